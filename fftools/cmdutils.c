@@ -19,6 +19,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_SCHED_SETAFFINITY
+/* for sched_setaffinity() and cpu_set_t, must come before any system header */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#endif
+
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -60,6 +69,9 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #endif
+#if HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -71,6 +83,7 @@ AVDictionary *swr_opts;
 AVDictionary *format_opts, *codec_opts;
 
 static FILE *report_file;
+static int log_async;
 static int report_file_level = AV_LOG_DEBUG;
 int hide_banner = 0;
 
@@ -82,6 +95,10 @@ enum show_muxdemuxers {
 
 void uninit_opts(void)
 {
+    if (log_async) {
+        av_log_async_stop();
+        log_async = 0;
+    }
     av_dict_free(&swr_opts);
     av_dict_free(&sws_dict);
     av_dict_free(&format_opts);
@@ -869,6 +886,140 @@ int opt_cpucount(void *optctx, const char *opt, const char *arg)
     return ret;
 }
 
+#if HAVE_SCHED_SETAFFINITY || HAVE_SETPROCESSAFFINITYMASK
+#define MAX_CPUSET_CPUS 1024
+
+/**
+ * Parse a list of CPU indices and ranges such as "0-3,8,10-11" into set.
+ * @return the number of CPUs in the set or a negative error code
+ */
+static int parse_cpu_list(const char *list, uint8_t *set, int max_cpus)
+{
+    const char *p = list;
+    int count = 0;
+
+    while (*p) {
+        char *end;
+        long first, last;
+
+        first = last = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return AVERROR(EINVAL);
+        p = end;
+        if (*p == '-') {
+            last = strtol(++p, &end, 10);
+            if (end == p || last < first)
+                return AVERROR(EINVAL);
+            p = end;
+        }
+        if (last >= max_cpus)
+            return AVERROR(ERANGE);
+        for (long i = first; i <= last; i++) {
+            count += !set[i];
+            set[i] = 1;
+        }
+        if (*p == ',')
+            p++;
+        else if (*p && *p != '\n')
+            return AVERROR(EINVAL);
+        else
+            break;
+    }
+
+    return count ? count : AVERROR(EINVAL);
+}
+
+/**
+ * Read the CPU list of a NUMA node from sysfs.
+ */
+static int read_node_cpu_list(const char *node, char *buf, int size)
+{
+    char path[128];
+    char *end;
+    FILE *f;
+    long n = strtol(node, &end, 10);
+
+    if (end == node || *end || n < 0)
+        return AVERROR(EINVAL);
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld/cpulist", n);
+    f = fopen(path, "r");
+    if (!f)
+        return AVERROR(errno);
+    if (!fgets(buf, size, f))
+        buf[0] = 0;
+    fclose(f);
+
+    return 0;
+}
+#endif
+
+int opt_cpuset(void *optctx, const char *opt, const char *arg)
+{
+#if HAVE_SCHED_SETAFFINITY || HAVE_SETPROCESSAFFINITYMASK
+    uint8_t set[MAX_CPUSET_CPUS] = { 0 };
+    char node_list[1024];
+    const char *list = arg;
+    int count, ret;
+
+    if (av_strstart(arg, "node", &list)) {
+        if ((ret = read_node_cpu_list(list, node_list, sizeof(node_list))) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Cannot get the CPUs of NUMA node '%s': %s\n",
+                   list, av_err2str(ret));
+            return ret;
+        }
+        list = node_list;
+    }
+
+#if HAVE_SCHED_SETAFFINITY
+    count = parse_cpu_list(list, set, FFMIN(CPU_SETSIZE, MAX_CPUSET_CPUS));
+#else
+    count = parse_cpu_list(list, set, FFMIN(sizeof(DWORD_PTR) * 8, MAX_CPUSET_CPUS));
+#endif
+    if (count < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid CPU list '%s'\n", arg);
+        return count;
+    }
+
+#if HAVE_SCHED_SETAFFINITY
+    {
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        for (int i = 0; i < FFMIN(CPU_SETSIZE, MAX_CPUSET_CPUS); i++)
+            if (set[i])
+                CPU_SET(i, &cpuset);
+
+        if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0) {
+            ret = AVERROR(errno);
+            av_log(NULL, AV_LOG_ERROR, "Cannot restrict the process to CPUs '%s': %s\n",
+                   arg, av_err2str(ret));
+            return ret;
+        }
+    }
+#else
+    {
+        DWORD_PTR mask = 0;
+
+        for (int i = 0; i < sizeof(mask) * 8; i++)
+            if (set[i])
+                mask |= (DWORD_PTR)1 << i;
+
+        if (!SetProcessAffinityMask(GetCurrentProcess(), mask)) {
+            av_log(NULL, AV_LOG_ERROR, "Cannot restrict the process to CPUs '%s'\n", arg);
+            return AVERROR_EXTERNAL;
+        }
+    }
+#endif
+
+    av_log(NULL, AV_LOG_VERBOSE, "Running on %d CPUs: %s\n", count, arg);
+    return 0;
+#else
+    av_log(NULL, AV_LOG_ERROR, "Setting the CPU affinity is not supported on this system\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
 int opt_loglevel(void *optctx, const char *opt, const char *arg)
 {
     const struct { const char *name; int level; } log_levels[] = {
@@ -886,6 +1037,7 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
     char *tail;
     int flags = av_log_get_flags();
     int level = av_log_get_level();
+    int async = log_async;
     int cmd, i = 0;
 
     av_assert0(arg);
@@ -898,6 +1050,7 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
         }
         if (!i && !cmd) {
             flags = 0;  /* missing relative prefix, build absolute value */
+            async = 0;
         }
         if (av_strstart(token, "repeat", &arg)) {
             if (cmd == '-') {
@@ -911,6 +1064,8 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
             } else {
                 flags |= AV_LOG_PRINT_LEVEL;
             }
+        } else if (av_strstart(token, "async", &arg)) {
+            async = cmd != '-';
         } else {
             break;
         }
@@ -922,6 +1077,7 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
         arg++;
     } else if (!i) {
         flags = av_log_get_flags();  /* level value without prefix, reset flags */
+        async = log_async;
     }
 
     for (i = 0; i < FF_ARRAY_ELEMS(log_levels); i++) {
@@ -943,6 +1099,20 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
 end:
     av_log_set_flags(flags);
     av_log_set_level(level);
+    if (async && !log_async) {
+        int ret = av_log_async_start(0);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_WARNING, "Could not start asynchronous logging: %s\n",
+                   av_err2str(ret));
+        } else {
+            av_log_set_callback(av_log_async_callback);
+            log_async = 1;
+        }
+    } else if (!async && log_async) {
+        av_log_set_callback(av_log_default_callback);
+        av_log_async_stop();
+        log_async = 0;
+    }
     return 0;
 }
 
@@ -1057,6 +1227,20 @@ int opt_report(void *optctx, const char *opt, const char *arg)
     return init_report(NULL);
 }
 
+int opt_hugepage_threshold(void *optctx, const char *opt, const char *arg)
+{
+    char *tail;
+    size_t threshold;
+
+    threshold = strtol(arg, &tail, 10);
+    if (*tail) {
+        av_log(NULL, AV_LOG_FATAL, "Invalid hugepage_threshold \"%s\".\n", arg);
+        exit_program(1);
+    }
+    av_hugepage_threshold(threshold);
+    return 0;
+}
+
 int opt_max_alloc(void *optctx, const char *opt, const char *arg)
 {
     char *tail;
@@ -93,6 +93,12 @@ int opt_cpuflags(void *optctx, const char *opt, const char *arg);
  */
 int opt_cpucount(void *optctx, const char *opt, const char *arg);
 
+/**
+ * Restrict the process and all threads it creates afterwards to a set of
+ * CPUs, given as a list like "0-3,8" or as "node<N>" for a NUMA node.
+ */
+int opt_cpuset(void *optctx, const char *opt, const char *arg);
+
 /**
  * Fallback for options that are not explicitly handled, these will be
  * parsed through AVOptions.
@@ -108,6 +114,11 @@ int opt_report(void *optctx, const char *opt, const char *arg);
 
 int opt_max_alloc(void *optctx, const char *opt, const char *arg);
 
+/**
+ * Set the size above which allocations are backed with huge pages.
+ */
+int opt_hugepage_threshold(void *optctx, const char *opt, const char *arg);
+
 int opt_codec_debug(void *optctx, const char *opt, const char *arg);
 
 /**
@@ -244,8 +255,10 @@ void show_help_options(const OptionDef *options, const char *msg, int req_flags,
     { "v",           HAS_ARG,              { .func_arg = opt_loglevel },     "set logging level", "loglevel" },         \
     { "report",      0,                    { .func_arg = opt_report },       "generate a report" },                     \
     { "max_alloc",   HAS_ARG,              { .func_arg = opt_max_alloc },    "set maximum size of a single allocated block", "bytes" }, \
+    { "hugepage_threshold", HAS_ARG | OPT_EXPERT, { .func_arg = opt_hugepage_threshold }, "back blocks of at least this size with huge pages", "bytes" }, \
     { "cpuflags",    HAS_ARG | OPT_EXPERT, { .func_arg = opt_cpuflags },     "force specific cpu flags", "flags" },     \
     { "cpucount",    HAS_ARG | OPT_EXPERT, { .func_arg = opt_cpucount },     "force specific cpu count", "count" },     \
+    { "cpuset",      HAS_ARG | OPT_EXPERT, { .func_arg = opt_cpuset },       "run on a specific set of cpus", "list" }, \
     { "hide_banner", OPT_BOOL | OPT_EXPERT, {&hide_banner},     "do not show program banner", "hide_banner" },          \
     CMDUTILS_COMMON_OPTIONS_AVDEVICE                                                                                    \
 
@@ -63,6 +63,7 @@
 #include "libavutil/time.h"
 #include "libavutil/thread.h"
 #include "libavutil/threadmessage.h"
+#include "libavutil/trace.h"
 #include "libavcodec/mathops.h"
 #include "libavformat/os_support.h"
 
@@ -110,6 +111,16 @@ const char program_name[] = "ffmpeg";
 const int program_birth_year = 2000;
 
 static FILE *vstats_file;
+static FILE *stats_json_file;
+
+#if HAVE_THREADS
+/* -metrics_listen: the metrics of the last report, served by a thread */
+static AVIOContext *metrics_server;
+static pthread_t metrics_thread_id;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *metrics_text;
+static atomic_int metrics_abort = ATOMIC_VAR_INIT(0);
+#endif
 
 const char *const forced_keyframes_const_names[] = {
     "n",
@@ -141,6 +152,7 @@ static unsigned nb_output_dumped = 0;
 static int want_sdp = 1;
 
 static BenchmarkTimeStamps current_time;
+static int64_t program_start_usec;
 AVIOContext *progress_avio = NULL;
 
 static uint8_t *subtitle_out;
@@ -167,6 +179,8 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_thread(OutputStream *ost);
+static void free_metrics_server(void);
 #endif
 
 /* sub2video hack:
@@ -343,6 +357,7 @@ void term_exit(void)
 static volatile int received_sigterm = 0;
 static volatile int received_nb_signals = 0;
 static atomic_int transcode_init_done = ATOMIC_VAR_INIT(0);
+static atomic_int_least64_t pipeline_memory = ATOMIC_VAR_INIT(0);
 static volatile int ffmpeg_exited = 0;
 static int main_return_code = 0;
 static int64_t copy_ts_first_pts = AV_NOPTS_VALUE;
@@ -521,6 +536,12 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+    if (memory_accounting) {
+        av_mem_accounting_dump(NULL, AV_LOG_INFO);
+        av_mem_accounting_stop();
+        memory_accounting = 0;
+    }
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -566,6 +587,7 @@ static void ffmpeg_cleanup(int ret)
         av_freep(&filtergraphs[i]);
     }
     av_freep(&filtergraphs);
+    filter_thread_pools_free();
 
     av_freep(&subtitle_out);
 
@@ -589,9 +611,13 @@ static void ffmpeg_cleanup(int ret)
         if (!ost)
             continue;
 
+#if HAVE_THREADS
+        free_encoder_thread(ost);
+#endif
         av_bsf_free(&ost->bsf_ctx);
 
-        av_frame_free(&ost->filtered_frame);
+        for (j = 0; j < FF_ARRAY_ELEMS(ost->filtered_frames); j++)
+            av_frame_free(&ost->filtered_frames[j]);
         av_frame_free(&ost->last_frame);
         av_packet_free(&ost->pkt);
         av_dict_free(&ost->encoder_opts);
@@ -623,10 +649,14 @@ static void ffmpeg_cleanup(int ret)
     }
 #if HAVE_THREADS
     free_input_threads();
+    free_metrics_server();
 #endif
     for (i = 0; i < nb_input_files; i++) {
         avformat_close_input(&input_files[i]->ctx);
         av_packet_free(&input_files[i]->pkt);
+#if HAVE_THREADS
+        av_packet_pool_free(&input_files[i]->pkt_pool);
+#endif
         av_freep(&input_files[i]);
     }
     for (i = 0; i < nb_input_streams; i++) {
@@ -639,7 +669,11 @@ static void ffmpeg_cleanup(int ret)
         av_frame_free(&ist->sub2video.frame);
         av_freep(&ist->filters);
         av_freep(&ist->hwaccel_device);
+        av_freep(&ist->hwupload_device);
+        av_buffer_unref(&ist->hwupload_frames_ctx);
+        av_buffer_unref(&ist->hwupload_device_ref);
         av_freep(&ist->dts_buffer);
+        frame_cache_free(&ist->frame_cache);
 
         avcodec_free_context(&ist->dec_ctx);
 
@@ -653,6 +687,24 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    if (stats_json_file) {
+        if (fclose(stats_json_file))
+            av_log(NULL, AV_LOG_ERROR,
+                   "Error closing JSON stats file, loss of information possible: %s\n",
+                   av_err2str(AVERROR(errno)));
+    }
+    av_freep(&stats_json_filename);
+    if (trace_events_filename) {
+        /* the codec and input threads have all been joined by now */
+        int err;
+
+        av_trace_stop();
+        if ((err = av_trace_write_json(trace_events_filename)) < 0)
+            av_log(NULL, AV_LOG_ERROR, "Error writing trace events to %s: %s\n",
+                   trace_events_filename, av_err2str(err));
+        av_trace_free();
+        av_freep(&trace_events_filename);
+    }
     av_freep(&filter_nbthreads);
 
     av_freep(&input_streams);
@@ -718,6 +770,78 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+static BenchmarkTimeStamps stage_start(void)
+{
+    BenchmarkTimeStamps t = { 0 };
+
+    if (stats_json_filename || metrics_listen)
+        t = get_benchmark_time_stamps();
+    return t;
+}
+
+static void stage_end(StageStats *st, BenchmarkTimeStamps t0)
+{
+    BenchmarkTimeStamps t;
+
+    if (!stats_json_filename && !metrics_listen)
+        return;
+    t = get_benchmark_time_stamps();
+    st->real_usec += t.real_usec - t0.real_usec;
+    st->cpu_usec  += t.user_usec + t.sys_usec - t0.user_usec - t0.sys_usec;
+    st->count++;
+}
+
+static void queue_stats_add(QueueStats *qs, int nb_elems)
+{
+    qs->bins[FFMIN(nb_elems ? av_log2(nb_elems) + 1 : 0, STATS_QUEUE_BINS - 1)]++;
+    qs->max = FFMAX(qs->max, nb_elems);
+}
+
+void pipeline_memory_add(int64_t size)
+{
+    atomic_fetch_add(&pipeline_memory, size);
+}
+
+/*
+ * Whether queuing size more bytes takes the pipeline over -max_pipeline_memory.
+ * A thread waits on it only while its own queue is not empty, so that the
+ * consumer of the queue can always make progress.
+ */
+static int pipeline_memory_over(int64_t size)
+{
+    return max_pipeline_memory && atomic_load(&pipeline_memory) + size > max_pipeline_memory;
+}
+
+int64_t frame_data_size(const AVFrame *frame)
+{
+    int64_t size = 0;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    for (i = 0; i < frame->nb_extended_buf; i++)
+        size += frame->extended_buf[i]->size;
+    return size;
+}
+
+static int encode_send_frame(OutputStream *ost, StageStats *st, const AVFrame *frame)
+{
+    BenchmarkTimeStamps t = stage_start();
+    int ret = avcodec_send_frame(ost->enc_ctx, frame);
+
+    stage_end(st, t);
+    return ret;
+}
+
+static int encode_receive_packet(OutputStream *ost, StageStats *st, AVPacket *pkt)
+{
+    BenchmarkTimeStamps t = stage_start();
+    int ret = avcodec_receive_packet(ost->enc_ctx, pkt);
+
+    stage_end(st, t);
+    return ret;
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
@@ -731,6 +855,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
+    BenchmarkTimeStamps t;
     int ret;
 
     /*
@@ -754,7 +879,8 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
         /* the muxer is not initialized yet, buffer the packet */
         if (!av_fifo_space(ost->muxing_queue)) {
             unsigned int are_we_over_size =
-                (ost->muxing_queue_data_size + pkt->size) > ost->muxing_queue_data_threshold;
+                (ost->muxing_queue_data_size + pkt->size) > ost->muxing_queue_data_threshold ||
+                pipeline_memory_over(pkt->size);
             int new_size = are_we_over_size ?
                            FFMIN(2 * av_fifo_size(ost->muxing_queue),
                                  ost->max_muxing_queue_size) :
@@ -778,6 +904,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
             exit_program(1);
         av_packet_move_ref(tmp_pkt, pkt);
         ost->muxing_queue_data_size += tmp_pkt->size;
+        pipeline_memory_add(tmp_pkt->size);
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
         return;
     }
@@ -864,7 +991,14 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
+    t = stage_start();
     ret = av_interleaved_write_frame(s, pkt);
+    stage_end(&of->mux_stats, t);
+    if (of->first_packet_usec < 0) {
+        of->first_packet_usec = av_gettime_relative() - program_start_usec;
+        av_log(NULL, AV_LOG_VERBOSE, "First packet muxed to output #%d after %.3fs\n",
+               ost->file_index, of->first_packet_usec / 1000000.0);
+    }
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
@@ -1001,6 +1135,220 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     return ret;
 }
 
+#if HAVE_THREADS
+static void *encoder_thread(void *arg)
+{
+    OutputStream   *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    StageStats stats = { 0 };
+    AVPacket *pkt = NULL;
+    AVFrame *frame;
+    int64_t pts;
+    int ret = 0;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    while (!ost->enc_abort) {
+        if (!av_fifo_size(ost->enc_frame_queue)) {
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+            continue;
+        }
+        av_fifo_generic_read(ost->enc_frame_queue, &frame, sizeof(frame), NULL);
+        if (frame)
+            pipeline_memory_add(-frame_data_size(frame));
+        pthread_cond_broadcast(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        /* a NULL frame flushes the encoder */
+        pts = frame ? frame->pts : AV_NOPTS_VALUE;
+        ret = encode_send_frame(ost, &stats, frame);
+        av_frame_free(&frame);
+
+        while (ret >= 0) {
+            if (!pkt && !(pkt = av_packet_alloc())) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            ret = encode_receive_packet(ost, &stats, pkt);
+            if (ret < 0)
+                break;
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt->pts = pts;
+
+            pthread_mutex_lock(&ost->enc_lock);
+            if (av_fifo_space(ost->enc_pkt_queue) < sizeof(pkt))
+                ret = av_fifo_realloc2(ost->enc_pkt_queue, 2 * av_fifo_size(ost->enc_pkt_queue));
+            if (ret >= 0) {
+                av_fifo_generic_write(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+                pkt = NULL;
+                pthread_cond_broadcast(&ost->enc_cond);
+            }
+            pthread_mutex_unlock(&ost->enc_lock);
+        }
+
+        pthread_mutex_lock(&ost->enc_lock);
+        ost->encode_stats.real_usec += stats.real_usec;
+        ost->encode_stats.cpu_usec  += stats.cpu_usec;
+        ost->encode_stats.count     += stats.count;
+        memset(&stats, 0, sizeof(stats));
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            ost->enc_thread_ret = ret;
+            pthread_cond_broadcast(&ost->enc_cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    AVFrame *frame;
+    AVPacket *pkt;
+
+    if (!ost->enc_frame_queue)
+        return;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    ost->enc_abort = 1;
+    pthread_cond_broadcast(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+    pthread_join(ost->enc_thread, NULL);
+
+    while (av_fifo_size(ost->enc_frame_queue)) {
+        av_fifo_generic_read(ost->enc_frame_queue, &frame, sizeof(frame), NULL);
+        if (frame)
+            pipeline_memory_add(-frame_data_size(frame));
+        av_frame_free(&frame);
+    }
+    av_fifo_freep(&ost->enc_frame_queue);
+    while (av_fifo_size(ost->enc_pkt_queue)) {
+        av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+        av_packet_free(&pkt);
+    }
+    av_fifo_freep(&ost->enc_pkt_queue);
+    pthread_cond_destroy(&ost->enc_cond);
+    pthread_mutex_destroy(&ost->enc_lock);
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    OutputFile *of = output_files[ost->file_index];
+    int ret;
+
+    /* the first pass statistics are written per packet from the main thread */
+    if (!of->thread_queue_size || ost->logfile ||
+        (ost->enc_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+         ost->enc_ctx->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+
+    ost->enc_frame_queue = av_fifo_alloc(of->thread_queue_size * sizeof(AVFrame *));
+    ost->enc_pkt_queue   = av_fifo_alloc(8 * sizeof(AVPacket *));
+    if (!ost->enc_frame_queue || !ost->enc_pkt_queue) {
+        av_fifo_freep(&ost->enc_frame_queue);
+        av_fifo_freep(&ost->enc_pkt_queue);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&ost->enc_lock, NULL);
+    pthread_cond_init(&ost->enc_cond, NULL);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_cond_destroy(&ost->enc_cond);
+        pthread_mutex_destroy(&ost->enc_lock);
+        av_fifo_freep(&ost->enc_frame_queue);
+        av_fifo_freep(&ost->enc_pkt_queue);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+/*
+ * Queue a reference to frame, or NULL to flush, to the encoder thread,
+ * waiting while its queue is full.
+ */
+static void send_frame_to_encoder_thread(OutputStream *ost, const AVFrame *frame)
+{
+    AVFrame *ref = NULL;
+    int64_t size;
+
+    if (frame && !(ref = av_frame_clone(frame))) {
+        av_log(NULL, AV_LOG_FATAL, "Error queuing a frame to the encoder\n");
+        exit_program(1);
+    }
+    size = ref ? frame_data_size(ref) : 0;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    queue_stats_add(&ost->enc_queue_stats, av_fifo_size(ost->enc_frame_queue) / sizeof(ref));
+    while ((av_fifo_space(ost->enc_frame_queue) < sizeof(ref) ||
+            (av_fifo_size(ost->enc_frame_queue) && pipeline_memory_over(size))) &&
+           !ost->enc_thread_ret)
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    if (!ost->enc_thread_ret) {
+        av_fifo_generic_write(ost->enc_frame_queue, &ref, sizeof(ref), NULL);
+        pipeline_memory_add(size);
+        pthread_cond_broadcast(&ost->enc_cond);
+        ref = NULL;
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    av_frame_free(&ref);
+}
+
+/*
+ * Write the packets returned so far by the encoder thread, or all of them
+ * until the encoder is flushed if flush is set.
+ */
+static void output_encoder_thread_packets(OutputFile *of, OutputStream *ost, int flush)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket *pkt;
+    int ret;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    for (;;) {
+        while (av_fifo_size(ost->enc_pkt_queue)) {
+            int pkt_size;
+
+            av_fifo_generic_read(ost->enc_pkt_queue, &pkt, sizeof(pkt), NULL);
+            pthread_mutex_unlock(&ost->enc_lock);
+
+            if (!(flush && ost->finished & MUXER_FINISHED)) {
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                           "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                           av_get_media_type_string(enc->codec_type),
+                           av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+                           av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+                }
+                av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+                pkt_size = pkt->size;
+                output_packet(of, pkt, ost, 0);
+                if (enc->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename)
+                    do_video_stats(ost, pkt_size);
+            }
+            av_packet_free(&pkt);
+
+            pthread_mutex_lock(&ost->enc_lock);
+        }
+        ret = ost->enc_thread_ret;
+        if (ret < 0 || !flush)
+            break;
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    if (ret < 0 && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(enc->codec_type), av_err2str(ret));
+        exit_program(1);
+    }
+}
+#endif
+
 static void do_audio_out(OutputFile *of, OutputStream *ost,
                          AVFrame *frame)
 {
@@ -1027,12 +1375,20 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
-    ret = avcodec_send_frame(enc, frame);
+#if HAVE_THREADS
+    if (ost->enc_frame_queue) {
+        send_frame_to_encoder_thread(ost, frame);
+        output_encoder_thread_packets(of, ost, 0);
+        return;
+    }
+#endif
+
+    ret = encode_send_frame(ost, &ost->encode_stats, frame);
     if (ret < 0)
         goto error;
 
     while (1) {
-        ret = avcodec_receive_packet(enc, pkt);
+        ret = encode_receive_packet(ost, &ost->encode_stats, pkt);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -1268,6 +1624,7 @@ static void do_video_out(OutputFile *of,
 
     if (nb0_frames == 0 && ost->last_dropped) {
         nb_frames_drop++;
+        ost->frames_dropped++;
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
@@ -1276,9 +1633,11 @@ static void do_video_out(OutputFile *of,
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
             nb_frames_drop++;
+            ost->frames_dropped++;
             return;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        nb_frames_dup          += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        ost->frames_duplicated += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
         if (nb_frames_dup > dup_warning) {
             av_log(NULL, AV_LOG_WARNING, "More than %d frames duplicated\n", dup_warning);
@@ -1369,14 +1728,25 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+#if HAVE_THREADS
+        if (ost->enc_frame_queue) {
+            send_frame_to_encoder_thread(ost, in_picture);
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
+            output_encoder_thread_packets(of, ost, 0);
+            ost->sync_opts++;
+            ost->frame_number++;
+            continue;
+        }
+#endif
+
+        ret = encode_send_frame(ost, &ost->encode_stats, in_picture);
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
         while (1) {
-            ret = avcodec_receive_packet(enc, pkt);
+            ret = encode_receive_packet(ost, &ost->encode_stats, pkt);
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
                 break;
@@ -1503,9 +1873,42 @@ static void finish_output_stream(OutputStream *ost)
  *
  * @return  0 for success, <0 for severe errors
  */
+static void reap_frame(OutputFile *of, OutputStream *ost, AVFrame *filtered_frame)
+{
+    AVFilterContext *filter = ost->filter->filter;
+    AVCodecContext *enc = ost->enc_ctx;
+
+    if (ost->finished) {
+        av_frame_unref(filtered_frame);
+        return;
+    }
+
+    switch (av_buffersink_get_type(filter)) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+
+        do_video_out(of, ost, filtered_frame);
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
+            enc->channels != filtered_frame->channels) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+            break;
+        }
+        do_audio_out(of, ost, filtered_frame);
+        break;
+    default:
+        // TODO support subtitle filters
+        av_assert0(0);
+    }
+
+    av_frame_unref(filtered_frame);
+}
+
 static int reap_filters(int flush)
 {
-    AVFrame *filtered_frame = NULL;
     int i;
 
     /* Reap all buffers present in the buffer sinks */
@@ -1513,7 +1916,6 @@ static int reap_filters(int flush)
         OutputStream *ost = output_streams[i];
         OutputFile    *of = output_files[ost->file_index];
         AVFilterContext *filter;
-        AVCodecContext *enc = ost->enc_ctx;
         int ret = 0;
 
         if (!ost->filter || !ost->filter->graph->graph)
@@ -1532,48 +1934,26 @@ static int reap_filters(int flush)
         if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_AUDIO)
             init_output_stream_wrapper(ost, NULL, 1);
 
-        filtered_frame = ost->filtered_frame;
-
         while (1) {
-            ret = av_buffersink_get_frame_flags(filter, filtered_frame,
-                                               AV_BUFFERSINK_FLAG_NO_REQUEST);
+            BenchmarkTimeStamps t = stage_start();
+
+            /* get all the frames queued in the sink at once */
+            ret = av_buffersink_get_frames(filter, ost->filtered_frames,
+                                           FF_ARRAY_ELEMS(ost->filtered_frames),
+                                           AV_BUFFERSINK_FLAG_NO_REQUEST);
+            stage_end(&ost->filter->graph->filter_stats, t);
             if (ret < 0) {
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
-                           "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
+                           "Error in av_buffersink_get_frames(): %s\n", av_err2str(ret));
                 } else if (flush && ret == AVERROR_EOF) {
                     if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
                         do_video_out(of, ost, NULL);
                 }
                 break;
             }
-            if (ost->finished) {
-                av_frame_unref(filtered_frame);
-                continue;
-            }
-
-            switch (av_buffersink_get_type(filter)) {
-            case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
-                do_video_out(of, ost, filtered_frame);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
-                    enc->channels != filtered_frame->channels) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
-            }
-
-            av_frame_unref(filtered_frame);
+            for (int j = 0; j < ret; j++)
+                reap_frame(of, ost, ost->filtered_frames[j]);
         }
     }
 
@@ -1697,6 +2077,452 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void json_print_string(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; str && *str; str++) {
+        if (*str == '"' || *str == '\\')
+            av_bprintf(bp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            av_bprintf(bp, "\\u%04x", (unsigned char)*str);
+        else
+            av_bprint_chars(bp, *str, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+static void json_print_stage(AVBPrint *bp, const char *name, const StageStats *st)
+{
+    av_bprintf(bp, "\"%s\": {\"real_us\": %"PRId64", \"cpu_us\": %"PRId64", \"count\": %"PRIu64"}",
+               name, st->real_usec, st->cpu_usec, st->count);
+}
+
+static void json_print_queue(AVBPrint *bp, const QueueStats *qs)
+{
+    int i, nb_bins = STATS_QUEUE_BINS;
+
+    while (nb_bins > 1 && !qs->bins[nb_bins - 1])
+        nb_bins--;
+    av_bprintf(bp, "\"queue\": {\"max\": %d, \"histogram\": [", qs->max);
+    for (i = 0; i < nb_bins; i++)
+        av_bprintf(bp, "%s%"PRIu64, i ? ", " : "", qs->bins[i]);
+    av_bprintf(bp, "]}");
+}
+
+/*
+ * Write the per-stage statistics as one JSON object on a line of the
+ * -stats_json file.
+ */
+static void write_stats_json(int is_last_report, int64_t elapsed)
+{
+    BenchmarkTimeStamps t = get_benchmark_time_stamps();
+    AVBPrint bp;
+    int i, j;
+
+    if (!stats_json_file) {
+        stats_json_file = fopen(stats_json_filename, "w");
+        if (!stats_json_file) {
+            av_log(NULL, AV_LOG_ERROR, "Error opening %s: %s\n",
+                   stats_json_filename, av_err2str(AVERROR(errno)));
+            av_freep(&stats_json_filename);
+            return;
+        }
+    }
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "{\"final\": %s, \"real_us\": %"PRId64", \"user_us\": %"PRId64", "
+               "\"sys_us\": %"PRId64", \"maxrss_kb\": %"PRId64", "
+               "\"frames_duplicated\": %d, \"frames_dropped\": %d",
+               is_last_report ? "true" : "false", elapsed, t.user_usec, t.sys_usec,
+               getmaxrss() / 1024, nb_frames_dup, nb_frames_drop);
+
+    av_bprintf(&bp, ", \"inputs\": [");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+
+        av_bprintf(&bp, "%s{\"index\": %d, \"url\": ", i ? ", " : "", i);
+        json_print_string(&bp, f->ctx->url);
+        av_bprintf(&bp, ", \"bytes_read\": %"PRId64", ", f->ctx->pb ? f->ctx->pb->bytes_read : 0);
+        json_print_stage(&bp, "demux", &f->demux_stats);
+        av_bprintf(&bp, ", ");
+        json_print_queue(&bp, &f->queue_stats);
+        av_bprintf(&bp, ", \"streams\": [");
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+
+            av_bprintf(&bp, "%s{\"index\": %d, \"type\": \"%s\", \"codec\": \"%s\", "
+                       "\"packets\": %"PRIu64", \"frames_decoded\": %"PRIu64", ",
+                       j ? ", " : "", j,
+                       (const char *)av_x_if_null(av_get_media_type_string(ist->st->codecpar->codec_type), "unknown"),
+                       avcodec_get_name(ist->st->codecpar->codec_id),
+                       ist->nb_packets, ist->frames_decoded);
+            json_print_stage(&bp, "decode", &ist->decode_stats);
+            av_bprintf(&bp, "}");
+        }
+        av_bprintf(&bp, "]}");
+    }
+
+    av_bprintf(&bp, "], \"filtergraphs\": [");
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        int simple = filtergraph_is_simple(fg);
+
+        av_bprintf(&bp, "%s{\"index\": %d, \"simple\": %s, \"graph\": ", i ? ", " : "", i,
+                   simple ? "true" : "false");
+        json_print_string(&bp, simple ? fg->outputs[0]->ost->avfilter : fg->graph_desc);
+        av_bprintf(&bp, ", ");
+        json_print_stage(&bp, "filter", &fg->filter_stats);
+        av_bprintf(&bp, "}");
+    }
+
+    av_bprintf(&bp, "], \"outputs\": [");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        av_bprintf(&bp, "%s{\"index\": %d, \"url\": ", i ? ", " : "", i);
+        json_print_string(&bp, of->ctx->url);
+        av_bprintf(&bp, ", \"bytes_written\": %"PRId64", ", of->ctx->pb ? of->ctx->pb->bytes_written : 0);
+        if (of->first_packet_usec >= 0)
+            av_bprintf(&bp, "\"first_packet_us\": %"PRId64", ", of->first_packet_usec);
+        else
+            av_bprintf(&bp, "\"first_packet_us\": null, ");
+        json_print_stage(&bp, "mux", &of->mux_stats);
+        av_bprintf(&bp, ", \"streams\": [");
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            OutputStream *ost = output_streams[of->ost_index + j];
+            StageStats encode_stats;
+            QueueStats queue_stats;
+
+#if HAVE_THREADS
+            if (ost->enc_frame_queue)
+                pthread_mutex_lock(&ost->enc_lock);
+#endif
+            encode_stats = ost->encode_stats;
+            queue_stats  = ost->enc_queue_stats;
+#if HAVE_THREADS
+            if (ost->enc_frame_queue)
+                pthread_mutex_unlock(&ost->enc_lock);
+#endif
+
+            av_bprintf(&bp, "%s{\"index\": %d, \"type\": \"%s\", \"codec\": \"%s\", "
+                       "\"frames_encoded\": %"PRIu64", \"packets_written\": %"PRIu64", "
+                       "\"frames_duplicated\": %"PRIu64", \"frames_dropped\": %"PRIu64", ",
+                       j ? ", " : "", j,
+                       (const char *)av_x_if_null(av_get_media_type_string(ost->st->codecpar->codec_type), "unknown"),
+                       avcodec_get_name(ost->st->codecpar->codec_id),
+                       ost->frames_encoded, ost->packets_written,
+                       ost->frames_duplicated, ost->frames_dropped);
+            json_print_stage(&bp, "encode", &encode_stats);
+            av_bprintf(&bp, ", ");
+            json_print_queue(&bp, &queue_stats);
+            av_bprintf(&bp, "}");
+        }
+        av_bprintf(&bp, "]}");
+    }
+    av_bprintf(&bp, "]}\n");
+
+    if (av_bprint_is_complete(&bp)) {
+        fputs(bp.str, stats_json_file);
+        fflush(stats_json_file);
+    }
+    av_bprint_finalize(&bp, NULL);
+}
+
+#if HAVE_THREADS
+static void metrics_family(AVBPrint *bp, const char *name, const char *type,
+                           const char *help)
+{
+    av_bprintf(bp, "# HELP ffmpeg_%s %s\n# TYPE ffmpeg_%s %s\n", name, help, name, type);
+}
+
+static void metrics_stage(AVBPrint *bp, int field, const char *stage,
+                          const char *labels, const StageStats *st)
+{
+    av_bprintf(bp, "ffmpeg_stage_%s{stage=\"%s\",%s} ",
+               field == 0 ? "seconds_total" : field == 1 ? "cpu_seconds_total" : "calls_total",
+               stage, labels);
+    if (field == 0)
+        av_bprintf(bp, "%.6f\n", st->real_usec / 1000000.0);
+    else if (field == 1)
+        av_bprintf(bp, "%.6f\n", st->cpu_usec / 1000000.0);
+    else
+        av_bprintf(bp, "%"PRIu64"\n", st->count);
+}
+
+/*
+ * Build the metrics of the current report in the Prometheus text format, for
+ * the metrics thread to serve them.
+ */
+static void update_metrics(int64_t elapsed, double speed)
+{
+    BenchmarkTimeStamps t = get_benchmark_time_stamps();
+    double secs = elapsed / 1000000.0;
+    char labels[64];
+    char *text;
+    AVBPrint bp;
+    int field, i, j;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    metrics_family(&bp, "elapsed_seconds", "gauge", "Time since the start of the transcoding.");
+    av_bprintf(&bp, "ffmpeg_elapsed_seconds %.6f\n", secs);
+    metrics_family(&bp, "speed", "gauge", "Output duration divided by the elapsed time.");
+    av_bprintf(&bp, "ffmpeg_speed %.4f\n", FFMAX(speed, 0));
+    metrics_family(&bp, "cpu_seconds_total", "counter", "User and system CPU time of the process.");
+    av_bprintf(&bp, "ffmpeg_cpu_seconds_total %.6f\n", (t.user_usec + t.sys_usec) / 1000000.0);
+    metrics_family(&bp, "pipeline_memory_bytes", "gauge", "Size of the packets and frames queued between the threads.");
+    av_bprintf(&bp, "ffmpeg_pipeline_memory_bytes %"PRId64"\n", (int64_t)atomic_load(&pipeline_memory));
+
+    metrics_family(&bp, "input_bytes_total", "counter", "Bytes read from the input file.");
+    for (i = 0; i < nb_input_files; i++)
+        av_bprintf(&bp, "ffmpeg_input_bytes_total{file=\"%d\"} %"PRId64"\n", i,
+                   input_files[i]->ctx->pb ? input_files[i]->ctx->pb->bytes_read : 0);
+    metrics_family(&bp, "input_queue_packets", "gauge", "Packets queued by the input thread.");
+    for (i = 0; i < nb_input_files; i++)
+        av_bprintf(&bp, "ffmpeg_input_queue_packets{file=\"%d\"} %d\n", i,
+                   input_files[i]->in_thread_queue ?
+                   av_thread_message_queue_nb_elems(input_files[i]->in_thread_queue) : 0);
+    metrics_family(&bp, "input_queue_bytes", "gauge", "Bytes queued by the input thread, when bounded.");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+        int64_t bytes = 0;
+
+        if (f->in_thread_queue && f->thread_queue_bytes) {
+            pthread_mutex_lock(&f->queue_lock);
+            bytes = f->queued_bytes;
+            pthread_mutex_unlock(&f->queue_lock);
+        }
+        av_bprintf(&bp, "ffmpeg_input_queue_bytes{file=\"%d\"} %"PRId64"\n", i, bytes);
+    }
+
+    metrics_family(&bp, "input_packets_total", "counter", "Packets read from the input stream.");
+    for (i = 0; i < nb_input_streams; i++)
+        av_bprintf(&bp, "ffmpeg_input_packets_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   input_streams[i]->file_index, input_streams[i]->st->index,
+                   input_streams[i]->nb_packets);
+    metrics_family(&bp, "decoded_frames_total", "counter", "Frames returned by the decoder.");
+    for (i = 0; i < nb_input_streams; i++)
+        av_bprintf(&bp, "ffmpeg_decoded_frames_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   input_streams[i]->file_index, input_streams[i]->st->index,
+                   input_streams[i]->frames_decoded);
+    metrics_family(&bp, "decoder_threads", "gauge", "Threads of the decoder.");
+    for (i = 0; i < nb_input_streams; i++)
+        if (input_streams[i]->decoding_needed)
+            av_bprintf(&bp, "ffmpeg_decoder_threads{file=\"%d\",stream=\"%d\"} %d\n",
+                       input_streams[i]->file_index, input_streams[i]->st->index,
+                       input_streams[i]->dec_ctx->thread_count);
+
+    metrics_family(&bp, "output_bytes_total", "counter", "Bytes written to the output file.");
+    for (i = 0; i < nb_output_files; i++)
+        av_bprintf(&bp, "ffmpeg_output_bytes_total{file=\"%d\"} %"PRId64"\n", i,
+                   output_files[i]->ctx->pb ? output_files[i]->ctx->pb->bytes_written : 0);
+    metrics_family(&bp, "output_bitrate_bits_per_second", "gauge", "Size of the output file divided by its duration.");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        int64_t pts = 0;
+
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            AVStream *st = of->ctx->streams[j];
+            if (av_stream_get_end_pts(st) != AV_NOPTS_VALUE)
+                pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(st), st->time_base, AV_TIME_BASE_Q));
+        }
+        av_bprintf(&bp, "ffmpeg_output_bitrate_bits_per_second{file=\"%d\"} %.1f\n", i,
+                   pts > 0 && of->ctx->pb ? of->ctx->pb->bytes_written * 8.0 * AV_TIME_BASE / pts : 0);
+    }
+
+    metrics_family(&bp, "output_packets_total", "counter", "Packets written to the output stream.");
+    for (i = 0; i < nb_output_streams; i++)
+        av_bprintf(&bp, "ffmpeg_output_packets_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   output_streams[i]->file_index, output_streams[i]->index,
+                   output_streams[i]->packets_written);
+    metrics_family(&bp, "encoded_frames_total", "counter", "Frames sent to the encoder.");
+    for (i = 0; i < nb_output_streams; i++)
+        av_bprintf(&bp, "ffmpeg_encoded_frames_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   output_streams[i]->file_index, output_streams[i]->index,
+                   output_streams[i]->frames_encoded);
+    metrics_family(&bp, "output_fps", "gauge", "Frames encoded per second since the start.");
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i]->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+            av_bprintf(&bp, "ffmpeg_output_fps{file=\"%d\",stream=\"%d\"} %.2f\n",
+                       output_streams[i]->file_index, output_streams[i]->index,
+                       secs > 0 ? output_streams[i]->frames_encoded / secs : 0);
+    metrics_family(&bp, "frames_dropped_total", "counter", "Frames dropped by the video sync.");
+    for (i = 0; i < nb_output_streams; i++)
+        av_bprintf(&bp, "ffmpeg_frames_dropped_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   output_streams[i]->file_index, output_streams[i]->index,
+                   output_streams[i]->frames_dropped);
+    metrics_family(&bp, "frames_duplicated_total", "counter", "Frames duplicated by the video sync.");
+    for (i = 0; i < nb_output_streams; i++)
+        av_bprintf(&bp, "ffmpeg_frames_duplicated_total{file=\"%d\",stream=\"%d\"} %"PRIu64"\n",
+                   output_streams[i]->file_index, output_streams[i]->index,
+                   output_streams[i]->frames_duplicated);
+    metrics_family(&bp, "encoder_queue_frames", "gauge", "Frames queued to the encoder thread.");
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        int nb_frames = 0;
+
+        if (ost->enc_frame_queue) {
+            pthread_mutex_lock(&ost->enc_lock);
+            nb_frames = av_fifo_size(ost->enc_frame_queue) / sizeof(AVFrame *);
+            pthread_mutex_unlock(&ost->enc_lock);
+        }
+        av_bprintf(&bp, "ffmpeg_encoder_queue_frames{file=\"%d\",stream=\"%d\"} %d\n",
+                   ost->file_index, ost->index, nb_frames);
+    }
+    metrics_family(&bp, "muxing_queue_packets", "gauge", "Packets queued until the muxer is initialized.");
+    for (i = 0; i < nb_output_streams; i++)
+        av_bprintf(&bp, "ffmpeg_muxing_queue_packets{file=\"%d\",stream=\"%d\"} %d\n",
+                   output_streams[i]->file_index, output_streams[i]->index,
+                   output_streams[i]->muxing_queue ?
+                   (int)(av_fifo_size(output_streams[i]->muxing_queue) / sizeof(AVPacket *)) : 0);
+
+    metrics_family(&bp, "first_packet_seconds", "gauge", "Time from the start until the first packet was muxed.");
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i]->first_packet_usec >= 0)
+            av_bprintf(&bp, "ffmpeg_first_packet_seconds{file=\"%d\"} %.6f\n",
+                       i, output_files[i]->first_packet_usec / 1000000.0);
+
+    for (field = 0; field < 3; field++) {
+        metrics_family(&bp, field == 0 ? "stage_seconds_total" :
+                            field == 1 ? "stage_cpu_seconds_total" : "stage_calls_total",
+                       "counter", field == 0 ? "Wall-clock time spent in the stage." :
+                                  field == 1 ? "CPU time of the process while in the stage." :
+                                               "Calls of the stage.");
+        for (i = 0; i < nb_input_files; i++) {
+            snprintf(labels, sizeof(labels), "file=\"%d\"", i);
+            metrics_stage(&bp, field, "demux", labels, &input_files[i]->demux_stats);
+        }
+        for (i = 0; i < nb_input_streams; i++) {
+            if (!input_streams[i]->decoding_needed)
+                continue;
+            snprintf(labels, sizeof(labels), "file=\"%d\",stream=\"%d\"",
+                     input_streams[i]->file_index, input_streams[i]->st->index);
+            metrics_stage(&bp, field, "decode", labels, &input_streams[i]->decode_stats);
+        }
+        for (i = 0; i < nb_filtergraphs; i++) {
+            snprintf(labels, sizeof(labels), "graph=\"%d\"", i);
+            metrics_stage(&bp, field, "filter", labels, &filtergraphs[i]->filter_stats);
+        }
+        for (i = 0; i < nb_output_streams; i++) {
+            OutputStream *ost = output_streams[i];
+            StageStats encode_stats;
+
+            if (!ost->encoding_needed)
+                continue;
+            if (ost->enc_frame_queue)
+                pthread_mutex_lock(&ost->enc_lock);
+            encode_stats = ost->encode_stats;
+            if (ost->enc_frame_queue)
+                pthread_mutex_unlock(&ost->enc_lock);
+            snprintf(labels, sizeof(labels), "file=\"%d\",stream=\"%d\"",
+                     ost->file_index, ost->index);
+            metrics_stage(&bp, field, "encode", labels, &encode_stats);
+        }
+        for (i = 0; i < nb_output_files; i++) {
+            snprintf(labels, sizeof(labels), "file=\"%d\"", i);
+            metrics_stage(&bp, field, "mux", labels, &output_files[i]->mux_stats);
+        }
+    }
+
+    if (av_bprint_finalize(&bp, &text) < 0)
+        return;
+    pthread_mutex_lock(&metrics_lock);
+    av_free(metrics_text);
+    metrics_text = text;
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+static int metrics_interrupt_cb(void *ctx)
+{
+    return atomic_load(&metrics_abort);
+}
+
+static const AVIOInterruptCB metrics_int_cb = { metrics_interrupt_cb, NULL };
+
+static void serve_metrics(AVIOContext *client)
+{
+    uint8_t *resource = NULL;
+    char *text = NULL;
+    int ret;
+
+    /* read the request up to its resource, then reply with the metrics */
+    while ((ret = avio_handshake(client)) > 0) {
+        av_opt_get(client, "resource", AV_OPT_SEARCH_CHILDREN, &resource);
+        if (resource && *resource)
+            break;
+        av_freep(&resource);
+    }
+    av_freep(&resource);
+    if (ret < 0)
+        return;
+    av_opt_set(client, "content_type", "text/plain; version=0.0.4", AV_OPT_SEARCH_CHILDREN);
+    while ((ret = avio_handshake(client)) > 0);
+    if (ret < 0)
+        return;
+
+    pthread_mutex_lock(&metrics_lock);
+    if (metrics_text)
+        text = av_strdup(metrics_text);
+    pthread_mutex_unlock(&metrics_lock);
+    if (text)
+        avio_write(client, text, strlen(text));
+    avio_flush(client);
+    av_free(text);
+}
+
+static void *metrics_thread(void *arg)
+{
+    AVIOContext *client;
+
+    while (avio_accept(metrics_server, &client) >= 0) {
+        serve_metrics(client);
+        avio_closep(&client);
+    }
+    return NULL;
+}
+
+static int init_metrics_server(void)
+{
+    const char *proto = avio_find_protocol_name(metrics_listen);
+    AVDictionary *opts = NULL;
+    int ret;
+
+    /* the server accepts each scrape as a client of its own */
+    if (!proto || strcmp(proto, "http")) {
+        av_log(NULL, AV_LOG_ERROR, "The metrics must be served on an http URL\n");
+        return AVERROR(EINVAL);
+    }
+    av_dict_set(&opts, "listen", "2", 0);
+    /* the listening context itself never sends a body */
+    av_dict_set(&opts, "chunked_post", "0", 0);
+    ret = avio_open2(&metrics_server, metrics_listen, AVIO_FLAG_WRITE, &metrics_int_cb, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to listen for metrics on %s: %s\n",
+               metrics_listen, av_err2str(ret));
+        return ret;
+    }
+    update_metrics(0, 0);
+
+    if ((ret = pthread_create(&metrics_thread_id, NULL, metrics_thread, NULL))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        avio_closep(&metrics_server);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void free_metrics_server(void)
+{
+    if (!metrics_server)
+        return;
+    atomic_store(&metrics_abort, 1);
+    pthread_join(metrics_thread_id, NULL);
+    avio_closep(&metrics_server);
+    av_freep(&metrics_text);
+}
+#endif
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1716,7 +2542,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int ret;
     float t;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!print_stats && !is_last_report && !progress_avio && !stats_json_live &&
+        !metrics_listen)
         return;
 
     if (!is_last_report) {
@@ -1818,8 +2645,10 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             }
         }
 
-        if (is_last_report)
-            nb_frames_drop += ost->last_dropped;
+        if (is_last_report) {
+            nb_frames_drop      += ost->last_dropped;
+            ost->frames_dropped += ost->last_dropped;
+        }
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1901,6 +2730,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    if (stats_json_filename && (stats_json_live || is_last_report))
+        write_stats_json(is_last_report, cur_time - timer_start);
+#if HAVE_THREADS
+    if (metrics_server)
+        update_metrics(cur_time - timer_start, speed);
+#endif
+
     first_report = 0;
 
     if (is_last_report)
@@ -1967,6 +2803,15 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_frame_queue) {
+            send_frame_to_encoder_thread(ost, NULL);
+            output_encoder_thread_packets(of, ost, 1);
+            output_packet(of, ost->pkt, ost, 1);
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket *pkt = ost->pkt;
@@ -1985,8 +2830,8 @@ static void flush_encoders(void)
 
             update_benchmark(NULL);
 
-            while ((ret = avcodec_receive_packet(enc, pkt)) == AVERROR(EAGAIN)) {
-                ret = avcodec_send_frame(enc, NULL);
+            while ((ret = encode_receive_packet(ost, &ost->encode_stats, pkt)) == AVERROR(EAGAIN)) {
+                ret = encode_send_frame(ost, &ost->encode_stats, NULL);
                 if (ret < 0) {
                     av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
                            desc,
@@ -2043,7 +2888,11 @@ static int check_output_constraints(InputStream *ist, OutputStream *ost)
     return 1;
 }
 
-static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *pkt)
+/*
+ * Copy pkt to ost. If move is set, the packet is not used anymore by the
+ * caller and is moved to the muxer instead of being referenced.
+ */
+static void do_streamcopy(InputStream *ist, OutputStream *ost, AVPacket *pkt, int move)
 {
     OutputFile *of = output_files[ost->file_index];
     InputFile   *f = input_files [ist->file_index];
@@ -2094,7 +2943,10 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
         ost->sync_opts++;
 
-    if (av_packet_ref(opkt, pkt) < 0)
+    if (move) {
+        av_packet_move_ref(opkt, pkt);
+        pkt = opkt;
+    } else if (av_packet_ref(opkt, pkt) < 0)
         exit_program(1);
 
     if (pkt->pts != AV_NOPTS_VALUE)
@@ -2170,17 +3022,13 @@ static int ifilter_has_all_input_formats(FilterGraph *fg)
     return 1;
 }
 
-static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
+/* determine if the parameters of the input changed */
+static int ifilter_need_reinit(InputFilter *ifilter, const AVFrame *frame)
 {
     FilterGraph *fg = ifilter->graph;
     AVFrameSideData *sd;
-    int need_reinit, ret;
-    int buffersrc_flags = AV_BUFFERSRC_FLAG_PUSH;
-
-    if (keep_reference)
-        buffersrc_flags |= AV_BUFFERSRC_FLAG_KEEP_REF;
+    int need_reinit;
 
-    /* determine if the parameters for this input changed */
     need_reinit = ifilter->format != frame->format;
 
     switch (ifilter->ist->st->codecpar->codec_type) {
@@ -2208,6 +3056,20 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
     } else if (ifilter->displaymatrix)
         need_reinit = 1;
 
+    return need_reinit;
+}
+
+static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
+{
+    FilterGraph *fg = ifilter->graph;
+    BenchmarkTimeStamps t;
+    int need_reinit, ret;
+    int buffersrc_flags = AV_BUFFERSRC_FLAG_PUSH;
+
+    if (keep_reference)
+        buffersrc_flags |= AV_BUFFERSRC_FLAG_KEEP_REF;
+
+    need_reinit = ifilter_need_reinit(ifilter, frame);
     if (need_reinit) {
         ret = ifilter_parameters_from_frame(ifilter, frame);
         if (ret < 0)
@@ -2229,6 +3091,7 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
                 }
             }
             av_fifo_generic_write(ifilter->frame_queue, &tmp, sizeof(tmp), NULL);
+            pipeline_memory_add(frame_data_size(tmp));
             return 0;
         }
 
@@ -2245,7 +3108,9 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
         }
     }
 
+    t = stage_start();
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, buffersrc_flags);
+    stage_end(&fg->filter_stats, t);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -2305,11 +3170,91 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
     return 0;
 }
 
+#if HAVE_THREADS
+typedef struct FilterPushJob {
+    InputFilter *ifilter;
+    AVFrame *frame;
+    pthread_t thread;
+    int threaded;
+    int ret;
+} FilterPushJob;
+
+static void *filter_push_thread(void *arg)
+{
+    FilterPushJob *job = arg;
+    BenchmarkTimeStamps t = stage_start();
+
+    job->ret = av_buffersrc_add_frame_flags(job->ifilter->filter, job->frame,
+                                            AV_BUFFERSRC_FLAG_PUSH |
+                                            AV_BUFFERSRC_FLAG_KEEP_REF);
+    stage_end(&job->ifilter->graph->filter_stats, t);
+    return NULL;
+}
+
+/*
+ * Push a video frame into all the filtergraphs fed by ist at once, one thread
+ * per graph, each taking its own reference to the frame.
+ * Return AVERROR(EAGAIN) if they must be fed sequentially because they are
+ * not all distinct and configured for the frame parameters.
+ */
+static int send_frame_to_filters_mt(InputStream *ist, AVFrame *decoded_frame)
+{
+    FilterPushJob jobs[16];
+    int i, j, ret;
+
+    if (ist->nb_filters > FF_ARRAY_ELEMS(jobs))
+        return AVERROR(EAGAIN);
+    for (i = 0; i < ist->nb_filters; i++) {
+        InputFilter *ifilter = ist->filters[i];
+
+        if (!ifilter->graph->graph || ifilter_need_reinit(ifilter, decoded_frame))
+            return AVERROR(EAGAIN);
+        for (j = 0; j < i; j++)
+            if (ist->filters[j]->graph == ifilter->graph)
+                return AVERROR(EAGAIN);
+        jobs[i].ifilter  = ifilter;
+        jobs[i].frame    = decoded_frame;
+        jobs[i].threaded = 0;
+    }
+
+    /* the first graph is fed by the calling thread, as are the others if
+     * their thread cannot be created */
+    for (i = 1; i < ist->nb_filters; i++) {
+        ret = pthread_create(&jobs[i].thread, NULL, filter_push_thread, &jobs[i]);
+        jobs[i].threaded = !ret;
+    }
+    for (i = 0; i < ist->nb_filters; i++)
+        if (!jobs[i].threaded)
+            filter_push_thread(&jobs[i]);
+    for (i = 1; i < ist->nb_filters; i++)
+        if (jobs[i].threaded)
+            pthread_join(jobs[i].thread, NULL);
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        ret = jobs[i].ret;
+        if (ret < 0 && ret != AVERROR_EOF) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Failed to inject frame into filter network: %s\n", av_err2str(ret));
+            return ret;
+        }
+    }
+    return 0;
+}
+#endif
+
 static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
 {
     int i, ret;
 
     av_assert1(ist->nb_filters > 0); /* ensure ret is initialized */
+#if HAVE_THREADS
+    if (parallel_filtergraphs && ist->nb_filters > 1 &&
+        ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        ret = send_frame_to_filters_mt(ist, decoded_frame);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+    }
+#endif
     for (i = 0; i < ist->nb_filters; i++) {
         ret = ifilter_send_frame(ist->filters[i], decoded_frame, i < ist->nb_filters - 1);
         if (ret == AVERROR_EOF)
@@ -2328,11 +3273,14 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
 {
     AVFrame *decoded_frame = ist->decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
+    BenchmarkTimeStamps t;
     int ret, err = 0;
     AVRational decoded_frame_tb;
 
     update_benchmark(NULL);
+    t = stage_start();
     ret = decode(avctx, decoded_frame, got_output, pkt);
+    stage_end(&ist->decode_stats, t);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2387,6 +3335,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
                         int *decode_failed)
 {
     AVFrame *decoded_frame = ist->decoded_frame;
+    BenchmarkTimeStamps t;
     int i, ret = 0, err = 0;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
@@ -2414,7 +3363,12 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
-    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    t = stage_start();
+    if (ist->frame_cache)
+        ret = frame_cache_decode(ist->frame_cache, ist->dec_ctx, decoded_frame, got_output, pkt);
+    else
+        ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    stage_end(&ist->decode_stats, t);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2466,6 +3420,12 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
     ist->hwaccel_retrieved_pix_fmt = decoded_frame->format;
 
+    if (ist->hwupload_device_ref) {
+        err = hwupload_frame(ist, decoded_frame);
+        if (err < 0)
+            goto fail;
+    }
+
     best_effort_timestamp= decoded_frame->best_effort_timestamp;
     *duration_pts = decoded_frame->pkt_duration;
 
@@ -2601,9 +3561,10 @@ static int send_filter_eof(InputStream *ist)
 }
 
 /* pkt = NULL means EOF (needed to flush decoder buffers) */
-static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
+/* pkt is consumed by the last output stream copying it */
+static int process_input_packet(InputStream *ist, AVPacket *pkt, int no_eof)
 {
-    int ret = 0, i;
+    int ret = 0, i, last_copy = -1;
     int repeating = 0;
     int eof_reached = 0;
 
@@ -2626,7 +3587,7 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
     if (ist->next_pts == AV_NOPTS_VALUE)
         ist->next_pts = ist->pts;
 
-    if (pkt) {
+    if (pkt && ist->decoding_needed) {
         av_packet_unref(avpkt);
         ret = av_packet_ref(avpkt, pkt);
         if (ret < 0)
@@ -2775,13 +3736,17 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         ist->pts = ist->dts;
         ist->next_pts = ist->next_dts;
     }
-    for (i = 0; i < nb_output_streams; i++) {
+    for (i = 0; i < nb_output_streams; i++)
+        if (check_output_constraints(ist, output_streams[i]) &&
+            !output_streams[i]->encoding_needed)
+            last_copy = i;
+    for (i = 0; i <= last_copy; i++) {
         OutputStream *ost = output_streams[i];
 
         if (!check_output_constraints(ist, ost) || ost->encoding_needed)
             continue;
 
-        do_streamcopy(ist, ost, pkt);
+        do_streamcopy(ist, ost, pkt, pkt && i == last_copy);
     }
 
     return !eof_reached;
@@ -2958,6 +3923,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return ret;
         }
 
+        ret = hw_device_setup_for_upload(ist);
+        if (ret < 0) {
+            snprintf(error, error_len, "Device setup failed for "
+                     "upload on input stream #%d:%d : %s",
+                     ist->file_index, ist->st->index, av_err2str(ret));
+            return ret;
+        }
+
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 0);
@@ -2969,6 +3942,21 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return ret;
         }
         assert_avoptions(ist->decoder_opts);
+
+        if (ist->frame_cache_size > 0 && ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            const AVCodecDescriptor *desc = avcodec_descriptor_get(ist->dec_ctx->codec_id);
+
+            /* the frame of a packet must not depend on the packets before it */
+            if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+                av_log(NULL, AV_LOG_WARNING, "Not caching the frames of input stream #%d:%d: "
+                       "%s is not an intra-only codec\n",
+                       ist->file_index, ist->st->index, avcodec_get_name(ist->dec_ctx->codec_id));
+            } else if (!(ist->frame_cache = frame_cache_alloc(ist->frame_cache_size))) {
+                snprintf(error, error_len, "Could not allocate the frame cache "
+                         "of input stream #%d:%d", ist->file_index, ist->st->index);
+                return AVERROR(ENOMEM);
+            }
+        }
     }
 
     ist->next_pts = AV_NOPTS_VALUE;
@@ -3031,6 +4019,7 @@ static int check_init_output_file(OutputFile *of, int file_index)
             AVPacket *pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
             ost->muxing_queue_data_size -= pkt->size;
+            pipeline_memory_add(-pkt->size);
             write_packet(of, pkt, ost, 1);
             av_packet_free(&pkt);
         }
@@ -3068,6 +4057,21 @@ static int init_output_bsfs(OutputStream *ost)
     return 0;
 }
 
+// copy estimated duration as a hint to the muxer, bounded by -t
+static void set_duration_hint(OutputStream *ost, InputStream *ist)
+{
+    OutputFile *of = output_files[ost->file_index];
+
+    if (ost->st->duration <= 0 && ist && ist->st->duration > 0)
+        ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+
+    if (of->recording_time != INT64_MAX) {
+        int64_t max = av_rescale_q(of->recording_time, AV_TIME_BASE_Q, ost->st->time_base);
+        if (ost->st->duration <= 0 || ost->st->duration > max)
+            ost->st->duration = max;
+    }
+}
+
 static int init_output_stream_streamcopy(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -3130,9 +4134,7 @@ static int init_output_stream_streamcopy(OutputStream *ost)
             ost->st->time_base = av_add_q(av_stream_get_codec_timebase(ost->st), (AVRational){0, 1});
     }
 
-    // copy estimated duration as a hint to the muxer
-    if (ost->st->duration <= 0 && ist->st->duration > 0)
-        ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+    set_duration_hint(ost, ist);
 
     if (ist->st->nb_side_data) {
         for (i = 0; i < ist->st->nb_side_data; i++) {
@@ -3598,9 +4600,16 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
         if (ost->st->time_base.num <= 0 || ost->st->time_base.den <= 0)
             ost->st->time_base = av_add_q(ost->enc_ctx->time_base, (AVRational){0, 1});
 
-        // copy estimated duration as a hint to the muxer
-        if (ost->st->duration <= 0 && ist && ist->st->duration > 0)
-            ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+        set_duration_hint(ost, ist);
+
+#if HAVE_THREADS
+        ret = init_encoder_thread(ost);
+        if (ret < 0) {
+            snprintf(error, error_len, "Error starting the encoder thread "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -4005,51 +5014,92 @@ static int check_keyboard_interaction(int64_t cur_time)
 }
 
 #if HAVE_THREADS
+/* number of packets read at once by the input thread */
+#define INPUT_THREAD_BATCH 16
+
 static void *input_thread(void *arg)
 {
     InputFile *f = arg;
-    AVPacket *pkt = f->pkt, *queue_pkt;
+    AVPacket *pkts[INPUT_THREAD_BATCH] = { NULL }, *queue_pkt;
     unsigned flags = f->non_blocking ? AV_THREAD_MESSAGE_NONBLOCK : 0;
-    int ret = 0;
+    /* packets of non-seekable inputs are forwarded as soon as they are read */
+    int nb_batch = f->non_blocking ? 1 : INPUT_THREAD_BATCH;
+    int ret = 0, nb_pkts;
 
     while (1) {
-        ret = av_read_frame(f->ctx, pkt);
-
-        if (ret == AVERROR(EAGAIN)) {
-            av_usleep(10000);
-            continue;
+        for (int i = 0; i < nb_batch; i++) {
+            if (!pkts[i] && !(pkts[i] = av_packet_pool_get(f->pkt_pool))) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
         }
         if (ret < 0) {
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
-        queue_pkt = av_packet_alloc();
-        if (!queue_pkt) {
-            av_packet_unref(pkt);
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, AVERROR(ENOMEM));
+
+        nb_pkts = av_read_frames(f->ctx, pkts, nb_batch, 0);
+
+        if (nb_pkts == AVERROR(EAGAIN)) {
+            av_usleep(10000);
+            continue;
+        }
+        if (nb_pkts < 0) {
+            av_thread_message_queue_set_err_recv(f->in_thread_queue, nb_pkts);
             break;
         }
-        av_packet_move_ref(queue_pkt, pkt);
-        ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
-        if (flags && ret == AVERROR(EAGAIN)) {
-            flags = 0;
+
+        for (int i = 0; i < nb_pkts && ret >= 0; i++) {
+            queue_pkt = pkts[i];
+            pkts[i]   = NULL;
+
+            if (f->thread_queue_bytes) {
+                pthread_mutex_lock(&f->queue_lock);
+                if (flags && f->queued_bytes && f->queued_bytes + queue_pkt->size > f->thread_queue_bytes) {
+                    flags = 0;
+                    av_log(f->ctx, AV_LOG_WARNING,
+                           "Thread message queue blocking; consider raising the "
+                           "thread_queue_bytes option (current value: %"PRId64")\n",
+                           f->thread_queue_bytes);
+                }
+                /* a packet larger than the limit is still queued alone */
+                while (!f->queue_abort && f->queued_bytes &&
+                       (f->queued_bytes + queue_pkt->size > f->thread_queue_bytes ||
+                        pipeline_memory_over(queue_pkt->size)))
+                    pthread_cond_wait(&f->queue_cond, &f->queue_lock);
+                f->queued_bytes += queue_pkt->size;
+                pipeline_memory_add(queue_pkt->size);
+                pthread_mutex_unlock(&f->queue_lock);
+            }
+
             ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
-            av_log(f->ctx, AV_LOG_WARNING,
-                   "Thread message queue blocking; consider raising the "
-                   "thread_queue_size option (current value: %d)\n",
-                   f->thread_queue_size);
+            if (flags && ret == AVERROR(EAGAIN)) {
+                flags = 0;
+                ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
+                av_log(f->ctx, AV_LOG_WARNING,
+                       "Thread message queue blocking; consider raising the "
+                       "thread_queue_size option (current value: %d)\n",
+                       f->thread_queue_size);
+            }
+            if (ret < 0) {
+                if (ret != AVERROR_EOF)
+                    av_log(f->ctx, AV_LOG_ERROR,
+                           "Unable to send packet to main thread: %s\n",
+                           av_err2str(ret));
+                if (f->thread_queue_bytes)
+                    pipeline_memory_add(-queue_pkt->size);
+                av_packet_pool_release(f->pkt_pool, &queue_pkt);
+                av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+            }
         }
-        if (ret < 0) {
-            if (ret != AVERROR_EOF)
-                av_log(f->ctx, AV_LOG_ERROR,
-                       "Unable to send packet to main thread: %s\n",
-                       av_err2str(ret));
-            av_packet_free(&queue_pkt);
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+        if (ret < 0)
             break;
-        }
     }
 
+    for (int i = 0; i < nb_batch; i++)
+        if (pkts[i])
+            av_packet_pool_release(f->pkt_pool, &pkts[i]);
+
     return NULL;
 }
 
@@ -4061,12 +5111,25 @@ static void free_input_thread(int i)
     if (!f || !f->in_thread_queue)
         return;
     av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
-    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
-        av_packet_free(&pkt);
+    if (f->thread_queue_bytes) {
+        pthread_mutex_lock(&f->queue_lock);
+        f->queue_abort = 1;
+        pthread_cond_signal(&f->queue_cond);
+        pthread_mutex_unlock(&f->queue_lock);
+    }
+    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0) {
+        if (f->thread_queue_bytes)
+            pipeline_memory_add(-pkt->size);
+        av_packet_pool_release(f->pkt_pool, &pkt);
+    }
 
     pthread_join(f->thread, NULL);
     f->joined = 1;
     av_thread_message_queue_free(&f->in_thread_queue);
+    if (f->thread_queue_bytes) {
+        pthread_cond_destroy(&f->queue_cond);
+        pthread_mutex_destroy(&f->queue_lock);
+    }
 }
 
 static void free_input_threads(void)
@@ -4077,27 +5140,74 @@ static void free_input_threads(void)
         free_input_thread(i);
 }
 
+/*
+ * Whether reading the input may stall or take long enough for it to be read
+ * by a thread of its own, even when it is the only input.
+ */
+static int input_wants_thread(InputFile *f)
+{
+    const char *proto = avio_find_protocol_name(f->ctx->url);
+
+    if (!strcmp(f->ctx->iformat->name, "imf") ||
+        !strcmp(f->ctx->iformat->name, "mxf"))
+        return 1;
+    return f->ctx->pb && proto && strcmp(proto, "file") && strcmp(proto, "pipe");
+}
+
 static int init_input_thread(int i)
 {
     int ret;
     InputFile *f = input_files[i];
 
-    if (f->thread_queue_size < 0)
-        f->thread_queue_size = (nb_input_files > 1 ? 8 : 0);
+    if (f->thread_queue_size < 0) {
+        if (nb_input_files > 1) {
+            f->thread_queue_size = 8;
+        } else if (input_wants_thread(f)) {
+            /* the queue is then bounded by the size of the packets, so that
+             * it holds many small packets or a few large ones */
+            f->thread_queue_size = 256;
+            if (f->thread_queue_bytes < 0)
+                f->thread_queue_bytes = 64 << 20;
+            av_log(NULL, AV_LOG_VERBOSE, "Reading input #%d from a thread\n", i);
+        } else {
+            f->thread_queue_size = 0;
+        }
+    }
+    if (f->thread_queue_bytes < 0)
+        f->thread_queue_bytes = 0;
+    /* the packets of the queue are then accounted in the pipeline memory */
+    if (max_pipeline_memory &&
+        (!f->thread_queue_bytes || f->thread_queue_bytes > max_pipeline_memory))
+        f->thread_queue_bytes = max_pipeline_memory;
     if (!f->thread_queue_size)
         return 0;
 
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(f->pkt));
+    /* kept across the restarts of the thread when the input loops */
+    if (!f->pkt_pool && !(f->pkt_pool = av_packet_pool_alloc()))
+        return AVERROR(ENOMEM);
+    ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                         f->thread_queue_size, sizeof(f->pkt),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
+    if (f->thread_queue_bytes) {
+        f->queued_bytes = 0;
+        f->queue_abort  = 0;
+        pthread_mutex_init(&f->queue_lock, NULL);
+        pthread_cond_init(&f->queue_cond, NULL);
+    }
+
     if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
         av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
         av_thread_message_queue_free(&f->in_thread_queue);
+        if (f->thread_queue_bytes) {
+            pthread_cond_destroy(&f->queue_cond);
+            pthread_mutex_destroy(&f->queue_lock);
+        }
         return AVERROR(ret);
     }
 
@@ -4118,9 +5228,20 @@ static int init_input_threads(void)
 
 static int get_input_packet_mt(InputFile *f, AVPacket **pkt)
 {
-    return av_thread_message_queue_recv(f->in_thread_queue, pkt,
-                                        f->non_blocking ?
-                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    int ret;
+
+    queue_stats_add(&f->queue_stats, av_thread_message_queue_nb_elems(f->in_thread_queue));
+    ret = av_thread_message_queue_recv(f->in_thread_queue, pkt,
+                                       f->non_blocking ?
+                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret >= 0 && f->thread_queue_bytes) {
+        pthread_mutex_lock(&f->queue_lock);
+        f->queued_bytes -= (*pkt)->size;
+        pipeline_memory_add(-(*pkt)->size);
+        pthread_cond_signal(&f->queue_cond);
+        pthread_mutex_unlock(&f->queue_lock);
+    }
+    return ret;
 }
 #endif
 
@@ -4263,13 +5384,16 @@ static int process_input(int file_index)
     AVFormatContext *is;
     InputStream *ist;
     AVPacket *pkt;
+    BenchmarkTimeStamps t;
     int ret, thread_ret, i, j;
     int64_t duration;
     int64_t pkt_dts;
     int disable_discontinuity_correction = copy_ts;
 
     is  = ifile->ctx;
+    t   = stage_start();
     ret = get_input_packet(ifile, &pkt);
+    stage_end(&ifile->demux_stats, t);
 
     if (ret == AVERROR(EAGAIN)) {
         ifile->eagain = 1;
@@ -4285,6 +5409,8 @@ static int process_input(int file_index)
                 if (ret>0)
                     return 0;
                 avcodec_flush_buffers(avctx);
+                if (ist->frame_cache)
+                    frame_cache_flush(ist->frame_cache);
             }
         }
 #if HAVE_THREADS
@@ -4535,7 +5661,7 @@ static int process_input(int file_index)
 discard_packet:
 #if HAVE_THREADS
     if (ifile->thread_queue_size)
-        av_packet_free(&pkt);
+        av_packet_pool_release(ifile->pkt_pool, &pkt);
     else
 #endif
     av_packet_unref(pkt);
@@ -4708,6 +5834,8 @@ static int transcode(void)
 #if HAVE_THREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if (metrics_listen && (ret = init_metrics_server()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4903,6 +6031,8 @@ int main(int argc, char **argv)
 #endif
     avformat_network_init();
 
+    program_start_usec = av_gettime_relative();
+
     show_banner(argc, argv, options);
 
     /* parse options and open all input/output files */
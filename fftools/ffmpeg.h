@@ -122,6 +122,7 @@ typedef struct OptionsContext {
     float readrate;
     int accurate_seek;
     int thread_queue_size;
+    int64_t thread_queue_bytes;
 
     SpecifierOpt *ts_scale;
     int        nb_ts_scale;
@@ -131,10 +132,14 @@ typedef struct OptionsContext {
     int        nb_hwaccels;
     SpecifierOpt *hwaccel_devices;
     int        nb_hwaccel_devices;
+    SpecifierOpt *hwupload_devices;
+    int        nb_hwupload_devices;
     SpecifierOpt *hwaccel_output_formats;
     int        nb_hwaccel_output_formats;
     SpecifierOpt *autorotate;
     int        nb_autorotate;
+    SpecifierOpt *frame_cache_sizes;
+    int        nb_frame_cache_sizes;
 
     /* output options */
     StreamMap *stream_maps;
@@ -286,6 +291,22 @@ typedef struct OutputFilter {
     int *sample_rates;
 } OutputFilter;
 
+#define STATS_QUEUE_BINS 16
+
+/* time spent in a processing stage, for -stats_json */
+typedef struct StageStats {
+    int64_t  real_usec;     /* wall clock time */
+    int64_t  cpu_usec;      /* process CPU time, user and system */
+    uint64_t count;         /* number of calls */
+} StageStats;
+
+/* occupancy histogram of a queue: bin 0 counts the samples of an empty queue,
+ * bin i > 0 those of 2^(i-1) to 2^i - 1 elements */
+typedef struct QueueStats {
+    uint64_t bins[STATS_QUEUE_BINS];
+    int max;
+} QueueStats;
+
 typedef struct FilterGraph {
     int            index;
     const char    *graph_desc;
@@ -297,8 +318,12 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    StageStats filter_stats;
 } FilterGraph;
 
+typedef struct FrameCache FrameCache;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -368,6 +393,11 @@ typedef struct InputStream {
 
     int reinit_filters;
 
+    /* decoded frames of the packets with a content identifier, reused for
+     * the later packets with the same identifier */
+    int64_t frame_cache_size;
+    FrameCache *frame_cache;
+
     /* hwaccel options */
     enum HWAccelID hwaccel_id;
     enum AVHWDeviceType hwaccel_device_type;
@@ -381,6 +411,12 @@ typedef struct InputStream {
     enum AVPixelFormat hwaccel_pix_fmt;
     enum AVPixelFormat hwaccel_retrieved_pix_fmt;
 
+    /* upload of the decoded frames, shared by all the filtergraphs and
+     * encoders fed by the stream */
+    char  *hwupload_device;
+    AVBufferRef *hwupload_device_ref;
+    AVBufferRef *hwupload_frames_ctx;
+
     /* stats */
     // combined size of all the packets read
     uint64_t data_size;
@@ -389,6 +425,7 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+    StageStats decode_stats;
 
     int64_t *dts_buffer;
     int nb_dts_buffer;
@@ -420,12 +457,21 @@ typedef struct InputFile {
 
     AVPacket *pkt;
 
+    StageStats demux_stats;
+    QueueStats queue_stats;     /* occupancy of the input thread queue */
+
 #if HAVE_THREADS
     AVThreadMessageQueue *in_thread_queue;
     pthread_t thread;           /* thread reading from this file */
     int non_blocking;           /* reading packets from the thread should not block */
     int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
+    int64_t thread_queue_bytes; /* maximum size of the queued packets, 0 for no limit */
+    int64_t queued_bytes;       /* size of the packets in the queue */
+    int queue_abort;            /* the thread must stop waiting for room in the queue */
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_cond;
+    AVPacketPool *pkt_pool;     /* packets handed from the thread to the main thread */
 #endif
 } InputFile;
 
@@ -474,7 +520,8 @@ typedef struct OutputStream {
     AVCodecParameters *ref_par; /* associated input codec parameters with encoders options applied */
     const AVCodec *enc;
     int64_t max_frames;
-    AVFrame *filtered_frame;
+    /* frames got at once from the buffersink */
+    AVFrame *filtered_frames[8];
     AVFrame *last_frame;
     AVPacket *pkt;
     int last_dropped;
@@ -546,6 +593,11 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // number of frames dropped and duplicated to match the output frame rate
+    uint64_t frames_dropped;
+    uint64_t frames_duplicated;
+    StageStats encode_stats;
+    QueueStats enc_queue_stats; /* occupancy of the encoder thread queue */
 
     /* packet quality factor */
     int quality;
@@ -569,6 +621,16 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_THREADS
+    pthread_t enc_thread;        /* thread running the encoder of this stream */
+    pthread_mutex_t enc_lock;
+    pthread_cond_t enc_cond;
+    AVFifoBuffer *enc_frame_queue; /* frames sent to the encoder thread */
+    AVFifoBuffer *enc_pkt_queue;   /* packets returned by the encoder thread */
+    int enc_thread_ret;          /* error which stopped the thread, AVERROR_EOF once flushed */
+    int enc_abort;               /* the thread must stop */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -582,6 +644,13 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+    int thread_queue_size;   /* maximum number of frames queued to the encoder threads, 0 for none */
+
+    StageStats mux_stats;
+    /* wall clock time from the program start to the first packet muxed,
+     * -1 until then */
+    int64_t first_packet_usec;
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -598,6 +667,12 @@ extern FilterGraph **filtergraphs;
 extern int        nb_filtergraphs;
 
 extern char *vstats_filename;
+extern char *stats_json_filename;
+extern int stats_json_live;
+extern int64_t max_pipeline_memory;
+extern char *trace_events_filename;
+extern int memory_accounting;
+extern char *metrics_listen;
 extern char *sdp_filename;
 
 extern float audio_drift_threshold;
@@ -630,8 +705,10 @@ extern char *videotoolbox_pixfmt;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_complex_branch_nbthreads;
 extern int vstats_version;
 extern int auto_conversion_filters;
+extern int parallel_filtergraphs;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -654,6 +731,7 @@ void assert_avoptions(AVDictionary *m);
 int guess_input_channel_layout(InputStream *ist);
 
 int configure_filtergraph(FilterGraph *fg);
+void filter_thread_pools_free(void);
 void check_filter_outputs(void);
 int filtergraph_is_simple(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
@@ -663,8 +741,29 @@ void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
 
 int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame);
 
+/**
+ * Account size bytes added to (or removed from, if negative) the queues of
+ * the pipeline, which are bounded by -max_pipeline_memory.
+ */
+void pipeline_memory_add(int64_t size);
+int64_t frame_data_size(const AVFrame *frame);
+
 int ffmpeg_parse_options(int argc, char **argv);
 
+FrameCache *frame_cache_alloc(int64_t max_size);
+void frame_cache_free(FrameCache **fc);
+/**
+ * Forget the packets in flight, after the decoder was flushed.
+ */
+void frame_cache_flush(FrameCache *fc);
+/**
+ * Same as decode() in ffmpeg.c, except that the packets whose content
+ * identifier is cached are not sent to the decoder: their frame is output
+ * from the cache, after the frames of the packets sent before.
+ */
+int frame_cache_decode(FrameCache *fc, AVCodecContext *avctx, AVFrame *frame,
+                       int *got_frame, AVPacket *pkt);
+
 int videotoolbox_init(AVCodecContext *s);
 int qsv_init(AVCodecContext *s);
 
@@ -673,6 +772,8 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev);
 void hw_device_free_all(void);
 
 int hw_device_setup_for_decode(InputStream *ist);
+int hw_device_setup_for_upload(InputStream *ist);
+int hwupload_frame(InputStream *ist, AVFrame *frame);
 int hw_device_setup_for_encode(OutputStream *ost);
 int hw_device_setup_for_filter(FilterGraph *fg);
 
@@ -963,6 +963,52 @@ static void cleanup_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
 }
 
+/* the filter graphs using the same number of threads share them */
+typedef struct FilterThreadPool {
+    int nb_threads;
+    AVBufferRef *pool;
+} FilterThreadPool;
+
+static FilterThreadPool *thread_pools;
+static int nb_thread_pools;
+
+static int set_thread_pool(AVFilterGraph *graph)
+{
+    FilterThreadPool *p = NULL;
+    int i, ret;
+
+    if (graph->nb_threads == 1)
+        return 0;
+
+    for (i = 0; i < nb_thread_pools && !p; i++)
+        if (thread_pools[i].nb_threads == graph->nb_threads)
+            p = &thread_pools[i];
+    if (!p) {
+        AVBufferRef *pool;
+
+        ret = avfilter_thread_pool_alloc(&pool, graph->nb_threads);
+        if (ret == AVERROR(ENOSYS))
+            return 0;
+        if (ret < 0)
+            return ret;
+        GROW_ARRAY(thread_pools, nb_thread_pools);
+        p = &thread_pools[nb_thread_pools - 1];
+        p->nb_threads = graph->nb_threads;
+        p->pool       = pool;
+    }
+
+    graph->thread_pool = av_buffer_ref(p->pool);
+    return graph->thread_pool ? 0 : AVERROR(ENOMEM);
+}
+
+void filter_thread_pools_free(void)
+{
+    for (int i = 0; i < nb_thread_pools; i++)
+        av_buffer_unref(&thread_pools[i].pool);
+    av_freep(&thread_pools);
+    nb_thread_pools = 0;
+}
+
 int configure_filtergraph(FilterGraph *fg)
 {
     AVFilterInOut *inputs, *outputs, *cur;
@@ -1010,9 +1056,13 @@ int configure_filtergraph(FilterGraph *fg)
             args[strlen(args)-1] = 0;
         av_opt_set(fg->graph, "aresample_swr_opts", args, 0);
     } else {
-        fg->graph->nb_threads = filter_complex_nbthreads;
+        fg->graph->nb_threads        = filter_complex_nbthreads;
+        fg->graph->nb_branch_threads = filter_complex_branch_nbthreads;
     }
 
+    if ((ret = set_thread_pool(fg->graph)) < 0)
+        goto fail;
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
 
@@ -1098,10 +1148,16 @@ int configure_filtergraph(FilterGraph *fg)
 
     for (i = 0; i < fg->nb_inputs; i++) {
         while (av_fifo_size(fg->inputs[i]->frame_queue)) {
-            AVFrame *tmp;
-            av_fifo_generic_read(fg->inputs[i]->frame_queue, &tmp, sizeof(tmp), NULL);
-            ret = av_buffersrc_add_frame(fg->inputs[i]->filter, tmp);
-            av_frame_free(&tmp);
+            AVFrame *tmp[16];
+            int nb = FFMIN(av_fifo_size(fg->inputs[i]->frame_queue) / sizeof(*tmp),
+                           FF_ARRAY_ELEMS(tmp));
+
+            av_fifo_generic_read(fg->inputs[i]->frame_queue, tmp, nb * sizeof(*tmp), NULL);
+            for (int j = 0; j < nb; j++)
+                pipeline_memory_add(-frame_data_size(tmp[j]));
+            ret = av_buffersrc_add_frames(fg->inputs[i]->filter, tmp, nb, 0);
+            for (int j = 0; j < nb; j++)
+                av_frame_free(&tmp[j]);
             if (ret < 0)
                 goto fail;
         }
@@ -0,0 +1,295 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Cache of decoded video frames, keyed by the AV_PKT_DATA_CONTENT_ID side data
+ * of the packets, so that the packets a demuxer marks as repeating an earlier
+ * one are not decoded again.
+ */
+
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "ffmpeg.h"
+
+typedef struct FrameCacheEntry {
+    uint8_t *key;
+    size_t   key_size;
+    AVFrame *frame;
+    int64_t  size;
+    uint64_t last_use;
+} FrameCacheEntry;
+
+/* packet sent to the decoder, whose frame is not output yet */
+typedef struct FrameCachePending {
+    int64_t  pts;
+    uint8_t *key;       /* NULL if the packet has no content identifier */
+    size_t   key_size;
+} FrameCachePending;
+
+struct FrameCache {
+    int64_t max_size;
+    int64_t size;
+    uint64_t use_count;
+
+    FrameCacheEntry *entries;
+    int           nb_entries;
+
+    FrameCachePending *pending;
+    int             nb_pending;
+
+    /* cached frame to output once the decoder is drained */
+    AVFrame *hit;
+    int draining;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+FrameCache *frame_cache_alloc(int64_t max_size)
+{
+    FrameCache *fc = av_mallocz(sizeof(*fc));
+
+    if (!fc)
+        return NULL;
+    if (!(fc->hit = av_frame_alloc())) {
+        av_free(fc);
+        return NULL;
+    }
+    fc->max_size = max_size;
+    return fc;
+}
+
+static void clear_pending(FrameCache *fc, int nb)
+{
+    for (int i = 0; i < nb; i++)
+        av_freep(&fc->pending[i].key);
+    memmove(fc->pending, fc->pending + nb, (fc->nb_pending - nb) * sizeof(*fc->pending));
+    fc->nb_pending -= nb;
+}
+
+static void remove_entry(FrameCache *fc, int i)
+{
+    FrameCacheEntry *entry = &fc->entries[i];
+
+    fc->size -= entry->size;
+    av_freep(&entry->key);
+    av_frame_free(&entry->frame);
+    fc->entries[i] = fc->entries[--fc->nb_entries];
+}
+
+void frame_cache_free(FrameCache **pfc)
+{
+    FrameCache *fc = *pfc;
+
+    if (!fc)
+        return;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Frame cache: %"PRIu64" hits, %"PRIu64" misses\n",
+           fc->hits, fc->misses);
+
+    while (fc->nb_entries)
+        remove_entry(fc, fc->nb_entries - 1);
+    av_freep(&fc->entries);
+    clear_pending(fc, fc->nb_pending);
+    av_freep(&fc->pending);
+    av_frame_free(&fc->hit);
+    av_freep(pfc);
+}
+
+void frame_cache_flush(FrameCache *fc)
+{
+    clear_pending(fc, fc->nb_pending);
+    av_frame_unref(fc->hit);
+    fc->draining = 0;
+}
+
+static FrameCacheEntry *find_entry(FrameCache *fc, const uint8_t *key, size_t key_size)
+{
+    for (int i = 0; i < fc->nb_entries; i++)
+        if (fc->entries[i].key_size == key_size &&
+            !memcmp(fc->entries[i].key, key, key_size))
+            return &fc->entries[i];
+    return NULL;
+}
+
+static int add_pending(FrameCache *fc, int64_t pts, const uint8_t *key, size_t key_size)
+{
+    FrameCachePending *pending;
+
+    pending = av_realloc_array(fc->pending, fc->nb_pending + 1, sizeof(*fc->pending));
+    if (!pending)
+        return AVERROR(ENOMEM);
+    fc->pending = pending;
+    pending = &fc->pending[fc->nb_pending];
+
+    pending->pts      = pts;
+    pending->key      = NULL;
+    pending->key_size = key_size;
+    if (key && !(pending->key = av_memdup(key, key_size)))
+        return AVERROR(ENOMEM);
+    fc->nb_pending++;
+
+    return 0;
+}
+
+static int add_entry(FrameCache *fc, uint8_t **key, size_t key_size, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int64_t size = frame_data_size(frame);
+    FrameCacheEntry *entry;
+    int oldest;
+
+    /* hardware frames belong to a pool of surfaces the decoder recycles */
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || size > fc->max_size)
+        return 0;
+
+    while (fc->nb_entries && fc->size + size > fc->max_size) {
+        oldest = 0;
+        for (int i = 1; i < fc->nb_entries; i++)
+            if (fc->entries[i].last_use < fc->entries[oldest].last_use)
+                oldest = i;
+        remove_entry(fc, oldest);
+    }
+
+    entry = av_realloc_array(fc->entries, fc->nb_entries + 1, sizeof(*fc->entries));
+    if (!entry)
+        return AVERROR(ENOMEM);
+    fc->entries = entry;
+    entry = &fc->entries[fc->nb_entries];
+
+    if (!(entry->frame = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+    entry->key      = *key;
+    entry->key_size = key_size;
+    entry->size     = size;
+    entry->last_use = ++fc->use_count;
+    *key = NULL;
+
+    fc->size += size;
+    fc->nb_entries++;
+
+    return 0;
+}
+
+/* cache a frame output by the decoder under the key of its packet */
+static int cache_decoded_frame(FrameCache *fc, const AVFrame *frame)
+{
+    FrameCachePending *pending;
+    int ret = 0;
+    int i;
+
+    for (i = 0; i < fc->nb_pending; i++)
+        if (fc->pending[i].pts == frame->pts)
+            break;
+    /* the decoder did not keep the timestamp: forget the oldest packet, as
+     * every frame consumes at least one */
+    if (i == fc->nb_pending) {
+        if (fc->nb_pending)
+            clear_pending(fc, 1);
+        return 0;
+    }
+
+    pending = &fc->pending[i];
+    if (pending->key && !find_entry(fc, pending->key, pending->key_size))
+        ret = add_entry(fc, &pending->key, pending->key_size, frame);
+    clear_pending(fc, i + 1);
+
+    return ret;
+}
+
+int frame_cache_decode(FrameCache *fc, AVCodecContext *avctx, AVFrame *frame,
+                       int *got_frame, AVPacket *pkt)
+{
+    FrameCacheEntry *entry = NULL;
+    const uint8_t *key = NULL;
+    size_t key_size = 0;
+    int ret;
+
+    *got_frame = 0;
+
+    /* a decoding error interrupted the previous drain */
+    if (pkt && fc->draining) {
+        avcodec_flush_buffers(avctx);
+        frame_cache_flush(fc);
+    }
+
+    if (pkt && pkt->size) {
+        key = av_packet_get_side_data(pkt, AV_PKT_DATA_CONTENT_ID, &key_size);
+        if (key)
+            entry = find_entry(fc, key, key_size);
+    }
+
+    if (entry) {
+        fc->hits++;
+        entry->last_use = ++fc->use_count;
+
+        av_frame_unref(fc->hit);
+        if ((ret = av_frame_ref(fc->hit, entry->frame)) < 0)
+            return ret;
+        fc->hit->pts                   =
+        fc->hit->best_effort_timestamp = pkt->pts;
+        fc->hit->pkt_dts               = pkt->dts;
+        fc->hit->pkt_duration          = pkt->duration;
+        fc->hit->pkt_pos               = pkt->pos;
+        fc->hit->pkt_size              = pkt->size;
+
+        /* the frames of the packets sent before are output first */
+        if (fc->nb_pending) {
+            ret = avcodec_send_packet(avctx, NULL);
+            if (ret < 0 && ret != AVERROR_EOF)
+                return ret;
+            fc->draining = 1;
+        }
+    } else if (pkt) {
+        ret = avcodec_send_packet(avctx, pkt);
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+        if (pkt->size) {
+            if (key)
+                fc->misses++;
+            if ((ret = add_pending(fc, pkt->pts, key, key_size)) < 0)
+                return ret;
+        }
+    }
+
+    if (!fc->hit->buf[0] || fc->draining) {
+        ret = avcodec_receive_frame(avctx, frame);
+        if (ret >= 0) {
+            *got_frame = 1;
+            return cache_decoded_frame(fc, frame);
+        }
+        if (ret == AVERROR_EOF)
+            clear_pending(fc, fc->nb_pending);
+        if (ret == AVERROR_EOF && fc->draining) {
+            avcodec_flush_buffers(avctx);
+            fc->draining = 0;
+        } else if (ret != AVERROR(EAGAIN)) {
+            return ret;
+        }
+    }
+
+    if (fc->hit->buf[0]) {
+        av_frame_move_ref(frame, fc->hit);
+        *got_frame = 1;
+    }
+
+    return 0;
+}
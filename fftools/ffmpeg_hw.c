@@ -442,6 +442,156 @@ int hw_device_setup_for_decode(InputStream *ist)
     return 0;
 }
 
+int hw_device_setup_for_upload(InputStream *ist)
+{
+    enum AVHWDeviceType type;
+    HWDevice *dev;
+    int err;
+
+    if (!ist->hwupload_device)
+        return 0;
+
+    // Either the name of a device created with -init_hw_device or a
+    // device type, for which a default device is created if needed.
+    dev = hw_device_get_by_name(ist->hwupload_device);
+    if (!dev) {
+        type = av_hwdevice_find_type_by_name(ist->hwupload_device);
+        if (type == AV_HWDEVICE_TYPE_NONE) {
+            av_log(ist->dec_ctx, AV_LOG_ERROR, "Unknown device for "
+                   "upload: %s.\n", ist->hwupload_device);
+            return AVERROR(EINVAL);
+        }
+        dev = hw_device_get_by_type(type);
+        if (!dev) {
+            err = hw_device_init_from_type(type, NULL, &dev);
+            if (err < 0)
+                return err;
+        }
+    }
+
+    av_log(ist->dec_ctx, AV_LOG_VERBOSE, "Uploading decoded frames to "
+           "device %s (type %s).\n", dev->name,
+           av_hwdevice_get_type_name(dev->type));
+    ist->hwupload_device_ref = av_buffer_ref(dev->device_ref);
+    if (!ist->hwupload_device_ref)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static int hwupload_init_frames(InputStream *ist, const AVFrame *frame)
+{
+    AVHWFramesConstraints *constraints;
+    AVHWFramesContext *frames;
+    AVBufferRef *frames_ref = NULL;
+    int i, err;
+
+    constraints = av_hwdevice_get_hwframe_constraints(ist->hwupload_device_ref, NULL);
+    if (!constraints)
+        return AVERROR(ENOMEM);
+
+    if (!constraints->valid_hw_formats) {
+        err = AVERROR(ENOSYS);
+        goto fail;
+    }
+    if (constraints->valid_sw_formats) {
+        for (i = 0; constraints->valid_sw_formats[i] != AV_PIX_FMT_NONE; i++)
+            if (constraints->valid_sw_formats[i] == frame->format)
+                break;
+        if (constraints->valid_sw_formats[i] == AV_PIX_FMT_NONE) {
+            av_log(ist->dec_ctx, AV_LOG_ERROR, "Format %s cannot be "
+                   "uploaded to the device.\n",
+                   av_get_pix_fmt_name(frame->format));
+            err = AVERROR(ENOSYS);
+            goto fail;
+        }
+    }
+
+    frames_ref = av_hwframe_ctx_alloc(ist->hwupload_device_ref);
+    if (!frames_ref) {
+        err = AVERROR(ENOMEM);
+        goto fail;
+    }
+    frames = (AVHWFramesContext*)frames_ref->data;
+    frames->format    = constraints->valid_hw_formats[0];
+    frames->sw_format = frame->format;
+    frames->width     = frame->width;
+    frames->height    = frame->height;
+    // As for the hwupload filter, a fixed pool is only used when
+    // extra_hw_frames is set on the decoder.
+    if (ist->dec_ctx->extra_hw_frames >= 0)
+        frames->initial_pool_size = 2 + ist->dec_ctx->extra_hw_frames;
+
+    err = av_hwframe_ctx_init(frames_ref);
+    if (err < 0)
+        goto fail;
+
+    av_log(ist->dec_ctx, AV_LOG_VERBOSE, "Uploading %dx%d %s frames "
+           "as %s.\n", frame->width, frame->height,
+           av_get_pix_fmt_name(frame->format),
+           av_get_pix_fmt_name(frames->format));
+    av_buffer_unref(&ist->hwupload_frames_ctx);
+    ist->hwupload_frames_ctx = frames_ref;
+    av_hwframe_constraints_free(&constraints);
+    return 0;
+
+fail:
+    av_buffer_unref(&frames_ref);
+    av_hwframe_constraints_free(&constraints);
+    return err;
+}
+
+int hwupload_frame(InputStream *ist, AVFrame *frame)
+{
+    AVHWFramesContext *frames;
+    AVFrame *output;
+    int err;
+
+    if (frame->hw_frames_ctx) {
+        // Already on a device.
+        return 0;
+    }
+
+    // The frames context follows the changes of parameters of the stream,
+    // e.g. between the resources of an IMF composition.
+    frames = ist->hwupload_frames_ctx ?
+             (AVHWFramesContext*)ist->hwupload_frames_ctx->data : NULL;
+    if (!frames || frames->sw_format != frame->format ||
+        frames->width != frame->width || frames->height != frame->height) {
+        err = hwupload_init_frames(ist, frame);
+        if (err < 0)
+            return err;
+    }
+
+    output = av_frame_alloc();
+    if (!output)
+        return AVERROR(ENOMEM);
+
+    err = av_hwframe_get_buffer(ist->hwupload_frames_ctx, output, 0);
+    if (err < 0)
+        goto fail;
+
+    err = av_hwframe_transfer_data(output, frame, 0);
+    if (err < 0) {
+        av_log(ist->dec_ctx, AV_LOG_ERROR, "Failed to upload frame: "
+               "%d.\n", err);
+        goto fail;
+    }
+
+    err = av_frame_copy_props(output, frame);
+    if (err < 0)
+        goto fail;
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, output);
+    av_frame_free(&output);
+
+    return 0;
+
+fail:
+    av_frame_free(&output);
+    return err;
+}
+
 int hw_device_setup_for_encode(OutputStream *ost)
 {
     const AVCodecHWConfig *config;
@@ -42,6 +42,7 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/trace.h"
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
@@ -63,7 +64,9 @@ static const char *const opt_name_ts_scale[]                  = {"itsscale", NUL
 static const char *const opt_name_hwaccels[]                  = {"hwaccel", NULL};
 static const char *const opt_name_hwaccel_devices[]           = {"hwaccel_device", NULL};
 static const char *const opt_name_hwaccel_output_formats[]    = {"hwaccel_output_format", NULL};
+static const char *const opt_name_hwupload_devices[]          = {"hwupload_device", NULL};
 static const char *const opt_name_autorotate[]                = {"autorotate", NULL};
+static const char *const opt_name_frame_cache_sizes[]         = {"frame_cache", NULL};
 static const char *const opt_name_autoscale[]                 = {"autoscale", NULL};
 static const char *const opt_name_max_frames[]                = {"frames", "aframes", "vframes", "dframes", NULL};
 static const char *const opt_name_bitstream_filters[]         = {"bsf", "absf", "vbsf", NULL};
@@ -143,6 +146,12 @@ const HWAccel hwaccels[] = {
 HWDevice *filter_hw_device;
 
 char *vstats_filename;
+char *stats_json_filename;
+int stats_json_live = 0;
+int64_t max_pipeline_memory = 0;
+char *metrics_listen;
+char *trace_events_filename;
+int memory_accounting;
 char *sdp_filename;
 
 float audio_drift_threshold = 0.1;
@@ -170,8 +179,10 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+int filter_complex_branch_nbthreads = 1;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
+int parallel_filtergraphs = 0;
 int64_t stats_period = 500000;
 
 
@@ -229,6 +240,7 @@ static void init_options(OptionsContext *o)
     o->chapters_input_file = INT_MAX;
     o->accurate_seek  = 1;
     o->thread_queue_size = -1;
+    o->thread_queue_bytes = -1;
 }
 
 static int show_hwaccels(void *optctx, const char *opt, const char *arg)
@@ -790,7 +802,7 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         AVStream *st = ic->streams[i];
         AVCodecParameters *par = st->codecpar;
         InputStream *ist = av_mallocz(sizeof(*ist));
-        char *framerate = NULL, *hwaccel_device = NULL;
+        char *framerate = NULL, *hwaccel_device = NULL, *hwupload_device = NULL;
         const char *hwaccel = NULL;
         char *hwaccel_output_format = NULL;
         char *codec_tag = NULL;
@@ -835,6 +847,8 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         ist->reinit_filters = -1;
         MATCH_PER_STREAM_OPT(reinit_filters, i, ist->reinit_filters, ic, st);
 
+        MATCH_PER_STREAM_OPT(frame_cache_sizes, i64, ist->frame_cache_size, ic, st);
+
         MATCH_PER_STREAM_OPT(discard, str, discard_str, ic, st);
         ist->user_set_discard = AVDISCARD_NONE;
 
@@ -970,6 +984,13 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
                     exit_program(1);
             }
 
+            MATCH_PER_STREAM_OPT(hwupload_devices, str, hwupload_device, ic, st);
+            if (hwupload_device) {
+                ist->hwupload_device = av_strdup(hwupload_device);
+                if (!ist->hwupload_device)
+                    exit_program(1);
+            }
+
             ist->hwaccel_pix_fmt = AV_PIX_FMT_NONE;
 
             break;
@@ -1082,20 +1103,36 @@ static void dump_attachment(AVStream *st, const char *filename)
     avio_close(out);
 }
 
-static int open_input_file(OptionsContext *o, const char *filename)
+/* An input file being opened. Its demuxer is opened and probed by
+ * open_input_files() on worker threads, the steps that may report errors
+ * and exit run on the main thread in the order of the inputs. */
+typedef struct InputFileOpen {
+    OptionsContext o;
+    const char *filename;
+    AVFormatContext *ic;
+    const AVInputFormat *iformat;
+    int scan_all_pmts_set;
+    int find_stream_info;
+    AVDictionary **stream_opts;
+    int orig_nb_streams;
+    int ret;
+#if HAVE_THREADS
+    pthread_t thread;
+    int threaded;
+#endif
+} InputFileOpen;
+
+/* Set up the demuxer context of an input file from its options. */
+static void open_input_file_setup(InputFileOpen *in)
 {
-    InputFile *f;
+    OptionsContext *o = &in->o;
+    const char *filename = in->filename;
     AVFormatContext *ic;
     const AVInputFormat *file_iformat = NULL;
-    int err, i, ret;
-    int64_t timestamp;
-    AVDictionary *unused_opts = NULL;
-    const AVDictionaryEntry *e = NULL;
     char *   video_codec_name = NULL;
     char *   audio_codec_name = NULL;
     char *subtitle_codec_name = NULL;
     char *    data_codec_name = NULL;
-    int scan_all_pmts_set = 0;
 
     if (o->stop_time != INT64_MAX && o->recording_time != INT64_MAX) {
         o->stop_time = INT64_MAX;
@@ -1120,7 +1157,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
     }
 
     if (!strcmp(filename, "-"))
-        filename = "pipe:";
+        filename = in->filename = "pipe:";
 
     stdin_interaction &= strncmp(filename, "pipe:", 5) &&
                          strcmp(filename, "/dev/stdin");
@@ -1188,17 +1225,38 @@ static int open_input_file(OptionsContext *o, const char *filename)
 
     if (!av_dict_get(o->g->format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
         av_dict_set(&o->g->format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
-        scan_all_pmts_set = 1;
+        in->scan_all_pmts_set = 1;
     }
-    /* open the input file with generic avformat function */
-    err = avformat_open_input(&ic, filename, file_iformat, &o->g->format_opts);
+
+    in->ic               = ic;
+    in->iformat          = file_iformat;
+    in->find_stream_info = find_stream_info;
+}
+
+static void *open_input_file_open(void *arg)
+{
+    InputFileOpen *in = arg;
+
+    in->ret = avformat_open_input(&in->ic, in->filename, in->iformat,
+                                  &in->o.g->format_opts);
+    return NULL;
+}
+
+/* Check the opened input file and prepare its probing. */
+static void open_input_file_opened(InputFileOpen *in)
+{
+    OptionsContext *o = &in->o;
+    const char *filename = in->filename;
+    AVFormatContext *ic = in->ic;
+    int err = in->ret, i;
+
     if (err < 0) {
         print_error(filename, err);
         if (err == AVERROR_PROTOCOL_NOT_FOUND)
             av_log(NULL, AV_LOG_ERROR, "Did you mean file:%s?\n", filename);
         exit_program(1);
     }
-    if (scan_all_pmts_set)
+    if (in->scan_all_pmts_set)
         av_dict_set(&o->g->format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
     remove_avoptions(&o->g->format_opts, o->g->codec_opts);
     assert_avoptions(o->g->format_opts);
@@ -1207,24 +1265,48 @@ static int open_input_file(OptionsContext *o, const char *filename)
     for (i = 0; i < ic->nb_streams; i++)
         choose_decoder(o, ic, ic->streams[i]);
 
-    if (find_stream_info) {
-        AVDictionary **opts = setup_find_stream_info_opts(ic, o->g->codec_opts);
-        int orig_nb_streams = ic->nb_streams;
+    if (in->find_stream_info) {
+        in->stream_opts     = setup_find_stream_info_opts(ic, o->g->codec_opts);
+        in->orig_nb_streams = ic->nb_streams;
+    }
+}
 
-        /* If not enough info to get the stream parameters, we decode the
-           first frames to get it. (used in mpeg case for example) */
-        ret = avformat_find_stream_info(ic, opts);
+static void *open_input_file_probe(void *arg)
+{
+    InputFileOpen *in = arg;
+    int i;
 
-        for (i = 0; i < orig_nb_streams; i++)
-            av_dict_free(&opts[i]);
-        av_freep(&opts);
+    if (!in->find_stream_info)
+        return NULL;
 
-        if (ret < 0) {
-            av_log(NULL, AV_LOG_FATAL, "%s: could not find codec parameters\n", filename);
-            if (ic->nb_streams == 0) {
-                avformat_close_input(&ic);
-                exit_program(1);
-            }
+    /* If not enough info to get the stream parameters, we decode the
+       first frames to get it. (used in mpeg case for example) */
+    in->ret = avformat_find_stream_info(in->ic, in->stream_opts);
+
+    for (i = 0; i < in->orig_nb_streams; i++)
+        av_dict_free(&in->stream_opts[i]);
+    av_freep(&in->stream_opts);
+
+    return NULL;
+}
+
+/* Set up the input streams of the probed input file. */
+static int open_input_file_finish(InputFileOpen *in)
+{
+    OptionsContext *o = &in->o;
+    const char *filename = in->filename;
+    AVFormatContext *ic = in->ic;
+    InputFile *f;
+    int i, ret;
+    int64_t timestamp;
+    AVDictionary *unused_opts = NULL;
+    const AVDictionaryEntry *e = NULL;
+
+    if (in->find_stream_info && in->ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "%s: could not find codec parameters\n", filename);
+        if (ic->nb_streams == 0) {
+            avformat_close_input(&ic);
+            exit_program(1);
         }
     }
 
@@ -1316,6 +1398,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
         exit_program(1);
 #if HAVE_THREADS
     f->thread_queue_size = o->thread_queue_size;
+    f->thread_queue_bytes = o->thread_queue_bytes;
 #endif
 
     /* check if all codec options have been used */
@@ -1501,9 +1584,11 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
         exit_program(1);
     }
 
-    ost->filtered_frame = av_frame_alloc();
-    if (!ost->filtered_frame)
-        exit_program(1);
+    for (i = 0; i < FF_ARRAY_ELEMS(ost->filtered_frames); i++) {
+        ost->filtered_frames[i] = av_frame_alloc();
+        if (!ost->filtered_frames[i])
+            exit_program(1);
+    }
 
     ost->pkt = av_packet_alloc();
     if (!ost->pkt)
@@ -2289,6 +2374,8 @@ static int open_output_file(OptionsContext *o, const char *filename)
     of->start_time     = o->start_time;
     of->limit_filesize = o->limit_filesize;
     of->shortest       = o->shortest;
+    of->thread_queue_size = FFMAX(o->thread_queue_size, 0);
+    of->first_packet_usec = -1;
     av_dict_copy(&of->opts, o->g->format_opts, 0);
 
     if (!strcmp(filename, "-"))
@@ -3065,6 +3152,29 @@ static int opt_vstats_file(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_trace_events(void *optctx, const char *opt, const char *arg)
+{
+    int ret = av_trace_start(0);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot record trace events: %s\n", av_err2str(ret));
+        return ret;
+    }
+    av_free(trace_events_filename);
+    trace_events_filename = av_strdup(arg);
+    return trace_events_filename ? 0 : AVERROR(ENOMEM);
+}
+
+static int opt_memory_accounting(void *optctx, const char *opt, const char *arg)
+{
+    int ret = av_mem_accounting_start();
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot account memory: %s\n", av_err2str(ret));
+        return ret;
+    }
+    memory_accounting = 1;
+    return 0;
+}
+
 static int opt_vstats(void *optctx, const char *opt, const char *arg)
 {
     char filename[40];
@@ -3459,6 +3569,86 @@ static int open_files(OptionGroupList *l, const char *inout,
     return 0;
 }
 
+/* Run func for all the input files, on a thread each when there are several
+ * and on the calling thread for those whose thread cannot be created. */
+static void run_input_file_jobs(InputFileOpen *in, int nb_in, void *(*func)(void *))
+{
+    int i;
+
+#if HAVE_THREADS
+    for (i = 0; i < nb_in; i++)
+        in[i].threaded = nb_in > 1 && !pthread_create(&in[i].thread, NULL, func, &in[i]);
+    for (i = 0; i < nb_in; i++)
+        if (!in[i].threaded)
+            func(&in[i]);
+    for (i = 0; i < nb_in; i++)
+        if (in[i].threaded)
+            pthread_join(in[i].thread, NULL);
+#else
+    for (i = 0; i < nb_in; i++)
+        func(&in[i]);
+#endif
+}
+
+/* Open the input files concurrently. Options are parsed, and errors
+ * reported, in the order of the inputs as when opening them one by one. */
+static int open_input_files(OptionGroupList *l)
+{
+    InputFileOpen *in;
+    int i, nb_in = 0, ret = 0;
+
+    if (!l->nb_groups)
+        return 0;
+
+    in = av_calloc(l->nb_groups, sizeof(*in));
+    if (!in)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < l->nb_groups; i++) {
+        OptionGroup *g = &l->groups[i];
+        InputFileOpen *cur = &in[i];
+
+        init_options(&cur->o);
+        cur->o.g      = g;
+        cur->filename = g->arg;
+        nb_in++;
+
+        ret = parse_optgroup(&cur->o, g);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error parsing options for input file "
+                   "%s.\n", g->arg);
+            goto fail;
+        }
+
+        av_log(NULL, AV_LOG_DEBUG, "Opening an input file: %s.\n", g->arg);
+        open_input_file_setup(cur);
+    }
+
+    run_input_file_jobs(in, nb_in, open_input_file_open);
+    for (i = 0; i < nb_in; i++)
+        open_input_file_opened(&in[i]);
+
+    run_input_file_jobs(in, nb_in, open_input_file_probe);
+    for (i = 0; i < nb_in; i++) {
+        ret = open_input_file_finish(&in[i]);
+        in[i].ic = NULL;
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error opening input file %s.\n",
+                   l->groups[i].arg);
+            goto fail;
+        }
+        av_log(NULL, AV_LOG_DEBUG, "Successfully opened the file.\n");
+    }
+
+fail:
+    for (i = 0; i < nb_in; i++) {
+        avformat_free_context(in[i].ic);
+        uninit_options(&in[i].o);
+    }
+    av_free(in);
+    return ret;
+}
+
 int ffmpeg_parse_options(int argc, char **argv)
 {
     OptionParseContext octx;
@@ -3486,7 +3676,7 @@ int ffmpeg_parse_options(int argc, char **argv)
     term_init();
 
     /* open input files */
-    ret = open_files(&octx.groups[GROUP_INFILE], "input", open_input_file);
+    ret = open_input_files(&octx.groups[GROUP_INFILE]);
     if (ret < 0) {
         av_log(NULL, AV_LOG_FATAL, "Error opening input files: ");
         goto fail;
@@ -3692,14 +3882,30 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_complex_branch_threads", HAS_ARG | OPT_INT | OPT_EXPERT, { &filter_complex_branch_nbthreads },
+        "number of threads running the independent branches of -filter_complex" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
     { "auto_conversion_filters", OPT_BOOL | OPT_EXPERT,              { &auto_conversion_filters },
         "enable automatic conversion filters globally" },
+    { "parallel_filtergraphs", OPT_BOOL | OPT_EXPERT,                { &parallel_filtergraphs },
+        "feed the filtergraphs of a decoded video stream in parallel" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
+    { "stats_json",     HAS_ARG | OPT_STRING | OPT_EXPERT,           { &stats_json_filename },
+        "write per-stage statistics in JSON to file", "file" },
+    { "metrics_listen", HAS_ARG | OPT_STRING | OPT_EXPERT,           { &metrics_listen },
+        "serve the metrics of the transcoding on the given HTTP URL", "url" },
+    { "trace_events",   HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_trace_events },
+        "write the spans of time spent in the processing stages as Chrome trace JSON to file", "file" },
+    { "memory_accounting", OPT_EXPERT,                               { .func_arg = opt_memory_accounting },
+        "print the memory allocated by each demuxer, codec, filter and muxer at exit" },
+    { "max_pipeline_memory", HAS_ARG | OPT_INT64 | OPT_EXPERT,       { &max_pipeline_memory },
+        "maximum size in bytes of the packets and frames queued between the threads", "size" },
+    { "stats_json_live", OPT_BOOL | OPT_EXPERT,                      { &stats_json_live },
+        "also write the JSON statistics at every progress report" },
     { "stats_period",    HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_stats_period },
         "set the period at which ffmpeg updates stats and -progress output", "time" },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
@@ -3720,9 +3926,12 @@ const OptionDef options[] = {
     { "disposition",    OPT_STRING | HAS_ARG | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(disposition) },
         "disposition", "" },
-    { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+    { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
-        "set the maximum number of queued packets from the demuxer" },
+        "set the maximum number of queued packets from the demuxer, or of queued frames to the encoder threads" },
+    { "thread_queue_bytes", HAS_ARG | OPT_INT64 | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+                                                                     { .off = OFFSET(thread_queue_bytes) },
+        "set the maximum size in bytes of the packets queued from the demuxer", "size" },
     { "find_stream_info", OPT_BOOL | OPT_PERFILE | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
 
@@ -3807,6 +4016,9 @@ const OptionDef options[] = {
     { "hwaccel_device",   OPT_VIDEO | OPT_STRING | HAS_ARG | OPT_EXPERT |
                           OPT_SPEC | OPT_INPUT,                                  { .off = OFFSET(hwaccel_devices) },
         "select a device for HW acceleration", "devicename" },
+    { "hwupload_device",  OPT_VIDEO | OPT_STRING | HAS_ARG | OPT_EXPERT |
+                          OPT_SPEC | OPT_INPUT,                                  { .off = OFFSET(hwupload_devices) },
+        "upload the decoded frames to a device", "devicename" },
     { "hwaccel_output_format", OPT_VIDEO | OPT_STRING | HAS_ARG | OPT_EXPERT |
                           OPT_SPEC | OPT_INPUT,                                  { .off = OFFSET(hwaccel_output_formats) },
         "select output format used with HW accelerated decoding", "format" },
@@ -3818,6 +4030,9 @@ const OptionDef options[] = {
     { "autorotate",       HAS_ARG | OPT_BOOL | OPT_SPEC |
                           OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(autorotate) },
         "automatically insert correct rotate filters" },
+    { "frame_cache",      OPT_VIDEO | HAS_ARG | OPT_INT64 | OPT_SPEC |
+                          OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(frame_cache_sizes) },
+        "reuse the decoded frames of repeated packets, caching up to size bytes of frames", "size" },
     { "autoscale",        HAS_ARG | OPT_BOOL | OPT_SPEC |
                           OPT_EXPERT | OPT_OUTPUT,                               { .off = OFFSET(autoscale) },
         "automatically insert a scale filter at the end of the filter graph" },
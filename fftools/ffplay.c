@@ -73,6 +73,9 @@ const int program_birth_year = 2003;
 /* Calculate actual buffer size keeping in mind not cause too frequent audio callbacks */
 #define SDL_AUDIO_MAX_CALLBACKS_PER_SEC 30
 
+/* seeks closer together than this are handled as scrubbing */
+#define SCRUB_INTERVAL 300000
+
 /* Step size for volume control in dB */
 #define SDL_VOLUME_STEP (0.75)
 
@@ -211,6 +214,11 @@ typedef struct VideoState {
     int seek_flags;
     int64_t seek_pos;
     int64_t seek_rel;
+    int seek_exact;
+    double exact_seek_pts;
+    int exact_seek_serial;
+    int scrubbing;
+    int64_t last_seek_time;
     int read_pause_return;
     AVFormatContext *ic;
     int realtime;
@@ -332,6 +340,8 @@ static int64_t duration = AV_NOPTS_VALUE;
 static int fast = 0;
 static int genpts = 0;
 static int lowres = 0;
+static int accurate_seek = 0;
+static int scrub_lowres = 0;
 static int decoder_reorder_pts = -1;
 static int autoexit;
 static int exit_on_keydown;
@@ -1467,12 +1477,34 @@ static void check_external_clock_speed(VideoState *is) {
    }
 }
 
+static int stream_component_open(VideoState *is, int stream_index);
+
+/* reopen the video decoder, e.g. to change its resolution */
+static void reopen_video_decoder(VideoState *is)
+{
+    int stream_index = is->video_stream;
+
+    if (stream_index < 0)
+        return;
+    stream_component_close(is, stream_index);
+    stream_component_open(is, stream_index);
+}
+
 /* seek in the stream */
-static void stream_seek(VideoState *is, int64_t pos, int64_t rel, int seek_by_bytes)
+static void stream_seek(VideoState *is, int64_t pos, int64_t rel, int seek_by_bytes, int exact)
 {
     if (!is->seek_req) {
+        if (scrub_lowres && !seek_by_bytes && is->video_st) {
+            int64_t now = av_gettime_relative();
+            if (!is->scrubbing && now - is->last_seek_time < SCRUB_INTERVAL) {
+                is->scrubbing = 1;
+                reopen_video_decoder(is);
+            }
+            is->last_seek_time = now;
+        }
         is->seek_pos = pos;
         is->seek_rel = rel;
+        is->seek_exact = exact && !seek_by_bytes && !is->scrubbing;
         is->seek_flags &= ~AVSEEK_FLAG_BYTE;
         if (seek_by_bytes)
             is->seek_flags |= AVSEEK_FLAG_BYTE;
@@ -1481,6 +1513,17 @@ static void stream_seek(VideoState *is, int64_t pos, int64_t rel, int seek_by_by
     }
 }
 
+/* go back to full resolution decoding once the scrubbing is over */
+static void check_scrubbing_end(VideoState *is)
+{
+    if (!is->scrubbing || is->seek_req ||
+        av_gettime_relative() - is->last_seek_time < SCRUB_INTERVAL)
+        return;
+    is->scrubbing = 0;
+    reopen_video_decoder(is);
+    stream_seek(is, is->seek_pos, 0, 0, 1);
+}
+
 /* pause or resume the video */
 static void stream_toggle_pause(VideoState *is)
 {
@@ -1521,6 +1564,22 @@ static void step_to_next_frame(VideoState *is)
     is->step = 1;
 }
 
+static void step_to_previous_frame(VideoState *is)
+{
+    Frame *vp;
+
+    if (!is->video_st || !is->pictq.rindex_shown || seek_by_bytes || is->seek_req)
+        return;
+    vp = frame_queue_peek_last(&is->pictq);
+    if (isnan(vp->pts) || vp->duration <= 0)
+        return;
+    /* the read thread steps to the frame once the seek is done */
+    if (!is->paused)
+        toggle_pause(is);
+    stream_seek(is, (int64_t)((vp->pts - vp->duration) * AV_TIME_BASE),
+                -(int64_t)(vp->duration * AV_TIME_BASE), 0, 1);
+}
+
 static double compute_target_delay(double delay, VideoState *is)
 {
     double sync_threshold, diff = 0;
@@ -1785,6 +1844,16 @@ static int get_video_frame(VideoState *is, AVFrame *frame)
 
         frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
 
+        if (is->viddec.pkt_serial == is->exact_seek_serial && !isnan(dpts)) {
+            AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, frame);
+            double duration = frame_rate.num && frame_rate.den ? av_q2d(av_inv_q(frame_rate)) : 0;
+            /* drop the frames which end before the seek target */
+            if (dpts + duration <= is->exact_seek_pts + 0.0001) {
+                av_frame_unref(frame);
+                return 0;
+            }
+        }
+
         if (framedrop>0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
             if (frame->pts != AV_NOPTS_VALUE) {
                 double diff = dpts - get_master_clock(is);
@@ -2617,6 +2686,8 @@ static int stream_component_open(VideoState *is, int stream_index)
                 codec->max_lowres);
         stream_lowres = codec->max_lowres;
     }
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && is->scrubbing)
+        stream_lowres = FFMAX(stream_lowres, FFMIN(scrub_lowres, codec->max_lowres));
     avctx->lowres = stream_lowres;
 
     if (fast)
@@ -2967,8 +3038,14 @@ static int read_thread(void *arg)
                     packet_queue_flush(&is->audioq);
                 if (is->subtitle_stream >= 0)
                     packet_queue_flush(&is->subtitleq);
-                if (is->video_stream >= 0)
+                if (is->video_stream >= 0) {
+                    /* the frames before the target are dropped by the video
+                     * thread, the serial is set before the flush so that it
+                     * is visible with the first packet of the new serial */
+                    is->exact_seek_pts    = seek_target / (double)AV_TIME_BASE;
+                    is->exact_seek_serial = is->seek_exact ? is->videoq.serial + 1 : -1;
                     packet_queue_flush(&is->videoq);
+                }
                 if (is->seek_flags & AVSEEK_FLAG_BYTE) {
                    set_clock(&is->extclk, NAN, 0);
                 } else {
@@ -3007,7 +3084,7 @@ static int read_thread(void *arg)
             (!is->audio_st || (is->auddec.finished == is->audioq.serial && frame_queue_nb_remaining(&is->sampq) == 0)) &&
             (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0))) {
             if (loop != 1 && (!loop || --loop)) {
-                stream_seek(is, start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0);
+                stream_seek(is, start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0, 0);
             } else if (autoexit) {
                 ret = AVERROR_EOF;
                 goto fail;
@@ -3083,6 +3160,7 @@ static VideoState *stream_open(const char *filename,
     if (!is)
         return NULL;
     is->last_video_stream = is->video_stream = -1;
+    is->exact_seek_serial = -1;
     is->last_audio_stream = is->audio_stream = -1;
     is->last_subtitle_stream = is->subtitle_stream = -1;
     is->filename = av_strdup(filename);
@@ -3241,6 +3319,7 @@ static void refresh_loop_wait_event(VideoState *is, SDL_Event *event) {
         if (remaining_time > 0.0)
             av_usleep((int64_t)(remaining_time * 1000000.0));
         remaining_time = REFRESH_RATE;
+        check_scrubbing_end(is);
         if (is->show_mode != SHOW_MODE_NONE && (!is->paused || is->force_refresh))
             video_refresh(is, &remaining_time);
         SDL_PumpEvents();
@@ -3271,7 +3350,7 @@ static void seek_chapter(VideoState *is, int incr)
 
     av_log(NULL, AV_LOG_VERBOSE, "Seeking to chapter %d.\n", i);
     stream_seek(is, av_rescale_q(is->ic->chapters[i]->start, is->ic->chapters[i]->time_base,
-                                 AV_TIME_BASE_Q), 0, 0);
+                                 AV_TIME_BASE_Q), 0, 0, accurate_seek);
 }
 
 /* handle an event sent by the GUI */
@@ -3315,6 +3394,9 @@ static void event_loop(VideoState *cur_stream)
             case SDLK_s: // S: Step to next frame
                 step_to_next_frame(cur_stream);
                 break;
+            case SDLK_COMMA: // ,: Step to previous frame
+                step_to_previous_frame(cur_stream);
+                break;
             case SDLK_a:
                 stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
                 break;
@@ -3381,7 +3463,7 @@ static void event_loop(VideoState *cur_stream)
                         else
                             incr *= 180000.0;
                         pos += incr;
-                        stream_seek(cur_stream, pos, incr, 1);
+                        stream_seek(cur_stream, pos, incr, 1, 0);
                     } else {
                         pos = get_master_clock(cur_stream);
                         if (isnan(pos))
@@ -3389,7 +3471,7 @@ static void event_loop(VideoState *cur_stream)
                         pos += incr;
                         if (cur_stream->ic->start_time != AV_NOPTS_VALUE && pos < cur_stream->ic->start_time / (double)AV_TIME_BASE)
                             pos = cur_stream->ic->start_time / (double)AV_TIME_BASE;
-                        stream_seek(cur_stream, (int64_t)(pos * AV_TIME_BASE), (int64_t)(incr * AV_TIME_BASE), 0);
+                        stream_seek(cur_stream, (int64_t)(pos * AV_TIME_BASE), (int64_t)(incr * AV_TIME_BASE), 0, accurate_seek);
                     }
                 break;
             default:
@@ -3428,7 +3510,7 @@ static void event_loop(VideoState *cur_stream)
             }
                 if (seek_by_bytes || cur_stream->ic->duration <= 0) {
                     uint64_t size =  avio_size(cur_stream->ic->pb);
-                    stream_seek(cur_stream, size*x/cur_stream->width, 0, 1);
+                    stream_seek(cur_stream, size*x/cur_stream->width, 0, 1, 0);
                 } else {
                     int64_t ts;
                     int ns, hh, mm, ss;
@@ -3448,7 +3530,7 @@ static void event_loop(VideoState *cur_stream)
                     ts = frac * cur_stream->ic->duration;
                     if (cur_stream->ic->start_time != AV_NOPTS_VALUE)
                         ts += cur_stream->ic->start_time;
-                    stream_seek(cur_stream, ts, 0, 0);
+                    stream_seek(cur_stream, ts, 0, 0, accurate_seek);
                 }
             break;
         case SDL_WINDOWEVENT:
@@ -3608,6 +3690,8 @@ static const OptionDef options[] = {
     { "genpts", OPT_BOOL | OPT_EXPERT, { &genpts }, "generate pts", "" },
     { "drp", OPT_INT | HAS_ARG | OPT_EXPERT, { &decoder_reorder_pts }, "let decoder reorder pts 0=off 1=on -1=auto", ""},
     { "lowres", OPT_INT | HAS_ARG | OPT_EXPERT, { &lowres }, "", "" },
+    { "accurate_seek", OPT_BOOL, { &accurate_seek }, "decode up to the exact seek position" },
+    { "scrub_lowres", OPT_INT | HAS_ARG | OPT_EXPERT, { &scrub_lowres }, "lower the video decoding resolution while scrubbing", "n" },
     { "sync", HAS_ARG | OPT_EXPERT, { .func_arg = opt_sync }, "set audio-video sync. type (type=audio/video/ext)", "type" },
     { "autoexit", OPT_BOOL | OPT_EXPERT, { &autoexit }, "exit at the end", "" },
     { "exitonkeydown", OPT_BOOL | OPT_EXPERT, { &exit_on_keydown }, "exit on key down", "" },
@@ -26,6 +26,7 @@
 #include "config.h"
 #include "libavutil/ffversion.h"
 
+#include <stdarg.h>
 #include <string.h>
 
 #include "libavformat/avformat.h"
@@ -87,6 +88,7 @@ const int program_birth_year = 2007;
 static int do_bitexact = 0;
 static int do_count_frames = 0;
 static int do_count_packets = 0;
+static int do_count_from_index = 0;
 static int do_read_frames  = 0;
 static int do_read_packets = 0;
 static int do_show_chapters = 0;
@@ -289,6 +291,14 @@ static const char unit_bit_per_second_str[] = "bit/s";
 static int nb_streams;
 static uint64_t *nb_streams_packets;
 static uint64_t *nb_streams_frames;
+
+typedef struct IndexStats {
+    uint64_t nb_entries;
+    int64_t min_size, max_size, total_size;
+} IndexStats;
+
+/* streams counted from the index of the demuxer, only set with -count_from_index */
+static IndexStats *index_stats;
 static int *selected_streams;
 
 #if HAVE_THREADS
@@ -482,8 +492,110 @@ struct WriterContext {
     int string_validation;
     char *string_validation_replacement;
     unsigned int string_validation_utf8_flags;
+
+    char *outbuf;                   ///< output not yet written to stdout
+    size_t outbuf_len;
 };
 
+/* Writers format their output into a large buffer of the context, which is
+ * written to stdout when it is full, rather than through many small stdio
+ * calls. */
+#define WRITER_OUTBUF_SIZE (1 << 20)
+
+static void writer_flush(WriterContext *wctx)
+{
+    if (wctx->outbuf_len) {
+        fwrite(wctx->outbuf, 1, wctx->outbuf_len, stdout);
+        wctx->outbuf_len = 0;
+    }
+}
+
+static inline void writer_write(WriterContext *wctx, const char *data, size_t size)
+{
+    if (size > WRITER_OUTBUF_SIZE - wctx->outbuf_len) {
+        writer_flush(wctx);
+        if (size > WRITER_OUTBUF_SIZE) {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+    }
+    memcpy(wctx->outbuf + wctx->outbuf_len, data, size);
+    wctx->outbuf_len += size;
+}
+
+static inline void writer_w8(WriterContext *wctx, int c)
+{
+    if (wctx->outbuf_len == WRITER_OUTBUF_SIZE)
+        writer_flush(wctx);
+    wctx->outbuf[wctx->outbuf_len++] = c;
+}
+
+static inline void writer_put_str(WriterContext *wctx, const char *str)
+{
+    writer_write(wctx, str, strlen(str));
+}
+
+static void writer_put_spaces(WriterContext *wctx, int n)
+{
+    static const char spaces[] = "                                ";
+
+    for (; n > 0; n -= sizeof(spaces) - 1)
+        writer_write(wctx, spaces, FFMIN(n, sizeof(spaces) - 1));
+}
+
+/**
+ * Format an integer in decimal into buf, which must hold at least 21 bytes,
+ * and return the length of the string.
+ */
+static int format_int(char *buf, long long int val)
+{
+    char tmp[20];
+    unsigned long long u = val < 0 ? -(unsigned long long)val : val;
+    int n = 0, len = 0;
+
+    do {
+        tmp[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (val < 0)
+        buf[len++] = '-';
+    while (n)
+        buf[len++] = tmp[--n];
+    buf[len] = 0;
+    return len;
+}
+
+static inline void writer_put_int(WriterContext *wctx, long long int val)
+{
+    char buf[21];
+    writer_write(wctx, buf, format_int(buf, val));
+}
+
+static void writer_printf(WriterContext *wctx, const char *fmt, ...)
+{
+    size_t left = WRITER_OUTBUF_SIZE - wctx->outbuf_len;
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(wctx->outbuf + wctx->outbuf_len, left, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if (n >= left) {
+        AVBPrint bp;
+
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        va_start(ap, fmt);
+        av_vbprintf(&bp, fmt, ap);
+        va_end(ap);
+        writer_write(wctx, bp.str, bp.len);
+        av_bprint_finalize(&bp, NULL);
+        return;
+    }
+    wctx->outbuf_len += n;
+}
+
 static const char *writer_get_name(void *p)
 {
     WriterContext *wctx = p;
@@ -530,6 +642,10 @@ static void writer_close(WriterContext **wctx)
 
     if ((*wctx)->writer->uninit)
         (*wctx)->writer->uninit(*wctx);
+    if ((*wctx)->outbuf) {
+        writer_flush(*wctx);
+        av_freep(&(*wctx)->outbuf);
+    }
     for (i = 0; i < SECTION_MAX_NB_LEVELS; i++)
         av_bprint_finalize(&(*wctx)->section_pbuf[i], NULL);
     if ((*wctx)->writer->priv_class)
@@ -563,6 +679,11 @@ static int writer_open(WriterContext **wctx, const Writer *writer, const char *a
         goto fail;
     }
 
+    if (!((*wctx)->outbuf = av_malloc(WRITER_OUTBUF_SIZE))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
     (*wctx)->class = &writer_class;
     (*wctx)->writer = writer;
     (*wctx)->level = -1;
@@ -786,10 +907,12 @@ static inline int writer_print_string(WriterContext *wctx,
 static inline void writer_print_rational(WriterContext *wctx,
                                          const char *key, AVRational q, char sep)
 {
-    AVBPrint buf;
-    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
-    av_bprintf(&buf, "%d%c%d", q.num, sep, q.den);
-    writer_print_string(wctx, key, buf.str, 0);
+    char buf[24];
+    int len = format_int(buf, q.num);
+
+    buf[len++] = sep;
+    format_int(buf + len, q.den);
+    writer_print_string(wctx, key, buf, 0);
 }
 
 static void writer_print_time(WriterContext *wctx, const char *key,
@@ -981,7 +1104,7 @@ static void default_print_section_header(WriterContext *wctx)
         return;
 
     if (!(section->flags & (SECTION_FLAG_IS_WRAPPER|SECTION_FLAG_IS_ARRAY)))
-        printf("[%s]\n", upcase_string(buf, sizeof(buf), section->name));
+        writer_printf(wctx, "[%s]\n", upcase_string(buf, sizeof(buf), section->name));
 }
 
 static void default_print_section_footer(WriterContext *wctx)
@@ -994,25 +1117,33 @@ static void default_print_section_footer(WriterContext *wctx)
         return;
 
     if (!(section->flags & (SECTION_FLAG_IS_WRAPPER|SECTION_FLAG_IS_ARRAY)))
-        printf("[/%s]\n", upcase_string(buf, sizeof(buf), section->name));
+        writer_printf(wctx, "[/%s]\n", upcase_string(buf, sizeof(buf), section->name));
 }
 
 static void default_print_str(WriterContext *wctx, const char *key, const char *value)
 {
     DefaultContext *def = wctx->priv;
 
-    if (!def->nokey)
-        printf("%s%s=", wctx->section_pbuf[wctx->level].str, key);
-    printf("%s\n", value);
+    if (!def->nokey) {
+        writer_put_str(wctx, wctx->section_pbuf[wctx->level].str);
+        writer_put_str(wctx, key);
+        writer_w8(wctx, '=');
+    }
+    writer_put_str(wctx, value);
+    writer_w8(wctx, '\n');
 }
 
 static void default_print_int(WriterContext *wctx, const char *key, long long int value)
 {
     DefaultContext *def = wctx->priv;
 
-    if (!def->nokey)
-        printf("%s%s=", wctx->section_pbuf[wctx->level].str, key);
-    printf("%lld\n", value);
+    if (!def->nokey) {
+        writer_put_str(wctx, wctx->section_pbuf[wctx->level].str);
+        writer_put_str(wctx, key);
+        writer_w8(wctx, '=');
+    }
+    writer_put_int(wctx, value);
+    writer_w8(wctx, '\n');
 }
 
 static const Writer default_writer = {
@@ -1151,11 +1282,11 @@ static void compact_print_section_header(WriterContext *wctx)
         if (parent_section && compact->has_nested_elems[wctx->level-1] &&
             (section->flags & SECTION_FLAG_IS_ARRAY)) {
             compact->terminate_line[wctx->level-1] = 0;
-            printf("\n");
+            writer_printf(wctx, "\n");
         }
         if (compact->print_section &&
             !(section->flags & (SECTION_FLAG_IS_WRAPPER|SECTION_FLAG_IS_ARRAY)))
-            printf("%s%c", section->name, compact->item_sep);
+            writer_printf(wctx, "%s%c", section->name, compact->item_sep);
     }
 }
 
@@ -1166,7 +1297,7 @@ static void compact_print_section_footer(WriterContext *wctx)
     if (!compact->nested_section[wctx->level] &&
         compact->terminate_line[wctx->level] &&
         !(wctx->section[wctx->level]->flags & (SECTION_FLAG_IS_WRAPPER|SECTION_FLAG_IS_ARRAY)))
-        printf("\n");
+        writer_printf(wctx, "\n");
 }
 
 static void compact_print_str(WriterContext *wctx, const char *key, const char *value)
@@ -1174,11 +1305,14 @@ static void compact_print_str(WriterContext *wctx, const char *key, const char *
     CompactContext *compact = wctx->priv;
     AVBPrint buf;
 
-    if (wctx->nb_item[wctx->level]) printf("%c", compact->item_sep);
-    if (!compact->nokey)
-        printf("%s%s=", wctx->section_pbuf[wctx->level].str, key);
+    if (wctx->nb_item[wctx->level]) writer_w8(wctx, compact->item_sep);
+    if (!compact->nokey) {
+        writer_put_str(wctx, wctx->section_pbuf[wctx->level].str);
+        writer_put_str(wctx, key);
+        writer_w8(wctx, '=');
+    }
     av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-    printf("%s", compact->escape_str(&buf, value, compact->item_sep, wctx));
+    writer_put_str(wctx, compact->escape_str(&buf, value, compact->item_sep, wctx));
     av_bprint_finalize(&buf, NULL);
 }
 
@@ -1186,10 +1320,13 @@ static void compact_print_int(WriterContext *wctx, const char *key, long long in
 {
     CompactContext *compact = wctx->priv;
 
-    if (wctx->nb_item[wctx->level]) printf("%c", compact->item_sep);
-    if (!compact->nokey)
-        printf("%s%s=", wctx->section_pbuf[wctx->level].str, key);
-    printf("%lld", value);
+    if (wctx->nb_item[wctx->level]) writer_w8(wctx, compact->item_sep);
+    if (!compact->nokey) {
+        writer_put_str(wctx, wctx->section_pbuf[wctx->level].str);
+        writer_put_str(wctx, key);
+        writer_w8(wctx, '=');
+    }
+    writer_put_int(wctx, value);
 }
 
 static const Writer compact_writer = {
@@ -1332,7 +1469,7 @@ static void flat_print_section_header(WriterContext *wctx)
 
 static void flat_print_int(WriterContext *wctx, const char *key, long long int value)
 {
-    printf("%s%s=%lld\n", wctx->section_pbuf[wctx->level].str, key, value);
+    writer_printf(wctx, "%s%s=%lld\n", wctx->section_pbuf[wctx->level].str, key, value);
 }
 
 static void flat_print_str(WriterContext *wctx, const char *key, const char *value)
@@ -1340,11 +1477,11 @@ static void flat_print_str(WriterContext *wctx, const char *key, const char *val
     FlatContext *flat = wctx->priv;
     AVBPrint buf;
 
-    printf("%s", wctx->section_pbuf[wctx->level].str);
+    writer_printf(wctx, "%s", wctx->section_pbuf[wctx->level].str);
     av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-    printf("%s=", flat_escape_key_str(&buf, key, flat->sep));
+    writer_printf(wctx, "%s=", flat_escape_key_str(&buf, key, flat->sep));
     av_bprint_clear(&buf);
-    printf("\"%s\"\n", flat_escape_value_str(&buf, value));
+    writer_printf(wctx, "\"%s\"\n", flat_escape_value_str(&buf, value));
     av_bprint_finalize(&buf, NULL);
 }
 
@@ -1414,12 +1551,12 @@ static void ini_print_section_header(WriterContext *wctx)
 
     av_bprint_clear(buf);
     if (!parent_section) {
-        printf("# ffprobe output\n\n");
+        writer_printf(wctx, "# ffprobe output\n\n");
         return;
     }
 
     if (wctx->nb_item[wctx->level-1])
-        printf("\n");
+        writer_printf(wctx, "\n");
 
     av_bprintf(buf, "%s", wctx->section_pbuf[wctx->level-1].str);
     if (ini->hierarchical ||
@@ -1434,7 +1571,7 @@ static void ini_print_section_header(WriterContext *wctx)
     }
 
     if (!(section->flags & (SECTION_FLAG_IS_ARRAY|SECTION_FLAG_IS_WRAPPER)))
-        printf("[%s]\n", buf->str);
+        writer_printf(wctx, "[%s]\n", buf->str);
 }
 
 static void ini_print_str(WriterContext *wctx, const char *key, const char *value)
@@ -1442,15 +1579,15 @@ static void ini_print_str(WriterContext *wctx, const char *key, const char *valu
     AVBPrint buf;
 
     av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-    printf("%s=", ini_escape_str(&buf, key));
+    writer_printf(wctx, "%s=", ini_escape_str(&buf, key));
     av_bprint_clear(&buf);
-    printf("%s\n", ini_escape_str(&buf, value));
+    writer_printf(wctx, "%s\n", ini_escape_str(&buf, value));
     av_bprint_finalize(&buf, NULL);
 }
 
 static void ini_print_int(WriterContext *wctx, const char *key, long long int value)
 {
-    printf("%s=%lld\n", key, value);
+    writer_printf(wctx, "%s=%lld\n", key, value);
 }
 
 static const Writer ini_writer = {
@@ -1493,63 +1630,76 @@ static av_cold int json_init(WriterContext *wctx)
     return 0;
 }
 
-static const char *json_escape_str(AVBPrint *dst, const char *src, void *log_ctx)
+/**
+ * Write a JSON string literal. The runs of characters which need no escaping,
+ * which are most keys and values, are copied as a whole.
+ */
+static void json_put_str(WriterContext *wctx, const char *src)
 {
     static const char json_escape[] = {'"', '\\', '\b', '\f', '\n', '\r', '\t', 0};
     static const char json_subst[]  = {'"', '\\',  'b',  'f',  'n',  'r',  't', 0};
-    const char *p;
+    const char *p = src;
 
-    for (p = src; *p; p++) {
-        char *s = strchr(json_escape, *p);
+    writer_w8(wctx, '"');
+    while (1) {
+        const char *start = p, *s;
+
+        while ((unsigned char)*p >= 32 && *p != '"' && *p != '\\')
+            p++;
+        writer_write(wctx, start, p - start);
+        if (!*p)
+            break;
+
+        s = strchr(json_escape, *p);
         if (s) {
-            av_bprint_chars(dst, '\\', 1);
-            av_bprint_chars(dst, json_subst[s - json_escape], 1);
-        } else if ((unsigned char)*p < 32) {
-            av_bprintf(dst, "\\u00%02x", *p & 0xff);
+            writer_w8(wctx, '\\');
+            writer_w8(wctx, json_subst[s - json_escape]);
         } else {
-            av_bprint_chars(dst, *p, 1);
+            writer_printf(wctx, "\\u00%02x", *p & 0xff);
         }
+        p++;
     }
-    return dst->str;
+    writer_w8(wctx, '"');
 }
 
-#define JSON_INDENT() printf("%*c", json->indent_level * 4, ' ')
+#define JSON_INDENT() writer_put_spaces(wctx, json->indent_level * 4)
 
 static void json_print_section_header(WriterContext *wctx)
 {
     JSONContext *json = wctx->priv;
-    AVBPrint buf;
     const struct section *section = wctx->section[wctx->level];
     const struct section *parent_section = wctx->level ?
         wctx->section[wctx->level-1] : NULL;
 
     if (wctx->level && wctx->nb_item[wctx->level-1])
-        printf(",\n");
+        writer_put_str(wctx, ",\n");
 
     if (section->flags & SECTION_FLAG_IS_WRAPPER) {
-        printf("{\n");
+        writer_put_str(wctx, "{\n");
         json->indent_level++;
     } else {
-        av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-        json_escape_str(&buf, section->name, wctx);
         JSON_INDENT();
 
         json->indent_level++;
         if (section->flags & SECTION_FLAG_IS_ARRAY) {
-            printf("\"%s\": [\n", buf.str);
+            json_put_str(wctx, section->name);
+            writer_put_str(wctx, ": [\n");
         } else if (parent_section && !(parent_section->flags & SECTION_FLAG_IS_ARRAY)) {
-            printf("\"%s\": {%s", buf.str, json->item_start_end);
+            json_put_str(wctx, section->name);
+            writer_put_str(wctx, ": {");
+            writer_put_str(wctx, json->item_start_end);
         } else {
-            printf("{%s", json->item_start_end);
+            writer_w8(wctx, '{');
+            writer_put_str(wctx, json->item_start_end);
 
             /* this is required so the parser can distinguish between packets and frames */
             if (parent_section && parent_section->id == SECTION_ID_PACKETS_AND_FRAMES) {
                 if (!json->compact)
                     JSON_INDENT();
-                printf("\"type\": \"%s\"", section->name);
+                writer_put_str(wctx, "\"type\": ");
+                json_put_str(wctx, section->name);
             }
         }
-        av_bprint_finalize(&buf, NULL);
     }
 }
 
@@ -1560,61 +1710,47 @@ static void json_print_section_footer(WriterContext *wctx)
 
     if (wctx->level == 0) {
         json->indent_level--;
-        printf("\n}\n");
+        writer_put_str(wctx, "\n}\n");
     } else if (section->flags & SECTION_FLAG_IS_ARRAY) {
-        printf("\n");
+        writer_w8(wctx, '\n');
         json->indent_level--;
         JSON_INDENT();
-        printf("]");
+        writer_w8(wctx, ']');
     } else {
-        printf("%s", json->item_start_end);
+        writer_put_str(wctx, json->item_start_end);
         json->indent_level--;
         if (!json->compact)
             JSON_INDENT();
-        printf("}");
+        writer_w8(wctx, '}');
     }
 }
 
-static inline void json_print_item_str(WriterContext *wctx,
-                                       const char *key, const char *value)
-{
-    AVBPrint buf;
-
-    av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-    printf("\"%s\":", json_escape_str(&buf, key,   wctx));
-    av_bprint_clear(&buf);
-    printf(" \"%s\"", json_escape_str(&buf, value, wctx));
-    av_bprint_finalize(&buf, NULL);
-}
-
-static void json_print_str(WriterContext *wctx, const char *key, const char *value)
+static void json_print_item_sep(WriterContext *wctx)
 {
     JSONContext *json = wctx->priv;
     const struct section *parent_section = wctx->level ?
         wctx->section[wctx->level-1] : NULL;
 
     if (wctx->nb_item[wctx->level] || (parent_section && parent_section->id == SECTION_ID_PACKETS_AND_FRAMES))
-        printf("%s", json->item_sep);
+        writer_put_str(wctx, json->item_sep);
     if (!json->compact)
         JSON_INDENT();
-    json_print_item_str(wctx, key, value);
 }
 
-static void json_print_int(WriterContext *wctx, const char *key, long long int value)
+static void json_print_str(WriterContext *wctx, const char *key, const char *value)
 {
-    JSONContext *json = wctx->priv;
-    const struct section *parent_section = wctx->level ?
-        wctx->section[wctx->level-1] : NULL;
-    AVBPrint buf;
-
-    if (wctx->nb_item[wctx->level] || (parent_section && parent_section->id == SECTION_ID_PACKETS_AND_FRAMES))
-        printf("%s", json->item_sep);
-    if (!json->compact)
-        JSON_INDENT();
+    json_print_item_sep(wctx);
+    json_put_str(wctx, key);
+    writer_put_str(wctx, ": ");
+    json_put_str(wctx, value);
+}
 
-    av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-    printf("\"%s\": %lld", json_escape_str(&buf, key, wctx), value);
-    av_bprint_finalize(&buf, NULL);
+static void json_print_int(WriterContext *wctx, const char *key, long long int value)
+{
+    json_print_item_sep(wctx);
+    json_put_str(wctx, key);
+    writer_put_str(wctx, ": ");
+    writer_put_int(wctx, value);
 }
 
 static const Writer json_writer = {
@@ -1629,6 +1765,85 @@ static const Writer json_writer = {
     .priv_class           = &json_class,
 };
 
+/* NDJSON output */
+
+/* Each object below the root, or each element of an array below the root,
+ * is a record written on a line of its own, with its section name as
+ * "type". */
+static int ndjson_is_record(WriterContext *wctx, int level)
+{
+    if (level == 1)
+        return !(wctx->section[1]->flags & SECTION_FLAG_IS_ARRAY);
+    return level == 2 && (wctx->section[1]->flags & SECTION_FLAG_IS_ARRAY);
+}
+
+static void ndjson_print_section_header(WriterContext *wctx)
+{
+    const struct section *section = wctx->section[wctx->level];
+    int level = wctx->level;
+
+    if (!level || (level == 1 && (section->flags & SECTION_FLAG_IS_ARRAY)))
+        return;
+
+    if (ndjson_is_record(wctx, level)) {
+        writer_put_str(wctx, "{\"type\": ");
+        json_put_str(wctx, section->name);
+        return;
+    }
+
+    if (wctx->nb_item[level-1] || ndjson_is_record(wctx, level-1))
+        writer_put_str(wctx, ", ");
+    if (wctx->section[level-1]->flags & SECTION_FLAG_IS_ARRAY) {
+        writer_w8(wctx, '{');
+    } else {
+        json_put_str(wctx, section->name);
+        writer_put_str(wctx, section->flags & SECTION_FLAG_IS_ARRAY ? ": [" : ": {");
+    }
+}
+
+static void ndjson_print_section_footer(WriterContext *wctx)
+{
+    const struct section *section = wctx->section[wctx->level];
+    int level = wctx->level;
+
+    if (!level || (level == 1 && (section->flags & SECTION_FLAG_IS_ARRAY)))
+        return;
+
+    if (ndjson_is_record(wctx, level))
+        writer_put_str(wctx, "}\n");
+    else
+        writer_w8(wctx, section->flags & SECTION_FLAG_IS_ARRAY ? ']' : '}');
+}
+
+static void ndjson_print_key(WriterContext *wctx, const char *key)
+{
+    if (wctx->nb_item[wctx->level] || ndjson_is_record(wctx, wctx->level))
+        writer_put_str(wctx, ", ");
+    json_put_str(wctx, key);
+    writer_put_str(wctx, ": ");
+}
+
+static void ndjson_print_str(WriterContext *wctx, const char *key, const char *value)
+{
+    ndjson_print_key(wctx, key);
+    json_put_str(wctx, value);
+}
+
+static void ndjson_print_int(WriterContext *wctx, const char *key, long long int value)
+{
+    ndjson_print_key(wctx, key);
+    writer_put_int(wctx, value);
+}
+
+static const Writer ndjson_writer = {
+    .name                 = "ndjson",
+    .print_section_header = ndjson_print_section_header,
+    .print_section_footer = ndjson_print_section_footer,
+    .print_integer        = ndjson_print_int,
+    .print_string         = ndjson_print_str,
+    .flags = WRITER_FLAG_PUT_PACKETS_AND_FRAMES_IN_SAME_CHAPTER,
+};
+
 /* XML output */
 
 typedef struct XMLContext {
@@ -1673,7 +1888,7 @@ static av_cold int xml_init(WriterContext *wctx)
     return 0;
 }
 
-#define XML_INDENT() printf("%*c", xml->indent_level * 4, ' ')
+#define XML_INDENT() writer_printf(wctx, "%*c", xml->indent_level * 4, ' ')
 
 static void xml_print_section_header(WriterContext *wctx)
 {
@@ -1687,8 +1902,8 @@ static void xml_print_section_header(WriterContext *wctx)
             "xmlns:ffprobe=\"http://www.ffmpeg.org/schema/ffprobe\" "
             "xsi:schemaLocation=\"http://www.ffmpeg.org/schema/ffprobe ffprobe.xsd\"";
 
-        printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-        printf("<%sffprobe%s>\n",
+        writer_printf(wctx, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        writer_printf(wctx, "<%sffprobe%s>\n",
                xml->fully_qualified ? "ffprobe:" : "",
                xml->fully_qualified ? qual : "");
         return;
@@ -1696,20 +1911,20 @@ static void xml_print_section_header(WriterContext *wctx)
 
     if (xml->within_tag) {
         xml->within_tag = 0;
-        printf(">\n");
+        writer_printf(wctx, ">\n");
     }
     if (section->flags & SECTION_FLAG_HAS_VARIABLE_FIELDS) {
         xml->indent_level++;
     } else {
         if (parent_section && (parent_section->flags & SECTION_FLAG_IS_WRAPPER) &&
             wctx->level && wctx->nb_item[wctx->level-1])
-            printf("\n");
+            writer_printf(wctx, "\n");
         xml->indent_level++;
 
         if (section->flags & SECTION_FLAG_IS_ARRAY) {
-            XML_INDENT(); printf("<%s>\n", section->name);
+            XML_INDENT(); writer_printf(wctx, "<%s>\n", section->name);
         } else {
-            XML_INDENT(); printf("<%s ", section->name);
+            XML_INDENT(); writer_printf(wctx, "<%s ", section->name);
             xml->within_tag = 1;
         }
     }
@@ -1721,15 +1936,15 @@ static void xml_print_section_footer(WriterContext *wctx)
     const struct section *section = wctx->section[wctx->level];
 
     if (wctx->level == 0) {
-        printf("</%sffprobe>\n", xml->fully_qualified ? "ffprobe:" : "");
+        writer_printf(wctx, "</%sffprobe>\n", xml->fully_qualified ? "ffprobe:" : "");
     } else if (xml->within_tag) {
         xml->within_tag = 0;
-        printf("/>\n");
+        writer_printf(wctx, "/>\n");
         xml->indent_level--;
     } else if (section->flags & SECTION_FLAG_HAS_VARIABLE_FIELDS) {
         xml->indent_level--;
     } else {
-        XML_INDENT(); printf("</%s>\n", section->name);
+        XML_INDENT(); writer_printf(wctx, "</%s>\n", section->name);
         xml->indent_level--;
     }
 }
@@ -1746,20 +1961,20 @@ static void xml_print_str(WriterContext *wctx, const char *key, const char *valu
         XML_INDENT();
         av_bprint_escape(&buf, key, NULL,
                          AV_ESCAPE_MODE_XML, AV_ESCAPE_FLAG_XML_DOUBLE_QUOTES);
-        printf("<%s key=\"%s\"",
+        writer_printf(wctx, "<%s key=\"%s\"",
                section->element_name, buf.str);
         av_bprint_clear(&buf);
 
         av_bprint_escape(&buf, value, NULL,
                          AV_ESCAPE_MODE_XML, AV_ESCAPE_FLAG_XML_DOUBLE_QUOTES);
-        printf(" value=\"%s\"/>\n", buf.str);
+        writer_printf(wctx, " value=\"%s\"/>\n", buf.str);
     } else {
         if (wctx->nb_item[wctx->level])
-            printf(" ");
+            writer_printf(wctx, " ");
 
         av_bprint_escape(&buf, value, NULL,
                          AV_ESCAPE_MODE_XML, AV_ESCAPE_FLAG_XML_DOUBLE_QUOTES);
-        printf("%s=\"%s\"", key, buf.str);
+        writer_printf(wctx, "%s=\"%s\"", key, buf.str);
     }
 
     av_bprint_finalize(&buf, NULL);
@@ -1768,8 +1983,8 @@ static void xml_print_str(WriterContext *wctx, const char *key, const char *valu
 static void xml_print_int(WriterContext *wctx, const char *key, long long int value)
 {
     if (wctx->nb_item[wctx->level])
-        printf(" ");
-    printf("%s=\"%lld\"", key, value);
+        writer_printf(wctx, " ");
+    writer_printf(wctx, "%s=\"%lld\"", key, value);
 }
 
 static Writer xml_writer = {
@@ -1798,6 +2013,7 @@ static void writer_register_all(void)
     writer_register(&flat_writer);
     writer_register(&ini_writer);
     writer_register(&json_writer);
+    writer_register(&ndjson_writer);
     writer_register(&xml_writer);
 }
 
@@ -2519,9 +2735,14 @@ static int read_interval_packets(WriterContext *w, InputFile *ifile,
             REALLOCZ_ARRAY_STREAM(nb_streams_frames,  nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(nb_streams_packets, nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(selected_streams,   nb_streams, fmt_ctx->nb_streams);
+            if (index_stats)
+                REALLOCZ_ARRAY_STREAM(index_stats,    nb_streams, fmt_ctx->nb_streams);
             nb_streams = fmt_ctx->nb_streams;
         }
-        if (selected_streams[pkt->stream_index]) {
+        /* packets buffered while probing the streams are returned whatever
+         * their discard setting */
+        if (selected_streams[pkt->stream_index] &&
+            !(index_stats && index_stats[pkt->stream_index].nb_entries)) {
             AVRational tb = ifile->streams[pkt->stream_index].st->time_base;
 
             if (pkt->pts != AV_NOPTS_VALUE)
@@ -2764,6 +2985,18 @@ static int show_stream(WriterContext *w, AVFormatContext *fmt_ctx, int stream_id
     else                                print_str_opt("nb_read_frames", "N/A");
     if (nb_streams_packets[stream_idx]) print_fmt    ("nb_read_packets", "%"PRIu64, nb_streams_packets[stream_idx]);
     else                                print_str_opt("nb_read_packets", "N/A");
+    if (index_stats && index_stats[stream_idx].total_size > 0) {
+        const IndexStats *is = &index_stats[stream_idx];
+
+        print_val("index_min_packet_size", is->min_size, unit_byte_str);
+        print_val("index_max_packet_size", is->max_size, unit_byte_str);
+        print_val("index_avg_packet_size", is->total_size / is->nb_entries, unit_byte_str);
+        if (stream->duration > 0 && stream->time_base.num > 0)
+            print_val("index_bit_rate",
+                      av_rescale(is->total_size * 8, stream->time_base.den,
+                                 stream->duration * stream->time_base.num),
+                      unit_bit_per_second_str);
+    }
     if (do_show_data)
         writer_print_data(w, "extradata", par->extradata,
                                           par->extradata_size);
@@ -3083,6 +3316,43 @@ static void close_input_file(InputFile *ifile)
     avformat_close_input(&ifile->fmt_ctx);
 }
 
+/**
+ * Count the packets of a stream from the index of the demuxer, when each
+ * packet has an index entry with its size, or else from the number of
+ * frames given by the demuxer.
+ *
+ * @return 1 if the stream was counted, 0 otherwise
+ */
+static int count_from_index(AVStream *st, IndexStats *is)
+{
+    int nb_entries = avformat_index_get_entries_count(st);
+
+    memset(is, 0, sizeof(*is));
+    if (nb_entries > 0 && (!st->nb_frames || st->nb_frames == nb_entries)) {
+        is->min_size = INT64_MAX;
+        for (int i = 0; i < nb_entries; i++) {
+            const AVIndexEntry *e = avformat_index_get_entry(st, i);
+
+            if (e->size <= 0) {
+                memset(is, 0, sizeof(*is));
+                break;
+            }
+            is->min_size    = FFMIN(is->min_size, e->size);
+            is->max_size    = FFMAX(is->max_size, e->size);
+            is->total_size += e->size;
+            is->nb_entries++;
+        }
+        if (is->nb_entries)
+            return 1;
+    }
+
+    if (st->nb_frames > 0) {
+        is->nb_entries = st->nb_frames;
+        return 1;
+    }
+    return 0;
+}
+
 static int probe_file(WriterContext *wctx, const char *filename,
                       const char *print_filename)
 {
@@ -3120,6 +3390,29 @@ static int probe_file(WriterContext *wctx, const char *filename,
             ifile.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
     }
 
+    /* the streams counted from the index are not read */
+    if (do_count_from_index && (do_count_frames || do_count_packets) &&
+        !do_show_frames && !do_show_packets && !read_intervals_nb) {
+        int nb_unindexed = 0;
+
+        REALLOCZ_ARRAY_STREAM(index_stats,0,ifile.fmt_ctx->nb_streams);
+        for (i = 0; i < ifile.fmt_ctx->nb_streams; i++) {
+            if (!selected_streams[i])
+                continue;
+            if (count_from_index(ifile.fmt_ctx->streams[i], &index_stats[i])) {
+                if (do_count_frames)
+                    nb_streams_frames[i]  = index_stats[i].nb_entries;
+                if (do_count_packets)
+                    nb_streams_packets[i] = index_stats[i].nb_entries;
+                ifile.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+            } else {
+                nb_unindexed++;
+            }
+        }
+        if (!nb_unindexed)
+            do_read_frames = do_read_packets = 0;
+    }
+
     if (do_read_frames || do_read_packets) {
         if (do_show_frames && do_show_packets &&
             wctx->writer->flags & WRITER_FLAG_PUT_PACKETS_AND_FRAMES_IN_SAME_CHAPTER)
@@ -3160,6 +3453,7 @@ end:
     av_freep(&nb_streams_frames);
     av_freep(&nb_streams_packets);
     av_freep(&selected_streams);
+    av_freep(&index_stats);
 
     return ret;
 }
@@ -3661,6 +3955,7 @@ static const OptionDef real_options[] = {
     { "show_chapters", 0, { .func_arg = &opt_show_chapters }, "show chapters info" },
     { "count_frames", OPT_BOOL, { &do_count_frames }, "count the number of frames per stream" },
     { "count_packets", OPT_BOOL, { &do_count_packets }, "count the number of packets per stream" },
+    { "count_from_index", OPT_BOOL, { &do_count_from_index }, "count the frames and packets from the demuxer index when available" },
     { "show_program_version",  0, { .func_arg = &opt_show_program_version },  "show ffprobe version" },
     { "show_library_versions", 0, { .func_arg = &opt_show_library_versions }, "show library versions" },
     { "show_versions",         0, { .func_arg = &opt_show_versions }, "show program and library versions" },
@@ -745,6 +745,7 @@ extern const AVCodec ff_libgsm_ms_decoder;
 extern const AVCodec ff_libilbc_encoder;
 extern const AVCodec ff_libilbc_decoder;
 extern const AVCodec ff_libmp3lame_encoder;
+extern const AVCodec ff_libnvjpeg2k_decoder;
 extern const AVCodec ff_libopencore_amrnb_encoder;
 extern const AVCodec ff_libopencore_amrnb_decoder;
 extern const AVCodec ff_libopencore_amrwb_decoder;
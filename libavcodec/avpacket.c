@@ -27,6 +27,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/rational.h"
+#include "libavutil/thread.h"
 
 #include "bytestream.h"
 #include "internal.h"
@@ -295,6 +296,7 @@ const char *av_packet_side_data_name(enum AVPacketSideDataType type)
     case AV_PKT_DATA_DOVI_CONF:                  return "DOVI configuration record";
     case AV_PKT_DATA_S12M_TIMECODE:              return "SMPTE ST 12-1:2014 timecode";
     case AV_PKT_DATA_DYNAMIC_HDR10_PLUS:         return "HDR10+ Dynamic Metadata (SMPTE 2094-40)";
+    case AV_PKT_DATA_CONTENT_ID:                 return "Content Identifier";
     }
     return NULL;
 }
@@ -528,6 +530,107 @@ void av_packet_rescale_ts(AVPacket *pkt, AVRational src_tb, AVRational dst_tb)
         pkt->duration = av_rescale_q(pkt->duration, src_tb, dst_tb);
 }
 
+#define PACKET_POOL_MAX_FREE 64
+
+struct AVPacketPool {
+    AVMutex lock;
+    AVPacket *free_pkts[PACKET_POOL_MAX_FREE];
+    int nb_free_pkts;
+    /* payload buffers, by power of two size */
+    AVBufferPool *buf_pools[31];
+};
+
+AVPacketPool *av_packet_pool_alloc(void)
+{
+    AVPacketPool *pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    if (ff_mutex_init(&pool->lock, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void av_packet_pool_free(AVPacketPool **ppool)
+{
+    AVPacketPool *pool = *ppool;
+
+    if (!pool)
+        return;
+
+    for (int i = 0; i < pool->nb_free_pkts; i++)
+        av_packet_free(&pool->free_pkts[i]);
+    for (int i = 0; i < FF_ARRAY_ELEMS(pool->buf_pools); i++)
+        av_buffer_pool_uninit(&pool->buf_pools[i]);
+    ff_mutex_destroy(&pool->lock);
+    av_freep(ppool);
+}
+
+AVPacket *av_packet_pool_get(AVPacketPool *pool)
+{
+    AVPacket *pkt = NULL;
+
+    ff_mutex_lock(&pool->lock);
+    if (pool->nb_free_pkts)
+        pkt = pool->free_pkts[--pool->nb_free_pkts];
+    ff_mutex_unlock(&pool->lock);
+
+    return pkt ? pkt : av_packet_alloc();
+}
+
+void av_packet_pool_release(AVPacketPool *pool, AVPacket **ppkt)
+{
+    AVPacket *pkt = *ppkt;
+
+    if (!pkt)
+        return;
+    *ppkt = NULL;
+
+    av_packet_unref(pkt);
+
+    ff_mutex_lock(&pool->lock);
+    if (pool->nb_free_pkts < PACKET_POOL_MAX_FREE) {
+        pool->free_pkts[pool->nb_free_pkts++] = pkt;
+        pkt = NULL;
+    }
+    ff_mutex_unlock(&pool->lock);
+
+    av_packet_free(&pkt);
+}
+
+int av_packet_pool_new_packet(AVPacketPool *pool, AVPacket *pkt, int size)
+{
+    AVBufferPool *buf_pool;
+    AVBufferRef *buf;
+    int index;
+
+    if (size < 0 || size >= INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+
+    index = av_log2(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    ff_mutex_lock(&pool->lock);
+    if (!pool->buf_pools[index])
+        pool->buf_pools[index] = av_buffer_pool_init((size_t)2 << index, NULL);
+    buf_pool = pool->buf_pools[index];
+    ff_mutex_unlock(&pool->lock);
+    if (!buf_pool)
+        return AVERROR(ENOMEM);
+
+    buf = av_buffer_pool_get(buf_pool);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    get_packet_defaults(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    return 0;
+}
+
 int avpriv_packet_list_put(PacketList **packet_buffer,
                            PacketList **plast_pktl,
                            AVPacket      *pkt,
@@ -38,6 +38,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/intmath.h"
 #include "libavutil/opt.h"
+#include "libavutil/trace_internal.h"
 
 #include "avcodec.h"
 #include "bytestream.h"
@@ -604,7 +605,11 @@ int attribute_align_arg avcodec_send_packet(AVCodecContext *avctx, const AVPacke
     }
 
     if (!avci->buffer_frame->buf[0]) {
+        void *mem_ctx = av_mem_accounting_set_context(avctx);
+        FF_TRACE_BEGIN("send_packet", avctx->codec->name);
         ret = decode_receive_frame_internal(avctx, avci->buffer_frame);
+        FF_TRACE_END("send_packet", avctx->codec->name);
+        av_mem_accounting_set_context(mem_ctx);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
             return ret;
     }
@@ -652,7 +657,11 @@ int attribute_align_arg avcodec_receive_frame(AVCodecContext *avctx, AVFrame *fr
     if (avci->buffer_frame->buf[0]) {
         av_frame_move_ref(frame, avci->buffer_frame);
     } else {
+        void *mem_ctx = av_mem_accounting_set_context(avctx);
+        FF_TRACE_BEGIN("receive_frame", avctx->codec->name);
         ret = decode_receive_frame_internal(avctx, frame);
+        FF_TRACE_END("receive_frame", avctx->codec->name);
+        av_mem_accounting_set_context(mem_ctx);
         if (ret < 0)
             return ret;
     }
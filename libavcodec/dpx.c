@@ -26,6 +26,7 @@
 #include "libavutil/timecode.h"
 #include "bytestream.h"
 #include "avcodec.h"
+#include "dpxdsp.h"
 #include "internal.h"
 
 enum DPX_TRC {
@@ -60,6 +61,21 @@ enum DPX_COL_SPEC {
     /* 12 = N/A */
 };
 
+typedef struct DPXDecContext {
+    DPXDSPContext dsp;
+
+    /* image being decoded by the slice threads */
+    AVFrame *frame;
+    const uint8_t *data;    ///< first line of the image data
+    int stride;             ///< distance between the lines of the image data
+    int nb_slices;
+    int bits_per_color;
+    int elements;
+    int packing;
+    int endian;
+    int unpadded_10bit;
+} DPXDecContext;
+
 static unsigned int read16(const uint8_t **ptr, int is_big)
 {
     unsigned int temp;
@@ -149,11 +165,111 @@ static uint16_t read12in32(const uint8_t **ptr, uint32_t *lbuf,
     }
 }
 
+static int decode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    DPXDecContext *dpx = avctx->priv_data;
+    AVFrame *const p = dpx->frame;
+    int start = avctx->height *  jobnr      / dpx->nb_slices;
+    int end   = avctx->height * (jobnr + 1) / dpx->nb_slices;
+    const uint8_t *buf = dpx->data + start * dpx->stride;
+    int elements = dpx->elements, packing = dpx->packing, endian = dpx->endian;
+    // The components of RGB lines are unpacked to the planes in blocks
+    int simd_width = elements == 3 && (dpx->bits_per_color == 10 || packing) ?
+                     avctx->width & ~15 : 0;
+    unsigned int rgbBuffer = 0;
+    int n_datum = 0;
+    int x, y, i;
+
+    switch (dpx->bits_per_color) {
+    case 10:
+        for (x = start; x < end; x++) {
+            uint16_t *dst[4] = {(uint16_t*)(p->data[0] + x * p->linesize[0]),
+                                (uint16_t*)(p->data[1] + x * p->linesize[1]),
+                                (uint16_t*)(p->data[2] + x * p->linesize[2]),
+                                (uint16_t*)(p->data[3] + x * p->linesize[3])};
+            int shift = elements > 1 ? packing == 1 ? 22 : 20 : packing == 1 ? 2 : 0;
+            if (simd_width) {
+                dpx->dsp.unpack_rgb10[endian](dst[0], dst[1], dst[2], buf,
+                                              simd_width, shift - 20);
+                buf += 4 * simd_width;
+                for (i = 0; i < 3; i++)
+                    dst[i] += simd_width;
+            }
+            for (y = simd_width; y < avctx->width; y++) {
+                if (elements >= 3)
+                    *dst[2]++ = read10in32(&buf, &rgbBuffer,
+                                           &n_datum, endian, shift);
+                if (elements == 1)
+                    *dst[0]++ = read10in32_gray(&buf, &rgbBuffer,
+                                                &n_datum, endian, shift);
+                else
+                    *dst[0]++ = read10in32(&buf, &rgbBuffer,
+                                           &n_datum, endian, shift);
+                if (elements >= 2)
+                    *dst[1]++ = read10in32(&buf, &rgbBuffer,
+                                           &n_datum, endian, shift);
+                if (elements == 4)
+                    *dst[3]++ =
+                    read10in32(&buf, &rgbBuffer,
+                               &n_datum, endian, shift);
+            }
+            if (!dpx->unpadded_10bit)
+                n_datum = 0;
+        }
+        break;
+    case 12:
+        for (x = start; x < end; x++) {
+            uint16_t *dst[4] = {(uint16_t*)(p->data[0] + x * p->linesize[0]),
+                                (uint16_t*)(p->data[1] + x * p->linesize[1]),
+                                (uint16_t*)(p->data[2] + x * p->linesize[2]),
+                                (uint16_t*)(p->data[3] + x * p->linesize[3])};
+            int shift = packing == 1 ? 4 : 0;
+            // Lines start at the next aligned position
+            buf = dpx->data + x * dpx->stride;
+            if (simd_width) {
+                dpx->dsp.unpack_rgb12[endian](dst[0], dst[1], dst[2], buf,
+                                              simd_width, shift);
+                buf += 6 * simd_width;
+                for (i = 0; i < 3; i++)
+                    dst[i] += simd_width;
+            }
+            for (y = simd_width; y < avctx->width; y++) {
+                if (packing) {
+                    if (elements >= 3)
+                        *dst[2]++ = read16(&buf, endian) >> shift & 0xFFF;
+                    *dst[0]++ = read16(&buf, endian) >> shift & 0xFFF;
+                    if (elements >= 2)
+                        *dst[1]++ = read16(&buf, endian) >> shift & 0xFFF;
+                    if (elements == 4)
+                        *dst[3]++ = read16(&buf, endian) >> shift & 0xFFF;
+                } else {
+                    if (elements >= 3)
+                        *dst[2]++ = read12in32(&buf, &rgbBuffer,
+                                               &n_datum, endian);
+                    *dst[0]++ = read12in32(&buf, &rgbBuffer,
+                                           &n_datum, endian);
+                    if (elements >= 2)
+                        *dst[1]++ = read12in32(&buf, &rgbBuffer,
+                                               &n_datum, endian);
+                    if (elements == 4)
+                        *dst[3]++ = read12in32(&buf, &rgbBuffer,
+                                               &n_datum, endian);
+                }
+            }
+            n_datum = 0;
+        }
+        break;
+    }
+
+    return 0;
+}
+
 static int decode_frame(AVCodecContext *avctx,
                         void *data,
                         int *got_frame,
                         AVPacket *avpkt)
 {
+    DPXDecContext *dpx = avctx->priv_data;
     const uint8_t *buf = avpkt->data;
     int buf_size       = avpkt->size;
     AVFrame *const p = data;
@@ -169,9 +285,6 @@ static int decode_frame(AVCodecContext *avctx,
     int yuv, color_trc, color_spec;
     int encoding, need_align = 0, unpadded_10bit = 0;
 
-    unsigned int rgbBuffer = 0;
-    int n_datum = 0;
-
     if (avpkt->size <= 1634) {
         av_log(avctx, AV_LOG_ERROR, "Packet too small for DPX header\n");
         return AVERROR_INVALIDDATA;
@@ -634,72 +747,22 @@ static int decode_frame(AVCodecContext *avctx,
 
     switch (bits_per_color) {
     case 10:
-        for (x = 0; x < avctx->height; x++) {
-            uint16_t *dst[4] = {(uint16_t*)ptr[0],
-                                (uint16_t*)ptr[1],
-                                (uint16_t*)ptr[2],
-                                (uint16_t*)ptr[3]};
-            int shift = elements > 1 ? packing == 1 ? 22 : 20 : packing == 1 ? 2 : 0;
-            for (y = 0; y < avctx->width; y++) {
-                if (elements >= 3)
-                    *dst[2]++ = read10in32(&buf, &rgbBuffer,
-                                           &n_datum, endian, shift);
-                if (elements == 1)
-                    *dst[0]++ = read10in32_gray(&buf, &rgbBuffer,
-                                                &n_datum, endian, shift);
-                else
-                    *dst[0]++ = read10in32(&buf, &rgbBuffer,
-                                           &n_datum, endian, shift);
-                if (elements >= 2)
-                    *dst[1]++ = read10in32(&buf, &rgbBuffer,
-                                           &n_datum, endian, shift);
-                if (elements == 4)
-                    *dst[3]++ =
-                    read10in32(&buf, &rgbBuffer,
-                               &n_datum, endian, shift);
-            }
-            if (!unpadded_10bit)
-                n_datum = 0;
-            for (i = 0; i < elements; i++)
-                ptr[i] += p->linesize[i];
-        }
-        break;
     case 12:
-        for (x = 0; x < avctx->height; x++) {
-            uint16_t *dst[4] = {(uint16_t*)ptr[0],
-                                (uint16_t*)ptr[1],
-                                (uint16_t*)ptr[2],
-                                (uint16_t*)ptr[3]};
-            int shift = packing == 1 ? 4 : 0;
-            for (y = 0; y < avctx->width; y++) {
-                if (packing) {
-                    if (elements >= 3)
-                        *dst[2]++ = read16(&buf, endian) >> shift & 0xFFF;
-                    *dst[0]++ = read16(&buf, endian) >> shift & 0xFFF;
-                    if (elements >= 2)
-                        *dst[1]++ = read16(&buf, endian) >> shift & 0xFFF;
-                    if (elements == 4)
-                        *dst[3]++ = read16(&buf, endian) >> shift & 0xFFF;
-                } else {
-                    if (elements >= 3)
-                        *dst[2]++ = read12in32(&buf, &rgbBuffer,
-                                               &n_datum, endian);
-                    *dst[0]++ = read12in32(&buf, &rgbBuffer,
-                                           &n_datum, endian);
-                    if (elements >= 2)
-                        *dst[1]++ = read12in32(&buf, &rgbBuffer,
-                                               &n_datum, endian);
-                    if (elements == 4)
-                        *dst[3]++ = read12in32(&buf, &rgbBuffer,
-                                               &n_datum, endian);
-                }
-            }
-            n_datum = 0;
-            for (i = 0; i < elements; i++)
-                ptr[i] += p->linesize[i];
-            // Jump to next aligned position
-            buf += need_align;
-        }
+        dpx->frame          = p;
+        dpx->data           = buf;
+        dpx->stride         = stride;
+        dpx->bits_per_color = bits_per_color;
+        dpx->elements       = elements;
+        dpx->packing        = packing;
+        dpx->endian         = endian;
+        dpx->unpadded_10bit = unpadded_10bit;
+        // Unpadded lines only start at a word boundary when they hold a
+        // multiple of 3 components
+        if (bits_per_color == 10 && unpadded_10bit && avctx->width * elements % 3)
+            dpx->nb_slices = 1;
+        else
+            dpx->nb_slices = av_clip(avctx->thread_count, 1, avctx->height);
+        avctx->execute2(avctx, decode_slice, NULL, NULL, dpx->nb_slices);
         break;
     case 32:
         if (elements == 1) {
@@ -762,11 +825,23 @@ static int decode_frame(AVCodecContext *avctx,
     return buf_size;
 }
 
+static av_cold int decode_init(AVCodecContext *avctx)
+{
+    DPXDecContext *dpx = avctx->priv_data;
+
+    ff_dpxdsp_init(&dpx->dsp);
+
+    return 0;
+}
+
 const AVCodec ff_dpx_decoder = {
     .name           = "dpx",
     .long_name      = NULL_IF_CONFIG_SMALL("DPX (Digital Picture Exchange) image"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_DPX,
+    .priv_data_size = sizeof(DPXDecContext),
+    .init           = decode_init,
     .decode         = decode_frame,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
 };
@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/intreadwrite.h"
+#include "dpxdsp.h"
+
+#define DPX_FUNCS(endian, RN16, RN32, WN16, WN32)                               \
+static void unpack_rgb10_ ## endian ## _c(uint16_t *dst_g, uint16_t *dst_b,     \
+                                          uint16_t *dst_r, const uint8_t *src,  \
+                                          ptrdiff_t width, int shift)           \
+{                                                                               \
+    for (ptrdiff_t x = 0; x < width; x++) {                                     \
+        uint32_t v = RN32(src + 4 * x);                                         \
+        dst_r[x] = v >> (shift + 20) & 0x3FF;                                   \
+        dst_g[x] = v >> (shift + 10) & 0x3FF;                                   \
+        dst_b[x] = v >>  shift       & 0x3FF;                                   \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+static void unpack_rgb12_ ## endian ## _c(uint16_t *dst_g, uint16_t *dst_b,     \
+                                          uint16_t *dst_r, const uint8_t *src,  \
+                                          ptrdiff_t width, int shift)           \
+{                                                                               \
+    for (ptrdiff_t x = 0; x < width; x++) {                                     \
+        dst_r[x] = RN16(src + 6 * x + 0) >> shift & 0xFFF;                      \
+        dst_g[x] = RN16(src + 6 * x + 2) >> shift & 0xFFF;                      \
+        dst_b[x] = RN16(src + 6 * x + 4) >> shift & 0xFFF;                      \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+static void pack_rgb10_ ## endian ## _c(uint8_t *dst, const uint16_t *src_g,    \
+                                        const uint16_t *src_b,                  \
+                                        const uint16_t *src_r, ptrdiff_t width) \
+{                                                                               \
+    for (ptrdiff_t x = 0; x < width; x++)                                       \
+        WN32(dst + 4 * x, (unsigned)RN16(src_r + x) << 22 |                     \
+                                    RN16(src_g + x) << 12 |                     \
+                                    RN16(src_b + x) <<  2);                     \
+}                                                                               \
+                                                                                \
+static void pack_rgb12_ ## endian ## _c(uint8_t *dst, const uint16_t *src_g,    \
+                                        const uint16_t *src_b,                  \
+                                        const uint16_t *src_r, ptrdiff_t width) \
+{                                                                               \
+    for (ptrdiff_t x = 0; x < width; x++) {                                     \
+        WN16(dst + 6 * x + 0, RN16(src_r + x) << 4);                            \
+        WN16(dst + 6 * x + 2, RN16(src_g + x) << 4);                            \
+        WN16(dst + 6 * x + 4, RN16(src_b + x) << 4);                            \
+    }                                                                           \
+}
+
+DPX_FUNCS(le, AV_RL16, AV_RL32, AV_WL16, AV_WL32)
+DPX_FUNCS(be, AV_RB16, AV_RB32, AV_WB16, AV_WB32)
+
+av_cold void ff_dpxdsp_init(DPXDSPContext *c)
+{
+    c->unpack_rgb10[0] = unpack_rgb10_le_c;
+    c->unpack_rgb10[1] = unpack_rgb10_be_c;
+    c->unpack_rgb12[0] = unpack_rgb12_le_c;
+    c->unpack_rgb12[1] = unpack_rgb12_be_c;
+    c->pack_rgb10[0]   = pack_rgb10_le_c;
+    c->pack_rgb10[1]   = pack_rgb10_be_c;
+    c->pack_rgb12[0]   = pack_rgb12_le_c;
+    c->pack_rgb12[1]   = pack_rgb12_be_c;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_DPXDSP_H
+#define AVCODEC_DPXDSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Conversions between the RGB lines of DPX images and the planes of
+ * gbrp10/gbrp12. The functions are indexed by the byte order of the DPX
+ * words, 0 for little-endian and 1 for big-endian. The width must be a
+ * multiple of 16.
+ */
+typedef struct DPXDSPContext {
+    /**
+     * Unpack 10-bit components packed in 32-bit words, one pixel per word
+     * with R in the most significant bits, to native-endian planes.
+     * @param shift position of B in the word, 2 for method A, 0 for method B
+     */
+    void (*unpack_rgb10[2])(uint16_t *dst_g, uint16_t *dst_b, uint16_t *dst_r,
+                            const uint8_t *src, ptrdiff_t width, int shift);
+    /**
+     * Unpack 12-bit R, G, B components filled to 16-bit words to
+     * native-endian planes.
+     * @param shift position of the component in the word, 4 for method A,
+     *              0 for method B
+     */
+    void (*unpack_rgb12[2])(uint16_t *dst_g, uint16_t *dst_b, uint16_t *dst_r,
+                            const uint8_t *src, ptrdiff_t width, int shift);
+    /**
+     * Pack planes of the same byte order as the words to 10-bit method A
+     * words, one pixel per word.
+     */
+    void (*pack_rgb10[2])(uint8_t *dst, const uint16_t *src_g,
+                          const uint16_t *src_b, const uint16_t *src_r,
+                          ptrdiff_t width);
+    /**
+     * Pack planes of the same byte order as the words to 12-bit method A
+     * R, G, B words.
+     */
+    void (*pack_rgb12[2])(uint8_t *dst, const uint16_t *src_g,
+                          const uint16_t *src_b, const uint16_t *src_r,
+                          ptrdiff_t width);
+} DPXDSPContext;
+
+void ff_dpxdsp_init(DPXDSPContext *c);
+
+#endif /* AVCODEC_DPXDSP_H */
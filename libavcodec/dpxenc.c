@@ -23,15 +23,23 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/imgutils.h"
 #include "avcodec.h"
+#include "dpxdsp.h"
 #include "encode.h"
 #include "internal.h"
 
 typedef struct DPXContext {
+    DPXDSPContext dsp;
     int big_endian;
     int bits_per_component;
     int num_components;
     int descriptor;
     int planar;
+
+    /* picture being encoded by the slice threads */
+    const AVFrame *pic;
+    uint8_t *dst;           ///< first line of the image data
+    int stride;             ///< distance between the lines of the image data
+    int nb_slices;
 } DPXContext;
 
 static av_cold int encode_init(AVCodecContext *avctx)
@@ -45,6 +53,8 @@ static av_cold int encode_init(AVCodecContext *avctx)
     s->descriptor         = (desc->flags & AV_PIX_FMT_FLAG_ALPHA) ? 51 : 50;
     s->planar             = !!(desc->flags & AV_PIX_FMT_FLAG_PLANAR);
 
+    ff_dpxdsp_init(&s->dsp);
+
     switch (avctx->pix_fmt) {
     case AV_PIX_FMT_ABGR:
         s->descriptor = 52;
@@ -89,13 +99,13 @@ static av_always_inline void write32_internal(int big_endian, void *p, int value
 #define write32(p, value) write32_internal(s->big_endian, p, value)
 
 static void encode_rgb48_10bit(AVCodecContext *avctx, const AVFrame *pic,
-                               uint8_t *dst)
+                               uint8_t *dst, int start, int end)
 {
     DPXContext *s = avctx->priv_data;
-    const uint8_t *src = pic->data[0];
+    const uint8_t *src = pic->data[0] + start * pic->linesize[0];
     int x, y;
 
-    for (y = 0; y < avctx->height; y++) {
+    for (y = start; y < end; y++) {
         for (x = 0; x < avctx->width; x++) {
             int value;
             if (s->big_endian) {
@@ -114,14 +124,22 @@ static void encode_rgb48_10bit(AVCodecContext *avctx, const AVFrame *pic,
     }
 }
 
-static void encode_gbrp10(AVCodecContext *avctx, const AVFrame *pic, uint8_t *dst)
+static void encode_gbrp10(AVCodecContext *avctx, const AVFrame *pic, uint8_t *dst,
+                          int start, int end)
 {
     DPXContext *s = avctx->priv_data;
-    const uint8_t *src[3] = {pic->data[0], pic->data[1], pic->data[2]};
+    const uint8_t *src[3] = {pic->data[0] + start * pic->linesize[0],
+                             pic->data[1] + start * pic->linesize[1],
+                             pic->data[2] + start * pic->linesize[2]};
+    int simd_width = avctx->width & ~15;
     int x, y, i;
 
-    for (y = 0; y < avctx->height; y++) {
-        for (x = 0; x < avctx->width; x++) {
+    for (y = start; y < end; y++) {
+        s->dsp.pack_rgb10[s->big_endian](dst, (const uint16_t *)src[0],
+                                         (const uint16_t *)src[1],
+                                         (const uint16_t *)src[2], simd_width);
+        dst += 4 * simd_width;
+        for (x = simd_width; x < avctx->width; x++) {
             int value;
             if (s->big_endian) {
                 value = (AV_RB16(src[0] + 2*x) << 12)
@@ -140,17 +158,21 @@ static void encode_gbrp10(AVCodecContext *avctx, const AVFrame *pic, uint8_t *ds
     }
 }
 
-static void encode_gbrp12(AVCodecContext *avctx, const AVFrame *pic, uint8_t *dst)
+static void encode_gbrp12(AVCodecContext *avctx, const AVFrame *pic, uint8_t *dst,
+                          int start, int end)
 {
     DPXContext *s = avctx->priv_data;
-    const uint16_t *src[3] = {(uint16_t*)pic->data[0],
-                              (uint16_t*)pic->data[1],
-                              (uint16_t*)pic->data[2]};
+    const uint16_t *src[3] = {(uint16_t*)(pic->data[0] + start * pic->linesize[0]),
+                              (uint16_t*)(pic->data[1] + start * pic->linesize[1]),
+                              (uint16_t*)(pic->data[2] + start * pic->linesize[2])};
+    int simd_width = avctx->width & ~15;
     int x, y, i, pad;
     pad = avctx->width*6;
     pad = (FFALIGN(pad, 4) - pad) >> 1;
-    for (y = 0; y < avctx->height; y++) {
-        for (x = 0; x < avctx->width; x++) {
+    for (y = start; y < end; y++) {
+        s->dsp.pack_rgb12[s->big_endian](dst, src[0], src[1], src[2], simd_width);
+        dst += 6 * simd_width;
+        for (x = simd_width; x < avctx->width; x++) {
             uint16_t value[3];
             if (s->big_endian) {
                 value[1] = AV_RB16(src[0] + x) << 4;
@@ -171,6 +193,23 @@ static void encode_gbrp12(AVCodecContext *avctx, const AVFrame *pic, uint8_t *ds
     }
 }
 
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    DPXContext *s = avctx->priv_data;
+    int start = avctx->height *  jobnr      / s->nb_slices;
+    int end   = avctx->height * (jobnr + 1) / s->nb_slices;
+    uint8_t *dst = s->dst + start * s->stride;
+
+    if (s->bits_per_component == 12)
+        encode_gbrp12(avctx, s->pic, dst, start, end);
+    else if (s->planar)
+        encode_gbrp10(avctx, s->pic, dst, start, end);
+    else
+        encode_rgb48_10bit(avctx, s->pic, dst, start, end);
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *frame, int *got_packet)
 {
@@ -251,13 +290,12 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
             return size;
         break;
     case 10:
-        if (s->planar)
-            encode_gbrp10(avctx, frame, buf + HEADER_SIZE);
-        else
-            encode_rgb48_10bit(avctx, frame, buf + HEADER_SIZE);
-        break;
     case 12:
-        encode_gbrp12(avctx, frame, buf + HEADER_SIZE);
+        s->pic       = frame;
+        s->dst       = buf + HEADER_SIZE;
+        s->stride    = size / avctx->height;
+        s->nb_slices = av_clip(avctx->thread_count, 1, avctx->height);
+        avctx->execute2(avctx, encode_slice, NULL, NULL, s->nb_slices);
         break;
     default:
         av_log(avctx, AV_LOG_ERROR, "Unsupported bit depth: %d\n", s->bits_per_component);
@@ -278,7 +316,7 @@ const AVCodec ff_dpx_encoder = {
     .long_name      = NULL_IF_CONFIG_SMALL("DPX (Digital Picture Exchange) image"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_DPX,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(DPXContext),
     .init           = encode_init,
     .encode2        = encode_frame,
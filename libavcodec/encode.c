@@ -378,7 +378,9 @@ int attribute_align_arg avcodec_send_frame(AVCodecContext *avctx, const AVFrame
     }
 
     if (!avci->buffer_pkt->data && !avci->buffer_pkt->side_data) {
+        void *mem_ctx = av_mem_accounting_set_context(avctx);
         ret = encode_receive_packet_internal(avctx, avci->buffer_pkt);
+        av_mem_accounting_set_context(mem_ctx);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
             return ret;
     }
@@ -399,7 +401,9 @@ int attribute_align_arg avcodec_receive_packet(AVCodecContext *avctx, AVPacket *
     if (avci->buffer_pkt->data || avci->buffer_pkt->side_data) {
         av_packet_move_ref(avpkt, avci->buffer_pkt);
     } else {
+        void *mem_ctx = av_mem_accounting_set_context(avctx);
         ret = encode_receive_packet_internal(avctx, avpkt);
+        av_mem_accounting_set_context(mem_ctx);
         if (ret < 0)
             return ret;
     }
@@ -70,6 +70,7 @@
 #include "internal.h"
 #include "bytestream.h"
 #include "jpeg2000.h"
+#include "jpeg2000htenc.h"
 #include "libavutil/common.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/opt.h"
@@ -107,6 +108,16 @@ typedef struct {
    double *layer_rates;
 } Jpeg2000Tile;
 
+/** a code block to be coded by tier-1, located in the DWT output of its component */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component *comp;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    Jpeg2000Tile *tile;
+    int x0, y0, x1, y1;
+    int bandpos, lev;
+} Jpeg2000CblkJob;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -131,6 +142,8 @@ typedef struct {
     Jpeg2000QuantStyle  qntsty;
 
     Jpeg2000Tile *tile;
+    Jpeg2000CblkJob *cblk_jobs;
+    int nb_cblk_jobs;
     int layer_rates[100];
     uint8_t compression_rate_enc; ///< Is compression done using compression ratio?
 
@@ -141,6 +154,8 @@ typedef struct {
     int prog;
     int nlayers;
     char *lr_str;
+    int bypass;
+    int htj2k;
 } Jpeg2000EncoderContext;
 
 
@@ -217,23 +232,38 @@ static void dump(Jpeg2000EncoderContext *s, FILE *fd)
 /* bitstream routines */
 
 /** put n times val bit */
-static void put_bits(Jpeg2000EncoderContext *s, int val, int n) // TODO: optimize
+static void put_bits(Jpeg2000EncoderContext *s, int val, int n)
 {
-    while (n-- > 0){
+    while (n > 0){
+        int k;
         if (s->bit_index == 8)
         {
             s->bit_index = *s->buf == 0xff;
             *(++s->buf) = 0;
         }
-        *s->buf |= val << (7 - s->bit_index++);
+        k = FFMIN(n, 8 - s->bit_index);
+        if (val)
+            *s->buf |= ((1 << k) - 1) << (8 - s->bit_index - k);
+        s->bit_index += k;
+        n -= k;
     }
 }
 
 /** put n least significant bits of a number num */
 static void put_num(Jpeg2000EncoderContext *s, int num, int n)
 {
-    while(--n >= 0)
-        put_bits(s, (num >> n) & 1, 1);
+    while (n > 0){
+        int k;
+        if (s->bit_index == 8)
+        {
+            s->bit_index = *s->buf == 0xff;
+            *(++s->buf) = 0;
+        }
+        k = FFMIN(n, 8 - s->bit_index);
+        n -= k;
+        *s->buf |= ((num >> n) & ((1 << k) - 1)) << (8 - s->bit_index - k);
+        s->bit_index += k;
+    }
 }
 
 /** flush the bitstream */
@@ -241,7 +271,9 @@ static void j2k_flush(Jpeg2000EncoderContext *s)
 {
     if (s->bit_index){
         s->bit_index = 0;
-        s->buf++;
+        // a header ending with 0xFF is followed by a stuffed 0 bit
+        if (*s->buf++ == 0xff)
+            *s->buf++ = 0;
     }
 }
 
@@ -306,7 +338,7 @@ static int put_siz(Jpeg2000EncoderContext *s)
 
     bytestream_put_be16(&s->buf, JPEG2000_SIZ);
     bytestream_put_be16(&s->buf, 38 + 3 * s->ncomponents); // Lsiz
-    bytestream_put_be16(&s->buf, 0); // Rsiz
+    bytestream_put_be16(&s->buf, s->htj2k ? 1 << 14 : 0); // Rsiz, CAP marker present
     bytestream_put_be32(&s->buf, s->width); // width
     bytestream_put_be32(&s->buf, s->height); // height
     bytestream_put_be32(&s->buf, 0); // X0Siz
@@ -326,6 +358,34 @@ static int put_siz(Jpeg2000EncoderContext *s)
     return 0;
 }
 
+/* extended capabilities, signaling the HT block coder of Part 15 */
+static int put_cap(Jpeg2000EncoderContext *s)
+{
+    Jpeg2000QuantStyle *qntsty = &s->qntsty;
+    int i, magb = 0, bp;
+
+    if (s->buf_end - s->buf < 10)
+        return -1;
+
+    // MAGB, the largest number of magnitude bit-planes of a subband
+    for (i = 0; i < s->codsty.nreslevels * 3 - 2; i++)
+        magb = FFMAX(magb, qntsty->expn[i] + qntsty->nguardbits - 1);
+    if (magb <= 8)
+        bp = 0;
+    else if (magb < 28)
+        bp = magb - 8;
+    else if (magb < 48)
+        bp = 13 + (magb >> 2);
+    else
+        bp = 31;
+
+    bytestream_put_be16(&s->buf, JPEG2000_CAP);
+    bytestream_put_be16(&s->buf, 8); // Lcap
+    bytestream_put_be32(&s->buf, 1 << (32 - 15)); // Pcap, Part 15
+    bytestream_put_be16(&s->buf, (s->codsty.transform != FF_DWT53) << 5 | bp); // Ccap15
+    return 0;
+}
+
 static int put_cod(Jpeg2000EncoderContext *s)
 {
     Jpeg2000CodingStyle *codsty = &s->codsty;
@@ -353,7 +413,7 @@ static int put_cod(Jpeg2000EncoderContext *s)
     bytestream_put_byte(&s->buf, codsty->nreslevels - 1); // num of decomp. levels
     bytestream_put_byte(&s->buf, codsty->log2_cblk_width-2); // cblk width
     bytestream_put_byte(&s->buf, codsty->log2_cblk_height-2); // cblk height
-    bytestream_put_byte(&s->buf, 0); // cblk style
+    bytestream_put_byte(&s->buf, codsty->cblk_style); // cblk style
     bytestream_put_byte(&s->buf, codsty->transform == FF_DWT53); // transformation
     return 0;
 }
@@ -452,6 +512,81 @@ static void compute_rates(Jpeg2000EncoderContext* s)
  * allocate memory for them
  * divide the input image into tile-components
  */
+/**
+ * Lay out the code blocks of all the tiles for tier-1 coding and allocate
+ * their buffers; only count them if jobs is NULL.
+ * @return the number of code blocks or a negative error code
+ */
+static int init_cblk_jobs(Jpeg2000EncoderContext *s, Jpeg2000CblkJob *jobs)
+{
+    int tileno, compno, reslevelno, bandno, nb_jobs = 0;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+
+    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
+        Jpeg2000Tile *tile = s->tile + tileno;
+        for (compno = 0; compno < s->ncomponents; compno++){
+            Jpeg2000Component *comp = tile->comp + compno;
+
+            for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
+                Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+
+                for (bandno = 0; bandno < reslevel->nbands ; bandno++){
+                    Jpeg2000Band *band = reslevel->band + bandno;
+                    Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+                    int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
+                    yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+                    y0 = yy0;
+                    yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
+                                band->coord[1][1]) - band->coord[1][0] + yy0;
+
+                    if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
+                        continue;
+
+                    bandpos = bandno + (reslevelno > 0);
+
+                    for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
+                        if (reslevelno == 0 || bandno == 1)
+                            xx0 = 0;
+                        else
+                            xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+                        x0 = xx0;
+                        xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                                    band->coord[0][1]) - band->coord[0][0] + xx0;
+
+                        for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++, nb_jobs++){
+                            if (jobs) {
+                                Jpeg2000CblkJob *job = jobs + nb_jobs;
+                                Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+
+                                cblk->data   = av_malloc(1 + 8192);
+                                cblk->passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof(*cblk->passes));
+                                if (!cblk->data || !cblk->passes)
+                                    return AVERROR(ENOMEM);
+
+                                job->comp    = comp;
+                                job->band    = band;
+                                job->cblk    = cblk;
+                                job->tile    = tile;
+                                job->x0      = xx0;
+                                job->y0      = yy0;
+                                job->x1      = xx1;
+                                job->y1      = yy1;
+                                job->bandpos = bandpos;
+                                job->lev     = codsty->nreslevels - reslevelno - 1;
+                            }
+                            xx0 = xx1;
+                            xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
+                        }
+                        yy0 = yy1;
+                        yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
+                    }
+                }
+            }
+        }
+    }
+    return nb_jobs;
+}
+
 static int init_tiles(Jpeg2000EncoderContext *s)
 {
     int tileno, tilex, tiley, compno;
@@ -501,6 +636,13 @@ static int init_tiles(Jpeg2000EncoderContext *s)
             }
         }
     compute_rates(s);
+
+    s->nb_cblk_jobs = init_cblk_jobs(s, NULL);
+    s->cblk_jobs = av_calloc(s->nb_cblk_jobs, sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs)
+        return AVERROR(ENOMEM);
+    if (init_cblk_jobs(s, s->cblk_jobs) < 0)
+        return AVERROR(ENOMEM);
     return 0;
 }
 
@@ -516,13 +658,14 @@ static int init_tiles(Jpeg2000EncoderContext *s)
                     Jpeg2000Component *comp = tile->comp + compno;                                                          \
                     int *dst = comp->i_data;                                                                                \
                     int cbps = s->cbps[compno];                                                                             \
+                    int shift = 8 * sizeof(PIXEL) - cbps;                                                                   \
                     line = (PIXEL*)s->picture->data[compno]                                                                 \
                            + comp->coord[1][0] * (s->picture->linesize[compno] / sizeof(PIXEL))                             \
                            + comp->coord[0][0];                                                                             \
                     for (y = comp->coord[1][0]; y < comp->coord[1][1]; y++){                                                \
                         PIXEL *ptr = line;                                                                                  \
                         for (x = comp->coord[0][0]; x < comp->coord[0][1]; x++)                                             \
-                            *dst++ = *ptr++ - (1 << (cbps - 1));                                                            \
+                            *dst++ = (*ptr++ >> shift) - (1 << (cbps - 1));                                                 \
                         line += s->picture->linesize[compno] / sizeof(PIXEL);                                               \
                     }                                                                                                       \
                 }                                                                                                           \
@@ -536,7 +679,8 @@ static int init_tiles(Jpeg2000EncoderContext *s)
                     for (x = tile->comp[0].coord[0][0]; x < tile->comp[0].coord[0][1]; x++, i++){                           \
                         for (compno = 0; compno < s->ncomponents; compno++){                                                \
                             int cbps = s->cbps[compno];                                                                     \
-                            tile->comp[compno].i_data[i] = *ptr++  - (1 << (cbps - 1));                                     \
+                            int shift = 8 * sizeof(PIXEL) - cbps;                                                           \
+                            tile->comp[compno].i_data[i] = (*ptr++ >> shift) - (1 << (cbps - 1));                           \
                         }                                                                                                   \
                     }                                                                                                       \
                     line += s->picture->linesize[0] / sizeof(PIXEL);                                                        \
@@ -594,6 +738,7 @@ static void init_luts(void)
                                     << 1, 0);
     }
     ff_jpeg2000_init_tier1_luts();
+    ff_jpeg2000_init_ht_enc_tables();
 }
 
 /* tier-1 routines */
@@ -624,6 +769,8 @@ static void encode_sigpass(Jpeg2000T1Context *t1, int width, int height, int ban
                     if (bit){
                         int xorbit;
                         int ctxno = ff_jpeg2000_getsgnctxno(t1->flags[(y+1) * t1->stride + x+1], &xorbit);
+                        if (t1->mqc.raw)
+                            xorbit = 0;
                         ff_mqc_encode(&t1->mqc, t1->mqc.cx_states + ctxno, (t1->flags[(y+1) * t1->stride + x+1] >> 15) ^ xorbit);
                         *nmsedec += getnmsedec_sig(t1->data[(y) * t1->stride + x], bpno + NMSEDEC_FRACBITS);
                         ff_jpeg2000_set_significance(t1, x, y, t1->flags[(y+1) * t1->stride + x+1] >> 15);
@@ -705,7 +852,8 @@ static void encode_clnpass(Jpeg2000T1Context *t1, int width, int height, int ban
 static void encode_cblk(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk, Jpeg2000Tile *tile,
                         int width, int height, int bandpos, int lev)
 {
-    int pass_t = 2, passno, x, y, max=0, nmsedec, bpno;
+    int cblk_style = s->codsty.cblk_style;
+    int pass_t = 2, passno, x, y, max=0, nmsedec, bpno, term, seg_start = 0;
     int64_t wmsedec = 0;
 
     memset(t1->flags, 0, t1->stride * (height + 2) * sizeof(*t1->flags));
@@ -743,8 +891,21 @@ static void encode_cblk(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg20
                     break;
         }
 
-        cblk->passes[passno].rate = ff_mqc_flush_to(&t1->mqc, cblk->passes[passno].flushed, &cblk->passes[passno].flushed_len);
-        cblk->passes[passno].rate -= cblk->passes[passno].flushed_len;
+        if ((term = needs_termination(cblk_style, passno))) {
+            int rate = ff_mqc_flush(&t1->mqc);
+            /* trailing 0xff 0x7f pairs of an MQ segment are decoded the same
+             * as the 1 bits read past its end */
+            if (!t1->mqc.raw)
+                while (rate - seg_start >= 2 && AV_RB16(cblk->data + 1 + rate - 2) == 0xff7f)
+                    rate -= 2;
+            cblk->passes[passno].rate = rate;
+            cblk->passes[passno].flushed_len = 0;
+            ff_mqc_restartenc(&t1->mqc, cblk->data + 1 + rate, term == 2);
+            seg_start = rate;
+        } else {
+            cblk->passes[passno].rate = ff_mqc_flush_to(&t1->mqc, cblk->passes[passno].flushed, &cblk->passes[passno].flushed_len);
+            cblk->passes[passno].rate -= cblk->passes[passno].flushed_len;
+        }
 
         wmsedec += (int64_t)nmsedec << (2*bpno);
         cblk->passes[passno].disto = wmsedec;
@@ -757,12 +918,67 @@ static void encode_cblk(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg20
     cblk->npasses = passno;
     cblk->ninclpasses = passno;
 
-    if (passno) {
+    if (passno && !needs_termination(cblk_style, passno - 1)) {
         cblk->passes[passno-1].rate = ff_mqc_flush_to(&t1->mqc, cblk->passes[passno-1].flushed, &cblk->passes[passno-1].flushed_len);
         cblk->passes[passno-1].rate -= cblk->passes[passno-1].flushed_len;
     }
 }
 
+/* An HT code block is coded by a single cleanup pass. Its candidates at
+ * the successive bit-planes are stored one after the other as its passes,
+ * so that the rate control picks one as it truncates the MQ coded passes. */
+static void encode_cblk_ht(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk,
+                           int width, int height)
+{
+    int passno = 0, offset = 0, x, y, max = 0, bpno;
+
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            max = FFMAX(max, FFABS(t1->data[y * t1->stride + x]));
+
+    cblk->nonzerobits = max ? av_log2(max) + 1 - NMSEDEC_FRACBITS : 0;
+    // without rate control, only the pass down to bit-plane 0 is kept
+    if (cblk->nonzerobits > 0 && !s->lambda && !s->compression_rate_enc)
+        cblk->nonzerobits = 1;
+
+    cblk->data[0] = 0;
+    for (bpno = cblk->nonzerobits - 1; bpno >= 0; bpno--, passno++) {
+        int shift = bpno + NMSEDEC_FRACBITS;
+        int64_t disto = 0;
+        int len = ff_jpeg2000_encode_ht_cleanup(cblk->data + 1 + offset, 8192 - offset,
+                                                t1->data, t1->stride, width, height, shift);
+        if (len < 0)
+            break;
+
+        // the decoder reconstructs at the midpoint of the bins, but bit-plane 0 of the 5/3 DWT
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                int64_t a = FFABS(t1->data[y * t1->stride + x]), mu = a >> shift, e = a;
+
+                if (mu)
+                    e -= bpno || s->codsty.transform != FF_DWT53 ? (2 * mu + 1) << (shift - 1) : mu << shift;
+                disto += a * a - e * e;
+            }
+        }
+        cblk->passes[passno].rate        = len;
+        cblk->passes[passno].disto       = 2 * disto;
+        cblk->passes[passno].flushed_len = 0;
+        offset += len;
+    }
+    cblk->npasses     = passno;
+    cblk->ninclpasses = passno;
+}
+
+/* offset in the data of an HT code block of its candidate cleanup pass n */
+static int ht_pass_offset(const Jpeg2000Cblk *cblk, int n)
+{
+    int passno, offset = 0;
+
+    for (passno = 0; passno < n; passno++)
+        offset += cblk->passes[passno].rate;
+    return offset;
+}
+
 /* tier-2 routines: */
 
 static void putnumpasses(Jpeg2000EncoderContext *s, int n)
@@ -809,7 +1025,11 @@ static int encode_packet(Jpeg2000EncoderContext *s, Jpeg2000ResLevel *rlevel, in
                 ff_tag_tree_zero(prec->cblkincl, prec->nb_codeblocks_width, prec->nb_codeblocks_height, 99);
                 for (pos = 0; pos < nb_cblks; pos++) {
                     Jpeg2000Cblk *cblk = &prec->cblk[pos];
-                    prec->zerobits[pos].val = expn[bandno] + numgbits - 1 - cblk->nonzerobits;
+                    int nonzerobits = cblk->nonzerobits;
+                    // the bit-plane of the cleanup pass of an HT code block
+                    if (s->htj2k && cblk->layers[0].cum_passes)
+                        nonzerobits -= cblk->layers[0].cum_passes - 1;
+                    prec->zerobits[pos].val = expn[bandno] + numgbits - 1 - nonzerobits;
                     cblk->incl = 0;
                     cblk->lblock = 3;
                     tag_tree_update(prec->zerobits + pos);
@@ -867,7 +1087,8 @@ static int encode_packet(Jpeg2000EncoderContext *s, Jpeg2000ResLevel *rlevel, in
 
         for (pos=0, yi = 0; yi < prec->nb_codeblocks_height; yi++) {
             for (xi = 0; xi < cblknw; xi++, pos++){
-                int llen = 0, length;
+                int llen = 0, nb_segs = 0, passno, start;
+                int seg_len[JPEG2000_MAX_PASSES], seg_passes[JPEG2000_MAX_PASSES];
                 Jpeg2000Cblk *cblk = prec->cblk + yi * cblknw + xi;
 
                 if (s->buf_end - s->buf < 20) // approximately
@@ -890,21 +1111,41 @@ static int encode_packet(Jpeg2000EncoderContext *s, Jpeg2000ResLevel *rlevel, in
                 }
 
                 // number of passes
-                putnumpasses(s, cblk->layers[layno].npasses);
-
-                length = cblk->layers[layno].data_len;
-                if (layno == nlayers - 1 && cblk->layers[layno].cum_passes){
-                    length += cblk->passes[cblk->layers[layno].cum_passes-1].flushed_len;
-                }
-                if (cblk->lblock + av_log2(cblk->layers[layno].npasses) < av_log2(length) + 1) {
-                    llen = av_log2(length) + 1 - cblk->lblock - av_log2(cblk->layers[layno].npasses);
+                if (s->htj2k) {
+                    // the selected candidate, as the only cleanup pass
+                    putnumpasses(s, 1);
+                    seg_len[0]    = cblk->layers[layno].data_len;
+                    seg_passes[0] = 1;
+                    nb_segs       = 1;
+                    if (cblk->lblock < av_log2(seg_len[0]) + 1)
+                        llen = av_log2(seg_len[0]) + 1 - cblk->lblock;
+                } else {
+                    putnumpasses(s, cblk->layers[layno].npasses);
+
+                    // the passes of the layer split into codeword segments at the terminations
+                    start = cblk->layers[layno].cum_passes - cblk->layers[layno].npasses;
+                    for (passno = start; passno < cblk->layers[layno].cum_passes; passno++) {
+                        int last = passno == cblk->layers[layno].cum_passes - 1;
+                        if (last || needs_termination(s->codsty.cblk_style, passno)) {
+                            int length = cblk->passes[passno].rate - (start ? cblk->passes[start - 1].rate : 0);
+                            int npasses = passno + 1 - start;
+                            if (last && layno == nlayers - 1)
+                                length += cblk->passes[passno].flushed_len;
+                            if (cblk->lblock + av_log2(npasses) < av_log2(length) + 1)
+                                llen = FFMAX(llen, av_log2(length) + 1 - cblk->lblock - av_log2(npasses));
+                            seg_len[nb_segs]      = length;
+                            seg_passes[nb_segs++] = npasses;
+                            start = passno + 1;
+                        }
+                    }
                 }
 
                 // length of code block
                 cblk->lblock += llen;
                 put_bits(s, 1, llen);
                 put_bits(s, 0, 1);
-                put_num(s, length, cblk->lblock + av_log2(cblk->layers[layno].npasses));
+                for (i = 0; i < nb_segs; i++)
+                    put_num(s, seg_len[i], cblk->lblock + av_log2(seg_passes[i]));
             }
         }
     }
@@ -1248,6 +1489,8 @@ static void makelayer(Jpeg2000EncoderContext *s, int layno, double thresh, Jpeg2
                         if (cblk->ninclpasses == 0) {
                             layer->data_len = cblk->passes[n - 1].rate;
                             layer->data_start = cblk->data;
+                            if (s->htj2k)
+                                layer->data_start += ht_pass_offset(cblk, n - 1);
                             layer->disto = cblk->passes[n - 1].disto;
                         } else {
                             layer->data_len = cblk->passes[n - 1].rate - cblk->passes[cblk->ninclpasses - 1].rate;
@@ -1391,6 +1634,8 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
                         cblk->ninclpasses = getcut(cblk, s->lambda,
                                 (int64_t)dwt_norms[codsty->transform == FF_DWT53][bandpos][lev] * (int64_t)band->i_stepsize >> 15);
                         cblk->layers[0].data_start = cblk->data;
+                        if (s->htj2k && cblk->ninclpasses)
+                            cblk->layers[0].data_start += ht_pass_offset(cblk, cblk->ninclpasses - 1);
                         cblk->layers[0].cum_passes = cblk->ninclpasses;
                         cblk->layers[0].npasses = cblk->ninclpasses;
                         if (cblk->ninclpasses)
@@ -1402,84 +1647,72 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
-static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+static int encode_dwt_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno, ret;
-    Jpeg2000T1Context t1;
-    Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
-
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Component *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
 
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+    return ff_dwt_encode(&comp->dwt, comp->i_data);
+}
 
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+static int encode_cblk_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+    const Jpeg2000CblkJob *job = s->cblk_jobs + jobnr;
+    const Jpeg2000Component *comp = job->comp;
+    const Jpeg2000Band *band = job->band;
+    int w = comp->coord[0][1] - comp->coord[0][0];
+    int64_t step = 16384 * 65536 / band->i_stepsize;
+    Jpeg2000T1Context t1;
+    int y, x;
 
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+    t1.stride = (1<<codsty->log2_cblk_width) + 2;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
-
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
-                                }
-                            }
-                        }
-                        if (!prec->cblk[cblkno].data)
-                            prec->cblk[cblkno].data = av_malloc(1 + 8192);
-                        if (!prec->cblk[cblkno].passes)
-                            prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
-                        if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
-                            return AVERROR(ENOMEM);
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
-                }
+    if (codsty->transform == FF_DWT53){
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1.data + (y-job->y0)*t1.stride;
+            for (x = job->x0; x < job->x1; x++){
+                *ptr++ = comp->i_data[w * y + x] * (1 << NMSEDEC_FRACBITS);
+            }
+        }
+    } else{
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1.data + (y-job->y0)*t1.stride;
+            for (x = job->x0; x < job->x1; x++){
+                *ptr++ = comp->i_data[w * y + x] * step >> 15 - NMSEDEC_FRACBITS;
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
     }
+    if (s->htj2k)
+        encode_cblk_ht(s, &t1, job->cblk, job->x1 - job->x0, job->y1 - job->y0);
+    else
+        encode_cblk(s, &t1, job->cblk, job->tile, job->x1 - job->x0, job->y1 - job->y0,
+                    job->bandpos, job->lev);
+    return 0;
+}
+
+/**
+ * Run the DWT of all the tile components, then tier-1 code all the code
+ * blocks. Both are independent per job and run on the slice threads.
+ */
+static void encode_tier1(Jpeg2000EncoderContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int ntiles = s->numXtiles * s->numYtiles;
+
+    av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
+    avctx->execute2(avctx, encode_dwt_thread, NULL, NULL, ntiles * s->ncomponents);
+    av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+    avctx->execute2(avctx, encode_cblk_thread, NULL, NULL, s->nb_cblk_jobs);
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+}
+
+/* rate control and tier-2, run serially in tile order so that the output
+ * does not depend on the number of threads */
+static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+{
+    int ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     if (s->compression_rate_enc)
@@ -1511,6 +1744,7 @@ static void cleanup(Jpeg2000EncoderContext *s)
         av_freep(&s->tile[tileno].layer_rates);
     }
     av_freep(&s->tile);
+    av_freep(&s->cblk_jobs);
 }
 
 static void reinit(Jpeg2000EncoderContext *s)
@@ -1546,13 +1780,15 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     s->lambda = s->picture->quality * LAMBDA_SCALE;
 
-    if (avctx->pix_fmt == AV_PIX_FMT_BGR48 || avctx->pix_fmt == AV_PIX_FMT_GRAY16)
+    if (avctx->pix_fmt == AV_PIX_FMT_RGB48 || avctx->pix_fmt == AV_PIX_FMT_GRAY16)
         copy_frame_16(s);
     else
         copy_frame_8(s);
 
     reinit(s);
 
+    encode_tier1(s);
+
     if (s->format == CODEC_JP2) {
         av_assert0(s->buf == pkt->data);
 
@@ -1634,6 +1870,8 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     bytestream_put_be16(&s->buf, JPEG2000_SOC);
     if ((ret = put_siz(s)) < 0)
         return ret;
+    if (s->htj2k && (ret = put_cap(s)) < 0)
+        return ret;
     if ((ret = put_cod(s)) < 0)
         return ret;
     if ((ret = put_qcd(s, 0)) < 0)
@@ -1746,6 +1984,17 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     codsty->log2_cblk_width  = 4;
     codsty->log2_cblk_height = 4;
     codsty->transform        = s->pred ? FF_DWT53 : FF_DWT97_INT;
+    codsty->cblk_style       = s->bypass ? JPEG2000_CBLK_BYPASS : 0;
+
+    if (s->htj2k) {
+        if (s->nlayers > 1) {
+            av_log(avctx, AV_LOG_ERROR, "HTJ2K supports a single quality layer only\n");
+            return AVERROR(EINVAL);
+        }
+        if (s->bypass)
+            av_log(avctx, AV_LOG_WARNING, "Arithmetic coding bypass does not apply to HTJ2K\n");
+        codsty->cblk_style   = JPEG2000_CBLK_HT;
+    }
 
     qntsty->nguardbits       = 1;
 
@@ -1762,9 +2011,11 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     s->width = avctx->width;
     s->height = avctx->height;
 
+    /* the 16 bit formats may carry fewer significant bits, in their MSBs */
     for (i = 0; i < 3; i++) {
         if (avctx->pix_fmt == AV_PIX_FMT_GRAY16 || avctx->pix_fmt == AV_PIX_FMT_RGB48)
-            s->cbps[i] = 16;
+            s->cbps[i] = avctx->bits_per_raw_sample > 8 && avctx->bits_per_raw_sample < 16 ?
+                         avctx->bits_per_raw_sample : 16;
         else
             s->cbps[i] = 8;
     }
@@ -1823,6 +2074,8 @@ static const AVOption options[] = {
     { "pcrl",          NULL,                0,                     AV_OPT_TYPE_CONST,  { .i64 = JPEG2000_PGOD_PCRL }, 0,         0,           VE, "prog" },
     { "cprl",          NULL,                0,                     AV_OPT_TYPE_CONST,  { .i64 = JPEG2000_PGOD_CPRL }, 0,         0,           VE, "prog" },
     { "layer_rates",   "Layer Rates",       OFFSET(lr_str),        AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, VE },
+    { "bypass",        "Arithmetic coding bypass", OFFSET(bypass), AV_OPT_TYPE_BOOL,  { .i64 = 0           }, 0,         1,           VE, },
+    { "htj2k",         "High Throughput block coding (Part 15)", OFFSET(htj2k), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1,             VE, },
     { NULL }
 };
 
@@ -1839,6 +2092,7 @@ const AVCodec ff_jpeg2000_encoder = {
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_JPEG2000,
     .priv_data_size = sizeof(Jpeg2000EncoderContext),
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
     .init           = j2kenc_init,
     .encode2        = encode_frame,
     .close          = j2kenc_destroy,
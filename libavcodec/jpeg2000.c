@@ -463,13 +463,35 @@ static int init_band(AVCodecContext *avctx,
     return 0;
 }
 
+/* Check whether the coefficients of a reversible component stay in 16 bits
+ * through the inverse DWT: the decoded coefficients have at most
+ * expn + guard bits - 1 magnitude bits, and the intermediate low pass bands
+ * grow by at most 9/4 per decomposition level. */
+static int coeffs_fit_16bit(const Jpeg2000CodingStyle *codsty,
+                            const Jpeg2000QuantStyle *qntsty, int cbps)
+{
+    int nbands = 3 * (codsty->nreslevels - 1) + 1;
+    int64_t range;
+
+    if (codsty->transform != FF_DWT53 || cbps > 10 ||
+        qntsty->quantsty != JPEG2000_QSTY_NONE)
+        return 0;
+    for (int i = 0; i < nbands; i++)
+        if (qntsty->expn[i] + qntsty->nguardbits - 1 > 15)
+            return 0;
+    range = 1 << (cbps - 1);
+    for (int i = 0; i < codsty->nreslevels2decode - 1; i++)
+        range = (range * 9 + 3) / 4;
+    return range < 32768;
+}
+
 int ff_jpeg2000_init_component(Jpeg2000Component *comp,
                                Jpeg2000CodingStyle *codsty,
                                Jpeg2000QuantStyle *qntsty,
                                int cbps, int dx, int dy,
                                AVCodecContext *avctx)
 {
-    int reslevelno, bandno, gbandno = 0, ret, i, j;
+    int reslevelno, bandno, gbandno = 0, ret, i, j, coeffs16;
     uint32_t csize;
 
     if (codsty->nreslevels2decode <= 0) {
@@ -477,9 +499,12 @@ int ff_jpeg2000_init_component(Jpeg2000Component *comp,
         return AVERROR_INVALIDDATA;
     }
 
+    coeffs16 = !av_codec_is_encoder(avctx->codec) &&
+               coeffs_fit_16bit(codsty, qntsty, cbps);
+
     if (ret = ff_jpeg2000_dwt_init(&comp->dwt, comp->coord,
                                    codsty->nreslevels2decode - 1,
-                                   codsty->transform))
+                                   coeffs16 ? FF_DWT53_16 : codsty->transform))
         return ret;
 
     if (av_image_check_size(comp->coord[0][1] - comp->coord[0][0],
@@ -493,12 +518,20 @@ int ff_jpeg2000_init_component(Jpeg2000Component *comp,
         return AVERROR_PATCHWELCOME;
     }
 
+    comp->s_data = NULL;
     if (codsty->transform == FF_DWT97) {
         csize += AV_INPUT_BUFFER_PADDING_SIZE / sizeof(*comp->f_data);
         comp->i_data = NULL;
         comp->f_data = av_calloc(csize, sizeof(*comp->f_data));
         if (!comp->f_data)
             return AVERROR(ENOMEM);
+    } else if (coeffs16) {
+        csize += AV_INPUT_BUFFER_PADDING_SIZE / sizeof(*comp->s_data);
+        comp->f_data = NULL;
+        comp->i_data = NULL;
+        comp->s_data = av_calloc(csize, sizeof(*comp->s_data));
+        if (!comp->s_data)
+            return AVERROR(ENOMEM);
     } else {
         csize += AV_INPUT_BUFFER_PADDING_SIZE / sizeof(*comp->i_data);
         comp->f_data = NULL;
@@ -644,4 +677,5 @@ void ff_jpeg2000_cleanup(Jpeg2000Component *comp, Jpeg2000CodingStyle *codsty)
     av_freep(&comp->reslevel);
     av_freep(&comp->i_data);
     av_freep(&comp->f_data);
+    av_freep(&comp->s_data);
 }
@@ -37,6 +37,7 @@
 
 enum Jpeg2000Markers {
     JPEG2000_SOC = 0xff4f, // start of codestream
+    JPEG2000_CAP = 0xff50, // extended capabilities
     JPEG2000_SIZ = 0xff51, // image and tile size
     JPEG2000_COD,          // coding style default
     JPEG2000_COC,          // coding style component
@@ -105,6 +106,8 @@ enum Jpeg2000Quantsty { // quantization style
 #define JPEG2000_CBLK_VSC       0x08 // Vertical stripe causal context formation
 #define JPEG2000_CBLK_PREDTERM  0x10 // Predictable termination
 #define JPEG2000_CBLK_SEGSYM    0x20 // Segmentation symbols present
+#define JPEG2000_CBLK_HT        0x40 // High Throughput block coding, ITU-T T.814
+#define JPEG2000_CBLK_HT_MIXED  0x80 // HT and Part 1 code blocks mixed
 
 // Coding styles
 #define JPEG2000_CSTY_PREC      0x01 // Precincts defined in coding style
@@ -179,6 +182,7 @@ typedef struct Jpeg2000Cblk {
     uint16_t *lengthinc;
     uint8_t nb_lengthinc;
     uint8_t lblock;
+    uint8_t ht_plhd; // placeholder passes before the HT cleanup pass
     uint8_t *data;
     size_t data_allocated;
     int nb_terminations;
@@ -220,6 +224,7 @@ typedef struct Jpeg2000Component {
     DWTContext dwt;
     float *f_data;
     int *i_data;
+    int16_t *s_data;   // used instead of i_data when the 5/3 DWT coefficients fit in 16 bits
     int coord[2][2];   // border coordinates {{x0, x1}, {y0, y1}} -- can be reduced with lowres option
     int coord_o[2][2]; // border coordinates {{x0, x1}, {y0, y1}} -- original values from jpeg2000 headers
     uint8_t roi_shift; // ROI scaling value for the component
@@ -24,6 +24,9 @@
  * JPEG2000 parser.
  */
 
+#include <string.h>
+
+#include "libavutil/common.h"
 #include "parser.h"
 
 /* Whether frame is jp2 file or codestream
@@ -74,6 +77,20 @@ static uint8_t info_marker(uint16_t marker)
     return 0;
 }
 
+/**
+ * Consume n bytes which do not need to be looked at one by one, keeping the
+ * state as if they had been.
+ */
+static void consume_bytes(JPEG2000ParserContext *m, const uint8_t *buf, int n,
+                          uint32_t *state, uint64_t *state64)
+{
+    for (int i = FFMAX(n - 8, 0); i < n; i++) {
+        *state   = *state   << 8 | buf[i];
+        *state64 = *state64 << 8 | buf[i];
+    }
+    m->bytes_read += n;
+}
+
 /**
  * Find the end of the current frame in the bitstream.
  * @return the position of the first byte of the next frame, or -1
@@ -91,17 +108,33 @@ static int find_frame_end(JPEG2000ParserContext *m, const uint8_t *buf, int buf_
     }
 
     for (i = 0; i < buf_size; i++) {
-        state = state << 8 | buf[i];
-        state64 = state64 << 8 | buf[i];
-        m->bytes_read++;
         if (m->skip_bytes) {
-            m->skip_bytes--;
+            int n = FFMIN(m->skip_bytes, buf_size - i);
+            consume_bytes(m, buf + i, n, &state, &state64);
+            m->skip_bytes -= n;
+            i += n - 1;
             continue;
         }
+        // Inside the codestream, only a marker can change the state, so jump
+        // to the next 0xFF unless one of the last 3 bytes started a marker.
+        if (m->in_codestream && !m->read_tp && !m->fheader_read &&
+            (state & 0xFF) != 0xFF && (state & 0xFF00) != 0xFF00 &&
+            (state & 0xFF0000) != 0xFF0000) {
+            const uint8_t *p = memchr(buf + i, 0xFF, buf_size - i);
+            int n = (p ? p - buf : buf_size) - i;
+            consume_bytes(m, buf + i, n, &state, &state64);
+            i += n;
+            if (i == buf_size)
+                break;
+        }
+        state = state << 8 | buf[i];
+        state64 = state64 << 8 | buf[i];
+        m->bytes_read++;
         if (m->read_tp) { // Find out how many bytes inside Tile part codestream to skip.
             if (m->read_tp == 1) {
-                m->skip_bytes = (state64 & 0xFFFFFFFF) - 9 > 0?
-                                (state64 & 0xFFFFFFFF) - 9 : 0;
+                // Psot is 0 for a last tile part running until EOC.
+                uint32_t psot = state64;
+                m->skip_bytes = psot > 9 ? psot - 9 : 0;
             }
             m->read_tp--;
             continue;
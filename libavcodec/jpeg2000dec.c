@@ -34,12 +34,15 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/time.h"
 #include "avcodec.h"
 #include "bytestream.h"
 #include "internal.h"
 #include "thread.h"
 #include "jpeg2000.h"
 #include "jpeg2000dsp.h"
+#include "jpeg2000htdec.h"
 #include "profiles.h"
 
 #define JP2_SIG_TYPE    0x6A502020
@@ -78,6 +81,11 @@ typedef struct Jpeg2000TilePart {
  * one per component, so tile_part elements have a size of 3 */
 typedef struct Jpeg2000Tile {
     Jpeg2000Component   *comp;
+    /* coding and quantization styles the components were initialized with,
+     * kept with them for the next frames; init is 0 until initialized */
+    Jpeg2000CodingStyle comp_codsty[4];
+    Jpeg2000QuantStyle  comp_qntsty[4];
+    /* the fields below are reset for each frame */
     uint8_t             properties[4];
     Jpeg2000CodingStyle codsty[4];
     Jpeg2000QuantStyle  qntsty[4];
@@ -87,10 +95,26 @@ typedef struct Jpeg2000Tile {
     uint8_t             *packed_headers;        // contains packed headers. Used only along with PPT marker
     int                 packed_headers_size;    // size in bytes of the packed headers
     GetByteContext      packed_headers_stream;  // byte context corresponding to packed headers
+    uint32_t            *packet_lengths;        // lengths of the packets, from the PLT markers
+    unsigned            nb_packet_lengths;
+    unsigned            packet_lengths_allocated;
+    uint8_t             cblks_decoded;          // the code blocks were decoded along with the packets
+    uint8_t             coded[4];               // and the components with coded code blocks
     uint16_t tp_idx;                    // Tile-part index
     int coord[2][2];                    // border coordinates {{x0, x1}, {y0, y1}}
 } Jpeg2000Tile;
 
+/* A packet of a tile, listed in the order of the codestream */
+typedef struct Jpeg2000Packet {
+    const uint8_t *data;
+    unsigned size;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000ResLevel *rlevel;
+    uint8_t *expn;
+    int numgbits;
+    int compno, reslevelno, precno, layno;
+} Jpeg2000Packet;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -130,42 +154,79 @@ typedef struct Jpeg2000DecoderContext {
 
     int             curtileno;
 
+    /* packets of the tile being decoded per precinct, cf. decode_precincts() */
+    int             list_packets;
+    Jpeg2000Packet  *packets;
+    unsigned        nb_packets;
+    unsigned        packets_allocated;
+
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    uint8_t         siz[36 + 3 * 4];    // SIZ marker segment, without its length
+    /* tiles of the previous frame, whose components are reused by the next
+     * frame if its SIZ marker segment is identical */
+    Jpeg2000Tile    *tile_pool;
+    unsigned        tile_pool_size;
+    int             tile_pool_ncomponents;
+    uint8_t         tile_pool_siz[36 + 3 * 4];
+
+    /* line buffers of the inverse DWT steps, one per slice thread */
+    uint8_t         *dwt_linebuf;
+    unsigned        dwt_linebuf_size;
+    size_t          dwt_linebuf_stride;
+
+    /* threads running the code block, DWT and tile jobs of a frame: the
+     * slice threads, or the inner workers of a frame thread */
+    int             nb_threads;
+    AVSliceThread   *inner;
+    int             (*inner_func)(AVCodecContext *avctx, void *arg, int jobnr, int threadnr);
+    void            *inner_arg;
+
     /*options parameters*/
     int             reduction_factor;
+    int             max_quality_layers;
+    int             window_x, window_y, window_w, window_h;
+    int             inner_threads;
+
+    /* exported wall clock time spent in each decoding stage, in microseconds */
+    int64_t         time_tier2;     // main and tile headers, packet headers
+    int64_t         time_tier1;     // code blocks, with their dequantization
+    int64_t         time_dwt;
+    int64_t         time_output;    // MCT, DC level shift and frame writing
+
+    int             window[2][2];   // decode window {{x0, x1}, {y0, y1}} in the picture, clipped
 } Jpeg2000DecoderContext;
 
 /* get_bits functions for JPEG2000 packet bitstream
  * It is a get_bit function with a bit-stuffing routine. If the value of the
  * byte is 0xFF, the next byte includes an extra zero bit stuffed into the MSB.
  * cf. ISO-15444-1:2002 / B.10.1 Bit-stuffing routine */
-static int get_bits(Jpeg2000DecoderContext *s, int n)
+static int get_bits(GetByteContext *g, int *bit_index, int n)
 {
     int res = 0;
 
     while (--n >= 0) {
         res <<= 1;
-        if (s->bit_index == 0) {
-            s->bit_index = 7 + (bytestream2_get_byte(&s->g) != 0xFFu);
+        if (*bit_index == 0) {
+            *bit_index = 7 + (bytestream2_get_byte(g) != 0xFFu);
         }
-        s->bit_index--;
-        res |= (bytestream2_peek_byte(&s->g) >> s->bit_index) & 1;
+        (*bit_index)--;
+        res |= (bytestream2_peek_byte(g) >> *bit_index) & 1;
     }
     return res;
 }
 
-static void jpeg2000_flush(Jpeg2000DecoderContext *s)
+static void jpeg2000_flush(GetByteContext *g, int *bit_index)
 {
-    if (bytestream2_get_byte(&s->g) == 0xff)
-        bytestream2_skip(&s->g, 1);
-    s->bit_index = 8;
+    if (bytestream2_get_byte(g) == 0xff)
+        bytestream2_skip(g, 1);
+    *bit_index = 8;
 }
 
 /* decode the value stored in node */
-static int tag_tree_decode(Jpeg2000DecoderContext *s, Jpeg2000TgtNode *node,
-                           int threshold)
+static int tag_tree_decode(Jpeg2000DecoderContext *s, GetByteContext *g, int *bit_index,
+                           Jpeg2000TgtNode *node, int threshold)
 {
     Jpeg2000TgtNode *stack[30];
     int sp = -1, curval = 0;
@@ -190,7 +251,7 @@ static int tag_tree_decode(Jpeg2000DecoderContext *s, Jpeg2000TgtNode *node,
             curval = stack[sp]->val;
         while (curval < threshold) {
             int ret;
-            if ((ret = get_bits(s, 1)) > 0) {
+            if ((ret = get_bits(g, bit_index, 1)) > 0) {
                 stack[sp]->vis++;
                 break;
             } else if (!ret)
@@ -266,6 +327,24 @@ static const enum AVPixelFormat all_pix_fmts[]  = {RGB_PIXEL_FORMATS,
                                                    YUV_PIXEL_FORMATS,
                                                    XYZ_PIXEL_FORMATS};
 
+static void jpeg2000_free_tile_pool(Jpeg2000DecoderContext *s)
+{
+    unsigned tileno;
+    int compno;
+
+    for (tileno = 0; tileno < s->tile_pool_size; tileno++) {
+        Jpeg2000Tile *tile = s->tile_pool + tileno;
+
+        if (!tile->comp)
+            continue;
+        for (compno = 0; compno < s->tile_pool_ncomponents; compno++)
+            ff_jpeg2000_cleanup(tile->comp + compno, tile->comp_codsty + compno);
+        av_freep(&tile->comp);
+    }
+    av_freep(&s->tile_pool);
+    s->tile_pool_size = 0;
+}
+
 /* marker segments */
 /* get sizes and offsets of image, tiles; number of components */
 static int get_siz(Jpeg2000DecoderContext *s)
@@ -278,6 +357,7 @@ static int get_siz(Jpeg2000DecoderContext *s)
     int ret;
     int o_dimx, o_dimy; //original image dimensions.
     int dimx, dimy;
+    const uint8_t *siz = s->g.buffer;
 
     if (bytestream2_get_bytes_left(&s->g) < 36) {
         av_log(s->avctx, AV_LOG_ERROR, "Insufficient space for SIZ\n");
@@ -349,6 +429,7 @@ static int get_siz(Jpeg2000DecoderContext *s)
         }
         log2_chroma_wh |= s->cdy[i] >> 1 << i * 4 | s->cdx[i] >> 1 << i * 4 + 2;
     }
+    memcpy(s->siz, siz, 36 + 3 * s->ncomponents);
 
     s->numXtiles = ff_jpeg2000_ceildiv(s->width  - s->tile_offset_x, s->tile_width);
     s->numYtiles = ff_jpeg2000_ceildiv(s->height - s->tile_offset_y, s->tile_height);
@@ -361,25 +442,44 @@ static int get_siz(Jpeg2000DecoderContext *s)
         return AVERROR(EINVAL);
     }
 
-    s->tile = av_calloc(s->numXtiles * s->numYtiles, sizeof(*s->tile));
-    if (!s->tile) {
-        s->numXtiles = s->numYtiles = 0;
-        return AVERROR(ENOMEM);
-    }
+    if (s->tile_pool && s->tile_pool_size == s->numXtiles * s->numYtiles &&
+        s->tile_pool_ncomponents == s->ncomponents &&
+        !memcmp(s->tile_pool_siz, s->siz, 36 + 3 * s->ncomponents)) {
+        s->tile           = s->tile_pool;
+        s->tile_pool      = NULL;
+        s->tile_pool_size = 0;
+        for (i = 0; i < s->numXtiles * s->numYtiles; i++) {
+            Jpeg2000Tile *tile = s->tile + i;
+            int compno;
 
-    for (i = 0; i < s->numXtiles * s->numYtiles; i++) {
-        Jpeg2000Tile *tile = s->tile + i;
+            memset(tile->properties, 0, sizeof(*tile) - offsetof(Jpeg2000Tile, properties));
+            for (compno = 0; compno < s->ncomponents; compno++)
+                tile->comp[compno].roi_shift = 0;
+        }
+    } else {
+        jpeg2000_free_tile_pool(s);
 
-        tile->comp = av_mallocz(s->ncomponents * sizeof(*tile->comp));
-        if (!tile->comp)
+        s->tile = av_calloc(s->numXtiles * s->numYtiles, sizeof(*s->tile));
+        if (!s->tile) {
+            s->numXtiles = s->numYtiles = 0;
             return AVERROR(ENOMEM);
+        }
+
+        for (i = 0; i < s->numXtiles * s->numYtiles; i++) {
+            Jpeg2000Tile *tile = s->tile + i;
+
+            tile->comp = av_mallocz(s->ncomponents * sizeof(*tile->comp));
+            if (!tile->comp)
+                return AVERROR(ENOMEM);
+        }
     }
 
-    /* compute image size with reduction factor */
+    /* compute image size with reduction factor, ff_set_dimensions()
+     * applies the generic lowres part of it */
     o_dimx = ff_jpeg2000_ceildivpow2(s->width  - s->image_offset_x,
-                                               s->reduction_factor);
+                                     s->reduction_factor - s->avctx->lowres);
     o_dimy = ff_jpeg2000_ceildivpow2(s->height - s->image_offset_y,
-                                               s->reduction_factor);
+                                     s->reduction_factor - s->avctx->lowres);
     dimx = ff_jpeg2000_ceildiv(o_dimx, s->cdx[0]);
     dimy = ff_jpeg2000_ceildiv(o_dimy, s->cdy[0]);
     for (i = 1; i < s->ncomponents; i++) {
@@ -502,7 +602,8 @@ static int get_cox(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *c)
            already in setup earlier we have to fail this frame until
            reinitialization is implemented */
         av_log(s->avctx, AV_LOG_ERROR, "reduction_factor too large for this bitstream, max is %d\n", c->nreslevels - 1);
-        s->reduction_factor = c->nreslevels - 1;
+        if (c->nreslevels - 1 >= s->avctx->lowres)
+            s->reduction_factor = c->nreslevels - 1;
         return AVERROR(EINVAL);
     }
 
@@ -519,7 +620,11 @@ static int get_cox(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *c)
     }
 
     c->cblk_style = bytestream2_get_byteu(&s->g);
-    if (c->cblk_style != 0) { // cblk style
+    if (c->cblk_style & JPEG2000_CBLK_HT_MIXED) {
+        avpriv_request_sample(s->avctx, "Mixed HT and Part 1 code blocks");
+        return AVERROR_PATCHWELCOME;
+    }
+    if (c->cblk_style != 0 && c->cblk_style != JPEG2000_CBLK_HT) { // cblk style
         av_log(s->avctx, AV_LOG_WARNING, "extra cblk styles %X\n", c->cblk_style);
         if (c->cblk_style & JPEG2000_CBLK_BYPASS)
             av_log(s->avctx, AV_LOG_WARNING, "Selective arithmetic coding bypass\n");
@@ -913,8 +1018,32 @@ static int get_tlm(Jpeg2000DecoderContext *s, int n)
     return 0;
 }
 
+/* Extended capabilities, listing the parts of ITU-T T.800 series the
+ * codestream needs beyond Part 1. Part 15, High Throughput block coding,
+ * is signaled again by the code-block style of the COD and COC markers. */
+static int get_cap(Jpeg2000DecoderContext *s, int n)
+{
+    uint32_t pcap;
+
+    if (n < 6)
+        return AVERROR_INVALIDDATA;
+
+    pcap = bytestream2_get_be32u(&s->g);
+    if (pcap & ~(1U << (32 - 15)))
+        av_log(s->avctx, AV_LOG_WARNING,
+               "Unsupported extended capabilities %08"PRIX32"\n", pcap);
+    bytestream2_skip(&s->g, n - 6);
+
+    return 0;
+}
+
+/* Packet lengths, tile-part header: see ISO 15444-1:2002, section A.7.3
+ * The lengths of the packets of a tile are stored in the order of the
+ * codestream, they allow decoding its precincts in parallel. */
 static int get_plt(Jpeg2000DecoderContext *s, int n)
 {
+    Jpeg2000Tile *tile = s->tile && s->curtileno >= 0 ? s->tile + s->curtileno : NULL;
+    uint64_t len = 0;
     int i;
     int v;
 
@@ -928,6 +1057,22 @@ static int get_plt(Jpeg2000DecoderContext *s, int n)
 
     for (i = 0; i < n - 3; i++) {
         v = bytestream2_get_byte(&s->g);
+        len = FFMIN(len << 7 | (v & 0x7F), UINT32_MAX);
+        if (v & 0x80)
+            continue;
+        if (tile) {
+            uint32_t *lengths;
+
+            if (tile->nb_packet_lengths >= INT_MAX / sizeof(*lengths))
+                return AVERROR_INVALIDDATA;
+            lengths = av_fast_realloc(tile->packet_lengths, &tile->packet_lengths_allocated,
+                                      (tile->nb_packet_lengths + 1) * sizeof(*lengths));
+            if (!lengths)
+                return AVERROR(ENOMEM);
+            tile->packet_lengths = lengths;
+            tile->packet_lengths[tile->nb_packet_lengths++] = len;
+        }
+        len = 0;
     }
     if (v & 0x80)
         return AVERROR_INVALIDDATA;
@@ -995,6 +1140,48 @@ static int get_ppt(Jpeg2000DecoderContext *s, int n)
     return 0;
 }
 
+/* Reset the decoding state of a component initialized for a previous frame */
+static void reset_component(Jpeg2000Component *comp, Jpeg2000CodingStyle *codsty)
+{
+    size_t csize = (size_t)(comp->coord[0][1] - comp->coord[0][0]) *
+                           (comp->coord[1][1] - comp->coord[1][0]);
+    int reslevelno, bandno, precno, cblkno;
+
+    if (comp->f_data)
+        memset(comp->f_data, 0, csize * sizeof(*comp->f_data));
+    else if (comp->s_data)
+        memset(comp->s_data, 0, csize * sizeof(*comp->s_data));
+    else
+        memset(comp->i_data, 0, csize * sizeof(*comp->i_data));
+
+    for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++) {
+        Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+        for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+            Jpeg2000Band *band = rlevel->band + bandno;
+            for (precno = 0; precno < rlevel->num_precincts_x * rlevel->num_precincts_y; precno++) {
+                Jpeg2000Prec *prec = band->prec + precno;
+
+                prec->decoded_layers = 0;
+                ff_tag_tree_zero(prec->zerobits, prec->nb_codeblocks_width, prec->nb_codeblocks_height, 0);
+                ff_tag_tree_zero(prec->cblkincl, prec->nb_codeblocks_width, prec->nb_codeblocks_height, 0);
+                for (cblkno = 0; cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height; cblkno++) {
+                    Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+                    cblk->npasses            = 0;
+                    cblk->ninclpasses        = 0;
+                    cblk->nonzerobits        = 0;
+                    cblk->length             = 0;
+                    cblk->lblock             = 3;
+                    cblk->ht_plhd            = 0;
+                    cblk->nb_lengthinc       = 0;
+                    cblk->nb_terminations    = 0;
+                    cblk->nb_terminationsinc = 0;
+                    av_freep(&cblk->lengthinc);
+                }
+            }
+        }
+    }
+}
+
 static int init_tile(Jpeg2000DecoderContext *s, int tileno)
 {
     int compno;
@@ -1035,34 +1222,48 @@ static int init_tile(Jpeg2000DecoderContext *s, int tileno)
             comp->roi_shift = s->roi_shift[compno];
         if (!codsty->init)
             return AVERROR_INVALIDDATA;
+
+        /* reuse the component of the previous frame if it was initialized
+         * identically */
+        if (!memcmp(tile->comp_codsty + compno, codsty, sizeof(*codsty)) &&
+            !memcmp(tile->comp_qntsty + compno, qntsty, sizeof(*qntsty))) {
+            reset_component(comp, codsty);
+            continue;
+        }
+
+        ff_jpeg2000_cleanup(comp, tile->comp_codsty + compno);
+        tile->comp_codsty[compno]      = *codsty;
+        tile->comp_codsty[compno].init = 0;
+        tile->comp_qntsty[compno]      = *qntsty;
         if (ret = ff_jpeg2000_init_component(comp, codsty, qntsty,
                                              s->cbps[compno], s->cdx[compno],
                                              s->cdy[compno], s->avctx))
             return ret;
+        tile->comp_codsty[compno].init = codsty->init;
     }
     return 0;
 }
 
 /* Read the number of coding passes. */
-static int getnpasses(Jpeg2000DecoderContext *s)
+static int getnpasses(GetByteContext *g, int *bit_index)
 {
     int num;
-    if (!get_bits(s, 1))
+    if (!get_bits(g, bit_index, 1))
         return 1;
-    if (!get_bits(s, 1))
+    if (!get_bits(g, bit_index, 1))
         return 2;
-    if ((num = get_bits(s, 2)) != 3)
+    if ((num = get_bits(g, bit_index, 2)) != 3)
         return num < 0 ? num : 3 + num;
-    if ((num = get_bits(s, 5)) != 31)
+    if ((num = get_bits(g, bit_index, 5)) != 31)
         return num < 0 ? num : 6 + num;
-    num = get_bits(s, 7);
+    num = get_bits(g, bit_index, 7);
     return num < 0 ? num : 37 + num;
 }
 
-static int getlblockinc(Jpeg2000DecoderContext *s)
+static int getlblockinc(GetByteContext *g, int *bit_index)
 {
     int res = 0, ret;
-    while (ret = get_bits(s, 1)) {
+    while (ret = get_bits(g, bit_index, 1)) {
         if (ret < 0)
             return ret;
         res++;
@@ -1081,6 +1282,17 @@ static inline void select_header(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
     }
 }
 
+static void skip_sop(Jpeg2000DecoderContext *s, GetByteContext *g,
+                     Jpeg2000CodingStyle *codsty)
+{
+    if (codsty->csty & JPEG2000_CSTY_SOP) {
+        if (bytestream2_peek_be32(g) == JPEG2000_SOP_FIXED_BYTES)
+            bytestream2_skip(g, JPEG2000_SOP_BYTE_LENGTH);
+        else
+            av_log(s->avctx, AV_LOG_ERROR, "SOP marker not found. instead %X\n", bytestream2_peek_be32(g));
+    }
+}
+
 static inline void select_stream(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
                                  int *tp_index, Jpeg2000CodingStyle *codsty)
 {
@@ -1090,36 +1302,99 @@ static inline void select_stream(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
             s->g = tile->tile_part[++(*tp_index)].tpg;
         }
     }
-    if (codsty->csty & JPEG2000_CSTY_SOP) {
-        if (bytestream2_peek_be32(&s->g) == JPEG2000_SOP_FIXED_BYTES)
-            bytestream2_skip(&s->g, JPEG2000_SOP_BYTE_LENGTH);
-        else
-            av_log(s->avctx, AV_LOG_ERROR, "SOP marker not found. instead %X\n", bytestream2_peek_be32(&s->g));
+    skip_sop(s, &s->g, codsty);
+}
+
+/* Read the length of a codeword segment of newpasses passes of a code
+ * block, and add it to the contribution of the code block. */
+static int get_lengthinc(Jpeg2000DecoderContext *s, GetByteContext *g, int *bit_index,
+                         Jpeg2000Cblk *cblk, int newpasses)
+{
+    int ret;
+
+    if ((ret = get_bits(g, bit_index, av_log2(newpasses) + cblk->lblock)) < 0)
+        return ret;
+    if (ret > cblk->data_allocated) {
+        size_t new_size = FFMAX(2*cblk->data_allocated, ret);
+        void *new = av_realloc(cblk->data, new_size);
+        if (new) {
+            cblk->data = new;
+            cblk->data_allocated = new_size;
+        }
     }
+    if (ret > cblk->data_allocated) {
+        avpriv_request_sample(s->avctx,
+                            "Block with lengthinc greater than %"SIZE_SPECIFIER"",
+                            cblk->data_allocated);
+        return AVERROR_PATCHWELCOME;
+    }
+    cblk->lengthinc[cblk->nb_lengthinc++] = ret;
+    return ret;
 }
 
-static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile, int *tp_index,
-                                  Jpeg2000CodingStyle *codsty,
-                                  Jpeg2000ResLevel *rlevel, int precno,
-                                  int layno, uint8_t *expn, int numgbits)
+/* Read the lengths of the contribution of a HT code block. Its passes up
+ * to the cleanup pass form one segment, where all the passes before the
+ * cleanup one are empty placeholders, and the SigProp and MagRef passes
+ * which follow it a second one (ITU-T T.814, B.3). */
+static int get_ht_lengths(Jpeg2000DecoderContext *s, GetByteContext *g, int *bit_index,
+                          Jpeg2000Cblk *cblk, int newpasses)
 {
-    int bandno, cblkno, ret, nb_code_blocks;
-    int cwsno;
+    int href, nseg, ret;
 
-    if (layno < rlevel->band[0].prec[precno].decoded_layers)
+    if (cblk->npasses > cblk->ht_plhd) {
+        /* refinement passes of an HT set whose cleanup pass was read */
+        if (cblk->npasses + newpasses > cblk->ht_plhd + 3) {
+            avpriv_request_sample(s->avctx, "Multiple HT sets");
+            return AVERROR_PATCHWELCOME;
+        }
+        if ((ret = get_lengthinc(s, g, bit_index, cblk, newpasses)) < 0)
+            return ret;
+        cblk->npasses += newpasses;
         return 0;
-    rlevel->band[0].prec[precno].decoded_layers = layno + 1;
-    // Select stream to read from
-    if (s->has_ppm)
-        select_header(s, tile, tp_index);
-    else if (tile->has_ppt)
-        s->g = tile->packed_headers_stream;
-    else
-        select_stream(s, tile, tp_index, codsty);
+    }
+
+    href = (cblk->npasses + newpasses - 1) % 3;
+    nseg = newpasses - href;
+    if (nseg > 0) {
+        if ((ret = get_lengthinc(s, g, bit_index, cblk, nseg)) < 0)
+            return ret;
+        if (ret) {
+            cblk->ht_plhd = cblk->npasses + nseg - 1;
+            cblk->nb_terminationsinc++;
+            if (href && (ret = get_lengthinc(s, g, bit_index, cblk, href)) < 0)
+                return ret;
+            cblk->npasses += newpasses;
+            return 0;
+        }
+        /* no cleanup pass, the rest of the length bits is 0 too */
+        cblk->nb_lengthinc--;
+        ret = get_bits(g, bit_index, av_log2(newpasses) - av_log2(nseg));
+    } else {
+        ret = get_bits(g, bit_index, av_log2(newpasses) + cblk->lblock);
+    }
+    if (ret < 0)
+        return ret;
+    if (ret) {
+        avpriv_request_sample(s->avctx, "Mixed HT and Part 1 code blocks");
+        return AVERROR_PATCHWELCOME;
+    }
+    cblk->npasses += newpasses;
+    cblk->ht_plhd  = cblk->npasses;
+    return 0;
+}
 
-    if (!(ret = get_bits(s, 1))) {
-        jpeg2000_flush(s);
-        goto skip_data;
+/* Parse a packet header, up to its EPH marker if any, and store the
+ * lengths of the contributions of its code blocks. */
+static int decode_packet_header(Jpeg2000DecoderContext *s, GetByteContext *g, int *bit_index,
+                                Jpeg2000CodingStyle *codsty,
+                                Jpeg2000ResLevel *rlevel, int precno,
+                                int layno, uint8_t *expn, int numgbits, int drop)
+{
+    int bandno, cblkno, ret, nb_code_blocks;
+
+    if (!(ret = get_bits(g, bit_index, 1))) {
+        jpeg2000_flush(g, bit_index);
+        goto eph;
     } else if (ret < 0)
         return ret;
 
@@ -1138,9 +1413,9 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
             void *tmp;
 
             if (cblk->npasses)
-                incl = get_bits(s, 1);
+                incl = get_bits(g, bit_index, 1);
             else
-                incl = tag_tree_decode(s, prec->cblkincl + cblkno, layno + 1) == layno;
+                incl = tag_tree_decode(s, g, bit_index, prec->cblkincl + cblkno, layno + 1) == layno;
             if (!incl)
                 continue;
             else if (incl < 0)
@@ -1148,7 +1423,7 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
 
             if (!cblk->npasses) {
                 int v = expn[bandno] + numgbits - 1 -
-                        tag_tree_decode(s, prec->zerobits + cblkno, 100);
+                        tag_tree_decode(s, g, bit_index, prec->zerobits + cblkno, 100);
                 if (v < 0 || v > 30) {
                     av_log(s->avctx, AV_LOG_ERROR,
                            "nonzerobits %d invalid or unsupported\n", v);
@@ -1156,14 +1431,14 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
                 }
                 cblk->nonzerobits = v;
             }
-            if ((newpasses = getnpasses(s)) < 0)
+            if ((newpasses = getnpasses(g, bit_index)) < 0)
                 return newpasses;
             av_assert2(newpasses > 0);
             if (cblk->npasses + newpasses >= JPEG2000_MAX_PASSES) {
                 avpriv_request_sample(s->avctx, "Too many passes");
                 return AVERROR_PATCHWELCOME;
             }
-            if ((llen = getlblockinc(s)) < 0)
+            if ((llen = getlblockinc(g, bit_index)) < 0)
                 return llen;
             if (cblk->lblock + llen + av_log2(newpasses) > 16) {
                 avpriv_request_sample(s->avctx,
@@ -1183,7 +1458,10 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
             if (!tmp)
                 return AVERROR(ENOMEM);
             cblk->data_start = tmp;
-            do {
+            if (codsty->cblk_style & JPEG2000_CBLK_HT) {
+                if ((ret = get_ht_lengths(s, g, bit_index, cblk, newpasses)) < 0)
+                    return ret;
+            } else do {
                 int newpasses1 = 0;
 
                 while (newpasses1 < newpasses) {
@@ -1194,45 +1472,34 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
                     }
                 }
 
-                if ((ret = get_bits(s, av_log2(newpasses1) + cblk->lblock)) < 0)
+                if ((ret = get_lengthinc(s, g, bit_index, cblk, newpasses1)) < 0)
                     return ret;
-                if (ret > cblk->data_allocated) {
-                    size_t new_size = FFMAX(2*cblk->data_allocated, ret);
-                    void *new = av_realloc(cblk->data, new_size);
-                    if (new) {
-                        cblk->data = new;
-                        cblk->data_allocated = new_size;
-                    }
-                }
-                if (ret > cblk->data_allocated) {
-                    avpriv_request_sample(s->avctx,
-                                        "Block with lengthinc greater than %"SIZE_SPECIFIER"",
-                                        cblk->data_allocated);
-                    return AVERROR_PATCHWELCOME;
-                }
-                cblk->lengthinc[cblk->nb_lengthinc++] = ret;
                 cblk->npasses  += newpasses1;
                 newpasses -= newpasses1;
             } while(newpasses);
+            if (!drop)
+                cblk->ninclpasses = cblk->npasses;
         }
     }
-    jpeg2000_flush(s);
+    jpeg2000_flush(g, bit_index);
 
+eph:
     if (codsty->csty & JPEG2000_CSTY_EPH) {
-        if (bytestream2_peek_be16(&s->g) == JPEG2000_EPH)
-            bytestream2_skip(&s->g, 2);
+        if (bytestream2_peek_be16(g) == JPEG2000_EPH)
+            bytestream2_skip(g, 2);
         else
-            av_log(s->avctx, AV_LOG_ERROR, "EPH marker not found. instead %X\n", bytestream2_peek_be32(&s->g));
+            av_log(s->avctx, AV_LOG_ERROR, "EPH marker not found. instead %X\n", bytestream2_peek_be32(g));
     }
+    return 0;
+}
+
+/* Read the packet body: append the contributions listed by the header to
+ * the data of the code blocks, or skip them for the dropped layers. */
+static int decode_packet_body(Jpeg2000DecoderContext *s, GetByteContext *g,
+                              Jpeg2000ResLevel *rlevel, int precno, int drop)
+{
+    int bandno, cblkno, cwsno, nb_code_blocks;
 
-    // Save state of stream
-    if (s->has_ppm) {
-        tile->tile_part[*tp_index].header_tpg = s->g;
-        select_stream(s, tile, tp_index, codsty);
-    } else if (tile->has_ppt) {
-        tile->packed_headers_stream = s->g;
-        select_stream(s, tile, tp_index, codsty);
-    }
     for (bandno = 0; bandno < rlevel->nbands; bandno++) {
         Jpeg2000Band *band = rlevel->band + bandno;
         Jpeg2000Prec *prec = band->prec + precno;
@@ -1242,6 +1509,20 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
             Jpeg2000Cblk *cblk = prec->cblk + cblkno;
             if (!cblk->nb_terminationsinc && !cblk->lengthinc)
                 continue;
+            if (drop) {
+                for (cwsno = 0; cwsno < cblk->nb_lengthinc; cwsno++) {
+                    if (bytestream2_get_bytes_left(g) < cblk->lengthinc[cwsno]) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "Lengthinc %d is too large, left %d\n",
+                               cblk->lengthinc[cwsno], bytestream2_get_bytes_left(g));
+                        return AVERROR_INVALIDDATA;
+                    }
+                    bytestream2_skipu(g, cblk->lengthinc[cwsno]);
+                }
+                cblk->nb_terminationsinc = 0;
+                av_freep(&cblk->lengthinc);
+                continue;
+            }
             for (cwsno = 0; cwsno < cblk->nb_lengthinc; cwsno ++) {
                 if (cblk->data_allocated < cblk->length + cblk->lengthinc[cwsno] + 4) {
                     size_t new_size = FFMAX(2*cblk->data_allocated, cblk->length + cblk->lengthinc[cwsno] + 4);
@@ -1251,16 +1532,16 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
                         cblk->data_allocated = new_size;
                     }
                 }
-                if (   bytestream2_get_bytes_left(&s->g) < cblk->lengthinc[cwsno]
+                if (   bytestream2_get_bytes_left(g) < cblk->lengthinc[cwsno]
                     || cblk->data_allocated < cblk->length + cblk->lengthinc[cwsno] + 4
                 ) {
                     av_log(s->avctx, AV_LOG_ERROR,
                         "Block length %"PRIu16" or lengthinc %d is too large, left %d\n",
-                        cblk->length, cblk->lengthinc[cwsno], bytestream2_get_bytes_left(&s->g));
+                        cblk->length, cblk->lengthinc[cwsno], bytestream2_get_bytes_left(g));
                     return AVERROR_INVALIDDATA;
                 }
 
-                bytestream2_get_bufferu(&s->g, cblk->data + cblk->length, cblk->lengthinc[cwsno]);
+                bytestream2_get_bufferu(g, cblk->data + cblk->length, cblk->lengthinc[cwsno]);
                 cblk->length   += cblk->lengthinc[cwsno];
                 cblk->lengthinc[cwsno] = 0;
                 if (cblk->nb_terminationsinc) {
@@ -1274,17 +1555,61 @@ static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
             av_freep(&cblk->lengthinc);
         }
     }
-    // Save state of stream
-    tile->tile_part[*tp_index].tpg = s->g;
     return 0;
+}
 
-skip_data:
-    if (codsty->csty & JPEG2000_CSTY_EPH) {
-        if (bytestream2_peek_be16(&s->g) == JPEG2000_EPH)
-            bytestream2_skip(&s->g, 2);
-        else
-            av_log(s->avctx, AV_LOG_ERROR, "EPH marker not found. instead %X\n", bytestream2_peek_be32(&s->g));
+static int jpeg2000_decode_packet(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile, int *tp_index,
+                                  Jpeg2000CodingStyle *codsty,
+                                  Jpeg2000ResLevel *rlevel, int precno,
+                                  int layno, uint8_t *expn, int numgbits)
+{
+    int ret;
+    /* the headers of the packets of the dropped layers and resolution levels
+     * are still parsed, but their bodies are skipped */
+    int drop = (s->max_quality_layers && layno >= s->max_quality_layers) ||
+               rlevel - tile->comp[codsty - tile->codsty].reslevel >= codsty->nreslevels2decode;
+
+    if (layno < rlevel->band[0].prec[precno].decoded_layers)
+        return 0;
+    rlevel->band[0].prec[precno].decoded_layers = layno + 1;
+
+    /* only list the packets, to decode them per precinct */
+    if (s->list_packets) {
+        Jpeg2000Packet *packet;
+        int compno = codsty - tile->codsty;
+
+        if (s->nb_packets >= INT_MAX / sizeof(*s->packets))
+            return AVERROR(ENOMEM);
+        packet = av_fast_realloc(s->packets, &s->packets_allocated,
+                                 (s->nb_packets + 1) * sizeof(*s->packets));
+        if (!packet)
+            return AVERROR(ENOMEM);
+        s->packets = packet;
+        packet = s->packets + s->nb_packets++;
+        packet->codsty     = codsty;
+        packet->rlevel     = rlevel;
+        packet->expn       = expn;
+        packet->numgbits   = numgbits;
+        packet->compno     = compno;
+        packet->reslevelno = rlevel - tile->comp[compno].reslevel;
+        packet->precno     = precno;
+        packet->layno      = layno;
+        return 0;
     }
+
+    // Select stream to read from
+    if (s->has_ppm)
+        select_header(s, tile, tp_index);
+    else if (tile->has_ppt)
+        s->g = tile->packed_headers_stream;
+    else
+        select_stream(s, tile, tp_index, codsty);
+
+    if ((ret = decode_packet_header(s, &s->g, &s->bit_index, codsty, rlevel,
+                                    precno, layno, expn, numgbits, drop)) < 0)
+        return ret;
+
+    // Save state of stream
     if (s->has_ppm) {
         tile->tile_part[*tp_index].header_tpg = s->g;
         select_stream(s, tile, tp_index, codsty);
@@ -1292,6 +1617,11 @@ skip_data:
         tile->packed_headers_stream = s->g;
         select_stream(s, tile, tp_index, codsty);
     }
+
+    if ((ret = decode_packet_body(s, &s->g, rlevel, precno, drop)) < 0)
+        return ret;
+
+    // Save state of stream
     tile->tile_part[*tp_index].tpg = s->g;
     return 0;
 }
@@ -1608,10 +1938,21 @@ static int jpeg2000_decode_packets(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
                 return ret;
         }
     } else {
+        int REpoc = 33;
+
+        /* the packets of the resolution levels which are not decoded come
+         * last in the resolution major orders, they are not parsed */
+        if (!s->list_packets &&
+            (tile->codsty[0].prog_order == JPEG2000_PGOD_RLCP ||
+             tile->codsty[0].prog_order == JPEG2000_PGOD_RPCL)) {
+            REpoc = 0;
+            for (i = 0; i < s->ncomponents; i++)
+                REpoc = FFMAX(REpoc, tile->codsty[i].nreslevels2decode);
+        }
         ret = jpeg2000_decode_packets_po_iteration(s, tile,
             0, 0,
             tile->codsty[0].nlayers,
-            33,
+            REpoc,
             s->ncomponents,
             tile->codsty[0].prog_order,
             &tp_index
@@ -1623,39 +1964,50 @@ static int jpeg2000_decode_packets(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
     return ret;
 }
 
-/* TIER-1 routines */
-static void decode_sigpass(Jpeg2000T1Context *t1, int width, int height,
-                           int bpno, int bandno,
-                           int vert_causal_ctx_csty_symbol)
+/* TIER-1 routines
+ * The passes are inlined into kernels specialized for a code-block size and
+ * the vertically causal context. full_stripes is set when the height is a
+ * multiple of 4, which makes every stripe loop a fixed 4 rows. */
+static av_always_inline void decode_sigpass(Jpeg2000T1Context *t1, int width, int height,
+                                            int stride, int full_stripes,
+                                            int bpno, int bandno,
+                                            int vert_causal_ctx_csty_symbol)
 {
     int mask = 3 << (bpno - 1), y0, x, y;
 
     for (y0 = 0; y0 < height; y0 += 4)
-        for (x = 0; x < width; x++)
-            for (y = y0; y < height && y < y0 + 4; y++) {
+        for (x = 0; x < width; x++) {
+            const uint16_t *f = &t1->flags[(y0 + 1) * stride + x + 1];
+            /* nothing to decode in a stripe column without significant neighbours */
+            if ((full_stripes || y0 + 3 < height) &&
+                !((f[0] | f[stride] | f[2 * stride] | f[3 * stride]) & JPEG2000_T1_SIG_NB))
+                continue;
+            for (y = y0; y < y0 + 4 && (full_stripes || y < height); y++) {
                 int flags_mask = -1;
                 if (vert_causal_ctx_csty_symbol && y == y0 + 3)
                     flags_mask &= ~(JPEG2000_T1_SIG_S | JPEG2000_T1_SIG_SW | JPEG2000_T1_SIG_SE | JPEG2000_T1_SGN_S);
-                if ((t1->flags[(y+1) * t1->stride + x+1] & JPEG2000_T1_SIG_NB & flags_mask)
-                && !(t1->flags[(y+1) * t1->stride + x+1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS))) {
-                    if (ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ff_jpeg2000_getsigctxno(t1->flags[(y+1) * t1->stride + x+1] & flags_mask, bandno))) {
-                        int xorbit, ctxno = ff_jpeg2000_getsgnctxno(t1->flags[(y+1) * t1->stride + x+1] & flags_mask, &xorbit);
+                if ((t1->flags[(y+1) * stride + x+1] & JPEG2000_T1_SIG_NB & flags_mask)
+                && !(t1->flags[(y+1) * stride + x+1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS))) {
+                    if (ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ff_jpeg2000_getsigctxno(t1->flags[(y+1) * stride + x+1] & flags_mask, bandno))) {
+                        int xorbit, ctxno = ff_jpeg2000_getsgnctxno(t1->flags[(y+1) * stride + x+1] & flags_mask, &xorbit);
                         if (t1->mqc.raw)
-                             t1->data[(y) * t1->stride + x] = ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ctxno) ? -mask : mask;
+                             t1->data[(y) * stride + x] = ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ctxno) ? -mask : mask;
                         else
-                             t1->data[(y) * t1->stride + x] = (ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ctxno) ^ xorbit) ?
+                             t1->data[(y) * stride + x] = (ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ctxno) ^ xorbit) ?
                                                -mask : mask;
 
                         ff_jpeg2000_set_significance(t1, x, y,
-                                                     t1->data[(y) * t1->stride + x] < 0);
+                                                     t1->data[(y) * stride + x] < 0);
                     }
-                    t1->flags[(y + 1) * t1->stride + x + 1] |= JPEG2000_T1_VIS;
+                    t1->flags[(y + 1) * stride + x + 1] |= JPEG2000_T1_VIS;
                 }
             }
+        }
 }
 
-static void decode_refpass(Jpeg2000T1Context *t1, int width, int height,
-                           int bpno, int vert_causal_ctx_csty_symbol)
+static av_always_inline void decode_refpass(Jpeg2000T1Context *t1, int width, int height,
+                                            int stride, int full_stripes,
+                                            int bpno, int vert_causal_ctx_csty_symbol)
 {
     int phalf, nhalf;
     int y0, x, y;
@@ -1664,23 +2016,30 @@ static void decode_refpass(Jpeg2000T1Context *t1, int width, int height,
     nhalf = -phalf;
 
     for (y0 = 0; y0 < height; y0 += 4)
-        for (x = 0; x < width; x++)
-            for (y = y0; y < height && y < y0 + 4; y++)
-                if ((t1->flags[(y + 1) * t1->stride + x + 1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS)) == JPEG2000_T1_SIG) {
+        for (x = 0; x < width; x++) {
+            const uint16_t *f = &t1->flags[(y0 + 1) * stride + x + 1];
+            if ((full_stripes || y0 + 3 < height) &&
+                !((f[0] | f[stride] | f[2 * stride] | f[3 * stride]) & JPEG2000_T1_SIG))
+                continue;
+            for (y = y0; y < y0 + 4 && (full_stripes || y < height); y++)
+                if ((t1->flags[(y + 1) * stride + x + 1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS)) == JPEG2000_T1_SIG) {
                     int flags_mask = (vert_causal_ctx_csty_symbol && y == y0 + 3) ?
                         ~(JPEG2000_T1_SIG_S | JPEG2000_T1_SIG_SW | JPEG2000_T1_SIG_SE | JPEG2000_T1_SGN_S) : -1;
-                    int ctxno = ff_jpeg2000_getrefctxno(t1->flags[(y + 1) * t1->stride + x + 1] & flags_mask);
+                    int ctxno = ff_jpeg2000_getrefctxno(t1->flags[(y + 1) * stride + x + 1] & flags_mask);
                     int r     = ff_mqc_decode(&t1->mqc,
                                               t1->mqc.cx_states + ctxno)
                                 ? phalf : nhalf;
-                    t1->data[(y) * t1->stride + x]          += t1->data[(y) * t1->stride + x] < 0 ? -r : r;
-                    t1->flags[(y + 1) * t1->stride + x + 1] |= JPEG2000_T1_REF;
+                    t1->data[(y) * stride + x]          += t1->data[(y) * stride + x] < 0 ? -r : r;
+                    t1->flags[(y + 1) * stride + x + 1] |= JPEG2000_T1_REF;
                 }
+        }
 }
 
-static void decode_clnpass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
-                           int width, int height, int bpno, int bandno,
-                           int seg_symbols, int vert_causal_ctx_csty_symbol)
+static av_always_inline void decode_clnpass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
+                                            int width, int height,
+                                            int stride, int full_stripes,
+                                            int bpno, int bandno, int seg_symbols,
+                                            int vert_causal_ctx_csty_symbol)
 {
     int mask = 3 << (bpno - 1), y0, x, y, runlen, dec;
 
@@ -1689,11 +2048,11 @@ static void decode_clnpass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
             int flags_mask = -1;
             if (vert_causal_ctx_csty_symbol)
                 flags_mask &= ~(JPEG2000_T1_SIG_S | JPEG2000_T1_SIG_SW | JPEG2000_T1_SIG_SE | JPEG2000_T1_SGN_S);
-            if (y0 + 3 < height &&
-                !((t1->flags[(y0 + 1) * t1->stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
-                  (t1->flags[(y0 + 2) * t1->stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
-                  (t1->flags[(y0 + 3) * t1->stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
-                  (t1->flags[(y0 + 4) * t1->stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG) & flags_mask))) {
+            if ((full_stripes || y0 + 3 < height) &&
+                !((t1->flags[(y0 + 1) * stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
+                  (t1->flags[(y0 + 2) * stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
+                  (t1->flags[(y0 + 3) * stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG)) ||
+                  (t1->flags[(y0 + 4) * stride + x + 1] & (JPEG2000_T1_SIG_NB | JPEG2000_T1_VIS | JPEG2000_T1_SIG) & flags_mask))) {
                 if (!ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + MQC_CX_RL))
                     continue;
                 runlen = ff_mqc_decode(&t1->mqc,
@@ -1707,28 +2066,28 @@ static void decode_clnpass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
                 dec    = 0;
             }
 
-            for (y = y0 + runlen; y < y0 + 4 && y < height; y++) {
+            for (y = y0 + runlen; y < y0 + 4 && (full_stripes || y < height); y++) {
                 int flags_mask = -1;
                 if (vert_causal_ctx_csty_symbol && y == y0 + 3)
                     flags_mask &= ~(JPEG2000_T1_SIG_S | JPEG2000_T1_SIG_SW | JPEG2000_T1_SIG_SE | JPEG2000_T1_SGN_S);
                 if (!dec) {
-                    if (!(t1->flags[(y+1) * t1->stride + x+1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS))) {
-                        dec = ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ff_jpeg2000_getsigctxno(t1->flags[(y+1) * t1->stride + x+1] & flags_mask,
+                    if (!(t1->flags[(y+1) * stride + x+1] & (JPEG2000_T1_SIG | JPEG2000_T1_VIS))) {
+                        dec = ff_mqc_decode(&t1->mqc, t1->mqc.cx_states + ff_jpeg2000_getsigctxno(t1->flags[(y+1) * stride + x+1] & flags_mask,
                                                                                              bandno));
                     }
                 }
                 if (dec) {
                     int xorbit;
-                    int ctxno = ff_jpeg2000_getsgnctxno(t1->flags[(y + 1) * t1->stride + x + 1] & flags_mask,
+                    int ctxno = ff_jpeg2000_getsgnctxno(t1->flags[(y + 1) * stride + x + 1] & flags_mask,
                                                         &xorbit);
-                    t1->data[(y) * t1->stride + x] = (ff_mqc_decode(&t1->mqc,
+                    t1->data[(y) * stride + x] = (ff_mqc_decode(&t1->mqc,
                                                     t1->mqc.cx_states + ctxno) ^
                                       xorbit)
                                      ? -mask : mask;
-                    ff_jpeg2000_set_significance(t1, x, y, t1->data[(y) * t1->stride + x] < 0);
+                    ff_jpeg2000_set_significance(t1, x, y, t1->data[(y) * stride + x] < 0);
                 }
                 dec = 0;
-                t1->flags[(y + 1) * t1->stride + x + 1] &= ~JPEG2000_T1_VIS;
+                t1->flags[(y + 1) * stride + x + 1] &= ~JPEG2000_T1_VIS;
             }
         }
     }
@@ -1744,13 +2103,101 @@ static void decode_clnpass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
     }
 }
 
+/* Decode one coding pass of a code block: 0 significance propagation,
+ * 1 magnitude refinement, 2 cleanup. */
+typedef void (*T1PassFunc)(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
+                           int pass_t, int width, int height,
+                           int bpno, int bandno, int seg_symbols);
+
+/* A kernel for code blocks of width x height (0 for any size) with or
+ * without the vertically causal context, and the one for the smaller code
+ * blocks at the band edges. */
+typedef struct Jpeg2000T1Kernel {
+    int width, height;
+    int vsc;
+    T1PassFunc decode_pass;
+    T1PassFunc decode_pass_partial;
+} Jpeg2000T1Kernel;
+
+static av_always_inline void decode_pass(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
+                                         int pass_t, int width, int height,
+                                         int bpno, int bandno, int seg_symbols,
+                                         int cblk_width, int cblk_height, int vsc)
+{
+    int stride       = cblk_width ? cblk_width + 2 : t1->stride;
+    int full_stripes = cblk_height && !(cblk_height & 3);
+
+    if (cblk_width)
+        width  = cblk_width;
+    if (cblk_height)
+        height = cblk_height;
+
+    switch (pass_t) {
+    case 0:
+        decode_sigpass(t1, width, height, stride, full_stripes, bpno, bandno, vsc);
+        break;
+    case 1:
+        decode_refpass(t1, width, height, stride, full_stripes, bpno, vsc);
+        break;
+    case 2:
+        av_assert2(!t1->mqc.raw);
+        decode_clnpass(s, t1, width, height, stride, full_stripes, bpno, bandno,
+                       seg_symbols, vsc);
+        break;
+    }
+}
+
+#define T1_KERNEL(name, cblk_width, cblk_height, vsc)                           \
+static void decode_pass_ ## name(Jpeg2000DecoderContext *s,                     \
+                                 Jpeg2000T1Context *t1, int pass_t,             \
+                                 int width, int height,                         \
+                                 int bpno, int bandno, int seg_symbols)         \
+{                                                                               \
+    decode_pass(s, t1, pass_t, width, height, bpno, bandno, seg_symbols,        \
+                cblk_width, cblk_height, vsc);                                  \
+}
+
+T1_KERNEL(generic,     0,  0, 0)
+T1_KERNEL(generic_vsc, 0,  0, JPEG2000_CBLK_VSC)
+T1_KERNEL(32x32,      32, 32, 0)
+T1_KERNEL(32x32_vsc,  32, 32, JPEG2000_CBLK_VSC)
+T1_KERNEL(64x64,      64, 64, 0)
+T1_KERNEL(64x64_vsc,  64, 64, JPEG2000_CBLK_VSC)
+
+static const Jpeg2000T1Kernel t1_kernels[] = {
+    { 32, 32, 0,                 decode_pass_32x32,       decode_pass_generic     },
+    { 32, 32, JPEG2000_CBLK_VSC, decode_pass_32x32_vsc,   decode_pass_generic_vsc },
+    { 64, 64, 0,                 decode_pass_64x64,       decode_pass_generic     },
+    { 64, 64, JPEG2000_CBLK_VSC, decode_pass_64x64_vsc,   decode_pass_generic_vsc },
+    {  0,  0, 0,                 decode_pass_generic,     decode_pass_generic     },
+    {  0,  0, JPEG2000_CBLK_VSC, decode_pass_generic_vsc, decode_pass_generic_vsc },
+};
+
+static const Jpeg2000T1Kernel *t1_kernel(const Jpeg2000CodingStyle *codsty)
+{
+    int vsc = codsty->cblk_style & JPEG2000_CBLK_VSC;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(t1_kernels); i++) {
+        const Jpeg2000T1Kernel *k = &t1_kernels[i];
+        if (k->vsc == vsc &&
+            (!k->width || (k->width  == 1 << codsty->log2_cblk_width &&
+                           k->height == 1 << codsty->log2_cblk_height)))
+            return k;
+    }
+    av_assert0(0);
+}
+
 static int decode_cblk(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *codsty,
+                       const Jpeg2000T1Kernel *t1k,
                        Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk,
                        int width, int height, int bandpos, uint8_t roi_shift)
 {
-    int passno = cblk->npasses, pass_t = 2, bpno = cblk->nonzerobits - 1 + roi_shift;
+    int passno = cblk->ninclpasses, pass_t = 2, bpno = cblk->nonzerobits - 1 + roi_shift;
     int pass_cnt = 0;
-    int vert_causal_ctx_csty_symbol = codsty->cblk_style & JPEG2000_CBLK_VSC;
+    int seg_symbols = codsty->cblk_style & JPEG2000_CBLK_SEGSYM;
+    T1PassFunc decode_pass = width == t1k->width && height == t1k->height ?
+                             t1k->decode_pass : t1k->decode_pass_partial;
     int term_cnt = 0;
     int coder_type;
 
@@ -1763,6 +2210,12 @@ static int decode_cblk(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *codsty,
     if (!cblk->length)
         return 0;
 
+    if (codsty->cblk_style & JPEG2000_CBLK_HT) {
+        int ret = ff_jpeg2000_decode_htj2k(s->avctx, codsty, t1, cblk,
+                                           width, height, roi_shift);
+        return ret < 0 ? ret : 1;
+    }
+
     memset(t1->flags, 0, t1->stride * (height + 2) * sizeof(*t1->flags));
 
     cblk->data[cblk->length] = 0xff;
@@ -1774,21 +2227,7 @@ static int decode_cblk(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *codsty,
             av_log(s->avctx, AV_LOG_ERROR, "bpno became invalid\n");
             return AVERROR_INVALIDDATA;
         }
-        switch(pass_t) {
-        case 0:
-            decode_sigpass(t1, width, height, bpno + 1, bandpos,
-                           vert_causal_ctx_csty_symbol);
-            break;
-        case 1:
-            decode_refpass(t1, width, height, bpno + 1, vert_causal_ctx_csty_symbol);
-            break;
-        case 2:
-            av_assert2(!t1->mqc.raw);
-            decode_clnpass(s, t1, width, height, bpno + 1, bandpos,
-                           codsty->cblk_style & JPEG2000_CBLK_SEGSYM,
-                           vert_causal_ctx_csty_symbol);
-            break;
-        }
+        decode_pass(s, t1, pass_t, width, height, bpno + 1, bandpos, seg_symbols);
         if (codsty->cblk_style & JPEG2000_CBLK_RESET) // XXX no testcase for just this
             ff_mqc_init_contexts(&t1->mqc);
 
@@ -1800,7 +2239,7 @@ static int decode_cblk(Jpeg2000DecoderContext *s, Jpeg2000CodingStyle *codsty,
             if (FFABS(cblk->data + cblk->data_start[term_cnt + 1] - 2 - t1->mqc.bp) > 0) {
                 av_log(s->avctx, AV_LOG_WARNING, "Mid mismatch %"PTRDIFF_SPECIFIER" in pass %d of %d\n",
                     cblk->data + cblk->data_start[term_cnt + 1] - 2 - t1->mqc.bp,
-                    pass_cnt, cblk->npasses);
+                    pass_cnt, cblk->ninclpasses);
             }
 
             ff_mqc_initdec(&t1->mqc, cblk->data + cblk->data_start[++term_cnt], coder_type == 2, 0);
@@ -1881,6 +2320,26 @@ static void dequantization_int(int x, int y, Jpeg2000Cblk *cblk,
     }
 }
 
+/* Integer dequantization of a codeblock to 16-bit coefficients. */
+static void dequantization_int16(int x, int y, Jpeg2000Cblk *cblk,
+                                 Jpeg2000Component *comp,
+                                 Jpeg2000T1Context *t1, Jpeg2000Band *band)
+{
+    int i, j;
+    int w = cblk->coord[0][1] - cblk->coord[0][0];
+    for (j = 0; j < (cblk->coord[1][1] - cblk->coord[1][0]); ++j) {
+        int16_t *datap = &comp->s_data[(comp->coord[0][1] - comp->coord[0][0]) * (y + j) + x];
+        int *src = t1->data + j*t1->stride;
+        if (band->i_stepsize == 32768) {
+            for (i = 0; i < w; ++i)
+                datap[i] = av_clip_int16(src[i] / 2);
+        } else {
+            for (i = 0; i < w; ++i)
+                datap[i] = av_clip_int16((src[i] * (int64_t)band->i_stepsize) / 65536);
+        }
+    }
+}
+
 static void dequantization_int_97(int x, int y, Jpeg2000Cblk *cblk,
                                Jpeg2000Component *comp,
                                Jpeg2000T1Context *t1, Jpeg2000Band *band)
@@ -1895,13 +2354,24 @@ static void dequantization_int_97(int x, int y, Jpeg2000Cblk *cblk,
     }
 }
 
+/* Coefficients of a component, in the type used by its DWT */
+static void *component_data(Jpeg2000Component *comp)
+{
+    if (comp->f_data)
+        return comp->f_data;
+    if (comp->s_data)
+        return comp->s_data;
+    return comp->i_data;
+}
+
 static inline void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
 {
     int i, csize = 1;
     void *src[3];
 
     for (i = 1; i < 3; i++) {
-        if (tile->codsty[0].transform != tile->codsty[i].transform) {
+        if (tile->codsty[0].transform != tile->codsty[i].transform ||
+            tile->comp[0].dwt.type != tile->comp[i].dwt.type) {
             av_log(s->avctx, AV_LOG_ERROR, "Transforms mismatch, MCT not supported\n");
             return;
         }
@@ -1912,15 +2382,12 @@ static inline void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
     }
 
     for (i = 0; i < 3; i++)
-        if (tile->codsty[0].transform == FF_DWT97)
-            src[i] = tile->comp[i].f_data;
-        else
-            src[i] = tile->comp[i].i_data;
+        src[i] = component_data(tile->comp + i);
 
     for (i = 0; i < 2; i++)
         csize *= tile->comp[0].coord[i][1] - tile->comp[0].coord[i][0];
 
-    s->dsp.mct_decode[tile->codsty[0].transform](src[0], src[1], src[2], csize);
+    s->dsp.mct_decode[tile->comp[0].dwt.type](src[0], src[1], src[2], csize);
 }
 
 static inline void roi_scale_cblk(Jpeg2000Cblk *cblk,
@@ -1936,77 +2403,407 @@ static inline void roi_scale_cblk(Jpeg2000Cblk *cblk,
     }
 }
 
-static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
+/* A code block to decode and dequantize, as a job of the slice threads */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component *comp;
+    Jpeg2000CodingStyle *codsty;
+    const Jpeg2000T1Kernel *t1k;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    int bandpos;
+    int compidx; // index of the component in the tiles, tileno * ncomponents + compno
+    int coded;
+} Jpeg2000CblkJob;
+
+/* Units [start, end) of a step of the inverse DWT of a component */
+typedef struct Jpeg2000DWTJob {
+    DWTContext *dwt;
+    void *data;
+    int step;
+    int start, end;
+} Jpeg2000DWTJob;
+
+/* Check whether the coefficients of the band area x0..x1, y0..y1 cannot
+ * reach the decode window. The inverse DWT spreads a coefficient at a given
+ * level over less than 5 of its samples on each side, scaled to the
+ * component. */
+static int outside_window(Jpeg2000DecoderContext *s, int compno, int level,
+                          int x0, int x1, int y0, int y1)
 {
-    Jpeg2000T1Context t1;
+    int cdx = s->cdx[compno], cdy = s->cdy[compno];
+    int64_t scale = INT64_C(1) << level;
+    int64_t wx0, wx1, wy0, wy1;
+
+    if (!s->window[0][1])
+        return 0;
+
+    wx0 = s->window[0][0] / cdx + ff_jpeg2000_ceildiv(s->image_offset_x, cdx);
+    wx1 = ff_jpeg2000_ceildiv(s->window[0][1], cdx) + ff_jpeg2000_ceildiv(s->image_offset_x, cdx);
+    wy0 = s->window[1][0] / cdy + ff_jpeg2000_ceildiv(s->image_offset_y, cdy);
+    wy1 = ff_jpeg2000_ceildiv(s->window[1][1], cdy) + ff_jpeg2000_ceildiv(s->image_offset_y, cdy);
+
+    return (x1 + 5) * scale <= wx0 || (x0 - 5) * scale >= wx1 ||
+           (y1 + 5) * scale <= wy0 || (y0 - 5) * scale >= wy1;
+}
 
-    int compno, reslevelno, bandno;
+/* List the code blocks to decode of a precinct of a component of a tile. */
+static unsigned precinct_codeblock_jobs(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                                        int compno, int reslevelno, int precno,
+                                        Jpeg2000CblkJob *jobs, int compidx)
+{
+    Jpeg2000Component *comp     = tile->comp + compno;
+    Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+    Jpeg2000ResLevel *rlevel    = comp->reslevel + reslevelno;
+    const Jpeg2000T1Kernel *t1k = t1_kernel(codsty);
+    /* decomposition level of the bands, in the decoded resolution */
+    int level = codsty->nreslevels2decode - reslevelno - !reslevelno;
+    int bandno, cblkno;
+    unsigned nb_jobs = 0;
+
+    if (reslevelno >= codsty->nreslevels2decode)
+        return 0;
+
+    /* Loop on bands */
+    for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+        int nb_codeblocks, offx = 0, offy = 0;
+        Jpeg2000Band *band = rlevel->band + bandno;
+        Jpeg2000Prec *prec = band->prec + precno;
+
+        /* the code blocks of the high pass bands are placed after
+         * the lower resolution level, cf. init_prec() */
+        if ((bandno + !!reslevelno) & 1)
+            offx = comp->reslevel[reslevelno - 1].coord[0][1] -
+                   comp->reslevel[reslevelno - 1].coord[0][0];
+        if ((bandno + !!reslevelno) & 2)
+            offy = comp->reslevel[reslevelno - 1].coord[1][1] -
+                   comp->reslevel[reslevelno - 1].coord[1][0];
+
+        if (band->coord[0][0] == band->coord[0][1] ||
+            band->coord[1][0] == band->coord[1][1])
+            continue;
+
+        if (outside_window(s, compno, level,
+                           prec->coord[0][0], prec->coord[0][1],
+                           prec->coord[1][0], prec->coord[1][1]))
+            continue;
+
+        nb_codeblocks = prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+        /* Loop on codeblocks */
+        for (cblkno = 0; cblkno < nb_codeblocks; cblkno++) {
+            Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+
+            if (outside_window(s, compno, level,
+                               cblk->coord[0][0] - offx, cblk->coord[0][1] - offx,
+                               cblk->coord[1][0] - offy, cblk->coord[1][1] - offy))
+                continue;
+            if (jobs) {
+                Jpeg2000CblkJob *job = jobs + nb_jobs;
+                job->comp    = comp;
+                job->codsty  = codsty;
+                job->t1k     = t1k;
+                job->band    = band;
+                job->cblk    = cblk;
+                job->bandpos = bandno + (reslevelno > 0);
+                job->compidx = compidx + compno;
+                job->coded   = 0;
+            }
+            nb_jobs++;
+        }
+    } /* end band */
+
+    return nb_jobs;
+}
+
+static unsigned tile_codeblock_jobs(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                                    Jpeg2000CblkJob *jobs, int compidx)
+{
+    int compno, reslevelno, precno;
+    unsigned nb_jobs = 0;
 
     /* Loop on tile components */
     for (compno = 0; compno < s->ncomponents; compno++) {
         Jpeg2000Component *comp     = tile->comp + compno;
         Jpeg2000CodingStyle *codsty = tile->codsty + compno;
-        int coded = 0;
-
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
 
         /* Loop on resolution levels */
         for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
             Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
-            /* Loop on bands */
-            for (bandno = 0; bandno < rlevel->nbands; bandno++) {
-                int nb_precincts, precno;
-                Jpeg2000Band *band = rlevel->band + bandno;
-                int cblkno = 0, bandpos;
+            int nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
 
-                bandpos = bandno + (reslevelno > 0);
+            /* Loop on precincts */
+            for (precno = 0; precno < nb_precincts; precno++)
+                nb_jobs += precinct_codeblock_jobs(s, tile, compno, reslevelno, precno,
+                                                   jobs ? jobs + nb_jobs : NULL, compidx);
+        } /* end reslevel */
+    } /*end comp */
 
-                if (band->coord[0][0] == band->coord[0][1] ||
-                    band->coord[1][0] == band->coord[1][1])
-                    continue;
+    return nb_jobs;
+}
 
-                nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
-                /* Loop on precincts */
-                for (precno = 0; precno < nb_precincts; precno++) {
-                    Jpeg2000Prec *prec = band->prec + precno;
-
-                    /* Loop on codeblocks */
-                    for (cblkno = 0;
-                         cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
-                         cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        int ret = decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos, comp->roi_shift);
-                        if (ret)
-                            coded = 1;
-                        else
-                            continue;
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (comp->roi_shift)
-                            roi_scale_cblk(cblk, comp, &t1);
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
-                   } /* end cblk */
-                } /*end prec */
-            } /* end band */
-        } /* end reslevel */
+static int jpeg2000_decode_cblk(AVCodecContext *avctx, void *td,
+                                int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000CblkJob *job = (Jpeg2000CblkJob *)td + jobnr;
+    Jpeg2000Component *comp     = job->comp;
+    Jpeg2000CodingStyle *codsty = job->codsty;
+    Jpeg2000Band *band          = job->band;
+    Jpeg2000Cblk *cblk          = job->cblk;
+    Jpeg2000T1Context t1;
+    int x, y;
 
-        /* inverse DWT */
-        if (coded)
-            ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
+    t1.stride = (1<<codsty->log2_cblk_width) + 2;
 
-    } /*end comp */
+    if (!decode_cblk(s, codsty, job->t1k, &t1, cblk,
+                     cblk->coord[0][1] - cblk->coord[0][0],
+                     cblk->coord[1][1] - cblk->coord[1][0],
+                     job->bandpos, comp->roi_shift))
+        return 0;
+    job->coded = 1;
+
+    x = cblk->coord[0][0] - band->coord[0][0];
+    y = cblk->coord[1][0] - band->coord[1][0];
+
+    if (comp->roi_shift)
+        roi_scale_cblk(cblk, comp, &t1);
+    if (codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, comp, &t1, band);
+    else if (codsty->transform == FF_DWT97_INT)
+        dequantization_int_97(x, y, cblk, comp, &t1, band);
+    else if (comp->s_data)
+        dequantization_int16(x, y, cblk, comp, &t1, band);
+    else
+        dequantization_int(x, y, cblk, comp, &t1, band);
+
+    return 0;
+}
+
+static int jpeg2000_dwt_component(AVCodecContext *avctx, void *td,
+                                  int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    const uint8_t *coded = td;
+    Jpeg2000Tile *tile = s->tile + jobnr / s->ncomponents;
+    Jpeg2000Component *comp = tile->comp + jobnr % s->ncomponents;
+
+    /* inverse DWT */
+    if (coded[jobnr])
+        ff_dwt_decode(&comp->dwt, component_data(comp));
+
+    return 0;
+}
+
+static void jpeg2000_inner_worker(void *priv, int jobnr, int threadnr,
+                                  int nb_jobs, int nb_threads)
+{
+    Jpeg2000DecoderContext *s = priv;
+
+    s->inner_func(s->avctx, s->inner_arg, jobnr, threadnr);
+}
+
+/* Run the jobs of a frame on the inner workers when frame threading with
+ * inner_threads, on the slice threads otherwise. */
+static void jpeg2000_execute(Jpeg2000DecoderContext *s,
+                             int (*func)(AVCodecContext *avctx, void *arg,
+                                         int jobnr, int threadnr),
+                             void *arg, int count)
+{
+    if (s->inner && count > 1) {
+        s->inner_func = func;
+        s->inner_arg  = arg;
+        avpriv_slicethread_execute(s->inner, count, 0);
+    } else if (count > 0) {
+        s->avctx->execute2(s->avctx, func, arg, NULL, count);
+    }
+}
+
+static int jpeg2000_dwt_step(AVCodecContext *avctx, void *td,
+                             int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000DWTJob *job = (Jpeg2000DWTJob *)td + jobnr;
+
+    ff_dwt_decode_step(job->dwt, job->data, job->step, job->start, job->end,
+                       s->dwt_linebuf + threadnr * s->dwt_linebuf_stride);
+
+    return 0;
+}
+
+/* Run the inverse DWT of the components step by step, splitting the rows
+ * and columns of each step over the slice threads, for the frames with
+ * fewer components than threads, e.g. a single RGB or XYZ tile. */
+static int dwt_component_steps(Jpeg2000DecoderContext *s, const uint8_t *coded)
+{
+    unsigned nb_comps = s->numXtiles * s->numYtiles * s->ncomponents;
+    int nb_threads = s->nb_threads;
+    int nb_steps = 0, nb_jobs, step, i, j;
+    size_t stride = 0;
+    Jpeg2000DWTJob *jobs;
+
+    for (i = 0; i < nb_comps; i++) {
+        DWTContext *dwt = &s->tile[i / s->ncomponents].comp[i % s->ncomponents].dwt;
+
+        if (!coded[i])
+            continue;
+        nb_steps = FFMAX(nb_steps, ff_dwt_decode_steps(dwt));
+        stride   = FFMAX(stride,   ff_dwt_linebuf_size(dwt));
+    }
+    if (!nb_steps)
+        return 0;
+
+    s->dwt_linebuf_stride = FFALIGN(stride, 64);
+    if (s->dwt_linebuf_stride > UINT_MAX / nb_threads)
+        return AVERROR(ENOMEM);
+    av_fast_malloc(&s->dwt_linebuf, &s->dwt_linebuf_size,
+                   s->dwt_linebuf_stride * nb_threads);
+    jobs = av_malloc_array(nb_comps * nb_threads, sizeof(*jobs));
+    if (!s->dwt_linebuf || !jobs) {
+        av_free(jobs);
+        return AVERROR(ENOMEM);
+    }
+
+    for (step = 0; step < nb_steps; step++) {
+        nb_jobs = 0;
+        for (i = 0; i < nb_comps; i++) {
+            Jpeg2000Tile *tile = s->tile + i / s->ncomponents;
+            Jpeg2000Component *comp = tile->comp + i % s->ncomponents;
+            int units;
+
+            if (!coded[i] || step >= ff_dwt_decode_steps(&comp->dwt))
+                continue;
+            units = ff_dwt_decode_step_units(&comp->dwt, step);
+            for (j = 0; j < nb_threads; j++) {
+                Jpeg2000DWTJob *job = jobs + nb_jobs;
+
+                job->dwt   = &comp->dwt;
+                job->data  = component_data(comp);
+                job->step  = step;
+                job->start = (int64_t)units *  j      / nb_threads;
+                job->end   = (int64_t)units * (j + 1) / nb_threads;
+                nb_jobs   += job->start < job->end;
+            }
+        }
+        jpeg2000_execute(s, jpeg2000_dwt_step, jobs, nb_jobs);
+    }
+
+    av_free(jobs);
+    return 0;
 }
 
+/* Decode the code blocks of all the tiles, then run the inverse DWT of all
+ * their components, each step spread over the slice threads, so that a frame
+ * made of a single tile is decoded in parallel as well. */
+static int tile_codeblocks(Jpeg2000DecoderContext *s)
+{
+    unsigned ntiles = s->numXtiles * s->numYtiles;
+    unsigned nb_jobs = 0, tileno, jobno;
+    Jpeg2000CblkJob *jobs;
+    uint8_t *coded;
+    int64_t start = av_gettime_relative(), end;
+    int ret = 0;
+
+    for (tileno = 0; tileno < ntiles; tileno++)
+        if (!s->tile[tileno].cblks_decoded)
+            nb_jobs += tile_codeblock_jobs(s, s->tile + tileno, NULL, 0);
+
+    jobs  = av_malloc_array(FFMAX(nb_jobs, 1), sizeof(*jobs));
+    coded = av_calloc(ntiles, s->ncomponents);
+    if (!jobs || !coded) {
+        av_free(jobs);
+        av_free(coded);
+        return AVERROR(ENOMEM);
+    }
+
+    nb_jobs = 0;
+    for (tileno = 0; tileno < ntiles; tileno++) {
+        Jpeg2000Tile *tile = s->tile + tileno;
+
+        if (tile->cblks_decoded)
+            memcpy(coded + tileno * s->ncomponents, tile->coded, s->ncomponents);
+        else
+            nb_jobs += tile_codeblock_jobs(s, tile, jobs + nb_jobs,
+                                           tileno * s->ncomponents);
+    }
+
+    jpeg2000_execute(s, jpeg2000_decode_cblk, jobs, nb_jobs);
+
+    for (jobno = 0; jobno < nb_jobs; jobno++)
+        coded[jobs[jobno].compidx] |= jobs[jobno].coded;
+
+    av_free(jobs);
+
+    end = av_gettime_relative();
+    s->time_tier1 += end - start;
+    start = end;
+
+    if (ntiles * s->ncomponents < s->nb_threads)
+        ret = dwt_component_steps(s, coded);
+    else
+        jpeg2000_execute(s, jpeg2000_dwt_component, coded, ntiles * s->ncomponents);
+
+    s->time_dwt += av_gettime_relative() - start;
+    av_free(coded);
+    return ret;
+}
+
+/* Types of the coefficients written to the frame */
+enum WriteSource {
+    WRITE_FLOAT,
+    WRITE_INT32,
+    WRITE_INT16,
+};
+
+/* DC level shift and clip see ISO 15444-1:2002 G.1.2
+ * Inlined with constant pixelsize and source type, so that the common
+ * layouts get loops without stride multiplies or per pixel branches. */
+#define WRITE_LINE(D, PIXEL)                                                                      \
+    static av_always_inline void write_line_ ## D(PIXEL *dst, const void *src, int w,             \
+                                                  int pixelsize, int cbps, int shift,             \
+                                                  enum WriteSource type)                          \
+    {                                                                                             \
+        const int offset = 1 << (cbps - 1);                                                       \
+        const int max    = (1 << cbps) - 1;                                                       \
+        int x;                                                                                    \
+                                                                                                  \
+        if (type == WRITE_FLOAT) {                                                                \
+            const float *datap = src;                                                             \
+            for (x = 0; x < w; x++) {                                                             \
+                int val = av_clip(lrintf(datap[x]) + offset, 0, max);                             \
+                dst[x * pixelsize] = val << shift;                                                \
+            }                                                                                     \
+        } else if (type == WRITE_INT16) {                                                         \
+            const int16_t *s_datap = src;                                                         \
+            for (x = 0; x < w; x++) {                                                             \
+                int val = av_clip(s_datap[x] + offset, 0, max);                                   \
+                dst[x * pixelsize] = val << shift;                                                \
+            }                                                                                     \
+        } else {                                                                                  \
+            const int32_t *i_datap = src;                                                         \
+            for (x = 0; x < w; x++) {                                                             \
+                int val = av_clip(i_datap[x] + offset, 0, max);                                   \
+                dst[x * pixelsize] = val << shift;                                                \
+            }                                                                                     \
+        }                                                                                         \
+    }
+
+WRITE_LINE(8, uint8_t)
+WRITE_LINE(16, uint16_t)
+
+#undef WRITE_LINE
+
+#define WRITE_LINE_TYPE(D, pixelsize, type)                                                       \
+    switch (type) {                                                                               \
+    case WRITE_FLOAT:                                                                             \
+        write_line_ ## D(dst, src, w, pixelsize, cbps, shift, WRITE_FLOAT);                       \
+        break;                                                                                    \
+    case WRITE_INT16:                                                                             \
+        write_line_ ## D(dst, src, w, pixelsize, cbps, shift, WRITE_INT16);                       \
+        break;                                                                                    \
+    default:                                                                                      \
+        write_line_ ## D(dst, src, w, pixelsize, cbps, shift, WRITE_INT32);                       \
+        break;                                                                                    \
+    }
+
 #define WRITE_FRAME(D, PIXEL)                                                                     \
     static inline void write_frame_ ## D(Jpeg2000DecoderContext * s, Jpeg2000Tile * tile,         \
                                          AVFrame * picture, int precision)                        \
@@ -2020,11 +2817,13 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
                                                                                                   \
         for (compno = 0; compno < s->ncomponents; compno++) {                                     \
             Jpeg2000Component *comp     = tile->comp + compno;                                    \
-            Jpeg2000CodingStyle *codsty = tile->codsty + compno;                                  \
             PIXEL *line;                                                                          \
-            float *datap     = comp->f_data;                                                      \
-            int32_t *i_datap = comp->i_data;                                                      \
+            const uint8_t *src = component_data(comp);                                            \
+            enum WriteSource type = comp->f_data ? WRITE_FLOAT :                                  \
+                                    comp->s_data ? WRITE_INT16 : WRITE_INT32;                     \
+            int src_size     = type == WRITE_INT16 ? sizeof(int16_t) : sizeof(int32_t);           \
             int cbps         = s->cbps[compno];                                                   \
+            int shift        = precision - cbps;                                                  \
             int w            = tile->comp[compno].coord[0][1] -                                   \
                                ff_jpeg2000_ceildiv(s->image_offset_x, s->cdx[compno]);            \
             int h            = tile->comp[compno].coord[1][1] -                                   \
@@ -2034,35 +2833,28 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
             if (planar)                                                                           \
                 plane = s->cdef[compno] ? s->cdef[compno]-1 : (s->ncomponents-1);                 \
                                                                                                   \
+            x    = tile->comp[compno].coord[0][0] -                                               \
+                   ff_jpeg2000_ceildiv(s->image_offset_x, s->cdx[compno]);                        \
             y    = tile->comp[compno].coord[1][0] -                                               \
                    ff_jpeg2000_ceildiv(s->image_offset_y, s->cdy[compno]);                        \
             line = (PIXEL *)picture->data[plane] + y * (picture->linesize[plane] / sizeof(PIXEL));\
+            w   -= x;                                                                             \
             for (; y < h; y++) {                                                                  \
-                PIXEL *dst;                                                                       \
-                                                                                                  \
-                x   = tile->comp[compno].coord[0][0] -                                            \
-                      ff_jpeg2000_ceildiv(s->image_offset_x, s->cdx[compno]);                     \
-                dst = line + x * pixelsize + compno*!planar;                                      \
+                PIXEL *dst = line + x * pixelsize + compno*!planar;                               \
                                                                                                   \
-                if (codsty->transform == FF_DWT97) {                                              \
-                    for (; x < w; x++) {                                                          \
-                        int val = lrintf(*datap) + (1 << (cbps - 1));                             \
-                        /* DC level shift and clip see ISO 15444-1:2002 G.1.2 */                  \
-                        val  = av_clip(val, 0, (1 << cbps) - 1);                                  \
-                        *dst = val << (precision - cbps);                                         \
-                        datap++;                                                                  \
-                        dst += pixelsize;                                                         \
-                    }                                                                             \
-                } else {                                                                          \
-                    for (; x < w; x++) {                                                          \
-                        int val = *i_datap + (1 << (cbps - 1));                                   \
-                        /* DC level shift and clip see ISO 15444-1:2002 G.1.2 */                  \
-                        val  = av_clip(val, 0, (1 << cbps) - 1);                                  \
-                        *dst = val << (precision - cbps);                                         \
-                        i_datap++;                                                                \
-                        dst += pixelsize;                                                         \
-                    }                                                                             \
+                switch (pixelsize) {                                                              \
+                case 1:                                                                           \
+                    WRITE_LINE_TYPE(D, 1, type)                                                   \
+                    break;                                                                        \
+                case 3:                                                                           \
+                    WRITE_LINE_TYPE(D, 3, type)                                                   \
+                    break;                                                                        \
+                default:                                                                          \
+                    write_line_ ## D(dst, src, w, pixelsize, cbps, shift, type);                  \
+                    break;                                                                        \
                 }                                                                                 \
+                if (w > 0)                                                                        \
+                    src += w * src_size;                                                          \
                 line += picture->linesize[plane] / sizeof(PIXEL);                                 \
             }                                                                                     \
         }                                                                                         \
@@ -2072,6 +2864,7 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
 WRITE_FRAME(8, uint8_t)
 WRITE_FRAME(16, uint16_t)
 
+#undef WRITE_LINE_TYPE
 #undef WRITE_FRAME
 
 static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
@@ -2082,8 +2875,6 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
     Jpeg2000Tile *tile = s->tile + jobnr;
     int x;
 
-    tile_codeblocks(s, tile);
-
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
@@ -2113,26 +2904,28 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
     return 0;
 }
 
+/* End the decoding of a frame, keeping its tiles for the next one */
 static void jpeg2000_dec_cleanup(Jpeg2000DecoderContext *s)
 {
-    int tileno, compno;
+    int tileno;
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
-        if (s->tile[tileno].comp) {
-            for (compno = 0; compno < s->ncomponents; compno++) {
-                Jpeg2000Component *comp     = s->tile[tileno].comp   + compno;
-                Jpeg2000CodingStyle *codsty = s->tile[tileno].codsty + compno;
-
-                ff_jpeg2000_cleanup(comp, codsty);
-            }
-            av_freep(&s->tile[tileno].comp);
-            av_freep(&s->tile[tileno].packed_headers);
-            s->tile[tileno].packed_headers_size = 0;
-        }
+        av_freep(&s->tile[tileno].packed_headers);
+        s->tile[tileno].packed_headers_size = 0;
+        av_freep(&s->tile[tileno].packet_lengths);
+        s->tile[tileno].nb_packet_lengths        = 0;
+        s->tile[tileno].packet_lengths_allocated = 0;
     }
     av_freep(&s->packed_headers);
     s->packed_headers_size = 0;
     memset(&s->packed_headers_stream, 0, sizeof(s->packed_headers_stream));
-    av_freep(&s->tile);
+    if (s->tile) {
+        jpeg2000_free_tile_pool(s);
+        s->tile_pool             = s->tile;
+        s->tile_pool_size        = s->numXtiles * s->numYtiles;
+        s->tile_pool_ncomponents = s->ncomponents;
+        memcpy(s->tile_pool_siz, s->siz, sizeof(s->siz));
+        s->tile = NULL;
+    }
     memset(s->codsty, 0, sizeof(s->codsty));
     memset(s->qntsty, 0, sizeof(s->qntsty));
     memset(s->properties, 0, sizeof(s->properties));
@@ -2221,6 +3014,9 @@ static int jpeg2000_read_main_headers(Jpeg2000DecoderContext *s)
             if (!s->tile)
                 s->numXtiles = s->numYtiles = 0;
             break;
+        case JPEG2000_CAP:
+            ret = get_cap(s, len);
+            break;
         case JPEG2000_COC:
             ret = get_coc(s, codsty, properties);
             break;
@@ -2306,6 +3102,175 @@ static int jpeg2000_read_main_headers(Jpeg2000DecoderContext *s)
     return 0;
 }
 
+typedef struct Jpeg2000PrecinctJob {
+    Jpeg2000Packet *packets;            // packets of the precinct, in layer order
+    int nb_packets;
+    Jpeg2000CblkJob *cblk_jobs;         // its code blocks to decode
+    unsigned nb_cblk_jobs;
+    int coded;
+    int ret;
+} Jpeg2000PrecinctJob;
+
+static int packet_cmp(const void *a, const void *b)
+{
+    const Jpeg2000Packet *pa = a, *pb = b;
+
+    if (pa->compno != pb->compno)
+        return pa->compno - pb->compno;
+    if (pa->reslevelno != pb->reslevelno)
+        return pa->reslevelno - pb->reslevelno;
+    if (pa->precno != pb->precno)
+        return pa->precno - pb->precno;
+    return pa->layno - pb->layno;
+}
+
+/* Parse the packets of a precinct, then decode its code blocks, which are
+ * complete once its last packet is read. */
+static int jpeg2000_decode_precinct(AVCodecContext *avctx, void *td,
+                                    int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000PrecinctJob *job  = (Jpeg2000PrecinctJob *)td + jobnr;
+    unsigned i;
+
+    for (i = 0; i < job->nb_packets; i++) {
+        Jpeg2000Packet *packet = job->packets + i;
+        int drop = s->max_quality_layers && packet->layno >= s->max_quality_layers;
+        int bit_index = 8;
+        GetByteContext g;
+
+        bytestream2_init(&g, packet->data, packet->size);
+        skip_sop(s, &g, packet->codsty);
+        if ((job->ret = decode_packet_header(s, &g, &bit_index, packet->codsty,
+                                             packet->rlevel, packet->precno,
+                                             packet->layno, packet->expn,
+                                             packet->numgbits, drop)) < 0 ||
+            (job->ret = decode_packet_body(s, &g, packet->rlevel,
+                                           packet->precno, drop)) < 0)
+            return 0;
+    }
+
+    for (i = 0; i < job->nb_cblk_jobs; i++) {
+        jpeg2000_decode_cblk(avctx, job->cblk_jobs, i, threadnr);
+        job->coded |= job->cblk_jobs[i].coded;
+    }
+
+    return 0;
+}
+
+/* With the PLT markers, the position of every packet of a tile is known
+ * before parsing its header, so the packets of the different precincts can
+ * be parsed in parallel, and the code blocks of a precinct decoded as soon
+ * as its packets are. Returns 0 if the tile must be decoded sequentially. */
+static int decode_precincts(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile, int tileno)
+{
+    Jpeg2000PrecinctJob *jobs = NULL;
+    Jpeg2000CblkJob *cblk_jobs = NULL;
+    unsigned nb_jobs = 0, nb_cblk_jobs = 0, i, j;
+    int tp_index = 0, ret;
+    GetByteContext g;
+
+    if (!tile->nb_packet_lengths || s->has_ppm || tile->has_ppt ||
+        (s->nb_threads < 2 && !s->reduction_factor && !s->max_quality_layers &&
+         !s->window[0][1]))
+        return 0;
+
+    s->nb_packets   = 0;
+    s->list_packets = 1;
+    ret = jpeg2000_decode_packets(s, tile);
+    s->list_packets = 0;
+    if (ret < 0)
+        return ret;
+
+    /* the packets must be those of the PLT markers, in the tile-parts */
+    g = tile->tile_part[0].tpg;
+    for (i = 0; i < s->nb_packets && s->nb_packets == tile->nb_packet_lengths; i++) {
+        Jpeg2000Packet *packet = s->packets + i;
+
+        while (!bytestream2_get_bytes_left(&g) && tp_index < tile->tp_idx)
+            g = tile->tile_part[++tp_index].tpg;
+        if (tile->packet_lengths[i] > bytestream2_get_bytes_left(&g))
+            break;
+        packet->data = g.buffer;
+        packet->size = tile->packet_lengths[i];
+        bytestream2_skipu(&g, packet->size);
+    }
+    if (i < s->nb_packets || s->nb_packets != tile->nb_packet_lengths) {
+        av_log(s->avctx, AV_LOG_DEBUG,
+               "PLT markers of tile %d do not match its %u packets\n",
+               tileno, s->nb_packets);
+        for (i = 0; i < s->nb_packets; i++) {
+            Jpeg2000Packet *packet = s->packets + i;
+            packet->rlevel->band[0].prec[packet->precno].decoded_layers = 0;
+        }
+        return 0;
+    }
+
+    qsort(s->packets, s->nb_packets, sizeof(*s->packets), packet_cmp);
+
+    /* the precincts without code blocks to decode, in the resolution levels
+     * above lowres or outside the window, and the packets of the dropped
+     * layers, the last ones of their precincts, are not parsed at all */
+    for (i = 0; i < s->nb_packets; i++) {
+        Jpeg2000Packet *packet = s->packets + i;
+        unsigned n;
+
+        if (packet->layno)
+            continue;
+        n = precinct_codeblock_jobs(s, tile, packet->compno, packet->reslevelno,
+                                    packet->precno, NULL, 0);
+        nb_jobs      += !!n;
+        nb_cblk_jobs += n;
+    }
+    jobs      = av_calloc(FFMAX(nb_jobs, 1), sizeof(*jobs));
+    cblk_jobs = av_malloc_array(FFMAX(nb_cblk_jobs, 1), sizeof(*cblk_jobs));
+    if (!jobs || !cblk_jobs) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    nb_jobs = nb_cblk_jobs = 0;
+    for (i = 0; i < s->nb_packets; i = j) {
+        Jpeg2000Packet *packet   = s->packets + i;
+        Jpeg2000PrecinctJob *job;
+        unsigned n;
+
+        for (j = i + 1; j < s->nb_packets && s->packets[j].layno; j++);
+        n = precinct_codeblock_jobs(s, tile, packet->compno, packet->reslevelno,
+                                    packet->precno, cblk_jobs + nb_cblk_jobs,
+                                    tileno * s->ncomponents);
+        if (!n)
+            continue;
+        job               = jobs + nb_jobs;
+        job->cblk_jobs    = cblk_jobs + nb_cblk_jobs;
+        job->nb_cblk_jobs = n;
+        job->packets      = packet;
+        job->nb_packets   = j - i;
+        if (s->max_quality_layers)
+            job->nb_packets = FFMIN(job->nb_packets, s->max_quality_layers);
+        nb_cblk_jobs     += job->nb_cblk_jobs;
+        nb_jobs++;
+    }
+
+    jpeg2000_execute(s, jpeg2000_decode_precinct, jobs, nb_jobs);
+
+    ret = 1;
+    for (i = 0; i < nb_jobs; i++) {
+        if (jobs[i].ret < 0) {
+            ret = jobs[i].ret;
+            break;
+        }
+        if (jobs[i].coded)
+            tile->coded[jobs[i].packets->compno] = 1;
+    }
+    tile->cblks_decoded = ret > 0;
+
+end:
+    av_free(jobs);
+    av_free(cblk_jobs);
+    return ret;
+}
+
 /* Read bit stream packets --> T2 operation. */
 static int jpeg2000_read_bitstream_packets(Jpeg2000DecoderContext *s)
 {
@@ -2318,7 +3283,9 @@ static int jpeg2000_read_bitstream_packets(Jpeg2000DecoderContext *s)
         if ((ret = init_tile(s, tileno)) < 0)
             return ret;
 
-        if ((ret = jpeg2000_decode_packets(s, tile)) < 0)
+        if ((ret = decode_precincts(s, tile, tileno)) < 0)
+            return ret;
+        if (!ret && (ret = jpeg2000_decode_packets(s, tile)) < 0)
             return ret;
     }
 
@@ -2481,6 +3448,32 @@ static av_cold int jpeg2000_decode_init(AVCodecContext *avctx)
     ff_jpeg2000dsp_init(&s->dsp);
     ff_jpeg2000_init_tier1_luts();
 
+    /* the generic lowres option shrinks the frame buffers, so it has to
+     * reduce the decoded resolution as well */
+    if (avctx->lowres)
+        s->reduction_factor = avctx->lowres;
+
+    s->nb_threads = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+    if ((avctx->active_thread_type & FF_THREAD_FRAME) && s->inner_threads != 1) {
+        int ret = avpriv_slicethread_create(&s->inner, s, jpeg2000_inner_worker,
+                                            NULL, s->inner_threads);
+        if (ret < 0)
+            return ret;
+        s->nb_threads = ret;
+    }
+
+    return 0;
+}
+
+static av_cold int jpeg2000_decode_close(AVCodecContext *avctx)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    jpeg2000_free_tile_pool(s);
+    av_freep(&s->dwt_linebuf);
+    av_freep(&s->packets);
+    avpriv_slicethread_free(&s->inner);
+
     return 0;
 }
 
@@ -2490,6 +3483,7 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     Jpeg2000DecoderContext *s = avctx->priv_data;
     ThreadFrame frame = { .f = data };
     AVFrame *picture = data;
+    int64_t start = av_gettime_relative();
     int ret;
 
     s->avctx     = avctx;
@@ -2528,6 +3522,13 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_main_headers(s))
         goto end;
 
+    s->window[0][0] = av_clip(s->window_x, 0, avctx->width);
+    s->window[1][0] = av_clip(s->window_y, 0, avctx->height);
+    s->window[0][1] = FFMIN(s->window[0][0] + (int64_t)s->window_w, avctx->width);
+    s->window[1][1] = FFMIN(s->window[1][0] + (int64_t)s->window_h, avctx->height);
+    if (s->window[0][1] <= s->window[0][0] || s->window[1][1] <= s->window[1][0])
+        memset(s->window, 0, sizeof(s->window));
+
     /* get picture buffer */
     if ((ret = ff_thread_get_buffer(avctx, &frame, 0)) < 0)
         goto end;
@@ -2536,13 +3537,26 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
 
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
+    s->time_tier2 += av_gettime_relative() - start;
+
+    if (ret = tile_codeblocks(s))
+        goto end;
 
-    avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
+    start = av_gettime_relative();
+    jpeg2000_execute(s, jpeg2000_decode_tile, picture, s->numXtiles * s->numYtiles);
+    s->time_output += av_gettime_relative() - start;
 
     jpeg2000_dec_cleanup(s);
 
     *got_frame = 1;
 
+    if (s->window[0][1]) {
+        picture->crop_left   = s->window[0][0];
+        picture->crop_right  = avctx->width  - s->window[0][1];
+        picture->crop_top    = s->window[1][0];
+        picture->crop_bottom = avctx->height - s->window[1][1];
+    }
+
     if (s->avctx->pix_fmt == AV_PIX_FMT_PAL8)
         memcpy(picture->data[1], s->palette, 256 * sizeof(uint32_t));
     if (s->sar.num && s->sar.den)
@@ -2558,10 +3572,31 @@ end:
 
 #define OFFSET(x) offsetof(Jpeg2000DecoderContext, x)
 #define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
+#define VDX VD | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
 
 static const AVOption options[] = {
     { "lowres",  "Lower the decoding resolution by a power of two",
         OFFSET(reduction_factor), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, JPEG2000_MAX_RESLEVELS - 1, VD },
+    { "max_quality_layers", "Decode only the first quality layers (0 = all)",
+        OFFSET(max_quality_layers), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 65535, VD },
+    { "window_x", "Left edge of the decode window",
+        OFFSET(window_x), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "window_y", "Top edge of the decode window",
+        OFFSET(window_y), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "window_w", "Width of the decode window (0 = no window)",
+        OFFSET(window_w), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "window_h", "Height of the decode window (0 = no window)",
+        OFFSET(window_h), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "inner_threads", "Threads decoding each frame when frame threading (0 = auto)",
+        OFFSET(inner_threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, INT_MAX, VD },
+    { "time_tier2", "Time spent parsing the headers and packet headers, in microseconds",
+        OFFSET(time_tier2), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VDX },
+    { "time_tier1", "Time spent decoding and dequantizing the code blocks, in microseconds",
+        OFFSET(time_tier1), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VDX },
+    { "time_dwt", "Time spent in the inverse DWT, in microseconds",
+        OFFSET(time_dwt), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VDX },
+    { "time_output", "Time spent in the MCT and writing the frames, in microseconds",
+        OFFSET(time_output), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, VDX },
     { NULL },
 };
 
@@ -2581,8 +3616,9 @@ const AVCodec ff_jpeg2000_decoder = {
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init             = jpeg2000_decode_init,
     .decode           = jpeg2000_decode_frame,
+    .close            = jpeg2000_decode_close,
     .priv_class       = &jpeg2000_class,
     .max_lowres       = 5,
     .profiles         = NULL_IF_CONFIG_SMALL(ff_jpeg2000_profiles),
-    .caps_internal    = FF_CODEC_CAP_INIT_THREADSAFE,
+    .caps_internal    = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -90,11 +90,28 @@ static void rct_int(void *_src0, void *_src1, void *_src2, int csize)
     }
 }
 
+static void rct_int16(void *_src0, void *_src1, void *_src2, int csize)
+{
+    int16_t *src0 = _src0, *src1 = _src1, *src2 = _src2;
+    int i0, i1, i2;
+    int i;
+
+    for (i = 0; i < csize; i++) {
+        i1 = *src0 - (*src2 + *src1 >> 2);
+        i0 = i1 + *src2;
+        i2 = i1 + *src1;
+        *src0++ = i0;
+        *src1++ = i1;
+        *src2++ = i2;
+    }
+}
+
 av_cold void ff_jpeg2000dsp_init(Jpeg2000DSPContext *c)
 {
     c->mct_decode[FF_DWT97]     = ict_float;
     c->mct_decode[FF_DWT53]     = rct_int;
     c->mct_decode[FF_DWT97_INT] = ict_int;
+    c->mct_decode[FF_DWT53_16]  = rct_int16;
 
     if (ARCH_X86)
         ff_jpeg2000dsp_init_x86(c);
@@ -47,6 +47,26 @@
 #define I_LFTG_X       53274ll
 #define I_PRESHIFT 8
 
+/* Number of columns transformed together by the vertical passes. The columns are gathered into a line buffer of DWT_COLS samples
+ * per row, so that the lifting steps run over contiguous memory. */
+#define DWT_COLS 16
+
+/* Sample of column c at row i of a buffer of DWT_COLS columns */
+#define COL(p, i) ((p) + (i) * DWT_COLS)
+
+/* Mirror the rows of a buffer of columns: same as the extend functions,
+ * applied to n columns */
+static inline void extend_cols(void *p, int size, int n, int i0, int i1, int ext)
+{
+    uint8_t *b = p;
+    int i, rs = DWT_COLS * size;
+
+    for (i = 1; i <= ext; i++) {
+        memcpy(b + (i0 - i) * rs, b + (i0 + i) * rs, n * size);
+        memcpy(b + (i1 + i - 1) * rs, b + (i1 - i - 1) * rs, n * size);
+    }
+}
+
 static inline void extend53(int *p, int i0, int i1)
 {
     p[i0 - 1] = p[i0 + 1];
@@ -93,11 +113,41 @@ static void sd_1d53(int *p, int i0, int i1)
         p[2*i] += (p[2*i-1] + p[2*i+1] + 2) >> 2;
 }
 
+static void sd_1d53_cols(int *p, int i0, int i1, int n)
+{
+    int i, c;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (c = 0; c < n; c++)
+                COL(p, 1)[c] *= 2;
+        return;
+    }
+
+    /* same as extend53() */
+    memcpy(COL(p, i0 - 1), COL(p, i0 + 1), n * sizeof(*p));
+    memcpy(COL(p, i1),     COL(p, i1 - 2), n * sizeof(*p));
+    memcpy(COL(p, i0 - 2), COL(p, i0 + 2), n * sizeof(*p));
+    memcpy(COL(p, i1 + 1), COL(p, i1 - 3), n * sizeof(*p));
+
+    for (i = ((i0+1)>>1) - 1; i < (i1+1)>>1; i++) {
+        int *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] -= (a[c] + b[c]) >> 1;
+    }
+    for (i = ((i0+1)>>1); i < (i1+1)>>1; i++) {
+        int *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] += (a[c] + b[c] + 2) >> 2;
+    }
+}
+
 static void dwt_encode53(DWTContext *s, int *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
     int *line = s->i_linebuf;
+    int *cols = line + 3 * DWT_COLS;
     line += 3;
 
     for (lev = s->ndeclevels-1; lev >= 0; lev--){
@@ -109,20 +159,20 @@ static void dwt_encode53(DWTContext *s, int *t)
         int *l;
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = COL(cols, mv);
+        for (lp = 0; lp < lh; lp += DWT_COLS) {
+            int i, j = 0, n = FFMIN(DWT_COLS, lh - lp);
 
             for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
+                memcpy(COL(l, i), t + w*i + lp, n * sizeof(*t));
 
-            sd_1d53(line, mv, mv + lv);
+            sd_1d53_cols(cols, mv, mv + lv, n);
 
             // copy back and deinterleave
             for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(t + w*j + lp, COL(l, i), n * sizeof(*t));
             for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(t + w*j + lp, COL(l, i), n * sizeof(*t));
         }
 
         // HOR_SD
@@ -168,11 +218,51 @@ static void sd_1d97_float(float *p, int i0, int i1)
         p[2*i] += 0.443506 * (p[2*i-1] + p[2*i+1]);
 }
 
+static void sd_1d97_float_cols(float *p, int i0, int i1, int n)
+{
+    int i, c;
+
+    if (i1 <= i0 + 1) {
+        for (c = 0; c < n; c++) {
+            if (i0 == 1)
+                COL(p, 1)[c] *= F_LFTG_X * 2;
+            else
+                COL(p, 0)[c] *= F_LFTG_K;
+        }
+        return;
+    }
+
+    extend_cols(p, sizeof(*p), n, i0, i1, 4);
+    i0++; i1++;
+
+    for (i = (i0>>1) - 2; i < (i1>>1) + 1; i++) {
+        float *x = COL(p, 2*i+1), *a = COL(p, 2*i), *b = COL(p, 2*i+2);
+        for (c = 0; c < n; c++)
+            x[c] -= 1.586134 * (a[c] + b[c]);
+    }
+    for (i = (i0>>1) - 1; i < (i1>>1) + 1; i++) {
+        float *x = COL(p, 2*i), *a = COL(p, 2*i-1), *b = COL(p, 2*i+1);
+        for (c = 0; c < n; c++)
+            x[c] -= 0.052980 * (a[c] + b[c]);
+    }
+    for (i = (i0>>1) - 1; i < (i1>>1); i++) {
+        float *x = COL(p, 2*i+1), *a = COL(p, 2*i), *b = COL(p, 2*i+2);
+        for (c = 0; c < n; c++)
+            x[c] += 0.882911 * (a[c] + b[c]);
+    }
+    for (i = (i0>>1); i < (i1>>1); i++) {
+        float *x = COL(p, 2*i), *a = COL(p, 2*i-1), *b = COL(p, 2*i+1);
+        for (c = 0; c < n; c++)
+            x[c] += 0.443506 * (a[c] + b[c]);
+    }
+}
+
 static void dwt_encode97_float(DWTContext *s, float *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
     float *line = s->f_linebuf;
+    float *cols = line + 5 * DWT_COLS;
     line += 5;
 
     for (lev = s->ndeclevels-1; lev >= 0; lev--){
@@ -201,20 +291,20 @@ static void dwt_encode97_float(DWTContext *s, float *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = COL(cols, mv);
+        for (lp = 0; lp < lh; lp += DWT_COLS) {
+            int i, j = 0, n = FFMIN(DWT_COLS, lh - lp);
 
             for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
+                memcpy(COL(l, i), t + w*i + lp, n * sizeof(*t));
 
-            sd_1d97_float(line, mv, mv + lv);
+            sd_1d97_float_cols(cols, mv, mv + lv, n);
 
             // copy back and deinterleave
             for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(t + w*j + lp, COL(l, i), n * sizeof(*t));
             for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(t + w*j + lp, COL(l, i), n * sizeof(*t));
         }
     }
 }
@@ -244,6 +334,45 @@ static void sd_1d97_int(int *p, int i0, int i1)
         p[2 * i]     += (I_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]) + (1 << 15)) >> 16;
 }
 
+static void sd_1d97_int_cols(int *p, int i0, int i1, int n)
+{
+    int i, c;
+
+    if (i1 <= i0 + 1) {
+        for (c = 0; c < n; c++) {
+            if (i0 == 1)
+                COL(p, 1)[c] = (COL(p, 1)[c] * I_LFTG_X + (1<<14)) >> 15;
+            else
+                COL(p, 0)[c] = (COL(p, 0)[c] * I_LFTG_K + (1<<15)) >> 16;
+        }
+        return;
+    }
+
+    extend_cols(p, sizeof(*p), n, i0, i1, 4);
+    i0++; i1++;
+
+    for (i = (i0>>1) - 2; i < (i1>>1) + 1; i++) {
+        int *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] -= (I_LFTG_ALPHA * (a[c] + b[c]) + (1 << 15)) >> 16;
+    }
+    for (i = (i0>>1) - 1; i < (i1>>1) + 1; i++) {
+        int *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] -= (I_LFTG_BETA  * (a[c] + b[c]) + (1 << 15)) >> 16;
+    }
+    for (i = (i0>>1) - 1; i < (i1>>1); i++) {
+        int *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] += (I_LFTG_GAMMA * (a[c] + b[c]) + (1 << 15)) >> 16;
+    }
+    for (i = (i0>>1); i < (i1>>1); i++) {
+        int *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] += (I_LFTG_DELTA * (a[c] + b[c]) + (1 << 15)) >> 16;
+    }
+}
+
 static void dwt_encode97_int(DWTContext *s, int *t)
 {
     int lev;
@@ -251,6 +380,7 @@ static void dwt_encode97_int(DWTContext *s, int *t)
     int h = s->linelen[s->ndeclevels-1][1];
     int i;
     int *line = s->i_linebuf;
+    int *cols = line + 5 * DWT_COLS;
     line += 5;
 
     for (i = 0; i < w * h; i++)
@@ -265,20 +395,21 @@ static void dwt_encode97_int(DWTContext *s, int *t)
         int *l;
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = COL(cols, mv);
+        for (lp = 0; lp < lh; lp += DWT_COLS) {
+            int i, j = 0, c, n = FFMIN(DWT_COLS, lh - lp);
 
             for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
+                memcpy(COL(l, i), t + w*i + lp, n * sizeof(*t));
 
-            sd_1d97_int(line, mv, mv + lv);
+            sd_1d97_int_cols(cols, mv, mv + lv, n);
 
             // copy back and deinterleave
             for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = ((l[i] * I_LFTG_X) + (1 << 15)) >> 16;
+                for (c = 0; c < n; c++)
+                    t[w*j + lp + c] = ((COL(l, i)[c] * I_LFTG_X) + (1 << 15)) >> 16;
             for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(t + w*j + lp, COL(l, i), n * sizeof(*t));
         }
 
         // HOR_SD
@@ -322,52 +453,186 @@ static void sr_1d53(unsigned *p, int i0, int i1)
         p[2 * i + 1] += (int)(p[2 * i] + p[2 * i + 2]) >> 1;
 }
 
-static void dwt_decode53(DWTContext *s, int *t)
+static void sr_1d53_cols(unsigned *p, int i0, int i1, int n)
 {
-    int lev;
-    int w     = s->linelen[s->ndeclevels - 1][0];
-    int32_t *line = s->i_linebuf;
+    int i, c;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (c = 0; c < n; c++)
+                COL(p, 1)[c] = (int)COL(p, 1)[c] >> 1;
+        return;
+    }
+
+    /* same as extend53() */
+    memcpy(COL(p, i0 - 1), COL(p, i0 + 1), n * sizeof(*p));
+    memcpy(COL(p, i1),     COL(p, i1 - 2), n * sizeof(*p));
+    memcpy(COL(p, i0 - 2), COL(p, i0 + 2), n * sizeof(*p));
+    memcpy(COL(p, i1 + 1), COL(p, i1 - 3), n * sizeof(*p));
+
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        unsigned *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] -= (int)(a[c] + b[c] + 2) >> 2;
+    }
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        unsigned *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] += (int)(a[c] + b[c]) >> 1;
+    }
+}
+
+static void dwt_decode53_hor(DWTContext *s, int32_t *t, int lev,
+                             int start, int end, int32_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        mh = s->mod[lev][0],
+        lp;
+    int32_t *l;
+
     line += 3;
+    l = line + mh;
+    for (lp = start; lp < end; lp++) {
+        int i, j = 0;
+        // copy with interleaving
+        for (i = mh; i < lh; i += 2, j++)
+            l[i] = t[w * lp + j];
+        for (i = 1 - mh; i < lh; i += 2, j++)
+            l[i] = t[w * lp + j];
+
+        sr_1d53(line, mh, mh + lh);
+
+        for (i = 0; i < lh; i++)
+            t[w * lp + i] = l[i];
+    }
+}
 
-    for (lev = 0; lev < s->ndeclevels; lev++) {
-        int lh = s->linelen[lev][0],
-            lv = s->linelen[lev][1],
-            mh = s->mod[lev][0],
-            mv = s->mod[lev][1],
-            lp;
-        int *l;
+static void dwt_decode53_ver(DWTContext *s, int32_t *t, int lev,
+                             int start, int end, int32_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        lv = s->linelen[lev][1],
+        mv = s->mod[lev][1],
+        lp;
+    int32_t *cols = line + 3 * DWT_COLS;
+    int32_t *l    = COL(cols, mv);
+
+    for (lp = start * DWT_COLS; lp < FFMIN(lh, end * DWT_COLS); lp += DWT_COLS) {
+        int i, j = 0, n = FFMIN(DWT_COLS, lh - lp);
+        // copy with interleaving
+        for (i = mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), t + w * j + lp, n * sizeof(*t));
+        for (i = 1 - mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), t + w * j + lp, n * sizeof(*t));
+
+        sr_1d53_cols(cols, mv, mv + lv, n);
+
+        for (i = 0; i < lv; i++)
+            memcpy(t + w * i + lp, COL(l, i), n * sizeof(*t));
+    }
+}
 
-        // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
-            // copy with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = t[w * lp + j];
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = t[w * lp + j];
+/* Same as sr_1d53() and sr_1d53_cols() on 16-bit coefficients, computed
+ * in int: the coefficients are known to fit in 16 bits. */
+static void sr_1d53_16(int16_t *p, int i0, int i1)
+{
+    int i;
 
-            sr_1d53(line, mh, mh + lh);
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            p[1] >>= 1;
+        return;
+    }
 
-            for (i = 0; i < lh; i++)
-                t[w * lp + i] = l[i];
-        }
+    p[i0 - 1] = p[i0 + 1];
+    p[i1]     = p[i1 - 2];
+    p[i0 - 2] = p[i0 + 2];
+    p[i1 + 1] = p[i1 - 3];
 
-        // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-            // copy with interleaving
-            for (i = mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
-            for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
+        p[2 * i] -= (p[2 * i - 1] + p[2 * i + 1] + 2) >> 2;
+    for (i = (i0 >> 1); i < (i1 >> 1); i++)
+        p[2 * i + 1] += (p[2 * i] + p[2 * i + 2]) >> 1;
+}
 
-            sr_1d53(line, mv, mv + lv);
+static void sr_1d53_16_cols(int16_t *p, int i0, int i1, int n)
+{
+    int i, c;
 
-            for (i = 0; i < lv; i++)
-                t[w * i + lp] = l[i];
-        }
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (c = 0; c < n; c++)
+                COL(p, 1)[c] >>= 1;
+        return;
+    }
+
+    memcpy(COL(p, i0 - 1), COL(p, i0 + 1), n * sizeof(*p));
+    memcpy(COL(p, i1),     COL(p, i1 - 2), n * sizeof(*p));
+    memcpy(COL(p, i0 - 2), COL(p, i0 + 2), n * sizeof(*p));
+    memcpy(COL(p, i1 + 1), COL(p, i1 - 3), n * sizeof(*p));
+
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        int16_t *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] -= (a[c] + b[c] + 2) >> 2;
+    }
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        int16_t *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] += (a[c] + b[c]) >> 1;
+    }
+}
+
+static void dwt_decode53_16_hor(DWTContext *s, int16_t *t, int lev,
+                                int start, int end, int16_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        mh = s->mod[lev][0],
+        lp;
+    int16_t *l;
+
+    line += 3;
+    l = line + mh;
+    for (lp = start; lp < end; lp++) {
+        int i, j = 0;
+        // copy with interleaving
+        for (i = mh; i < lh; i += 2, j++)
+            l[i] = t[w * lp + j];
+        for (i = 1 - mh; i < lh; i += 2, j++)
+            l[i] = t[w * lp + j];
+
+        sr_1d53_16(line, mh, mh + lh);
+
+        memcpy(t + w * lp, l, lh * sizeof(*t));
+    }
+}
+
+static void dwt_decode53_16_ver(DWTContext *s, int16_t *t, int lev,
+                                int start, int end, int16_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        lv = s->linelen[lev][1],
+        mv = s->mod[lev][1],
+        lp;
+    int16_t *cols = line + 3 * DWT_COLS;
+    int16_t *l    = COL(cols, mv);
+
+    for (lp = start * DWT_COLS; lp < FFMIN(lh, end * DWT_COLS); lp += DWT_COLS) {
+        int i, j = 0, n = FFMIN(DWT_COLS, lh - lp);
+        // copy with interleaving
+        for (i = mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), t + w * j + lp, n * sizeof(*t));
+        for (i = 1 - mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), t + w * j + lp, n * sizeof(*t));
+
+        sr_1d53_16_cols(cols, mv, mv + lv, n);
+
+        for (i = 0; i < lv; i++)
+            memcpy(t + w * i + lp, COL(l, i), n * sizeof(*t));
     }
 }
 
@@ -398,53 +663,97 @@ static void sr_1d97_float(float *p, int i0, int i1)
         p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
 }
 
-static void dwt_decode97_float(DWTContext *s, float *t)
+static void sr_1d97_float_cols(float *p, int i0, int i1, int n)
 {
-    int lev;
-    int w       = s->linelen[s->ndeclevels - 1][0];
-    float *line = s->f_linebuf;
-    float *data = t;
-    /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    int i, c;
 
-    for (lev = 0; lev < s->ndeclevels; lev++) {
-        int lh = s->linelen[lev][0],
-            lv = s->linelen[lev][1],
-            mh = s->mod[lev][0],
-            mv = s->mod[lev][1],
-            lp;
-        float *l;
-        // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
-            // copy with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = data[w * lp + j];
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = data[w * lp + j];
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (c = 0; c < n; c++)
+                COL(p, 1)[c] *= F_LFTG_K/2;
+        else
+            for (c = 0; c < n; c++)
+                COL(p, 0)[c] *= F_LFTG_X;
+        return;
+    }
 
-            sr_1d97_float(line, mh, mh + lh);
+    extend_cols(p, sizeof(*p), n, i0, i1, 4);
 
-            for (i = 0; i < lh; i++)
-                data[w * lp + i] = l[i];
-        }
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        float *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] -= F_LFTG_DELTA * (a[c] + b[c]);
+    }
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        float *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] -= F_LFTG_GAMMA * (a[c] + b[c]);
+    }
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        float *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] += F_LFTG_BETA * (a[c] + b[c]);
+    }
+    /* step 6 */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        float *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] += F_LFTG_ALPHA * (a[c] + b[c]);
+    }
+}
 
-        // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-            // copy with interleaving
-            for (i = mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
-            for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+static void dwt_decode97_float_hor(DWTContext *s, float *data, int lev,
+                                   int start, int end, float *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        mh = s->mod[lev][0],
+        lp;
+    float *l;
 
-            sr_1d97_float(line, mv, mv + lv);
+    /* position at index O of line range [0-5,w+5] cf. extend function */
+    line += 5;
+    l = line + mh;
+    for (lp = start; lp < end; lp++) {
+        int i, j = 0;
+        // copy with interleaving
+        for (i = mh; i < lh; i += 2, j++)
+            l[i] = data[w * lp + j];
+        for (i = 1 - mh; i < lh; i += 2, j++)
+            l[i] = data[w * lp + j];
+
+        sr_1d97_float(line, mh, mh + lh);
+
+        for (i = 0; i < lh; i++)
+            data[w * lp + i] = l[i];
+    }
+}
 
-            for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
-        }
+static void dwt_decode97_float_ver(DWTContext *s, float *data, int lev,
+                                   int start, int end, float *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        lv = s->linelen[lev][1],
+        mv = s->mod[lev][1],
+        lp;
+    float *cols = line + 5 * DWT_COLS;
+    float *l    = COL(cols, mv);
+
+    for (lp = start * DWT_COLS; lp < FFMIN(lh, end * DWT_COLS); lp += DWT_COLS) {
+        int i, j = 0, n = FFMIN(DWT_COLS, lh - lp);
+        // copy with interleaving
+        for (i = mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), data + w * j + lp, n * sizeof(*data));
+        for (i = 1 - mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), data + w * j + lp, n * sizeof(*data));
+
+        sr_1d97_float_cols(cols, mv, mv + lv, n);
+
+        for (i = 0; i < lv; i++)
+            memcpy(data + w * i + lp, COL(l, i), n * sizeof(*data));
     }
 }
 
@@ -475,62 +784,116 @@ static void sr_1d97_int(int32_t *p, int i0, int i1)
         p[2 * i + 1] += (I_LFTG_ALPHA * (p[2 * i]     + (int64_t)p[2 * i + 2]) + (1 << 15)) >> 16;
 }
 
-static void dwt_decode97_int(DWTContext *s, int32_t *t)
+static void sr_1d97_int_cols(int32_t *p, int i0, int i1, int n)
 {
-    int lev;
-    int w       = s->linelen[s->ndeclevels - 1][0];
-    int h       = s->linelen[s->ndeclevels - 1][1];
-    int i;
-    int32_t *line = s->i_linebuf;
-    int32_t *data = t;
-    /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    int i, c;
 
-    for (i = 0; i < w * h; i++)
-        data[i] *= 1LL << I_PRESHIFT;
-
-    for (lev = 0; lev < s->ndeclevels; lev++) {
-        int lh = s->linelen[lev][0],
-            lv = s->linelen[lev][1],
-            mh = s->mod[lev][0],
-            mv = s->mod[lev][1],
-            lp;
-        int32_t *l;
-        // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
-            // rescale with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = ((data[w * lp + j] * I_LFTG_K) + (1 << 15)) >> 16;
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = data[w * lp + j];
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (c = 0; c < n; c++)
+                COL(p, 1)[c] = (COL(p, 1)[c] * I_LFTG_K + (1<<16)) >> 17;
+        else
+            for (c = 0; c < n; c++)
+                COL(p, 0)[c] = (COL(p, 0)[c] * I_LFTG_X + (1<<15)) >> 16;
+        return;
+    }
 
-            sr_1d97_int(line, mh, mh + lh);
+    extend_cols(p, sizeof(*p), n, i0, i1, 4);
 
-            for (i = 0; i < lh; i++)
-                data[w * lp + i] = l[i];
-        }
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        int32_t *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] -= (I_LFTG_DELTA * (a[c] + (int64_t)b[c]) + (1 << 15)) >> 16;
+    }
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        int32_t *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] -= (I_LFTG_GAMMA * (a[c] + (int64_t)b[c]) + (1 << 15)) >> 16;
+    }
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        int32_t *x = COL(p, 2 * i), *a = COL(p, 2 * i - 1), *b = COL(p, 2 * i + 1);
+        for (c = 0; c < n; c++)
+            x[c] += (I_LFTG_BETA * (a[c] + (int64_t)b[c]) + (1 << 15)) >> 16;
+    }
+    /* step 6 */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        int32_t *x = COL(p, 2 * i + 1), *a = COL(p, 2 * i), *b = COL(p, 2 * i + 2);
+        for (c = 0; c < n; c++)
+            x[c] += (I_LFTG_ALPHA * (a[c] + (int64_t)b[c]) + (1 << 15)) >> 16;
+    }
+}
 
-        // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-            // rescale with interleaving
-            for (i = mv; i < lv; i += 2, j++)
-                l[i] = ((data[w * j + lp] * I_LFTG_K) + (1 << 15)) >> 16;
-            for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+static void dwt_decode97_int_hor(DWTContext *s, int32_t *data, int lev,
+                                 int start, int end, int32_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        mh = s->mod[lev][0],
+        lp;
+    int32_t *l;
 
-            sr_1d97_int(line, mv, mv + lv);
+    /* position at index O of line range [0-5,w+5] cf. extend function */
+    line += 5;
+    l = line + mh;
+    for (lp = start; lp < end; lp++) {
+        int i, j = 0;
+        // rescale with interleaving
+        for (i = mh; i < lh; i += 2, j++)
+            l[i] = ((data[w * lp + j] * I_LFTG_K) + (1 << 15)) >> 16;
+        for (i = 1 - mh; i < lh; i += 2, j++)
+            l[i] = data[w * lp + j];
+
+        sr_1d97_int(line, mh, mh + lh);
+
+        for (i = 0; i < lh; i++)
+            data[w * lp + i] = l[i];
+    }
+}
 
-            for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
-        }
+static void dwt_decode97_int_ver(DWTContext *s, int32_t *data, int lev,
+                                 int start, int end, int32_t *line)
+{
+    int w  = s->linelen[s->ndeclevels - 1][0];
+    int lh = s->linelen[lev][0],
+        lv = s->linelen[lev][1],
+        mv = s->mod[lev][1],
+        lp;
+    int32_t *cols = line + 5 * DWT_COLS;
+    int32_t *l    = COL(cols, mv);
+
+    for (lp = start * DWT_COLS; lp < FFMIN(lh, end * DWT_COLS); lp += DWT_COLS) {
+        int i, j = 0, c, n = FFMIN(DWT_COLS, lh - lp);
+        // rescale with interleaving
+        for (i = mv; i < lv; i += 2, j++)
+            for (c = 0; c < n; c++)
+                COL(l, i)[c] = ((data[w * j + lp + c] * I_LFTG_K) + (1 << 15)) >> 16;
+        for (i = 1 - mv; i < lv; i += 2, j++)
+            memcpy(COL(l, i), data + w * j + lp, n * sizeof(*data));
+
+        sr_1d97_int_cols(cols, mv, mv + lv, n);
+
+        for (i = 0; i < lv; i++)
+            memcpy(data + w * i + lp, COL(l, i), n * sizeof(*data));
     }
+}
 
-    for (i = 0; i < w * h; i++)
-        data[i] = (data[i] + ((1LL<<I_PRESHIFT)>>1)) >> I_PRESHIFT;
+/* The integer 9/7 transform runs on samples scaled by 1 << I_PRESHIFT */
+static void dwt_decode97_int_scale(DWTContext *s, int32_t *data, int post,
+                                   int start, int end)
+{
+    int w = s->linelen[s->ndeclevels - 1][0];
+    int i;
+
+    data += w * start;
+    if (post) {
+        for (i = 0; i < w * (end - start); i++)
+            data[i] = (data[i] + ((1LL<<I_PRESHIFT)>>1)) >> I_PRESHIFT;
+    } else {
+        for (i = 0; i < w * (end - start); i++)
+            data[i] *= 1LL << I_PRESHIFT;
+    }
 }
 
 int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
@@ -557,17 +920,18 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
         }
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_malloc_array((maxlen + 12) * DWT_COLS, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
      case FF_DWT97_INT:
-        s->i_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen + 12) * DWT_COLS, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     case FF_DWT53:
-        s->i_linebuf = av_malloc_array((maxlen +  6), sizeof(*s->i_linebuf));
+    case FF_DWT53_16:
+        s->i_linebuf = av_malloc_array((maxlen +  6) * DWT_COLS, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
@@ -595,24 +959,95 @@ int ff_dwt_encode(DWTContext *s, void *t)
     return 0;
 }
 
-int ff_dwt_decode(DWTContext *s, void *t)
+int ff_dwt_decode_steps(const DWTContext *s)
 {
-    if (s->ndeclevels == 0)
+    return 2 * s->ndeclevels + 2 * (s->ndeclevels && s->type == FF_DWT97_INT);
+}
+
+int ff_dwt_decode_step_units(const DWTContext *s, int step)
+{
+    int lev;
+
+    if (s->type == FF_DWT97_INT) {
+        if (step == 0 || step == ff_dwt_decode_steps(s) - 1)
+            return s->linelen[s->ndeclevels - 1][1];
+        step--;
+    }
+    lev = step >> 1;
+    if (step & 1)
+        return (s->linelen[lev][0] + DWT_COLS - 1) / DWT_COLS;
+    return s->linelen[lev][1];
+}
+
+size_t ff_dwt_linebuf_size(const DWTContext *s)
+{
+    int maxlen;
+
+    if (!s->ndeclevels)
         return 0;
+    maxlen = FFMAX(s->linelen[s->ndeclevels - 1][0],
+                   s->linelen[s->ndeclevels - 1][1]);
+    if (s->type == FF_DWT97)
+        return (maxlen + 12) * DWT_COLS * sizeof(*s->f_linebuf);
+    if (s->type == FF_DWT53_16)
+        return (maxlen + 6) * DWT_COLS * sizeof(int16_t);
+    return (maxlen + (s->type == FF_DWT53 ? 6 : 12)) * DWT_COLS * sizeof(*s->i_linebuf);
+}
+
+void ff_dwt_decode_step(DWTContext *s, void *t, int step, int start, int end,
+                        void *linebuf)
+{
+    int lev;
+
+    if (s->type == FF_DWT97_INT) {
+        if (step == 0 || step == ff_dwt_decode_steps(s) - 1) {
+            dwt_decode97_int_scale(s, t, step > 0, start, end);
+            return;
+        }
+        step--;
+    }
+    lev = step >> 1;
 
     switch (s->type) {
     case FF_DWT97:
-        dwt_decode97_float(s, t);
+        if (step & 1)
+            dwt_decode97_float_ver(s, t, lev, start, end, linebuf);
+        else
+            dwt_decode97_float_hor(s, t, lev, start, end, linebuf);
         break;
     case FF_DWT97_INT:
-        dwt_decode97_int(s, t);
+        if (step & 1)
+            dwt_decode97_int_ver(s, t, lev, start, end, linebuf);
+        else
+            dwt_decode97_int_hor(s, t, lev, start, end, linebuf);
         break;
     case FF_DWT53:
-        dwt_decode53(s, t);
+        if (step & 1)
+            dwt_decode53_ver(s, t, lev, start, end, linebuf);
+        else
+            dwt_decode53_hor(s, t, lev, start, end, linebuf);
+        break;
+    case FF_DWT53_16:
+        if (step & 1)
+            dwt_decode53_16_ver(s, t, lev, start, end, linebuf);
+        else
+            dwt_decode53_16_hor(s, t, lev, start, end, linebuf);
         break;
-    default:
-        return -1;
     }
+}
+
+int ff_dwt_decode(DWTContext *s, void *t)
+{
+    void *linebuf = s->type == FF_DWT97 ? (void*)s->f_linebuf : (void*)s->i_linebuf;
+    int step;
+
+    if (s->ndeclevels == 0)
+        return 0;
+    if (s->type >= FF_DWT_NB)
+        return -1;
+
+    for (step = 0; step < ff_dwt_decode_steps(s); step++)
+        ff_dwt_decode_step(s, t, step, 0, ff_dwt_decode_step_units(s, step), linebuf);
     return 0;
 }
 
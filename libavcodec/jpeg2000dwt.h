@@ -27,6 +27,7 @@
  * Discrete wavelet transform
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define FF_DWT_MAX_DECLVLS 32 ///< max number of decomposition levels
@@ -37,6 +38,7 @@ enum DWTType {
     FF_DWT97,
     FF_DWT53,
     FF_DWT97_INT,
+    FF_DWT53_16,  ///< 5/3 inverse transform of int16_t coefficients, decoding only
     FF_DWT_NB
 };
 
@@ -45,7 +47,7 @@ typedef struct DWTContext {
     int linelen[FF_DWT_MAX_DECLVLS][2];
     uint8_t mod[FF_DWT_MAX_DECLVLS][2];  ///< coordinates (x0, y0) of decomp. levels mod 2
     uint8_t ndeclevels;                  ///< number of decomposition levels
-    uint8_t type;                        ///< 0 for 9/7; 1 for 5/3
+    uint8_t type;                        ///< enum DWTType
     int32_t *i_linebuf;                  ///< int buffer used by transform
     float   *f_linebuf;                  ///< float buffer used by transform
 } DWTContext;
@@ -55,7 +57,7 @@ typedef struct DWTContext {
  * @param s                 DWT context
  * @param border            coordinates of transformed region {{x0, x1}, {y0, y1}}
  * @param decomp_levels     number of decomposition levels
- * @param type              0 for DWT 9/7; 1 for DWT 5/3
+ * @param type              enum DWTType
  */
 int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
                          int decomp_levels, int type);
@@ -63,6 +65,27 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
 int ff_dwt_encode(DWTContext *s, void *t);
 int ff_dwt_decode(DWTContext *s, void *t);
 
+/**
+ * The inverse transform is also available as a sequence of steps, each
+ * made of independent units (rows or groups of columns) which can be run
+ * in parallel. A step must be complete before the next one is started.
+ */
+int ff_dwt_decode_steps(const DWTContext *s);
+int ff_dwt_decode_step_units(const DWTContext *s, int step);
+
+/**
+ * Size in bytes of the line buffer needed by ff_dwt_decode_step().
+ */
+size_t ff_dwt_linebuf_size(const DWTContext *s);
+
+/**
+ * Run the units [start, end) of a step of the inverse transform.
+ * @param linebuf           line buffer of ff_dwt_linebuf_size() bytes, which
+ *                          must not be used by another concurrent call
+ */
+void ff_dwt_decode_step(DWTContext *s, void *t, int step, int start, int end,
+                        void *linebuf);
+
 void ff_dwt_destroy(DWTContext *s);
 
 #endif /* AVCODEC_JPEG2000DWT_H */
@@ -0,0 +1,287 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) tables
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "jpeg2000htdata.h"
+
+/* CxtVLC codewords of the cleanup pass, for the initial row of quads and
+ * for the other rows, as decoding tables indexed by the quad context and
+ * the next 7 bits of the VLC stream. */
+const uint16_t ff_jpeg2000_ht_vlc[2][1024] = {
+    {
+        0x0023, 0x00A5, 0x0043, 0x0066, 0x0083, 0xA8EE, 0x0014, 0xD8DF,
+        0x0023, 0x10BE, 0x0043, 0xF5FF, 0x0083, 0x207E, 0x0055, 0x515F,
+        0x0023, 0x0035, 0x0043, 0x444E, 0x0083, 0xC4CE, 0x0014, 0xCCCF,
+        0x0023, 0xE2FE, 0x0043, 0x99FF, 0x0083, 0x0096, 0x00C5, 0x313F,
+        0x0023, 0x00A5, 0x0043, 0x445E, 0x0083, 0xC8CE, 0x0014, 0x11DF,
+        0x0023, 0xF4FE, 0x0043, 0xFCFF, 0x0083, 0x009E, 0x0055, 0x0077,
+        0x0023, 0x0035, 0x0043, 0xF1FF, 0x0083, 0x88AE, 0x0014, 0x00B7,
+        0x0023, 0xF8FE, 0x0043, 0xE4EF, 0x0083, 0x888E, 0x00C5, 0x111F,
+        0x0023, 0x00A5, 0x0043, 0x0066, 0x0083, 0xA8EE, 0x0014, 0x54DF,
+        0x0023, 0x10BE, 0x0043, 0x22EF, 0x0083, 0x207E, 0x0055, 0x227F,
+        0x0023, 0x0035, 0x0043, 0x444E, 0x0083, 0xC4CE, 0x0014, 0x11BF,
+        0x0023, 0xE2FE, 0x0043, 0x00F7, 0x0083, 0x0096, 0x00C5, 0x223F,
+        0x0023, 0x00A5, 0x0043, 0x445E, 0x0083, 0xC8CE, 0x0014, 0x00D7,
+        0x0023, 0xF4FE, 0x0043, 0xBAFF, 0x0083, 0x009E, 0x0055, 0x006F,
+        0x0023, 0x0035, 0x0043, 0xE6FF, 0x0083, 0x88AE, 0x0014, 0xA2AF,
+        0x0023, 0xF8FE, 0x0043, 0x00E7, 0x0083, 0x888E, 0x00C5, 0x222F,
+        0x0002, 0x00C5, 0x0084, 0x207E, 0x0002, 0xC4CE, 0x0024, 0x00F7,
+        0x0002, 0xA2FE, 0x0044, 0x0056, 0x0002, 0x009E, 0x0014, 0x00D7,
+        0x0002, 0x10BE, 0x0084, 0x0066, 0x0002, 0x88AE, 0x0024, 0x11DF,
+        0x0002, 0xA8EE, 0x0044, 0x0036, 0x0002, 0x888E, 0x0014, 0x111F,
+        0x0002, 0x00C5, 0x0084, 0x006E, 0x0002, 0x88CE, 0x0024, 0x88FF,
+        0x0002, 0xB8FE, 0x0044, 0x444E, 0x0002, 0x0096, 0x0014, 0x00B7,
+        0x0002, 0xE4FE, 0x0084, 0x445E, 0x0002, 0x00A6, 0x0024, 0x00E7,
+        0x0002, 0x54DE, 0x0044, 0x222E, 0x0002, 0x003E, 0x0014, 0x0077,
+        0x0002, 0x00C5, 0x0084, 0x207E, 0x0002, 0xC4CE, 0x0024, 0xF1FF,
+        0x0002, 0xA2FE, 0x0044, 0x0056, 0x0002, 0x009E, 0x0014, 0x11BF,
+        0x0002, 0x10BE, 0x0084, 0x0066, 0x0002, 0x88AE, 0x0024, 0x22EF,
+        0x0002, 0xA8EE, 0x0044, 0x0036, 0x0002, 0x888E, 0x0014, 0x227F,
+        0x0002, 0x00C5, 0x0084, 0x006E, 0x0002, 0x88CE, 0x0024, 0xE4EF,
+        0x0002, 0xB8FE, 0x0044, 0x444E, 0x0002, 0x0096, 0x0014, 0xA2AF,
+        0x0002, 0xE4FE, 0x0084, 0x445E, 0x0002, 0x00A6, 0x0024, 0xD8DF,
+        0x0002, 0x54DE, 0x0044, 0x222E, 0x0002, 0x003E, 0x0014, 0x515F,
+        0x0002, 0x0055, 0x0084, 0x0066, 0x0002, 0x88DE, 0x0024, 0x32FF,
+        0x0002, 0x11FE, 0x0044, 0x444E, 0x0002, 0x00AE, 0x0014, 0x00B7,
+        0x0002, 0x317E, 0x0084, 0x515E, 0x0002, 0x00C6, 0x0024, 0x00D7,
+        0x0002, 0x20EE, 0x0044, 0x111E, 0x0002, 0x009E, 0x0014, 0x0077,
+        0x0002, 0x0055, 0x0084, 0x545E, 0x0002, 0x44CE, 0x0024, 0x00E7,
+        0x0002, 0xF1FE, 0x0044, 0x0036, 0x0002, 0x00A6, 0x0014, 0x555F,
+        0x0002, 0x74FE, 0x0084, 0x113E, 0x0002, 0x20BE, 0x0024, 0x747F,
+        0x0002, 0xC4DE, 0x0044, 0xF8FF, 0x0002, 0x0096, 0x0014, 0x222F,
+        0x0002, 0x0055, 0x0084, 0x0066, 0x0002, 0x88DE, 0x0024, 0x00F7,
+        0x0002, 0x11FE, 0x0044, 0x444E, 0x0002, 0x00AE, 0x0014, 0x888F,
+        0x0002, 0x317E, 0x0084, 0x515E, 0x0002, 0x00C6, 0x0024, 0xC8CF,
+        0x0002, 0x20EE, 0x0044, 0x111E, 0x0002, 0x009E, 0x0014, 0x006F,
+        0x0002, 0x0055, 0x0084, 0x545E, 0x0002, 0x44CE, 0x0024, 0xD1DF,
+        0x0002, 0xF1FE, 0x0044, 0x0036, 0x0002, 0x00A6, 0x0014, 0x227F,
+        0x0002, 0x74FE, 0x0084, 0x113E, 0x0002, 0x20BE, 0x0024, 0x22BF,
+        0x0002, 0xC4DE, 0x0044, 0x22EF, 0x0002, 0x0096, 0x0014, 0x323F,
+        0x0003, 0xD4DE, 0xF4FD, 0xFCFF, 0x0014, 0x113E, 0x0055, 0x888F,
+        0x0003, 0x32BE, 0x0085, 0x00E7, 0x0025, 0x515E, 0xAAFE, 0x727F,
+        0x0003, 0x44CE, 0xF8FD, 0x44EF, 0x0014, 0x647E, 0x0045, 0xA2AF,
+        0x0003, 0x00A6, 0x555D, 0x99DF, 0xF1FD, 0x0036, 0xF5FE, 0x626F,
+        0x0003, 0xD1DE, 0xF4FD, 0xE6FF, 0x0014, 0x717E, 0x0055, 0xB1BF,
+        0x0003, 0x88AE, 0x0085, 0xD5DF, 0x0025, 0x444E, 0xF2FE, 0x667F,
+        0x0003, 0x00C6, 0xF8FD, 0xE2EF, 0x0014, 0x545E, 0x0045, 0x119F,
+        0x0003, 0x0096, 0x555D, 0xC8CF, 0xF1FD, 0x111E, 0xC8EE, 0x0067,
+        0x0003, 0xD4DE, 0xF4FD, 0xF3FF, 0x0014, 0x113E, 0x0055, 0x11BF,
+        0x0003, 0x32BE, 0x0085, 0xD8DF, 0x0025, 0x515E, 0xAAFE, 0x222F,
+        0x0003, 0x44CE, 0xF8FD, 0x00F7, 0x0014, 0x647E, 0x0045, 0x989F,
+        0x0003, 0x00A6, 0x555D, 0x00D7, 0xF1FD, 0x0036, 0xF5FE, 0x446F,
+        0x0003, 0xD1DE, 0xF4FD, 0xB9FF, 0x0014, 0x717E, 0x0055, 0x00B7,
+        0x0003, 0x88AE, 0x0085, 0xDCDF, 0x0025, 0x444E, 0xF2FE, 0x0077,
+        0x0003, 0x00C6, 0xF8FD, 0xE4EF, 0x0014, 0x545E, 0x0045, 0x737F,
+        0x0003, 0x0096, 0x555D, 0xB8BF, 0xF1FD, 0x111E, 0xC8EE, 0x323F,
+        0x0002, 0x00A5, 0x0084, 0x407E, 0x0002, 0x10DE, 0x0024, 0x11DF,
+        0x0002, 0x72FE, 0x0044, 0x0056, 0x0002, 0xA8AE, 0x0014, 0xB2BF,
+        0x0002, 0x0096, 0x0084, 0x0066, 0x0002, 0x00C6, 0x0024, 0x00E7,
+        0x0002, 0xC8EE, 0x0044, 0x222E, 0x0002, 0x888E, 0x0014, 0x0077,
+        0x0002, 0x00A5, 0x0084, 0x006E, 0x0002, 0x88CE, 0x0024, 0x00F7,
+        0x0002, 0x91FE, 0x0044, 0x0036, 0x0002, 0xA2AE, 0x0014, 0xAAAF,
+        0x0002, 0xB8FE, 0x0084, 0x005E, 0x0002, 0x00BE, 0x0024, 0xC4CF,
+        0x0002, 0x44EE, 0x0044, 0xF4FF, 0x0002, 0x223E, 0x0014, 0x111F,
+        0x0002, 0x00A5, 0x0084, 0x407E, 0x0002, 0x10DE, 0x0024, 0x99FF,
+        0x0002, 0x72FE, 0x0044, 0x0056, 0x0002, 0xA8AE, 0x0014, 0x00B7,
+        0x0002, 0x0096, 0x0084, 0x0066, 0x0002, 0x00C6, 0x0024, 0x00D7,
+        0x0002, 0xC8EE, 0x0044, 0x222E, 0x0002, 0x888E, 0x0014, 0x444F,
+        0x0002, 0x00A5, 0x0084, 0x006E, 0x0002, 0x88CE, 0x0024, 0xE2EF,
+        0x0002, 0x91FE, 0x0044, 0x0036, 0x0002, 0xA2AE, 0x0014, 0x447F,
+        0x0002, 0xB8FE, 0x0084, 0x005E, 0x0002, 0x00BE, 0x0024, 0x009F,
+        0x0002, 0x44EE, 0x0044, 0x76FF, 0x0002, 0x223E, 0x0014, 0x313F,
+        0x0003, 0x00C6, 0x0085, 0xD9FF, 0xF2FD, 0x647E, 0xF1FE, 0x99BF,
+        0x0003, 0xA2AE, 0x0025, 0x66EF, 0xF4FD, 0x0056, 0xE2EE, 0x737F,
+        0x0003, 0x98BE, 0x0045, 0x00F7, 0xF8FD, 0x0066, 0x76FE, 0x889F,
+        0x0003, 0x888E, 0x0015, 0xD5DF, 0x00A5, 0x222E, 0x98DE, 0x444F,
+        0x0003, 0xB2BE, 0x0085, 0xFCFF, 0xF2FD, 0x226E, 0x0096, 0x00B7,
+        0x0003, 0xAAAE, 0x0025, 0xD1DF, 0xF4FD, 0x0036, 0xD4DE, 0x646F,
+        0x0003, 0xA8AE, 0x0045, 0xEAEF, 0xF8FD, 0x445E, 0xE8EE, 0x717F,
+        0x0003, 0x323E, 0x0015, 0xC4CF, 0x00A5, 0xFAFF, 0x88CE, 0x313F,
+        0x0003, 0x00C6, 0x0085, 0x77FF, 0xF2FD, 0x647E, 0xF1FE, 0xB3BF,
+        0x0003, 0xA2AE, 0x0025, 0x00E7, 0xF4FD, 0x0056, 0xE2EE, 0x0077,
+        0x0003, 0x98BE, 0x0045, 0xE4EF, 0xF8FD, 0x0066, 0x76FE, 0x667F,
+        0x0003, 0x888E, 0x0015, 0x00D7, 0x00A5, 0x222E, 0x98DE, 0x333F,
+        0x0003, 0xB2BE, 0x0085, 0x75FF, 0xF2FD, 0x226E, 0x0096, 0x919F,
+        0x0003, 0xAAAE, 0x0025, 0x99DF, 0xF4FD, 0x0036, 0xD4DE, 0x515F,
+        0x0003, 0xA8AE, 0x0045, 0xECEF, 0xF8FD, 0x445E, 0xE8EE, 0x727F,
+        0x0003, 0x323E, 0x0015, 0xB1BF, 0x00A5, 0xF3FF, 0x88CE, 0x111F,
+        0x0003, 0x54DE, 0xF2FD, 0x111E, 0x0014, 0x647E, 0xF8FE, 0xCCCF,
+        0x0003, 0x91BE, 0x0045, 0x22EF, 0x0025, 0x222E, 0xF3FE, 0x888F,
+        0x0003, 0x00C6, 0x0085, 0x00F7, 0x0014, 0x115E, 0xFCFE, 0xA8AF,
+        0x0003, 0x00A6, 0x0035, 0xC8DF, 0xF1FD, 0x313E, 0x66FE, 0x646F,
+        0x0003, 0xC8CE, 0xF2FD, 0xF5FF, 0x0014, 0x0066, 0xF4FE, 0xBABF,
+        0x0003, 0x22AE, 0x0045, 0x00E7, 0x0025, 0x323E, 0xEAFE, 0x737F,
+        0x0003, 0xB2BE, 0x0085, 0x55DF, 0x0014, 0x0056, 0x717E, 0x119F,
+        0x0003, 0x0096, 0x0035, 0xC4CF, 0xF1FD, 0x333E, 0xE8EE, 0x444F,
+        0x0003, 0x54DE, 0xF2FD, 0x111E, 0x0014, 0x647E, 0xF8FE, 0x99BF,
+        0x0003, 0x91BE, 0x0045, 0xE2EF, 0x0025, 0x222E, 0xF3FE, 0x667F,
+        0x0003, 0x00C6, 0x0085, 0xE4EF, 0x0014, 0x115E, 0xFCFE, 0x989F,
+        0x0003, 0x00A6, 0x0035, 0x00D7, 0xF1FD, 0x313E, 0x66FE, 0x226F,
+        0x0003, 0xC8CE, 0xF2FD, 0xB9FF, 0x0014, 0x0066, 0xF4FE, 0x00B7,
+        0x0003, 0x22AE, 0x0045, 0xD1DF, 0x0025, 0x323E, 0xEAFE, 0x0077,
+        0x0003, 0xB2BE, 0x0085, 0xECEF, 0x0014, 0x0056, 0x717E, 0x727F,
+        0x0003, 0x0096, 0x0035, 0xB8BF, 0xF1FD, 0x333E, 0xE8EE, 0x545F,
+        0xF1FC, 0xD1DE, 0xFAFD, 0x00D7, 0xF8FC, 0x0016, 0xFFFD, 0x747F,
+        0xF4FC, 0x717E, 0xF3FD, 0xB3BF, 0xF2FC, 0xEAEF, 0xE8EE, 0x444F,
+        0xF1FC, 0x22AE, 0x0005, 0xB8BF, 0xF8FC, 0x00F7, 0xFCFE, 0x0077,
+        0xF4FC, 0x115E, 0xF5FD, 0x757F, 0xF2FC, 0xD8DF, 0xE2EE, 0x333F,
+        0xF1FC, 0xB2BE, 0xFAFD, 0x88CF, 0xF8FC, 0xFBFF, 0xFFFD, 0x737F,
+        0xF4FC, 0x006E, 0xF3FD, 0x00B7, 0xF2FC, 0x66EF, 0xF9FE, 0x313F,
+        0xF1FC, 0x009E, 0x0005, 0xBABF, 0xF8FC, 0xFDFF, 0xF6FE, 0x0067,
+        0xF4FC, 0x0026, 0xF5FD, 0x888F, 0xF2FC, 0xDCDF, 0xD4DE, 0x222F,
+        0xF1FC, 0xD1DE, 0xFAFD, 0xC4CF, 0xF8FC, 0x0016, 0xFFFD, 0x727F,
+        0xF4FC, 0x717E, 0xF3FD, 0x99BF, 0xF2FC, 0xECEF, 0xE8EE, 0x0047,
+        0xF1FC, 0x22AE, 0x0005, 0x00A7, 0xF8FC, 0xF7FF, 0xFCFE, 0x0057,
+        0xF4FC, 0x115E, 0xF5FD, 0x0097, 0xF2FC, 0xD5DF, 0xE2EE, 0x0037,
+        0xF1FC, 0xB2BE, 0xFAFD, 0x00C7, 0xF8FC, 0xFEFF, 0xFFFD, 0x667F,
+        0xF4FC, 0x006E, 0xF3FD, 0xA8AF, 0xF2FC, 0x00E7, 0xF9FE, 0x323F,
+        0xF1FC, 0x009E, 0x0005, 0xB1BF, 0xF8FC, 0xE4EF, 0xF6FE, 0x545F,
+        0xF4FC, 0x0026, 0xF5FD, 0x0087, 0xF2FC, 0x99DF, 0xD4DE, 0x111F,
+    },
+    {
+        0x0013, 0x0065, 0x0043, 0x00DE, 0x0083, 0x888D, 0x0023, 0x444E,
+        0x0013, 0x00A5, 0x0043, 0x88AE, 0x0083, 0x0035, 0x0023, 0x00D7,
+        0x0013, 0x00C5, 0x0043, 0x009E, 0x0083, 0x0055, 0x0023, 0x222E,
+        0x0013, 0x0095, 0x0043, 0x007E, 0x0083, 0x10FE, 0x0023, 0x0077,
+        0x0013, 0x0065, 0x0043, 0x88CE, 0x0083, 0x888D, 0x0023, 0x111E,
+        0x0013, 0x00A5, 0x0043, 0x005E, 0x0083, 0x0035, 0x0023, 0x00E7,
+        0x0013, 0x00C5, 0x0043, 0x00BE, 0x0083, 0x0055, 0x0023, 0x11FF,
+        0x0013, 0x0095, 0x0043, 0x003E, 0x0083, 0x40EE, 0x0023, 0xA2AF,
+        0x0013, 0x0065, 0x0043, 0x00DE, 0x0083, 0x888D, 0x0023, 0x444E,
+        0x0013, 0x00A5, 0x0043, 0x88AE, 0x0083, 0x0035, 0x0023, 0x44EF,
+        0x0013, 0x00C5, 0x0043, 0x009E, 0x0083, 0x0055, 0x0023, 0x222E,
+        0x0013, 0x0095, 0x0043, 0x007E, 0x0083, 0x10FE, 0x0023, 0x00B7,
+        0x0013, 0x0065, 0x0043, 0x88CE, 0x0083, 0x888D, 0x0023, 0x111E,
+        0x0013, 0x00A5, 0x0043, 0x005E, 0x0083, 0x0035, 0x0023, 0xC4CF,
+        0x0013, 0x00C5, 0x0043, 0x00BE, 0x0083, 0x0055, 0x0023, 0x00F7,
+        0x0013, 0x0095, 0x0043, 0x003E, 0x0083, 0x40EE, 0x0023, 0x006F,
+        0x0001, 0x0084, 0x0001, 0x0056, 0x0001, 0x0014, 0x0001, 0x00D7,
+        0x0001, 0x0024, 0x0001, 0x0096, 0x0001, 0x0045, 0x0001, 0x0077,
+        0x0001, 0x0084, 0x0001, 0x00C6, 0x0001, 0x0014, 0x0001, 0x888F,
+        0x0001, 0x0024, 0x0001, 0x00F7, 0x0001, 0x0035, 0x0001, 0x222F,
+        0x0001, 0x0084, 0x0001, 0x40FE, 0x0001, 0x0014, 0x0001, 0x00B7,
+        0x0001, 0x0024, 0x0001, 0x00BF, 0x0001, 0x0045, 0x0001, 0x0067,
+        0x0001, 0x0084, 0x0001, 0x00A6, 0x0001, 0x0014, 0x0001, 0x444F,
+        0x0001, 0x0024, 0x0001, 0x00E7, 0x0001, 0x0035, 0x0001, 0x113F,
+        0x0001, 0x0084, 0x0001, 0x0056, 0x0001, 0x0014, 0x0001, 0x00CF,
+        0x0001, 0x0024, 0x0001, 0x0096, 0x0001, 0x0045, 0x0001, 0x006F,
+        0x0001, 0x0084, 0x0001, 0x00C6, 0x0001, 0x0014, 0x0001, 0x009F,
+        0x0001, 0x0024, 0x0001, 0x00EF, 0x0001, 0x0035, 0x0001, 0x323F,
+        0x0001, 0x0084, 0x0001, 0x40FE, 0x0001, 0x0014, 0x0001, 0x00AF,
+        0x0001, 0x0024, 0x0001, 0x44FF, 0x0001, 0x0045, 0x0001, 0x005F,
+        0x0001, 0x0084, 0x0001, 0x00A6, 0x0001, 0x0014, 0x0001, 0x007F,
+        0x0001, 0x0024, 0x0001, 0x00DF, 0x0001, 0x0035, 0x0001, 0x111F,
+        0x0001, 0x0024, 0x0001, 0x0056, 0x0001, 0x0085, 0x0001, 0x00BF,
+        0x0001, 0x0014, 0x0001, 0x00F7, 0x0001, 0x00C6, 0x0001, 0x0077,
+        0x0001, 0x0024, 0x0001, 0xF8FF, 0x0001, 0x0045, 0x0001, 0x007F,
+        0x0001, 0x0014, 0x0001, 0x00DF, 0x0001, 0x00A6, 0x0001, 0x313F,
+        0x0001, 0x0024, 0x0001, 0x222E, 0x0001, 0x0085, 0x0001, 0x00B7,
+        0x0001, 0x0014, 0x0001, 0x44EF, 0x0001, 0xA2AE, 0x0001, 0x0067,
+        0x0001, 0x0024, 0x0001, 0x51FF, 0x0001, 0x0045, 0x0001, 0x0097,
+        0x0001, 0x0014, 0x0001, 0x00CF, 0x0001, 0x0036, 0x0001, 0x223F,
+        0x0001, 0x0024, 0x0001, 0x0056, 0x0001, 0x0085, 0x0001, 0xB2BF,
+        0x0001, 0x0014, 0x0001, 0x40EF, 0x0001, 0x00C6, 0x0001, 0x006F,
+        0x0001, 0x0024, 0x0001, 0x72FF, 0x0001, 0x0045, 0x0001, 0x009F,
+        0x0001, 0x0014, 0x0001, 0x00D7, 0x0001, 0x00A6, 0x0001, 0x444F,
+        0x0001, 0x0024, 0x0001, 0x222E, 0x0001, 0x0085, 0x0001, 0xA8AF,
+        0x0001, 0x0014, 0x0001, 0x00E7, 0x0001, 0xA2AE, 0x0001, 0x005F,
+        0x0001, 0x0024, 0x0001, 0x44FF, 0x0001, 0x0045, 0x0001, 0x888F,
+        0x0001, 0x0014, 0x0001, 0xAAAF, 0x0001, 0x0036, 0x0001, 0x111F,
+        0x0002, 0xF8FE, 0x0024, 0x0056, 0x0002, 0x00B6, 0x0085, 0x66FF,
+        0x0002, 0x00CE, 0x0014, 0x111E, 0x0002, 0x0096, 0x0035, 0xA8AF,
+        0x0002, 0x00F6, 0x0024, 0x313E, 0x0002, 0x00A6, 0x0045, 0xB3BF,
+        0x0002, 0xB2BE, 0x0014, 0xF5FF, 0x0002, 0x0066, 0x517E, 0x545F,
+        0x0002, 0xF2FE, 0x0024, 0x222E, 0x0002, 0x22AE, 0x0085, 0x44EF,
+        0x0002, 0x00C6, 0x0014, 0xF4FF, 0x0002, 0x0076, 0x0035, 0x447F,
+        0x0002, 0x40DE, 0x0024, 0x323E, 0x0002, 0x009E, 0x0045, 0x00D7,
+        0x0002, 0x88BE, 0x0014, 0xFAFF, 0x0002, 0x115E, 0xF1FE, 0x444F,
+        0x0002, 0xF8FE, 0x0024, 0x0056, 0x0002, 0x00B6, 0x0085, 0xC8EF,
+        0x0002, 0x00CE, 0x0014, 0x111E, 0x0002, 0x0096, 0x0035, 0x888F,
+        0x0002, 0x00F6, 0x0024, 0x313E, 0x0002, 0x00A6, 0x0045, 0x44DF,
+        0x0002, 0xB2BE, 0x0014, 0xA8FF, 0x0002, 0x0066, 0x517E, 0x006F,
+        0x0002, 0xF2FE, 0x0024, 0x222E, 0x0002, 0x22AE, 0x0085, 0x00E7,
+        0x0002, 0x00C6, 0x0014, 0xE2EF, 0x0002, 0x0076, 0x0035, 0x727F,
+        0x0002, 0x40DE, 0x0024, 0x323E, 0x0002, 0x009E, 0x0045, 0xB1BF,
+        0x0002, 0x88BE, 0x0014, 0x73FF, 0x0002, 0x115E, 0xF1FE, 0x333F,
+        0x0001, 0x0084, 0x0001, 0x20EE, 0x0001, 0x00C5, 0x0001, 0xC4CF,
+        0x0001, 0x0044, 0x0001, 0x32FF, 0x0001, 0x0015, 0x0001, 0x888F,
+        0x0001, 0x0084, 0x0001, 0x0066, 0x0001, 0x0025, 0x0001, 0x00AF,
+        0x0001, 0x0044, 0x0001, 0x22EF, 0x0001, 0x00A6, 0x0001, 0x005F,
+        0x0001, 0x0084, 0x0001, 0x444E, 0x0001, 0x00C5, 0x0001, 0xCCCF,
+        0x0001, 0x0044, 0x0001, 0x00F7, 0x0001, 0x0015, 0x0001, 0x006F,
+        0x0001, 0x0084, 0x0001, 0x0056, 0x0001, 0x0025, 0x0001, 0x009F,
+        0x0001, 0x0044, 0x0001, 0x00DF, 0x0001, 0x30FE, 0x0001, 0x222F,
+        0x0001, 0x0084, 0x0001, 0x20EE, 0x0001, 0x00C5, 0x0001, 0xC8CF,
+        0x0001, 0x0044, 0x0001, 0x11FF, 0x0001, 0x0015, 0x0001, 0x0077,
+        0x0001, 0x0084, 0x0001, 0x0066, 0x0001, 0x0025, 0x0001, 0x007F,
+        0x0001, 0x0044, 0x0001, 0x00E7, 0x0001, 0x00A6, 0x0001, 0x0037,
+        0x0001, 0x0084, 0x0001, 0x444E, 0x0001, 0x00C5, 0x0001, 0x00B7,
+        0x0001, 0x0044, 0x0001, 0x00BF, 0x0001, 0x0015, 0x0001, 0x003F,
+        0x0001, 0x0084, 0x0001, 0x0056, 0x0001, 0x0025, 0x0001, 0x0097,
+        0x0001, 0x0044, 0x0001, 0x00D7, 0x0001, 0x30FE, 0x0001, 0x111F,
+        0x0002, 0xA8EE, 0x0044, 0x888E, 0x0002, 0x00D6, 0x00C5, 0xF3FF,
+        0x0002, 0xFCFE, 0x0025, 0x003E, 0x0002, 0x00B6, 0x0055, 0xD8DF,
+        0x0002, 0xF8FE, 0x0044, 0x0066, 0x0002, 0x207E, 0x0085, 0x99FF,
+        0x0002, 0x00E6, 0x00F5, 0x0036, 0x0002, 0x00A6, 0x0015, 0x009F,
+        0x0002, 0xF2FE, 0x0044, 0x0076, 0x0002, 0x44CE, 0x00C5, 0x76FF,
+        0x0002, 0xF1FE, 0x0025, 0x444E, 0x0002, 0x00AE, 0x0055, 0xC8CF,
+        0x0002, 0xF4FE, 0x0044, 0x445E, 0x0002, 0x10BE, 0x0085, 0xE4EF,
+        0x0002, 0x54DE, 0x00F5, 0x111E, 0x0002, 0x0096, 0x0015, 0x222F,
+        0x0002, 0xA8EE, 0x0044, 0x888E, 0x0002, 0x00D6, 0x00C5, 0xFAFF,
+        0x0002, 0xFCFE, 0x0025, 0x003E, 0x0002, 0x00B6, 0x0055, 0x11BF,
+        0x0002, 0xF8FE, 0x0044, 0x0066, 0x0002, 0x207E, 0x0085, 0x22EF,
+        0x0002, 0x00E6, 0x00F5, 0x0036, 0x0002, 0x00A6, 0x0015, 0x227F,
+        0x0002, 0xF2FE, 0x0044, 0x0076, 0x0002, 0x44CE, 0x00C5, 0xD5FF,
+        0x0002, 0xF1FE, 0x0025, 0x444E, 0x0002, 0x00AE, 0x0055, 0x006F,
+        0x0002, 0xF4FE, 0x0044, 0x445E, 0x0002, 0x10BE, 0x0085, 0x11DF,
+        0x0002, 0x54DE, 0x00F5, 0x111E, 0x0002, 0x0096, 0x0015, 0x515F,
+        0x0003, 0x00F6, 0x0014, 0x111E, 0x0044, 0x888E, 0x00A5, 0xD4DF,
+        0x0003, 0xA2AE, 0x0055, 0x76FF, 0x0024, 0x223E, 0x00B6, 0xAAAF,
+        0x0003, 0x00E6, 0x0014, 0xF5FF, 0x0044, 0x0066, 0x0085, 0xCCCF,
+        0x0003, 0x009E, 0x00C5, 0x44EF, 0x0024, 0x0036, 0xF8FE, 0x317F,
+        0x0003, 0xE8EE, 0x0014, 0xF1FF, 0x0044, 0x0076, 0x00A5, 0xC4CF,
+        0x0003, 0x227E, 0x0055, 0xD1DF, 0x0024, 0x444E, 0xF4FE, 0x515F,
+        0x0003, 0x00D6, 0x0014, 0xE2EF, 0x0044, 0x445E, 0x0085, 0x22BF,
+        0x0003, 0x0096, 0x00C5, 0xC8DF, 0x0024, 0x222E, 0xF2FE, 0x226F,
+        0x0003, 0x00F6, 0x0014, 0x111E, 0x0044, 0x888E, 0x00A5, 0xB1BF,
+        0x0003, 0xA2AE, 0x0055, 0x33FF, 0x0024, 0x223E, 0x00B6, 0xA8AF,
+        0x0003, 0x00E6, 0x0014, 0xB9FF, 0x0044, 0x0066, 0x0085, 0xA8BF,
+        0x0003, 0x009E, 0x00C5, 0xE4EF, 0x0024, 0x0036, 0xF8FE, 0x646F,
+        0x0003, 0xE8EE, 0x0014, 0xFCFF, 0x0044, 0x0076, 0x00A5, 0xC8CF,
+        0x0003, 0x227E, 0x0055, 0xEAEF, 0x0024, 0x444E, 0xF4FE, 0x747F,
+        0x0003, 0x00D6, 0x0014, 0xFAFF, 0x0044, 0x445E, 0x0085, 0xB2BF,
+        0x0003, 0x0096, 0x00C5, 0x44DF, 0x0024, 0x222E, 0xF2FE, 0x313F,
+        0x00F3, 0xFAFE, 0xF1FD, 0x0036, 0x0004, 0x32BE, 0x0075, 0x11DF,
+        0x00F3, 0x54DE, 0xF2FD, 0xE4EF, 0x00D5, 0x717E, 0xFCFE, 0x737F,
+        0x00F3, 0xF3FE, 0xF8FD, 0x111E, 0x0004, 0x0096, 0x0055, 0xB1BF,
+        0x00F3, 0x00CE, 0x00B5, 0xD8DF, 0xF4FD, 0x0066, 0xB9FE, 0x545F,
+        0x00F3, 0x76FE, 0xF1FD, 0x0026, 0x0004, 0x00A6, 0x0075, 0x009F,
+        0x00F3, 0x00AE, 0xF2FD, 0xF7FF, 0x00D5, 0x0046, 0xF5FE, 0x747F,
+        0x00F3, 0x00E6, 0xF8FD, 0x0016, 0x0004, 0x0086, 0x0055, 0x888F,
+        0x00F3, 0x00C6, 0x00B5, 0xE2EF, 0xF4FD, 0x115E, 0xA8EE, 0x113F,
+        0x00F3, 0xFAFE, 0xF1FD, 0x0036, 0x0004, 0x32BE, 0x0075, 0xD1DF,
+        0x00F3, 0x54DE, 0xF2FD, 0xFBFF, 0x00D5, 0x717E, 0xFCFE, 0x447F,
+        0x00F3, 0xF3FE, 0xF8FD, 0x111E, 0x0004, 0x0096, 0x0055, 0x727F,
+        0x00F3, 0x00CE, 0x00B5, 0x22EF, 0xF4FD, 0x0066, 0xB9FE, 0x444F,
+        0x00F3, 0x76FE, 0xF1FD, 0x0026, 0x0004, 0x00A6, 0x0075, 0x11BF,
+        0x00F3, 0x00AE, 0xF2FD, 0xFFFF, 0x00D5, 0x0046, 0xF5FE, 0x323F,
+        0x00F3, 0x00E6, 0xF8FD, 0x0016, 0x0004, 0x0086, 0x0055, 0x006F,
+        0x00F3, 0x00C6, 0x00B5, 0xB8BF, 0xF4FD, 0x115E, 0xA8EE, 0x222F,
+    },
+};
@@ -0,0 +1,37 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) tables
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_JPEG2000HTDATA_H
+#define AVCODEC_JPEG2000HTDATA_H
+
+#include <stdint.h>
+
+/* Fields of the entries of ff_jpeg2000_ht_vlc */
+#define HT_VLC_LEN(e)   ((e) & 7)          // codeword length
+#define HT_VLC_UOFF(e)  (((e) >> 3) & 1)   // u_off, an unsigned residual follows
+#define HT_VLC_RHO(e)   (((e) >> 4) & 0xF) // significance of the 4 samples
+#define HT_VLC_EMB1(e)  (((e) >> 8) & 0xF) // values of the known MSBs
+#define HT_VLC_EMBK(e)  ((e) >> 12)        // samples with a known MSB
+
+/* Context-indexed CxtVLC decoding tables, [0] for the first row of quads
+ * of a code block and [1] for the others */
+extern const uint16_t ff_jpeg2000_ht_vlc[2][1024];
+
+#endif /* AVCODEC_JPEG2000HTDATA_H */
@@ -0,0 +1,469 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) block decoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * HT block decoder
+ *
+ * The cleanup pass codes the samples of a code block by quads of 2x2
+ * samples, with three byte streams sharing its segment: the MagSgn bits
+ * read forwards from its start, and the MEL and VLC streams, which start
+ * from both ends of its suffix of Scup bytes. The SigProp and MagRef
+ * passes then refine the block by one bit-plane, from the two ends of
+ * a second segment.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/log.h"
+#include "jpeg2000.h"
+#include "jpeg2000htdata.h"
+#include "jpeg2000htdec.h"
+
+/* Exponents of the runs of the MEL coder, by state */
+static const uint8_t mel_exp[13] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 5 };
+
+/* Prefix length | suffix length << 2 | base << 5 of the U-VLC codes, by
+ * the next 3 bits of the VLC stream */
+static const uint8_t uvlc_dec[8] = {
+    3 | 5 << 2 | 5 << 5, 1 | 0 << 2 | 1 << 5, 2 | 0 << 2 | 2 << 5, 1 | 0 << 2 | 1 << 5,
+    3 | 1 << 2 | 3 << 5, 1 | 0 << 2 | 1 << 5, 2 | 0 << 2 | 2 << 5, 1 | 0 << 2 | 1 << 5,
+};
+
+/* Bit stream read forwards, lsb first. A byte after 0xFF has its msb
+ * stuffed; pad is read past the end. */
+typedef struct StreamFwd {
+    const uint8_t *buf;
+    int pos, size;
+    uint64_t tmp;
+    int bits;
+    int unstuff;
+    uint8_t pad;
+} StreamFwd;
+
+/* Bit stream read backwards, lsb first. A byte after one above 0x8F has
+ * its msb stuffed when its other bits are all set; 0 is read past the
+ * start. */
+typedef struct StreamRev {
+    const uint8_t *buf;
+    int pos;
+    uint64_t tmp;
+    int bits;
+    int unstuff;
+} StreamRev;
+
+typedef struct MelDecoder {
+    const uint8_t *buf;
+    int pos, size;
+    int byte, bits;
+    int unstuff;
+    int k;
+    int zeros;  // 0 events left in the current run
+    int one;    // the current run ends with a 1 event
+} MelDecoder;
+
+static void fwd_init(StreamFwd *s, const uint8_t *buf, int size, uint8_t pad)
+{
+    *s = (StreamFwd){ .buf = buf, .size = size, .pad = pad };
+}
+
+static void fwd_refill(StreamFwd *s)
+{
+    while (s->bits <= 56) {
+        int d = s->pos < s->size ? s->buf[s->pos++] : s->pad;
+        int n = 8 - s->unstuff;
+
+        s->tmp    |= (uint64_t)(d & ((1 << n) - 1)) << s->bits;
+        s->bits   += n;
+        s->unstuff = d == 0xFF;
+    }
+}
+
+static av_always_inline unsigned fwd_get(StreamFwd *s, int n)
+{
+    unsigned v;
+
+    if (s->bits < 32)
+        fwd_refill(s);
+    v = s->tmp & ((1ULL << n) - 1);
+    s->tmp  >>= n;
+    s->bits  -= n;
+    return v;
+}
+
+static void rev_refill(StreamRev *s)
+{
+    while (s->bits <= 56) {
+        int d = s->pos >= 0 ? s->buf[s->pos--] : 0;
+        int n = 8 - (s->unstuff && (d & 0x7F) == 0x7F);
+
+        s->tmp    |= (uint64_t)(d & ((1 << n) - 1)) << s->bits;
+        s->bits   += n;
+        s->unstuff = d > 0x8F;
+    }
+}
+
+static av_always_inline void rev_skip(StreamRev *s, int n)
+{
+    s->tmp  >>= n;
+    s->bits  -= n;
+}
+
+static void mel_init(MelDecoder *mel, const uint8_t *buf, int size)
+{
+    *mel = (MelDecoder){ .buf = buf, .size = size };
+}
+
+static int mel_get_bit(MelDecoder *mel)
+{
+    if (!mel->bits) {
+        int d = 0xFF;
+
+        if (mel->pos < mel->size) {
+            d = mel->buf[mel->pos++];
+            /* the last byte is shared with the VLC stream */
+            if (mel->pos == mel->size)
+                d |= 0x0F;
+        }
+        mel->byte    = d;
+        mel->bits    = 8 - mel->unstuff;
+        mel->unstuff = d == 0xFF;
+    }
+    return (mel->byte >> --mel->bits) & 1;
+}
+
+/* Next event of the MEL run length coder */
+static int mel_decode(MelDecoder *mel)
+{
+    while (!mel->zeros && !mel->one) {
+        int e = mel_exp[mel->k];
+
+        if (mel_get_bit(mel)) {
+            mel->zeros = 1 << e;
+            mel->k     = FFMIN(mel->k + 1, 12);
+        } else {
+            int run = 0;
+            while (e--)
+                run = run << 1 | mel_get_bit(mel);
+            mel->zeros = run;
+            mel->one   = 1;
+            mel->k     = FFMAX(mel->k - 1, 0);
+        }
+    }
+    if (mel->zeros) {
+        mel->zeros--;
+        return 0;
+    }
+    mel->one = 0;
+    return 1;
+}
+
+/* Read the prefix of a U-VLC code, returning its entry of uvlc_dec */
+static av_always_inline int uvlc_prefix(StreamRev *vlc)
+{
+    int d = uvlc_dec[vlc->tmp & 7];
+    rev_skip(vlc, d & 3);
+    return d;
+}
+
+/* Read the suffix of a U-VLC code of prefix d, returning the value */
+static av_always_inline int uvlc_suffix(StreamRev *vlc, int d)
+{
+    int n = (d >> 2) & 7;
+    int u = (d >> 5) + (vlc->tmp & ((1 << n) - 1));
+    rev_skip(vlc, n);
+    return u;
+}
+
+/* Decode the unsigned residuals of the quads of a pair, whose presence
+ * is signaled by mode, u_off of the first quad | u_off of the second one
+ * << 1. In the initial row, a MEL event tells when both exceed 2. */
+static void decode_uvlc(StreamRev *vlc, MelDecoder *mel, int mode,
+                        int initial, int u[2])
+{
+    int d0, d1;
+
+    u[0] = u[1] = 0;
+    switch (mode) {
+    case 1:
+    case 2:
+        d0 = uvlc_prefix(vlc);
+        u[mode - 1] = uvlc_suffix(vlc, d0);
+        break;
+    case 3:
+        d0 = uvlc_prefix(vlc);
+        if (initial && mel_decode(mel)) {
+            d1   = uvlc_prefix(vlc);
+            u[0] = uvlc_suffix(vlc, d0) + 2;
+            u[1] = uvlc_suffix(vlc, d1) + 2;
+        } else if (initial && (d0 & 3) == 3) {
+            /* u[0] > 2, hence u[1] is 1 or 2 */
+            u[1] = (vlc->tmp & 1) + 1;
+            rev_skip(vlc, 1);
+            u[0] = uvlc_suffix(vlc, d0);
+        } else {
+            d1   = uvlc_prefix(vlc);
+            u[0] = uvlc_suffix(vlc, d0);
+            u[1] = uvlc_suffix(vlc, d1);
+        }
+        break;
+    }
+}
+
+/* The cleanup pass, coding the magnitudes of the samples above bit-plane
+ * p. The values are stored twice, with the midpoint of their last bin. */
+static int decode_cleanup(void *logctx, Jpeg2000T1Context *t1,
+                          const uint8_t *buf, int lcup,
+                          int width, int height, int p)
+{
+    int qw = (width + 1) >> 1;
+    /* exponents E of the last row of the previous and current row pairs,
+     * from column -1 */
+    uint8_t e_buf[2][1024 + 4] = { { 0 } };
+    uint8_t *e_prev = e_buf[0] + 1, *e_cur = e_buf[1] + 1;
+    StreamFwd magsgn;
+    StreamRev vlc;
+    MelDecoder mel;
+    int scup, pcup, d, x, y, q, i, n;
+
+    if (lcup < 2)
+        return AVERROR_INVALIDDATA;
+    scup = (buf[lcup - 1] << 4) + (buf[lcup - 2] & 0xF);
+    if (scup < 2 || scup > lcup || scup > 4079) {
+        av_log(logctx, AV_LOG_ERROR, "Invalid HT cleanup suffix length %d\n", scup);
+        return AVERROR_INVALIDDATA;
+    }
+    pcup = lcup - scup;
+
+    fwd_init(&magsgn, buf, pcup, 0xFF);
+    mel_init(&mel, buf + pcup, scup - 1);
+
+    d   = buf[lcup - 2];
+    vlc = (StreamRev){
+        .buf     = buf + pcup,
+        .pos     = scup - 3,
+        .tmp     = d >> 4,
+        .bits    = 4 - ((d >> 4 & 7) == 7),
+        .unstuff = (d | 0xF) > 0x8F,
+    };
+    vlc.tmp &= (1 << vlc.bits) - 1;
+
+    for (y = 0; y < height; y += 2) {
+        const uint16_t *tbl = ff_jpeg2000_ht_vlc[!!y];
+        int c = 0;
+
+        memset(e_cur - 1, 0, width + 4);
+        for (q = 0; q < qw; q += 2) {
+            int t[2] = { 0 }, u[2], U[2];
+
+            if (vlc.bits < 32)
+                rev_refill(&vlc);
+            for (i = 0; i < 2 && q + i < qw; i++) {
+                int x0 = 2 * (q + i), e;
+
+                if (y) {
+                    c |= (!!e_prev[x0 - 1] | !!e_prev[x0]) |
+                         (!!e_prev[x0 + 1] | !!e_prev[x0 + 2]) << 2;
+                }
+                e = tbl[c << 7 | (vlc.tmp & 0x7F)];
+                if (!c && !mel_decode(&mel))
+                    e = 0;
+                rev_skip(&vlc, HT_VLC_LEN(e));
+                t[i] = e;
+
+                /* context of the next quad */
+                n = HT_VLC_RHO(e);
+                if (!y)
+                    c = (n & 1 | n >> 1 & 1) | (n >> 2 & 1) << 1 | (n >> 3) << 2;
+                else
+                    c = (n >> 2 & 1 | n >> 3) << 1;
+            }
+
+            decode_uvlc(&vlc, &mel, HT_VLC_UOFF(t[0]) | HT_VLC_UOFF(t[1]) << 1,
+                        !y, u);
+
+            for (i = 0; i < 2 && q + i < qw; i++) {
+                int x0 = 2 * (q + i), rho = HT_VLC_RHO(t[i]), kappa = 1;
+
+                if (!rho)
+                    continue;
+                if (y && (rho & (rho - 1))) {
+                    int emax = FFMAX(FFMAX(e_prev[x0 - 1], e_prev[x0]),
+                                     FFMAX(e_prev[x0 + 1], e_prev[x0 + 2]));
+                    kappa = FFMAX(emax - 1, 1);
+                }
+                U[i] = kappa + u[i];
+                if (U[i] + p > 30) {
+                    av_log(logctx, AV_LOG_ERROR, "Invalid HT magnitude exponent %d\n", U[i]);
+                    return AVERROR_INVALIDDATA;
+                }
+
+                for (n = 0; n < 4; n++) {
+                    int m, mu, v;
+
+                    if (!(rho >> n & 1))
+                        continue;
+                    m  = U[i] - (HT_VLC_EMBK(t[i]) >> n & 1);
+                    v  = fwd_get(&magsgn, m);
+                    v |= (HT_VLC_EMB1(t[i]) >> n & 1) << m;
+                    mu = (v >> 1) + 1;
+                    /* keep the magnitude in the range of the MQ decoder, with room
+                     * for the MagRef bit */
+                    if (mu >= 1 << (29 - p)) {
+                        av_log(logctx, AV_LOG_ERROR, "Invalid HT magnitude %d\n", mu);
+                        return AVERROR_INVALIDDATA;
+                    }
+
+                    x = x0 + (n >> 1);
+                    if (x >= width || y + (n & 1) >= height)
+                        continue;
+                    t1->data[(y + (n & 1)) * t1->stride + x] =
+                        v & 1 ? -((2 * mu + 1) << p) : (2 * mu + 1) << p;
+                    if (n & 1)
+                        e_cur[x] = av_log2(2 * mu - 1) + 1;
+                }
+            }
+        }
+        FFSWAP(uint8_t *, e_prev, e_cur);
+    }
+
+    return 0;
+}
+
+/* Whether one of the 8 neighbours of a sample is significant. In vertically
+ * causal mode, the samples below the stripe are not used. */
+static int has_significant_neighbour(const Jpeg2000T1Context *t1,
+                                     int x, int y, int width, int height,
+                                     int ymax)
+{
+    int i, j;
+
+    for (j = FFMAX(y - 1, 0); j <= FFMIN(y + 1, ymax); j++)
+        for (i = FFMAX(x - 1, 0); i <= FFMIN(x + 1, width - 1); i++)
+            if (t1->data[j * t1->stride + i])
+                return 1;
+    return 0;
+}
+
+/* The SigProp pass, bit-plane p - 1 of the insignificant samples next to
+ * significant ones. It scans stripes of 4 rows by groups of 4 columns,
+ * each column top-down, and codes the signs of the new significant samples
+ * of a group after its significance bits. */
+static void decode_sigprop(Jpeg2000T1Context *t1, StreamFwd *sp,
+                           int width, int height, int p, int causal)
+{
+    int x0, y0, x, y;
+
+    for (y0 = 0; y0 < height; y0 += 4) {
+        int y1   = FFMIN(y0 + 4, height);
+        int ymax = causal ? y1 - 1 : height - 1;
+
+        for (x0 = 0; x0 < width; x0 += 4) {
+            int x1 = FFMIN(x0 + 4, width);
+            int *newsig[16], nb_newsig = 0, i;
+
+            for (x = x0; x < x1; x++) {
+                for (y = y0; y < y1; y++) {
+                    int *dp = &t1->data[y * t1->stride + x];
+
+                    if (*dp || !has_significant_neighbour(t1, x, y, width, height, ymax))
+                        continue;
+                    if (fwd_get(sp, 1)) {
+                        *dp = 3 << (p - 1);
+                        newsig[nb_newsig++] = dp;
+                    }
+                }
+            }
+            for (i = 0; i < nb_newsig; i++)
+                if (fwd_get(sp, 1))
+                    *newsig[i] = -*newsig[i];
+        }
+    }
+}
+
+/* The MagRef pass, bit-plane p - 1 of the samples significant after the
+ * cleanup pass, in the order of the SigProp pass. */
+static void decode_magref(Jpeg2000T1Context *t1, StreamRev *mr,
+                          int width, int height, int p)
+{
+    int x, y, y0;
+
+    for (y0 = 0; y0 < height; y0 += 4) {
+        for (x = 0; x < width; x++) {
+            for (y = y0; y < FFMIN(y0 + 4, height); y++) {
+                int *dp = &t1->data[y * t1->stride + x];
+                int r;
+
+                if (!*dp)
+                    continue;
+                if (mr->bits < 1)
+                    rev_refill(mr);
+                r = mr->tmp & 1 ? 1 << (p - 1) : -(1 << (p - 1));
+                rev_skip(mr, 1);
+                *dp += *dp < 0 ? -r : r;
+            }
+        }
+    }
+}
+
+int ff_jpeg2000_decode_htj2k(void *logctx, const Jpeg2000CodingStyle *codsty,
+                             Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk,
+                             int width, int height, int roi_shift)
+{
+    int p = cblk->nonzerobits - 1 - cblk->ht_plhd / 3 + roi_shift;
+    int nb_refpasses = cblk->ninclpasses - cblk->ht_plhd - 1;
+    int lcup, lref, ret;
+
+    if (nb_refpasses < 0)
+        return 0;
+    if (cblk->nb_terminations < 1) {
+        av_log(logctx, AV_LOG_ERROR, "Missing HT cleanup segment\n");
+        return AVERROR_INVALIDDATA;
+    }
+    /* the segments are followed by 2 bytes of padding */
+    lcup = cblk->data_start[1] - 2;
+    lref = cblk->length - cblk->data_start[1];
+    if (p < 0 || p > 29 || nb_refpasses && !p) {
+        av_log(logctx, AV_LOG_ERROR, "Invalid HT cleanup bit-plane %d\n", p);
+        return AVERROR_INVALIDDATA;
+    }
+
+    ret = decode_cleanup(logctx, t1, cblk->data, lcup, width, height, p);
+    if (ret < 0)
+        return ret;
+
+    /* the MagRef pass only refines the samples made significant by the
+     * cleanup pass, so it can run ahead of the SigProp pass */
+    if (nb_refpasses > 1) {
+        StreamRev mr = {
+            .buf     = cblk->data + cblk->data_start[1],
+            .pos     = lref - 1,
+            .unstuff = 1,
+        };
+        decode_magref(t1, &mr, width, height, p);
+    }
+    if (nb_refpasses > 0) {
+        StreamFwd sp;
+        fwd_init(&sp, cblk->data + cblk->data_start[1], lref, 0);
+        decode_sigprop(t1, &sp, width, height, p,
+                       codsty->cblk_style & JPEG2000_CBLK_VSC);
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) block decoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_JPEG2000HTDEC_H
+#define AVCODEC_JPEG2000HTDEC_H
+
+#include <stdint.h>
+#include "jpeg2000.h"
+
+/**
+ * Decode the HT set of a code block: its cleanup pass and the SigProp and
+ * MagRef passes which follow it, into t1->data in the layout of the
+ * decoder of the Part 1 passes.
+ *
+ * @param roi_shift shift of the region of interest of the component
+ * @return 0 on success, a negative AVERROR code on invalid data
+ */
+int ff_jpeg2000_decode_htj2k(void *logctx, const Jpeg2000CodingStyle *codsty,
+                             Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk,
+                             int width, int height, int roi_shift);
+
+#endif /* AVCODEC_JPEG2000HTDEC_H */
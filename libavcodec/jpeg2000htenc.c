@@ -0,0 +1,368 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) block encoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * HT block encoder
+ *
+ * Only the cleanup pass is produced: it codes a code block in a single
+ * pass, down to the bit-plane chosen by the caller. The MagSgn stream is
+ * written at the start of the segment, followed by the MEL stream and the
+ * VLC stream, which is written backwards from the end of the segment.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "jpeg2000htdata.h"
+#include "jpeg2000htenc.h"
+
+/* Exponents of the runs of the MEL coder, by state */
+static const uint8_t mel_exp[13] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 5 };
+
+typedef struct HTVlcCode {
+    uint8_t cwd, len;
+    uint8_t embk;   // samples whose MSB the codeword implies
+} HTVlcCode;
+
+/* Shortest CxtVLC codeword by row type, context, significance of the
+ * samples, u_off and the samples whose exponent reaches U */
+static HTVlcCode vlc_enc[2][8][16][2][16];
+
+/* Bit stream written forwards, lsb first. A byte after 0xFF has its msb
+ * stuffed. */
+typedef struct MagSgnEncoder {
+    uint8_t *buf;
+    int pos;
+    unsigned tmp;
+    int bits, max_bits;
+} MagSgnEncoder;
+
+typedef struct MelEncoder {
+    uint8_t buf[2048];
+    int pos;
+    int tmp, remaining;
+    int k, run;
+} MelEncoder;
+
+/* Bit stream written backwards, lsb first, from buf[0] on. A byte after
+ * one above 0x8F has its msb stuffed when its other bits are all set. */
+typedef struct VlcEncoder {
+    uint8_t buf[2560];
+    int pos;
+    unsigned tmp;
+    int bits;
+    int last_8f;
+} VlcEncoder;
+
+void ff_jpeg2000_init_ht_enc_tables(void)
+{
+    int t, i, eps;
+
+    for (t = 0; t < 2; t++) {
+        for (i = 0; i < 1024; i++) {
+            int e = ff_jpeg2000_ht_vlc[t][i], len = HT_VLC_LEN(e), rho = HT_VLC_RHO(e);
+
+            if (!len)
+                continue;
+            for (eps = 0; eps < 16; eps++) {
+                HTVlcCode *code = &vlc_enc[t][i >> 7][rho][HT_VLC_UOFF(e)][eps];
+
+                if ((eps & ~rho) || (HT_VLC_EMBK(e) & eps) != HT_VLC_EMB1(e))
+                    continue;
+                if (code->len && code->len <= len)
+                    continue;
+                *code = (HTVlcCode){ i & ((1 << len) - 1), len, HT_VLC_EMBK(e) };
+            }
+        }
+    }
+}
+
+static void ms_put(MagSgnEncoder *ms, uint32_t v, int n)
+{
+    while (n > 0) {
+        int k = FFMIN(n, ms->max_bits - ms->bits);
+
+        ms->tmp  |= (v & ((1 << k) - 1)) << ms->bits;
+        ms->bits += k;
+        v       >>= k;
+        n        -= k;
+        if (ms->bits == ms->max_bits) {
+            ms->buf[ms->pos++] = ms->tmp;
+            ms->max_bits = ms->tmp == 0xFF ? 7 : 8;
+            ms->tmp  = 0;
+            ms->bits = 0;
+        }
+    }
+}
+
+/* Pad the last byte with 1s, which the decoder reads past the end too */
+static void ms_terminate(MagSgnEncoder *ms)
+{
+    if (ms->bits) {
+        ms->tmp |= (0xFF << ms->bits) & ((1 << ms->max_bits) - 1);
+        if (ms->tmp != 0xFF)
+            ms->buf[ms->pos++] = ms->tmp;
+    } else if (ms->max_bits == 7) {
+        ms->pos--;
+    }
+}
+
+static void mel_emit_bit(MelEncoder *mel, int bit)
+{
+    mel->tmp = mel->tmp << 1 | bit;
+    if (!--mel->remaining) {
+        mel->buf[mel->pos++] = mel->tmp;
+        mel->remaining = mel->tmp == 0xFF ? 7 : 8;
+        mel->tmp       = 0;
+    }
+}
+
+static void mel_encode(MelEncoder *mel, int bit)
+{
+    if (!bit) {
+        if (++mel->run >= 1 << mel_exp[mel->k]) {
+            mel_emit_bit(mel, 1);
+            mel->run = 0;
+            mel->k   = FFMIN(mel->k + 1, 12);
+        }
+    } else {
+        int e = mel_exp[mel->k];
+
+        mel_emit_bit(mel, 0);
+        while (e--)
+            mel_emit_bit(mel, mel->run >> e & 1);
+        mel->run = 0;
+        mel->k   = FFMAX(mel->k - 1, 0);
+    }
+}
+
+static void vlc_put(VlcEncoder *vlc, int cwd, int len)
+{
+    while (len > 0) {
+        int avail = 8 - vlc->last_8f - vlc->bits;
+        int n     = FFMIN(avail, len);
+
+        vlc->tmp  |= (cwd & ((1 << n) - 1)) << vlc->bits;
+        vlc->bits += n;
+        avail     -= n;
+        len       -= n;
+        cwd      >>= n;
+        if (!avail) {
+            /* the msb is only stuffed when the other bits are all set */
+            if (vlc->last_8f && vlc->tmp != 0x7F) {
+                vlc->last_8f = 0;
+                continue;
+            }
+            vlc->buf[vlc->pos++] = vlc->tmp;
+            vlc->last_8f = vlc->tmp > 0x8F;
+            vlc->tmp  = 0;
+            vlc->bits = 0;
+        }
+    }
+}
+
+/* Flush the MEL and VLC streams, into a single byte between them when
+ * their last bits fit together */
+static void mel_vlc_terminate(MelEncoder *mel, VlcEncoder *vlc)
+{
+    int mel_mask, vlc_mask, fuse;
+
+    if (mel->run)
+        mel_emit_bit(mel, 1);
+    mel->tmp <<= mel->remaining;
+    mel_mask  = (0xFF << mel->remaining) & 0xFF;
+    vlc_mask  = 0xFF >> (8 - vlc->bits);
+    if (!(mel_mask | vlc_mask))
+        return;
+
+    fuse = mel->tmp | vlc->tmp;
+    if (!((fuse ^ mel->tmp) & mel_mask) && !((fuse ^ vlc->tmp) & vlc_mask) &&
+        fuse != 0xFF && vlc->pos > 1) {
+        mel->buf[mel->pos++] = fuse;
+    } else {
+        mel->buf[mel->pos++] = mel->tmp;
+        vlc->buf[vlc->pos++] = vlc->tmp;
+    }
+}
+
+static void uvlc_prefix(VlcEncoder *vlc, int u)
+{
+    if (u == 1)
+        vlc_put(vlc, 1, 1);
+    else if (u == 2)
+        vlc_put(vlc, 2, 2);
+    else if (u <= 4)
+        vlc_put(vlc, 4, 3);
+    else
+        vlc_put(vlc, 0, 3);
+}
+
+static void uvlc_suffix(VlcEncoder *vlc, int u)
+{
+    if (u > 4)
+        vlc_put(vlc, u - 5, 5);
+    else if (u > 2)
+        vlc_put(vlc, u - 3, 1);
+}
+
+/* Code the unsigned residuals of the quads of a pair. In the initial row,
+ * a MEL event tells when both exceed 2. */
+static void encode_uvlc(VlcEncoder *vlc, MelEncoder *mel, const int u[2],
+                        int initial)
+{
+    if (u[0] && u[1]) {
+        if (initial) {
+            int both = u[0] > 2 && u[1] > 2;
+
+            mel_encode(mel, both);
+            if (both) {
+                uvlc_prefix(vlc, u[0] - 2);
+                uvlc_prefix(vlc, u[1] - 2);
+                uvlc_suffix(vlc, u[0] - 2);
+                uvlc_suffix(vlc, u[1] - 2);
+                return;
+            }
+            if (u[0] > 2) {
+                /* u[1] is 1 or 2 */
+                uvlc_prefix(vlc, u[0]);
+                vlc_put(vlc, u[1] - 1, 1);
+                uvlc_suffix(vlc, u[0]);
+                return;
+            }
+        }
+        uvlc_prefix(vlc, u[0]);
+        uvlc_prefix(vlc, u[1]);
+        uvlc_suffix(vlc, u[0]);
+        uvlc_suffix(vlc, u[1]);
+    } else if (u[0] || u[1]) {
+        uvlc_prefix(vlc, u[0] | u[1]);
+        uvlc_suffix(vlc, u[0] | u[1]);
+    }
+}
+
+int ff_jpeg2000_encode_ht_cleanup(uint8_t *buf, int size, const int *data,
+                                  int stride, int width, int height, int p)
+{
+    int qw = (width + 1) >> 1;
+    /* exponents E of the last row of the previous and current row pairs,
+     * from column -1 */
+    uint8_t e_buf[2][1024 + 4] = { { 0 } };
+    uint8_t *e_prev = e_buf[0] + 1, *e_cur = e_buf[1] + 1;
+    MagSgnEncoder ms = { .buf = buf, .max_bits = 8 };
+    MelEncoder  mel  = { .remaining = 8 };
+    VlcEncoder  vlc  = { .buf = { 0xFF }, .pos = 1, .tmp = 0xF, .bits = 4, .last_8f = 1 };
+    int emax = 0, scup, lcup, x, y, q, i, n;
+
+    /* bound the MagSgn bits by the largest exponent */
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            emax = FFMAX(emax, FFABS(data[y * stride + x]) >> p);
+    emax = emax ? av_log2(2 * emax - 1) + 1 : 0;
+    if (size < (width * height * emax + 6) / 7 + 2)
+        return AVERROR(ENOSPC);
+
+    for (y = 0; y < height; y += 2) {
+        HTVlcCode (*tbl)[16][2][16] = vlc_enc[!!y];
+        int c = 0;
+
+        memset(e_cur - 1, 0, width + 4);
+        for (q = 0; q < qw; q += 2) {
+            int rho[2] = { 0 }, u[2] = { 0 }, U[2], embk[2] = { 0 };
+            uint32_t v[2][4];
+
+            for (i = 0; i < 2 && q + i < qw; i++) {
+                int x0 = 2 * (q + i), e[4] = { 0 }, eq = 0, kappa = 1, eps = 0;
+
+                for (n = 0; n < 4; n++) {
+                    int s = 0, mu;
+
+                    x = x0 + (n >> 1);
+                    if (x < width && y + (n & 1) < height)
+                        s = data[(y + (n & 1)) * stride + x];
+                    mu = FFABS(s) >> p;
+                    if (!mu)
+                        continue;
+                    rho[i]   |= 1 << n;
+                    v[i][n]   = 2 * (mu - 1) + (s < 0);
+                    e[n]      = av_log2(2 * mu - 1) + 1;
+                    eq        = FFMAX(eq, e[n]);
+                    if (n & 1)
+                        e_cur[x] = e[n];
+                }
+
+                if (y) {
+                    c |= (!!e_prev[x0 - 1] | !!e_prev[x0]) |
+                         (!!e_prev[x0 + 1] | !!e_prev[x0 + 2]) << 2;
+                    if (rho[i] & (rho[i] - 1)) {
+                        int emax_n = FFMAX(FFMAX(e_prev[x0 - 1], e_prev[x0]),
+                                           FFMAX(e_prev[x0 + 1], e_prev[x0 + 2]));
+                        kappa = FFMAX(emax_n - 1, 1);
+                    }
+                }
+                U[i] = FFMAX(eq, kappa);
+                if (rho[i])
+                    u[i] = U[i] - kappa;
+                if (u[i])
+                    for (n = 0; n < 4; n++)
+                        eps |= (e[n] == U[i]) << n;
+
+                if (!c)
+                    mel_encode(&mel, !!rho[i]);
+                if (c || rho[i]) {
+                    const HTVlcCode *code = &tbl[c][rho[i]][!!u[i]][eps];
+                    vlc_put(&vlc, code->cwd, code->len);
+                    embk[i] = code->embk;
+                }
+
+                /* context of the next quad */
+                n = rho[i];
+                if (!y)
+                    c = (n & 1 | n >> 1 & 1) | (n >> 2 & 1) << 1 | (n >> 3) << 2;
+                else
+                    c = (n >> 2 & 1 | n >> 3) << 1;
+            }
+
+            encode_uvlc(&vlc, &mel, u, !y);
+
+            for (i = 0; i < 2; i++)
+                for (n = 0; n < 4; n++)
+                    if (rho[i] >> n & 1)
+                        ms_put(&ms, v[i][n], U[i] - (embk[i] >> n & 1));
+        }
+        FFSWAP(uint8_t *, e_prev, e_cur);
+    }
+
+    ms_terminate(&ms);
+    mel_vlc_terminate(&mel, &vlc);
+
+    scup = mel.pos + vlc.pos;
+    lcup = ms.pos + scup;
+    if (scup > 4079 || lcup > size)
+        return AVERROR(ENOSPC);
+    memcpy(buf + ms.pos, mel.buf, mel.pos);
+    for (i = 0; i < vlc.pos; i++)
+        buf[lcup - 1 - i] = vlc.buf[i];
+    buf[lcup - 1] = scup >> 4;
+    buf[lcup - 2] = (buf[lcup - 2] & 0xF0) | (scup & 0xF);
+
+    return lcup;
+}
@@ -0,0 +1,44 @@
+/*
+ * High Throughput JPEG 2000 (ITU-T T.814) block encoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_JPEG2000HTENC_H
+#define AVCODEC_JPEG2000HTENC_H
+
+#include <stdint.h>
+
+/**
+ * Build the CxtVLC encoding tables. Must be called once before
+ * ff_jpeg2000_encode_ht_cleanup().
+ */
+void ff_jpeg2000_init_ht_enc_tables(void);
+
+/**
+ * Code the magnitudes of the samples of a code block above bit-plane p
+ * with the HT cleanup pass.
+ *
+ * @param data   signed samples of the code block, of at most 4096 samples
+ * @param p      bit-plane of the values of data the pass stops at
+ * @return the length of the segment written to buf, or a negative AVERROR
+ *         code if it does not fit in size bytes
+ */
+int ff_jpeg2000_encode_ht_cleanup(uint8_t *buf, int size, const int *data,
+                                  int stride, int width, int height, int p);
+
+#endif /* AVCODEC_JPEG2000HTENC_H */
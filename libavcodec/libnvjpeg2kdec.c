@@ -0,0 +1,549 @@
+/*
+ * JPEG 2000 decoding support via Nvidia nvJPEG2000
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * JPEG 2000 decoder using the Nvidia nvJPEG2000 library
+ *
+ * The pictures are decoded straight into frames of a CUDA frames context.
+ * Up to async_depth pictures are submitted to the GPU before the oldest one
+ * is returned, so that parsing the next codestreams on the CPU overlaps with
+ * the decoding of the previous ones.
+ */
+
+#include <nvjpeg2k.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/cuda_check.h"
+#include "libavutil/hwcontext.h"
+#include "libavutil/hwcontext_cuda_internal.h"
+#include "libavutil/internal.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avcodec.h"
+#include "decode.h"
+#include "hwconfig.h"
+#include "internal.h"
+
+typedef struct NvJpeg2kPicture {
+    nvjpeg2kDecodeState_t state;
+    nvjpeg2kStream_t      stream;
+    /* the codestream is referenced by the parsed stream until decoded */
+    AVPacket             *pkt;
+    AVFrame              *frame;
+} NvJpeg2kPicture;
+
+typedef struct NvJpeg2kContext {
+    AVClass *class;
+
+    char *gpu;
+    int async_depth;
+
+    AVBufferRef *hwdevice;
+    AVBufferRef *hwframe;
+    int user_hwframe;
+    CudaFunctions *cudl;
+    CUcontext cuda_ctx;
+    CUstream cuda_stream;
+
+    nvjpeg2kHandle_t handle;
+    NvJpeg2kPicture *pics;
+    int first;
+    int nb_pending;
+    int eof;
+
+    /* pixel format signalled by the container, if any */
+    enum AVPixelFormat hint_pix_fmt;
+} NvJpeg2kContext;
+
+#define CHECK_CU(x) FF_CUDA_CHECK_DL(avctx, s->cudl, x)
+
+static int nvjpeg2k_check(AVCodecContext *avctx, nvjpeg2kStatus_t status,
+                          const char *func)
+{
+    if (status == NVJPEG2K_STATUS_SUCCESS)
+        return 0;
+
+    av_log(avctx, AV_LOG_ERROR, "%s failed: %d\n", func, status);
+
+    switch (status) {
+    case NVJPEG2K_STATUS_ALLOCATOR_FAILURE:
+        return AVERROR(ENOMEM);
+    case NVJPEG2K_STATUS_BAD_JPEG:
+        return AVERROR_INVALIDDATA;
+    case NVJPEG2K_STATUS_JPEG_NOT_SUPPORTED:
+    case NVJPEG2K_STATUS_IMPLEMENTATION_NOT_SUPPORTED:
+        return AVERROR_PATCHWELCOME;
+    default:
+        return AVERROR_EXTERNAL;
+    }
+}
+
+#define CHECK_NVJ2K(x) nvjpeg2k_check(avctx, x, #x)
+
+/* Software formats the codestreams are decoded to, the components are
+ * stored in the planes of the descriptor components in codestream order. */
+static const enum AVPixelFormat output_pix_fmts[] = {
+    AV_PIX_FMT_GRAY8,     AV_PIX_FMT_GRAY10,    AV_PIX_FMT_GRAY12,    AV_PIX_FMT_GRAY16,
+    AV_PIX_FMT_YUV420P,   AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV420P12,
+    AV_PIX_FMT_YUV422P,   AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P12,
+    AV_PIX_FMT_GBRP,      AV_PIX_FMT_GBRP10,    AV_PIX_FMT_GBRP12,    AV_PIX_FMT_GBRP16,
+    AV_PIX_FMT_YUV444P,   AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV444P12, AV_PIX_FMT_YUV444P16,
+};
+
+static enum AVPixelFormat get_sw_format(AVCodecContext *avctx,
+                                        const nvjpeg2kImageInfo_t *info,
+                                        const nvjpeg2kImageComponentInfo_t *comp)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    const AVPixFmtDescriptor *hint = av_pix_fmt_desc_get(s->hint_pix_fmt);
+    int prefer_yuv = hint && hint->nb_components >= 3 &&
+                     !(hint->flags & AV_PIX_FMT_FLAG_RGB);
+    enum AVPixelFormat ret = AV_PIX_FMT_NONE;
+    int i, c;
+
+    for (c = 0; c < info->num_components; c++) {
+        if (comp[c].sgn || comp[c].precision != comp[0].precision) {
+            av_log(avctx, AV_LOG_ERROR, "Signed components or components of "
+                   "different precision are not supported\n");
+            return AV_PIX_FMT_NONE;
+        }
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(output_pix_fmts); i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(output_pix_fmts[i]);
+
+        if (desc->nb_components != info->num_components ||
+            desc->comp[0].depth  != comp[0].precision    ||
+            comp[0].component_width  != info->image_width ||
+            comp[0].component_height != info->image_height)
+            continue;
+        for (c = 1; c < desc->nb_components; c++)
+            if (comp[c].component_width  != AV_CEIL_RSHIFT(info->image_width,  desc->log2_chroma_w) ||
+                comp[c].component_height != AV_CEIL_RSHIFT(info->image_height, desc->log2_chroma_h))
+                break;
+        if (c < desc->nb_components)
+            continue;
+
+        ret = output_pix_fmts[i];
+        if (!(desc->flags & AV_PIX_FMT_FLAG_RGB) || !prefer_yuv)
+            break;
+    }
+
+    if (ret == AV_PIX_FMT_NONE)
+        avpriv_report_missing_feature(avctx, "%d components of %d bits",
+                                      info->num_components, comp[0].precision);
+    return ret;
+}
+
+static int init_hwframe(AVCodecContext *avctx, enum AVPixelFormat sw_format,
+                        int width, int height)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    AVHWFramesContext *hwframe_ctx = (AVHWFramesContext*)s->hwframe->data;
+    enum AVPixelFormat pix_fmts[3] = { AV_PIX_FMT_CUDA, sw_format, AV_PIX_FMT_NONE };
+    int ret;
+
+    if (hwframe_ctx->pool &&
+        (hwframe_ctx->sw_format != sw_format ||
+         hwframe_ctx->width != width || hwframe_ctx->height != height)) {
+        if (s->user_hwframe) {
+            av_log(avctx, AV_LOG_ERROR, "The picture does not match the "
+                   "user supplied frames context\n");
+            return AVERROR(EINVAL);
+        }
+
+        /* frames still in flight keep a reference to the old context */
+        av_buffer_unref(&s->hwframe);
+        s->hwframe = av_hwframe_ctx_alloc(s->hwdevice);
+        if (!s->hwframe)
+            return AVERROR(ENOMEM);
+        hwframe_ctx = (AVHWFramesContext*)s->hwframe->data;
+    } else if (hwframe_ctx->pool && avctx->sw_pix_fmt == sw_format) {
+        return 0;
+    }
+
+    ret = ff_set_dimensions(avctx, width, height);
+    if (ret < 0)
+        return ret;
+
+    avctx->sw_pix_fmt = sw_format;
+    ret = ff_get_format(avctx, pix_fmts);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "ff_get_format failed: %d\n", ret);
+        return ret;
+    }
+    avctx->pix_fmt = ret;
+
+    if (!hwframe_ctx->pool) {
+        hwframe_ctx->format    = AV_PIX_FMT_CUDA;
+        hwframe_ctx->sw_format = sw_format;
+        hwframe_ctx->width     = width;
+        hwframe_ctx->height    = height;
+
+        ret = av_hwframe_ctx_init(s->hwframe);
+        if (ret < 0) {
+            av_log(avctx, AV_LOG_ERROR, "av_hwframe_ctx_init failed\n");
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static int submit_picture(AVCodecContext *avctx, NvJpeg2kPicture *pic)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    nvjpeg2kImageComponentInfo_t comp[4];
+    nvjpeg2kImageInfo_t info;
+    nvjpeg2kImage_t output;
+    const AVPixFmtDescriptor *desc;
+    enum AVPixelFormat sw_format;
+    void *pixel_data[4];
+    size_t pitch[4];
+    CUcontext dummy;
+    int ret, eret, c;
+
+    ret = CHECK_CU(s->cudl->cuCtxPushCurrent(s->cuda_ctx));
+    if (ret < 0)
+        return ret;
+
+    ret = CHECK_NVJ2K(nvjpeg2kStreamParse(s->handle, pic->pkt->data, pic->pkt->size,
+                                          0, 0, pic->stream));
+    if (ret < 0)
+        goto end;
+
+    ret = CHECK_NVJ2K(nvjpeg2kStreamGetImageInfo(pic->stream, &info));
+    if (ret < 0)
+        goto end;
+    if (!info.num_components || info.num_components > FF_ARRAY_ELEMS(comp)) {
+        avpriv_report_missing_feature(avctx, "%d components", info.num_components);
+        ret = AVERROR_PATCHWELCOME;
+        goto end;
+    }
+    for (c = 0; c < info.num_components; c++) {
+        ret = CHECK_NVJ2K(nvjpeg2kStreamGetImageComponentInfo(pic->stream, &comp[c], c));
+        if (ret < 0)
+            goto end;
+    }
+
+    sw_format = get_sw_format(avctx, &info, comp);
+    if (sw_format == AV_PIX_FMT_NONE) {
+        ret = AVERROR_PATCHWELCOME;
+        goto end;
+    }
+
+    ret = init_hwframe(avctx, sw_format, info.image_width, info.image_height);
+    if (ret < 0)
+        goto end;
+
+    ret = av_hwframe_get_buffer(s->hwframe, pic->frame, 0);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "av_hwframe_get_buffer failed\n");
+        goto end;
+    }
+
+    desc = av_pix_fmt_desc_get(sw_format);
+    for (c = 0; c < info.num_components; c++) {
+        int plane = desc->comp[c].plane;
+
+        pixel_data[c] = pic->frame->data[plane];
+        pitch[c]      = pic->frame->linesize[plane];
+    }
+    output.pixel_data     = pixel_data;
+    output.pitch_in_bytes = pitch;
+    output.pixel_type     = comp[0].precision > 8 ? NVJPEG2K_UINT16 : NVJPEG2K_UINT8;
+    output.num_components = info.num_components;
+
+    ret = CHECK_NVJ2K(nvjpeg2kDecode(s->handle, pic->state, pic->stream, &output,
+                                     (cudaStream_t)s->cuda_stream));
+    if (ret < 0)
+        goto end;
+
+    ret = ff_decode_frame_props(avctx, pic->frame);
+    if (ret < 0)
+        goto end;
+
+    pic->frame->pts          = pic->pkt->pts;
+    pic->frame->pkt_dts      = pic->pkt->dts;
+    pic->frame->pkt_pos      = pic->pkt->pos;
+    pic->frame->pkt_duration = pic->pkt->duration;
+    pic->frame->pkt_size     = pic->pkt->size;
+    pic->frame->key_frame    = 1;
+    pic->frame->pict_type    = AV_PICTURE_TYPE_I;
+
+end:
+    eret = CHECK_CU(s->cudl->cuCtxPopCurrent(&dummy));
+    if (ret < 0) {
+        av_frame_unref(pic->frame);
+        return ret;
+    }
+    return eret;
+}
+
+static int output_picture(AVCodecContext *avctx, NvJpeg2kPicture *pic,
+                          AVFrame *frame)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    CUcontext dummy;
+    int ret, eret;
+
+    ret = CHECK_CU(s->cudl->cuCtxPushCurrent(s->cuda_ctx));
+    if (ret < 0)
+        return ret;
+    ret  = CHECK_CU(s->cudl->cuStreamSynchronize(s->cuda_stream));
+    eret = CHECK_CU(s->cudl->cuCtxPopCurrent(&dummy));
+    if (ret < 0 || eret < 0)
+        return ret < 0 ? ret : eret;
+
+    av_packet_unref(pic->pkt);
+
+    if (avctx->pix_fmt == AV_PIX_FMT_CUDA) {
+        av_frame_move_ref(frame, pic->frame);
+        return 0;
+    }
+
+    ret = ff_get_buffer(avctx, frame, 0);
+    if (ret >= 0)
+        ret = av_hwframe_transfer_data(frame, pic->frame, 0);
+    if (ret >= 0)
+        ret = av_frame_copy_props(frame, pic->frame);
+    av_frame_unref(pic->frame);
+    return ret;
+}
+
+static int nvjpeg2k_receive_frame(AVCodecContext *avctx, AVFrame *frame)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    NvJpeg2kPicture *pic;
+    int ret;
+
+    while (!s->eof && s->nb_pending < s->async_depth) {
+        pic = &s->pics[(s->first + s->nb_pending) % s->async_depth];
+
+        ret = ff_decode_get_packet(avctx, pic->pkt);
+        if (ret == AVERROR_EOF) {
+            s->eof = 1;
+            break;
+        }
+        if (ret < 0)
+            return ret;
+
+        ret = submit_picture(avctx, pic);
+        if (ret < 0) {
+            av_packet_unref(pic->pkt);
+            return ret;
+        }
+        s->nb_pending++;
+    }
+
+    if (!s->nb_pending)
+        return AVERROR_EOF;
+
+    pic = &s->pics[s->first];
+    s->first = (s->first + 1) % s->async_depth;
+    s->nb_pending--;
+
+    return output_picture(avctx, pic, frame);
+}
+
+static void nvjpeg2k_flush(AVCodecContext *avctx)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    CUcontext dummy;
+    int i;
+
+    if (s->cudl && !CHECK_CU(s->cudl->cuCtxPushCurrent(s->cuda_ctx))) {
+        CHECK_CU(s->cudl->cuStreamSynchronize(s->cuda_stream));
+        CHECK_CU(s->cudl->cuCtxPopCurrent(&dummy));
+    }
+
+    for (i = 0; s->pics && i < s->async_depth; i++) {
+        av_packet_unref(s->pics[i].pkt);
+        av_frame_unref(s->pics[i].frame);
+    }
+    s->first      = 0;
+    s->nb_pending = 0;
+    s->eof        = 0;
+}
+
+static av_cold int nvjpeg2k_decode_end(AVCodecContext *avctx)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    CUcontext dummy;
+    int i;
+
+    nvjpeg2k_flush(avctx);
+
+    if (s->cudl && !CHECK_CU(s->cudl->cuCtxPushCurrent(s->cuda_ctx))) {
+        for (i = 0; s->pics && i < s->async_depth; i++) {
+            if (s->pics[i].stream)
+                nvjpeg2kStreamDestroy(s->pics[i].stream);
+            if (s->pics[i].state)
+                nvjpeg2kDecodeStateDestroy(s->pics[i].state);
+        }
+        if (s->handle)
+            nvjpeg2kDestroy(s->handle);
+        CHECK_CU(s->cudl->cuCtxPopCurrent(&dummy));
+    }
+
+    for (i = 0; s->pics && i < s->async_depth; i++) {
+        av_packet_free(&s->pics[i].pkt);
+        av_frame_free(&s->pics[i].frame);
+    }
+    av_freep(&s->pics);
+
+    av_buffer_unref(&s->hwframe);
+    av_buffer_unref(&s->hwdevice);
+    s->cudl = NULL;
+
+    return 0;
+}
+
+static av_cold int nvjpeg2k_decode_init(AVCodecContext *avctx)
+{
+    NvJpeg2kContext *s = avctx->priv_data;
+    AVHWFramesContext *hwframe_ctx;
+    AVCUDADeviceContext *device_hwctx;
+    enum AVPixelFormat pix_fmts[3] = { AV_PIX_FMT_CUDA,
+                                       AV_PIX_FMT_YUV420P,
+                                       AV_PIX_FMT_NONE };
+    CUcontext dummy;
+    int ret, i;
+
+    s->hint_pix_fmt = avctx->pix_fmt;
+
+    // As for cuvid, accelerated transcoding with 'ffmpeg' requires the
+    // pix_fmt to be AV_PIX_FMT_CUDA early, the software format is only
+    // known after the first codestream has been parsed.
+    ret = ff_get_format(avctx, pix_fmts);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "ff_get_format failed: %d\n", ret);
+        return ret;
+    }
+    avctx->pix_fmt = ret;
+
+    if (avctx->hw_frames_ctx) {
+        s->hwframe = av_buffer_ref(avctx->hw_frames_ctx);
+        if (!s->hwframe)
+            return AVERROR(ENOMEM);
+        s->user_hwframe = 1;
+
+        hwframe_ctx = (AVHWFramesContext*)s->hwframe->data;
+        s->hwdevice = av_buffer_ref(hwframe_ctx->device_ref);
+        if (!s->hwdevice)
+            return AVERROR(ENOMEM);
+    } else {
+        if (avctx->hw_device_ctx) {
+            s->hwdevice = av_buffer_ref(avctx->hw_device_ctx);
+            if (!s->hwdevice)
+                return AVERROR(ENOMEM);
+        } else {
+            ret = av_hwdevice_ctx_create(&s->hwdevice, AV_HWDEVICE_TYPE_CUDA, s->gpu, NULL, 0);
+            if (ret < 0)
+                return ret;
+        }
+
+        s->hwframe = av_hwframe_ctx_alloc(s->hwdevice);
+        if (!s->hwframe) {
+            av_log(avctx, AV_LOG_ERROR, "av_hwframe_ctx_alloc failed\n");
+            return AVERROR(ENOMEM);
+        }
+        hwframe_ctx = (AVHWFramesContext*)s->hwframe->data;
+    }
+
+    device_hwctx   = hwframe_ctx->device_ctx->hwctx;
+    s->cuda_ctx    = device_hwctx->cuda_ctx;
+    s->cuda_stream = device_hwctx->stream;
+    s->cudl        = device_hwctx->internal->cuda_dl;
+
+    s->pics = av_calloc(s->async_depth, sizeof(*s->pics));
+    if (!s->pics)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->async_depth; i++) {
+        s->pics[i].pkt   = av_packet_alloc();
+        s->pics[i].frame = av_frame_alloc();
+        if (!s->pics[i].pkt || !s->pics[i].frame)
+            return AVERROR(ENOMEM);
+    }
+
+    ret = CHECK_CU(s->cudl->cuCtxPushCurrent(s->cuda_ctx));
+    if (ret < 0)
+        return ret;
+
+    ret = CHECK_NVJ2K(nvjpeg2kCreateSimple(&s->handle));
+    for (i = 0; ret >= 0 && i < s->async_depth; i++) {
+        ret = CHECK_NVJ2K(nvjpeg2kDecodeStateCreate(s->handle, &s->pics[i].state));
+        if (ret >= 0)
+            ret = CHECK_NVJ2K(nvjpeg2kStreamCreate(&s->pics[i].stream));
+    }
+
+    CHECK_CU(s->cudl->cuCtxPopCurrent(&dummy));
+    return ret;
+}
+
+#define OFFSET(x) offsetof(NvJpeg2kContext, x)
+#define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+    { "gpu",         "GPU to be used for decoding",          OFFSET(gpu),         AV_OPT_TYPE_STRING, { .str = NULL }, 0,  0, VD },
+    { "async_depth", "Pictures submitted ahead of the output", OFFSET(async_depth), AV_OPT_TYPE_INT,  { .i64 = 4    }, 1, 32, VD },
+    { NULL }
+};
+
+static const AVClass nvjpeg2k_class = {
+    .class_name = "libnvjpeg2k",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+static const AVCodecHWConfigInternal *const nvjpeg2k_hw_configs[] = {
+    &(const AVCodecHWConfigInternal) {
+        .public = {
+            .pix_fmt     = AV_PIX_FMT_CUDA,
+            .methods     = AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX |
+                           AV_CODEC_HW_CONFIG_METHOD_INTERNAL,
+            .device_type = AV_HWDEVICE_TYPE_CUDA
+        },
+        .hwaccel = NULL,
+    },
+    NULL
+};
+
+const AVCodec ff_libnvjpeg2k_decoder = {
+    .name           = "libnvjpeg2k",
+    .long_name      = NULL_IF_CONFIG_SMALL("Nvidia nvJPEG2000 JPEG 2000 decoder"),
+    .type           = AVMEDIA_TYPE_VIDEO,
+    .id             = AV_CODEC_ID_JPEG2000,
+    .priv_data_size = sizeof(NvJpeg2kContext),
+    .priv_class     = &nvjpeg2k_class,
+    .init           = nvjpeg2k_decode_init,
+    .close          = nvjpeg2k_decode_end,
+    .receive_frame  = nvjpeg2k_receive_frame,
+    .flush          = nvjpeg2k_flush,
+    .capabilities   = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_AVOID_PROBING |
+                      AV_CODEC_CAP_HARDWARE,
+    .caps_internal  = FF_CODEC_CAP_SETS_FRAME_PROPS | FF_CODEC_CAP_INIT_CLEANUP,
+    .pix_fmts       = (const enum AVPixelFormat[]){ AV_PIX_FMT_CUDA,
+                                                    AV_PIX_FMT_NONE },
+    .hw_configs     = nvjpeg2k_hw_configs,
+    .wrapper_name   = "libnvjpeg2k",
+};
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
@@ -39,6 +40,9 @@
 #define JP2_SIG_TYPE    0x6A502020
 #define JP2_SIG_VALUE   0x0D0A870A
 
+#define HAVE_OPJ_THREADS (OPJ_VERSION_MAJOR > 2 || \
+                          OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2)
+
 // pix_fmts with lower bpp have to be listed before
 // similar pix_fmts with higher bpp.
 #define RGB_PIXEL_FORMATS  AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,                 \
@@ -79,6 +83,7 @@ typedef struct LibOpenJPEGContext {
     AVClass *class;
     opj_dparameters_t dec_params;
     int lowqual;
+    int opj_threads;
 } LibOpenJPEGContext;
 
 static void error_callback(const char *msg, void *data)
@@ -314,6 +319,25 @@ static av_cold int libopenjpeg_decode_init(AVCodecContext *avctx)
     LibOpenJPEGContext *ctx = avctx->priv_data;
 
     opj_set_default_decoder_parameters(&ctx->dec_params);
+
+#if HAVE_OPJ_THREADS
+    /* Frame threads already keep the cores busy, each of them decodes its
+     * frame alone unless told otherwise. Without them, the code blocks of
+     * each frame are decoded by thread_count OpenJPEG threads. */
+    if (!ctx->opj_threads) {
+        if (avctx->active_thread_type & FF_THREAD_FRAME)
+            ctx->opj_threads = 1;
+        else
+            ctx->opj_threads = avctx->thread_count ? avctx->thread_count : av_cpu_count();
+    }
+    if (ctx->opj_threads > 1 && !opj_has_thread_support()) {
+        av_log(avctx, AV_LOG_VERBOSE, "OpenJPEG was built without thread support\n");
+        ctx->opj_threads = 1;
+    }
+#else
+    if (ctx->opj_threads > 1)
+        av_log(avctx, AV_LOG_WARNING, "opj_threads needs OpenJPEG 2.2.0 or later\n");
+#endif
     return 0;
 }
 
@@ -371,6 +395,12 @@ static int libopenjpeg_decode_frame(AVCodecContext *avctx,
     // Tie decoder with decoding parameters
     opj_setup_decoder(dec, &ctx->dec_params);
 
+#if HAVE_OPJ_THREADS
+    if (ctx->opj_threads > 1 && !opj_codec_set_threads(dec, ctx->opj_threads))
+        av_log(avctx, AV_LOG_WARNING, "Could not start %d OpenJPEG threads\n",
+               ctx->opj_threads);
+#endif
+
     stream = opj_stream_default_create(OPJ_STREAM_READ);
 
     if (!stream) {
@@ -492,6 +522,8 @@ done:
 static const AVOption options[] = {
     { "lowqual", "Limit the number of layers used for decoding",
         OFFSET(lowqual), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "opj_threads", "Number of OpenJPEG threads decoding each frame (0 for automatic)",
+        OFFSET(opj_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
     { NULL },
 };
 
@@ -513,5 +545,6 @@ const AVCodec ff_libopenjpeg_decoder = {
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
     .max_lowres     = 31,
     .priv_class     = &openjpeg_class,
+    .caps_internal  = FF_CODEC_CAP_AUTO_THREADS,
     .wrapper_name   = "libopenjpeg",
 };
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
@@ -33,6 +34,12 @@
 #include "internal.h"
 #include <openjpeg.h>
 
+/* opj_codec_set_threads() only works on compressors since 2.4.0 */
+#define HAVE_OPJ_ENC_THREADS (OPJ_VERSION_MAJOR > 2 || \
+                              OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 4)
+
+#define OPJ_IMF(profile) ((profile) >= OPJ_PROFILE_IMF_2K && (profile) <= OPJ_PROFILE_IMF_8K_R)
+
 typedef struct LibOpenJPEGContext {
     AVClass *avclass;
     opj_cparameters_t enc_params;
@@ -44,6 +51,9 @@ typedef struct LibOpenJPEGContext {
     int irreversible;
     int disto_alloc;
     int fixed_quality;
+    int mainlevel;
+    int sublevel;
+    int opj_threads;
 } LibOpenJPEGContext;
 
 static void error_callback(const char *msg, void *data)
@@ -168,6 +178,56 @@ static void cinema_parameters(opj_cparameters_t *p)
     p->tcp_mct = 1;
 }
 
+static void imf_parameters(AVCodecContext *avctx, opj_cparameters_t *p, int profile)
+{
+    int max_res, i;
+
+    /* Single tile at (0, 0) */
+    p->tile_size_on = 0;
+    p->cp_tx0 = 0;
+    p->cp_ty0 = 0;
+    p->image_offset_x0 = 0;
+    p->image_offset_y0 = 0;
+
+    /* One tile-part per component */
+    p->tp_flag = 'C';
+    p->tp_on = 1;
+
+    p->cblockw_init = 32;
+    p->cblockh_init = 32;
+    p->prog_order = OPJ_CPRL;
+    p->roi_compno = -1;
+    p->subsampling_dx = 1;
+    p->subsampling_dy = 1;
+
+    /* The reversible profiles are the lossless 5-3 ones */
+    p->irreversible = profile == OPJ_PROFILE_IMF_2K ||
+                      profile == OPJ_PROFILE_IMF_4K ||
+                      profile == OPJ_PROFILE_IMF_8K;
+
+    /* At most 5, 6 and 7 decomposition levels for 2K, 4K and 8K */
+    switch (profile) {
+    case OPJ_PROFILE_IMF_2K:
+    case OPJ_PROFILE_IMF_2K_R: max_res = 6; break;
+    case OPJ_PROFILE_IMF_4K:
+    case OPJ_PROFILE_IMF_4K_R: max_res = 7; break;
+    default:                   max_res = 8; break;
+    }
+    if (p->numresolution > max_res) {
+        av_log(avctx, AV_LOG_WARNING, "Limiting numresolution to %d for IMF\n", max_res);
+        p->numresolution = max_res;
+    }
+
+    /* Precincts of 128x128 in the lowest resolution and 256x256 above,
+     * listed from the highest resolution down */
+    p->csty |= 0x01;
+    p->res_spec = p->numresolution;
+    for (i = 0; i < p->numresolution; i++) {
+        p->prcw_init[i] = i == p->numresolution - 1 ? 128 : 256;
+        p->prch_init[i] = p->prcw_init[i];
+    }
+}
+
 static opj_image_t *mj2_create_image(AVCodecContext *avctx, opj_cparameters_t *parameters)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(avctx->pix_fmt);
@@ -302,6 +362,22 @@ static av_cold int libopenjpeg_encode_init(AVCodecContext *avctx)
     }
 
     switch (ctx->profile) {
+    case OPJ_PROFILE_BC_SINGLE:
+    case OPJ_PROFILE_IMF_2K:
+    case OPJ_PROFILE_IMF_4K:
+    case OPJ_PROFILE_IMF_8K:
+    case OPJ_PROFILE_IMF_2K_R:
+    case OPJ_PROFILE_IMF_4K_R:
+    case OPJ_PROFILE_IMF_8K_R:
+        if (ctx->cinema_mode) {
+            err = AVERROR(EINVAL);
+            break;
+        }
+        /* Broadcast has no sublevel */
+        ctx->enc_params.rsiz = ctx->profile | ctx->mainlevel;
+        if (OPJ_IMF(ctx->profile))
+            ctx->enc_params.rsiz |= ctx->sublevel << 4;
+        break;
     case OPJ_CINEMA2K:
         if (ctx->enc_params.rsiz == OPJ_PROFILE_CINEMA_4K) {
             err = AVERROR(EINVAL);
@@ -341,10 +417,34 @@ static av_cold int libopenjpeg_encode_init(AVCodecContext *avctx)
     if (ctx->cinema_mode > 0) {
         cinema_parameters(&ctx->enc_params);
     }
+    if (OPJ_IMF(ctx->profile))
+        imf_parameters(avctx, &ctx->enc_params, ctx->profile);
+
+#if HAVE_OPJ_ENC_THREADS
+    /* Frame thread workers get thread_count 1, so they encode their frame
+     * alone; otherwise the code blocks are shared by thread_count threads. */
+    if (!ctx->opj_threads)
+        ctx->opj_threads = avctx->thread_count ? avctx->thread_count : av_cpu_count();
+    if (ctx->opj_threads > 1 && !opj_has_thread_support()) {
+        av_log(avctx, AV_LOG_VERBOSE, "OpenJPEG was built without thread support\n");
+        ctx->opj_threads = 1;
+    }
+#else
+    if (ctx->opj_threads > 1)
+        av_log(avctx, AV_LOG_WARNING, "opj_threads needs OpenJPEG 2.4.0 or later\n");
+#endif
 
     return 0;
 }
 
+/* Repeat the last row of a component from row y on. */
+static void pad_bottom(opj_image_comp_t *comp, int y)
+{
+    for (; y < comp->h; ++y)
+        memcpy(comp->data + y * comp->w, comp->data + (y - 1) * comp->w,
+               comp->w * sizeof(*comp->data));
+}
+
 static int libopenjpeg_copy_packed8(AVCodecContext *avctx, const AVFrame *frame, opj_image_t *image)
 {
     int compno;
@@ -373,12 +473,7 @@ static int libopenjpeg_copy_packed8(AVCodecContext *avctx, const AVFrame *frame,
                 image_line[x] = image_line[x - 1];
             }
         }
-        for (; y < image->comps[compno].h; ++y) {
-            image_line = image->comps[compno].data + y * image->comps[compno].w;
-            for (x = 0; x < image->comps[compno].w; ++x) {
-                image_line[x] = image_line[x - (int)image->comps[compno].w];
-            }
-        }
+        pad_bottom(&image->comps[compno], y);
     }
 
     return 1;
@@ -413,12 +508,7 @@ static int libopenjpeg_copy_packed12(AVCodecContext *avctx, const AVFrame *frame
                 image_line[x] = image_line[x - 1];
             }
         }
-        for (; y < image->comps[compno].h; ++y) {
-            image_line = image->comps[compno].data + y * image->comps[compno].w;
-            for (x = 0; x < image->comps[compno].w; ++x) {
-                image_line[x] = image_line[x - (int)image->comps[compno].w];
-            }
-        }
+        pad_bottom(&image->comps[compno], y);
     }
 
     return 1;
@@ -453,12 +543,7 @@ static int libopenjpeg_copy_packed16(AVCodecContext *avctx, const AVFrame *frame
                 image_line[x] = image_line[x - 1];
             }
         }
-        for (; y < image->comps[compno].h; ++y) {
-            image_line = image->comps[compno].data + y * image->comps[compno].w;
-            for (x = 0; x < image->comps[compno].w; ++x) {
-                image_line[x] = image_line[x - (int)image->comps[compno].w];
-            }
-        }
+        pad_bottom(&image->comps[compno], y);
     }
 
     return 1;
@@ -472,7 +557,6 @@ static int libopenjpeg_copy_unpacked8(AVCodecContext *avctx, const AVFrame *fram
     int width;
     int height;
     int *image_line;
-    int frame_index;
     const int numcomps = image->numcomps;
 
     for (compno = 0; compno < numcomps; ++compno) {
@@ -486,20 +570,15 @@ static int libopenjpeg_copy_unpacked8(AVCodecContext *avctx, const AVFrame *fram
         width  = (avctx->width + image->comps[compno].dx - 1) / image->comps[compno].dx;
         height = (avctx->height + image->comps[compno].dy - 1) / image->comps[compno].dy;
         for (y = 0; y < height; ++y) {
+            const uint8_t *src = frame->data[compno] + y * frame->linesize[compno];
             image_line = image->comps[compno].data + y * image->comps[compno].w;
-            frame_index = y * frame->linesize[compno];
             for (x = 0; x < width; ++x)
-                image_line[x] = frame->data[compno][frame_index++];
+                image_line[x] = src[x];
             for (; x < image->comps[compno].w; ++x) {
                 image_line[x] = image_line[x - 1];
             }
         }
-        for (; y < image->comps[compno].h; ++y) {
-            image_line = image->comps[compno].data + y * image->comps[compno].w;
-            for (x = 0; x < image->comps[compno].w; ++x) {
-                image_line[x] = image_line[x - (int)image->comps[compno].w];
-            }
-        }
+        pad_bottom(&image->comps[compno], y);
     }
 
     return 1;
@@ -513,9 +592,7 @@ static int libopenjpeg_copy_unpacked16(AVCodecContext *avctx, const AVFrame *fra
     int width;
     int height;
     int *image_line;
-    int frame_index;
     const int numcomps = image->numcomps;
-    uint16_t *frame_ptr;
 
     for (compno = 0; compno < numcomps; ++compno) {
         if (image->comps[compno].w > frame->linesize[compno]) {
@@ -525,24 +602,18 @@ static int libopenjpeg_copy_unpacked16(AVCodecContext *avctx, const AVFrame *fra
     }
 
     for (compno = 0; compno < numcomps; ++compno) {
-        width     = (avctx->width + image->comps[compno].dx - 1) / image->comps[compno].dx;
-        height    = (avctx->height + image->comps[compno].dy - 1) / image->comps[compno].dy;
-        frame_ptr = (uint16_t *)frame->data[compno];
+        width  = (avctx->width + image->comps[compno].dx - 1) / image->comps[compno].dx;
+        height = (avctx->height + image->comps[compno].dy - 1) / image->comps[compno].dy;
         for (y = 0; y < height; ++y) {
+            const uint16_t *src = (const uint16_t *)(frame->data[compno] + y * frame->linesize[compno]);
             image_line = image->comps[compno].data + y * image->comps[compno].w;
-            frame_index = y * (frame->linesize[compno] / 2);
             for (x = 0; x < width; ++x)
-                image_line[x] = frame_ptr[frame_index++];
+                image_line[x] = src[x];
             for (; x < image->comps[compno].w; ++x) {
                 image_line[x] = image_line[x - 1];
             }
         }
-        for (; y < image->comps[compno].h; ++y) {
-            image_line = image->comps[compno].data + y * image->comps[compno].w;
-            for (x = 0; x < image->comps[compno].w; ++x) {
-                image_line[x] = image_line[x - (int)image->comps[compno].w];
-            }
-        }
+        pad_bottom(&image->comps[compno], y);
     }
 
     return 1;
@@ -684,6 +755,11 @@ static int libopenjpeg_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
         ret = AVERROR_EXTERNAL;
         goto done;
     }
+#if HAVE_OPJ_ENC_THREADS
+    if (ctx->opj_threads > 1 && !opj_codec_set_threads(compress, ctx->opj_threads))
+        av_log(avctx, AV_LOG_WARNING, "Could not start %d OpenJPEG threads\n",
+               ctx->opj_threads);
+#endif
     stream = opj_stream_default_create(OPJ_STREAM_WRITE);
 
     if (!stream) {
@@ -724,10 +800,19 @@ static const AVOption options[] = {
     { "format",        "Codec Format",      OFFSET(format),        AV_OPT_TYPE_INT,   { .i64 = OPJ_CODEC_JP2   }, OPJ_CODEC_J2K, OPJ_CODEC_JP2,   VE, "format"      },
     { "j2k",           NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_CODEC_J2K   }, 0,         0,           VE, "format"      },
     { "jp2",           NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_CODEC_JP2   }, 0,         0,           VE, "format"      },
-    { "profile",       NULL,                OFFSET(profile),       AV_OPT_TYPE_INT,   { .i64 = OPJ_STD_RSIZ    }, OPJ_STD_RSIZ,  OPJ_CINEMA4K,    VE, "profile"     },
+    { "profile",       NULL,                OFFSET(profile),       AV_OPT_TYPE_INT,   { .i64 = OPJ_STD_RSIZ    }, OPJ_STD_RSIZ,  OPJ_PROFILE_IMF_8K_R, VE, "profile" },
     { "jpeg2000",      NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_STD_RSIZ    }, 0,         0,           VE, "profile"     },
     { "cinema2k",      NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_CINEMA2K    }, 0,         0,           VE, "profile"     },
     { "cinema4k",      NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_CINEMA4K    }, 0,         0,           VE, "profile"     },
+    { "broadcast",     NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_BC_SINGLE }, 0,   0,           VE, "profile"     },
+    { "imf2k",         NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_2K   }, 0,    0,           VE, "profile"     },
+    { "imf4k",         NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_4K   }, 0,    0,           VE, "profile"     },
+    { "imf8k",         NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_8K   }, 0,    0,           VE, "profile"     },
+    { "imf2k_r",       NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_2K_R }, 0,    0,           VE, "profile"     },
+    { "imf4k_r",       NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_4K_R }, 0,    0,           VE, "profile"     },
+    { "imf8k_r",       NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_PROFILE_IMF_8K_R }, 0,    0,           VE, "profile"     },
+    { "mainlevel",     "IMF/broadcast mainlevel", OFFSET(mainlevel), AV_OPT_TYPE_INT, { .i64 = 0            }, 0,         11,          VE                },
+    { "sublevel",      "IMF sublevel",      OFFSET(sublevel),      AV_OPT_TYPE_INT,   { .i64 = 0            }, 0,         9,           VE                },
     { "cinema_mode",   "Digital Cinema",    OFFSET(cinema_mode),   AV_OPT_TYPE_INT,   { .i64 = OPJ_OFF         }, OPJ_OFF,       OPJ_CINEMA4K_24, VE, "cinema_mode" },
     { "off",           NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_OFF         }, 0,         0,           VE, "cinema_mode" },
     { "2k_24",         NULL,                0,                     AV_OPT_TYPE_CONST, { .i64 = OPJ_CINEMA2K_24 }, 0,         0,           VE, "cinema_mode" },
@@ -743,6 +828,8 @@ static const AVOption options[] = {
     { "irreversible",  NULL,                OFFSET(irreversible),  AV_OPT_TYPE_INT,   { .i64 = 0            }, 0,         1,           VE                },
     { "disto_alloc",   NULL,                OFFSET(disto_alloc),   AV_OPT_TYPE_INT,   { .i64 = 1            }, 0,         1,           VE                },
     { "fixed_quality", NULL,                OFFSET(fixed_quality), AV_OPT_TYPE_INT,   { .i64 = 0            }, 0,         1,           VE                },
+    { "opj_threads",   "Number of OpenJPEG threads encoding each frame (0 for automatic)",
+        OFFSET(opj_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE },
     { NULL },
 };
 
@@ -762,6 +849,7 @@ const AVCodec ff_libopenjpeg_encoder = {
     .init           = libopenjpeg_encode_init,
     .encode2        = libopenjpeg_encode_frame,
     .capabilities   = AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal  = FF_CODEC_CAP_AUTO_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA, AV_PIX_FMT_RGB48,
         AV_PIX_FMT_RGBA64, AV_PIX_FMT_GBR24P,
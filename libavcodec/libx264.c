@@ -593,14 +593,20 @@ static int convert_pix_fmt(enum AVPixelFormat pix_fmt)
     case AV_PIX_FMT_YUV420P:
     case AV_PIX_FMT_YUVJ420P:
     case AV_PIX_FMT_YUV420P9:
-    case AV_PIX_FMT_YUV420P10: return X264_CSP_I420;
+    case AV_PIX_FMT_YUV420P10:
+    case AV_PIX_FMT_YUVA420P:
+    case AV_PIX_FMT_YUVA420P10: return X264_CSP_I420;
     case AV_PIX_FMT_YUV422P:
     case AV_PIX_FMT_YUVJ422P:
-    case AV_PIX_FMT_YUV422P10: return X264_CSP_I422;
+    case AV_PIX_FMT_YUV422P10:
+    case AV_PIX_FMT_YUVA422P:
+    case AV_PIX_FMT_YUVA422P10: return X264_CSP_I422;
     case AV_PIX_FMT_YUV444P:
     case AV_PIX_FMT_YUVJ444P:
     case AV_PIX_FMT_YUV444P9:
-    case AV_PIX_FMT_YUV444P10: return X264_CSP_I444;
+    case AV_PIX_FMT_YUV444P10:
+    case AV_PIX_FMT_YUVA444P:
+    case AV_PIX_FMT_YUVA444P10: return X264_CSP_I444;
     case AV_PIX_FMT_BGR0:
         return X264_CSP_BGRA;
     case AV_PIX_FMT_BGR24:
@@ -673,6 +679,9 @@ static av_cold int X264_init(AVCodecContext *avctx)
 #if X264_BUILD >= 153
     x4->params.i_bitdepth           = av_pix_fmt_desc_get(avctx->pix_fmt)->comp[0].depth;
 #endif
+    /* Taking YUVA input as is spares a conversion, the alpha plane is not coded */
+    if (av_pix_fmt_desc_get(avctx->pix_fmt)->flags & AV_PIX_FMT_FLAG_ALPHA)
+        av_log(avctx, AV_LOG_VERBOSE, "Ignoring the alpha plane of the input\n");
 
     PARSE_X264_OPT("weightp", wpredp);
 
@@ -1027,6 +1036,9 @@ static const enum AVPixelFormat pix_fmts_8bit[] = {
     AV_PIX_FMT_YUVJ422P,
     AV_PIX_FMT_YUV444P,
     AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUVA420P,
+    AV_PIX_FMT_YUVA422P,
+    AV_PIX_FMT_YUVA444P,
     AV_PIX_FMT_NV12,
     AV_PIX_FMT_NV16,
 #ifdef X264_CSP_NV21
@@ -1043,6 +1055,9 @@ static const enum AVPixelFormat pix_fmts_10bit[] = {
     AV_PIX_FMT_YUV420P10,
     AV_PIX_FMT_YUV422P10,
     AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUVA420P10,
+    AV_PIX_FMT_YUVA422P10,
+    AV_PIX_FMT_YUVA444P10,
     AV_PIX_FMT_NV20,
     AV_PIX_FMT_NONE
 };
@@ -1053,6 +1068,9 @@ static const enum AVPixelFormat pix_fmts_all[] = {
     AV_PIX_FMT_YUVJ422P,
     AV_PIX_FMT_YUV444P,
     AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUVA420P,
+    AV_PIX_FMT_YUVA422P,
+    AV_PIX_FMT_YUVA444P,
     AV_PIX_FMT_NV12,
     AV_PIX_FMT_NV16,
 #ifdef X264_CSP_NV21
@@ -1061,6 +1079,9 @@ static const enum AVPixelFormat pix_fmts_all[] = {
     AV_PIX_FMT_YUV420P10,
     AV_PIX_FMT_YUV422P10,
     AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUVA420P10,
+    AV_PIX_FMT_YUVA422P10,
+    AV_PIX_FMT_YUVA444P10,
     AV_PIX_FMT_NV20,
 #ifdef X264_CSP_I400
     AV_PIX_FMT_GRAY8,
@@ -242,11 +242,16 @@ static av_cold int libx265_encode_init(AVCodecContext *avctx)
     case AV_PIX_FMT_YUV420P:
     case AV_PIX_FMT_YUV420P10:
     case AV_PIX_FMT_YUV420P12:
+    case AV_PIX_FMT_YUVA420P:
+    case AV_PIX_FMT_YUVA420P10:
         ctx->params->internalCsp = X265_CSP_I420;
         break;
     case AV_PIX_FMT_YUV422P:
     case AV_PIX_FMT_YUV422P10:
     case AV_PIX_FMT_YUV422P12:
+    case AV_PIX_FMT_YUVA422P:
+    case AV_PIX_FMT_YUVA422P10:
+    case AV_PIX_FMT_YUVA422P12:
         ctx->params->internalCsp = X265_CSP_I422;
         break;
     case AV_PIX_FMT_GBRP:
@@ -258,6 +263,9 @@ static av_cold int libx265_encode_init(AVCodecContext *avctx)
     case AV_PIX_FMT_YUV444P:
     case AV_PIX_FMT_YUV444P10:
     case AV_PIX_FMT_YUV444P12:
+    case AV_PIX_FMT_YUVA444P:
+    case AV_PIX_FMT_YUVA444P10:
+    case AV_PIX_FMT_YUVA444P12:
         ctx->params->internalCsp = X265_CSP_I444;
         break;
     case AV_PIX_FMT_GRAY8:
@@ -272,6 +280,9 @@ static av_cold int libx265_encode_init(AVCodecContext *avctx)
         ctx->params->internalCsp = X265_CSP_I400;
         break;
     }
+    /* Taking YUVA input as is spares a conversion, the alpha plane is not coded */
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA)
+        av_log(avctx, AV_LOG_VERBOSE, "Ignoring the alpha plane of the input\n");
 
     if (ctx->crf >= 0) {
         char crf[6];
@@ -645,6 +656,9 @@ static const enum AVPixelFormat x265_csp_eight[] = {
     AV_PIX_FMT_YUVJ422P,
     AV_PIX_FMT_YUV444P,
     AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUVA420P,
+    AV_PIX_FMT_YUVA422P,
+    AV_PIX_FMT_YUVA444P,
     AV_PIX_FMT_GBRP,
     AV_PIX_FMT_GRAY8,
     AV_PIX_FMT_NONE
@@ -657,10 +671,16 @@ static const enum AVPixelFormat x265_csp_ten[] = {
     AV_PIX_FMT_YUVJ422P,
     AV_PIX_FMT_YUV444P,
     AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUVA420P,
+    AV_PIX_FMT_YUVA422P,
+    AV_PIX_FMT_YUVA444P,
     AV_PIX_FMT_GBRP,
     AV_PIX_FMT_YUV420P10,
     AV_PIX_FMT_YUV422P10,
     AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUVA420P10,
+    AV_PIX_FMT_YUVA422P10,
+    AV_PIX_FMT_YUVA444P10,
     AV_PIX_FMT_GBRP10,
     AV_PIX_FMT_GRAY8,
     AV_PIX_FMT_GRAY10,
@@ -674,14 +694,22 @@ static const enum AVPixelFormat x265_csp_twelve[] = {
     AV_PIX_FMT_YUVJ422P,
     AV_PIX_FMT_YUV444P,
     AV_PIX_FMT_YUVJ444P,
+    AV_PIX_FMT_YUVA420P,
+    AV_PIX_FMT_YUVA422P,
+    AV_PIX_FMT_YUVA444P,
     AV_PIX_FMT_GBRP,
     AV_PIX_FMT_YUV420P10,
     AV_PIX_FMT_YUV422P10,
     AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUVA420P10,
+    AV_PIX_FMT_YUVA422P10,
+    AV_PIX_FMT_YUVA444P10,
     AV_PIX_FMT_GBRP10,
     AV_PIX_FMT_YUV420P12,
     AV_PIX_FMT_YUV422P12,
     AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_YUVA422P12,
+    AV_PIX_FMT_YUVA444P12,
     AV_PIX_FMT_GBRP12,
     AV_PIX_FMT_GRAY8,
     AV_PIX_FMT_GRAY10,
@@ -51,9 +51,18 @@ typedef struct MqcState {
 /** initialize the encoder */
 void ff_mqc_initenc(MqcState *mqc, uint8_t *bp);
 
+/**
+ * Start a new codeword segment at bp, keeping the context states.
+ * @param raw code the segment in raw (bypass) mode
+ */
+void ff_mqc_restartenc(MqcState *mqc, uint8_t *bp, int raw);
+
 /** code bit d with context cx */
 void ff_mqc_encode(MqcState *mqc, uint8_t *cxstate, int d);
 
+/** terminate the codeword segment [returns number of bytes encoded] */
+int ff_mqc_flush(MqcState *mqc);
+
 /** flush the encoder [returns number of bytes encoded] */
 int ff_mqc_flush_to(MqcState *mqc, uint8_t *dst, int *dst_len);
 
@@ -25,6 +25,8 @@
  * @author Kamil Nowosad
  */
 
+#include "libavutil/common.h"
+
 #include "mqc.h"
 
 static void bytein(MqcState *mqc)
@@ -42,6 +44,28 @@ static void bytein(MqcState *mqc)
     }
 }
 
+/**
+ * RENORMD: see ISO/IEC 15444-1:2002 §C.3.3
+ * The low byte of c holds a single set bit which is shifted out when the
+ * next byte is due, so the shifts up to that point are done at once.
+ */
+static void renormd(MqcState *mqc)
+{
+    int n = ff_clz(mqc->a) - 16;
+
+    do {
+        int k;
+        if (!(mqc->c & 0xff)) {
+            mqc->c -= 0x100;
+            bytein(mqc);
+        }
+        k = FFMIN(n, 8 - ff_ctz(mqc->c));
+        mqc->a <<= k;
+        mqc->c <<= k;
+        n -= k;
+    } while (n > 0);
+}
+
 static int exchange(MqcState *mqc, uint8_t *cxstate, int lps)
 {
     int d;
@@ -56,15 +80,7 @@ static int exchange(MqcState *mqc, uint8_t *cxstate, int lps)
         d = 1 - (*cxstate & 1);
         *cxstate = ff_mqc_nlps[*cxstate];
     }
-    // do RENORMD: see ISO/IEC 15444-1:2002 §C.3.3
-    do {
-        if (!(mqc->c & 0xff)) {
-            mqc->c -= 0x100;
-            bytein(mqc);
-        }
-        mqc->a += mqc->a;
-        mqc->c += mqc->c;
-    } while (!(mqc->a & 0x8000));
+    renormd(mqc);
     return d;
 }
 
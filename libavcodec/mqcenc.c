@@ -26,6 +26,7 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/common.h"
 #include "mqc.h"
 
 static void byteout(MqcState *mqc)
@@ -50,12 +51,18 @@ retry:
 
 static void renorme(MqcState *mqc)
 {
+    /* shift until the next byte out at once instead of bit by bit;
+     * a is nonzero and below 0x8000 here */
+    int n = ff_clz(mqc->a) - 16;
     do{
-        mqc->a += mqc->a;
-        mqc->c += mqc->c;
-        if (!--mqc->ct)
+        int k = FFMIN(n, mqc->ct);
+        mqc->a <<= k;
+        mqc->c <<= k;
+        mqc->ct -= k;
+        n       -= k;
+        if (!mqc->ct)
             byteout(mqc);
-    } while (!(mqc->a & 0x8000));
+    } while (n);
 }
 
 static void setbits(MqcState *mqc)
@@ -74,12 +81,38 @@ void ff_mqc_initenc(MqcState *mqc, uint8_t *bp)
     mqc->bp = bp-1;
     mqc->bpstart = bp;
     mqc->ct = 12 + (*mqc->bp == 0xff);
+    mqc->raw = 0;
+}
+
+void ff_mqc_restartenc(MqcState *mqc, uint8_t *bp, int raw)
+{
+    /* The previous segment does not end with 0xff, and the interval
+     * cannot carry into the byte before bp until the first byte out. */
+    mqc->a = 0x8000;
+    mqc->c = 0;
+    mqc->bp = bp-1;
+    mqc->ct = raw ? 8 : 12;
+    mqc->raw = raw;
+}
+
+static void encode_raw(MqcState *mqc, int d)
+{
+    mqc->c = (mqc->c << 1) | d;
+    if (!--mqc->ct) {
+        *++mqc->bp = mqc->c;
+        mqc->ct = mqc->c == 0xff ? 7 : 8;
+        mqc->c = 0;
+    }
 }
 
 void ff_mqc_encode(MqcState *mqc, uint8_t *cxstate, int d)
 {
     int qe;
 
+    if (mqc->raw) {
+        encode_raw(mqc, d);
+        return;
+    }
     qe = ff_mqc_qe[*cxstate];
     mqc->a -= qe;
     if ((*cxstate & 1) == d){
@@ -102,8 +135,23 @@ void ff_mqc_encode(MqcState *mqc, uint8_t *cxstate, int d)
     }
 }
 
-static int mqc_flush(MqcState *mqc)
+/* Pad the last byte of a raw segment with alternating bits. A byte is
+ * padded after 0xff as well, so that no segment ends with 0xff. */
+static int raw_flush(MqcState *mqc)
 {
+    int i, n = mqc->ct;
+
+    if (n < 8)
+        for (i = 0; i < n; i++)
+            encode_raw(mqc, i & 1);
+    mqc->bp++;
+    return mqc->bp - mqc->bpstart;
+}
+
+int ff_mqc_flush(MqcState *mqc)
+{
+    if (mqc->raw)
+        return raw_flush(mqc);
     setbits(mqc);
     mqc->c = mqc->c << mqc->ct;
     byteout(mqc);
@@ -117,10 +165,19 @@ static int mqc_flush(MqcState *mqc)
 int ff_mqc_flush_to(MqcState *mqc, uint8_t *dst, int *dst_len)
 {
     MqcState mqc2 = *mqc;
+
+    if (mqc->raw) {
+        /* the bytes written so far are final, only the pending bits are
+         * flushed to dst */
+        mqc2.bpstart = dst;
+        mqc2.bp = dst - 1;
+        *dst_len = raw_flush(&mqc2);
+        return mqc->bp + 1 - mqc->bpstart + *dst_len;
+    }
     mqc2.bpstart=
     mqc2.bp = dst;
     *mqc2.bp = *mqc->bp;
-    mqc_flush(&mqc2);
+    ff_mqc_flush(&mqc2);
     *dst_len = mqc2.bp - dst;
     if (mqc->bp < mqc->bpstart) {
         av_assert1(mqc->bpstart - mqc->bp == 1);
@@ -298,6 +298,16 @@ enum AVPacketSideDataType {
      */
     AV_PKT_DATA_DYNAMIC_HDR10_PLUS,
 
+    /**
+     * An opaque identifier of the coded content of the packet, as a byte
+     * string. Packets of the same stream which carry the same identifier
+     * contain the same coded data, e.g. because a playlist references the
+     * same frame of a resource several times. For intra-only codecs, they
+     * decode to identical frames, so a decoded frame may be reused instead
+     * of decoding the packet again.
+     */
+    AV_PKT_DATA_CONTENT_ID,
+
     /**
      * The number of side data types.
      * This is not part of the public API/ABI in the sense that it may
@@ -715,6 +725,61 @@ int av_packet_make_writable(AVPacket *pkt);
  */
 void av_packet_rescale_ts(AVPacket *pkt, AVRational tb_src, AVRational tb_dst);
 
+/**
+ * A pool of AVPacket structures and of packet payloads, which can be used
+ * to avoid allocating and freeing them for each packet when packets are
+ * produced and consumed at a high rate.
+ *
+ * All functions operating on a pool may be called from different threads
+ * at the same time. Payloads allocated from a pool stay valid after the
+ * pool is freed, until their last reference is released.
+ */
+typedef struct AVPacketPool AVPacketPool;
+
+/**
+ * Allocate an empty packet pool.
+ *
+ * @return the pool or NULL on allocation failure
+ */
+AVPacketPool *av_packet_pool_alloc(void);
+
+/**
+ * Free a packet pool and the packets it holds, and set *pool to NULL.
+ * Packets and payloads that are still in use are not affected.
+ */
+void av_packet_pool_free(AVPacketPool **pool);
+
+/**
+ * Get a packet from the pool, set to default values. If the pool holds no
+ * packet, a new one is allocated as with av_packet_alloc().
+ *
+ * @return the packet, which should be returned to the pool with
+ *         av_packet_pool_release() or freed with av_packet_free(), or NULL
+ *         on allocation failure
+ */
+AVPacket *av_packet_pool_get(AVPacketPool *pool);
+
+/**
+ * Unreference a packet and return it to the pool, or free it if the pool
+ * already holds enough packets. *pkt is set to NULL.
+ *
+ * @param pkt packet allocated with av_packet_pool_get() or av_packet_alloc()
+ */
+void av_packet_pool_release(AVPacketPool *pool, AVPacket **pkt);
+
+/**
+ * Same as av_new_packet(), except that the payload is taken from the pool.
+ * Payloads are pooled by power of two sizes, so this is most useful when
+ * the packet sizes do not vary by much.
+ *
+ * @param pool the packet pool
+ * @param pkt  packet to be initialized, any previous content is not
+ *             unreferenced
+ * @param size wanted payload size
+ * @return 0 if OK, AVERROR_xxx otherwise
+ */
+int av_packet_pool_new_packet(AVPacketPool *pool, AVPacket *pkt, int size);
+
 /**
  * @}
  */
@@ -53,65 +53,83 @@ static void permute(uint8_t *dst, const uint8_t *src, const uint8_t permutation[
 #define ALPHA_SHIFT_16_TO_12(alpha_val) (alpha_val >> 4)
 #define ALPHA_SHIFT_8_TO_12(alpha_val)  ((alpha_val << 4) | (alpha_val >> 4))
 
-static void inline unpack_alpha(GetBitContext *gb, uint16_t *dst, int num_coeffs,
-                                const int num_bits, const int decode_precision) {
+static av_always_inline int alpha_output(int alpha_val, const int num_bits,
+                                         const int decode_precision)
+{
+    if (num_bits == 16) {
+        if (decode_precision == 10)
+            return ALPHA_SHIFT_16_TO_10(alpha_val);
+        else /* 12b */
+            return ALPHA_SHIFT_16_TO_12(alpha_val);
+    } else {
+        if (decode_precision == 10)
+            return ALPHA_SHIFT_8_TO_10(alpha_val);
+        else /* 12b */
+            return ALPHA_SHIFT_8_TO_12(alpha_val);
+    }
+}
+
+static av_always_inline void fill_alpha(uint16_t *dst, int val, int n)
+{
+    const uint64_t val4 = val * 0x0001000100010001ULL;
+
+    for (; n >= 4; n -= 4, dst += 4)
+        AV_WN64(dst, val4);
+    for (; n > 0; n--)
+        *dst++ = val;
+}
+
+static av_always_inline void unpack_alpha(GetBitContext *gb, uint16_t *dst, int num_coeffs,
+                                          const int num_bits, const int decode_precision)
+{
     const int mask = (1 << num_bits) - 1;
-    int i, idx, val, alpha_val;
+    int idx, val, alpha_val;
+
+    OPEN_READER(re, gb);
 
     idx       = 0;
     alpha_val = mask;
     do {
         do {
-            if (get_bits1(gb)) {
-                val = get_bits(gb, num_bits);
+            /* flag + value + continuation flag fit in MIN_CACHE_BITS */
+            UPDATE_CACHE(re, gb);
+            if (SHOW_UBITS(re, gb, 1)) {
+                SKIP_BITS(re, gb, 1);
+                val = SHOW_UBITS(re, gb, num_bits);
+                SKIP_BITS(re, gb, num_bits);
             } else {
                 int sign;
-                val  = get_bits(gb, num_bits == 16 ? 7 : 4);
+                SKIP_BITS(re, gb, 1);
+                val  = SHOW_UBITS(re, gb, num_bits == 16 ? 7 : 4);
+                SKIP_BITS(re, gb, num_bits == 16 ? 7 : 4);
                 sign = val & 1;
                 val  = (val + 2) >> 1;
                 if (sign)
                     val = -val;
             }
             alpha_val = (alpha_val + val) & mask;
-            if (num_bits == 16) {
-                if (decode_precision == 10) {
-                    dst[idx++] = ALPHA_SHIFT_16_TO_10(alpha_val);
-                } else { /* 12b */
-                    dst[idx++] = ALPHA_SHIFT_16_TO_12(alpha_val);
-                }
-            } else {
-                if (decode_precision == 10) {
-                    dst[idx++] = ALPHA_SHIFT_8_TO_10(alpha_val);
-                } else { /* 12b */
-                    dst[idx++] = ALPHA_SHIFT_8_TO_12(alpha_val);
-                }
-            }
+            dst[idx++] = alpha_output(alpha_val, num_bits, decode_precision);
             if (idx >= num_coeffs)
                 break;
-        } while (get_bits_left(gb)>0 && get_bits1(gb));
-        val = get_bits(gb, 4);
-        if (!val)
-            val = get_bits(gb, 11);
+            if (gb->size_in_bits - re_index <= 0)
+                break;
+            val = SHOW_UBITS(re, gb, 1);
+            SKIP_BITS(re, gb, 1);
+        } while (val);
+        UPDATE_CACHE(re, gb);
+        val = SHOW_UBITS(re, gb, 4);
+        SKIP_BITS(re, gb, 4);
+        if (!val) {
+            val = SHOW_UBITS(re, gb, 11);
+            SKIP_BITS(re, gb, 11);
+        }
         if (idx + val > num_coeffs)
             val = num_coeffs - idx;
-        if (num_bits == 16) {
-            for (i = 0; i < val; i++) {
-                if (decode_precision == 10) {
-                    dst[idx++] = ALPHA_SHIFT_16_TO_10(alpha_val);
-                } else { /* 12b */
-                    dst[idx++] = ALPHA_SHIFT_16_TO_12(alpha_val);
-                }
-            }
-        } else {
-            for (i = 0; i < val; i++) {
-                if (decode_precision == 10) {
-                    dst[idx++] = ALPHA_SHIFT_8_TO_10(alpha_val);
-                } else { /* 12b */
-                    dst[idx++] = ALPHA_SHIFT_8_TO_12(alpha_val);
-                }
-            }
-        }
+        fill_alpha(dst + idx, alpha_output(alpha_val, num_bits, decode_precision), val);
+        idx += val;
     } while (idx < num_coeffs);
+
+    CLOSE_READER(re, gb);
 }
 
 static void unpack_alpha_10(GetBitContext *gb, uint16_t *dst, int num_coeffs,
@@ -595,9 +613,7 @@ static void decode_slice_alpha(ProresContext *ctx,
     LOCAL_ALIGNED_32(int16_t, blocks, [8*4*64]);
     int16_t *block;
 
-    for (i = 0; i < blocks_per_slice<<2; i++)
-        ctx->bdsp.clear_block(blocks+(i<<6));
-
+    /* unpack_alpha() always fills the whole buffer, no need to clear it */
     init_get_bits(&gb, buf, buf_size << 3);
 
     if (ctx->alpha_info == 2) {
@@ -220,11 +220,21 @@ struct TrellisNode {
 
 #define MAX_STORED_Q 16
 
+/**
+ * Reciprocal of a quantizer for quant_div(); the division by multiplication
+ * is exact for all coefficient magnitudes up to 1 << 15.
+ */
+#define QUANT_RECIP(q) ((1U << 31) / (q) + 1)
+
 typedef struct ProresThreadData {
     DECLARE_ALIGNED(16, int16_t, blocks)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
+    /// magnitudes of the AC coefficients of a slice, in scan order
+    uint16_t ac_levels[MAX_PLANES][63 * 4 * MAX_MBS_PER_SLICE];
     DECLARE_ALIGNED(16, uint16_t, emu_buf)[16 * 16];
     int16_t custom_q[64];
     int16_t custom_chroma_q[64];
+    uint32_t custom_q_recip[64];
+    uint32_t custom_chroma_q_recip[64];
     struct TrellisNode *nodes;
 } ProresThreadData;
 
@@ -234,6 +244,8 @@ typedef struct ProresContext {
     DECLARE_ALIGNED(16, uint16_t, emu_buf)[16*16];
     int16_t quants[MAX_STORED_Q][64];
     int16_t quants_chroma[MAX_STORED_Q][64];
+    uint32_t quants_recip[MAX_STORED_Q][64];
+    uint32_t quants_chroma_recip[MAX_STORED_Q][64];
     int16_t custom_q[64];
     int16_t custom_chroma_q[64];
     const uint8_t *quant_mat;
@@ -677,26 +689,51 @@ static int estimate_dcs(int *error, int16_t *blocks, int blocks_per_slice,
     return bits;
 }
 
-static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
+static av_always_inline unsigned quant_div(unsigned level, uint32_t recip)
+{
+    return (uint64_t)level * recip >> 31;
+}
+
+/**
+ * Gather the AC coefficient magnitudes of a slice plane in the order they
+ * are coded, so that the bit estimation for every candidate quantiser reads
+ * them sequentially.
+ */
+static void get_ac_levels(uint16_t *levels, const int16_t *blocks,
+                          int blocks_per_slice, const uint8_t *scan)
+{
+    int i, j;
+
+    for (i = 1; i < 64; i++) {
+        const int16_t *src = blocks + scan[i];
+
+        for (j = 0; j < blocks_per_slice; j++)
+            *levels++ = FFABS(src[j << 6]);
+    }
+}
+
+static int estimate_acs(int *error, const uint16_t *levels, int blocks_per_slice,
                         int plane_size_factor,
-                        const uint8_t *scan, const int16_t *qmat)
+                        const uint8_t *scan, const int16_t *qmat,
+                        const uint32_t *qmat_recip)
 {
-    int idx, i;
-    int run, level, run_cb, lev_cb;
-    int max_coeffs, abs_level;
-    int bits = 0;
+    int i, j;
+    int run, run_cb, lev_cb;
+    unsigned abs_level;
+    int bits = 0, err = 0;
 
-    max_coeffs = blocks_per_slice << 6;
     run_cb     = ff_prores_run_to_cb_index[4];
     lev_cb     = ff_prores_lev_to_cb_index[2];
     run        = 0;
 
     for (i = 1; i < 64; i++) {
-        for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level   = blocks[idx] / qmat[scan[i]];
-            *error += FFABS(blocks[idx]) % qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
+        const int      q     = qmat[scan[i]];
+        const uint32_t recip = qmat_recip[scan[i]];
+
+        for (j = 0; j < blocks_per_slice; j++) {
+            abs_level = quant_div(levels[j], recip);
+            err      += levels[j] - abs_level * q;
+            if (abs_level) {
                 bits += estimate_vlc(ff_prores_ac_codebook[run_cb], run);
                 bits += estimate_vlc(ff_prores_ac_codebook[lev_cb],
                                      abs_level - 1) + 1;
@@ -708,7 +745,9 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
                 run++;
             }
         }
+        levels += blocks_per_slice;
     }
+    *error += err;
 
     return bits;
 }
@@ -717,7 +756,8 @@ static int estimate_slice_plane(ProresContext *ctx, int *error, int plane,
                                 const uint16_t *src, ptrdiff_t linesize,
                                 int mbs_per_slice,
                                 int blocks_per_mb, int plane_size_factor,
-                                const int16_t *qmat, ProresThreadData *td)
+                                const int16_t *qmat, const uint32_t *qmat_recip,
+                                ProresThreadData *td)
 {
     int blocks_per_slice;
     int bits;
@@ -725,8 +765,8 @@ static int estimate_slice_plane(ProresContext *ctx, int *error, int plane,
     blocks_per_slice = mbs_per_slice * blocks_per_mb;
 
     bits  = estimate_dcs(error, td->blocks[plane], blocks_per_slice, qmat[0]);
-    bits += estimate_acs(error, td->blocks[plane], blocks_per_slice,
-                         plane_size_factor, ctx->scantable, qmat);
+    bits += estimate_acs(error, td->ac_levels[plane], blocks_per_slice,
+                         plane_size_factor, ctx->scantable, qmat, qmat_recip);
 
     return FFALIGN(bits, 8);
 }
@@ -806,6 +846,7 @@ static int find_slice_quant(AVCodecContext *avctx,
     int overquant;
     uint16_t *qmat;
     uint16_t *qmat_chroma;
+    uint32_t *qmat_recip, *qmat_chroma_recip;
     int linesize[4], line_add;
     int alpha_bits = 0;
 
@@ -841,6 +882,8 @@ static int find_slice_quant(AVCodecContext *avctx,
                            pwidth, avctx->height / ctx->pictures_per_frame,
                            td->blocks[i], td->emu_buf,
                            mbs_per_slice, num_cblocks[i], is_chroma[i]);
+            get_ac_levels(td->ac_levels[i], td->blocks[i],
+                          mbs_per_slice * num_cblocks[i], ctx->scantable);
         } else {
             get_alpha_data(ctx, src, linesize[i], xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
@@ -864,13 +907,15 @@ static int find_slice_quant(AVCodecContext *avctx,
                                      src, linesize[0],
                                      mbs_per_slice,
                                      num_cblocks[0], plane_factor[0],
-                                     ctx->quants[q], td); /* estimate luma plane */
+                                     ctx->quants[q], ctx->quants_recip[q],
+                                     td); /* estimate luma plane */
         for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
             bits += estimate_slice_plane(ctx, &error, i,
                                          src, linesize[i],
                                          mbs_per_slice,
                                          num_cblocks[i], plane_factor[i],
-                                         ctx->quants_chroma[q], td);
+                                         ctx->quants_chroma[q],
+                                         ctx->quants_chroma_recip[q], td);
         }
         if (bits > 65000 * 8)
             error = SCORE_LIMIT;
@@ -889,25 +934,31 @@ static int find_slice_quant(AVCodecContext *avctx,
             if (q < MAX_STORED_Q) {
                 qmat = ctx->quants[q];
                 qmat_chroma = ctx->quants_chroma[q];
+                qmat_recip = ctx->quants_recip[q];
+                qmat_chroma_recip = ctx->quants_chroma_recip[q];
             } else {
                 qmat = td->custom_q;
                 qmat_chroma = td->custom_chroma_q;
+                qmat_recip = td->custom_q_recip;
+                qmat_chroma_recip = td->custom_chroma_q_recip;
                 for (i = 0; i < 64; i++) {
                     qmat[i] = ctx->quant_mat[i] * q;
                     qmat_chroma[i] = ctx->quant_chroma_mat[i] * q;
+                    qmat_recip[i] = QUANT_RECIP(qmat[i]);
+                    qmat_chroma_recip[i] = QUANT_RECIP(qmat_chroma[i]);
                 }
             }
             bits += estimate_slice_plane(ctx, &error, 0,
                                          src, linesize[0],
                                          mbs_per_slice,
                                          num_cblocks[0], plane_factor[0],
-                                         qmat, td);/* estimate luma plane */
+                                         qmat, qmat_recip, td);/* estimate luma plane */
             for (i = 1; i < ctx->num_planes - !!ctx->alpha_bits; i++) { /* estimate chroma plane */
                 bits += estimate_slice_plane(ctx, &error, i,
                                              src, linesize[i],
                                              mbs_per_slice,
                                              num_cblocks[i], plane_factor[i],
-                                             qmat_chroma, td);
+                                             qmat_chroma, qmat_chroma_recip, td);
             }
             if (bits <= ctx->bits_per_mb * mbs_per_slice)
                 break;
@@ -1270,6 +1321,8 @@ static av_cold int encode_init(AVCodecContext *avctx)
             for (j = 0; j < 64; j++) {
                 ctx->quants[i][j] = ctx->quant_mat[j] * i;
                 ctx->quants_chroma[i][j] = ctx->quant_chroma_mat[j] * i;
+                ctx->quants_recip[i][j] = QUANT_RECIP(ctx->quants[i][j]);
+                ctx->quants_chroma_recip[i][j] = QUANT_RECIP(ctx->quants_chroma[i][j]);
             }
         }
 
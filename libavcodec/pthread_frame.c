@@ -44,6 +44,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace_internal.h"
 
 enum {
     ///< Set when the thread is awaiting a packet.
@@ -118,8 +119,22 @@ typedef struct PerThreadContext {
     int async_serializing;
 
     atomic_int debug_threads;       ///< Set if the FF_DEBUG_THREADS option is set.
+
+    int64_t seq;                    ///< Out-of-order mode: number of the packet being decoded, -1 if idle.
 } PerThreadContext;
 
+/**
+ * Output of a thread kept until the frames before it are returned,
+ * in out-of-order mode.
+ */
+typedef struct ReorderEntry {
+    AVFrame *frame;
+    int      got_frame;
+    int      result;
+    int64_t  pkt_dts;
+    int      done;
+} ReorderEntry;
+
 /**
  * Context stored in the client AVCodecInternal thread_ctx.
  */
@@ -145,6 +160,19 @@ typedef struct FrameThreadContext {
                                     * Set for the first N packets, where N is the number of threads.
                                     * While it is set, ff_thread_en/decode_frame won't return any results.
                                     */
+
+    /**
+     * Set for intra-only codecs without inter-thread state: the packets are
+     * submitted to any idle thread, and the frames finished out of order
+     * wait in the reorder buffer.
+     */
+    int out_of_order;
+    ReorderEntry *reorder;         ///< Reorder buffer, indexed by packet number modulo nb_reorder.
+    int nb_reorder;
+    int64_t next_seq;              ///< Number of the next packet submitted.
+    int64_t next_output_seq;       ///< Number of the packet of the next returned frame.
+    pthread_mutex_t done_mutex;    ///< Out-of-order mode: mutex for done_cond.
+    pthread_cond_t  done_cond;     ///< Out-of-order mode: signaled when a thread finishes.
 } FrameThreadContext;
 
 #if FF_API_THREAD_SAFE_CALLBACKS
@@ -216,7 +244,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
         av_frame_unref(p->frame);
         p->got_frame = 0;
+        av_mem_accounting_set_context(avctx);
+        FF_TRACE_BEGIN("frame_thread", codec->name);
         p->result = codec->decode(avctx, p->frame, &p->got_frame, p->avpkt);
+        FF_TRACE_END("frame_thread", codec->name);
 
         if ((p->result < 0 || !p->got_frame) && p->frame->buf[0]) {
             if (avctx->codec->caps_internal & FF_CODEC_CAP_ALLOCATE_PROGRESS)
@@ -246,6 +277,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
         pthread_cond_broadcast(&p->progress_cond);
         pthread_cond_signal(&p->output_cond);
         pthread_mutex_unlock(&p->progress_mutex);
+
+        if (p->parent->out_of_order) {
+            pthread_mutex_lock(&p->parent->done_mutex);
+            pthread_cond_signal(&p->parent->done_cond);
+            pthread_mutex_unlock(&p->parent->done_mutex);
+        }
     }
     pthread_mutex_unlock(&p->mutex);
 
@@ -402,6 +439,43 @@ static void release_delayed_buffers(PerThreadContext *p)
 }
 #endif
 
+/**
+ * Initializes the codec of a thread and creates the thread.
+ *
+ * @param avctx the user context, updated from the codec of the thread if not NULL
+ */
+static int start_thread(PerThreadContext *p, AVCodecContext *avctx)
+{
+    const AVCodec *codec = p->avctx->codec;
+    int err;
+
+    /* a thread which failed to start is not retried */
+    if (p->thread_init != UNINITIALIZED)
+        return p->thread_init == INITIALIZED ? 0 : AVERROR(EINVAL);
+
+    if (codec->init) {
+        err = codec->init(p->avctx);
+        if (err < 0) {
+            if (codec->caps_internal & FF_CODEC_CAP_INIT_CLEANUP)
+                p->thread_init = NEEDS_CLOSE;
+            return err;
+        }
+    }
+    p->thread_init = NEEDS_CLOSE;
+
+    if (avctx)
+        update_context_from_thread(avctx, p->avctx, 1);
+
+    atomic_init(&p->debug_threads, (p->avctx->debug & FF_DEBUG_THREADS) != 0);
+
+    err = AVERROR(pthread_create(&p->thread, NULL, frame_worker_thread, p));
+    if (err < 0)
+        return err;
+    p->thread_init = INITIALIZED;
+
+    return 0;
+}
+
 static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
                          AVPacket *avpkt)
 {
@@ -413,6 +487,10 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
     if (!avpkt->size && !(codec->capabilities & AV_CODEC_CAP_DELAY))
         return 0;
 
+    ret = start_thread(p, NULL);
+    if (ret < 0)
+        return ret;
+
     pthread_mutex_lock(&p->mutex);
 
     ret = update_context_from_user(p->avctx, user_avctx);
@@ -500,6 +578,97 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
+/**
+ * Moves the output of the threads which are done to the reorder buffer.
+ *
+ * @param seq number of the packet whose output to wait for, or -1 to wait
+ *            for an idle thread
+ * @return a pointer to an idle thread
+ */
+static PerThreadContext *collect_finished_threads(AVCodecContext *avctx, int64_t seq)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    PerThreadContext *idle;
+
+    pthread_mutex_lock(&fctx->done_mutex);
+    while (1) {
+        idle = NULL;
+        for (int i = 0; i < avctx->thread_count; i++) {
+            PerThreadContext *p = &fctx->threads[i];
+            ReorderEntry *e;
+
+            if (p->seq >= 0 && atomic_load(&p->state) == STATE_INPUT_READY) {
+                e = &fctx->reorder[p->seq % fctx->nb_reorder];
+                av_frame_move_ref(e->frame, p->frame);
+                e->got_frame = p->got_frame;
+                e->result    = p->result;
+                e->pkt_dts   = p->avpkt->dts;
+                e->done      = 1;
+                p->got_frame = 0;
+                p->result    = 0;
+                p->seq       = -1;
+                /* the frames carry their own properties, the user context
+                 * only follows the threads in completion order */
+                update_context_from_thread(avctx, p->avctx, 1);
+            }
+            if (p->seq < 0 && !idle)
+                idle = p;
+        }
+        if (seq < 0 ? !!idle : fctx->reorder[seq % fctx->nb_reorder].done)
+            break;
+        pthread_cond_wait(&fctx->done_cond, &fctx->done_mutex);
+    }
+    pthread_mutex_unlock(&fctx->done_mutex);
+
+    return idle;
+}
+
+static int decode_frame_out_of_order(AVCodecContext *avctx,
+                                     AVFrame *picture, int *got_picture_ptr,
+                                     AVPacket *avpkt)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    ReorderEntry *e;
+    int err;
+
+    *got_picture_ptr = 0;
+
+    if (avpkt->size) {
+        /* the reorder buffer has room for this packet, since at most
+         * nb_reorder - 1 packets are in flight between calls */
+        PerThreadContext *p = collect_finished_threads(avctx, -1);
+
+        err = submit_packet(p, avctx, avpkt);
+        if (err)
+            return err;
+        p->seq = fctx->next_seq++;
+        fctx->next_decoding = 0;
+
+        if (fctx->next_seq - fctx->next_output_seq < fctx->nb_reorder)
+            return avpkt->size;
+    }
+
+    /* return the oldest frame, skipping the packets which did not output
+     * a frame or an error at the end of the stream */
+    while (fctx->next_output_seq < fctx->next_seq) {
+        e = &fctx->reorder[fctx->next_output_seq % fctx->nb_reorder];
+        if (!e->done)
+            collect_finished_threads(avctx, fctx->next_output_seq);
+
+        av_frame_move_ref(picture, e->frame);
+        *got_picture_ptr = e->got_frame;
+        picture->pkt_dts = e->pkt_dts;
+        err = e->result;
+        e->got_frame = e->result = e->done = 0;
+        fctx->next_output_seq++;
+
+        if (avpkt->size || *got_picture_ptr || err < 0)
+            return err < 0 ? err : avpkt->size;
+    }
+
+    return 0;
+}
+
 int ff_thread_decode_frame(AVCodecContext *avctx,
                            AVFrame *picture, int *got_picture_ptr,
                            AVPacket *avpkt)
@@ -513,6 +682,11 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
      * go forward while we are in this function */
     async_unlock(fctx);
 
+    if (fctx->out_of_order) {
+        err = decode_frame_out_of_order(avctx, picture, got_picture_ptr, avpkt);
+        goto finish;
+    }
+
     /*
      * Submit a packet to the next decoding thread.
      */
@@ -682,8 +856,8 @@ static void park_frame_worker_threads(FrameThreadContext *fctx, int thread_count
 
 #define OFF(member) offsetof(FrameThreadContext, member)
 DEFINE_OFFSET_ARRAY(FrameThreadContext, thread_ctx, pthread_init_cnt,
-                    (OFF(buffer_mutex), OFF(hwaccel_mutex), OFF(async_mutex)),
-                    (OFF(async_cond)));
+                    (OFF(buffer_mutex), OFF(hwaccel_mutex), OFF(async_mutex), OFF(done_mutex)),
+                    (OFF(async_cond), OFF(done_cond)));
 #undef OFF
 
 #define OFF(member) offsetof(PerThreadContext, member)
@@ -758,6 +932,10 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
     }
 
     av_freep(&fctx->threads);
+    if (fctx->reorder)
+        for (i = 0; i < fctx->nb_reorder; i++)
+            av_frame_free(&fctx->reorder[i].frame);
+    av_freep(&fctx->reorder);
     ff_pthread_free(fctx, thread_ctx_offsets);
 
     av_freep(&avctx->internal->thread_ctx);
@@ -771,6 +949,7 @@ static av_cold int init_thread(PerThreadContext *p, int *threads_to_free,
     int err;
 
     atomic_init(&p->state, STATE_INPUT_READY);
+    p->seq = -1;
 
     copy = av_memdup(src, sizeof(*src));
     if (!copy)
@@ -816,25 +995,9 @@ static av_cold int init_thread(PerThreadContext *p, int *threads_to_free,
     if (!first)
         copy->internal->is_copy = 1;
 
-    if (codec->init) {
-        err = codec->init(copy);
-        if (err < 0) {
-            if (codec->caps_internal & FF_CODEC_CAP_INIT_CLEANUP)
-                p->thread_init = NEEDS_CLOSE;
-            return err;
-        }
-    }
-    p->thread_init = NEEDS_CLOSE;
-
+    /* the other threads are started when a packet is first submitted to them */
     if (first)
-        update_context_from_thread(avctx, copy, 1);
-
-    atomic_init(&p->debug_threads, (copy->debug & FF_DEBUG_THREADS) != 0);
-
-    err = AVERROR(pthread_create(&p->thread, NULL, frame_worker_thread, p));
-    if (err < 0)
-        return err;
-    p->thread_init = INITIALIZED;
+        return start_thread(p, avctx);
 
     return 0;
 }
@@ -844,6 +1007,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
     int thread_count = avctx->thread_count;
     const AVCodec *codec = avctx->codec;
     AVCodecContext *src = avctx;
+    const AVCodecDescriptor *desc;
     FrameThreadContext *fctx;
     int err, i = 0;
 
@@ -875,8 +1039,34 @@ int ff_frame_thread_init(AVCodecContext *avctx)
     fctx->async_lock = 1;
     fctx->delaying = 1;
 
+    /* without inter-frame state, a slow frame only delays the output of the
+     * following ones, while the other threads keep decoding */
+    desc = avcodec_descriptor_get(avctx->codec_id);
+    fctx->out_of_order = codec->type == AVMEDIA_TYPE_VIDEO && !codec->update_thread_context &&
+                         desc && desc->props & AV_CODEC_PROP_INTRA_ONLY;
+#if FF_API_THREAD_SAFE_CALLBACKS
+FF_DISABLE_DEPRECATION_WARNINGS
+    /* the callbacks would be serviced from the threads in submission order */
+    if (!THREAD_SAFE_CALLBACKS(avctx))
+        fctx->out_of_order = 0;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+    if (fctx->out_of_order) {
+        fctx->nb_reorder = 2 * thread_count;
+        fctx->reorder = av_calloc(fctx->nb_reorder, sizeof(*fctx->reorder));
+        if (!fctx->reorder) {
+            err = AVERROR(ENOMEM);
+            goto error;
+        }
+        for (int j = 0; j < fctx->nb_reorder; j++)
+            if (!(fctx->reorder[j].frame = av_frame_alloc())) {
+                err = AVERROR(ENOMEM);
+                goto error;
+            }
+    }
+
     if (codec->type == AVMEDIA_TYPE_VIDEO)
-        avctx->delay = src->thread_count - 1;
+        avctx->delay = fctx->out_of_order ? fctx->nb_reorder - 1 : src->thread_count - 1;
 
     fctx->threads = av_calloc(thread_count, sizeof(*fctx->threads));
     if (!fctx->threads) {
@@ -916,9 +1106,16 @@ void ff_thread_flush(AVCodecContext *avctx)
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
     fctx->prev_thread = NULL;
+    fctx->next_seq = fctx->next_output_seq = 0;
+    for (i = 0; i < fctx->nb_reorder; i++) {
+        ReorderEntry *e = &fctx->reorder[i];
+        av_frame_unref(e->frame);
+        e->got_frame = e->result = e->done = 0;
+    }
     for (i = 0; i < avctx->thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
         // Make sure decode flush calls with size=0 won't return old frames
+        p->seq = -1;
         p->got_frame = 0;
         av_frame_unref(p->frame);
         p->result = 0;
@@ -927,7 +1124,7 @@ void ff_thread_flush(AVCodecContext *avctx)
         release_delayed_buffers(p);
 #endif
 
-        if (avctx->codec->flush)
+        if (avctx->codec->flush && p->thread_init == INITIALIZED)
             avctx->codec->flush(p->avctx);
     }
 }
@@ -35,6 +35,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/trace_internal.h"
 
 typedef int (action_func)(AVCodecContext *c, void *arg);
 typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
@@ -68,8 +69,10 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
     SliceThreadContext *c = avctx->internal->thread_ctx;
     int ret;
 
+    FF_TRACE_BEGIN("slice_job", avctx->codec->name);
     ret = c->func ? c->func(avctx, (char *)c->args + c->job_size * jobnr)
                   : c->func2(avctx, c->args, jobnr, threadnr);
+    FF_TRACE_END("slice_job", avctx->codec->name);
     if (c->rets)
         c->rets[jobnr] = ret;
 }
@@ -92,9 +95,30 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&avctx->internal->thread_ctx);
 }
 
+/**
+ * Creates the threads, which is deferred to the first execution of jobs, so
+ * that a codec which is opened but never decodes, e.g. while probing, does
+ * not start them.
+ */
+static int create_threads(AVCodecContext *avctx)
+{
+    SliceThreadContext *c = avctx->internal->thread_ctx;
+    void (*mainfunc)(void *);
+    int ret;
+
+    mainfunc = avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
+    ret = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, avctx->thread_count);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Could not create the slice threads: %s\n", av_err2str(ret));
+        return ret;
+    }
+    return 0;
+}
+
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
     SliceThreadContext *c = avctx->internal->thread_ctx;
+    int err;
 
     if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
@@ -102,6 +126,9 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     if (job_count <= 0)
         return 0;
 
+    if (!c->thread && (err = create_threads(avctx)) < 0)
+        return err;
+
     c->job_size = job_size;
     c->args = arg;
     c->func = func;
@@ -130,7 +157,6 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 {
     SliceThreadContext *c;
     int thread_count = avctx->thread_count;
-    void (*mainfunc)(void *);
 
     // We cannot do this in the encoder init as the threads are created before
     if (av_codec_is_encoder(avctx->codec) &&
@@ -155,16 +181,8 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     }
 
     avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
-    mainfunc = avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
-        if (c)
-            avpriv_slicethread_free(&c->thread);
-        av_freep(&avctx->internal->thread_ctx);
-        avctx->thread_count = 1;
-        avctx->active_thread_type = 0;
-        return 0;
-    }
-    avctx->thread_count = thread_count;
+    if (!c)
+        return AVERROR(ENOMEM);
 
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
@@ -37,34 +37,33 @@ static av_cold int encode_init(AVCodecContext *avctx)
     return 0;
 }
 
-static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
-                        const AVFrame *pic, int *got_packet)
+/**
+ * Pack a picture of planar GBR samples, rounded from input_depth to 10 bits.
+ */
+static av_always_inline void pack_picture(AVCodecContext *avctx, uint8_t *dst,
+                                          const AVFrame *pic, int pad,
+                                          int input_depth)
 {
-    int i, j, ret;
-    int aligned_width = FFALIGN(avctx->width,
-                                avctx->codec_id == AV_CODEC_ID_R10K ? 1 : 64);
-    int pad = (aligned_width - avctx->width) * 4;
-    uint8_t *srcr_line, *srcg_line, *srcb_line;
-    uint8_t *dst;
-
-    ret = ff_get_encode_buffer(avctx, pkt, 4 * aligned_width * avctx->height, 0);
-    if (ret < 0)
-        return ret;
-
-    srcg_line = pic->data[0];
-    srcb_line = pic->data[1];
-    srcr_line = pic->data[2];
-    dst = pkt->data;
+    int shift = input_depth - 10;
+    const uint8_t *srcg_line = pic->data[0];
+    const uint8_t *srcb_line = pic->data[1];
+    const uint8_t *srcr_line = pic->data[2];
+    int i, j;
 
     for (i = 0; i < avctx->height; i++) {
-        uint16_t *srcr = (uint16_t *)srcr_line;
-        uint16_t *srcg = (uint16_t *)srcg_line;
-        uint16_t *srcb = (uint16_t *)srcb_line;
+        const uint16_t *srcr = (const uint16_t *)srcr_line;
+        const uint16_t *srcg = (const uint16_t *)srcg_line;
+        const uint16_t *srcb = (const uint16_t *)srcb_line;
         for (j = 0; j < avctx->width; j++) {
             uint32_t pixel;
             unsigned r = *srcr++;
             unsigned g = *srcg++;
             unsigned b = *srcb++;
+            if (shift) {
+                r = FFMIN((r + (1 << (shift - 1))) >> shift, 1023);
+                g = FFMIN((g + (1 << (shift - 1))) >> shift, 1023);
+                b = FFMIN((b + (1 << (shift - 1))) >> shift, 1023);
+            }
             if (avctx->codec_id == AV_CODEC_ID_R210)
                 pixel = (r << 20) | (g << 10) | b;
             else
@@ -80,12 +79,33 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
         srcg_line += pic->linesize[0];
         srcb_line += pic->linesize[1];
     }
+}
+
+static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                        const AVFrame *pic, int *got_packet)
+{
+    int ret;
+    int aligned_width = FFALIGN(avctx->width,
+                                avctx->codec_id == AV_CODEC_ID_R10K ? 1 : 64);
+    int pad = (aligned_width - avctx->width) * 4;
+
+    ret = ff_get_encode_buffer(avctx, pkt, 4 * aligned_width * avctx->height, 0);
+    if (ret < 0)
+        return ret;
+
+    /* 12-bit input is rounded while packing, without a separate conversion */
+    if (pic->format == AV_PIX_FMT_GBRP12)
+        pack_picture(avctx, pkt->data, pic, pad, 12);
+    else
+        pack_picture(avctx, pkt->data, pic, pad, 10);
 
     *got_packet = 1;
     return 0;
 }
 
-static const enum AVPixelFormat pix_fmt[] = { AV_PIX_FMT_GBRP10, AV_PIX_FMT_NONE };
+static const enum AVPixelFormat pix_fmt[] = {
+    AV_PIX_FMT_GBRP10, AV_PIX_FMT_GBRP12, AV_PIX_FMT_NONE
+};
 
 #if CONFIG_R210_ENCODER
 const AVCodec ff_r210_encoder = {
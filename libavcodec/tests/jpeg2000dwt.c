@@ -65,6 +65,44 @@ static int test_dwt(int *array, int *ref, int border[2][2], int decomp_levels, i
     return 0;
 }
 
+/* Inverse 5/3 transform of 16-bit coefficients, against the forward 5/3
+ * transform of 32-bit ones */
+static int test_dwt16(int *array, int16_t *array16, int *ref, int border[2][2], int decomp_levels) {
+    int ret, j;
+    DWTContext s1={{{0}}}, *s= &s1;
+    DWTContext s2={{{0}}}, *s16= &s2;
+
+    if ((ret = ff_jpeg2000_dwt_init(s,   border, decomp_levels, FF_DWT53)) < 0 ||
+        (ret = ff_jpeg2000_dwt_init(s16, border, decomp_levels, FF_DWT53_16)) < 0) {
+        fprintf(stderr, "ff_jpeg2000_dwt_init failed\n");
+        return 1;
+    }
+    ret = ff_dwt_encode(s, array);
+    if (ret < 0) {
+        fprintf(stderr, "ff_dwt_encode failed\n");
+        return 1;
+    }
+    for (j = 0; j<MAX_W * MAX_W; j++)
+        array16[j] = array[j];
+    ret = ff_dwt_decode(s16, array16);
+    if (ret < 0) {
+        fprintf(stderr, "ff_dwt_decode failed\n");
+        return 1;
+    }
+    for (j = 0; j<MAX_W * MAX_W; j++) {
+        if (array16[j] != ref[j]) {
+            fprintf(stderr, "16-bit missmatch at %d (%d != %d) decomp:%d border %d %d %d %d\n",
+                    j, array16[j], ref[j],decomp_levels, border[0][0], border[0][1], border[1][0], border[1][1]);
+            return 2;
+        }
+        array[j] = ref[j];
+    }
+    ff_dwt_destroy(s);
+    ff_dwt_destroy(s16);
+
+    return 0;
+}
+
 static int test_dwtf(float *array, float *ref, int border[2][2], int decomp_levels, float max_diff) {
     int ret, j;
     DWTContext s1={{{0}}}, *s= &s1;
@@ -105,6 +143,9 @@ static int test_dwtf(float *array, float *ref, int border[2][2], int decomp_leve
 
 static int array[MAX_W * MAX_W];
 static int ref  [MAX_W * MAX_W];
+static int array10[MAX_W * MAX_W];
+static int ref10  [MAX_W * MAX_W];
+static int16_t array16[MAX_W * MAX_W];
 static float arrayf[MAX_W * MAX_W];
 static float reff  [MAX_W * MAX_W];
 
@@ -118,6 +159,9 @@ int main(void) {
 
     for (i = 0; i<MAX_W * MAX_W; i++)
         arrayf[i] = reff[i] = array[i] = ref[i] =  av_lfg_get(&prng) % 2048;
+    /* 10-bit samples after the DC level shift */
+    for (i = 0; i<MAX_W * MAX_W; i++)
+        array10[i] = ref10[i] = ref[i] / 2 - 512;
 
     for (i = 0; i < 100; i++) {
         for (j=0; j<4; j++)
@@ -135,6 +179,10 @@ int main(void) {
         ret = test_dwtf(arrayf, reff, border, decomp_levels, 0.05);
         if (ret)
             return ret;
+        /* the 16-bit transform is used up to 5 levels for 10-bit samples */
+        ret = test_dwt16(array10, array16, ref10, border, FFMIN(decomp_levels, 5));
+        if (ret)
+            return ret;
     }
 
     return 0;
@@ -23,11 +23,14 @@
 #include "internal.h"
 
 #define CLIP(v, depth) av_clip(v, 1<<(depth-8), ((1<<depth)-(1<<(depth-8))-1))
+/* clipped to the legal range and scaled or rounded to 10 bits */
+#define SAMPLE(v, depth) ((depth) > 10 ? av_clip(((v) + 2) >> 2, 4, 1019) : \
+                                         CLIP(v, depth) << (10-(depth)))
 #define WRITE_PIXELS(a, b, c, depth)                      \
     do {                                                  \
-        val  =  CLIP(*a++, depth)  << (10-depth);         \
-        val |=  (CLIP(*b++, depth) << (20-depth)) |       \
-                (CLIP(*c++, depth) << (30-depth));        \
+        val  =  SAMPLE(*a++, depth);                      \
+        val |=  (SAMPLE(*b++, depth) << 10) |             \
+                (SAMPLE(*c++, depth) << 20);              \
         AV_WL32(dst, val);                                \
         dst += 4;                                         \
     } while (0)
@@ -65,18 +68,18 @@ static void RENAME(v210_enc)(AVCodecContext *avctx,
         if (w < avctx->width - 1) {
             WRITE_PIXELS(u, y, v, DEPTH);
 
-            val = CLIP(*y++, DEPTH) << (10-DEPTH);
+            val = SAMPLE(*y++, DEPTH);
             if (w == avctx->width - 2) {
                 AV_WL32(dst, val);
                 dst += 4;
             }
         }
         if (w < avctx->width - 3) {
-            val |= (CLIP(*u++, DEPTH) << (20-DEPTH)) | (CLIP(*y++, DEPTH) << (30-DEPTH));
+            val |= (SAMPLE(*u++, DEPTH) << 10) | (SAMPLE(*y++, DEPTH) << 20);
             AV_WL32(dst, val);
             dst += 4;
 
-            val = CLIP(*v++, DEPTH) << (10-DEPTH) | (CLIP(*y++, DEPTH) << (20-DEPTH));
+            val = SAMPLE(*v++, DEPTH) | (SAMPLE(*y++, DEPTH) << 10);
             AV_WL32(dst, val);
             dst += 4;
         }
@@ -47,6 +47,16 @@
 #undef BYTES_PER_PIXEL
 #undef TYPE
 
+#define TYPE uint16_t
+#define DEPTH 12
+#define BYTES_PER_PIXEL 2
+#define RENAME(a) a ## _ ## 12
+#include "v210_template.c"
+#undef RENAME
+#undef DEPTH
+#undef BYTES_PER_PIXEL
+#undef TYPE
+
 static void v210_planar_pack_8_c(const uint8_t *y, const uint8_t *u,
                                  const uint8_t *v, uint8_t *dst,
                                  ptrdiff_t width)
@@ -82,12 +92,29 @@ static void v210_planar_pack_10_c(const uint16_t *y, const uint16_t *u,
     }
 }
 
+static void v210_planar_pack_12_c(const uint16_t *y, const uint16_t *u,
+                                  const uint16_t *v, uint8_t *dst,
+                                  ptrdiff_t width)
+{
+    uint32_t val;
+    int i;
+
+    for (i = 0; i < width - 5; i += 6) {
+        WRITE_PIXELS(u, y, v, 12);
+        WRITE_PIXELS(y, u, y, 12);
+        WRITE_PIXELS(v, y, u, 12);
+        WRITE_PIXELS(y, v, y, 12);
+    }
+}
+
 av_cold void ff_v210enc_init(V210EncContext *s)
 {
     s->pack_line_8  = v210_planar_pack_8_c;
     s->pack_line_10 = v210_planar_pack_10_c;
+    s->pack_line_12 = v210_planar_pack_12_c;
     s->sample_factor_8  = 2;
     s->sample_factor_10 = 1;
+    s->sample_factor_12 = 1;
 
     if (ARCH_X86)
         ff_v210enc_init_x86(s);
@@ -126,7 +153,9 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     }
     dst = pkt->data;
 
-    if (pic->format == AV_PIX_FMT_YUV422P10)
+    if (pic->format == AV_PIX_FMT_YUV422P12)
+        v210_enc_12(avctx, dst, pic);
+    else if (pic->format == AV_PIX_FMT_YUV422P10)
         v210_enc_10(avctx, dst, pic);
     else if(pic->format == AV_PIX_FMT_YUV422P)
         v210_enc_8(avctx, dst, pic);
@@ -160,6 +189,7 @@ const AVCodec ff_v210_encoder = {
     .priv_data_size = sizeof(V210EncContext),
     .init           = encode_init,
     .encode2        = encode_frame,
-    .pix_fmts       = (const enum AVPixelFormat[]){ AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P, AV_PIX_FMT_NONE },
+    .pix_fmts       = (const enum AVPixelFormat[]){ AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P,
+                                                 AV_PIX_FMT_YUV422P12, AV_PIX_FMT_NONE },
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
 };
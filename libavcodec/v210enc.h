@@ -28,8 +28,11 @@ typedef struct V210EncContext {
                         const uint8_t *v, uint8_t *dst, ptrdiff_t width);
     void (*pack_line_10)(const uint16_t *y, const uint16_t *u,
                          const uint16_t *v, uint8_t *dst, ptrdiff_t width);
+    void (*pack_line_12)(const uint16_t *y, const uint16_t *u,
+                         const uint16_t *v, uint8_t *dst, ptrdiff_t width);
     int sample_factor_8;
     int sample_factor_10;
+    int sample_factor_12;
 } V210EncContext;
 
 void ff_v210enc_init(V210EncContext *s);
@@ -57,12 +57,23 @@ static int v410_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     v = (uint16_t *)pic->data[2];
 
     for (i = 0; i < avctx->height; i++) {
-        for (j = 0; j < avctx->width; j++) {
-            val  = u[j] << 2;
-            val |= y[j] << 12;
-            val |= (uint32_t) v[j] << 22;
-            AV_WL32(dst, val);
-            dst += 4;
+        if (pic->format == AV_PIX_FMT_YUV444P12) {
+            /* rounded to 10 bits while packing */
+            for (j = 0; j < avctx->width; j++) {
+                val  = FFMIN((u[j] + 2) >> 2, 1023) << 2;
+                val |= FFMIN((y[j] + 2) >> 2, 1023) << 12;
+                val |= (uint32_t) FFMIN((v[j] + 2) >> 2, 1023) << 22;
+                AV_WL32(dst, val);
+                dst += 4;
+            }
+        } else {
+            for (j = 0; j < avctx->width; j++) {
+                val  = u[j] << 2;
+                val |= y[j] << 12;
+                val |= (uint32_t) v[j] << 22;
+                AV_WL32(dst, val);
+                dst += 4;
+            }
         }
         y += pic->linesize[0] >> 1;
         u += pic->linesize[1] >> 1;
@@ -81,6 +92,7 @@ const AVCodec ff_v410_encoder = {
     .capabilities = AV_CODEC_CAP_DR1,
     .init         = v410_encode_init,
     .encode2      = v410_encode_frame,
-    .pix_fmts     = (const enum AVPixelFormat[]){ AV_PIX_FMT_YUV444P10, AV_PIX_FMT_NONE },
+    .pix_fmts     = (const enum AVPixelFormat[]){ AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV444P12,
+                                               AV_PIX_FMT_NONE },
     .caps_internal = FF_CODEC_CAP_INIT_THREADSAFE,
 };
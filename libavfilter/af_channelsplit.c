@@ -111,7 +111,7 @@ static int query_formats(AVFilterContext *ctx)
     AVFilterChannelLayouts *in_layouts = NULL;
     int i, ret;
 
-    if ((ret = ff_set_common_formats(ctx, ff_planar_sample_fmts())) < 0 ||
+    if ((ret = ff_set_common_formats(ctx, ff_all_formats(AVMEDIA_TYPE_AUDIO))) < 0 ||
         (ret = ff_set_common_all_samplerates(ctx)) < 0)
         return ret;
 
@@ -131,12 +131,67 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
+#define DEINTERLEAVE(type) do {                                          \
+    const type *src = (const type *)buf->data[0];                       \
+                                                                        \
+    for (n = 0; n < nb_samples; n++, src += nb_channels)                \
+        for (i = 0; i < nb_outputs; i++)                                \
+            ((type *)out[i]->data[0])[n] = src[s->map[i]];              \
+} while (0)
+
+/**
+ * Extract the selected channels of a packed frame in a single pass over
+ * the input samples.
+ */
+static int filter_frame_packed(AVFilterContext *ctx, AVFrame *buf)
+{
+    ChannelSplitContext *s = ctx->priv;
+    const int nb_outputs  = ctx->nb_outputs;
+    const int nb_channels = buf->channels;
+    const int nb_samples  = buf->nb_samples;
+    AVFrame *out[64] = { NULL };
+    int i, n, ret = 0;
+
+    for (i = 0; i < nb_outputs; i++) {
+        out[i] = ff_get_audio_buffer(ctx->outputs[i], nb_samples);
+        if (!out[i]) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        av_frame_copy_props(out[i], buf);
+    }
+
+    switch (av_get_bytes_per_sample(buf->format)) {
+    case 1: DEINTERLEAVE(uint8_t);  break;
+    case 2: DEINTERLEAVE(uint16_t); break;
+    case 4: DEINTERLEAVE(uint32_t); break;
+    case 8: DEINTERLEAVE(uint64_t); break;
+    }
+
+    for (i = 0; i < nb_outputs; i++) {
+        ret = ff_filter_frame(ctx->outputs[i], out[i]);
+        out[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+
+fail:
+    for (i = 0; i < nb_outputs; i++)
+        av_frame_free(&out[i]);
+    av_frame_free(&buf);
+    return ret;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
 {
     AVFilterContext *ctx = inlink->dst;
     ChannelSplitContext *s = ctx->priv;
     int i, ret = 0;
 
+    /* mono frames are both planar and packed, so can be referenced as is */
+    if (!av_sample_fmt_is_planar(buf->format) && buf->channels > 1)
+        return filter_frame_packed(ctx, buf);
+
     for (i = 0; i < ctx->nb_outputs; i++) {
         AVFrame *buf_out = av_frame_clone(buf);
 
@@ -320,6 +320,7 @@ extern const AVFilter ff_vf_lut;
 extern const AVFilter ff_vf_lut1d;
 extern const AVFilter ff_vf_lut2;
 extern const AVFilter ff_vf_lut3d;
+extern const AVFilter ff_vf_lut3d_cuda;
 extern const AVFilter ff_vf_lutrgb;
 extern const AVFilter ff_vf_lutyuv;
 extern const AVFilter ff_vf_maskedclamp;
@@ -377,6 +378,7 @@ extern const AVFilter ff_vf_program_opencl;
 extern const AVFilter ff_vf_pseudocolor;
 extern const AVFilter ff_vf_psnr;
 extern const AVFilter ff_vf_pullup;
+extern const AVFilter ff_vf_qcstats;
 extern const AVFilter ff_vf_qp;
 extern const AVFilter ff_vf_random;
 extern const AVFilter ff_vf_readeia608;
@@ -33,6 +33,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace_internal.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -542,11 +543,13 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
 {
     if (pts == AV_NOPTS_VALUE)
         return;
+    ff_filter_graph_lock_sink_links(link->graph);
     link->current_pts = pts;
     link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
     if (link->graph && link->age_index >= 0)
         ff_avfilter_graph_update_heap(link->graph, link);
+    ff_filter_graph_unlock_sink_links(link->graph);
 }
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
@@ -989,6 +992,7 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     int (*filter_frame)(AVFilterLink *, AVFrame *);
     AVFilterContext *dstctx = link->dst;
     AVFilterPad *dst = link->dstpad;
+    void *mem_ctx;
     int ret;
 
     if (!(filter_frame = dst->filter_frame))
@@ -1006,7 +1010,11 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     if (dstctx->is_disabled &&
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
+    mem_ctx = av_mem_accounting_set_context(dstctx);
+    FF_TRACE_BEGIN("filter_frame", dstctx->filter->name);
     ret = filter_frame(link, frame);
+    FF_TRACE_END("filter_frame", dstctx->filter->name);
+    av_mem_accounting_set_context(mem_ctx);
     link->frame_count_out++;
     return ret;
 
@@ -1361,8 +1369,15 @@ int ff_filter_activate(AVFilterContext *filter)
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
-    ret = filter->filter->activate ? filter->filter->activate(filter) :
-          ff_filter_activate_default(filter);
+    if (filter->filter->activate) {
+        void *mem_ctx = av_mem_accounting_set_context(filter);
+        FF_TRACE_BEGIN("activate", filter->filter->name);
+        ret = filter->filter->activate(filter);
+        FF_TRACE_END("activate", filter->filter->name);
+        av_mem_accounting_set_context(mem_ctx);
+    } else {
+        ret = ff_filter_activate_default(filter);
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
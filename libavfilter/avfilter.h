@@ -898,6 +898,37 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * Maximum number of threads used to run the independent branches of
+     * this graph, i.e. the sets of filters not connected to each other by
+     * any link, in parallel. Must be set before avfilter_graph_config().
+     *
+     * When it is different from 1 and the graph has several branches, frames
+     * pushed with AV_BUFFERSRC_FLAG_PUSH are processed in the background and
+     * av_buffersink_get_frame_flags() with AV_BUFFERSINK_FLAG_NO_REQUEST
+     * does not wait for them. All the other calls on a filter wait until its
+     * branch is idle. The frames output by each sink are the same as without
+     * threads. Zero means that the number of threads is determined
+     * automatically. The default is 1.
+     *
+     * Filters linked through a filter with several outputs, such as split,
+     * are in the same branch and are run by one thread at a time.
+     */
+    int nb_branch_threads;
+
+    /**
+     * A reference to a pool of threads allocated with
+     * avfilter_thread_pool_alloc(), which the slice threaded filters of this
+     * graph run on instead of on threads of their own. Several graphs may
+     * share a pool, their filters then take turns on it. nb_threads still
+     * limits the number of jobs of each filter.
+     *
+     * May be set by the caller immediately after allocating the graph and
+     * before adding any filters to it. The reference is then owned by the
+     * graph and unreferenced by avfilter_graph_free().
+     */
+    AVBufferRef *thread_pool;
+
     /**
      * Private fields
      *
@@ -987,6 +1018,18 @@ enum {
  */
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx);
 
+/**
+ * Allocate a pool of threads for running slice threaded filters, which may
+ * be shared by several filter graphs through AVFilterGraph.thread_pool.
+ *
+ * @param pool       a reference to the new pool is returned here
+ * @param nb_threads number of threads, 0 for automatic
+ * @return 0 on success, a negative AVERROR code on failure, in particular
+ *         AVERROR(ENOSYS) if libavfilter was built without threads or if
+ *         only one thread would be used
+ */
+int avfilter_thread_pool_alloc(AVBufferRef **pool, int nb_threads);
+
 /**
  * Free a graph, destroy its links, and set *graph to NULL.
  * If *graph is NULL, do nothing.
@@ -28,10 +28,12 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -53,6 +55,9 @@ static const AVOption filtergraph_options[] = {
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
+    { "branch_threads", "Maximum number of threads running independent branches", OFFSET(nb_branch_threads), AV_OPT_TYPE_INT,
+        { .i64 = 1 }, 0, INT_MAX, F|V|A, "branch_threads" },
+        {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "branch_threads"},
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
@@ -69,6 +74,12 @@ static const AVClass filtergraph_class = {
 };
 
 #if !HAVE_THREADS
+int ff_thread_pool_alloc(AVBufferRef **pool, int nb_threads)
+{
+    *pool = NULL;
+    return AVERROR(ENOSYS);
+}
+
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
 }
@@ -81,6 +92,13 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 }
 #endif
 
+int avfilter_thread_pool_alloc(AVBufferRef **pool, int nb_threads)
+{
+    if (nb_threads < 0)
+        return AVERROR(EINVAL);
+    return ff_thread_pool_alloc(pool, nb_threads);
+}
+
 AVFilterGraph *avfilter_graph_alloc(void)
 {
     AVFilterGraph *ret = av_mallocz(sizeof(*ret));
@@ -118,15 +136,20 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
     }
 }
 
+static void graph_branches_free(AVFilterGraph *graph);
+
 void avfilter_graph_free(AVFilterGraph **graph)
 {
     if (!*graph)
         return;
 
+    graph_branches_free(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    av_buffer_unref(&(*graph)->thread_pool);
 
     av_freep(&(*graph)->sink_links);
 
@@ -1153,6 +1176,328 @@ static int graph_config_pointers(AVFilterGraph *graph, void *log_ctx)
     return 0;
 }
 
+#if HAVE_THREADS
+typedef struct FilterBranch {
+    AVFilterContext **filters;
+    unsigned nb_filters;
+    int queued;             ///< processing requested and not finished yet
+    int ret;                ///< error of the last background processing
+} FilterBranch;
+
+typedef struct FilterBranches {
+    FilterBranch *branches;
+    unsigned nb_branches;
+
+    /* branches waiting for a worker, at most one entry per branch */
+    FilterBranch **queue;
+    unsigned queue_start;
+    unsigned nb_queued;
+
+    pthread_t *workers;
+    unsigned nb_workers;
+    int exit;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  idle_cond;
+    pthread_mutex_t sink_links_lock;
+} FilterBranches;
+
+static int run_once_branch(FilterBranch *b)
+{
+    AVFilterContext *filter = b->filters[0];
+    unsigned i;
+
+    for (i = 1; i < b->nb_filters; i++)
+        if (b->filters[i]->ready > filter->ready)
+            filter = b->filters[i];
+    if (!filter->ready)
+        return AVERROR(EAGAIN);
+    return ff_filter_activate(filter);
+}
+
+static void *branch_worker(void *arg)
+{
+    FilterBranches *s = arg;
+
+    pthread_mutex_lock(&s->lock);
+    while (1) {
+        FilterBranch *b;
+        int ret;
+
+        while (!s->exit && !s->nb_queued)
+            pthread_cond_wait(&s->work_cond, &s->lock);
+        if (s->exit)
+            break;
+        b = s->queue[s->queue_start];
+        s->queue_start = (s->queue_start + 1) % s->nb_branches;
+        s->nb_queued--;
+        pthread_mutex_unlock(&s->lock);
+
+        while ((ret = run_once_branch(b)) >= 0);
+
+        pthread_mutex_lock(&s->lock);
+        b->ret    = ret == AVERROR(EAGAIN) ? 0 : ret;
+        b->queued = 0;
+        pthread_cond_broadcast(&s->idle_cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+#endif
+
+static void graph_branches_free(AVFilterGraph *graph)
+{
+#if HAVE_THREADS
+    FilterBranches *s = graph->internal->branches;
+    unsigned i;
+
+    if (!s)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+    s->exit = 1;
+    pthread_cond_broadcast(&s->work_cond);
+    pthread_mutex_unlock(&s->lock);
+    for (i = 0; i < s->nb_workers; i++)
+        pthread_join(s->workers[i], NULL);
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->work_cond);
+    pthread_cond_destroy(&s->idle_cond);
+    pthread_mutex_destroy(&s->sink_links_lock);
+
+    for (i = 0; i < graph->nb_filters; i++)
+        graph->filters[i]->internal->branch = NULL;
+    for (i = 0; i < s->nb_branches; i++)
+        av_freep(&s->branches[i].filters);
+    av_freep(&s->branches);
+    av_freep(&s->queue);
+    av_freep(&s->workers);
+    av_freep(&graph->internal->branches);
+#endif
+}
+
+/**
+ * Split the graph into its connected components and start the threads
+ * running them, if requested and if there are several components.
+ */
+static int graph_config_branches(AVFilterGraph *graph, void *log_ctx)
+{
+#if HAVE_THREADS
+    FilterBranches *s;
+    AVFilterContext **stack;
+    unsigned *branch_of, nb_branches = 0, nb_threads, i, j, k;
+    int ret = 0;
+
+    graph_branches_free(graph);
+
+    if (graph->nb_branch_threads == 1 || graph->nb_filters < 2)
+        return 0;
+
+    branch_of = av_malloc_array(graph->nb_filters, sizeof(*branch_of));
+    stack     = av_malloc_array(graph->nb_filters, sizeof(*stack));
+    if (!branch_of || !stack) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < graph->nb_filters; i++)
+        branch_of[i] = UINT_MAX;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        unsigned sp = 0;
+
+        if (branch_of[i] != UINT_MAX)
+            continue;
+        branch_of[i] = nb_branches;
+        stack[sp++]  = graph->filters[i];
+        while (sp) {
+            AVFilterContext *f = stack[--sp];
+
+            for (j = 0; j < f->nb_inputs + f->nb_outputs; j++) {
+                AVFilterLink *l = j < f->nb_inputs ? f->inputs[j] :
+                                                     f->outputs[j - f->nb_inputs];
+                AVFilterContext *peer;
+
+                if (!l)
+                    continue;
+                peer = j < f->nb_inputs ? l->src : l->dst;
+                for (k = 0; k < graph->nb_filters && graph->filters[k] != peer; k++);
+                av_assert0(k < graph->nb_filters);
+                if (branch_of[k] == UINT_MAX) {
+                    branch_of[k] = nb_branches;
+                    stack[sp++]  = peer;
+                }
+            }
+        }
+        nb_branches++;
+    }
+
+    if (nb_branches < 2)
+        goto end;
+
+    nb_threads = graph->nb_branch_threads ? graph->nb_branch_threads :
+                                            av_cpu_count();
+    nb_threads = FFMIN(nb_threads, nb_branches);
+    if (nb_threads < 2)
+        goto end;
+
+    s = graph->internal->branches = av_mallocz(sizeof(*s));
+    if (!s) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->work_cond, NULL);
+    pthread_cond_init(&s->idle_cond, NULL);
+    pthread_mutex_init(&s->sink_links_lock, NULL);
+
+    s->branches = av_calloc(nb_branches, sizeof(*s->branches));
+    s->queue    = av_calloc(nb_branches, sizeof(*s->queue));
+    s->workers  = av_calloc(nb_threads,  sizeof(*s->workers));
+    if (!s->branches || !s->queue || !s->workers)
+        goto fail;
+    s->nb_branches = nb_branches;
+    for (i = 0; i < graph->nb_filters; i++)
+        s->branches[branch_of[i]].nb_filters++;
+    for (k = 0; k < nb_branches; k++) {
+        FilterBranch *b = &s->branches[k];
+
+        b->filters = av_malloc_array(b->nb_filters, sizeof(*b->filters));
+        if (!b->filters)
+            goto fail;
+        b->nb_filters = 0;
+    }
+    for (i = 0; i < graph->nb_filters; i++) {
+        FilterBranch *b = &s->branches[branch_of[i]];
+        b->filters[b->nb_filters++]        = graph->filters[i];
+        graph->filters[i]->internal->branch = b;
+    }
+
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&s->workers[i], NULL, branch_worker, s);
+        if (ret) {
+            ret = AVERROR(ret);
+            graph_branches_free(graph);
+            goto end;
+        }
+        s->nb_workers++;
+    }
+    av_log(log_ctx, AV_LOG_VERBOSE, "Running %u branches on %u threads\n",
+           nb_branches, nb_threads);
+
+end:
+    av_free(branch_of);
+    av_free(stack);
+    return ret;
+fail:
+    graph_branches_free(graph);
+    ret = AVERROR(ENOMEM);
+    goto end;
+#else
+    return 0;
+#endif
+}
+
+int ff_filter_branch_wait(AVFilterContext *ctx, int nonblock)
+{
+#if HAVE_THREADS
+    FilterBranch *b = ctx->internal->branch;
+    FilterBranches *s;
+    int ret;
+
+    if (!b)
+        return 0;
+    s = ctx->graph->internal->branches;
+    pthread_mutex_lock(&s->lock);
+    if (nonblock && b->queued) {
+        pthread_mutex_unlock(&s->lock);
+        return AVERROR(EAGAIN);
+    }
+    while (b->queued)
+        pthread_cond_wait(&s->idle_cond, &s->lock);
+    ret    = b->ret;
+    b->ret = 0;
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+#else
+    return 0;
+#endif
+}
+
+void ff_filter_graph_wait_branches(AVFilterGraph *graph)
+{
+#if HAVE_THREADS
+    FilterBranches *s = graph->internal->branches;
+    unsigned i;
+
+    if (!s)
+        return;
+    pthread_mutex_lock(&s->lock);
+    for (i = 0; i < s->nb_branches; i++)
+        while (s->branches[i].queued)
+            pthread_cond_wait(&s->idle_cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+#endif
+}
+
+int ff_filter_graph_push(AVFilterContext *ctx)
+{
+    int ret;
+
+#if HAVE_THREADS
+    FilterBranch *b = ctx->internal->branch;
+
+    if (b) {
+        FilterBranches *s = ctx->graph->internal->branches;
+
+        pthread_mutex_lock(&s->lock);
+        if (!b->queued) {
+            b->queued = 1;
+            s->queue[(s->queue_start + s->nb_queued++) % s->nb_branches] = b;
+            pthread_cond_signal(&s->work_cond);
+        }
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+#endif
+
+    while (1) {
+        ret = ff_filter_graph_run_once(ctx->graph);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+int ff_filter_graph_run_once_branch(AVFilterContext *ctx)
+{
+#if HAVE_THREADS
+    if (ctx->internal->branch)
+        return run_once_branch(ctx->internal->branch);
+#endif
+    return ff_filter_graph_run_once(ctx->graph);
+}
+
+void ff_filter_graph_lock_sink_links(AVFilterGraph *graph)
+{
+#if HAVE_THREADS
+    if (graph && graph->internal->branches)
+        pthread_mutex_lock(&graph->internal->branches->sink_links_lock);
+#endif
+}
+
+void ff_filter_graph_unlock_sink_links(AVFilterGraph *graph)
+{
+#if HAVE_THREADS
+    if (graph && graph->internal->branches)
+        pthread_mutex_unlock(&graph->internal->branches->sink_links_lock);
+#endif
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1167,6 +1512,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_config_branches(graphctx, log_ctx)))
+        return ret;
 
     return 0;
 }
@@ -1178,6 +1525,8 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     if (!graph)
         return r;
 
+    ff_filter_graph_wait_branches(graph);
+
     if ((flags & AVFILTER_CMD_FLAG_ONE) && !(flags & AVFILTER_CMD_FLAG_FAST)) {
         r = avfilter_graph_send_command(graph, target, cmd, arg, res, res_len, flags | AVFILTER_CMD_FLAG_FAST);
         if (r != AVERROR(ENOSYS))
@@ -1208,6 +1557,8 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
     if(!graph)
         return 0;
 
+    ff_filter_graph_wait_branches(graph);
+
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if(filter && (!strcmp(target, "all") || !strcmp(target, filter->name) || !strcmp(target, filter->filter->name))){
@@ -1287,8 +1638,14 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     int64_t frame_count;
     int r;
 
-    while (graph->sink_links_count) {
+    while (1) {
+        ff_filter_graph_lock_sink_links(graph);
+        if (!graph->sink_links_count) {
+            ff_filter_graph_unlock_sink_links(graph);
+            break;
+        }
         oldest = graph->sink_links[0];
+        ff_filter_graph_unlock_sink_links(graph);
         if (oldest->dst->filter->activate) {
             /* For now, buffersink is the only filter implementing activate. */
             r = av_buffersink_get_frame_flags(oldest->dst, NULL,
@@ -1304,13 +1661,16 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
                oldest->dst->name,
                oldest->dstpad->name);
         /* EOF: remove the link from the heap */
+        ff_filter_graph_lock_sink_links(graph);
         if (oldest->age_index < --graph->sink_links_count)
             heap_bubble_down(graph, graph->sink_links[graph->sink_links_count],
                              oldest->age_index);
         oldest->age_index = -1;
+        ff_filter_graph_unlock_sink_links(graph);
     }
     if (!graph->sink_links_count)
         return AVERROR_EOF;
+    ff_filter_graph_wait_branches(graph);
     av_assert1(!oldest->dst->filter->activate);
     av_assert1(oldest->age_index >= 0);
     frame_count = oldest->frame_count_out;
@@ -115,6 +115,10 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
     if (buf->peeked_frame)
         return return_or_keep_frame(buf, frame, buf->peeked_frame, flags);
 
+    ret = ff_filter_branch_wait(ctx, flags & AV_BUFFERSINK_FLAG_NO_REQUEST);
+    if (ret < 0)
+        return ret;
+
     while (1) {
         ret = samples ? ff_inlink_consume_samples(inlink, samples, samples, &cur_frame) :
                         ff_inlink_consume_frame(inlink, &cur_frame);
@@ -128,7 +132,7 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
         } else if ((flags & AV_BUFFERSINK_FLAG_NO_REQUEST)) {
             return AVERROR(EAGAIN);
         } else if (inlink->frame_wanted_out) {
-            ret = ff_filter_graph_run_once(ctx->graph);
+            ret = ff_filter_graph_run_once_branch(ctx);
             if (ret < 0)
                 return ret;
         } else {
@@ -148,6 +152,29 @@ int attribute_align_arg av_buffersink_get_samples(AVFilterContext *ctx,
     return get_frame_internal(ctx, frame, 0, nb_samples);
 }
 
+int attribute_align_arg av_buffersink_get_frames(AVFilterContext *ctx, AVFrame **frames,
+                                                 int nb_frames, int flags)
+{
+    int min_samples = ctx->inputs[0]->min_samples;
+    int i, ret;
+
+    if (nb_frames <= 0 || (flags & AV_BUFFERSINK_FLAG_PEEK))
+        return AVERROR(EINVAL);
+
+    ret = get_frame_internal(ctx, frames[0], flags, min_samples);
+    if (ret < 0)
+        return ret;
+
+    /* the status of the link stays set, so errors are returned again by
+     * the next call */
+    for (i = 1; i < nb_frames; i++)
+        if (get_frame_internal(ctx, frames[i], flags | AV_BUFFERSINK_FLAG_NO_REQUEST,
+                               min_samples) < 0)
+            break;
+
+    return i;
+}
+
 #if FF_API_BUFFERSINK_ALLOC
 AVBufferSinkParams *av_buffersink_params_alloc(void)
 {
@@ -198,6 +198,30 @@ int av_buffersink_get_frame(AVFilterContext *ctx, AVFrame *frame);
  */
 int av_buffersink_get_samples(AVFilterContext *ctx, AVFrame *frame, int nb_samples);
 
+/**
+ * Get several frames with filtered data from the sink.
+ *
+ * The first frame is obtained as with av_buffersink_get_frame_flags(),
+ * running the filter graph if needed and allowed by the flags. The
+ * following ones are only those already queued in the sink, the graph is
+ * not run again. When an error or the end of the stream is met after the
+ * first frame, the frames obtained before are returned, and the next call
+ * returns the error.
+ *
+ * @param ctx        pointer to a buffersink or abuffersink filter context.
+ * @param frames     array of nb_frames allocated frames that will be filled
+ *                   with data. The data must be freed using av_frame_unref()
+ *                   / av_frame_free()
+ * @param nb_frames  size of the array
+ * @param flags      a combination of AV_BUFFERSINK_FLAG_* flags, except
+ *                   AV_BUFFERSINK_FLAG_PEEK
+ *
+ * @return the number of frames returned, at least one, or a negative
+ *         AVERROR code with the same meaning as for av_buffersink_get_frame()
+ */
+int av_buffersink_get_frames(AVFilterContext *ctx, AVFrame **frames,
+                             int nb_frames, int flags);
+
 /**
  * @}
  */
@@ -148,36 +148,18 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *fr
     return av_buffersrc_add_frame_flags(ctx, frame, 0);
 }
 
-static int push_frame(AVFilterGraph *graph)
-{
-    int ret;
-
-    while (1) {
-        ret = ff_filter_graph_run_once(graph);
-        if (ret == AVERROR(EAGAIN))
-            break;
-        if (ret < 0)
-            return ret;
-    }
-    return 0;
-}
-
-int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+static int add_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSourceContext *s = ctx->priv;
     AVFrame *copy;
     int refcounted, ret;
 
-    if (frame && frame->channel_layout &&
+    if (frame->channel_layout &&
         av_get_channel_layout_nb_channels(frame->channel_layout) != frame->channels) {
         av_log(ctx, AV_LOG_ERROR, "Layout indicates a different number of channels than actually present\n");
         return AVERROR(EINVAL);
     }
 
-    s->nb_failed_requests = 0;
-
-    if (!frame)
-        return av_buffersrc_close(ctx, AV_NOPTS_VALUE, flags);
     if (s->eof)
         return AVERROR(EINVAL);
 
@@ -216,12 +198,28 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
         }
     }
 
-    ret = ff_filter_frame(ctx->outputs[0], copy);
+    return ff_filter_frame(ctx->outputs[0], copy);
+}
+
+int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+{
+    BufferSourceContext *s = ctx->priv;
+    int ret;
+
+    if ((ret = ff_filter_branch_wait(ctx, 0)) < 0)
+        return ret;
+
+    s->nb_failed_requests = 0;
+
+    if (!frame)
+        return av_buffersrc_close(ctx, AV_NOPTS_VALUE, flags);
+
+    ret = add_frame_internal(ctx, frame, flags);
     if (ret < 0)
         return ret;
 
     if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
-        ret = push_frame(ctx->graph);
+        ret = ff_filter_graph_push(ctx);
         if (ret < 0)
             return ret;
     }
@@ -229,13 +227,42 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     return 0;
 }
 
+int attribute_align_arg av_buffersrc_add_frames(AVFilterContext *ctx, AVFrame **frames,
+                                                int nb_frames, int flags)
+{
+    BufferSourceContext *s = ctx->priv;
+    int i, ret;
+
+    if ((ret = ff_filter_branch_wait(ctx, 0)) < 0)
+        return ret;
+
+    s->nb_failed_requests = 0;
+
+    for (i = 0; i < nb_frames; i++) {
+        ret = add_frame_internal(ctx, frames[i], flags);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (nb_frames && (flags & AV_BUFFERSRC_FLAG_PUSH)) {
+        ret = ff_filter_graph_push(ctx);
+        if (ret < 0)
+            return ret;
+    }
+
+    return nb_frames;
+}
+
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 {
     BufferSourceContext *s = ctx->priv;
+    int ret;
 
+    if ((ret = ff_filter_branch_wait(ctx, 0)) < 0)
+        return ret;
     s->eof = 1;
     ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
-    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph) : 0;
+    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? ff_filter_graph_push(ctx) : 0;
 }
 
 static av_cold int init_video(AVFilterContext *ctx)
@@ -263,6 +290,7 @@ static av_cold int init_video(AVFilterContext *ctx)
 
 unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
 {
+    ff_filter_branch_wait(buffer_src, 0);
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
@@ -193,6 +193,28 @@ av_warn_unused_result
 int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
                                  AVFrame *frame, int flags);
 
+/**
+ * Add several frames to the buffer source.
+ *
+ * This is equivalent to calling av_buffersrc_add_frame_flags() on each
+ * frame in turn, except that the caller only synchronizes with the filter
+ * graph once, and with AV_BUFFERSRC_FLAG_PUSH, the graph is only run once
+ * all the frames are queued.
+ *
+ * If this function returns an error, the frames before the failing one have
+ * been added, the failing frame and the following ones are not touched.
+ *
+ * @param buffer_src  pointer to a buffer source context
+ * @param frames      array of nb_frames frames, none of them NULL
+ * @param nb_frames   number of frames to add
+ * @param flags       a combination of AV_BUFFERSRC_FLAG_*
+ * @return            the number of frames added in case of success, a
+ *                    negative AVERROR code in case of failure
+ */
+av_warn_unused_result
+int av_buffersrc_add_frames(AVFilterContext *buffer_src, AVFrame **frames,
+                            int nb_frames, int flags);
+
 /**
  * Close the buffer source after EOF.
  *
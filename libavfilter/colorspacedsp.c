@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/intreadwrite.h"
+
 #include "colorspacedsp.h"
 
 /*
@@ -98,6 +100,37 @@ static void multiply3x3_c(int16_t *buf[3], ptrdiff_t stride,
     }
 }
 
+static void xyz12_to_rgb_c(int16_t *rgb[3], ptrdiff_t rgb_stride,
+                           const uint8_t *xyz, ptrdiff_t xyz_stride,
+                           int w, int h, const int16_t *lin_lut,
+                           const int16_t m[3][3][8])
+{
+    int y, x;
+    int16_t *r = rgb[0], *g = rgb[1], *b = rgb[2];
+
+    for (y = 0; y < h; y++) {
+        const uint16_t *src = (const uint16_t *) xyz;
+
+        for (x = 0; x < w; x++) {
+            int vx = lin_lut[AV_RN16(&src[3 * x + 0]) >> 4];
+            int vy = lin_lut[AV_RN16(&src[3 * x + 1]) >> 4];
+            int vz = lin_lut[AV_RN16(&src[3 * x + 2]) >> 4];
+
+            r[x] = av_clip_int16((m[0][0][0] * vx + m[0][1][0] * vy +
+                                  m[0][2][0] * vz + 2048) >> 12);
+            g[x] = av_clip_int16((m[1][0][0] * vx + m[1][1][0] * vy +
+                                  m[1][2][0] * vz + 2048) >> 12);
+            b[x] = av_clip_int16((m[2][0][0] * vx + m[2][1][0] * vy +
+                                  m[2][2][0] * vz + 2048) >> 12);
+        }
+
+        xyz += xyz_stride;
+        r   += rgb_stride;
+        g   += rgb_stride;
+        b   += rgb_stride;
+    }
+}
+
 void ff_colorspacedsp_init(ColorSpaceDSPContext *dsp)
 {
 #define init_yuv2rgb_fn(bit) \
@@ -141,6 +174,7 @@ void ff_colorspacedsp_init(ColorSpaceDSPContext *dsp)
     init_yuv2yuv_fns(12);
 
     dsp->multiply3x3 = multiply3x3_c;
+    dsp->xyz12_to_rgb = xyz12_to_rgb_c;
 
     if (ARCH_X86)
         ff_colorspacedsp_x86_init(dsp);
@@ -41,6 +41,10 @@ typedef void (*yuv2yuv_fn)(uint8_t *yuv_out[3], const ptrdiff_t yuv_out_stride[3
                            uint8_t *yuv_in[3], const ptrdiff_t yuv_in_stride[3],
                            int w, int h, const int16_t yuv2yuv_coeffs[3][3][8],
                            const int16_t yuv_offset[2][8]);
+typedef void (*xyz2rgb_fn)(int16_t *rgb[3], ptrdiff_t rgb_stride,
+                           const uint8_t *xyz, ptrdiff_t xyz_stride,
+                           int w, int h, const int16_t *lin_lut,
+                           const int16_t xyz2rgb_coeffs[3][3][8]);
 
 enum BitDepthIndex {
     BPP_8,
@@ -73,6 +77,12 @@ typedef struct ColorSpaceDSPContext {
      * (our internal data format) */
     void (*multiply3x3)(int16_t *data[3], ptrdiff_t stride,
                         int w, int h, const int16_t m[3][3][8]);
+
+    /* Convert packed, native-endian X'Y'Z' 12bpp data from a user-provided
+     * buffer into linear intermediate RGB data (15bpp, internal format).
+     * lin_lut maps the 12bit code values to linear XYZ, the coefficients are
+     * 12bit (so in the [-8.0,8.0] range). */
+    xyz2rgb_fn xyz12_to_rgb;
 } ColorSpaceDSPContext;
 
 void ff_colorspacedsp_init(ColorSpaceDSPContext *dsp);
@@ -44,6 +44,7 @@ typedef struct TFOptions{
     char *sess_config;
     uint8_t async;
     uint32_t nireq;
+    int batch_size;
 } TFOptions;
 
 typedef struct TFContext {
@@ -75,7 +76,8 @@ typedef struct TFInferRequest {
 
 typedef struct TFRequestItem {
     TFInferRequest *infer_request;
-    LastLevelTaskItem *lltask;
+    LastLevelTaskItem **lltasks;
+    uint32_t lltask_count;
     TF_Status *status;
     DNNAsyncExecModule exec_module;
 } TFRequestItem;
@@ -84,6 +86,7 @@ typedef struct TFRequestItem {
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption dnn_tensorflow_options[] = {
     { "sess_config", "config for SessionOptions", OFFSET(options.sess_config), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { "batch_size",  "batch size per request",    OFFSET(options.batch_size),  AV_OPT_TYPE_INT,    { .i64 = 1 },    1, 1000, FLAGS },
     DNN_BACKEND_COMMON_OPTIONS
     { NULL }
 };
@@ -158,7 +161,7 @@ static DNNReturnType tf_start_inference(void *args)
 {
     TFRequestItem *request = args;
     TFInferRequest *infer_request = request->infer_request;
-    LastLevelTaskItem *lltask = request->lltask;
+    LastLevelTaskItem *lltask = request->lltasks[0];
     TaskItem *task = lltask->task;
     TFModel *tf_model = task->model;
 
@@ -196,7 +199,9 @@ static inline void destroy_request_item(TFRequestItem **arg) {
     request = *arg;
     tf_free_request(request->infer_request);
     av_freep(&request->infer_request);
-    av_freep(&request->lltask);
+    for (uint32_t i = 0; i < request->lltask_count; i++)
+        av_freep(&request->lltasks[i]);
+    av_freep(&request->lltasks);
     TF_DeleteStatus(request->status);
     ff_dnn_async_module_cleanup(&request->exec_module);
     av_freep(arg);
@@ -255,11 +260,11 @@ static TF_Buffer *read_graph(const char *model_filename)
     return graph_buf;
 }
 
-static TF_Tensor *allocate_input_tensor(const DNNData *input)
+static TF_Tensor *allocate_input_tensor(const DNNData *input, int batch)
 {
     TF_DataType dt;
     size_t size;
-    int64_t input_dims[] = {1, input->height, input->width, input->channels};
+    int64_t input_dims[] = {batch, input->height, input->width, input->channels};
     switch (input->dt) {
     case DNN_FLOAT:
         dt = TF_FLOAT;
@@ -274,7 +279,7 @@ static TF_Tensor *allocate_input_tensor(const DNNData *input)
     }
 
     return TF_AllocateTensor(dt, input_dims, 4,
-                             input_dims[1] * input_dims[2] * input_dims[3] * size);
+                             input_dims[0] * input_dims[1] * input_dims[2] * input_dims[3] * size);
 }
 
 static DNNReturnType get_input_tf(void *model, DNNData *input, const char *input_name)
@@ -884,6 +889,10 @@ DNNModel *ff_dnn_load_model_tf(const char *model_filename, DNNFunctionType func_
         ctx->options.nireq = av_cpu_count() / 2 + 1;
     }
 
+    if (ctx->options.batch_size <= 0) {
+        ctx->options.batch_size = 1;
+    }
+
 #if !HAVE_PTHREAD_CANCEL
     if (ctx->options.async) {
         ctx->options.async = 0;
@@ -901,10 +910,16 @@ DNNModel *ff_dnn_load_model_tf(const char *model_filename, DNNFunctionType func_
         if (!item) {
             goto err;
         }
-        item->lltask = NULL;
+        item->lltasks = av_calloc(ctx->options.batch_size, sizeof(*item->lltasks));
+        if (!item->lltasks) {
+            av_freep(&item);
+            goto err;
+        }
+        item->lltask_count = 0;
         item->infer_request = tf_create_inference_request();
         if (!item->infer_request) {
             av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for TensorFlow inference request\n");
+            av_freep(&item->lltasks);
             av_freep(&item);
             goto err;
         }
@@ -948,11 +963,11 @@ static DNNReturnType fill_model_input_tf(TFModel *tf_model, TFRequestItem *reque
     TaskItem *task;
     TFInferRequest *infer_request;
     TFContext *ctx = &tf_model->ctx;
+    int batch = 0;
 
-    lltask = ff_queue_pop_front(tf_model->lltask_queue);
+    lltask = ff_queue_peek_front(tf_model->lltask_queue);
     av_assert0(lltask);
     task = lltask->task;
-    request->lltask = lltask;
 
     if (get_input_tf(tf_model, &input, task->input_name) != DNN_SUCCESS) {
         goto err;
@@ -962,6 +977,16 @@ static DNNReturnType fill_model_input_tf(TFModel *tf_model, TFRequestItem *reque
     input.height = task->in_frame->height;
     input.width = task->in_frame->width;
 
+    // frames of the same size are batched in one tensor, in queue order
+    while (batch < ctx->options.batch_size && ff_queue_size(tf_model->lltask_queue)) {
+        lltask = ff_queue_peek_front(tf_model->lltask_queue);
+        if (lltask->task->in_frame->width  != input.width ||
+            lltask->task->in_frame->height != input.height)
+            break;
+        request->lltasks[batch++] = ff_queue_pop_front(tf_model->lltask_queue);
+    }
+    request->lltask_count = batch;
+
     infer_request->tf_input = av_malloc(sizeof(TF_Output));
     if (!infer_request->tf_input) {
         av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for input tensor\n");
@@ -975,29 +1000,34 @@ static DNNReturnType fill_model_input_tf(TFModel *tf_model, TFRequestItem *reque
     }
     infer_request->tf_input->index = 0;
 
-    infer_request->input_tensor = allocate_input_tensor(&input);
+    infer_request->input_tensor = allocate_input_tensor(&input, batch);
     if (!infer_request->input_tensor){
         av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for input tensor\n");
         goto err;
     }
     input.data = (float *)TF_TensorData(infer_request->input_tensor);
 
-    switch (tf_model->model->func_type) {
-    case DFT_PROCESS_FRAME:
-        if (task->do_ioproc) {
-            if (tf_model->model->frame_pre_proc != NULL) {
-                tf_model->model->frame_pre_proc(task->in_frame, &input, tf_model->model->filter_ctx);
-            } else {
-                ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+    for (int i = 0; i < batch; i++) {
+        task = request->lltasks[i]->task;
+        switch (tf_model->model->func_type) {
+        case DFT_PROCESS_FRAME:
+            if (task->do_ioproc) {
+                if (tf_model->model->frame_pre_proc != NULL) {
+                    tf_model->model->frame_pre_proc(task->in_frame, &input, tf_model->model->filter_ctx);
+                } else {
+                    ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+                }
             }
+            break;
+        case DFT_ANALYTICS_DETECT:
+            ff_frame_to_dnn_detect(task->in_frame, &input, ctx);
+            break;
+        default:
+            avpriv_report_missing_feature(ctx, "model function type %d", tf_model->model->func_type);
+            break;
         }
-        break;
-    case DFT_ANALYTICS_DETECT:
-        ff_frame_to_dnn_detect(task->in_frame, &input, ctx);
-        break;
-    default:
-        avpriv_report_missing_feature(ctx, "model function type %d", tf_model->model->func_type);
-        break;
+        input.data = (uint8_t *)input.data
+                     + input.width * input.height * input.channels * TF_DataTypeSize(input.dt);
     }
 
     infer_request->tf_outputs = av_malloc_array(task->nb_output, sizeof(TF_Output));
@@ -1030,7 +1060,7 @@ err:
 
 static void infer_completion_callback(void *args) {
     TFRequestItem *request = args;
-    LastLevelTaskItem *lltask = request->lltask;
+    LastLevelTaskItem *lltask = request->lltasks[0];
     TaskItem *task = lltask->task;
     DNNData *outputs;
     TFInferRequest *infer_request = request->infer_request;
@@ -1050,33 +1080,46 @@ static void infer_completion_callback(void *args) {
         outputs[i].data = TF_TensorData(infer_request->output_tensors[i]);
         outputs[i].dt = TF_TensorType(infer_request->output_tensors[i]);
     }
-    switch (tf_model->model->func_type) {
-    case DFT_PROCESS_FRAME:
-        //it only support 1 output if it's frame in & frame out
-        if (task->do_ioproc) {
-            if (tf_model->model->frame_post_proc != NULL) {
-                tf_model->model->frame_post_proc(task->out_frame, outputs, tf_model->model->filter_ctx);
+    for (uint32_t b = 0; b < request->lltask_count; ++b) {
+        task = request->lltasks[b]->task;
+        switch (tf_model->model->func_type) {
+        case DFT_PROCESS_FRAME:
+            //it only support 1 output if it's frame in & frame out
+            if (task->do_ioproc) {
+                if (tf_model->model->frame_post_proc != NULL) {
+                    tf_model->model->frame_post_proc(task->out_frame, outputs, tf_model->model->filter_ctx);
+                } else {
+                    ff_proc_from_dnn_to_frame(task->out_frame, outputs, ctx);
+                }
             } else {
-                ff_proc_from_dnn_to_frame(task->out_frame, outputs, ctx);
+                task->out_frame->width = outputs[0].width;
+                task->out_frame->height = outputs[0].height;
+            }
+            break;
+        case DFT_ANALYTICS_DETECT:
+            if (!tf_model->model->detect_post_proc) {
+                av_log(ctx, AV_LOG_ERROR, "Detect filter needs provide post proc\n");
+                goto err;
             }
-        } else {
-            task->out_frame->width = outputs[0].width;
-            task->out_frame->height = outputs[0].height;
+            tf_model->model->detect_post_proc(task->in_frame, outputs, task->nb_output, tf_model->model->filter_ctx);
+            break;
+        default:
+            av_log(ctx, AV_LOG_ERROR, "Tensorflow backend does not support this kind of dnn filter now\n");
+            goto err;
         }
-        break;
-    case DFT_ANALYTICS_DETECT:
-        if (!tf_model->model->detect_post_proc) {
-            av_log(ctx, AV_LOG_ERROR, "Detect filter needs provide post proc\n");
-            return;
+        task->inference_done++;
+
+        // move on to the results of the next frame of the batch
+        for (uint32_t i = 0; i < task->nb_output; ++i) {
+            TF_Tensor *tensor = infer_request->output_tensors[i];
+            outputs[i].data = (uint8_t *)outputs[i].data +
+                              TF_TensorByteSize(tensor) / TF_Dim(tensor, 0);
         }
-        tf_model->model->detect_post_proc(task->in_frame, outputs, task->nb_output, tf_model->model->filter_ctx);
-        break;
-    default:
-        av_log(ctx, AV_LOG_ERROR, "Tensorflow backend does not support this kind of dnn filter now\n");
-        goto err;
     }
-    task->inference_done++;
 err:
+    for (uint32_t b = 0; b < request->lltask_count; ++b)
+        av_freep(&request->lltasks[b]);
+    request->lltask_count = 0;
     tf_free_request(infer_request);
     av_freep(&outputs);
 
@@ -1120,6 +1163,9 @@ static DNNReturnType execute_model_tf(TFRequestItem *request, Queue *lltask_queu
         return (task->inference_done == task->inference_todo) ? DNN_SUCCESS : DNN_ERROR;
     }
 err:
+    for (uint32_t i = 0; i < request->lltask_count; i++)
+        av_freep(&request->lltasks[i]);
+    request->lltask_count = 0;
     tf_free_request(request->infer_request);
     if (ff_safe_queue_push_back(tf_model->request_queue, request) < 0) {
         destroy_request_item(&request);
@@ -1160,6 +1206,29 @@ DNNReturnType ff_dnn_execute_model_tf(const DNNModel *model, DNNExecBaseParams *
         return DNN_ERROR;
     }
 
+    if (ctx->options.async) {
+        while (ff_queue_size(tf_model->lltask_queue) >= ctx->options.batch_size) {
+            DNNReturnType ret;
+
+            request = ff_safe_queue_pop_front(tf_model->request_queue);
+            if (!request) {
+                av_log(ctx, AV_LOG_ERROR, "unable to get infer request.\n");
+                return DNN_ERROR;
+            }
+
+            ret = execute_model_tf(request, tf_model->lltask_queue);
+            if (ret != DNN_SUCCESS) {
+                return ret;
+            }
+        }
+        return DNN_SUCCESS;
+    }
+
+    if (ctx->options.batch_size > 1) {
+        avpriv_report_missing_feature(ctx, "batch mode for sync execution");
+        return DNN_ERROR;
+    }
+
     request = ff_safe_queue_pop_front(tf_model->request_queue);
     if (!request) {
         av_log(ctx, AV_LOG_ERROR, "unable to get infer request.\n");
@@ -1186,22 +1255,32 @@ DNNReturnType ff_dnn_flush_tf(const DNNModel *model)
         return DNN_SUCCESS;
     }
 
-    request = ff_safe_queue_pop_front(tf_model->request_queue);
-    if (!request) {
-        av_log(ctx, AV_LOG_ERROR, "unable to get infer request.\n");
-        return DNN_ERROR;
-    }
+    // a batch stops at a change of frame size, so this may take several requests
+    while (ff_queue_size(tf_model->lltask_queue) != 0) {
+        request = ff_safe_queue_pop_front(tf_model->request_queue);
+        if (!request) {
+            av_log(ctx, AV_LOG_ERROR, "unable to get infer request.\n");
+            return DNN_ERROR;
+        }
 
-    ret = fill_model_input_tf(tf_model, request);
-    if (ret != DNN_SUCCESS) {
-        av_log(ctx, AV_LOG_ERROR, "Failed to fill model input.\n");
-        if (ff_safe_queue_push_back(tf_model->request_queue, request) < 0) {
-            destroy_request_item(&request);
+        ret = fill_model_input_tf(tf_model, request);
+        if (ret != DNN_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to fill model input.\n");
+            for (uint32_t i = 0; i < request->lltask_count; i++)
+                av_freep(&request->lltasks[i]);
+            request->lltask_count = 0;
+            if (ff_safe_queue_push_back(tf_model->request_queue, request) < 0) {
+                destroy_request_item(&request);
+            }
+            return ret;
         }
-        return ret;
+
+        ret = ff_dnn_start_inference_async(ctx, &request->exec_module);
+        if (ret != DNN_SUCCESS)
+            return ret;
     }
 
-    return ff_dnn_start_inference_async(ctx, &request->exec_module);
+    return DNN_SUCCESS;
 }
 
 void ff_dnn_free_model_tf(DNNModel **model)
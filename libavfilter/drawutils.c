@@ -79,6 +79,19 @@ int ff_fill_rgba_map(uint8_t *rgba_map, enum AVPixelFormat pix_fmt)
     return 0;
 }
 
+/* Blend w 16 bits samples with src using an 8 bits mask, the weight of each
+ * sample is mask[x] * alpha, alpha <= 0x101. */
+static void blend_row16(uint16_t *dst, const uint8_t *mask, int w,
+                        unsigned src, unsigned alpha)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        unsigned a = mask[x] * alpha;
+        dst[x] = ((0x10001 - a) * dst[x] + a * src) >> 16;
+    }
+}
+
 int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
@@ -590,6 +603,14 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
                     p += dst_linesize[plane];
                     m += mask_linesize << draw->vsub[plane];
                 }
+            } else if (!draw->hsub[plane] && !draw->vsub[plane] &&
+                       draw->pixelstep[plane] == 2 && l2depth == 3) {
+                for (y = 0; y < h_sub; y++) {
+                    blend_row16((uint16_t *)p, m + xm0, w_sub,
+                                color->comp[plane].u16[comp], alpha);
+                    p += dst_linesize[plane];
+                    m += mask_linesize;
+                }
             } else {
                 for (y = 0; y < h_sub; y++) {
                     blend_line_hv16(p, draw->pixelstep[plane],
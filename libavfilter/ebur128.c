@@ -337,29 +337,31 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
     }                                                                              \
     for (c = 0; c < st->channels; ++c) {                                           \
         int ci = st->d->channel_map[c] - 1;                                        \
+        const double *a = st->d->a, *b = st->d->b;                                 \
+        double a1 = a[1], a2 = a[2], a3 = a[3], a4 = a[4];                         \
+        double b0 = b[0], b1 = b[1], b2 = b[2], b3 = b[3], b4 = b[4];              \
+        double *v, v0, v1, v2, v3, v4;                                             \
         if (ci < 0) continue;                                                      \
         else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
+        /* keep the filter state and coefficients in locals, so that the           \
+         * stores to audio_data do not force reloading them */                     \
+        v = st->d->v[ci];                                                          \
+        v0 = v[0]; v1 = v[1]; v2 = v[2]; v3 = v[3]; v4 = v[4];                     \
         for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
+            v0 = (double) (srcs[c][src_index + i * stride] / scaling_factor)       \
+                         - a1 * v1 - a2 * v2 - a3 * v3 - a4 * v4;                  \
             audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
+                           b0 * v0 + b1 * v1 + b2 * v2 + b3 * v3 + b4 * v4;        \
+            v4 = v3;                                                               \
+            v3 = v2;                                                               \
+            v2 = v1;                                                               \
+            v1 = v0;                                                               \
         }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
+        v[0] = v0;                                                                 \
+        v[4] = fabs(v4) < DBL_MIN ? 0.0 : v4;                                      \
+        v[3] = fabs(v3) < DBL_MIN ? 0.0 : v3;                                      \
+        v[2] = fabs(v2) < DBL_MIN ? 0.0 : v2;                                      \
+        v[1] = fabs(v1) < DBL_MIN ? 0.0 : v1;                                      \
     }                                                                              \
 }
 EBUR128_FILTER(double, 1.0)
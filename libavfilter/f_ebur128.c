@@ -598,6 +598,99 @@ static int gate_update(struct integrator *integ, double power,
     return gate_hist_pos;
 }
 
+typedef struct ThreadData {
+    const double *samples;
+    int nb_samples;
+    int bin_id_400, bin_id_3000;
+} ThreadData;
+
+static int filter_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    EBUR128Context *ebur128 = ctx->priv;
+    const ThreadData *td = arg;
+    const int nb_channels = ebur128->nb_channels;
+    const int start = (nb_channels *  jobnr   ) / nb_jobs;
+    const int end   = (nb_channels * (jobnr+1)) / nb_jobs;
+    const double pre_b0 = ebur128->pre_b[0], pre_b1 = ebur128->pre_b[1], pre_b2 = ebur128->pre_b[2];
+    const double pre_a1 = ebur128->pre_a[1], pre_a2 = ebur128->pre_a[2];
+    const double rlb_b0 = ebur128->rlb_b[0], rlb_b1 = ebur128->rlb_b[1], rlb_b2 = ebur128->rlb_b[2];
+    const double rlb_a1 = ebur128->rlb_a[1], rlb_a2 = ebur128->rlb_a[2];
+    int ch, i;
+
+    for (ch = start; ch < end; ch++) {
+        const double *samples = td->samples + ch;
+        double *x = ebur128->x + ch * 3;
+        double *y = ebur128->y + ch * 3;
+        double *z = ebur128->z + ch * 3;
+        double *cache_400, *cache_3000, sum_400, sum_3000;
+        double x0, x1, x2, y0, y1, y2, z0, z1, z2;
+        int bin_id_400  = td->bin_id_400;
+        int bin_id_3000 = td->bin_id_3000;
+
+        if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
+            double peak = ebur128->sample_peaks[ch];
+
+            for (i = 0; i < td->nb_samples; i++)
+                peak = FFMAX(peak, fabs(samples[i * nb_channels]));
+            ebur128->sample_peaks[ch] = peak;
+        }
+
+        if (!ebur128->ch_weighting[ch]) {
+            x[0] = samples[(td->nb_samples - 1) * nb_channels];
+            continue;
+        }
+
+        cache_400  = ebur128->i400.cache[ch];
+        cache_3000 = ebur128->i3000.cache[ch];
+        sum_400    = ebur128->i400.sum[ch];
+        sum_3000   = ebur128->i3000.sum[ch];
+        x1 = x[1]; x2 = x[2];
+        y0 = y[0]; y1 = y[1]; y2 = y[2];
+        z0 = z[0]; z1 = z[1]; z2 = z[2];
+
+        for (i = 0; i < td->nb_samples; i++) {
+            double bin;
+
+            x0 = samples[i * nb_channels];
+
+            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
+            // TODO: merge both filters in one?
+            y2 = y1;                                            // apply pre-filter
+            y1 = y0;
+            y0 = x0*pre_b0 + x1*pre_b1 + x2*pre_b2 - y1*pre_a1 - y2*pre_a2;
+            x2 = x1;
+            x1 = x0;
+            z2 = z1;                                            // apply RLB-filter
+            z1 = z0;
+            z0 = y0*rlb_b0 + y1*rlb_b1 + y2*rlb_b2 - z1*rlb_a1 - z2*rlb_a2;
+
+            bin = z0 * z0;
+
+            /* add the new value, and limit the sum to the cache size (400ms or 3s)
+             * by removing the oldest one */
+            sum_400  = sum_400  + bin - cache_400 [bin_id_400];
+            sum_3000 = sum_3000 + bin - cache_3000[bin_id_3000];
+
+            /* override old cache entry with the new value */
+            cache_400 [bin_id_400 ] = bin;
+            cache_3000[bin_id_3000] = bin;
+
+            if (++bin_id_400 == ebur128->i400.cache_size)
+                bin_id_400 = 0;
+            if (++bin_id_3000 == ebur128->i3000.cache_size)
+                bin_id_3000 = 0;
+        }
+
+        ebur128->i400.sum[ch]  = sum_400;
+        ebur128->i3000.sum[ch] = sum_3000;
+        x[0] = x1; x[1] = x1; x[2] = x2;
+        y[0] = y0; y[1] = y1; y[2] = y2;
+        z[0] = z0; z[1] = z1; z[2] = z2;
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 {
     int i, ch, idx_insample;
@@ -628,70 +721,44 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
     }
 #endif
 
-    for (idx_insample = 0; idx_insample < nb_samples; idx_insample++) {
-        const int bin_id_400  = ebur128->i400.cache_pos;
-        const int bin_id_3000 = ebur128->i3000.cache_pos;
-
-#define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
-    ebur128->i##time.cache_pos++;                           \
-    if (ebur128->i##time.cache_pos ==                       \
-        ebur128->i##time.cache_size) {                      \
-        ebur128->i##time.filled    = 1;                     \
-        ebur128->i##time.cache_pos = 0;                     \
-    }                                                       \
-} while (0)
-
-        MOVE_TO_NEXT_CACHED_ENTRY(400);
-        MOVE_TO_NEXT_CACHED_ENTRY(3000);
-
-        for (ch = 0; ch < nb_channels; ch++) {
-            double bin;
-
-            if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS)
-                ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch], fabs(*samples));
-
-            ebur128->x[ch * 3] = *samples++; // set X[i]
+    for (idx_insample = 0; idx_insample < nb_samples;) {
+        /* Filter all the samples up to the next 100ms boundary at once, one
+         * channel after another (so the filter state stays in registers). */
+        const int nb_block = FFMIN(nb_samples - idx_insample,
+                                   FFMAX(1, inlink->sample_rate / 10 - ebur128->sample_count));
+        ThreadData td = {
+            .samples     = samples + idx_insample * nb_channels,
+            .nb_samples  = nb_block,
+            .bin_id_400  = ebur128->i400.cache_pos,
+            .bin_id_3000 = ebur128->i3000.cache_pos,
+        };
 
-            if (!ebur128->ch_weighting[ch])
-                continue;
+        ff_filter_execute(ctx, filter_channels, &td, NULL,
+                          FFMIN(nb_channels, ff_filter_get_nb_threads(ctx)));
 
-            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
-#define FILTER(Y, X, NUM, DEN) do {                                             \
-            double *dst = ebur128->Y + ch*3;                                    \
-            double *src = ebur128->X + ch*3;                                    \
-            dst[2] = dst[1];                                                    \
-            dst[1] = dst[0];                                                    \
-            dst[0] = src[0]*NUM[0] + src[1]*NUM[1] + src[2]*NUM[2]              \
-                                   - dst[1]*DEN[1] - dst[2]*DEN[2];             \
+#define MOVE_CACHE_POS(time) do {                                           \
+    ebur128->i##time.cache_pos += nb_block;                                 \
+    if (ebur128->i##time.cache_pos >= ebur128->i##time.cache_size) {        \
+        ebur128->i##time.filled     = 1;                                    \
+        ebur128->i##time.cache_pos -= ebur128->i##time.cache_size;          \
+    }                                                                       \
 } while (0)
 
-            // TODO: merge both filters in one?
-            FILTER(y, x, ebur128->pre_b, ebur128->pre_a);  // apply pre-filter
-            ebur128->x[ch * 3 + 2] = ebur128->x[ch * 3 + 1];
-            ebur128->x[ch * 3 + 1] = ebur128->x[ch * 3    ];
-            FILTER(z, y, ebur128->rlb_b, ebur128->rlb_a);  // apply RLB-filter
-
-            bin = ebur128->z[ch * 3] * ebur128->z[ch * 3];
+        MOVE_CACHE_POS(400);
+        MOVE_CACHE_POS(3000);
 
-            /* add the new value, and limit the sum to the cache size (400ms or 3s)
-             * by removing the oldest one */
-            ebur128->i400.sum [ch] = ebur128->i400.sum [ch] + bin - ebur128->i400.cache [ch][bin_id_400];
-            ebur128->i3000.sum[ch] = ebur128->i3000.sum[ch] + bin - ebur128->i3000.cache[ch][bin_id_3000];
-
-            /* override old cache entry with the new value */
-            ebur128->i400.cache [ch][bin_id_400 ] = bin;
-            ebur128->i3000.cache[ch][bin_id_3000] = bin;
-        }
+        idx_insample += nb_block;
+        ebur128->sample_count += nb_block;
 
         /* For integrated loudness, gating blocks are 400ms long with 75%
          * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
          * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == inlink->sample_rate / 10) {
+        if (ebur128->sample_count == inlink->sample_rate / 10) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
             const int64_t pts = insamples->pts +
-                av_rescale_q(idx_insample, (AVRational){ 1, inlink->sample_rate },
+                av_rescale_q(idx_insample - 1, (AVRational){ 1, inlink->sample_rate },
                              outlink->time_base);
 
             ebur128->sample_count = 0;
@@ -1029,5 +1096,5 @@ const AVFilter ff_af_ebur128 = {
     .outputs       = NULL,
     FILTER_QUERY_FUNC(query_formats),
     .priv_class    = &ebur128_class,
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
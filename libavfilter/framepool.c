@@ -26,6 +26,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
 
 struct FFFramePool {
 
@@ -46,8 +47,15 @@ struct FFFramePool {
     int linesize[4];
     AVBufferPool *pools[4];
 
+    /* shared pools */
+    AVBufferRef* (*alloc)(size_t size);
+    FFFramePool **shared_list;
+    FFFramePool *next;
+    int nb_users;
 };
 
+static AVMutex shared_lock = AV_MUTEX_INITIALIZER;
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
                                       int width,
                                       int height,
@@ -66,6 +74,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
         return NULL;
 
     pool->type = AVMEDIA_TYPE_VIDEO;
+    pool->alloc = alloc;
     pool->width = width;
     pool->height = height;
     pool->format = format;
@@ -279,6 +288,33 @@ fail:
     return NULL;
 }
 
+FFFramePool *ff_frame_pool_video_get_shared(FFFramePool **list,
+                                            AVBufferRef* (*alloc)(size_t size),
+                                            int width,
+                                            int height,
+                                            enum AVPixelFormat format,
+                                            int align)
+{
+    FFFramePool *pool;
+
+    ff_mutex_lock(&shared_lock);
+    for (pool = *list; pool; pool = pool->next)
+        if (pool->alloc == alloc && pool->width == width && pool->height == height &&
+            pool->format == format && pool->align == align)
+            break;
+    if (pool) {
+        pool->nb_users++;
+    } else if ((pool = ff_frame_pool_video_init(alloc, width, height, format, align))) {
+        pool->shared_list = list;
+        pool->next        = *list;
+        pool->nb_users    = 1;
+        *list             = pool;
+    }
+    ff_mutex_unlock(&shared_lock);
+
+    return pool;
+}
+
 void ff_frame_pool_uninit(FFFramePool **pool)
 {
     int i;
@@ -286,6 +322,20 @@ void ff_frame_pool_uninit(FFFramePool **pool)
     if (!pool || !*pool)
         return;
 
+    if ((*pool)->shared_list) {
+        FFFramePool **p;
+
+        ff_mutex_lock(&shared_lock);
+        if (--(*pool)->nb_users) {
+            ff_mutex_unlock(&shared_lock);
+            *pool = NULL;
+            return;
+        }
+        for (p = (*pool)->shared_list; *p != *pool; p = &(*p)->next);
+        *p = (*pool)->next;
+        ff_mutex_unlock(&shared_lock);
+    }
+
     for (i = 0; i < 4; i++) {
         av_buffer_pool_uninit(&(*pool)->pools[i]);
     }
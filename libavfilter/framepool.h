@@ -50,6 +50,23 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
                                       enum AVPixelFormat format,
                                       int align);
 
+/**
+ * Get a video frame pool shared with the other users of the same list
+ * asking for the same parameters, e.g. the links of a filter graph with the
+ * same geometry, so that the buffers freed at the end of a filter chain are
+ * reused at its beginning. The pool is released with ff_frame_pool_uninit().
+ *
+ * @param list list of the shared pools, initially NULL; it must not be
+ *             freed before all its pools are released
+ * @return video frame pool on success, NULL on error.
+ */
+FFFramePool *ff_frame_pool_video_get_shared(FFFramePool **list,
+                                            AVBufferRef* (*alloc)(size_t size),
+                                            int width,
+                                            int height,
+                                            enum AVPixelFormat format,
+                                            int align);
+
 /**
  * Allocate and initialize an audio frame pool.
  *
@@ -69,8 +86,9 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
                                       int align);
 
 /**
- * Deallocate the frame pool. It is safe to call this function while
- * some of the allocated frame are still in use.
+ * Deallocate the frame pool, or release it if it is shared and has other
+ * users. It is safe to call this function while some of the allocated
+ * frame are still in use.
  *
  * @param pool pointer to the frame pool to be freed. It will be set to NULL.
  */
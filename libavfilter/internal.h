@@ -131,13 +131,17 @@ struct AVFilterPad {
 };
 
 struct AVFilterGraphInternal {
-    void *thread;
+    AVBufferRef *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    struct FilterBranches *branches;
+    /* video frame pools shared by the links */
+    struct FFFramePool *frame_pools;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    struct FilterBranch *branch;
 };
 
 static av_always_inline int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -375,6 +379,40 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 int ff_filter_graph_run_once(AVFilterGraph *graph);
 
+/**
+ * Run one round of processing on the branch of the graph containing ctx,
+ * or on the whole graph if its branches do not run in parallel.
+ * Must only be called when the branch is idle.
+ */
+int ff_filter_graph_run_once_branch(AVFilterContext *ctx);
+
+/**
+ * Process the filters of the branch containing ctx until none of them is
+ * ready. If the branches of the graph run in parallel, this is done in the
+ * background and errors are returned by the next ff_filter_branch_wait().
+ */
+int ff_filter_graph_push(AVFilterContext *ctx);
+
+/**
+ * Wait until the branch of the graph containing ctx is idle.
+ *
+ * @param nonblock  return AVERROR(EAGAIN) instead of waiting
+ * @return 0 or the error that stopped the last background processing
+ */
+int ff_filter_branch_wait(AVFilterContext *ctx, int nonblock);
+
+/**
+ * Wait until all the branches of the graph are idle.
+ */
+void ff_filter_graph_wait_branches(AVFilterGraph *graph);
+
+/**
+ * Lock and unlock the heap of sink links against the branches running in
+ * parallel. No-op if graph is NULL or its branches do not run in parallel.
+ */
+void ff_filter_graph_lock_sink_links(AVFilterGraph *graph);
+void ff_filter_graph_unlock_sink_links(AVFilterGraph *graph);
+
 /**
  * Get number of threads for current filter instance.
  * This number is always same or less than graph->nb_threads.
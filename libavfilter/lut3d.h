@@ -21,6 +21,7 @@
 #ifndef AVFILTER_LUT3D_H
 #define AVFILTER_LUT3D_H
 
+#include "libavutil/buffer.h"
 #include "libavutil/pixdesc.h"
 #include "framesync.h"
 #include "avfilter.h"
@@ -63,6 +64,8 @@ typedef struct LUT3DContext {
     int step;
     avfilter_action_func *interp;
     Lut3DPreLut prelut;
+    AVBufferRef *lut_buf;       ///< set if lut is shared through the file cache
+    AVBufferRef *prelut_buf[3];
 #if CONFIG_HALDCLUT_FILTER
     uint8_t clut_rgba_map[4];
     int clut_step;
@@ -78,6 +81,13 @@ typedef struct ThreadData {
     AVFrame *in, *out;
 } ThreadData;
 
+/**
+ * Load the LUT set by the file option, or an identity LUT, into the
+ * LUT3DContext at the start of ctx->priv. Also used by lut3d_cuda.
+ */
+int ff_lut3d_init(AVFilterContext *ctx);
+void ff_lut3d_uninit(AVFilterContext *ctx);
+
 void ff_lut3d_init_x86(LUT3DContext *s, const AVPixFmtDescriptor *desc);
 
 #endif /* AVFILTER_LUT3D_H */
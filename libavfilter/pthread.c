@@ -23,19 +23,24 @@
 
 #include "config.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/trace_internal.h"
 
 #include "avfilter.h"
 #include "internal.h"
 #include "thread.h"
 
 typedef struct ThreadContext {
-    AVFilterGraph *graph;
     AVSliceThread *thread;
+    int nb_threads;
     avfilter_action_func *func;
+    /* the independent branches of the graph, as well as the other graphs
+     * sharing the pool, may execute concurrently */
+    pthread_mutex_t execute_lock;
 
     /* per-execute parameters */
     AVFilterContext *ctx;
@@ -46,42 +51,71 @@ typedef struct ThreadContext {
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
     ThreadContext *c = priv;
-    int ret = c->func(c->ctx, c->arg, jobnr, nb_jobs);
+    int ret;
+
+    FF_TRACE_BEGIN("slice_job", c->ctx->filter->name);
+    ret = c->func(c->ctx, c->arg, jobnr, nb_jobs);
+    FF_TRACE_END("slice_job", c->ctx->filter->name);
     if (c->rets)
         c->rets[jobnr] = ret;
 }
 
-static void slice_thread_uninit(ThreadContext *c)
+static void thread_pool_free(void *opaque, uint8_t *data)
 {
+    ThreadContext *c = (ThreadContext *)data;
+
     avpriv_slicethread_free(&c->thread);
+    pthread_mutex_destroy(&c->execute_lock);
+    av_free(c);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
                           void *arg, int *ret, int nb_jobs)
 {
-    ThreadContext *c = ctx->graph->internal->thread;
+    ThreadContext *c = (ThreadContext *)ctx->graph->internal->thread->data;
 
     if (nb_jobs <= 0)
         return 0;
+    pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+int ff_thread_pool_alloc(AVBufferRef **pool, int nb_threads)
 {
+    ThreadContext *c = av_mallocz(sizeof(*c));
+
+    *pool = NULL;
+    if (!c)
+        return AVERROR(ENOMEM);
+
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
-    return FFMAX(nb_threads, 1);
+        av_free(c);
+        return nb_threads < 0 ? nb_threads : AVERROR(ENOSYS);
+    }
+    pthread_mutex_init(&c->execute_lock, NULL);
+    c->nb_threads = nb_threads;
+
+    *pool = av_buffer_create((uint8_t *)c, sizeof(*c), thread_pool_free, NULL, 0);
+    if (!*pool) {
+        thread_pool_free(NULL, (uint8_t *)c);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
 }
 
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
+    ThreadContext *c;
     int ret;
 
     if (graph->nb_threads == 1) {
@@ -89,18 +123,22 @@ int ff_graph_thread_init(AVFilterGraph *graph)
         return 0;
     }
 
-    graph->internal->thread = av_mallocz(sizeof(ThreadContext));
-    if (!graph->internal->thread)
-        return AVERROR(ENOMEM);
-
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
-    if (ret <= 1) {
-        av_freep(&graph->internal->thread);
-        graph->thread_type = 0;
-        graph->nb_threads  = 1;
-        return (ret < 0) ? ret : 0;
+    if (graph->thread_pool) {
+        graph->internal->thread = av_buffer_ref(graph->thread_pool);
+        if (!graph->internal->thread)
+            return AVERROR(ENOMEM);
+    } else {
+        ret = ff_thread_pool_alloc(&graph->internal->thread, graph->nb_threads);
+        if (ret < 0) {
+            graph->thread_type = 0;
+            graph->nb_threads  = 1;
+            return ret == AVERROR(ENOSYS) ? 0 : ret;
+        }
     }
-    graph->nb_threads = ret;
+
+    c = (ThreadContext *)graph->internal->thread->data;
+    graph->nb_threads = graph->nb_threads > 0 ? FFMIN(graph->nb_threads, c->nb_threads) :
+                                                c->nb_threads;
 
     graph->internal->thread_execute = thread_execute;
 
@@ -109,7 +147,5 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
-    if (graph->internal->thread)
-        slice_thread_uninit(graph->internal->thread);
-    av_freep(&graph->internal->thread);
+    av_buffer_unref(&graph->internal->thread);
 }
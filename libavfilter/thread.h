@@ -21,6 +21,14 @@
 
 #include "avfilter.h"
 
+/**
+ * Allocate a reference counted pool of slice threads.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if only one thread would be used,
+ *         another negative AVERROR code on failure
+ */
+int ff_thread_pool_alloc(AVBufferRef **pool, int nb_threads);
+
 int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
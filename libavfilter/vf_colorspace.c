@@ -130,6 +130,7 @@ typedef struct ColorSpaceContext {
     enum AVColorTransferCharacteristic in_trc, out_trc, user_trc, user_itrc;
     enum AVColorPrimaries in_prm, out_prm, user_prm, user_iprm;
     enum AVPixelFormat in_format, user_format;
+    int in_xyz;
     int fast_mode;
     enum DitherMode dither;
     enum WhitepointAdaptation wp_adapt;
@@ -145,7 +146,8 @@ typedef struct ColorSpaceContext {
 
     const struct TransferCharacteristics *in_txchr, *out_txchr;
     int rgb2rgb_passthrough;
-    int16_t *lin_lut, *delin_lut;
+    int16_t *lin_lut, *delin_lut, *xyz_lin_lut;
+    DECLARE_ALIGNED(16, int16_t, xyz2rgb_coeffs)[3][3][8];
 
     const struct LumaCoefficients *in_lumacoef, *out_lumacoef;
     int yuv2yuv_passthrough, yuv2yuv_fastmode;
@@ -187,6 +189,14 @@ static const struct TransferCharacteristics transfer_characteristics[AVCOL_TRC_N
     [AVCOL_TRC_BT2020_12] = { 1.0993, 0.0181, 0.45, 4.5 },
 };
 
+/*
+ * X'Y'Z' as used in digital cinema (SMPTE ST 428-1): a pure 2.6 gamma, with
+ * the 48 cd/m^2 reference white encoded at 48/52.37 of full scale.
+ */
+static const struct TransferCharacteristics xyz_transfer_characteristics =
+    { 1.0, 0.0, 1.0 / 2.6, 0.0 };
+#define XYZ_NORM (52.37 / 48.0)
+
 static const struct TransferCharacteristics *
     get_transfer_characteristics(enum AVColorTransferCharacteristic trc)
 {
@@ -244,10 +254,11 @@ static int fill_gamma_table(ColorSpaceContext *s)
     double out_alpha = s->out_txchr->alpha, out_beta = s->out_txchr->beta;
     double out_gamma = s->out_txchr->gamma, out_delta = s->out_txchr->delta;
 
-    s->lin_lut = av_malloc(sizeof(*s->lin_lut) * 32768 * 2);
+    s->lin_lut = av_malloc(sizeof(*s->lin_lut) * (32768 * 2 + (s->in_xyz ? 4096 : 0)));
     if (!s->lin_lut)
         return AVERROR(ENOMEM);
     s->delin_lut = &s->lin_lut[32768];
+    s->xyz_lin_lut = s->in_xyz ? &s->lin_lut[32768 * 2] : NULL;
     for (n = 0; n < 32768; n++) {
         double v = (n - 2048.0) / 28672.0, d, l;
 
@@ -272,6 +283,13 @@ static int fill_gamma_table(ColorSpaceContext *s)
         s->lin_lut[n] = av_clip_int16(lrint(l * 28672.0));
     }
 
+    // linearize 12bit X'Y'Z' code values straight from the input
+    for (n = 0; s->xyz_lin_lut && n < 4096; n++) {
+        double l = pow(n / 4095.0, in_igamma) * XYZ_NORM;
+
+        s->xyz_lin_lut[n] = av_clip_int16(lrint(l * 28672.0));
+    }
+
     return 0;
 }
 
@@ -350,8 +368,10 @@ static int convert(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
     int w = td->in->width, h = h2 - h1;
 
     in_data[0]  = td->in->data[0]  + td->in_linesize[0]  *  h1;
-    in_data[1]  = td->in->data[1]  + td->in_linesize[1]  * (h1 >> td->in_ss_h);
-    in_data[2]  = td->in->data[2]  + td->in_linesize[2]  * (h1 >> td->in_ss_h);
+    if (!s->in_xyz) {
+        in_data[1] = td->in->data[1] + td->in_linesize[1] * (h1 >> td->in_ss_h);
+        in_data[2] = td->in->data[2] + td->in_linesize[2] * (h1 >> td->in_ss_h);
+    }
     out_data[0] = td->out->data[0] + td->out_linesize[0] *  h1;
     out_data[1] = td->out->data[1] + td->out_linesize[1] * (h1 >> td->out_ss_h);
     out_data[2] = td->out->data[2] + td->out_linesize[2] * (h1 >> td->out_ss_h);
@@ -388,14 +408,23 @@ static int convert(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
          *   read chroma pixels at luma resolution. If you want some more fancy
          *   filter, you can use swscale to convert to yuv444p.
          * - all coefficients are 14bit (so in the [-2.0,2.0] range).
+         * - X'Y'Z' input is linearized and converted to the output primaries
+         *   in a single pass (xyz12_to_rgb), directly into linear RGB. The
+         *   12bit matrix leaves room for the large XYZ-to-RGB coefficients.
          */
-        s->yuv2rgb(rgb, s->rgb_stride, in_data, td->in_linesize, w, h,
-                   s->yuv2rgb_coeffs, s->yuv_offset[0]);
-        if (!s->rgb2rgb_passthrough) {
-            apply_lut(rgb, s->rgb_stride, w, h, s->lin_lut);
-            if (!s->lrgb2lrgb_passthrough)
-                s->dsp.multiply3x3(rgb, s->rgb_stride, w, h, s->lrgb2lrgb_coeffs);
+        if (s->in_xyz) {
+            s->dsp.xyz12_to_rgb(rgb, s->rgb_stride, in_data[0], td->in_linesize[0],
+                                w, h, s->xyz_lin_lut, s->xyz2rgb_coeffs);
             apply_lut(rgb, s->rgb_stride, w, h, s->delin_lut);
+        } else {
+            s->yuv2rgb(rgb, s->rgb_stride, in_data, td->in_linesize, w, h,
+                       s->yuv2rgb_coeffs, s->yuv_offset[0]);
+            if (!s->rgb2rgb_passthrough) {
+                apply_lut(rgb, s->rgb_stride, w, h, s->lin_lut);
+                if (!s->lrgb2lrgb_passthrough)
+                    s->dsp.multiply3x3(rgb, s->rgb_stride, w, h, s->lrgb2lrgb_coeffs);
+                apply_lut(rgb, s->rgb_stride, w, h, s->delin_lut);
+            }
         }
         if (s->dither == DITHER_FSB) {
             s->rgb2yuv_fsb(out_data, td->out_linesize, rgb, s->rgb_stride, w, h,
@@ -456,7 +485,8 @@ static int create_filtergraph(AVFilterContext *ctx,
      supported_depth((d)->comp[0].depth) && \
      supported_subsampling((d)->log2_chroma_w, (d)->log2_chroma_h))
 
-    if (!supported_format(in_desc)) {
+    s->in_xyz = in->format == AV_PIX_FMT_XYZ12;
+    if (!s->in_xyz && !supported_format(in_desc)) {
         av_log(ctx, AV_LOG_ERROR,
                "Unsupported input format %d (%s) or bitdepth (%d)\n",
                in->format, av_get_pix_fmt_name(in->format),
@@ -486,7 +516,10 @@ static int create_filtergraph(AVFilterContext *ctx,
             s->in_prm = default_prm[FFMIN(s->user_iall, CS_NB)];
         if (s->user_iprm != AVCOL_PRI_UNSPECIFIED)
             s->in_prm = s->user_iprm;
-        s->in_primaries = get_color_primaries(s->in_prm);
+        // X'Y'Z' has no RGB primaries, decoding to the output primaries
+        // happens directly from absolute (unadapted) XYZ
+        s->in_primaries = s->in_xyz ? &color_primaries[AVCOL_PRI_SMPTE428] :
+                                      get_color_primaries(s->in_prm);
         if (!s->in_primaries) {
             av_log(ctx, AV_LOG_ERROR,
                    "Unsupported input primaries %d (%s)\n",
@@ -510,9 +543,26 @@ static int create_filtergraph(AVFilterContext *ctx,
             }
             return AVERROR(EINVAL);
         }
-        s->lrgb2lrgb_passthrough = !memcmp(s->in_primaries, s->out_primaries,
+        s->lrgb2lrgb_passthrough = !s->in_xyz &&
+                                   !memcmp(s->in_primaries, s->out_primaries,
                                            sizeof(*s->in_primaries));
-        if (!s->lrgb2lrgb_passthrough) {
+        if (s->in_xyz) {
+            double rgb2xyz[3][3], xyz2rgb[3][3];
+            const struct WhitepointCoefficients *wp_out;
+
+            // rgb2xyz maps white to Y = yw, scale it so that white is Y = 1.0
+            wp_out = &whitepoint_coefficients[s->out_primaries->wp];
+            ff_fill_rgb2xyz_table(&s->out_primaries->coeff, wp_out, rgb2xyz);
+            ff_matrix_invert_3x3(rgb2xyz, xyz2rgb);
+            for (m = 0; m < 3; m++)
+                for (n = 0; n < 3; n++) {
+                    s->xyz2rgb_coeffs[m][n][0] = lrint(4096.0 * wp_out->yw * xyz2rgb[m][n]);
+                    for (o = 1; o < 8; o++)
+                        s->xyz2rgb_coeffs[m][n][o] = s->xyz2rgb_coeffs[m][n][0];
+                }
+
+            emms = 1;
+        } else if (!s->lrgb2lrgb_passthrough) {
             double rgb2xyz[3][3], xyz2rgb[3][3], rgb2rgb[3][3];
             const struct WhitepointCoefficients *wp_out, *wp_in;
 
@@ -550,7 +600,8 @@ static int create_filtergraph(AVFilterContext *ctx,
             s->in_trc = default_trc[FFMIN(s->user_iall, CS_NB)];
         if (s->user_itrc != AVCOL_TRC_UNSPECIFIED)
             s->in_trc = s->user_itrc;
-        s->in_txchr = get_transfer_characteristics(s->in_trc);
+        s->in_txchr = s->in_xyz ? &xyz_transfer_characteristics :
+                                  get_transfer_characteristics(s->in_trc);
         if (!s->in_txchr) {
             av_log(ctx, AV_LOG_ERROR,
                    "Unsupported input transfer characteristics %d (%s)\n",
@@ -581,8 +632,8 @@ static int create_filtergraph(AVFilterContext *ctx,
         }
     }
 
-    s->rgb2rgb_passthrough = s->fast_mode || (s->lrgb2lrgb_passthrough &&
-                             !memcmp(s->in_txchr, s->out_txchr, sizeof(*s->in_txchr)));
+    s->rgb2rgb_passthrough = !s->in_xyz && (s->fast_mode || (s->lrgb2lrgb_passthrough &&
+                             !memcmp(s->in_txchr, s->out_txchr, sizeof(*s->in_txchr))));
     if (!s->rgb2rgb_passthrough && !s->lin_lut) {
         res = fill_gamma_table(s);
         if (res < 0)
@@ -590,7 +641,7 @@ static int create_filtergraph(AVFilterContext *ctx,
         emms = 1;
     }
 
-    if (!s->in_lumacoef) {
+    if (!s->in_lumacoef && !s->in_xyz) {
         s->in_csp = in->colorspace;
         if (s->user_iall != CS_UNSPECIFIED)
             s->in_csp = default_csp[FFMIN(s->user_iall, CS_NB)];
@@ -766,10 +817,12 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     AVFilterContext *ctx = link->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     ColorSpaceContext *s = ctx->priv;
-    // FIXME if yuv2yuv_passthrough, don't get a new buffer but use the
-    // input one if it is writable *OR* the actual literal values of in_*
-    // and out_* are identical (not just their respective properties)
-    AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    // FIXME if yuv2yuv_passthrough, also use the input buffer if the actual
+    // literal values of in_* and out_* are identical (not just their
+    // respective properties)
+    // each slice is converted from the input before it is written, so the
+    // input buffer is reused when the format does not change
+    AVFrame *out = ff_get_video_buffer_inplace(outlink, in);
     int res;
     ptrdiff_t rgb_stride = FFALIGN(in->width * sizeof(int16_t), 32);
     unsigned rgb_sz = rgb_stride * in->height;
@@ -779,12 +832,6 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         av_frame_free(&in);
         return AVERROR(ENOMEM);
     }
-    res = av_frame_copy_props(out, in);
-    if (res < 0) {
-        av_frame_free(&in);
-        av_frame_free(&out);
-        return res;
-    }
 
     out->color_primaries = s->user_prm == AVCOL_PRI_UNSPECIFIED ?
                            default_prm[FFMIN(s->user_all, CS_NB)] : s->user_prm;
@@ -801,6 +848,8 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
                            default_csp[FFMIN(s->user_all, CS_NB)] : s->user_csp;
     out->color_range     = s->user_rng == AVCOL_RANGE_UNSPECIFIED ?
                            in->color_range : s->user_rng;
+    if (in->format == AV_PIX_FMT_XYZ12 && out->color_range == AVCOL_RANGE_UNSPECIFIED)
+        out->color_range = AVCOL_RANGE_MPEG;
     if (rgb_sz != s->rgb_sz) {
         const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(out->format);
         int uvw = in->width >> desc->log2_chroma_w;
@@ -866,7 +915,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     td.in_ss_h = av_pix_fmt_desc_get(in->format)->log2_chroma_h;
     td.out_ss_h = av_pix_fmt_desc_get(out->format)->log2_chroma_h;
     if (s->yuv2yuv_passthrough) {
-        res = av_frame_copy(out, in);
+        res = out->data[0] == in->data[0] ? 0 : av_frame_copy(out, in);
         if (res < 0) {
             av_frame_free(&in);
             av_frame_free(&out);
@@ -893,16 +942,26 @@ static int query_formats(AVFilterContext *ctx)
     int res;
     ColorSpaceContext *s = ctx->priv;
     AVFilterFormats *formats = ff_make_format_list(pix_fmts);
+    AVFilterFormats *in_formats;
 
     if (!formats)
         return AVERROR(ENOMEM);
-    if (s->user_format == AV_PIX_FMT_NONE)
-        return ff_set_common_formats(ctx, formats);
-    res = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats);
+    if (s->user_format != AV_PIX_FMT_NONE) {
+        in_formats = formats;
+        formats = NULL;
+        res = ff_add_format(&formats, s->user_format);
+        if (res < 0)
+            return res;
+    } else {
+        in_formats = ff_make_format_list(pix_fmts);
+        if (!in_formats)
+            return AVERROR(ENOMEM);
+    }
+    // X'Y'Z' is only supported as input
+    res = ff_add_format(&in_formats, AV_PIX_FMT_XYZ12);
     if (res < 0)
         return res;
-    formats = NULL;
-    res = ff_add_format(&formats, s->user_format);
+    res = ff_formats_ref(in_formats, &ctx->inputs[0]->outcfg.formats);
     if (res < 0)
         return res;
 
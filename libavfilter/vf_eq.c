@@ -252,13 +252,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     const AVPixFmtDescriptor *desc;
     int i;
 
-    out = ff_get_video_buffer(outlink, inlink->w, inlink->h);
+    out = ff_get_video_buffer_inplace(outlink, in);
     if (!out) {
         av_frame_free(&in);
         return AVERROR(ENOMEM);
     }
 
-    av_frame_copy_props(out, in);
     desc = av_pix_fmt_desc_get(inlink->format);
 
     eq->var_values[VAR_N]   = inlink->frame_count_out;
@@ -281,11 +280,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
             h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
         }
 
-        if (i == 3 || !eq->param[i].adjust)
-            av_image_copy_plane(out->data[i], out->linesize[i],
-                                in->data[i], in->linesize[i], w, h);
-
-        else
+        if (i == 3 || !eq->param[i].adjust) {
+            if (out->data[i] != in->data[i])
+                av_image_copy_plane(out->data[i], out->linesize[i],
+                                    in->data[i], in->linesize[i], w, h);
+        } else
             eq->param[i].adjust(&eq->param[i], out->data[i], out->linesize[i],
                                  in->data[i], in->linesize[i], w, h);
     }
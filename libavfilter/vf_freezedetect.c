@@ -28,6 +28,7 @@
 
 #include "avfilter.h"
 #include "filters.h"
+#include "internal.h"
 #include "scene_sad.h"
 
 typedef struct FreezeDetectContext {
@@ -36,6 +37,8 @@ typedef struct FreezeDetectContext {
     ptrdiff_t width[4];
     ptrdiff_t height[4];
     ff_scene_sad_fn sad;
+    uint64_t *slice_sad;
+    int nb_slices;
     int bitdepth;
     AVFrame *reference_frame;
     int64_t n;
@@ -106,6 +109,18 @@ static int config_input(AVFilterLink *inlink)
     if (!s->sad)
         return AVERROR(EINVAL);
 
+    /* every slice needs at least one row of each plane */
+    s->nb_slices = ff_filter_get_nb_threads(ctx);
+    for (int plane = 0; plane < 4; plane++) {
+        if (s->width[plane])
+            s->nb_slices = FFMIN(s->nb_slices, s->height[plane]);
+    }
+    s->nb_slices = FFMAX(s->nb_slices, 1);
+    av_freep(&s->slice_sad);
+    s->slice_sad = av_calloc(s->nb_slices, sizeof(*s->slice_sad));
+    if (!s->slice_sad)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -113,23 +128,51 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     FreezeDetectContext *s = ctx->priv;
     av_frame_free(&s->reference_frame);
+    av_freep(&s->slice_sad);
 }
 
-static int is_frozen(FreezeDetectContext *s, AVFrame *reference, AVFrame *frame)
+typedef struct ThreadData {
+    AVFrame *reference, *frame;
+} ThreadData;
+
+static int sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    FreezeDetectContext *s = ctx->priv;
+    ThreadData *td = arg;
     uint64_t sad = 0;
-    uint64_t count = 0;
-    double mafd;
+
     for (int plane = 0; plane < 4; plane++) {
         if (s->width[plane]) {
+            const int slice_start = (s->height[plane] *  jobnr   ) / nb_jobs;
+            const int slice_end   = (s->height[plane] * (jobnr+1)) / nb_jobs;
+            const ptrdiff_t flinesize = td->frame->linesize[plane];
+            const ptrdiff_t rlinesize = td->reference->linesize[plane];
             uint64_t plane_sad;
-            s->sad(frame->data[plane], frame->linesize[plane],
-                   reference->data[plane], reference->linesize[plane],
-                   s->width[plane], s->height[plane], &plane_sad);
+
+            s->sad(td->frame->data[plane] + slice_start * flinesize, flinesize,
+                   td->reference->data[plane] + slice_start * rlinesize, rlinesize,
+                   s->width[plane], slice_end - slice_start, &plane_sad);
             sad += plane_sad;
-            count += s->width[plane] * s->height[plane];
         }
     }
+    s->slice_sad[jobnr] = sad;
+
+    return 0;
+}
+
+static int is_frozen(AVFilterContext *ctx, AVFrame *reference, AVFrame *frame)
+{
+    FreezeDetectContext *s = ctx->priv;
+    ThreadData td = { .reference = reference, .frame = frame };
+    uint64_t sad = 0;
+    uint64_t count = 0;
+    double mafd;
+
+    ff_filter_execute(ctx, sad_slice, &td, NULL, s->nb_slices);
+    for (int i = 0; i < s->nb_slices; i++)
+        sad += s->slice_sad[i];
+    for (int plane = 0; plane < 4; plane++)
+        count += s->width[plane] * s->height[plane];
     emms_c();
     mafd = (double)sad / count / (1ULL << s->bitdepth);
     return (mafd <= s->noise);
@@ -166,7 +209,7 @@ static int activate(AVFilterContext *ctx)
             else
                 duration = av_rescale_q(frame->pts - s->reference_frame->pts, inlink->time_base, AV_TIME_BASE_Q);
 
-            frozen = is_frozen(s, s->reference_frame, frame);
+            frozen = is_frozen(ctx, s->reference_frame, frame);
             if (duration >= s->duration) {
                 if (!s->frozen)
                     set_meta(s, frame, "lavfi.freezedetect.freeze_start", av_ts2timestr(s->reference_frame->pts, &inlink->time_base));
@@ -221,4 +264,5 @@ const AVFilter ff_vf_freezedetect = {
     FILTER_OUTPUTS(freezedetect_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -16,8 +16,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
 #include "libavutil/buffer.h"
+#include "libavutil/cuda_check.h"
 #include "libavutil/hwcontext.h"
+#include "libavutil/hwcontext_cuda_internal.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 
@@ -26,14 +31,138 @@
 #include "internal.h"
 #include "video.h"
 
+/* number of uploads which may be in flight when using pinned memory */
+#define MAX_PENDING 4
+
 typedef struct CudaUploadContext {
     const AVClass *class;
     int device_idx;
+    int pinned;
 
     AVBufferRef *hwdevice;
     AVBufferRef *hwframe;
+
+    AVBufferPool *pinned_pool;
+    int pinned_pool_size;
+
+    /* input frames which must be kept until their upload is done */
+    AVFrame *pending[MAX_PENDING];
+    CUevent  pending_event[MAX_PENDING];
+    int      pending_idx;
 } CudaUploadContext;
 
+#define CHECK_CU(x) FF_CUDA_CHECK_DL(ctx, cu, x)
+
+#if HAVE_CUDAFUNCTIONS_CUMEMHOSTALLOC
+static void cudaupload_pinned_free(void *opaque, uint8_t *data)
+{
+    AVHWDeviceContext     *ctx = (AVHWDeviceContext*)((AVBufferRef*)opaque)->data;
+    AVCUDADeviceContext *hwctx = ctx->hwctx;
+    CudaFunctions          *cu = hwctx->internal->cuda_dl;
+    CUcontext dummy;
+
+    CHECK_CU(cu->cuCtxPushCurrent(hwctx->cuda_ctx));
+    CHECK_CU(cu->cuMemFreeHost(data));
+    CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+}
+
+static AVBufferRef *cudaupload_pinned_alloc(void *opaque, size_t size)
+{
+    AVHWDeviceContext     *ctx = (AVHWDeviceContext*)((AVBufferRef*)opaque)->data;
+    AVCUDADeviceContext *hwctx = ctx->hwctx;
+    CudaFunctions          *cu = hwctx->internal->cuda_dl;
+    AVBufferRef *ret = NULL;
+    CUcontext dummy;
+    void *data;
+
+    if (CHECK_CU(cu->cuCtxPushCurrent(hwctx->cuda_ctx)) < 0)
+        return NULL;
+
+    if (CHECK_CU(cu->cuMemHostAlloc(&data, size, 0)) >= 0) {
+        ret = av_buffer_create(data, size, cudaupload_pinned_free, opaque, 0);
+        if (!ret)
+            CHECK_CU(cu->cuMemFreeHost(data));
+    }
+
+    CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    return ret;
+}
+
+static void cudaupload_pinned_pool_free(void *opaque)
+{
+    AVBufferRef *hwdevice = opaque;
+    av_buffer_unref(&hwdevice);
+}
+
+/* the input frames are allocated in page-locked memory, from which the
+ * copies to the device are asynchronous and don't need a staging copy */
+static AVFrame *cudaupload_get_video_buffer(AVFilterLink *inlink, int w, int h)
+{
+    CudaUploadContext *s = inlink->dst->priv;
+    AVFrame *frame;
+    int size;
+
+    if (!s->pinned || inlink->hw_frames_ctx)
+        return ff_default_get_video_buffer(inlink, w, h);
+
+    size = av_image_get_buffer_size(inlink->format, w, h, 32);
+    if (size < 0)
+        return NULL;
+
+    if (!s->pinned_pool || s->pinned_pool_size != size) {
+        AVBufferRef *hwdevice = av_buffer_ref(s->hwdevice);
+        if (!hwdevice)
+            return NULL;
+
+        av_buffer_pool_uninit(&s->pinned_pool);
+        s->pinned_pool = av_buffer_pool_init2(size, hwdevice, cudaupload_pinned_alloc,
+                                              cudaupload_pinned_pool_free);
+        if (!s->pinned_pool) {
+            av_buffer_unref(&hwdevice);
+            return NULL;
+        }
+        s->pinned_pool_size = size;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+
+    frame->buf[0] = av_buffer_pool_get(s->pinned_pool);
+    if (!frame->buf[0])
+        goto fail;
+
+    if (av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data,
+                             inlink->format, w, h, 32) < 0)
+        goto fail;
+
+    frame->format = inlink->format;
+    frame->width  = w;
+    frame->height = h;
+
+    return frame;
+fail:
+    av_frame_free(&frame);
+    return NULL;
+}
+#endif
+
+/* wait for the upload from the pending frame in the current slot */
+static int cudaupload_release_pending(AVFilterContext *avctx, int idx)
+{
+    CudaUploadContext      *s = avctx->priv;
+    AVHWDeviceContext    *ctx = (AVHWDeviceContext*)s->hwdevice->data;
+    AVCUDADeviceContext *hwctx = ctx->hwctx;
+    CudaFunctions          *cu = hwctx->internal->cuda_dl;
+    int ret = 0;
+
+    if (s->pending[idx]) {
+        ret = CHECK_CU(cu->cuEventSynchronize(s->pending_event[idx]));
+        av_frame_free(&s->pending[idx]);
+    }
+    return ret;
+}
+
 static av_cold int cudaupload_init(AVFilterContext *ctx)
 {
     CudaUploadContext *s = ctx->priv;
@@ -44,10 +173,26 @@ static av_cold int cudaupload_init(AVFilterContext *ctx)
     return av_hwdevice_ctx_create(&s->hwdevice, AV_HWDEVICE_TYPE_CUDA, buf, NULL, 0);
 }
 
-static av_cold void cudaupload_uninit(AVFilterContext *ctx)
+static av_cold void cudaupload_uninit(AVFilterContext *avctx)
 {
-    CudaUploadContext *s = ctx->priv;
+    CudaUploadContext *s = avctx->priv;
+
+    if (s->hwdevice) {
+        AVHWDeviceContext     *ctx = (AVHWDeviceContext*)s->hwdevice->data;
+        AVCUDADeviceContext *hwctx = ctx->hwctx;
+        CudaFunctions          *cu = hwctx->internal->cuda_dl;
+        CUcontext dummy;
+
+        CHECK_CU(cu->cuCtxPushCurrent(hwctx->cuda_ctx));
+        for (int i = 0; i < MAX_PENDING; i++) {
+            cudaupload_release_pending(avctx, i);
+            if (s->pending_event[i])
+                CHECK_CU(cu->cuEventDestroy(s->pending_event[i]));
+        }
+        CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    }
 
+    av_buffer_pool_uninit(&s->pinned_pool);
     av_buffer_unref(&s->hwframe);
     av_buffer_unref(&s->hwdevice);
 }
@@ -113,6 +258,22 @@ static int cudaupload_config_output(AVFilterLink *outlink)
     if (ret < 0)
         return ret;
 
+    if (s->pinned && !s->pending_event[0]) {
+        AVHWDeviceContext     *dev = (AVHWDeviceContext*)s->hwdevice->data;
+        AVCUDADeviceContext *hwctx = dev->hwctx;
+        CudaFunctions          *cu = hwctx->internal->cuda_dl;
+        CUcontext dummy;
+
+        ret = CHECK_CU(cu->cuCtxPushCurrent(hwctx->cuda_ctx));
+        if (ret < 0)
+            return ret;
+        for (int i = 0; i < MAX_PENDING && ret >= 0; i++)
+            ret = CHECK_CU(cu->cuEventCreate(&s->pending_event[i], CU_EVENT_DISABLE_TIMING));
+        CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+        if (ret < 0)
+            return ret;
+    }
+
     outlink->hw_frames_ctx = av_buffer_ref(s->hwframe);
     if (!outlink->hw_frames_ctx)
         return AVERROR(ENOMEM);
@@ -120,10 +281,37 @@ static int cudaupload_config_output(AVFilterLink *outlink)
     return 0;
 }
 
+static int cudaupload_keep_pending(AVFilterContext *avctx, AVFrame *in)
+{
+    CudaUploadContext      *s = avctx->priv;
+    AVHWDeviceContext    *ctx = (AVHWDeviceContext*)s->hwdevice->data;
+    AVCUDADeviceContext *hwctx = ctx->hwctx;
+    CudaFunctions          *cu = hwctx->internal->cuda_dl;
+    CUcontext dummy;
+    int idx = s->pending_idx;
+    int ret;
+
+    ret = CHECK_CU(cu->cuCtxPushCurrent(hwctx->cuda_ctx));
+    if (ret < 0)
+        return ret;
+
+    ret = cudaupload_release_pending(avctx, idx);
+    if (ret >= 0)
+        ret = CHECK_CU(cu->cuEventRecord(s->pending_event[idx], hwctx->stream));
+    if (ret >= 0) {
+        s->pending[idx] = in;
+        s->pending_idx  = (idx + 1) % MAX_PENDING;
+    }
+
+    CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    return ret;
+}
+
 static int cudaupload_filter_frame(AVFilterLink *link, AVFrame *in)
 {
     AVFilterContext   *ctx = link->dst;
     AVFilterLink  *outlink = ctx->outputs[0];
+    CudaUploadContext   *s = ctx->priv;
 
     AVFrame *out = NULL;
     int ret;
@@ -147,6 +335,15 @@ static int cudaupload_filter_frame(AVFilterLink *link, AVFrame *in)
     if (ret < 0)
         goto fail;
 
+    if (s->pinned && !link->hw_frames_ctx) {
+        /* the copy from page-locked memory runs asynchronously, so the
+         * input is kept until it is done */
+        ret = cudaupload_keep_pending(ctx, in);
+        if (ret < 0)
+            goto fail;
+        in = NULL;
+    }
+
     av_frame_free(&in);
 
     return ff_filter_frame(ctx->outputs[0], out);
@@ -160,6 +357,9 @@ fail:
 #define FLAGS (AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
 static const AVOption cudaupload_options[] = {
     { "device", "Number of the device to use", OFFSET(device_idx), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+#if HAVE_CUDAFUNCTIONS_CUMEMHOSTALLOC
+    { "pinned", "Allocate the input frames in page-locked memory", OFFSET(pinned), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+#endif
     { NULL },
 };
 
@@ -170,6 +370,9 @@ static const AVFilterPad cudaupload_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .filter_frame = cudaupload_filter_frame,
+#if HAVE_CUDAFUNCTIONS_CUMEMHOSTALLOC
+        .get_buffer.video = cudaupload_get_video_buffer,
+#endif
     },
 };
 
@@ -27,6 +27,7 @@
 #include <pthread.h>
 #include <libvmaf.h>
 #include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
@@ -48,9 +49,8 @@ typedef struct LIBVMAFContext {
     pthread_mutex_t lock;
     pthread_cond_t cond;
     int eof;
-    AVFrame *gmain;
-    AVFrame *gref;
-    int frame_set;
+    AVFifoBuffer *queue;
+    int queue_size;
     char *model_path;
     char *log_path;
     char *log_fmt;
@@ -84,30 +84,44 @@ static const AVOption libvmaf_options[] = {
     {"n_threads", "Set number of threads to be used when computing vmaf.",              OFFSET(n_threads), AV_OPT_TYPE_INT, {.i64=0}, 0, UINT_MAX, FLAGS},
     {"n_subsample", "Set interval for frame subsampling used when computing vmaf.",     OFFSET(n_subsample), AV_OPT_TYPE_INT, {.i64=1}, 1, UINT_MAX, FLAGS},
     {"enable_conf_interval",  "Enables confidence interval.",                           OFFSET(enable_conf_interval), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS},
+    {"queue_size", "Set the number of frame pairs queued for the vmaf thread.",         OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64=8}, 1, 1024, FLAGS},
     { NULL }
 };
 
 FRAMESYNC_DEFINE_CLASS(libvmaf, LIBVMAFContext, fs);
 
+/* Queue entries are pairs of frame references, the frame data is not copied. */
+typedef struct FramePair {
+    AVFrame *main;
+    AVFrame *ref;
+} FramePair;
+
 #define read_frame_fn(type, bits)                                               \
     static int read_frame_##bits##bit(float *ref_data, float *main_data,        \
                                       float *temp_data, int stride, void *ctx)  \
 {                                                                               \
     LIBVMAFContext *s = (LIBVMAFContext *) ctx;                                 \
-    int ret;                                                                    \
+    FramePair pair = { NULL };                                                  \
     \
     pthread_mutex_lock(&s->lock);                                               \
     \
-    while (!s->frame_set && !s->eof) {                                          \
+    while (!av_fifo_size(s->queue) && !s->eof) {                                \
         pthread_cond_wait(&s->cond, &s->lock);                                  \
     }                                                                           \
     \
-    if (s->frame_set) {                                                         \
-        int ref_stride = s->gref->linesize[0];                                  \
-        int main_stride = s->gmain->linesize[0];                                \
+    if (av_fifo_size(s->queue)) {                                               \
+        av_fifo_generic_read(s->queue, &pair, sizeof(pair), NULL);              \
+        pthread_cond_signal(&s->cond);                                          \
+    }                                                                           \
+    \
+    pthread_mutex_unlock(&s->lock);                                             \
+    \
+    if (pair.ref) {                                                             \
+        int ref_stride = pair.ref->linesize[0];                                 \
+        int main_stride = pair.main->linesize[0];                               \
         \
-        const type *ref_ptr = (const type *) s->gref->data[0];                  \
-        const type *main_ptr = (const type *) s->gmain->data[0];                \
+        const type *ref_ptr = (const type *) pair.ref->data[0];                 \
+        const type *main_ptr = (const type *) pair.main->data[0];               \
         \
         float *ptr = ref_data;                                                  \
         float factor = 1.f / (1 << (bits - 8));                                 \
@@ -134,26 +148,18 @@ FRAMESYNC_DEFINE_CLASS(libvmaf, LIBVMAFContext, fs);
             main_ptr += main_stride / sizeof(*main_ptr);                        \
             ptr += stride / sizeof(*ptr);                                       \
         }                                                                       \
+        \
+        av_frame_free(&pair.ref);                                               \
+        av_frame_free(&pair.main);                                              \
+        return 0;                                                               \
     }                                                                           \
     \
-    ret = !s->frame_set;                                                        \
-    \
-    av_frame_unref(s->gref);                                                    \
-    av_frame_unref(s->gmain);                                                   \
-    s->frame_set = 0;                                                           \
-    \
-    pthread_cond_signal(&s->cond);                                              \
-    pthread_mutex_unlock(&s->lock);                                             \
-    \
-    if (ret) {                                                                  \
-        return 2;                                                               \
-    }                                                                           \
-    \
-    return 0;                                                                   \
+    return 2;                                                                   \
 }
 
 read_frame_fn(uint8_t, 8);
 read_frame_fn(uint16_t, 10);
+read_frame_fn(uint16_t, 12);
 
 static void compute_vmaf_score(LIBVMAFContext *s)
 {
@@ -163,8 +169,10 @@ static void compute_vmaf_score(LIBVMAFContext *s)
 
     if (s->desc->comp[0].depth <= 8) {
         read_frame = read_frame_8bit;
-    } else {
+    } else if (s->desc->comp[0].depth <= 10) {
         read_frame = read_frame_10bit;
+    } else {
+        read_frame = read_frame_12bit;
     }
 
     format = (char *) s->desc->name;
@@ -197,6 +205,7 @@ static int do_vmaf(FFFrameSync *fs)
     AVFilterContext *ctx = fs->parent;
     LIBVMAFContext *s = ctx->priv;
     AVFrame *master, *ref;
+    FramePair pair;
     int ret;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
@@ -205,9 +214,18 @@ static int do_vmaf(FFFrameSync *fs)
     if (!ref)
         return ff_filter_frame(ctx->outputs[0], master);
 
+    pair.ref  = av_frame_clone(ref);
+    pair.main = av_frame_clone(master);
+    if (!pair.ref || !pair.main) {
+        av_frame_free(&pair.ref);
+        av_frame_free(&pair.main);
+        av_frame_free(&master);
+        return AVERROR(ENOMEM);
+    }
+
     pthread_mutex_lock(&s->lock);
 
-    while (s->frame_set && !s->error) {
+    while (av_fifo_space(s->queue) < sizeof(pair) && !s->error) {
         pthread_cond_wait(&s->cond, &s->lock);
     }
 
@@ -215,13 +233,13 @@ static int do_vmaf(FFFrameSync *fs)
         av_log(ctx, AV_LOG_ERROR,
                "libvmaf encountered an error, check log for details\n");
         pthread_mutex_unlock(&s->lock);
+        av_frame_free(&pair.ref);
+        av_frame_free(&pair.main);
+        av_frame_free(&master);
         return AVERROR(EINVAL);
     }
 
-    av_frame_ref(s->gref, ref);
-    av_frame_ref(s->gmain, master);
-
-    s->frame_set = 1;
+    av_fifo_generic_write(s->queue, &pair, sizeof(pair), NULL);
 
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->lock);
@@ -233,9 +251,8 @@ static av_cold int init(AVFilterContext *ctx)
 {
     LIBVMAFContext *s = ctx->priv;
 
-    s->gref = av_frame_alloc();
-    s->gmain = av_frame_alloc();
-    if (!s->gref || !s->gmain)
+    s->queue = av_fifo_alloc_array(s->queue_size, sizeof(FramePair));
+    if (!s->queue)
         return AVERROR(ENOMEM);
 
     s->error = 0;
@@ -251,6 +268,7 @@ static av_cold int init(AVFilterContext *ctx)
 static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P,
     AV_PIX_FMT_YUV444P10LE, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV420P10LE,
+    AV_PIX_FMT_YUV444P12LE, AV_PIX_FMT_YUV422P12LE, AV_PIX_FMT_YUV420P12LE,
     AV_PIX_FMT_NONE
 };
 
@@ -324,8 +342,14 @@ static av_cold void uninit(AVFilterContext *ctx)
         s->vmaf_thread_created = 0;
     }
 
-    av_frame_free(&s->gref);
-    av_frame_free(&s->gmain);
+    while (s->queue && av_fifo_size(s->queue)) {
+        FramePair pair;
+
+        av_fifo_generic_read(s->queue, &pair, sizeof(pair), NULL);
+        av_frame_free(&pair.ref);
+        av_frame_free(&pair.main);
+    }
+    av_fifo_freep(&s->queue);
 
     pthread_mutex_destroy(&s->lock);
     pthread_cond_destroy(&s->cond);
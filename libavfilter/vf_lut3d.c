@@ -25,6 +25,7 @@
  */
 
 #include "float.h"
+#include <sys/stat.h>
 
 #include "libavutil/opt.h"
 #include "libavutil/file.h"
@@ -32,6 +33,7 @@
 #include "libavutil/intfloat.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/thread.h"
 #include "drawutils.h"
 #include "formats.h"
 #include "internal.h"
@@ -1223,12 +1225,126 @@ static const AVOption lut3d_haldclut_options[] = {
 
 AVFILTER_DEFINE_CLASS_EXT(lut3d, "lut3d", lut3d_haldclut_options);
 
-static av_cold int lut3d_init(AVFilterContext *ctx)
+/*
+ * Parsed LUT files are kept in a small process-wide cache, keyed by file
+ * name, size and modification time, so that several filter instances using
+ * the same file parse it once and share read-only, refcounted tables.
+ */
+#define LUT_CACHE_SIZE 8
+
+typedef struct LutCacheEntry {
+    char *file;
+    int64_t size, mtime;
+    AVBufferRef *lut, *prelut[3];
+    int lutsize;
+    struct rgbvec scale;
+    Lut3DPreLut prelut_params;
+} LutCacheEntry;
+
+static AVMutex lut_cache_mutex = AV_MUTEX_INITIALIZER;
+static LutCacheEntry lut_cache[LUT_CACHE_SIZE];
+static unsigned lut_cache_next;
+
+static av_cold int lut_cache_get(LUT3DContext *lut3d, const struct stat *st)
+{
+    int i, j, found = 0;
+
+    ff_mutex_lock(&lut_cache_mutex);
+    for (i = 0; i < LUT_CACHE_SIZE && !found; i++) {
+        LutCacheEntry *e = &lut_cache[i];
+
+        if (!e->file || strcmp(e->file, lut3d->file) ||
+            e->size != st->st_size || e->mtime != st->st_mtime)
+            continue;
+
+        lut3d->lut_buf = av_buffer_ref(e->lut);
+        if (!lut3d->lut_buf)
+            break;
+        for (j = 0; j < 3 && e->prelut[j]; j++) {
+            lut3d->prelut_buf[j] = av_buffer_ref(e->prelut[j]);
+            if (!lut3d->prelut_buf[j])
+                break;
+        }
+        if (j < 3 && e->prelut[j])
+            break;
+
+        lut3d->lut      = (struct rgbvec *)lut3d->lut_buf->data;
+        lut3d->lutsize  = e->lutsize;
+        lut3d->lutsize2 = e->lutsize * e->lutsize;
+        lut3d->scale    = e->scale;
+        lut3d->prelut   = e->prelut_params;
+        for (j = 0; j < 3; j++)
+            lut3d->prelut.lut[j] = lut3d->prelut_buf[j] ? (float *)lut3d->prelut_buf[j]->data : NULL;
+        found = 1;
+    }
+    ff_mutex_unlock(&lut_cache_mutex);
+
+    if (!found) {
+        av_buffer_unref(&lut3d->lut_buf);
+        for (j = 0; j < 3; j++)
+            av_buffer_unref(&lut3d->prelut_buf[j]);
+    }
+    return found;
+}
+
+static av_cold void lut_cache_put(LUT3DContext *lut3d, const struct stat *st)
+{
+    const size_t lut_size = (size_t)lut3d->lutsize * lut3d->lutsize2 * sizeof(*lut3d->lut);
+    LutCacheEntry *e;
+    char *file;
+    int i;
+
+    /* hand the tables over to buffers, they become read-only from now on */
+    lut3d->lut_buf = av_buffer_create((uint8_t *)lut3d->lut, lut_size,
+                                      av_buffer_default_free, NULL, 0);
+    if (!lut3d->lut_buf)
+        return;
+    for (i = 0; i < 3 && lut3d->prelut.lut[i]; i++) {
+        lut3d->prelut_buf[i] = av_buffer_create((uint8_t *)lut3d->prelut.lut[i],
+                                                PRELUT_SIZE * sizeof(*lut3d->prelut.lut[i]),
+                                                av_buffer_default_free, NULL, 0);
+        if (!lut3d->prelut_buf[i])
+            return;
+    }
+
+    file = av_strdup(lut3d->file);
+    if (!file)
+        return;
+
+    ff_mutex_lock(&lut_cache_mutex);
+    e = &lut_cache[lut_cache_next++ % LUT_CACHE_SIZE];
+    av_freep(&e->file);
+    av_buffer_unref(&e->lut);
+    for (i = 0; i < 3; i++)
+        av_buffer_unref(&e->prelut[i]);
+
+    e->lut = av_buffer_ref(lut3d->lut_buf);
+    for (i = 0; i < 3 && lut3d->prelut_buf[i]; i++)
+        e->prelut[i] = av_buffer_ref(lut3d->prelut_buf[i]);
+    if (e->lut && (i == 3 || !lut3d->prelut_buf[i])) {
+        e->file          = file;
+        e->size          = st->st_size;
+        e->mtime         = st->st_mtime;
+        e->lutsize       = lut3d->lutsize;
+        e->scale         = lut3d->scale;
+        e->prelut_params = lut3d->prelut;
+    } else {
+        av_buffer_unref(&e->lut);
+        for (i = 0; i < 3; i++)
+            av_buffer_unref(&e->prelut[i]);
+        av_free(file);
+    }
+    ff_mutex_unlock(&lut_cache_mutex);
+}
+
+av_cold int ff_lut3d_init(AVFilterContext *ctx)
 {
     int ret;
     FILE *f;
     const char *ext;
     LUT3DContext *lut3d = ctx->priv;
+    struct stat st;
+    int cacheable;
 
     lut3d->scale.r = lut3d->scale.g = lut3d->scale.b = 1.f;
 
@@ -1236,6 +1352,12 @@ static av_cold int lut3d_init(AVFilterContext *ctx)
         return set_identity_matrix(ctx, 32);
     }
 
+    cacheable = !stat(lut3d->file, &st);
+    if (cacheable && lut_cache_get(lut3d, &st)) {
+        av_log(ctx, AV_LOG_DEBUG, "Using cached 3D LUT for %s\n", lut3d->file);
+        return 0;
+    }
+
     f = av_fopen_utf8(lut3d->file, "r");
     if (!f) {
         ret = AVERROR(errno);
@@ -1271,19 +1393,33 @@ static av_cold int lut3d_init(AVFilterContext *ctx)
         ret = AVERROR_INVALIDDATA;
     }
 
+    if (!ret && cacheable)
+        lut_cache_put(lut3d, &st);
+
 end:
     fclose(f);
     return ret;
 }
 
-static av_cold void lut3d_uninit(AVFilterContext *ctx)
+av_cold void ff_lut3d_uninit(AVFilterContext *ctx)
 {
     LUT3DContext *lut3d = ctx->priv;
     int i;
-    av_freep(&lut3d->lut);
+
+    if (lut3d->lut_buf) {
+        av_buffer_unref(&lut3d->lut_buf);
+        lut3d->lut = NULL;
+    } else {
+        av_freep(&lut3d->lut);
+    }
 
     for (i = 0; i < 3; i++) {
-        av_freep(&lut3d->prelut.lut[i]);
+        if (lut3d->prelut_buf[i]) {
+            av_buffer_unref(&lut3d->prelut_buf[i]);
+            lut3d->prelut.lut[i] = NULL;
+        } else {
+            av_freep(&lut3d->prelut.lut[i]);
+        }
     }
 }
 
@@ -1307,8 +1443,8 @@ const AVFilter ff_vf_lut3d = {
     .name          = "lut3d",
     .description   = NULL_IF_CONFIG_SMALL("Adjust colors using a 3D LUT."),
     .priv_size     = sizeof(LUT3DContext),
-    .init          = lut3d_init,
-    .uninit        = lut3d_uninit,
+    .init          = ff_lut3d_init,
+    .uninit        = ff_lut3d_uninit,
     FILTER_INPUTS(lut3d_inputs),
     FILTER_OUTPUTS(lut3d_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
@@ -0,0 +1,387 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * 3D LUT filter for CUDA frames
+ */
+
+#include "libavutil/hwcontext.h"
+#include "libavutil/hwcontext_cuda_internal.h"
+#include "libavutil/cuda_check.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avfilter.h"
+#include "drawutils.h"
+#include "internal.h"
+#include "lut3d.h"
+#include "video.h"
+
+#include "cuda/load_helper.h"
+#include "vf_lut3d_cuda.h"
+
+#define CHECK_CU(x) FF_CUDA_CHECK_DL(ctx, s->hwctx->internal->cuda_dl, x)
+#define DIV_UP(a, b) ( ((a) + (b) - 1) / (b) )
+#define BLOCKX 32
+#define BLOCKY 16
+
+static const enum AVPixelFormat supported_formats[] = {
+    AV_PIX_FMT_GBRP,
+    AV_PIX_FMT_GBRP10,
+    AV_PIX_FMT_GBRP12,
+    AV_PIX_FMT_GBRP16,
+    AV_PIX_FMT_0RGB32,
+    AV_PIX_FMT_0BGR32,
+};
+
+typedef struct LUT3DCudaContext {
+    LUT3DContext lut3d;         ///< must be first, the LUT parsers use it
+
+    AVCUDADeviceContext *hwctx;
+    const AVPixFmtDescriptor *desc;
+    uint8_t rgba_map[4];
+
+    CUmodule    cu_module;
+    CUfunction  cu_func;
+    CUstream    cu_stream;
+    CUdeviceptr lut;
+    CUdeviceptr prelut;
+} LUT3DCudaContext;
+
+static int format_is_supported(enum AVPixelFormat fmt)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(supported_formats); i++)
+        if (supported_formats[i] == fmt)
+            return 1;
+    return 0;
+}
+
+static av_cold void lut3d_cuda_uninit(AVFilterContext *ctx)
+{
+    LUT3DCudaContext *s = ctx->priv;
+
+    if (s->hwctx) {
+        CudaFunctions *cu = s->hwctx->internal->cuda_dl;
+        CUcontext dummy;
+
+        CHECK_CU(cu->cuCtxPushCurrent(s->hwctx->cuda_ctx));
+        if (s->lut) {
+            CHECK_CU(cu->cuMemFree(s->lut));
+            s->lut = 0;
+        }
+        if (s->prelut) {
+            CHECK_CU(cu->cuMemFree(s->prelut));
+            s->prelut = 0;
+        }
+        if (s->cu_module) {
+            CHECK_CU(cu->cuModuleUnload(s->cu_module));
+            s->cu_module = NULL;
+        }
+        CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    }
+
+    ff_lut3d_uninit(ctx);
+}
+
+/* Copy a host buffer of height rows of width bytes to new device memory. */
+static int upload(AVFilterContext *ctx, CUdeviceptr *dst, const void *src,
+                  size_t width, size_t height)
+{
+    LUT3DCudaContext *s = ctx->priv;
+    CudaFunctions *cu = s->hwctx->internal->cuda_dl;
+    CUDA_MEMCPY2D cpy = {
+        .srcMemoryType = CU_MEMORYTYPE_HOST,
+        .dstMemoryType = CU_MEMORYTYPE_DEVICE,
+        .srcHost       = src,
+        .srcPitch      = width,
+        .dstPitch      = width,
+        .WidthInBytes  = width,
+        .Height        = height,
+    };
+    int ret;
+
+    ret = CHECK_CU(cu->cuMemAlloc(dst, width * height));
+    if (ret < 0)
+        return ret;
+
+    cpy.dstDevice = *dst;
+    ret = CHECK_CU(cu->cuMemcpy2DAsync(&cpy, s->cu_stream));
+    if (ret < 0)
+        return ret;
+
+    return CHECK_CU(cu->cuStreamSynchronize(s->cu_stream));
+}
+
+static int upload_luts(AVFilterContext *ctx)
+{
+    LUT3DCudaContext *s = ctx->priv;
+    LUT3DContext *lut3d = &s->lut3d;
+    const int lutsize = lut3d->lutsize;
+    const int nb_entries = lutsize * lut3d->lutsize2;
+    float *buf;
+    int i, ret;
+
+    /* CUDA has no 3 component vectors, pad the entries to float4 */
+    buf = av_malloc_array(nb_entries, 4 * sizeof(*buf));
+    if (!buf)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_entries; i++) {
+        buf[4 * i + 0] = lut3d->lut[i].r;
+        buf[4 * i + 1] = lut3d->lut[i].g;
+        buf[4 * i + 2] = lut3d->lut[i].b;
+        buf[4 * i + 3] = 0.f;
+    }
+    ret = upload(ctx, &s->lut, buf, lutsize * 4 * sizeof(*buf), lut3d->lutsize2);
+    av_free(buf);
+    if (ret < 0)
+        return ret;
+
+    if (lut3d->prelut.size > 0) {
+        const size_t size = lut3d->prelut.size * sizeof(*lut3d->prelut.lut[0]);
+
+        buf = av_malloc(3 * size);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < 3; i++)
+            memcpy((uint8_t *)buf + i * size, lut3d->prelut.lut[i], size);
+        ret = upload(ctx, &s->prelut, buf, size, 3);
+        av_free(buf);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static av_cold int lut3d_cuda_config_props(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    LUT3DCudaContext *s = ctx->priv;
+    AVHWFramesContext *frames_ctx;
+    AVCUDADeviceContext *device_hwctx;
+    CudaFunctions *cu;
+    CUcontext dummy;
+    const char *func_name;
+    int ret;
+
+    extern const unsigned char ff_vf_lut3d_cuda_ptx_data[];
+    extern const unsigned int ff_vf_lut3d_cuda_ptx_len;
+
+    if (!inlink->hw_frames_ctx) {
+        av_log(ctx, AV_LOG_ERROR, "No hw context provided on input\n");
+        return AVERROR(EINVAL);
+    }
+    frames_ctx   = (AVHWFramesContext*)inlink->hw_frames_ctx->data;
+    device_hwctx = frames_ctx->device_ctx->hwctx;
+
+    if (!format_is_supported(frames_ctx->sw_format)) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported input format: %s\n",
+               av_get_pix_fmt_name(frames_ctx->sw_format));
+        return AVERROR(ENOSYS);
+    }
+
+    s->hwctx     = device_hwctx;
+    s->cu_stream = s->hwctx->stream;
+    s->desc      = av_pix_fmt_desc_get(frames_ctx->sw_format);
+    ff_fill_rgba_map(s->rgba_map, frames_ctx->sw_format);
+    cu = s->hwctx->internal->cuda_dl;
+
+    if (s->desc->flags & AV_PIX_FMT_FLAG_PLANAR)
+        func_name = s->desc->comp[0].depth > 8 ? "Lut3D_planar_ushort" : "Lut3D_planar_uchar";
+    else
+        func_name = "Lut3D_packed_uchar4";
+
+    ret = CHECK_CU(cu->cuCtxPushCurrent(s->hwctx->cuda_ctx));
+    if (ret < 0)
+        return ret;
+
+    ret = ff_cuda_load_module(ctx, s->hwctx, &s->cu_module,
+                              ff_vf_lut3d_cuda_ptx_data, ff_vf_lut3d_cuda_ptx_len);
+    if (ret < 0)
+        goto fail;
+
+    ret = CHECK_CU(cu->cuModuleGetFunction(&s->cu_func, s->cu_module, func_name));
+    if (ret < 0)
+        goto fail;
+
+    ret = upload_luts(ctx);
+
+fail:
+    CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    if (ret < 0)
+        return ret;
+
+    outlink->hw_frames_ctx = av_buffer_ref(inlink->hw_frames_ctx);
+    if (!outlink->hw_frames_ctx)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static int call_kernel(AVFilterContext *ctx, AVFrame *out, const AVFrame *in)
+{
+    LUT3DCudaContext *s = ctx->priv;
+    LUT3DContext *lut3d = &s->lut3d;
+    CudaFunctions *cu = s->hwctx->internal->cuda_dl;
+    const float lut_max = lut3d->lutsize - 1;
+    Lut3DCudaParams p = {
+        .lut         = s->lut,
+        .lutsize     = lut3d->lutsize,
+        .prelut_size = lut3d->prelut.size > 0 ? lut3d->prelut.size : 0,
+        .scale       = { lut3d->scale.r * lut_max,
+                         lut3d->scale.g * lut_max,
+                         lut3d->scale.b * lut_max },
+        .depth       = s->desc->comp[0].depth,
+        .width       = in->width,
+        .height      = in->height,
+    };
+    int i;
+
+    switch (lut3d->interpolation) {
+    case INTERPOLATE_NEAREST:   p.interp = LUT3D_CUDA_INTERP_NEAREST;     break;
+    case INTERPOLATE_TRILINEAR: p.interp = LUT3D_CUDA_INTERP_TRILINEAR;   break;
+    default:                    p.interp = LUT3D_CUDA_INTERP_TETRAHEDRAL; break;
+    }
+
+    if (p.prelut_size) {
+        for (i = 0; i < 3; i++) {
+            p.prelut[i]        = s->prelut + i * p.prelut_size * sizeof(float);
+            p.prelut_min[i]    = lut3d->prelut.min[i];
+            p.prelut_scale[i]  = lut3d->prelut.scale[i];
+        }
+    }
+
+    if (s->desc->flags & AV_PIX_FMT_FLAG_PLANAR) {
+        /* gbr plane order */
+        CUdeviceptr dst[3] = { (CUdeviceptr)out->data[0], (CUdeviceptr)out->data[1], (CUdeviceptr)out->data[2] };
+        CUdeviceptr src[3] = { (CUdeviceptr)in->data[0],  (CUdeviceptr)in->data[1],  (CUdeviceptr)in->data[2]  };
+        int dst_pitch = out->linesize[0], src_pitch = in->linesize[0];
+        void *args[] = { &p, &dst[0], &dst[1], &dst[2], &dst_pitch,
+                         &src[0], &src[1], &src[2], &src_pitch };
+
+        if (out->linesize[1] != dst_pitch || out->linesize[2] != dst_pitch ||
+            in->linesize[1]  != src_pitch || in->linesize[2]  != src_pitch) {
+            av_log(ctx, AV_LOG_ERROR, "Planes with different strides are not supported\n");
+            return AVERROR(ENOSYS);
+        }
+
+        return CHECK_CU(cu->cuLaunchKernel(s->cu_func,
+                                           DIV_UP(in->width, BLOCKX), DIV_UP(in->height, BLOCKY), 1,
+                                           BLOCKX, BLOCKY, 1, 0, s->cu_stream, args, NULL));
+    } else {
+        CUdeviceptr dst = (CUdeviceptr)out->data[0];
+        CUdeviceptr src = (CUdeviceptr)in->data[0];
+        int dst_pitch = out->linesize[0], src_pitch = in->linesize[0];
+        int r = s->rgba_map[0], g = s->rgba_map[1], b = s->rgba_map[2], a = s->rgba_map[3];
+        void *args[] = { &p, &dst, &dst_pitch, &src, &src_pitch, &r, &g, &b, &a };
+
+        return CHECK_CU(cu->cuLaunchKernel(s->cu_func,
+                                           DIV_UP(in->width, BLOCKX), DIV_UP(in->height, BLOCKY), 1,
+                                           BLOCKX, BLOCKY, 1, 0, s->cu_stream, args, NULL));
+    }
+}
+
+static int lut3d_cuda_filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    LUT3DCudaContext *s = ctx->priv;
+    CudaFunctions *cu = s->hwctx->internal->cuda_dl;
+    AVFrame *out;
+    CUcontext dummy;
+    int ret;
+
+    out = av_frame_alloc();
+    if (!out) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = av_hwframe_get_buffer(outlink->hw_frames_ctx, out, 0);
+    if (ret < 0)
+        goto fail;
+
+    ret = CHECK_CU(cu->cuCtxPushCurrent(s->hwctx->cuda_ctx));
+    if (ret < 0)
+        goto fail;
+
+    ret = call_kernel(ctx, out, in);
+
+    CHECK_CU(cu->cuCtxPopCurrent(&dummy));
+    if (ret < 0)
+        goto fail;
+
+    ret = av_frame_copy_props(out, in);
+    if (ret < 0)
+        goto fail;
+
+    av_frame_free(&in);
+    return ff_filter_frame(outlink, out);
+fail:
+    av_frame_free(&in);
+    av_frame_free(&out);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(LUT3DCudaContext, lut3d.x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
+#define TFLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_RUNTIME_PARAM
+static const AVOption lut3d_cuda_options[] = {
+    { "file", "set 3D LUT file name", OFFSET(file), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
+    { "interp", "select interpolation mode", OFFSET(interpolation), AV_OPT_TYPE_INT, {.i64=INTERPOLATE_TETRAHEDRAL}, 0, INTERPOLATE_TETRAHEDRAL, TFLAGS, "interp_mode" },
+        { "nearest",     "use values from the nearest defined points",            0, AV_OPT_TYPE_CONST, {.i64=INTERPOLATE_NEAREST},     0, 0, TFLAGS, "interp_mode" },
+        { "trilinear",   "interpolate values using the 8 points defining a cube", 0, AV_OPT_TYPE_CONST, {.i64=INTERPOLATE_TRILINEAR},   0, 0, TFLAGS, "interp_mode" },
+        { "tetrahedral", "interpolate values using a tetrahedron",                0, AV_OPT_TYPE_CONST, {.i64=INTERPOLATE_TETRAHEDRAL}, 0, 0, TFLAGS, "interp_mode" },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(lut3d_cuda);
+
+static const AVFilterPad lut3d_cuda_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = lut3d_cuda_filter_frame,
+    },
+};
+
+static const AVFilterPad lut3d_cuda_outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = lut3d_cuda_config_props,
+    },
+};
+
+const AVFilter ff_vf_lut3d_cuda = {
+    .name            = "lut3d_cuda",
+    .description     = NULL_IF_CONFIG_SMALL("Adjust colors using a 3D LUT on CUDA frames."),
+    .priv_size       = sizeof(LUT3DCudaContext),
+    .init            = ff_lut3d_init,
+    .uninit          = lut3d_cuda_uninit,
+    FILTER_INPUTS(lut3d_cuda_inputs),
+    FILTER_OUTPUTS(lut3d_cuda_outputs),
+    FILTER_SINGLE_PIXFMT(AV_PIX_FMT_CUDA),
+    .priv_class      = &lut3d_cuda_class,
+    .process_command = ff_filter_process_command,
+    .flags_internal  = FF_FILTER_FLAG_HWFRAME_AWARE,
+};
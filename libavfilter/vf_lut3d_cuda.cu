@@ -0,0 +1,238 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "vf_lut3d_cuda.h"
+
+/* Same arithmetic as the C code in vf_lut3d.c, in single precision. */
+
+struct rgb {
+    float r, g, b;
+};
+
+static inline __device__ float clipf(float v, float lo, float hi)
+{
+    return min(max(v, lo), hi);
+}
+
+static inline __device__ rgb fetch(const Lut3DCudaParams &p, int r, int g, int b)
+{
+    const float4 *lut = (const float4 *)p.lut;
+    float4 v = lut[(r * p.lutsize + g) * p.lutsize + b];
+    rgb c = { v.x, v.y, v.z };
+    return c;
+}
+
+static inline __device__ rgb lerp(rgb a, rgb b, float f)
+{
+    rgb c = { a.r + (b.r - a.r) * f, a.g + (b.g - a.g) * f, a.b + (b.b - a.b) * f };
+    return c;
+}
+
+// c = w0 * c0 + w1 * c1 + w2 * c2 + w3 * c3
+static inline __device__ rgb blend4(rgb c0, float w0, rgb c1, float w1,
+                                    rgb c2, float w2, rgb c3, float w3)
+{
+    rgb c = {
+        w0 * c0.r + w1 * c1.r + w2 * c2.r + w3 * c3.r,
+        w0 * c0.g + w1 * c1.g + w2 * c2.g + w3 * c3.g,
+        w0 * c0.b + w1 * c1.b + w2 * c2.b + w3 * c3.b,
+    };
+    return c;
+}
+
+static inline __device__ float prelut_1d(const Lut3DCudaParams &p, int idx, float s)
+{
+    const float *lut = (const float *)p.prelut[idx];
+    const int lut_max = p.prelut_size - 1;
+    const float x = clipf((s - p.prelut_min[idx]) * p.prelut_scale[idx], 0.0f, lut_max);
+    const int prev = (int)x;
+    const int next = min(prev + 1, lut_max);
+    const float pv = lut[prev];
+    return pv + (lut[next] - pv) * (x - (float)prev);
+}
+
+static inline __device__ rgb apply_lut(const Lut3DCudaParams &p, rgb s)
+{
+    const float lut_max = p.lutsize - 1;
+    int prev[3], next[3];
+    rgb d, c000, c111;
+
+    if (p.prelut_size > 0) {
+        s.r = prelut_1d(p, 0, s.r);
+        s.g = prelut_1d(p, 1, s.g);
+        s.b = prelut_1d(p, 2, s.b);
+    }
+
+    s.r = clipf(s.r * p.scale[0], 0.0f, lut_max);
+    s.g = clipf(s.g * p.scale[1], 0.0f, lut_max);
+    s.b = clipf(s.b * p.scale[2], 0.0f, lut_max);
+
+    if (p.interp == LUT3D_CUDA_INTERP_NEAREST)
+        return fetch(p, (int)(s.r + .5f), (int)(s.g + .5f), (int)(s.b + .5f));
+
+    prev[0] = (int)s.r;
+    prev[1] = (int)s.g;
+    prev[2] = (int)s.b;
+    next[0] = min(prev[0] + 1, p.lutsize - 1);
+    next[1] = min(prev[1] + 1, p.lutsize - 1);
+    next[2] = min(prev[2] + 1, p.lutsize - 1);
+    d.r = s.r - prev[0];
+    d.g = s.g - prev[1];
+    d.b = s.b - prev[2];
+
+    c000 = fetch(p, prev[0], prev[1], prev[2]);
+    c111 = fetch(p, next[0], next[1], next[2]);
+
+    if (p.interp == LUT3D_CUDA_INTERP_TRILINEAR) {
+        rgb c001 = fetch(p, prev[0], prev[1], next[2]);
+        rgb c010 = fetch(p, prev[0], next[1], prev[2]);
+        rgb c011 = fetch(p, prev[0], next[1], next[2]);
+        rgb c100 = fetch(p, next[0], prev[1], prev[2]);
+        rgb c101 = fetch(p, next[0], prev[1], next[2]);
+        rgb c110 = fetch(p, next[0], next[1], prev[2]);
+        rgb c00  = lerp(c000, c100, d.r);
+        rgb c10  = lerp(c010, c110, d.r);
+        rgb c01  = lerp(c001, c101, d.r);
+        rgb c11  = lerp(c011, c111, d.r);
+        rgb c0   = lerp(c00,  c10,  d.g);
+        rgb c1   = lerp(c01,  c11,  d.g);
+        return lerp(c0, c1, d.b);
+    }
+
+    // tetrahedral
+    if (d.r > d.g) {
+        if (d.g > d.b) {
+            rgb c100 = fetch(p, next[0], prev[1], prev[2]);
+            rgb c110 = fetch(p, next[0], next[1], prev[2]);
+            return blend4(c000, 1 - d.r, c100, d.r - d.g, c110, d.g - d.b, c111, d.b);
+        } else if (d.r > d.b) {
+            rgb c100 = fetch(p, next[0], prev[1], prev[2]);
+            rgb c101 = fetch(p, next[0], prev[1], next[2]);
+            return blend4(c000, 1 - d.r, c100, d.r - d.b, c101, d.b - d.g, c111, d.g);
+        } else {
+            rgb c001 = fetch(p, prev[0], prev[1], next[2]);
+            rgb c101 = fetch(p, next[0], prev[1], next[2]);
+            return blend4(c000, 1 - d.b, c001, d.b - d.r, c101, d.r - d.g, c111, d.g);
+        }
+    } else {
+        if (d.b > d.g) {
+            rgb c001 = fetch(p, prev[0], prev[1], next[2]);
+            rgb c011 = fetch(p, prev[0], next[1], next[2]);
+            return blend4(c000, 1 - d.b, c001, d.b - d.g, c011, d.g - d.r, c111, d.r);
+        } else if (d.b > d.r) {
+            rgb c010 = fetch(p, prev[0], next[1], prev[2]);
+            rgb c011 = fetch(p, prev[0], next[1], next[2]);
+            return blend4(c000, 1 - d.g, c010, d.g - d.b, c011, d.b - d.r, c111, d.r);
+        } else {
+            rgb c010 = fetch(p, prev[0], next[1], prev[2]);
+            rgb c110 = fetch(p, next[0], next[1], prev[2]);
+            return blend4(c000, 1 - d.g, c010, d.g - d.r, c110, d.r - d.b, c111, d.b);
+        }
+    }
+}
+
+static inline __device__ int to_int(float v, float max_val)
+{
+    return (int)clipf(v * max_val, 0.0f, max_val);
+}
+
+extern "C" {
+
+// planar GBR, 8 bits
+__global__ void Lut3D_planar_uchar(Lut3DCudaParams p,
+                                   unsigned char *dst_g, unsigned char *dst_b,
+                                   unsigned char *dst_r, int dst_pitch,
+                                   const unsigned char *src_g, const unsigned char *src_b,
+                                   const unsigned char *src_r, int src_pitch)
+{
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    const float max_val = 255.0f;
+    const float scale = 1.0f / max_val;
+    int src_off = y * src_pitch + x;
+    int dst_off = y * dst_pitch + x;
+    rgb c;
+
+    if (x >= p.width || y >= p.height)
+        return;
+
+    c.r = src_r[src_off] * scale;
+    c.g = src_g[src_off] * scale;
+    c.b = src_b[src_off] * scale;
+    c = apply_lut(p, c);
+    dst_r[dst_off] = to_int(c.r, max_val);
+    dst_g[dst_off] = to_int(c.g, max_val);
+    dst_b[dst_off] = to_int(c.b, max_val);
+}
+
+// planar GBR, 9 to 16 bits, pitches in bytes
+__global__ void Lut3D_planar_ushort(Lut3DCudaParams p,
+                                    unsigned short *dst_g, unsigned short *dst_b,
+                                    unsigned short *dst_r, int dst_pitch,
+                                    const unsigned short *src_g, const unsigned short *src_b,
+                                    const unsigned short *src_r, int src_pitch)
+{
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    const float max_val = (1 << p.depth) - 1;
+    const float scale = 1.0f / max_val;
+    int src_off = y * (src_pitch >> 1) + x;
+    int dst_off = y * (dst_pitch >> 1) + x;
+    rgb c;
+
+    if (x >= p.width || y >= p.height)
+        return;
+
+    c.r = src_r[src_off] * scale;
+    c.g = src_g[src_off] * scale;
+    c.b = src_b[src_off] * scale;
+    c = apply_lut(p, c);
+    dst_r[dst_off] = to_int(c.r, max_val);
+    dst_g[dst_off] = to_int(c.g, max_val);
+    dst_b[dst_off] = to_int(c.b, max_val);
+}
+
+// packed 32-bit RGB with the byte offsets of each component, the 4th byte is copied
+__global__ void Lut3D_packed_uchar4(Lut3DCudaParams p,
+                                    unsigned char *dst, int dst_pitch,
+                                    const unsigned char *src, int src_pitch,
+                                    int r_off, int g_off, int b_off, int a_off)
+{
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    const float scale = 1.0f / 255.0f;
+    const unsigned char *s;
+    unsigned char *d;
+    rgb c;
+
+    if (x >= p.width || y >= p.height)
+        return;
+
+    s = src + y * src_pitch + x * 4;
+    d = dst + y * dst_pitch + x * 4;
+    c.r = s[r_off] * scale;
+    c.g = s[g_off] * scale;
+    c.b = s[b_off] * scale;
+    c = apply_lut(p, c);
+    d[r_off] = to_int(c.r, 255.0f);
+    d[g_off] = to_int(c.g, 255.0f);
+    d[b_off] = to_int(c.b, 255.0f);
+    d[a_off] = s[a_off];
+}
+
+}
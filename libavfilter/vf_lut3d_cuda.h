@@ -0,0 +1,45 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_LUT3D_CUDA_H
+#define AVFILTER_LUT3D_CUDA_H
+
+/**
+ * Kernel parameters, shared between the host code and the kernels.
+ * Device pointers are stored as 64-bit integers so that the layout is the
+ * same on both sides.
+ */
+typedef struct Lut3DCudaParams {
+    unsigned long long lut;         ///< lutsize^3 float4 entries, r major
+    unsigned long long prelut[3];   ///< prelut_size floats per channel
+    int lutsize;
+    int prelut_size;                ///< 0 if there is no prelut
+    float scale[3];                 ///< input scale, including lutsize - 1
+    float prelut_min[3];
+    float prelut_scale[3];
+    int interp;                     ///< LUT3D_CUDA_INTERP_*
+    int depth;
+    int width;
+    int height;
+} Lut3DCudaParams;
+
+#define LUT3D_CUDA_INTERP_NEAREST     0
+#define LUT3D_CUDA_INTERP_TRILINEAR   1
+#define LUT3D_CUDA_INTERP_TETRAHEDRAL 2
+
+#endif /* AVFILTER_LUT3D_CUDA_H */
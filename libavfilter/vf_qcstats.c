@@ -0,0 +1,543 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Quality control statistics: signalstats, blackdetect, freezedetect and
+ * scdet measurements gathered in a single pass over each frame.
+ */
+
+#include <float.h>
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/timestamp.h"
+
+#include "avfilter.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+enum QCMetric {
+    QC_SIGNALSTATS = 1 << 0,
+    QC_BLACK       = 1 << 1,
+    QC_FREEZE      = 1 << 2,
+    QC_SCD         = 1 << 3,
+};
+
+#define HUE_BINS 360
+
+typedef struct SliceStats {
+    uint64_t dif[3];                ///< SAD against the previous frame, per plane
+    uint64_t dif_ref;               ///< SAD against the freeze reference, if it is not the previous frame
+    unsigned mask[3];               ///< OR of all the values, per plane
+} SliceStats;
+
+typedef struct QCStatsContext {
+    const AVClass *class;
+
+    int metrics;
+
+    /* blackdetect */
+    double black_min_duration_time;
+    int64_t black_min_duration;
+    int64_t black_start, black_end, last_pts;
+    int black_started;
+    double picture_black_ratio_th;
+    double pixel_black_th;
+    unsigned pixel_black_th_i;
+
+    /* freezedetect */
+    double freeze_noise;
+    int64_t freeze_duration;
+    AVFrame *reference;
+    int64_t n, reference_n;
+    int frozen;
+
+    /* scdet */
+    double scd_threshold;
+    double prev_mafd;
+
+    int depth, hsub, vsub;
+    int w, h, cw, ch;
+    int64_t fs, cfs;                ///< number of luma and chroma samples per plane
+    int maxsize;
+    AVFrame *prev;
+
+    int nb_slices;
+    int hist_size;                  ///< size of one slice's histograms
+    unsigned *hist;                 ///< Y, U, V, saturation and hue histograms, per slice
+    SliceStats *slices;
+} QCStatsContext;
+
+#define OFFSET(x) offsetof(QCStatsContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption qcstats_options[] = {
+    { "metrics", "set the metrics to compute", OFFSET(metrics), AV_OPT_TYPE_FLAGS, {.i64=QC_SIGNALSTATS|QC_BLACK|QC_FREEZE|QC_SCD}, 1, QC_SIGNALSTATS|QC_BLACK|QC_FREEZE|QC_SCD, FLAGS, "metrics" },
+        { "signalstats", "signalstats basic statistics", 0, AV_OPT_TYPE_CONST, {.i64=QC_SIGNALSTATS}, 0, 0, FLAGS, "metrics" },
+        { "black",       "blackdetect",                  0, AV_OPT_TYPE_CONST, {.i64=QC_BLACK},       0, 0, FLAGS, "metrics" },
+        { "freeze",      "freezedetect",                 0, AV_OPT_TYPE_CONST, {.i64=QC_FREEZE},      0, 0, FLAGS, "metrics" },
+        { "scd",         "scdet",                        0, AV_OPT_TYPE_CONST, {.i64=QC_SCD},         0, 0, FLAGS, "metrics" },
+    { "black_min_duration", "set minimum detected black duration in seconds", OFFSET(black_min_duration_time), AV_OPT_TYPE_DOUBLE, {.dbl=2}, 0, DBL_MAX, FLAGS },
+    { "bd",                 "set minimum detected black duration in seconds", OFFSET(black_min_duration_time), AV_OPT_TYPE_DOUBLE, {.dbl=2}, 0, DBL_MAX, FLAGS },
+    { "picture_black_ratio_th", "set the picture black ratio threshold", OFFSET(picture_black_ratio_th), AV_OPT_TYPE_DOUBLE, {.dbl=.98}, 0, 1, FLAGS },
+    { "pic_th",                 "set the picture black ratio threshold", OFFSET(picture_black_ratio_th), AV_OPT_TYPE_DOUBLE, {.dbl=.98}, 0, 1, FLAGS },
+    { "pixel_black_th", "set the pixel black threshold", OFFSET(pixel_black_th), AV_OPT_TYPE_DOUBLE, {.dbl=.10}, 0, 1, FLAGS },
+    { "pix_th",         "set the pixel black threshold", OFFSET(pixel_black_th), AV_OPT_TYPE_DOUBLE, {.dbl=.10}, 0, 1, FLAGS },
+    { "freeze_noise",    "set freeze noise tolerance",                OFFSET(freeze_noise),    AV_OPT_TYPE_DOUBLE,   {.dbl=0.001},   0,       1.0, FLAGS },
+    { "fn",              "set freeze noise tolerance",                OFFSET(freeze_noise),    AV_OPT_TYPE_DOUBLE,   {.dbl=0.001},   0,       1.0, FLAGS },
+    { "freeze_duration", "set minimum freeze duration in seconds",    OFFSET(freeze_duration), AV_OPT_TYPE_DURATION, {.i64=2000000}, 0, INT64_MAX, FLAGS },
+    { "fd",              "set minimum freeze duration in seconds",    OFFSET(freeze_duration), AV_OPT_TYPE_DURATION, {.i64=2000000}, 0, INT64_MAX, FLAGS },
+    { "scd_threshold",   "set scene change detect threshold",         OFFSET(scd_threshold),   AV_OPT_TYPE_DOUBLE,   {.dbl=10.},     0,      100., FLAGS },
+    { "st",              "set scene change detect threshold",         OFFSET(scd_threshold),   AV_OPT_TYPE_DOUBLE,   {.dbl=10.},     0,      100., FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(qcstats);
+
+#define YUVJ_FORMATS \
+    AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_YUVJ440P
+
+static const enum AVPixelFormat yuvj_formats[] = {
+    YUVJ_FORMATS, AV_PIX_FMT_NONE
+};
+
+static const enum AVPixelFormat pix_fmts[] = {
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV411P,
+    AV_PIX_FMT_YUV440P,
+    YUVJ_FORMATS,
+    AV_PIX_FMT_YUV444P9, AV_PIX_FMT_YUV422P9, AV_PIX_FMT_YUV420P9,
+    AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV420P10,
+    AV_PIX_FMT_YUV440P10,
+    AV_PIX_FMT_YUV444P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV420P12,
+    AV_PIX_FMT_YUV440P12,
+    AV_PIX_FMT_YUV444P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV420P14,
+    AV_PIX_FMT_YUV444P16, AV_PIX_FMT_YUV422P16, AV_PIX_FMT_YUV420P16,
+    AV_PIX_FMT_NONE
+};
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    QCStatsContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    const int max = (1 << desc->comp[0].depth) - 1;
+    const int factor = 1 << (desc->comp[0].depth - 8);
+
+    s->depth   = desc->comp[0].depth;
+    s->hsub    = desc->log2_chroma_w;
+    s->vsub    = desc->log2_chroma_h;
+    s->maxsize = 1 << s->depth;
+    s->w       = inlink->w;
+    s->h       = inlink->h;
+    s->cw      = AV_CEIL_RSHIFT(inlink->w, s->hsub);
+    s->ch      = AV_CEIL_RSHIFT(inlink->h, s->vsub);
+    s->fs      = (int64_t)s->w  * s->h;
+    s->cfs     = (int64_t)s->cw * s->ch;
+
+    s->black_min_duration = s->black_min_duration_time / av_q2d(inlink->time_base);
+    s->pixel_black_th_i = ff_fmt_is_in(inlink->format, yuvj_formats) ?
+        // luminance_minimum_value + pixel_black_th * luminance_range_size
+             s->pixel_black_th *  max :
+        16 * factor + s->pixel_black_th * (235 - 16) * factor;
+
+    /* slices are made of whole chroma rows and their luma rows */
+    s->nb_slices = FFMAX(1, FFMIN(s->ch, ff_filter_get_nb_threads(ctx)));
+    s->hist_size = 4 * s->maxsize + HUE_BINS;
+    av_freep(&s->hist);
+    av_freep(&s->slices);
+    s->hist   = av_malloc_array(s->nb_slices, s->hist_size * sizeof(*s->hist));
+    s->slices = av_calloc(s->nb_slices, sizeof(*s->slices));
+    if (!s->hist || !s->slices)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+typedef struct ThreadData {
+    const AVFrame *in;
+    const AVFrame *prev;
+    const AVFrame *ref;             ///< freeze reference, NULL if it is prev
+} ThreadData;
+
+static av_always_inline void stats_row(const uint8_t *src8, const uint8_t *prev8,
+                                       const uint8_t *ref8, int w, int is16,
+                                       unsigned *hist, unsigned *mask,
+                                       uint64_t *dif, uint64_t *dif_ref)
+{
+    unsigned m = 0;
+    uint64_t d = 0, dr = 0;
+
+    for (int x = 0; x < w; x++) {
+        const int v = is16 ? AV_RN16(src8 + 2 * x) : src8[x];
+
+        m |= v;
+        hist[v]++;
+        d += abs(v - (is16 ? AV_RN16(prev8 + 2 * x) : prev8[x]));
+        if (ref8)
+            dr += abs(v - (is16 ? AV_RN16(ref8 + 2 * x) : ref8[x]));
+    }
+    *mask    |= m;
+    *dif     += d;
+    *dif_ref += dr;
+}
+
+static av_always_inline int stats_slice(AVFilterContext *ctx, void *arg,
+                                        int jobnr, int nb_jobs, int is16)
+{
+    QCStatsContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *in = td->in, *prev = td->prev, *ref = td->ref;
+    SliceStats *st = &s->slices[jobnr];
+    unsigned *histy   = s->hist + jobnr * s->hist_size;
+    unsigned *histu   = histy + s->maxsize;
+    unsigned *histv   = histu + s->maxsize;
+    unsigned *histsat = histv + s->maxsize;
+    unsigned *histhue = histsat + s->maxsize;
+    const int do_huesat = s->metrics & QC_SIGNALSTATS;
+    const int mid = 1 << (s->depth - 1);
+    const int cstart = (s->ch *  jobnr   ) / nb_jobs;
+    const int cend   = (s->ch * (jobnr+1)) / nb_jobs;
+
+    memset(histy, 0, s->hist_size * sizeof(*histy));
+    memset(st, 0, sizeof(*st));
+
+    for (int cy = cstart; cy < cend; cy++) {
+        const int ystart = cy << s->vsub;
+        const int yend   = FFMIN(s->h, (cy + 1) << s->vsub);
+        const uint8_t *u, *v;
+
+        for (int y = ystart; y < yend; y++) {
+            stats_row(in->data[0] + y * in->linesize[0],
+                      prev->data[0] + y * prev->linesize[0],
+                      ref ? ref->data[0] + y * ref->linesize[0] : NULL,
+                      s->w, is16, histy, &st->mask[0], &st->dif[0], &st->dif_ref);
+        }
+
+        for (int p = 1; p < 3; p++) {
+            stats_row(in->data[p] + cy * in->linesize[p],
+                      prev->data[p] + cy * prev->linesize[p],
+                      ref ? ref->data[p] + cy * ref->linesize[p] : NULL,
+                      s->cw, is16, p == 1 ? histu : histv,
+                      &st->mask[p], &st->dif[p], &st->dif_ref);
+        }
+
+        if (!do_huesat)
+            continue;
+
+        u = in->data[1] + cy * in->linesize[1];
+        v = in->data[2] + cy * in->linesize[2];
+        for (int x = 0; x < s->cw; x++) {
+            const int yuvu = is16 ? AV_RN16(u + 2 * x) : u[x];
+            const int yuvv = is16 ? AV_RN16(v + 2 * x) : v[x];
+            // same rounding as in signalstats
+            const int sat = (int)hypotf(yuvu - mid, yuvv - mid);
+            const int hue = fmodf(floorf((180.f / M_PI) * atan2f(yuvu - mid, yuvv - mid) + 180.f), 360.f);
+
+            histsat[sat]++;
+            histhue[hue]++;
+        }
+    }
+
+    return 0;
+}
+
+static int stats_slice8(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    return stats_slice(ctx, arg, jobnr, nb_jobs, 0);
+}
+
+static int stats_slice16(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    return stats_slice(ctx, arg, jobnr, nb_jobs, 1);
+}
+
+static void set_meta(AVFrame *frame, const char *key, const char *fmt, ...)
+{
+    char buf[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    av_dict_set(&frame->metadata, key, buf, 0);
+}
+
+static void signalstats_meta(QCStatsContext *s, AVFrame *in, const unsigned *hist,
+                             const SliceStats *st)
+{
+    static const char *const names[4] = { "Y", "U", "V", "SAT" };
+    const unsigned *histhue = hist + 4 * s->maxsize;
+    int64_t tothue = 0, acchue = 0;
+    unsigned maxhue = histhue[0];
+    int medhue = -1;
+    char key[64];
+
+    for (int c = 0; c < 4; c++) {
+        const unsigned *h = hist + c * s->maxsize;
+        const int64_t size = c ? s->cfs : s->fs;
+        const int lowp  = lrint(size * 10 / 100.);
+        const int highp = lrint(size * 90 / 100.);
+        int min = -1, max = -1, low = -1, high = -1;
+        int64_t tot = 0, acc = 0;
+
+        for (int i = 0; i < s->maxsize; i++) {
+            if (min < 0 && h[i]) min = i;
+            if (h[i])            max = i;
+            tot += (int64_t)h[i] * i;
+            acc += h[i];
+            if (low  == -1 && acc >= lowp)  low  = i;
+            if (high == -1 && acc >= highp) high = i;
+        }
+
+#define SET_META(name, fmt, val) do {                                         \
+    snprintf(key, sizeof(key), "lavfi.signalstats.%s" name, names[c]);       \
+    set_meta(in, key, fmt, val);                                              \
+} while (0)
+
+        SET_META("MIN",  "%d", min);
+        SET_META("LOW",  "%d", low);
+        SET_META("AVG",  "%g", 1.0 * tot / size);
+        SET_META("HIGH", "%d", high);
+        SET_META("MAX",  "%d", max);
+    }
+
+    for (int i = 0; i < HUE_BINS; i++) {
+        tothue += (int64_t)histhue[i] * i;
+        acchue += histhue[i];
+        if (medhue == -1 && acchue > s->cfs / 2)
+            medhue = i;
+        maxhue = FFMAX(maxhue, histhue[i]);
+    }
+    set_meta(in, "lavfi.signalstats.HUEMED", "%d", medhue);
+    set_meta(in, "lavfi.signalstats.HUEAVG", "%g", 1.0 * tothue / s->cfs);
+
+    set_meta(in, "lavfi.signalstats.YDIF", "%g", 1.0 * st->dif[0] / s->fs);
+    set_meta(in, "lavfi.signalstats.UDIF", "%g", 1.0 * st->dif[1] / s->cfs);
+    set_meta(in, "lavfi.signalstats.VDIF", "%g", 1.0 * st->dif[2] / s->cfs);
+
+    set_meta(in, "lavfi.signalstats.YBITDEPTH", "%d", av_popcount(st->mask[0]));
+    set_meta(in, "lavfi.signalstats.UBITDEPTH", "%d", av_popcount(st->mask[1]));
+    set_meta(in, "lavfi.signalstats.VBITDEPTH", "%d", av_popcount(st->mask[2]));
+}
+
+static void check_black_end(AVFilterContext *ctx, AVRational tb)
+{
+    QCStatsContext *s = ctx->priv;
+
+    if ((s->black_end - s->black_start) >= s->black_min_duration) {
+        av_log(ctx, AV_LOG_INFO,
+               "black_start:%s black_end:%s black_duration:%s\n",
+               av_ts2timestr(s->black_start, &tb),
+               av_ts2timestr(s->black_end,   &tb),
+               av_ts2timestr(s->black_end - s->black_start, &tb));
+    }
+}
+
+static void black_meta(AVFilterContext *ctx, AVFrame *in, const unsigned *histy)
+{
+    QCStatsContext *s = ctx->priv;
+    AVRational tb = ctx->inputs[0]->time_base;
+    const int th = FFMIN(s->pixel_black_th_i, s->maxsize - 1);
+    uint64_t nb_black_pixels = 0;
+    double picture_black_ratio;
+
+    for (int i = 0; i <= th; i++)
+        nb_black_pixels += histy[i];
+    picture_black_ratio = (double)nb_black_pixels / s->fs;
+
+    if (picture_black_ratio >= s->picture_black_ratio_th) {
+        if (!s->black_started) {
+            s->black_started = 1;
+            s->black_start = in->pts;
+            av_dict_set(&in->metadata, "lavfi.black_start",
+                        av_ts2timestr(s->black_start, &tb), 0);
+        }
+    } else if (s->black_started) {
+        s->black_started = 0;
+        s->black_end = in->pts;
+        check_black_end(ctx, tb);
+        av_dict_set(&in->metadata, "lavfi.black_end",
+                    av_ts2timestr(s->black_end, &tb), 0);
+    }
+}
+
+static void freeze_log_meta(AVFilterContext *ctx, AVFrame *frame, const char *key, const char *value)
+{
+    av_log(ctx, AV_LOG_INFO, "%s: %s\n", key, value);
+    av_dict_set(&frame->metadata, key, value, 0);
+}
+
+static int freeze_meta(AVFilterContext *ctx, AVFrame *in, uint64_t sad)
+{
+    QCStatsContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const double mafd = (double)sad / (s->fs + 2 * s->cfs) / (1ULL << s->depth);
+    const int frozen = mafd <= s->freeze_noise;
+    int64_t duration;
+
+    if (s->reference->pts == AV_NOPTS_VALUE || in->pts == AV_NOPTS_VALUE || in->pts < s->reference->pts) // Discontinuity?
+        duration = inlink->frame_rate.num > 0 ? av_rescale_q(s->n - s->reference_n, av_inv_q(inlink->frame_rate), AV_TIME_BASE_Q) : 0;
+    else
+        duration = av_rescale_q(in->pts - s->reference->pts, inlink->time_base, AV_TIME_BASE_Q);
+
+    if (duration >= s->freeze_duration) {
+        if (!s->frozen)
+            freeze_log_meta(ctx, in, "lavfi.freezedetect.freeze_start", av_ts2timestr(s->reference->pts, &inlink->time_base));
+        if (!frozen) {
+            freeze_log_meta(ctx, in, "lavfi.freezedetect.freeze_duration", av_ts2timestr(duration, &AV_TIME_BASE_Q));
+            freeze_log_meta(ctx, in, "lavfi.freezedetect.freeze_end", av_ts2timestr(in->pts, &inlink->time_base));
+        }
+        s->frozen = frozen;
+    }
+
+    return frozen;
+}
+
+static void scd_meta(AVFilterContext *ctx, AVFrame *in, const SliceStats *st, int has_prev)
+{
+    QCStatsContext *s = ctx->priv;
+    AVRational tb = ctx->inputs[0]->time_base;
+    double score = 0;
+
+    if (has_prev) {
+        const double mafd = (double)st->dif[0] * 100. / s->fs / (1ULL << s->depth);
+        const double diff = fabs(mafd - s->prev_mafd);
+
+        score = av_clipf(FFMIN(mafd, diff), 0, 100.);
+        s->prev_mafd = mafd;
+    }
+
+    set_meta(in, "lavfi.scd.mafd", "%0.3f", s->prev_mafd);
+    set_meta(in, "lavfi.scd.score", "%0.3f", score);
+    if (score > s->scd_threshold) {
+        av_log(ctx, AV_LOG_INFO, "lavfi.scd.score: %.3f, lavfi.scd.time: %s\n",
+               score, av_ts2timestr(in->pts, &tb));
+        av_dict_set(&in->metadata, "lavfi.scd.time", av_ts2timestr(in->pts, &tb), 0);
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    QCStatsContext *s = ctx->priv;
+    const int has_prev = !!s->prev;
+    SliceStats *st = &s->slices[0];
+    int frozen = 0;
+    ThreadData td = {
+        .in   = in,
+        .prev = has_prev ? s->prev : in,
+    };
+
+    s->n++;
+
+    /* The freeze reference is usually the previous frame: only compare
+     * against it separately while a freeze is in progress. */
+    if ((s->metrics & QC_FREEZE) && s->reference &&
+        (!has_prev || s->reference->data[0] != s->prev->data[0]))
+        td.ref = s->reference;
+
+    ff_filter_execute(ctx, s->depth > 8 ? stats_slice16 : stats_slice8,
+                      &td, NULL, s->nb_slices);
+
+    for (int i = 1; i < s->nb_slices; i++) {
+        const unsigned *hist = s->hist + i * s->hist_size;
+
+        for (int j = 0; j < s->hist_size; j++)
+            s->hist[j] += hist[j];
+        for (int p = 0; p < 3; p++) {
+            st->dif[p]  += s->slices[i].dif[p];
+            st->mask[p] |= s->slices[i].mask[p];
+        }
+        st->dif_ref += s->slices[i].dif_ref;
+    }
+
+    if (s->metrics & QC_SIGNALSTATS)
+        signalstats_meta(s, in, s->hist, st);
+    if (s->metrics & QC_BLACK)
+        black_meta(ctx, in, s->hist);
+    if ((s->metrics & QC_FREEZE) && s->reference)
+        frozen = freeze_meta(ctx, in, td.ref ? st->dif_ref :
+                             st->dif[0] + st->dif[1] + st->dif[2]);
+    if (s->metrics & QC_SCD)
+        scd_meta(ctx, in, st, has_prev);
+
+    s->last_pts = in->pts;
+
+    av_frame_free(&s->prev);
+    s->prev = av_frame_clone(in);
+    if (!s->prev)
+        goto fail;
+    if ((s->metrics & QC_FREEZE) && !frozen) {
+        av_frame_free(&s->reference);
+        s->reference = av_frame_clone(in);
+        s->reference_n = s->n;
+        if (!s->reference)
+            goto fail;
+    }
+
+    return ff_filter_frame(ctx->outputs[0], in);
+fail:
+    av_frame_free(&in);
+    return AVERROR(ENOMEM);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    QCStatsContext *s = ctx->priv;
+
+    if (s->black_started) {
+        s->black_end = s->last_pts;
+        check_black_end(ctx, ctx->inputs[0]->time_base);
+    }
+
+    av_frame_free(&s->prev);
+    av_frame_free(&s->reference);
+    av_freep(&s->hist);
+    av_freep(&s->slices);
+}
+
+static const AVFilterPad qcstats_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+};
+
+static const AVFilterPad qcstats_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+};
+
+const AVFilter ff_vf_qcstats = {
+    .name          = "qcstats",
+    .description   = NULL_IF_CONFIG_SMALL("Compute signalstats, blackdetect, freezedetect and scdet metrics in one pass."),
+    .priv_size     = sizeof(QCStatsContext),
+    .priv_class    = &qcstats_class,
+    .uninit        = uninit,
+    FILTER_INPUTS(qcstats_inputs),
+    FILTER_OUTPUTS(qcstats_outputs),
+    FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+};
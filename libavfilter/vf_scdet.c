@@ -28,6 +28,7 @@
 
 #include "avfilter.h"
 #include "filters.h"
+#include "internal.h"
 #include "scene_sad.h"
 
 typedef struct SCDetContext {
@@ -38,6 +39,8 @@ typedef struct SCDetContext {
     int nb_planes;
     int bitdepth;
     ff_scene_sad_fn sad;
+    uint64_t *slice_sad;
+    int nb_slices;
     double prev_mafd;
     double scene_score;
     AVFrame *prev_picref;
@@ -94,6 +97,18 @@ static int config_input(AVFilterLink *inlink)
     if (!s->sad)
         return AVERROR(EINVAL);
 
+    /* every slice needs at least one row of each plane */
+    s->nb_slices = ff_filter_get_nb_threads(ctx);
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        if (s->width[plane])
+            s->nb_slices = FFMIN(s->nb_slices, s->height[plane]);
+    }
+    s->nb_slices = FFMAX(s->nb_slices, 1);
+    av_freep(&s->slice_sad);
+    s->slice_sad = av_calloc(s->nb_slices, sizeof(*s->slice_sad));
+    if (!s->slice_sad)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -102,6 +117,34 @@ static av_cold void uninit(AVFilterContext *ctx)
     SCDetContext *s = ctx->priv;
 
     av_frame_free(&s->prev_picref);
+    av_freep(&s->slice_sad);
+}
+
+typedef struct ThreadData {
+    AVFrame *prev, *cur;
+} ThreadData;
+
+static int sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SCDetContext *s = ctx->priv;
+    ThreadData *td = arg;
+    uint64_t sad = 0;
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        const int slice_start = (s->height[plane] *  jobnr   ) / nb_jobs;
+        const int slice_end   = (s->height[plane] * (jobnr+1)) / nb_jobs;
+        const ptrdiff_t plinesize = td->prev->linesize[plane];
+        const ptrdiff_t clinesize = td->cur->linesize[plane];
+        uint64_t plane_sad;
+
+        s->sad(td->prev->data[plane] + slice_start * plinesize, plinesize,
+               td->cur->data[plane] + slice_start * clinesize, clinesize,
+               s->width[plane], slice_end - slice_start, &plane_sad);
+        sad += plane_sad;
+    }
+    s->slice_sad[jobnr] = sad;
+
+    return 0;
 }
 
 static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
@@ -112,18 +155,16 @@ static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
 
     if (prev_picref && frame->height == prev_picref->height
                     && frame->width  == prev_picref->width) {
+        ThreadData td = { .prev = prev_picref, .cur = frame };
         uint64_t sad = 0;
         double mafd, diff;
         uint64_t count = 0;
 
-        for (int plane = 0; plane < s->nb_planes; plane++) {
-            uint64_t plane_sad;
-            s->sad(prev_picref->data[plane], prev_picref->linesize[plane],
-                    frame->data[plane], frame->linesize[plane],
-                    s->width[plane], s->height[plane], &plane_sad);
-            sad += plane_sad;
+        ff_filter_execute(ctx, sad_slice, &td, NULL, s->nb_slices);
+        for (int i = 0; i < s->nb_slices; i++)
+            sad += s->slice_sad[i];
+        for (int plane = 0; plane < s->nb_planes; plane++)
             count += s->width[plane] * s->height[plane];
-        }
 
         emms_c();
         mafd = (double)sad * 100. / count / (1ULL << s->bitdepth);
@@ -210,4 +251,5 @@ const AVFilter ff_vf_scdet = {
     FILTER_OUTPUTS(scdet_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -34,6 +34,12 @@
 
 #define HIST_SIZE (3*256)
 
+enum ThumbMode {
+    MODE_BUFFER,
+    MODE_RUNNING,
+    NB_MODES
+};
+
 struct thumb_frame {
     AVFrame *buf;               ///< cached frame
     int histogram[HIST_SIZE];   ///< RGB color distribution histogram of the frame
@@ -45,6 +51,14 @@ typedef struct ThumbContext {
     int n_frames;               ///< number of frames for analysis
     struct thumb_frame *frames; ///< the n_frames frames
     AVRational tb;              ///< copy of the input timebase to ease access
+    int mode;                   ///< ThumbMode
+    int sub;                    ///< histogram sampling step in both directions
+
+    int best;                   ///< index in the batch of the running candidate
+    uint64_t sum_hist[HIST_SIZE]; ///< running sum of the batch histograms
+
+    int nb_threads;
+    int *thread_histogram;      ///< one histogram per slice job
 
     int planewidth[4];
     int planeheight[4];
@@ -55,6 +69,10 @@ typedef struct ThumbContext {
 
 static const AVOption thumbnail_options[] = {
     { "n", "set the frames batch size", OFFSET(n_frames), AV_OPT_TYPE_INT, {.i64=100}, 2, INT_MAX, FLAGS },
+    { "mode", "set the selection mode", OFFSET(mode), AV_OPT_TYPE_INT, {.i64=MODE_BUFFER}, 0, NB_MODES-1, FLAGS, "mode" },
+        { "buffer",  "buffer the whole batch",          0, AV_OPT_TYPE_CONST, {.i64=MODE_BUFFER},  0, 0, FLAGS, "mode" },
+        { "running", "only keep the current candidate", 0, AV_OPT_TYPE_CONST, {.i64=MODE_RUNNING}, 0, 0, FLAGS, "mode" },
+    { "sub", "set the histogram sampling step", OFFSET(sub), AV_OPT_TYPE_INT, {.i64=1}, 1, 64, FLAGS },
     { NULL }
 };
 
@@ -64,7 +82,7 @@ static av_cold int init(AVFilterContext *ctx)
 {
     ThumbContext *s = ctx->priv;
 
-    s->frames = av_calloc(s->n_frames, sizeof(*s->frames));
+    s->frames = av_calloc(s->mode == MODE_RUNNING ? 2 : s->n_frames, sizeof(*s->frames));
     if (!s->frames) {
         av_log(ctx, AV_LOG_ERROR,
                "Allocation failure, try to lower the number of frames\n");
@@ -100,6 +118,15 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
     int nb_frames = s->n;
     double avg_hist[HIST_SIZE] = {0}, sq_err, min_sq_err = -1;
 
+    if (s->mode == MODE_RUNNING) {
+        best_frame_idx = s->best;
+        picref = s->frames[0].buf;
+        s->frames[0].buf = NULL;
+        memset(s->sum_hist, 0, sizeof(s->sum_hist));
+        s->n = 0;
+        goto end;
+    }
+
     // average histogram of the N frames
     for (j = 0; j < FF_ARRAY_ELEMS(avg_hist); j++) {
         for (i = 0; i < nb_frames; i++)
@@ -124,77 +151,141 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
 
     // raise the chosen one
     picref = s->frames[best_frame_idx].buf;
+    s->frames[best_frame_idx].buf = NULL;
+end:
     av_log(ctx, AV_LOG_INFO, "frame id #%d (pts_time=%f) selected "
            "from a set of %d images\n", best_frame_idx,
            picref->pts * av_q2d(s->tb), nb_frames);
-    s->frames[best_frame_idx].buf = NULL;
 
     return picref;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+/**
+ * Keep the frame closest to the average histogram of the batch so far,
+ * comparing the new frame with the current candidate only.
+ */
+static void update_running_best(ThumbContext *s, AVFrame *frame, const int *hist)
 {
+    double avg_hist[HIST_SIZE];
+    int i;
+
+    for (i = 0; i < HIST_SIZE; i++) {
+        s->sum_hist[i] += hist[i];
+        avg_hist[i] = (double)s->sum_hist[i] / (s->n + 1);
+    }
+
+    if (!s->frames[0].buf ||
+        frame_sum_square_err(hist, avg_hist) <
+        frame_sum_square_err(s->frames[0].histogram, avg_hist)) {
+        av_frame_free(&s->frames[0].buf);
+        s->frames[0].buf = frame;
+        memcpy(s->frames[0].histogram, hist, sizeof(s->frames[0].histogram));
+        s->best = s->n;
+    } else {
+        av_frame_free(&frame);
+    }
+}
+
+static int do_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThumbContext *s = ctx->priv;
+    AVFrame *frame = arg;
+    int *hist = s->thread_histogram + HIST_SIZE * jobnr;
+    const int h = frame->height;
+    const int w = frame->width;
+    const int sub = s->sub;
+    const int slice_start = (h * jobnr) / nb_jobs;
+    const int slice_end = (h * (jobnr+1)) / nb_jobs;
+    const int row_start = (slice_start + sub - 1) / sub * sub;
+    const uint8_t *p = frame->data[0] + row_start * frame->linesize[0];
+    const ptrdiff_t linesize = frame->linesize[0] * sub;
     int i, j;
-    AVFilterContext *ctx  = inlink->dst;
-    ThumbContext *s   = ctx->priv;
-    AVFilterLink *outlink = ctx->outputs[0];
-    int *hist = s->frames[s->n].histogram;
-    const uint8_t *p = frame->data[0];
 
-    // keep a reference of each frame
-    s->frames[s->n].buf = frame;
+    memset(hist, 0, sizeof(*hist) * HIST_SIZE);
 
-    // update current frame histogram
-    switch (inlink->format) {
+    switch (frame->format) {
     case AV_PIX_FMT_RGB24:
     case AV_PIX_FMT_BGR24:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
+        for (j = row_start; j < slice_end; j += sub) {
+            for (i = 0; i < w; i += sub) {
                 hist[0*256 + p[i*3    ]]++;
                 hist[1*256 + p[i*3 + 1]]++;
                 hist[2*256 + p[i*3 + 2]]++;
             }
-            p += frame->linesize[0];
+            p += linesize;
         }
         break;
     case AV_PIX_FMT_RGB0:
     case AV_PIX_FMT_BGR0:
     case AV_PIX_FMT_RGBA:
     case AV_PIX_FMT_BGRA:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
+        for (j = row_start; j < slice_end; j += sub) {
+            for (i = 0; i < w; i += sub) {
                 hist[0*256 + p[i*4    ]]++;
                 hist[1*256 + p[i*4 + 1]]++;
                 hist[2*256 + p[i*4 + 2]]++;
             }
-            p += frame->linesize[0];
+            p += linesize;
         }
         break;
     case AV_PIX_FMT_0RGB:
     case AV_PIX_FMT_0BGR:
     case AV_PIX_FMT_ARGB:
     case AV_PIX_FMT_ABGR:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
+        for (j = row_start; j < slice_end; j += sub) {
+            for (i = 0; i < w; i += sub) {
                 hist[0*256 + p[i*4 + 1]]++;
                 hist[1*256 + p[i*4 + 2]]++;
                 hist[2*256 + p[i*4 + 3]]++;
             }
-            p += frame->linesize[0];
+            p += linesize;
         }
         break;
     default:
         for (int plane = 0; plane < 3; plane++) {
-            const uint8_t *p = frame->data[plane];
-            for (j = 0; j < s->planeheight[plane]; j++) {
-                for (i = 0; i < s->planewidth[plane]; i++)
+            const int ph = s->planeheight[plane];
+            const int start = (ph * jobnr) / nb_jobs;
+            const int end = (ph * (jobnr+1)) / nb_jobs;
+            const int rstart = (start + sub - 1) / sub * sub;
+            const uint8_t *p = frame->data[plane] + rstart * frame->linesize[plane];
+
+            for (j = rstart; j < end; j += sub) {
+                for (i = 0; i < s->planewidth[plane]; i += sub)
                     hist[256*plane + p[i]]++;
-                p += frame->linesize[plane];
+                p += frame->linesize[plane] * sub;
             }
         }
         break;
     }
 
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx  = inlink->dst;
+    ThumbContext *s   = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    int *hist = s->mode == MODE_RUNNING ? s->frames[1].histogram
+                                        : s->frames[s->n].histogram;
+    int nb_jobs = FFMIN(inlink->h, s->nb_threads);
+
+    // update current frame histogram
+    ff_filter_execute(ctx, do_slice, frame, NULL, nb_jobs);
+    for (int i = 0; i < HIST_SIZE; i++) {
+        int sum = 0;
+        for (int j = 0; j < nb_jobs; j++)
+            sum += s->thread_histogram[j * HIST_SIZE + i];
+        hist[i] = sum;
+    }
+
+    if (s->mode == MODE_RUNNING) {
+        update_running_best(s, frame, hist);
+    } else {
+        // keep a reference of each frame
+        s->frames[s->n].buf = frame;
+    }
+
     // no selection until the buffer of N frames is filled up
     s->n++;
     if (s->n < s->n_frames)
@@ -207,9 +298,11 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     int i;
     ThumbContext *s = ctx->priv;
-    for (i = 0; i < s->n_frames && s->frames && s->frames[i].buf; i++)
+    int nb_frames = s->mode == MODE_RUNNING ? 1 : s->n_frames;
+    for (i = 0; i < nb_frames && s->frames && s->frames[i].buf; i++)
         av_frame_free(&s->frames[i].buf);
     av_freep(&s->frames);
+    av_freep(&s->thread_histogram);
 }
 
 static int request_frame(AVFilterLink *link)
@@ -241,6 +334,12 @@ static int config_props(AVFilterLink *inlink)
     s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->planeheight[0] = s->planeheight[3] = inlink->h;
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    av_freep(&s->thread_histogram);
+    s->thread_histogram = av_calloc(s->nb_threads, HIST_SIZE * sizeof(*s->thread_histogram));
+    if (!s->thread_histogram)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -288,5 +387,5 @@ const AVFilter ff_vf_thumbnail = {
     FILTER_OUTPUTS(thumbnail_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .priv_class    = &thumbnail_class,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
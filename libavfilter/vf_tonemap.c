@@ -102,104 +102,131 @@ static float hable(float in)
     return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
 }
 
-static float mobius(float in, float j, double peak)
-{
-    float a, b;
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    const AVPixFmtDescriptor *desc;
+    double peak;
 
-    if (in <= j)
-        return in;
+    /* constants of the tone curves for the current peak */
+    double gamma_exp, gamma_low;
+    float hable_peak;
+    float mobius_j, mobius_a, mobius_b, mobius_scale;
+} ThreadData;
+
+static void init_curve_constants(TonemapContext *s, ThreadData *td)
+{
+    double peak = td->peak;
+    float j = s->param;
 
-    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
-    b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+    td->gamma_exp  = 1.0f / s->param;
+    td->gamma_low  = pow(0.05f / peak, td->gamma_exp);
+    td->hable_peak = hable(peak);
 
-    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
+    td->mobius_j = j;
+    td->mobius_a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+    td->mobius_b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+    td->mobius_scale = (td->mobius_b * td->mobius_b + 2.0f * td->mobius_b * j + j * j) /
+                       (td->mobius_b - td->mobius_a);
 }
 
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
+/**
+ * Tone map one row. Inlined once per algorithm, so that the loops do not
+ * branch on it and the curve constants stay in registers.
+ */
+static av_always_inline void tonemap_row(TonemapContext *s, const ThreadData *td,
+                                         float *r_out, float *b_out, float *g_out,
+                                         const float *r_in, const float *b_in,
+                                         const float *g_in, int width,
+                                         enum TonemapAlgorithm algo)
 {
-    const float *r_in = (const float *)(in->data[0] + x * desc->comp[0].step + y * in->linesize[0]);
-    const float *b_in = (const float *)(in->data[1] + x * desc->comp[1].step + y * in->linesize[1]);
-    const float *g_in = (const float *)(in->data[2] + x * desc->comp[2].step + y * in->linesize[2]);
-    float *r_out = (float *)(out->data[0] + x * desc->comp[0].step + y * out->linesize[0]);
-    float *b_out = (float *)(out->data[1] + x * desc->comp[1].step + y * out->linesize[1]);
-    float *g_out = (float *)(out->data[2] + x * desc->comp[2].step + y * out->linesize[2]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *b_out = *b_in;
-    *g_out = *g_in;
-
-    /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = s->coeffs->cr * *r_in + s->coeffs->cg * *g_in + s->coeffs->cb * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
-    }
+    const double peak = td->peak;
+    const double param = s->param;
+    const double desat = s->desat;
+
+    for (int x = 0; x < width; x++) {
+        float r = r_in[x], g = g_in[x], b = b_in[x];
+        float sig, sig_orig;
+
+        /* desaturate to prevent unnatural colors */
+        if (desat > 0) {
+            float luma = s->coeffs->cr * r_in[x] + s->coeffs->cg * g_in[x] + s->coeffs->cb * b_in[x];
+            float overbright = FFMAX(luma - desat, 1e-6) / FFMAX(luma, 1e-6);
+            r = MIX(r_in[x], luma, overbright);
+            g = MIX(g_in[x], luma, overbright);
+            b = MIX(b_in[x], luma, overbright);
+        }
 
-    /* pick the brightest component, reducing the value range as necessary
-     * to keep the entire signal in range and preventing discoloration due to
-     * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
+        /* pick the brightest component, reducing the value range as necessary
+         * to keep the entire signal in range and preventing discoloration due to
+         * out-of-bounds clipping */
+        sig = FFMAX(FFMAX3(r, g, b), 1e-6);
+        sig_orig = sig;
+
+        switch(algo) {
+        default:
+        case TONEMAP_NONE:
+            // do nothing
+            break;
+        case TONEMAP_LINEAR:
+            sig = sig * param / peak;
+            break;
+        case TONEMAP_GAMMA:
+            sig = sig > 0.05f ? pow(sig / peak, td->gamma_exp)
+                              : sig * td->gamma_low / 0.05f;
+            break;
+        case TONEMAP_CLIP:
+            sig = av_clipf(sig * param, 0, 1.0f);
+            break;
+        case TONEMAP_HABLE:
+            sig = hable(sig) / td->hable_peak;
+            break;
+        case TONEMAP_REINHARD:
+            sig = sig / (sig + param) * (peak + param) / peak;
+            break;
+        case TONEMAP_MOBIUS:
+            if (sig > td->mobius_j)
+                sig = td->mobius_scale * (sig + td->mobius_a) / (sig + td->mobius_b);
+            break;
+        }
 
-    switch(s->tonemap) {
-    default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
+        /* apply the computed scale factor to the color,
+         * linearly to prevent discoloration */
+        r_out[x] = r * (sig / sig_orig);
+        g_out[x] = g * (sig / sig_orig);
+        b_out[x] = b * (sig / sig_orig);
     }
-
-    /* apply the computed scale factor to the color,
-     * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
 }
 
-typedef struct ThreadData {
-    AVFrame *in, *out;
-    const AVPixFmtDescriptor *desc;
-    double peak;
-} ThreadData;
-
 static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     TonemapContext *s = ctx->priv;
     ThreadData *td = arg;
     AVFrame *in = td->in;
     AVFrame *out = td->out;
-    const AVPixFmtDescriptor *desc = td->desc;
     const int slice_start = (in->height * jobnr) / nb_jobs;
     const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
-    double peak = td->peak;
 
-    for (int y = slice_start; y < slice_end; y++)
-        for (int x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    for (int y = slice_start; y < slice_end; y++) {
+        const float *r_in = (const float *)(in->data[0] + y * in->linesize[0]);
+        const float *b_in = (const float *)(in->data[1] + y * in->linesize[1]);
+        const float *g_in = (const float *)(in->data[2] + y * in->linesize[2]);
+        float *r_out = (float *)(out->data[0] + y * out->linesize[0]);
+        float *b_out = (float *)(out->data[1] + y * out->linesize[1]);
+        float *g_out = (float *)(out->data[2] + y * out->linesize[2]);
+
+#define ROW(algo) tonemap_row(s, td, r_out, b_out, g_out, r_in, b_in, g_in, out->width, algo)
+        switch (s->tonemap) {
+        case TONEMAP_LINEAR:   ROW(TONEMAP_LINEAR);   break;
+        case TONEMAP_GAMMA:    ROW(TONEMAP_GAMMA);    break;
+        case TONEMAP_CLIP:     ROW(TONEMAP_CLIP);     break;
+        case TONEMAP_HABLE:    ROW(TONEMAP_HABLE);    break;
+        case TONEMAP_REINHARD: ROW(TONEMAP_REINHARD); break;
+        case TONEMAP_MOBIUS:   ROW(TONEMAP_MOBIUS);   break;
+        default:               ROW(TONEMAP_NONE);     break;
+        }
+#undef ROW
+    }
 
     return 0;
 }
@@ -264,6 +291,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     td.in = in;
     td.desc = desc;
     td.peak = peak;
+    init_curve_constants(s, &td);
     ff_filter_execute(ctx, tonemap_slice, &td, NULL,
                       FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
 
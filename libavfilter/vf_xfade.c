@@ -27,6 +27,7 @@
 #include "internal.h"
 #include "filters.h"
 #include "video.h"
+#include "xfade.h"
 
 enum XFadeTransitions {
     CUSTOM = -1,
@@ -101,6 +102,9 @@ typedef struct XFadeContext {
     int max_value;
     uint16_t black[4];
     uint16_t white[4];
+    float *noise;
+
+    XFadeDSPContext dsp;
 
     void (*transitionf)(AVFilterContext *ctx, const AVFrame *a, const AVFrame *b, AVFrame *out, float progress,
                         int slice_start, int slice_end, int jobnr);
@@ -141,6 +145,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     XFadeContext *s = ctx->priv;
 
     av_expr_free(s->e);
+    av_freep(&s->noise);
 }
 
 #define OFFSET(x) offsetof(XFadeContext, x)
@@ -260,154 +265,143 @@ static inline float smoothstep(float edge0, float edge1, float x)
     return t * t * (3.f - 2.f * t);
 }
 
-#define FADE_TRANSITION(name, type, div)                                             \
-static void fade##name##_transition(AVFilterContext *ctx,                            \
-                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = mix(xf0[x], xf1[x], progress);                              \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+static void blend8_c(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                     ptrdiff_t width, const float *c)
+{
+    for (int x = 0; x < width; x++)
+        dst[x] = (a[x] * c[0] + c[1]) * c[2] + (b[x] * c[3] + c[4]) * c[5];
 }
 
-FADE_TRANSITION(8, uint8_t, 1)
-FADE_TRANSITION(16, uint16_t, 2)
+static void blend16_c(uint8_t *dstp, const uint8_t *ap, const uint8_t *bp,
+                      ptrdiff_t width, const float *c)
+{
+    const uint16_t *a = (const uint16_t *)ap;
+    const uint16_t *b = (const uint16_t *)bp;
+    uint16_t *dst = (uint16_t *)dstp;
 
-#define WIPELEFT_TRANSITION(name, type, div)                                         \
-static void wipeleft##name##_transition(AVFilterContext *ctx,                        \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->width * progress;                                             \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf1[x] : xf0[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    for (int x = 0; x < width; x++)
+        dst[x] = (a[x] * c[0] + c[1]) * c[2] + (b[x] * c[3] + c[4]) * c[5];
 }
 
-WIPELEFT_TRANSITION(8, uint8_t, 1)
-WIPELEFT_TRANSITION(16, uint16_t, 2)
+av_cold void ff_xfade_init(XFadeDSPContext *dsp, int depth)
+{
+    dsp->blend = depth <= 8 ? blend8_c : blend16_c;
+}
 
-#define WIPERIGHT_TRANSITION(name, type, div)                                        \
-static void wiperight##name##_transition(AVFilterContext *ctx,                       \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,   \
-                                 float progress,                                     \
-                                 int slice_start, int slice_end, int jobnr)          \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->width * (1.f - progress);                                     \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf0[x] : xf1[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+/* Blend every plane of a slice with coefficients c[p], see XFadeDSPContext. */
+static void blend_planes(AVFilterContext *ctx,
+                         const AVFrame *a, const AVFrame *b, AVFrame *out,
+                         float c[4][6], int slice_start, int slice_end)
+{
+    XFadeContext *s = ctx->priv;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        const uint8_t *xf0 = a->data[p] + slice_start * a->linesize[p];
+        const uint8_t *xf1 = b->data[p] + slice_start * b->linesize[p];
+        uint8_t *dst = out->data[p] + slice_start * out->linesize[p];
+
+        for (int y = slice_start; y < slice_end; y++) {
+            s->dsp.blend(dst, xf0, xf1, out->width, c[p]);
+
+            dst += out->linesize[p];
+            xf0 += a->linesize[p];
+            xf1 += b->linesize[p];
+        }
+    }
 }
 
-WIPERIGHT_TRANSITION(8, uint8_t, 1)
-WIPERIGHT_TRANSITION(16, uint16_t, 2)
+static void fade_transition(AVFilterContext *ctx,
+                            const AVFrame *a, const AVFrame *b, AVFrame *out,
+                            float progress,
+                            int slice_start, int slice_end, int jobnr)
+{
+    float c[4][6];
+
+    /* mix(a, b, progress) */
+    for (int p = 0; p < 4; p++) {
+        c[p][0] = c[p][3] = 1.f;
+        c[p][1] = c[p][4] = 0.f;
+        c[p][2] = progress;
+        c[p][5] = 1.f - progress;
+    }
 
-#define WIPEUP_TRANSITION(name, type, div)                                           \
-static void wipeup##name##_transition(AVFilterContext *ctx,                          \
-                              const AVFrame *a, const AVFrame *b, AVFrame *out,      \
-                              float progress,                                        \
-                              int slice_start, int slice_end, int jobnr)             \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->height * progress;                                            \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf1[x] : xf0[x];                      \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    blend_planes(ctx, a, b, out, c, slice_start, slice_end);
 }
 
-WIPEUP_TRANSITION(8, uint8_t, 1)
-WIPEUP_TRANSITION(16, uint16_t, 2)
+/*
+ * Rows up to zh take their first n[0] samples from src[0] and the rest from
+ * src[1], the rows below zh take their first n[1] samples from src[2] and
+ * the rest from src[3].
+ */
+static void wipe_slice(AVFilterContext *ctx, AVFrame *out,
+                       const AVFrame *const src[4], const int n[2], int zh,
+                       int slice_start, int slice_end)
+{
+    XFadeContext *s = ctx->priv;
+    const int bps = 1 + (s->depth > 8);
+    const int width = out->width * bps;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const int i = y > zh;
+            const AVFrame *left = src[2 * i], *right = src[2 * i + 1];
+            const int split = n[i] * bps;
+            uint8_t *dst = out->data[p] + y * out->linesize[p];
+
+            memcpy(dst, left->data[p] + y * left->linesize[p], split);
+            memcpy(dst + split, right->data[p] + y * right->linesize[p] + split,
+                   width - split);
+        }
+    }
+}
 
-#define WIPEDOWN_TRANSITION(name, type, div)                                         \
-static void wipedown##name##_transition(AVFilterContext *ctx,                        \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->height * (1.f - progress);                                    \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf0[x] : xf1[x];                      \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+static void wipeleft_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->width * progress;
+    const AVFrame *const src[4] = { a, b, a, b };
+    const int n = FFMIN(z + 1, out->width);
+
+    wipe_slice(ctx, out, src, (const int[2]){ n, n }, INT_MAX, slice_start, slice_end);
 }
 
-WIPEDOWN_TRANSITION(8, uint8_t, 1)
-WIPEDOWN_TRANSITION(16, uint16_t, 2)
+static void wiperight_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->width * (1.f - progress);
+    const AVFrame *const src[4] = { b, a, b, a };
+    const int n = FFMIN(z + 1, out->width);
+
+    wipe_slice(ctx, out, src, (const int[2]){ n, n }, INT_MAX, slice_start, slice_end);
+}
+
+static void wipeup_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->height * progress;
+    const AVFrame *const src[4] = { a, a, b, b };
+
+    wipe_slice(ctx, out, src, (const int[2]){ out->width, out->width }, z,
+               slice_start, slice_end);
+}
+
+static void wipedown_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->height * (1.f - progress);
+    const AVFrame *const src[4] = { b, b, a, a };
+
+    wipe_slice(ctx, out, src, (const int[2]){ out->width, out->width }, z,
+               slice_start, slice_end);
+}
 
 #define SLIDELEFT_TRANSITION(name, type, div)                                        \
 static void slideleft##name##_transition(AVFilterContext *ctx,                       \
@@ -640,71 +634,50 @@ static void distance##name##_transition(AVFilterContext *ctx,
 DISTANCE_TRANSITION(8, uint8_t, 1)
 DISTANCE_TRANSITION(16, uint16_t, 2)
 
-#define FADEBLACK_TRANSITION(name, type, div)                                        \
-static void fadeblack##name##_transition(AVFilterContext *ctx,                       \
-                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const float phase = 0.2f;                                                        \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-        const int bg = s->black[p];                                                  \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = mix(mix(xf0[x], bg, smoothstep(1.f-phase, 1.f, progress)),  \
-                         mix(bg, xf1[x], smoothstep(phase, 1.f, progress)),          \
-                             progress);                                              \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+static void fadecolor_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress, const uint16_t *color,
+                                 int slice_start, int slice_end)
+{
+    const float phase = 0.2f;
+    const float s0 = smoothstep(1.f - phase, 1.f, progress);
+    const float s1 = smoothstep(phase, 1.f, progress);
+    float c[4][6];
+
+    /* mix(mix(a, color, s0), mix(color, b, s1), progress) */
+    for (int p = 0; p < 4; p++) {
+        const int bg = color[p];
+
+        c[p][0] = s0;
+        c[p][1] = bg * (1.f - s0);
+        c[p][2] = progress;
+        c[p][3] = 1.f - s1;
+        c[p][4] = bg * s1;
+        c[p][5] = 1.f - progress;
+    }
+
+    blend_planes(ctx, a, b, out, c, slice_start, slice_end);
 }
 
-FADEBLACK_TRANSITION(8, uint8_t, 1)
-FADEBLACK_TRANSITION(16, uint16_t, 2)
+static void fadeblack_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
 
-#define FADEWHITE_TRANSITION(name, type, div)                                        \
-static void fadewhite##name##_transition(AVFilterContext *ctx,                       \
-                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const float phase = 0.2f;                                                        \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-        const int bg = s->white[p];                                                  \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = mix(mix(xf0[x], bg, smoothstep(1.f-phase, 1.f, progress)),  \
-                         mix(bg, xf1[x], smoothstep(phase, 1.f, progress)),          \
-                             progress);                                              \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    fadecolor_transition(ctx, a, b, out, progress, s->black, slice_start, slice_end);
 }
 
-FADEWHITE_TRANSITION(8, uint8_t, 1)
-FADEWHITE_TRANSITION(16, uint16_t, 2)
+static void fadewhite_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+
+    fadecolor_transition(ctx, a, b, out, progress, s->white, slice_start, slice_end);
+}
 
 #define RADIAL_TRANSITION(name, type, div)                                           \
 static void radial##name##_transition(AVFilterContext *ctx,                          \
@@ -1027,13 +1000,15 @@ static void dissolve##name##_transition(AVFilterContext *ctx,
     const int width = out->width;                                                    \
                                                                                      \
     for (int y = slice_start; y < slice_end; y++) {                                  \
-        for (int x = 0; x < width; x++) {                                            \
-            const float smooth = frand(x, y) * 2.f + progress * 2.f - 1.5f;          \
-            for (int p = 0; p < s->nb_planes; p++) {                                 \
-                const type *xf0 = (const type *)(a->data[p] + y * a->linesize[p]);   \
-                const type *xf1 = (const type *)(b->data[p] + y * b->linesize[p]);   \
-                type *dst = (type *)(out->data[p] + y * out->linesize[p]);           \
+        const float *noise = s->noise + y * width;                                   \
                                                                                      \
+        for (int p = 0; p < s->nb_planes; p++) {                                     \
+            const type *xf0 = (const type *)(a->data[p] + y * a->linesize[p]);       \
+            const type *xf1 = (const type *)(b->data[p] + y * b->linesize[p]);       \
+            type *dst = (type *)(out->data[p] + y * out->linesize[p]);               \
+                                                                                     \
+            for (int x = 0; x < width; x++) {                                        \
+                const float smooth = noise[x] * 2.f + progress * 2.f - 1.5f;         \
                 dst[x] = smooth >= 0.5f ? xf0[x] : xf1[x];                           \
             }                                                                        \
         }                                                                            \
@@ -1423,134 +1398,58 @@ static void fadegrays##name##_transition(AVFilterContext *ctx,
 FADEGRAYS_TRANSITION(8, uint8_t, 1)
 FADEGRAYS_TRANSITION(16, uint16_t, 2)
 
-#define WIPETL_TRANSITION(name, type, div)                                           \
-static void wipetl##name##_transition(AVFilterContext *ctx,                          \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int zw = out->width * progress;                                            \
-    const int zh = out->height * progress;                                           \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y <= zh &&                                    \
-                         x <= zw ? xf0[x] : xf1[x];                                  \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+static void wipetl_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    const int zw = out->width * progress;
+    const int zh = out->height * progress;
+    const AVFrame *const src[4] = { a, b, b, b };
+
+    wipe_slice(ctx, out, src, (const int[2]){ FFMIN(zw + 1, out->width), 0 }, zh,
+               slice_start, slice_end);
 }
 
-WIPETL_TRANSITION(8, uint8_t, 1)
-WIPETL_TRANSITION(16, uint16_t, 2)
+static void wipetr_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    const int zw = out->width * (1.f - progress);
+    const int zh = out->height * progress;
+    const AVFrame *const src[4] = { b, a, b, b };
 
-#define WIPETR_TRANSITION(name, type, div)                                           \
-static void wipetr##name##_transition(AVFilterContext *ctx,                          \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int zw = out->width * (1.f - progress);                                    \
-    const int zh = out->height * progress;                                           \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y <= zh &&                                    \
-                         x > zw ? xf0[x] : xf1[x];                                   \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    wipe_slice(ctx, out, src, (const int[2]){ FFMIN(zw + 1, out->width), 0 }, zh,
+               slice_start, slice_end);
 }
 
-WIPETR_TRANSITION(8, uint8_t, 1)
-WIPETR_TRANSITION(16, uint16_t, 2)
+static void wipebl_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    const int zw = out->width * progress;
+    const int zh = out->height * (1.f - progress);
+    const AVFrame *const src[4] = { b, b, a, b };
 
-#define WIPEBL_TRANSITION(name, type, div)                                           \
-static void wipebl##name##_transition(AVFilterContext *ctx,                          \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int zw = out->width * progress;                                            \
-    const int zh = out->height * (1.f - progress);                                   \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > zh &&                                     \
-                         x <= zw ? xf0[x] : xf1[x];                                  \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    wipe_slice(ctx, out, src, (const int[2]){ 0, FFMIN(zw + 1, out->width) }, zh,
+               slice_start, slice_end);
 }
 
-WIPEBL_TRANSITION(8, uint8_t, 1)
-WIPEBL_TRANSITION(16, uint16_t, 2)
+static void wipebr_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    const int zh = out->height * (1.f - progress);
+    const int zw = out->width * (1.f - progress);
+    const AVFrame *const src[4] = { b, b, b, a };
 
-#define WIPEBR_TRANSITION(name, type, div)                                           \
-static void wipebr##name##_transition(AVFilterContext *ctx,                          \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int zh = out->height * (1.f - progress);                                   \
-    const int zw = out->width * (1.f - progress);                                    \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > zh &&                                     \
-                         x > zw ? xf0[x] : xf1[x];                                   \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    wipe_slice(ctx, out, src, (const int[2]){ 0, FFMIN(zw + 1, out->width) }, zh,
+               slice_start, slice_end);
 }
 
-WIPEBR_TRANSITION(8, uint8_t, 1)
-WIPEBR_TRANSITION(16, uint16_t, 2)
-
 #define SQUEEZEH_TRANSITION(name, type, div)                                         \
 static void squeezeh##name##_transition(AVFilterContext *ctx,                        \
                                 const AVFrame *a, const AVFrame *b, AVFrame *out,    \
@@ -1772,11 +1671,11 @@ static int config_output(AVFilterLink *outlink)
 
     switch (s->transition) {
     case CUSTOM:     s->transitionf = s->depth <= 8 ? custom8_transition     : custom16_transition;     break;
-    case FADE:       s->transitionf = s->depth <= 8 ? fade8_transition       : fade16_transition;       break;
-    case WIPELEFT:   s->transitionf = s->depth <= 8 ? wipeleft8_transition   : wipeleft16_transition;   break;
-    case WIPERIGHT:  s->transitionf = s->depth <= 8 ? wiperight8_transition  : wiperight16_transition;  break;
-    case WIPEUP:     s->transitionf = s->depth <= 8 ? wipeup8_transition     : wipeup16_transition;     break;
-    case WIPEDOWN:   s->transitionf = s->depth <= 8 ? wipedown8_transition   : wipedown16_transition;   break;
+    case FADE:       s->transitionf = fade_transition;                                                  break;
+    case WIPELEFT:   s->transitionf = wipeleft_transition;                                              break;
+    case WIPERIGHT:  s->transitionf = wiperight_transition;                                             break;
+    case WIPEUP:     s->transitionf = wipeup_transition;                                                break;
+    case WIPEDOWN:   s->transitionf = wipedown_transition;                                              break;
     case SLIDELEFT:  s->transitionf = s->depth <= 8 ? slideleft8_transition  : slideleft16_transition;  break;
     case SLIDERIGHT: s->transitionf = s->depth <= 8 ? slideright8_transition : slideright16_transition; break;
     case SLIDEUP:    s->transitionf = s->depth <= 8 ? slideup8_transition    : slideup16_transition;    break;
@@ -1784,8 +1683,8 @@ static int config_output(AVFilterLink *outlink)
     case CIRCLECROP: s->transitionf = s->depth <= 8 ? circlecrop8_transition : circlecrop16_transition; break;
     case RECTCROP:   s->transitionf = s->depth <= 8 ? rectcrop8_transition   : rectcrop16_transition;   break;
     case DISTANCE:   s->transitionf = s->depth <= 8 ? distance8_transition   : distance16_transition;   break;
-    case FADEBLACK:  s->transitionf = s->depth <= 8 ? fadeblack8_transition  : fadeblack16_transition;  break;
-    case FADEWHITE:  s->transitionf = s->depth <= 8 ? fadewhite8_transition  : fadewhite16_transition;  break;
+    case FADEBLACK:  s->transitionf = fadeblack_transition;                                             break;
+    case FADEWHITE:  s->transitionf = fadewhite_transition;                                             break;
     case RADIAL:     s->transitionf = s->depth <= 8 ? radial8_transition     : radial16_transition;     break;
     case SMOOTHLEFT: s->transitionf = s->depth <= 8 ? smoothleft8_transition : smoothleft16_transition; break;
     case SMOOTHRIGHT:s->transitionf = s->depth <= 8 ? smoothright8_transition: smoothright16_transition;break;
@@ -1809,16 +1708,28 @@ static int config_output(AVFilterLink *outlink)
     case VDSLICE:    s->transitionf = s->depth <= 8 ? vdslice8_transition    : vdslice16_transition;    break;
     case HBLUR:      s->transitionf = s->depth <= 8 ? hblur8_transition      : hblur16_transition;      break;
     case FADEGRAYS:  s->transitionf = s->depth <= 8 ? fadegrays8_transition  : fadegrays16_transition;  break;
-    case WIPETL:     s->transitionf = s->depth <= 8 ? wipetl8_transition     : wipetl16_transition;     break;
-    case WIPETR:     s->transitionf = s->depth <= 8 ? wipetr8_transition     : wipetr16_transition;     break;
-    case WIPEBL:     s->transitionf = s->depth <= 8 ? wipebl8_transition     : wipebl16_transition;     break;
-    case WIPEBR:     s->transitionf = s->depth <= 8 ? wipebr8_transition     : wipebr16_transition;     break;
+    case WIPETL:     s->transitionf = wipetl_transition;                                                break;
+    case WIPETR:     s->transitionf = wipetr_transition;                                                break;
+    case WIPEBL:     s->transitionf = wipebl_transition;                                                break;
+    case WIPEBR:     s->transitionf = wipebr_transition;                                                break;
     case SQUEEZEH:   s->transitionf = s->depth <= 8 ? squeezeh8_transition   : squeezeh16_transition;   break;
     case SQUEEZEV:   s->transitionf = s->depth <= 8 ? squeezev8_transition   : squeezev16_transition;   break;
     case ZOOMIN:     s->transitionf = s->depth <= 8 ? zoomin8_transition     : zoomin16_transition;     break;
     default: return AVERROR_BUG;
     }
 
+    ff_xfade_init(&s->dsp, s->depth);
+
+    if (s->transition == DISSOLVE) {
+        av_freep(&s->noise);
+        s->noise = av_malloc_array(outlink->w * outlink->h, sizeof(*s->noise));
+        if (!s->noise)
+            return AVERROR(ENOMEM);
+        for (int y = 0; y < outlink->h; y++)
+            for (int x = 0; x < outlink->w; x++)
+                s->noise[y * outlink->w + x] = frand(x, y);
+    }
+
     if (s->transition == CUSTOM) {
         static const char *const func2_names[]    = {
             "a0", "a1", "a2", "a3",
@@ -1933,8 +1844,15 @@ static int xfade_activate(AVFilterContext *ctx)
 
         s->last_pts = s->xf[1]->pts;
         s->pts = s->xf[0]->pts;
-        if (s->xf[0]->pts - (s->first_pts + s->offset_pts) > s->duration_pts)
+        if (s->xf[0]->pts - (s->first_pts + s->offset_pts) > s->duration_pts) {
+            /* past the end of the transition, pass the second input through */
             s->xfade_is_over = 1;
+            in = s->xf[1];
+            s->xf[1] = NULL;
+            in->pts = s->pts;
+            av_frame_free(&s->xf[0]);
+            return ff_filter_frame(outlink, in);
+        }
         ret = xfade_frame(ctx, s->xf[0], s->xf[1]);
         av_frame_free(&s->xf[0]);
         av_frame_free(&s->xf[1]);
@@ -44,6 +44,7 @@
 #include "libavutil/imgutils.h"
 
 #define ZIMG_ALIGNMENT 32
+#define MAX_THREADS 32
 
 static const char *const var_names[] = {
     "in_w",   "iw",
@@ -113,13 +114,20 @@ typedef struct ZScaleContext {
 
     int force_original_aspect_ratio;
 
-    void *tmp;
-    size_t tmp_size;
+    /* one graph and temporary buffer per slice, processed by one thread each */
+    int nb_slices;
+    int jobs_ret[MAX_THREADS];
+    int out_slice_start[MAX_THREADS];
+    int out_slice_end[MAX_THREADS];
+    int in_slice_start[MAX_THREADS];
+    int in_slice_end[MAX_THREADS];
+    void *tmp[MAX_THREADS];
+    size_t tmp_size[MAX_THREADS];
 
     zimg_image_format src_format, dst_format;
     zimg_image_format alpha_src_format, alpha_dst_format;
     zimg_graph_builder_params alpha_params, params;
-    zimg_filter_graph *alpha_graph, *graph;
+    zimg_filter_graph *alpha_graph[MAX_THREADS], *graph[MAX_THREADS];
 
     enum AVColorSpace in_colorspace, out_colorspace;
     enum AVColorTransferCharacteristic in_trc, out_trc;
@@ -489,7 +497,7 @@ static void format_init(zimg_image_format *format, AVFrame *frame, const AVPixFm
 }
 
 static int graph_build(zimg_filter_graph **graph, zimg_graph_builder_params *params,
-                       zimg_image_format *src_format, zimg_image_format *dst_format,
+                       const zimg_image_format *src_format, const zimg_image_format *dst_format,
                        void **tmp, size_t *tmp_size)
 {
     int ret;
@@ -516,6 +524,74 @@ static int graph_build(zimg_filter_graph **graph, zimg_graph_builder_params *par
     return 0;
 }
 
+/**
+ * Split the output into horizontal slices. The slices start on output rows
+ * which are aligned to the chroma subsampling and fall on integer input rows
+ * of all planes, so that each slice, processed as an active region of the
+ * whole input, uses the same filter taps as the whole frame. The taps read
+ * the input rows around the region, which are not copied.
+ */
+static void slice_params(AVFilterContext *ctx, const AVPixFmtDescriptor *desc,
+                         const AVPixFmtDescriptor *odesc, int in_h, int out_h)
+{
+    ZScaleContext *s = ctx->priv;
+    int64_t out_align = 1 << odesc->log2_chroma_h;
+    int64_t in_unit   = (int64_t)out_h << desc->log2_chroma_h;
+    int64_t unit, nb_units;
+    int i, nb_slices;
+
+    /* smallest output row y with y * in_h a multiple of in_unit */
+    unit = in_unit / av_gcd(in_h, in_unit);
+    unit = unit / av_gcd(unit, out_align) * out_align;
+    nb_units = out_h / unit;
+
+    nb_slices = FFMIN(ff_filter_get_nb_threads(ctx), MAX_THREADS);
+    /* the dither patterns and error diffusion depend on the slice origin */
+    if (s->dither != ZIMG_DITHER_NONE)
+        nb_slices = 1;
+    nb_slices = FFMAX(FFMIN(nb_slices, nb_units), 1);
+
+    for (i = 0; i < nb_slices; i++) {
+        s->out_slice_start[i] = nb_units * i / nb_slices * unit;
+        s->out_slice_end[i]   = i + 1 < nb_slices ? nb_units * (i + 1) / nb_slices * unit : out_h;
+        s->in_slice_start[i]  = (int64_t)s->out_slice_start[i] * in_h / out_h;
+        s->in_slice_end[i]    = i + 1 < nb_slices ? (int64_t)s->out_slice_end[i] * in_h / out_h : in_h;
+    }
+    s->nb_slices = nb_slices;
+}
+
+static int graphs_build(AVFilterContext *ctx, zimg_filter_graph **graphs,
+                        zimg_graph_builder_params *params,
+                        const zimg_image_format *src_format,
+                        const zimg_image_format *dst_format)
+{
+    ZScaleContext *s = ctx->priv;
+    int i, ret;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        zimg_image_format src_slice = *src_format;
+        zimg_image_format dst_slice = *dst_format;
+
+        if (s->nb_slices > 1) {
+            src_slice.active_region.left   = 0;
+            src_slice.active_region.top    = s->in_slice_start[i];
+            src_slice.active_region.width  = src_format->width;
+            src_slice.active_region.height = s->in_slice_end[i] - s->in_slice_start[i];
+            dst_slice.height = s->out_slice_end[i] - s->out_slice_start[i];
+        }
+        ret = graph_build(&graphs[i], params, &src_slice, &dst_slice,
+                          &s->tmp[i], &s->tmp_size[i]);
+        if (ret < 0)
+            return ret;
+    }
+    for (; i < MAX_THREADS; i++) {
+        zimg_filter_graph_free(graphs[i]);
+        graphs[i] = NULL;
+    }
+
+    return 0;
+}
+
 static int realign_frame(const AVPixFmtDescriptor *desc, AVFrame **frame)
 {
     AVFrame *aligned = NULL;
@@ -572,17 +648,67 @@ static void update_output_color_information(ZScaleContext *s, AVFrame *frame)
         frame->chroma_location = (int)s->dst_format.chroma_location + 1;
 }
 
+typedef struct ThreadData {
+    const AVPixFmtDescriptor *desc, *odesc;
+    AVFrame *in, *out;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ZScaleContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const AVPixFmtDescriptor *desc = td->desc;
+    const AVPixFmtDescriptor *odesc = td->odesc;
+    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
+    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+    int out_y = s->out_slice_start[jobnr];
+    int plane, ret;
+
+    for (plane = 0; plane < 3; plane++) {
+        int p = desc->comp[plane].plane;
+        int y = out_y >> (plane ? odesc->log2_chroma_h : 0);
+
+        src_buf.plane[plane].data   = td->in->data[p];
+        src_buf.plane[plane].stride = td->in->linesize[p];
+        src_buf.plane[plane].mask   = -1;
+
+        p = odesc->comp[plane].plane;
+        dst_buf.plane[plane].data   = td->out->data[p] + y * td->out->linesize[p];
+        dst_buf.plane[plane].stride = td->out->linesize[p];
+        dst_buf.plane[plane].mask   = -1;
+    }
+
+    ret = zimg_filter_graph_process(s->graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+    if (ret)
+        return print_zimg_error(ctx);
+
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+        src_buf.plane[0].data   = td->in->data[3];
+        src_buf.plane[0].stride = td->in->linesize[3];
+        src_buf.plane[0].mask   = -1;
+
+        dst_buf.plane[0].data   = td->out->data[3] + out_y * td->out->linesize[3];
+        dst_buf.plane[0].stride = td->out->linesize[3];
+        dst_buf.plane[0].mask   = -1;
+
+        ret = zimg_filter_graph_process(s->alpha_graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+        if (ret)
+            return print_zimg_error(ctx);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ZScaleContext *s = link->dst->priv;
     AVFilterLink *outlink = link->dst->outputs[0];
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
-    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
-    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
     char buf[32];
-    int ret = 0, plane;
+    int ret = 0, i;
     AVFrame *out = NULL;
+    ThreadData td;
 
     if ((ret = realign_frame(desc, &in)) < 0)
         goto fail;
@@ -641,8 +767,9 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
         update_output_color_information(s, out);
 
-        ret = graph_build(&s->graph, &s->params, &s->src_format, &s->dst_format,
-                          &s->tmp, &s->tmp_size);
+        slice_params(link->dst, desc, odesc, in->height, out->height);
+
+        ret = graphs_build(link->dst, s->graph, &s->params, &s->src_format, &s->dst_format);
         if (ret < 0)
             goto fail;
 
@@ -676,12 +803,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             s->alpha_dst_format.pixel_type = (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) ? ZIMG_PIXEL_FLOAT : odesc->comp[0].depth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
             s->alpha_dst_format.color_family = ZIMG_COLOR_GREY;
 
-            zimg_filter_graph_free(s->alpha_graph);
-            s->alpha_graph = zimg_filter_graph_build(&s->alpha_src_format, &s->alpha_dst_format, &s->alpha_params);
-            if (!s->alpha_graph) {
-                ret = print_zimg_error(link->dst);
+            ret = graphs_build(link->dst, s->alpha_graph, &s->alpha_params,
+                               &s->alpha_src_format, &s->alpha_dst_format);
+            if (ret < 0)
                 goto fail;
-            }
         }
     }
 
@@ -692,39 +817,19 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
               (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
               INT_MAX);
 
-    for (plane = 0; plane < 3; plane++) {
-        int p = desc->comp[plane].plane;
-        src_buf.plane[plane].data   = in->data[p];
-        src_buf.plane[plane].stride = in->linesize[p];
-        src_buf.plane[plane].mask   = -1;
-
-        p = odesc->comp[plane].plane;
-        dst_buf.plane[plane].data   = out->data[p];
-        dst_buf.plane[plane].stride = out->linesize[p];
-        dst_buf.plane[plane].mask   = -1;
-    }
-
-    ret = zimg_filter_graph_process(s->graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-    if (ret) {
-        ret = print_zimg_error(link->dst);
-        goto fail;
-    }
-
-    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
-        src_buf.plane[0].data   = in->data[3];
-        src_buf.plane[0].stride = in->linesize[3];
-        src_buf.plane[0].mask   = -1;
-
-        dst_buf.plane[0].data   = out->data[3];
-        dst_buf.plane[0].stride = out->linesize[3];
-        dst_buf.plane[0].mask   = -1;
-
-        ret = zimg_filter_graph_process(s->alpha_graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-        if (ret) {
-            ret = print_zimg_error(link->dst);
+    td.desc  = desc;
+    td.odesc = odesc;
+    td.in    = in;
+    td.out   = out;
+    ff_filter_execute(link->dst, filter_slice, &td, s->jobs_ret, s->nb_slices);
+    for (i = 0; i < s->nb_slices; i++) {
+        if (s->jobs_ret[i] < 0) {
+            ret = s->jobs_ret[i];
             goto fail;
         }
-    } else if (odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+    }
+
+    if (!(desc->flags & AV_PIX_FMT_FLAG_ALPHA) && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
         int x, y;
 
         if (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) {
@@ -754,10 +859,14 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     ZScaleContext *s = ctx->priv;
 
-    zimg_filter_graph_free(s->graph);
-    zimg_filter_graph_free(s->alpha_graph);
-    av_freep(&s->tmp);
-    s->tmp_size = 0;
+    int i;
+
+    for (i = 0; i < MAX_THREADS; i++) {
+        zimg_filter_graph_free(s->graph[i]);
+        zimg_filter_graph_free(s->alpha_graph[i]);
+        av_freep(&s->tmp[i]);
+        s->tmp_size[i] = 0;
+    }
 }
 
 static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
@@ -941,4 +1050,5 @@ const AVFilter ff_vf_zscale = {
     FILTER_OUTPUTS(avfilter_vf_zscale_outputs),
     FILTER_QUERY_FUNC(query_formats),
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -40,6 +40,16 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
+static FFFramePool *video_pool_init(AVFilterLink *link, int w, int h)
+{
+    if (link->graph)
+        return ff_frame_pool_video_get_shared(&link->graph->internal->frame_pools,
+                                              av_buffer_allocz, w, h,
+                                              link->format, BUFFER_ALIGN);
+    return ff_frame_pool_video_init(av_buffer_allocz, w, h,
+                                    link->format, BUFFER_ALIGN);
+}
+
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *frame = NULL;
@@ -64,8 +74,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     }
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                    link->format, BUFFER_ALIGN);
+        link->frame_pool = video_pool_init(link, w, h);
         if (!link->frame_pool)
             return NULL;
     } else {
@@ -79,8 +88,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             pool_format != link->format || pool_align != BUFFER_ALIGN) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                        link->format, BUFFER_ALIGN);
+            link->frame_pool = video_pool_init(link, w, h);
             if (!link->frame_pool)
                 return NULL;
         }
@@ -109,3 +117,21 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 
     return ret;
 }
+
+AVFrame *ff_get_video_buffer_inplace(AVFilterLink *link, AVFrame *in)
+{
+    AVFrame *out;
+
+    if (av_frame_is_writable(in) && !in->hw_frames_ctx &&
+        in->format == link->format && in->width == link->w && in->height == link->h)
+        return av_frame_clone(in);
+
+    out = ff_get_video_buffer(link, link->w, link->h);
+    if (!out)
+        return NULL;
+    if (av_frame_copy_props(out, in) < 0) {
+        av_frame_free(&out);
+        return NULL;
+    }
+    return out;
+}
@@ -37,4 +37,20 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h);
  */
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h);
 
+/**
+ * Get the output frame of a filter that can process a frame in place,
+ * i.e. reads each sample of the input before writing the same sample of
+ * the output.
+ *
+ * If in is writable and has the format and dimensions of the output link,
+ * the returned frame references the buffers of in, otherwise it is a new
+ * frame of the link. In both cases, it has the properties of in and in must
+ * still be freed by the caller.
+ *
+ * @param link  the output link of the filter
+ * @param in    the input frame
+ * @return      on success, an AVFrame owned by the caller, NULL on error
+ */
+AVFrame *ff_get_video_buffer_inplace(AVFilterLink *link, AVFrame *in);
+
 #endif /* AVFILTER_VIDEO_H */
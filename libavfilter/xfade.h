@@ -0,0 +1,38 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_XFADE_H
+#define AVFILTER_XFADE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct XFadeDSPContext {
+    /**
+     * Blend one row of two planes:
+     * dst[x] = (a[x] * c[0] + c[1]) * c[2] + (b[x] * c[3] + c[4]) * c[5],
+     * evaluated in single precision and truncated. Samples are 8 bit for
+     * depth 8 and native endian 16 bit otherwise.
+     */
+    void (*blend)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                  ptrdiff_t width, const float *c);
+} XFadeDSPContext;
+
+void ff_xfade_init(XFadeDSPContext *dsp, int depth);
+
+#endif /* AVFILTER_XFADE_H */
@@ -32,6 +32,7 @@
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/log.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "url.h"
@@ -53,6 +54,25 @@ typedef struct RingBuffer
     int           read_pos;
 } RingBuffer;
 
+enum RangeState {
+    RANGE_EMPTY,
+    RANGE_PENDING,
+    RANGE_LOADING,
+    RANGE_READY,
+};
+
+/* A range of the resource kept apart from the read-ahead FIFO, e.g. the
+ * header or the index at the end of a file, so that a demuxer jumping
+ * between them and the essence does not refill the FIFO every time. */
+typedef struct CachedRange {
+    enum RangeState state;
+    int64_t         start;
+    int             size;
+    uint8_t        *data;
+    unsigned int    allocated;
+    uint64_t        last_use;
+} CachedRange;
+
 typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
@@ -70,6 +90,14 @@ typedef struct Context {
     int64_t         logical_pos;
     int64_t         logical_size;
     RingBuffer      ring;
+    /* position of the FIFO read pointer, differs from logical_pos while
+     * reading from a cached range */
+    int64_t         ring_pos;
+    /* only accessed by the background thread */
+    int64_t         inner_pos;
+
+    CachedRange    *ranges;
+    uint64_t        range_uses;
 
     pthread_cond_t  cond_wakeup_main;
     pthread_cond_t  cond_wakeup_background;
@@ -78,6 +106,12 @@ typedef struct Context {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    int             buffer_size;
+    int             head_size;
+    int             tail_size;
+    int             nb_ranges;
+    int             max_range_size;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -169,10 +203,41 @@ static int wrapped_url_read(void *src, void *dst, int size)
 
     ret = ffurl_read(c->inner, dst, size);
     c->inner_io_error = ret < 0 ? ret : 0;
+    if (ret > 0)
+        c->inner_pos += ret;
 
     return ret;
 }
 
+static int load_pending_range(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CachedRange *r = NULL;
+    int64_t seek_ret;
+    int ret = -1;
+
+    for (int i = 0; i < c->nb_ranges && !r; i++)
+        if (c->ranges[i].state == RANGE_PENDING)
+            r = &c->ranges[i];
+    if (!r)
+        return 0;
+
+    r->state = RANGE_LOADING;
+    pthread_mutex_unlock(&c->mutex);
+
+    seek_ret = ffurl_seek(c->inner, r->start, SEEK_SET);
+    c->inner_pos = seek_ret;
+    if (seek_ret == r->start) {
+        ret = ffurl_read_complete(c->inner, r->data, r->size);
+        c->inner_pos += FFMAX(ret, 0);
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    r->state = ret == r->size ? RANGE_READY : RANGE_EMPTY;
+    pthread_cond_signal(&c->cond_wakeup_main);
+    return 1;
+}
+
 static void *async_buffer_task(void *arg)
 {
     URLContext   *h    = arg;
@@ -183,6 +248,7 @@ static void *async_buffer_task(void *arg)
 
     while (1) {
         int fifo_space, to_copy;
+        int64_t fifo_end;
 
         pthread_mutex_lock(&c->mutex);
         if (async_check_interrupt(h)) {
@@ -198,6 +264,8 @@ static void *async_buffer_task(void *arg)
             if (seek_ret >= 0) {
                 c->io_eof_reached = 0;
                 c->io_error       = 0;
+                c->inner_pos      = seek_ret;
+                c->ring_pos       = seek_ret;
                 ring_reset(ring);
             }
 
@@ -211,6 +279,13 @@ static void *async_buffer_task(void *arg)
             continue;
         }
 
+        /* Cached ranges are requested ahead of their use, so they take
+         * precedence over filling the FIFO. */
+        if (load_pending_range(h)) {
+            pthread_mutex_unlock(&c->mutex);
+            continue;
+        }
+
         fifo_space = ring_space(ring);
         if (c->io_eof_reached || fifo_space <= 0) {
             pthread_cond_signal(&c->cond_wakeup_main);
@@ -218,10 +293,19 @@ static void *async_buffer_task(void *arg)
             pthread_mutex_unlock(&c->mutex);
             continue;
         }
+        fifo_end = c->ring_pos + ring_size(ring);
         pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        /* Loading a range moved the inner position away from the FIFO. */
+        if (c->inner_pos != fifo_end) {
+            seek_ret = ffurl_seek(c->inner, fifo_end, SEEK_SET);
+            c->inner_pos = seek_ret;
+            ret = seek_ret < 0 ? seek_ret : 1;
+            c->inner_io_error = ret < 0 ? ret : 0;
+        } else {
+            to_copy = FFMIN(4096, fifo_space);
+            ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        }
 
         pthread_mutex_lock(&c->mutex);
         if (ret <= 0) {
@@ -237,6 +321,66 @@ static void *async_buffer_task(void *arg)
     return NULL;
 }
 
+static void free_ranges(Context *c)
+{
+    for (int i = 0; c->ranges && i < c->nb_ranges; i++)
+        av_freep(&c->ranges[i].data);
+    av_freep(&c->ranges);
+}
+
+static CachedRange *find_range(Context *c, int64_t pos)
+{
+    for (int i = 0; i < c->nb_ranges; i++) {
+        CachedRange *r = &c->ranges[i];
+        if (r->state != RANGE_EMPTY && r->start <= pos && pos < r->start + r->size)
+            return r;
+    }
+    return NULL;
+}
+
+/* Must be called with the mutex held once the background thread runs. */
+static int queue_range(URLContext *h, int64_t start, int64_t size)
+{
+    Context     *c = h->priv_data;
+    CachedRange *r = NULL;
+
+    if (c->logical_size > 0)
+        size = FFMIN(size, c->logical_size - start);
+    size = FFMIN(size, c->max_range_size);
+    if (start < 0 || size <= 0)
+        return 0;
+
+    for (int i = 0; i < c->nb_ranges; i++) {
+        CachedRange *cur = &c->ranges[i];
+        if (cur->state != RANGE_EMPTY && cur->start <= start &&
+            start + size <= cur->start + cur->size)
+            return 0;
+        /* replace the least recently used range if none is free */
+        if (cur->state == RANGE_EMPTY) {
+            if (!r || r->state != RANGE_EMPTY)
+                r = cur;
+        } else if (cur->state == RANGE_READY &&
+                   (!r || r->state == RANGE_READY && cur->last_use < r->last_use))
+            r = cur;
+    }
+    if (!r)
+        return 0;
+
+    av_fast_malloc(&r->data, &r->allocated, size);
+    if (!r->data) {
+        r->state = RANGE_EMPTY;
+        return AVERROR(ENOMEM);
+    }
+    av_log(h, AV_LOG_TRACE, "async: caching %"PRId64" bytes at %"PRId64"\n", size, start);
+    r->start    = start;
+    r->size     = size;
+    r->state    = RANGE_PENDING;
+    r->last_use = ++c->range_uses;
+    pthread_cond_signal(&c->cond_wakeup_background);
+
+    return 0;
+}
+
 static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     Context         *c = h->priv_data;
@@ -245,7 +389,7 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    ret = ring_init(&c->ring, c->buffer_size, READ_BACK_CAPACITY);
     if (ret < 0)
         goto fifo_fail;
 
@@ -260,6 +404,15 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
     c->logical_size = ffurl_size(c->inner);
     h->is_streamed  = c->inner->is_streamed;
 
+    if (c->nb_ranges && !h->is_streamed) {
+        c->ranges = av_calloc(c->nb_ranges, sizeof(*c->ranges));
+        if (!c->ranges) {
+            ret = AVERROR(ENOMEM);
+            goto mutex_fail;
+        }
+    } else
+        c->nb_ranges = 0;
+
     ret = pthread_mutex_init(&c->mutex, NULL);
     if (ret != 0) {
         ret = AVERROR(ret);
@@ -281,6 +434,11 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
         goto cond_wakeup_background_fail;
     }
 
+    if (c->head_size)
+        queue_range(h, 0, c->head_size);
+    if (c->tail_size && c->logical_size > 0)
+        queue_range(h, FFMAX(c->logical_size - c->tail_size, 0), c->tail_size);
+
     ret = pthread_create(&c->async_buffer_thread, NULL, async_buffer_task, h);
     if (ret) {
         ret = AVERROR(ret);
@@ -297,6 +455,7 @@ cond_wakeup_background_fail:
 cond_wakeup_main_fail:
     pthread_mutex_destroy(&c->mutex);
 mutex_fail:
+    free_ranges(c);
     ffurl_closep(&c->inner);
 url_fail:
     ring_destroy(&c->ring);
@@ -321,6 +480,7 @@ static int async_close(URLContext *h)
     pthread_cond_destroy(&c->cond_wakeup_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
+    free_ranges(c);
     ffurl_closep(&c->inner);
     ring_destroy(&c->ring);
 
@@ -350,6 +510,7 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
             if (!func)
                 dest = (uint8_t *)dest + to_copy;
             c->logical_pos += to_copy;
+            c->ring_pos    += to_copy;
             to_read        -= to_copy;
             ret             = size - to_read;
 
@@ -374,59 +535,71 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
     return ret;
 }
 
-static int async_read(URLContext *h, unsigned char *buf, int size)
+static int read_range(URLContext *h, unsigned char *buf, int size)
 {
-    return async_read_internal(h, buf, size, 0, NULL);
+    Context     *c   = h->priv_data;
+    CachedRange *r;
+    int          ret = 0;
+
+    if (!c->nb_ranges)
+        return 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while ((r = find_range(c, c->logical_pos))) {
+        if (r->state == RANGE_READY) {
+            ret = FFMIN(size, r->start + r->size - c->logical_pos);
+            memcpy(buf, r->data + (c->logical_pos - r->start), ret);
+            c->logical_pos += ret;
+            r->last_use     = ++c->range_uses;
+            break;
+        }
+        if (async_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
 }
 
 static void fifo_do_not_copy_func(void* dest, void* src, int size) {
     // do not copy
 }
 
-static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+/* Move the FIFO to new_logical_pos and continue reading from it there. */
+static int64_t seek_ring(URLContext *h, int64_t new_logical_pos)
 {
     Context      *c    = h->priv_data;
     RingBuffer   *ring = &c->ring;
     int64_t       ret;
-    int64_t       new_logical_pos;
     int fifo_size;
     int fifo_size_of_read_back;
 
-    if (whence == AVSEEK_SIZE) {
-        av_log(h, AV_LOG_TRACE, "async_seek: AVSEEK_SIZE: %"PRId64"\n", (int64_t)c->logical_size);
-        return c->logical_size;
-    } else if (whence == SEEK_CUR) {
-        av_log(h, AV_LOG_TRACE, "async_seek: %"PRId64"\n", pos);
-        new_logical_pos = pos + c->logical_pos;
-    } else if (whence == SEEK_SET){
-        av_log(h, AV_LOG_TRACE, "async_seek: %"PRId64"\n", pos);
-        new_logical_pos = pos;
-    } else {
-        return AVERROR(EINVAL);
-    }
-    if (new_logical_pos < 0)
-        return AVERROR(EINVAL);
-
     fifo_size = ring_size(ring);
     fifo_size_of_read_back = ring_size_of_read_back(ring);
-    if (new_logical_pos == c->logical_pos) {
+    if (new_logical_pos == c->ring_pos) {
         /* current position */
+        c->logical_pos = c->ring_pos;
         return c->logical_pos;
-    } else if ((new_logical_pos >= (c->logical_pos - fifo_size_of_read_back)) &&
-               (new_logical_pos < (c->logical_pos + fifo_size + SHORT_SEEK_THRESHOLD))) {
-        int pos_delta = (int)(new_logical_pos - c->logical_pos);
+    } else if ((new_logical_pos >= (c->ring_pos - fifo_size_of_read_back)) &&
+               (new_logical_pos < (c->ring_pos + fifo_size + SHORT_SEEK_THRESHOLD))) {
+        int pos_delta = (int)(new_logical_pos - c->ring_pos);
         /* fast seek */
         av_log(h, AV_LOG_TRACE, "async_seek: fask_seek %"PRId64" from %d dist:%d/%d\n",
-                new_logical_pos, (int)c->logical_pos,
-                (int)(new_logical_pos - c->logical_pos), fifo_size);
+                new_logical_pos, (int)c->ring_pos,
+                (int)(new_logical_pos - c->ring_pos), fifo_size);
 
+        c->logical_pos = c->ring_pos;
         if (pos_delta > 0) {
             // fast seek forwards
             async_read_internal(h, NULL, pos_delta, 1, fifo_do_not_copy_func);
         } else {
             // fast seek backwards
             ring_drain(ring, pos_delta);
-            c->logical_pos = new_logical_pos;
+            c->logical_pos = c->ring_pos = new_logical_pos;
         }
 
         return c->logical_pos;
@@ -466,10 +639,81 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     return ret;
 }
 
+static int async_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c = h->priv_data;
+    int64_t  ret;
+
+    ret = read_range(h, buf, size);
+    if (ret)
+        return ret;
+
+    if (c->logical_pos != c->ring_pos) {
+        ret = seek_ring(h, c->logical_pos);
+        if (ret < 0)
+            return ret;
+    }
+
+    return async_read_internal(h, buf, size, 0, NULL);
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context      *c    = h->priv_data;
+    int64_t       new_logical_pos;
+    CachedRange  *r;
+
+    if (whence == AVSEEK_SIZE) {
+        av_log(h, AV_LOG_TRACE, "async_seek: AVSEEK_SIZE: %"PRId64"\n", (int64_t)c->logical_size);
+        return c->logical_size;
+    } else if (whence == SEEK_CUR) {
+        av_log(h, AV_LOG_TRACE, "async_seek: %"PRId64"\n", pos);
+        new_logical_pos = pos + c->logical_pos;
+    } else if (whence == SEEK_SET){
+        av_log(h, AV_LOG_TRACE, "async_seek: %"PRId64"\n", pos);
+        new_logical_pos = pos;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    if (new_logical_pos < 0)
+        return AVERROR(EINVAL);
+
+    if (new_logical_pos == c->logical_pos)
+        return c->logical_pos;
+
+    /* Seeks into a cached range leave the FIFO where it is. */
+    pthread_mutex_lock(&c->mutex);
+    r = find_range(c, new_logical_pos);
+    if (r)
+        c->logical_pos = new_logical_pos;
+    pthread_mutex_unlock(&c->mutex);
+    if (r)
+        return new_logical_pos;
+
+    return seek_ring(h, new_logical_pos);
+}
+
+static int async_prefetch(URLContext *h, int64_t pos, int64_t size)
+{
+    Context *c = h->priv_data;
+    int      ret;
+
+    pthread_mutex_lock(&c->mutex);
+    ret = queue_range(h, pos, size);
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
 #define OFFSET(x) offsetof(Context, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "buffer_size", "size of the read ahead buffer", OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY }, 4096, INT_MAX - READ_BACK_CAPACITY, D },
+    { "ranges", "number of ranges cached apart from the read ahead buffer", OFFSET(nb_ranges), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, 64, D },
+    { "head_size", "size of the range cached at the start", OFFSET(head_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "tail_size", "size of the range cached at the end", OFFSET(tail_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "max_range_size", "maximum size of a cached range", OFFSET(max_range_size), AV_OPT_TYPE_INT, { .i64 = 16 << 20 }, 0, INT_MAX, D },
     {NULL},
 };
 
@@ -489,6 +733,7 @@ const URLProtocol ff_async_protocol = {
     .url_read            = async_read,
     .url_seek            = async_seek,
     .url_close           = async_close,
+    .url_prefetch        = async_prefetch,
     .priv_data_size      = sizeof(Context),
     .priv_data_class     = &async_context_class,
 };
@@ -418,6 +418,20 @@ struct AVDeviceCapabilitiesQuery;
  */
 int av_get_packet(AVIOContext *s, AVPacket *pkt, int size);
 
+/**
+ * Same as av_get_packet(), except that the payload is allocated from a
+ * packet pool, so that the memory of freed packets is reused. This is meant
+ * for demuxers whose packets are of similar sizes, such as frame-wrapped
+ * essence. A short read is signalled with AV_PKT_FLAG_CORRUPT.
+ *
+ * @param s    associated IO context
+ * @param pool packet pool to allocate the payload from
+ * @param pkt  packet
+ * @param size desired payload size
+ * @return >0 (read size) if OK, AVERROR_xxx otherwise
+ */
+int av_get_packet_pooled(AVIOContext *s, AVPacketPool *pool, AVPacket *pkt, int size);
+
 
 /**
  * Read data and append it to the current content of the AVPacket.
@@ -770,6 +784,19 @@ typedef struct AVInputFormat {
      */
     int (*get_device_list)(struct AVFormatContext *s, struct AVDeviceInfoList *device_list);
 
+    /**
+     * Read several packets at once, for av_read_frames(). Optional, the
+     * packets are otherwise read one by one with read_packet().
+     * @param pkts     blank packets to fill, in order
+     * @param nb_pkts  number of packets in pkts, set to the number of
+     *                 packets filled on return
+     * @param max_size reading may stop once this many bytes were read,
+     *                 no limit if <= 0
+     * @return 0 on success, < 0 on error. The error is reported after the
+     *         packets filled before it occurred.
+     */
+    int (*read_packets)(struct AVFormatContext *s, AVPacket **pkts,
+                        int *nb_pkts, int64_t max_size);
 } AVInputFormat;
 /**
  * @}
@@ -2165,6 +2192,23 @@ int av_find_best_stream(AVFormatContext *ic,
  */
 int av_read_frame(AVFormatContext *s, AVPacket *pkt);
 
+/**
+ * Return the next frames of the streams, in the same way as repeated calls
+ * to av_read_frame(). Demuxers that support it read the packets in
+ * batches, which is cheaper than reading them one by one.
+ *
+ * @param pkts     packets that are filled in order, they must not contain
+ *                 data that needs to be freed
+ * @param nb_pkts  maximum number of packets to read
+ * @param max_size reading stops once the packets read hold at least this
+ *                 many bytes, no limit if <= 0
+ * @return the number of packets read, > 0, or < 0 on error or end of file.
+ *         An error that occurs after some packets were read is returned by
+ *         the next call.
+ */
+int av_read_frames(AVFormatContext *s, AVPacket **pkts, int nb_pkts,
+                   int64_t max_size);
+
 /**
  * Seek to the keyframe at timestamp.
  * 'timestamp' in 'stream_index'.
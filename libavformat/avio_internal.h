@@ -77,6 +77,21 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Read hook set with ffio_set_read_hook(), and the position up to which
+     * the data of the buffer was passed to it.
+     */
+    void (*read_hook)(void *opaque, int64_t pos, const uint8_t *buf, int size);
+    void *read_hook_opaque;
+    int64_t read_hook_pos;
+
+    /**
+     * Number of buffer fills in a row read in full without seeking, and
+     * the buffer size requested with ffio_hint_read_size().
+     */
+    int seq_fills;
+    int read_size_hint;
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -141,6 +156,16 @@ uint64_t ffio_read_varlen(AVIOContext *bc);
  */
 int ffio_read_size(AVIOContext *s, unsigned char *buf, int size);
 
+/**
+ * Hint the size of the sequential reads about to be done, e.g. the size of
+ * the KLV packets known from an index. The read buffer grows to it, within
+ * a limit, at its next refill. Without a hint the buffer grows on its own
+ * after several sequential reads.
+ *
+ * @param size read size in bytes, 0 to remove the hint
+ */
+void ffio_hint_read_size(AVIOContext *s, int64_t size);
+
 /**
  * Reallocate a given buffer for AVIOContext.
  *
@@ -167,6 +192,19 @@ void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
 unsigned long ffio_get_checksum(AVIOContext *s);
+
+/**
+ * Set a callback receiving the data read by a read-only AVIOContext, with its
+ * position, before it leaves the buffer. Unlike the checksum of
+ * ffio_init_checksum(), this follows seeks: after one, the data passed starts
+ * at the new position, and data read again is passed again.
+ *
+ * The data still in the buffer is passed to the previous hook, if any, so
+ * that setting a NULL hook before closing the context passes everything read.
+ */
+void ffio_set_read_hook(AVIOContext *s,
+                        void (*read_hook)(void *opaque, int64_t pos, const uint8_t *buf, int size),
+                        void *opaque);
 unsigned long ff_crc04C11DB7_update(unsigned long checksum, const uint8_t *buf,
                                     unsigned int len);
 unsigned long ff_crcEDB88320_update(unsigned long checksum, const uint8_t *buf,
@@ -206,6 +244,28 @@ int ffio_fdopen(AVIOContext **s, URLContext *h);
  */
 URLContext *ffio_geturlcontext(AVIOContext *s);
 
+/**
+ * Read size bytes without copying them, if the underlying protocol can
+ * reference its data directly, e.g. a memory mapped file.
+ *
+ * On success, the read position advances by size and *buf is set to a
+ * read-only buffer holding the data, followed by padding that is readable
+ * but not necessarily zeroed.
+ *
+ * @return 0 on success, a negative error code if the data has to be read
+ *         with avio_read() instead; nothing is consumed in that case
+ */
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf);
+
+/**
+ * Hint that size bytes starting at pos will be read soon. Demuxers can use
+ * it when they know they are going to jump there, e.g. to an index at the
+ * end of the file.
+ *
+ * @return 0 on success, a negative error code if the hint is not supported
+ */
+int ffio_prefetch(AVIOContext *s, int64_t pos, int64_t size);
+
 
 /**
  * Read url related dictionary options from the AVIOContext and write to the given dictionary
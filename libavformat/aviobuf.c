@@ -43,6 +43,15 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+/**
+ * The read buffer doubles after this many buffer fills in a row were read
+ * in full without seeking, up to IO_BUFFER_MAX_GROWN, or grows at once to
+ * the read size hinted with ffio_hint_read_size(), up to IO_BUFFER_MAX_HINT.
+ */
+#define IO_BUFFER_GROW_FILLS 4
+#define IO_BUFFER_MAX_GROWN  (256 << 10)
+#define IO_BUFFER_MAX_HINT   (4 << 20)
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -191,6 +200,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
     s->pos += len;
 }
 
+/**
+ * Pass the data of the buffer not passed yet to the read hook.
+ */
+static void read_hook_flush(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    int64_t start;
+
+    if (!ctx->read_hook || s->write_flag || s->pos <= ctx->read_hook_pos)
+        return;
+    start = FFMAX(ctx->read_hook_pos, s->pos - (s->buf_end - s->buffer));
+    ctx->read_hook(ctx->read_hook_opaque, start,
+                   s->buf_end - (s->pos - start), s->pos - start);
+    ctx->read_hook_pos = s->pos;
+}
+
 static void flush_buffer(AVIOContext *s)
 {
     s->buf_ptr_max = FFMAX(s->buf_ptr, s->buf_ptr_max);
@@ -202,6 +227,8 @@ static void flush_buffer(AVIOContext *s)
             s->checksum_ptr = s->buffer;
         }
     }
+    if (!s->write_flag)
+        read_hook_flush(s);
     s->buf_ptr = s->buf_ptr_max = s->buffer;
     if (!s->write_flag)
         s->buf_end = s->buffer;
@@ -319,9 +346,11 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         pos -= FFMIN(buffer_size>>1, pos);
         if ((res = s->seek(s->opaque, pos, SEEK_SET)) < 0)
             return res;
+        read_hook_flush(s);
         s->buf_end =
         s->buf_ptr = s->buffer;
-        s->pos = pos;
+        s->pos = ctx->read_hook_pos = pos;
+        ctx->seq_fills = 0;
         s->eof_reached = 0;
         fill_buffer(s);
         return avio_seek(s, offset, SEEK_SET | force);
@@ -335,8 +364,12 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
             return res;
         ctx->seek_count++;
-        if (!s->write_flag)
+        ctx->seq_fills = 0;
+        if (!s->write_flag) {
+            read_hook_flush(s);
             s->buf_end = s->buffer;
+            ctx->read_hook_pos = offset;
+        }
         s->buf_ptr = s->buf_ptr_max = s->buffer;
         s->pos = offset;
     }
@@ -537,6 +570,20 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 
 /* Input stream */
 
+/* Size the read buffer should grow to before the next fill, or 0. */
+static int grown_buffer_size(FFIOContext *ctx)
+{
+    AVIOContext *const s = &ctx->pub;
+
+    if (!s->read_packet || s->max_packet_size || s->write_flag || s->direct)
+        return 0;
+    if (ctx->read_size_hint > s->buffer_size)
+        return ctx->read_size_hint;
+    if (ctx->seq_fills >= IO_BUFFER_GROW_FILLS && s->buffer_size < IO_BUFFER_MAX_GROWN)
+        return FFMIN(2 * s->buffer_size, IO_BUFFER_MAX_GROWN);
+    return 0;
+}
+
 static void fill_buffer(AVIOContext *s)
 {
     FFIOContext *const ctx = (FFIOContext *)s;
@@ -545,6 +592,7 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    int req;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -554,6 +602,8 @@ static void fill_buffer(AVIOContext *s)
     if (s->eof_reached)
         return;
 
+    if (dst == s->buffer)
+        read_hook_flush(s);
     if (s->update_checksum && dst == s->buffer) {
         if (s->buf_end > s->checksum_ptr)
             s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
@@ -572,8 +622,18 @@ static void fill_buffer(AVIOContext *s)
             s->checksum_ptr = dst = s->buffer;
         }
         len = ctx->orig_buffer_size;
+    } else if (dst == s->buffer && s->buf_ptr != dst) {
+        int buf_size = grown_buffer_size(ctx);
+        if (buf_size) {
+            if (set_buf_size(s, buf_size) >= 0) {
+                s->checksum_ptr = dst = s->buffer;
+                len = s->buffer_size;
+            }
+            ctx->seq_fills = 0;
+        }
     }
 
+    req = len;
     len = read_packet_wrapper(s, dst, len);
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
@@ -588,6 +648,8 @@ static void fill_buffer(AVIOContext *s)
         s->buf_end = dst + len;
         ffiocontext(s)->bytes_read += len;
         s->bytes_read = ffiocontext(s)->bytes_read;
+        /* short reads do not get faster with a larger buffer */
+        ctx->seq_fills = len == req ? ctx->seq_fills + 1 : 0;
     }
 }
 
@@ -628,6 +690,19 @@ void ffio_init_checksum(AVIOContext *s,
     }
 }
 
+void ffio_set_read_hook(AVIOContext *s,
+                        void (*read_hook)(void *opaque, int64_t pos, const uint8_t *buf, int size),
+                        void *opaque)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    read_hook_flush(s);
+    ctx->read_hook        = read_hook;
+    ctx->read_hook_opaque = opaque;
+    /* the data already in the buffer is passed too */
+    ctx->read_hook_pos    = s->pos - (s->buf_end - s->buffer);
+}
+
 /* XXX: put an inline version */
 int avio_r8(AVIOContext *s)
 {
@@ -648,6 +723,7 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
         if (len == 0 || s->write_flag) {
             if((s->direct || size > s->buffer_size) && !s->update_checksum) {
                 // bypass the buffer and read data directly into buf
+                read_hook_flush(s);
                 len = read_packet_wrapper(s, buf, size);
                 if (len == AVERROR_EOF) {
                     /* do not modify buffer if EOF reached so that a seek back can
@@ -659,6 +735,11 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
                     s->error= len;
                     break;
                 } else {
+                    FFIOContext *const ctx = ffiocontext(s);
+                    if (ctx->read_hook) {
+                        ctx->read_hook(ctx->read_hook_opaque, s->pos, buf, len);
+                        ctx->read_hook_pos = s->pos + len;
+                    }
                     s->pos += len;
                     ffiocontext(s)->bytes_read += len;
                     s->bytes_read = ffiocontext(s)->bytes_read;
@@ -1022,6 +1103,38 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
         return NULL;
 }
 
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t pos, ret;
+
+    /* Smaller reads are served from the I/O buffer anyway. */
+    if (!h || s->write_flag || s->update_checksum || size <= s->buffer_size)
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(s);
+    if (pos < 0)
+        return pos;
+    if ((ret = ffurl_get_buffer(h, pos, size, buf)) < 0)
+        return ret;
+
+    if ((ret = avio_seek(s, pos + size, SEEK_SET)) < 0) {
+        av_buffer_unref(buf);
+        return ret;
+    }
+
+    return 0;
+}
+
+int ffio_prefetch(AVIOContext *s, int64_t pos, int64_t size)
+{
+    URLContext *h = ffio_geturlcontext(s);
+
+    if (!h || s->write_flag)
+        return AVERROR(ENOSYS);
+    return ffurl_prefetch(h, pos, size);
+}
+
 int ffio_copy_url_options(AVIOContext* pb, AVDictionary** avio_opts)
 {
     const char *opts[] = {
@@ -1054,6 +1167,14 @@ static void update_checksum(AVIOContext *s)
     }
 }
 
+void ffio_hint_read_size(AVIOContext *s, int64_t size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    ctx->read_size_hint = size > IO_BUFFER_SIZE ?
+                          1 << av_ceil_log2(FFMIN(size, IO_BUFFER_MAX_HINT)) : 0;
+}
+
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
     uint8_t *buffer;
@@ -1122,6 +1243,7 @@ static int set_buf_size(AVIOContext *s, int buf_size)
     if (!buffer)
         return AVERROR(ENOMEM);
 
+    read_hook_flush(s);
     av_free(s->buffer);
     s->buffer = buffer;
     ffiocontext(s)->orig_buffer_size =
@@ -1146,6 +1268,7 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     if (!buffer)
         return AVERROR(ENOMEM);
 
+    read_hook_flush(s);
     data_size = s->write_flag ? (s->buf_ptr - s->buffer) : (s->buf_end - s->buf_ptr);
     if (data_size > 0)
         memcpy(buffer, s->write_flag ? s->buffer : s->buf_ptr, data_size);
@@ -1195,6 +1318,7 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         av_freep(bufp);
         return AVERROR(EINVAL);
     }
+    read_hook_flush(s);
 
     overlap = buf_size - buffer_start;
     new_size = buf_size + buffer_size - overlap;
@@ -1326,12 +1450,15 @@ int64_t avio_seek_time(AVIOContext *s, int stream_index,
     ret = s->read_seek(s->opaque, stream_index, timestamp, flags);
     if (ret >= 0) {
         int64_t pos;
+        read_hook_flush(s);
         s->buf_ptr = s->buf_end; // Flush buffer
         pos = s->seek(s->opaque, 0, SEEK_CUR);
         if (pos >= 0)
             s->pos = pos;
         else if (pos != AVERROR(ENOSYS))
             ret = pos;
+        ffiocontext(s)->read_hook_pos = s->pos;
+        ffiocontext(s)->seq_fills     = 0;
     }
     return ret;
 }
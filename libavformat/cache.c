@@ -31,8 +31,14 @@
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/sha.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
+#include "internal.h"
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #include <fcntl.h>
 #if HAVE_IO_H
 #include <io.h>
@@ -40,6 +46,10 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_UTIME
+#include <sys/types.h>
+#include <utime.h>
+#endif
 #include <sys/stat.h>
 #include <stdlib.h>
 #include "os_support.h"
@@ -64,6 +74,17 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    /* shared block cache */
+    char *cache_dir;
+    int block_size;
+    int64_t max_size;
+    char *block_dir;
+    uint8_t *block;
+    int64_t block_index;
+    int block_len;
+    int64_t inner_size;
+    int64_t stored_size;
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -71,6 +92,272 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+/* The shared cache keeps each block of block_size bytes of a resource in
+ * its own file, named after the block index, in a directory named after
+ * the resource. Blocks are only ever replaced atomically by rename(), so
+ * any number of processes can use it at the same time. */
+
+static int shared_open(URLContext *h, const char *arg)
+{
+    Context *c = h->priv_data;
+    const char *validators[] = { "etag", "last_modified" };
+    struct AVSHA *sha;
+    uint8_t digest[32];
+    char key[2 * sizeof(digest) + 1];
+    int ret, validated = 0;
+
+    c->inner_size  = ffurl_size(c->inner);
+    c->block_index = -1;
+
+    sha = av_sha_alloc();
+    if (!sha)
+        return AVERROR(ENOMEM);
+    av_sha_init(sha, 256);
+    av_sha_update(sha, arg, strlen(arg) + 1);
+    for (int i = 0; i < FF_ARRAY_ELEMS(validators); i++) {
+        uint8_t *val = NULL;
+        if (c->inner->prot->priv_data_class &&
+            av_opt_get(c->inner->priv_data, validators[i], 0, &val) >= 0 && *val) {
+            av_sha_update(sha, validators[i], strlen(validators[i]) + 1);
+            av_sha_update(sha, val, strlen(val) + 1);
+            validated = 1;
+        }
+        av_free(val);
+    }
+    av_sha_update(sha, (const uint8_t *)&c->inner_size, sizeof(c->inner_size));
+    av_sha_update(sha, (const uint8_t *)&c->block_size, sizeof(c->block_size));
+    av_sha_final(sha, digest);
+    av_free(sha);
+
+    if (!validated && c->inner_size < 0)
+        av_log(h, AV_LOG_WARNING, "Cannot tell if '%s' changed, "
+               "its cached blocks may be out of date\n", arg);
+
+    ff_data_to_hex(key, digest, sizeof(digest), 1);
+    key[sizeof(key) - 1] = 0;
+    c->block_dir = av_asprintf("%s/%s", c->cache_dir, key);
+    c->block     = av_malloc(c->block_size);
+    if (!c->block_dir || !c->block)
+        return AVERROR(ENOMEM);
+
+    if (ff_mkdir_p(c->block_dir) < 0 && errno != EEXIST) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create cache directory %s\n", c->block_dir);
+        return ret;
+    }
+
+    return 0;
+}
+
+#if HAVE_DIRENT_H
+typedef struct CacheFile {
+    char *path;
+    int64_t size;
+    time_t mtime;
+} CacheFile;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const CacheFile *)a)->mtime, ((const CacheFile *)b)->mtime);
+}
+
+/* Delete the least recently used blocks of all resources until the cache
+ * fits in max_size. Other processes may be doing the same, so files that
+ * have already disappeared are not an error. */
+static void shared_evict(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheFile *files = NULL;
+    unsigned nb_files = 0;
+    int64_t total = 0;
+    struct dirent *entry, *block;
+    DIR *dir, *subdir;
+
+    if (!(dir = opendir(c->cache_dir)))
+        return;
+    while ((entry = readdir(dir))) {
+        char *path;
+
+        if (entry->d_name[0] == '.')
+            continue;
+        path = av_asprintf("%s/%s", c->cache_dir, entry->d_name);
+        if (!path || !(subdir = opendir(path))) {
+            av_free(path);
+            continue;
+        }
+        while ((block = readdir(subdir))) {
+            CacheFile file;
+            struct stat st;
+
+            if (block->d_name[0] == '.' || strchr(block->d_name, '.'))
+                continue;
+            file.path = av_asprintf("%s/%s", path, block->d_name);
+            if (!file.path)
+                continue;
+            if (stat(file.path, &st) < 0 || !S_ISREG(st.st_mode) ||
+                av_dynarray2_add((void **)&files, &nb_files, sizeof(file),
+                                 (const uint8_t *)&file) == NULL) {
+                av_free(file.path);
+                continue;
+            }
+            files[nb_files - 1].size  = st.st_size;
+            files[nb_files - 1].mtime = st.st_mtime;
+            total += st.st_size;
+        }
+        closedir(subdir);
+        av_free(path);
+    }
+    closedir(dir);
+
+    if (total > c->max_size) {
+        qsort(files, nb_files, sizeof(*files), cmp_mtime);
+        for (unsigned i = 0; i < nb_files && total > c->max_size; i++)
+            if (!unlink(files[i].path) || errno == ENOENT)
+                total -= files[i].size;
+    }
+
+    for (unsigned i = 0; i < nb_files; i++)
+        av_free(files[i].path);
+    av_free(files);
+}
+#endif
+
+static void shared_store(URLContext *h, const char *path)
+{
+    Context *c = h->priv_data;
+    char *tmp;
+    int fd, ret = -1;
+
+    tmp = av_asprintf("%s.%08"PRIx32".tmp", path, av_get_random_seed());
+    if (!tmp)
+        return;
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd >= 0) {
+        ret = write(fd, c->block, c->block_len);
+        if (close(fd) < 0)
+            ret = -1;
+    }
+    if (ret != c->block_len || rename(tmp, path) < 0) {
+        /* Failing to cache only costs the next reader a download. */
+        av_log(h, AV_LOG_DEBUG, "Failed to store cache block %s\n", path);
+        unlink(tmp);
+        av_free(tmp);
+        return;
+    }
+    av_free(tmp);
+
+#if HAVE_DIRENT_H
+    /* Scanning the whole cache is slow, so only check the size after
+     * adding a sixteenth of it. */
+    c->stored_size += c->block_len;
+    if (c->max_size && c->stored_size >= c->max_size / 16) {
+        shared_evict(h);
+        c->stored_size = 0;
+    }
+#endif
+}
+
+static int shared_load(URLContext *h, int64_t index)
+{
+    Context *c = h->priv_data;
+    int64_t start = index * c->block_size;
+    char path[1024];
+    int fd, len = 0, ret;
+
+    snprintf(path, sizeof(path), "%s/%"PRId64, c->block_dir, index);
+
+    fd = avpriv_open(path, O_RDONLY);
+    if (fd >= 0) {
+        while (len < c->block_size) {
+            ret = read(fd, c->block + len, c->block_size - len);
+            if (ret <= 0)
+                break;
+            len += ret;
+        }
+        close(fd);
+        /* Only the last block of the resource may be short. */
+        if (len == c->block_size ||
+            (len > 0 && c->inner_size >= 0 && start + len == c->inner_size)) {
+#if HAVE_UTIME
+            /* Keep the mtime as the time of last use for eviction. */
+            utime(path, NULL);
+#endif
+            c->block_index = index;
+            c->block_len   = len;
+            c->cache_hit++;
+            return 0;
+        }
+    }
+
+    c->block_index = -1;
+    if (c->inner_pos != start) {
+        int64_t r = ffurl_seek(c->inner, start, SEEK_SET);
+        if (r < 0) {
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+            return r;
+        }
+        c->inner_pos = r;
+    }
+    ret = ffurl_read_complete(c->inner, c->block, c->block_size);
+    if (ret < 0)
+        return ret;
+    c->inner_pos  += ret;
+    c->block_index = index;
+    c->block_len   = ret;
+    c->cache_miss++;
+
+    if (ret == c->block_size ||
+        (ret > 0 && c->inner_size >= 0 && start + ret == c->inner_size))
+        shared_store(h, path);
+
+    return 0;
+}
+
+static int shared_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c = h->priv_data;
+    int64_t index = c->logical_pos / c->block_size;
+    int offset    = c->logical_pos % c->block_size;
+    int ret;
+
+    if (c->inner_size >= 0 && c->logical_pos >= c->inner_size)
+        return AVERROR_EOF;
+
+    if (index != c->block_index && (ret = shared_load(h, index)) < 0)
+        return ret;
+    if (offset >= c->block_len)
+        return AVERROR_EOF;
+
+    size = FFMIN(size, c->block_len - offset);
+    memcpy(buf, c->block + offset, size);
+    c->logical_pos += size;
+
+    return size;
+}
+
+static int64_t shared_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context *c = h->priv_data;
+
+    if (whence == AVSEEK_SIZE)
+        return c->inner_size >= 0 ? c->inner_size : AVERROR(ENOSYS);
+
+    if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END) {
+        if (c->inner_size < 0)
+            return AVERROR(ENOSYS);
+        pos += c->inner_size;
+    } else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* The inner protocol is only seeked on a cache miss. */
+    c->logical_pos = pos;
+    return pos;
+}
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     int ret;
@@ -79,6 +366,14 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->cache_dir) {
+        ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                                   options, h->protocol_whitelist, h->protocol_blacklist, h);
+        if (ret < 0)
+            return ret;
+        return shared_open(h, arg);
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -165,6 +460,9 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     CacheEntry *entry, *next[2] = {NULL, NULL};
     int64_t r;
 
+    if (c->cache_dir)
+        return shared_read(h, buf, size);
+
     entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
 
     if (!entry)
@@ -229,6 +527,9 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     Context *c= h->priv_data;
     int64_t ret;
 
+    if (c->cache_dir)
+        return shared_seek(h, pos, whence);
+
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
@@ -303,7 +604,10 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
+    if (!c->cache_dir)
+        close(c->fd);
+    av_freep(&c->block_dir);
+    av_freep(&c->block);
     if (c->filename) {
         ret = unlink(c->filename);
         if (ret < 0)
@@ -322,6 +626,9 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "directory of a block cache shared between processes", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_block_size", "size of the blocks of the shared cache", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, INT_MAX, D },
+    { "cache_max_size", "maximum size of the shared cache, 0 for unlimited", OFFSET(max_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
     {NULL},
 };
 
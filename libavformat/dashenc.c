@@ -48,6 +48,7 @@
 #include "internal.h"
 #include "isom.h"
 #include "os_support.h"
+#include "segupload.h"
 #include "url.h"
 #include "vpcc.h"
 #include "dash.h"
@@ -197,6 +198,8 @@ typedef struct DASHContext {
     AVRational min_playback_rate;
     AVRational max_playback_rate;
     int64_t update_period;
+    int upload_threads;
+    SegmentUploader *uploader;
 } DASHContext;
 
 static struct codec_string {
@@ -226,7 +229,10 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !c->http_persistent) {
+    if (c->uploader && http_base_proto) {
+        err = ff_segment_uploader_open(c->uploader, pb, filename, options,
+                                       av_match_ext(filename, "mpd,m3u8"));
+    } else if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -247,7 +253,11 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
-    if (!http_base_proto || !c->http_persistent) {
+    if (c->uploader && ff_segment_uploader_owns(c->uploader, *pb)) {
+        int ret = ff_segment_uploader_close(c->uploader, pb);
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Background upload failed: %s\n", av_err2str(ret));
+    } else if (!http_base_proto || !c->http_persistent) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -604,6 +614,8 @@ static void dash_free(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     int i, j;
 
+    ff_segment_uploader_free(&c->uploader);
+
     if (c->as) {
         for (i = 0; i < c->nb_as; i++) {
             av_dict_free(&c->as[i].metadata);
@@ -1449,6 +1461,15 @@ static int dash_init(AVFormatContext *s)
         av_log(s, AV_LOG_WARNING, "Low Latency mode enabled without Producer Reference Time element option! Resulting manifest may not be complaint\n");
     }
 
+    if (c->upload_threads) {
+        if (c->streaming) {
+            av_log(s, AV_LOG_WARNING, "upload_threads option will be ignored as streaming is enabled\n");
+        } else if ((ret = ff_segment_uploader_alloc(&c->uploader, s, c->upload_threads,
+                                                    c->http_persistent)) < 0) {
+            return ret;
+        }
+    }
+
     if (c->target_latency && !c->write_prft) {
         av_log(s, AV_LOG_WARNING, "Target latency option will be ignored as Producer Reference Time element will not be written\n");
         c->target_latency = 0;
@@ -1856,7 +1877,7 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
         set_http_options(&http_opts, c);
         av_dict_set(&http_opts, "method", "DELETE", 0);
 
-        if (dashenc_io_open(s, &out, filename, &http_opts) < 0) {
+        if (s->io_open(s, &out, filename, AVIO_FLAG_WRITE, &http_opts) < 0) {
             av_log(s, AV_LOG_ERROR, "failed to delete %s\n", filename);
         }
 
@@ -2310,6 +2331,14 @@ static int dash_write_trailer(AVFormatContext *s)
     }
     dash_flush(s, 1, -1);
 
+    if (c->uploader) {
+        int ret = ff_segment_uploader_flush(c->uploader);
+        if (ret < 0 && !c->ignore_io_errors) {
+            av_log(s, AV_LOG_ERROR, "Background upload failed: %s\n", av_err2str(ret));
+            return ret;
+        }
+    }
+
     if (c->remove_at_exit) {
         for (i = 0; i < s->nb_streams; ++i) {
             OutputStream *os = &c->streams[i];
@@ -2402,6 +2431,7 @@ static const AVOption options[] = {
     { "min_playback_rate", "Set desired minimum playback rate", OFFSET(min_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "update_period", "Set the mpd update interval", OFFSET(update_period), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, E},
+    { "upload_threads", "Number of threads uploading HTTP segments and manifests in the background", OFFSET(upload_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, E},
     { NULL },
 };
 
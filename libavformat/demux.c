@@ -33,6 +33,7 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
+#include "libavutil/trace_internal.h"
 
 #include "libavcodec/bsf.h"
 #include "libavcodec/internal.h"
@@ -293,12 +294,16 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
     if (s->pb)
         ff_id3v2_read_dict(s->pb, &si->id3v2_meta, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta);
 
-    if (s->iformat->read_header)
-        if ((ret = s->iformat->read_header(s)) < 0) {
+    if (s->iformat->read_header) {
+        void *mem_ctx = av_mem_accounting_set_context(s);
+        ret = s->iformat->read_header(s);
+        av_mem_accounting_set_context(mem_ctx);
+        if (ret < 0) {
             if (s->iformat->flags_internal & FF_FMT_INIT_CLEANUP)
                 goto close;
             goto fail;
         }
+    }
 
     if (!s->metadata) {
         s->metadata    = si->id3v2_meta;
@@ -521,6 +526,57 @@ static int update_wrap_reference(AVFormatContext *s, AVStream *st, int stream_in
     return 1;
 }
 
+/**
+ * Get the next packet from the demuxer, reading a batch of them with
+ * read_packets() during av_read_frames().
+ */
+static int read_raw_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    void *mem_ctx;
+    int nb_pkts, err;
+
+    if (si->batch_pos < si->batch_nb) {
+        av_packet_move_ref(pkt, si->batch_pkts[si->batch_pos++]);
+        return 0;
+    }
+    if (si->batch_error < 0) {
+        err = si->batch_error;
+        si->batch_error = 0;
+        return err;
+    }
+
+    mem_ctx = av_mem_accounting_set_context(s);
+    FF_TRACE_BEGIN("read_packet", s->iformat->name);
+    if (s->iformat->read_packets && si->batch_size > 1) {
+        nb_pkts = FFMIN(si->batch_size, MAX_READ_BATCH);
+        for (int i = 0; i < nb_pkts; i++) {
+            if (!si->batch_pkts[i] && !(si->batch_pkts[i] = av_packet_alloc())) {
+                nb_pkts = i;
+                break;
+            }
+        }
+        err = nb_pkts ? s->iformat->read_packets(s, si->batch_pkts, &nb_pkts,
+                                                 si->batch_max_size)
+                      : AVERROR(ENOMEM);
+        if (nb_pkts > 0) {
+            av_packet_move_ref(pkt, si->batch_pkts[0]);
+            si->batch_pos   = 1;
+            si->batch_nb    = nb_pkts;
+            si->batch_error = err;
+            err = 0;
+        } else if (!err) {
+            err = AVERROR(EAGAIN);
+        }
+    } else {
+        err = s->iformat->read_packet(s, pkt);
+    }
+    FF_TRACE_END("read_packet", s->iformat->name);
+    av_mem_accounting_set_context(mem_ctx);
+
+    return err;
+}
+
 int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -555,7 +611,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             }
         }
 
-        err = s->iformat->read_packet(s, pkt);
+        err = read_raw_packet(s, pkt);
         if (err < 0) {
             av_packet_unref(pkt);
 
@@ -1509,6 +1565,36 @@ return_packet:
     return ret;
 }
 
+int av_read_frames(AVFormatContext *s, AVPacket **pkts, int nb_pkts,
+                   int64_t max_size)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    int64_t size = 0;
+    int n = 0, ret = 0;
+
+    if (si->read_frames_error < 0) {
+        ret = si->read_frames_error;
+        si->read_frames_error = 0;
+        return ret;
+    }
+
+    si->batch_size     = nb_pkts;
+    si->batch_max_size = max_size;
+    while (n < nb_pkts && (max_size <= 0 || size < max_size)) {
+        ret = av_read_frame(s, pkts[n]);
+        if (ret < 0)
+            break;
+        size += pkts[n++]->size;
+    }
+    si->batch_size = 0;
+
+    if (!n)
+        return ret;
+    if (ret < 0 && ret != AVERROR(EAGAIN))
+        si->read_frames_error = ret;
+    return n;
+}
+
 /**
  * Return TRUE if the stream has accurate duration in any stream.
  *
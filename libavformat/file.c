@@ -20,8 +20,10 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavcodec/defs.h"
 #include "avformat.h"
 #if HAVE_DIRENT_H
 #include <dirent.h>
@@ -34,6 +36,9 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
@@ -74,6 +79,11 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int readahead;
+    int use_mmap;
+    int64_t pos;
+    int64_t readahead_end;
+    AVBufferRef *map;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -84,6 +94,8 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "readahead", "set the size of the window read ahead asynchronously", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "map the file and return packets referencing it without copying", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -106,12 +118,36 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_POSIX_FADVISE
+/* Keep the kernel reading up to c->readahead bytes past the current
+ * position in the background, topping the window up once half of it
+ * has been consumed. */
+static void file_readahead(FileContext *c)
+{
+    int64_t start, end;
+
+    if (c->pos + c->readahead / 2 < c->readahead_end)
+        return;
+
+    start = FFMAX(c->pos, c->readahead_end);
+    end   = c->pos + c->readahead;
+    posix_fadvise(c->fd, start, end - start, POSIX_FADV_WILLNEED);
+    c->readahead_end = end;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_POSIX_FADVISE
+    if (c->readahead && !h->is_streamed)
+        file_readahead(c);
+#endif
     ret = read(c->fd, buf, size);
+    if (ret > 0)
+        c->pos += ret;
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
     if (ret == 0)
@@ -128,12 +164,85 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+static int file_map(URLContext *h, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    void *data;
+
+    if (size <= 0 || size != (size_t)size)
+        return AVERROR(EINVAL);
+
+    data = mmap(NULL, size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+#if HAVE_POSIX_MADVISE
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    c->map = av_buffer_create(data, size, file_unmap, (void *)(uintptr_t)size,
+                              AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static int file_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    AVBufferRef *ref;
+
+    /* The padding has to be backed by the file, too. */
+    if (!c->map || pos < 0 ||
+        pos + size + AV_INPUT_BUFFER_PADDING_SIZE > c->map->size)
+        return AVERROR(ENOSYS);
+
+    ref = av_buffer_ref(c->map);
+    if (!ref)
+        return AVERROR(ENOMEM);
+    ref->data += pos;
+    ref->size  = size + AV_INPUT_BUFFER_PADDING_SIZE;
+
+#if HAVE_POSIX_MADVISE
+    if (c->readahead)
+        posix_madvise(c->map->data + pos + size,
+                      FFMIN(c->readahead, c->map->size - pos - size),
+                      POSIX_MADV_WILLNEED);
+#endif
+
+    *buf = ref;
+    return 0;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
     return c->fd;
 }
 
+#if HAVE_POSIX_FADVISE
+static int file_prefetch(URLContext *h, int64_t pos, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    int ret;
+
+    if (pos < 0 || size <= 0)
+        return AVERROR(EINVAL);
+    /* the hint outlives the file descriptor: the pages stay cached */
+    ret = posix_fadvise(c->fd, pos, size, POSIX_FADV_WILLNEED);
+    return ret ? AVERROR(ret) : 0;
+}
+#endif
+
 static int file_check(URLContext *h, int mask)
 {
     int ret = 0;
@@ -243,6 +352,23 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_POSIX_FADVISE
+    if (c->readahead && !h->is_streamed && !(flags & AVIO_FLAG_WRITE))
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !h->is_streamed && !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+#if HAVE_MMAP
+        int ret = file_map(h, st.st_size);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot map '%s', reading it instead: %s\n",
+                   filename, av_err2str(ret));
+#else
+        av_log(h, AV_LOG_WARNING, "Memory mapping is not supported on this system\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -259,13 +385,19 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     }
 
     ret = lseek(c->fd, pos, whence);
+    if (ret < 0)
+        return AVERROR(errno);
+
+    if (ret != c->pos)
+        c->pos = c->readahead_end = ret;
 
-    return ret < 0 ? AVERROR(errno) : ret;
+    return ret;
 }
 
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+    av_buffer_unref(&c->map);
     return close(c->fd);
 }
 
@@ -361,6 +493,12 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+#if HAVE_MMAP
+    .url_get_buffer      = file_get_buffer,
+#endif
+#if HAVE_POSIX_FADVISE
+    .url_prefetch        = file_prefetch,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
@@ -54,6 +54,7 @@
 #include "hlsplaylist.h"
 #include "internal.h"
 #include "os_support.h"
+#include "segupload.h"
 
 typedef enum {
     HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -254,6 +255,8 @@ typedef struct HLSContext {
     int64_t timeout;
     int ignore_io_errors;
     char *headers;
+    int upload_threads;
+    SegmentUploader *uploader;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
 } HLSContext;
@@ -287,7 +290,10 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *file
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !hls->http_persistent) {
+    if (hls->uploader && http_base_proto) {
+        err = ff_segment_uploader_open(hls->uploader, pb, filename, options,
+                                       av_match_ext(filename, "m3u8"));
+    } else if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -309,7 +315,9 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     int ret = 0;
     if (!*pb)
         return ret;
-    if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
+    if (hls->uploader && ff_segment_uploader_owns(hls->uploader, *pb)) {
+        ret = ff_segment_uploader_close(hls->uploader, pb);
+    } else if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -2676,6 +2684,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    ff_segment_uploader_free(&hls->uploader);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2755,8 +2765,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+                    ff_format_io_close(s, &vs->out);
                 }
             }
         }
@@ -2825,6 +2835,7 @@ failed:
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
+            hlsenc_io_close(s, &vtt_oc->pb, vtt_oc->url);
             ff_format_io_close(s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
@@ -2838,6 +2849,11 @@ failed:
         av_free(old_filename);
     }
 
+    if (hls->uploader && (ret = ff_segment_uploader_flush(hls->uploader)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Background upload failed: %s\n", av_err2str(ret));
+        return hls->ignore_io_errors ? 0 : ret;
+    }
+
     return 0;
 }
 
@@ -2864,6 +2880,15 @@ static int hls_init(AVFormatContext *s)
             pattern += 2;
     }
 
+    if (hls->upload_threads) {
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_WARNING, "upload_threads is not supported in byte range mode, ignoring\n");
+        } else if ((ret = ff_segment_uploader_alloc(&hls->uploader, s, hls->upload_threads,
+                                                    hls->http_persistent)) < 0) {
+            return ret;
+        }
+    }
+
     hls->has_default_key = 0;
     hls->has_video_m3u8 = 0;
     ret = update_variant_stream_info(s);
@@ -3154,6 +3179,7 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"upload_threads", "Number of threads uploading HTTP segments and playlists in the background", OFFSET(upload_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
     { NULL },
 };
 
@@ -31,6 +31,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -76,6 +77,8 @@ typedef struct HTTPContext {
     char *headers;
     char *mime_type;
     char *http_version;
+    char *etag;
+    char *last_modified;
     char *user_agent;
     char *referer;
     char *content_type;
@@ -127,6 +130,11 @@ typedef struct HTTPContext {
     HandshakeState handshake_step;
     int is_connected_server;
     int short_seek_size;
+    int parallel_requests;
+    int parallel_chunk_size;
+#if HAVE_THREADS
+    struct HTTPParallel *parallel;
+#endif
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -146,6 +154,8 @@ static const AVOption options[] = {
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the ETag of the resource", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the Last-Modified date of the resource", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     { "icy_metadata_headers", "return ICY metadata headers", OFFSET(icy_metadata_headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT },
@@ -169,6 +179,8 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "parallel_requests", "number of range requests to keep in flight", OFFSET(parallel_requests), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
+    { "parallel_chunk_size", "size of each parallel range request", OFFSET(parallel_chunk_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, 4096, INT_MAX, D },
     { NULL }
 };
 
@@ -1097,6 +1109,12 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1679,10 +1697,393 @@ static int store_icy(URLContext *h, int size)
     return FFMIN(size, remaining);
 }
 
+#if HAVE_THREADS
+/* Parallel ranged reads: worker threads, each with its own keep-alive
+ * connection, fetch consecutive chunks of the resource ahead of the read
+ * position; http_read() hands them out in order. */
+
+enum HTTPChunkState {
+    CHUNK_FREE,
+    CHUNK_QUEUED,
+    CHUNK_FETCHING,
+    CHUNK_DONE,
+};
+
+typedef struct HTTPChunk {
+    uint8_t *data;
+    uint64_t start;
+    int size;
+    int filled;
+    int ret;
+    enum HTTPChunkState state;
+    /* Set when a seek drops the chunk while it is being fetched. */
+    int cancel;
+} HTTPChunk;
+
+typedef struct HTTPWorker {
+    struct HTTPParallel *p;
+    URLContext *hd;
+    HTTPChunk *chunk;
+    AVIOInterruptCB interrupt_callback;
+    pthread_t thread;
+} HTTPWorker;
+
+typedef struct HTTPParallel {
+    URLContext *h;
+    HTTPWorker *workers;
+    int nb_workers;
+    HTTPChunk *chunks;
+    int nb_chunks;
+    /* start of the next chunk to queue */
+    uint64_t next_off;
+    int abort;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} HTTPParallel;
+
+static int http_worker_check_interrupt(void *arg)
+{
+    HTTPWorker *w = arg;
+
+    if (w->p->abort || (w->chunk && w->chunk->cancel))
+        return 1;
+
+    return ff_check_interrupt(&w->p->h->interrupt_callback);
+}
+
+static int http_worker_open(HTTPWorker *w, uint64_t start, uint64_t end)
+{
+    URLContext *h = w->p->h;
+    HTTPContext *s = h->priv_data;
+    const AVOption *o = NULL;
+    AVDictionary *opts = NULL;
+    uint8_t *val;
+    int ret;
+
+    /* Pass on the request options of the parent, the worker connections
+     * only differ in the range and in being persistent. */
+    while ((o = av_opt_next(s, o))) {
+        if (o->type == AV_OPT_TYPE_CONST || !(o->flags & D) ||
+            o->flags & (AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY) ||
+            !strcmp(o->name, "location"))
+            continue;
+        if ((ret = av_opt_get(s, o->name, 0, &val)) < 0)
+            goto fail;
+        /* unset strings are returned as empty ones */
+        if (!*val) {
+            av_free(val);
+            continue;
+        }
+        if ((ret = av_dict_set(&opts, o->name, val, AV_DICT_DONT_STRDUP_VAL)) < 0)
+            goto fail;
+    }
+    av_dict_copy(&opts, s->chained_options, 0);
+    av_dict_set_int(&opts, "offset", start, 0);
+    av_dict_set_int(&opts, "end_offset", end, 0);
+    av_dict_set_int(&opts, "multiple_requests", 1, 0);
+    av_dict_set_int(&opts, "seekable", 1, 0);
+    av_dict_set_int(&opts, "icy", 0, 0);
+    av_dict_set_int(&opts, "parallel_requests", 0, 0);
+
+    ret = ffurl_open_whitelist(&w->hd, s->location, AVIO_FLAG_READ,
+                               &w->interrupt_callback, &opts,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+fail:
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int http_worker_fetch(HTTPWorker *w, HTTPChunk *c)
+{
+    uint64_t end = c->start + c->size;
+    int ret;
+
+    /* Reuse the connection if the previous response was read completely. */
+    if (w->hd) {
+        HTTPContext *ws = w->hd->priv_data;
+        AVDictionary *options = NULL;
+
+        if (ws->hd && !ws->willclose && ws->http_code == 206) {
+            ws->off              = c->start;
+            ws->end_off          = end;
+            ws->chunkend         = 0;
+            ws->end_chunked_post = 0;
+            ret = http_open_cnx(w->hd, &options);
+            av_dict_free(&options);
+        } else
+            ret = AVERROR(EPIPE);
+        if (ret < 0)
+            ffurl_closep(&w->hd);
+    }
+    if (!w->hd && (ret = http_worker_open(w, c->start, end)) < 0)
+        return ret;
+
+    ret = ffurl_read_complete(w->hd, c->data, c->size);
+    if (ret != c->size)
+        ffurl_closep(&w->hd);
+    return ret;
+}
+
+static void *http_worker_thread(void *arg)
+{
+    HTTPWorker *w = arg;
+    HTTPParallel *p = w->p;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        HTTPChunk *c = NULL;
+        int ret;
+
+        for (int i = 0; i < p->nb_chunks; i++)
+            if (p->chunks[i].state == CHUNK_QUEUED &&
+                (!c || p->chunks[i].start < c->start))
+                c = &p->chunks[i];
+        if (!c) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+
+        c->state = CHUNK_FETCHING;
+        w->chunk = c;
+        pthread_mutex_unlock(&p->mutex);
+
+        ret = http_worker_fetch(w, c);
+
+        pthread_mutex_lock(&p->mutex);
+        w->chunk = NULL;
+        if (c->cancel) {
+            c->cancel = 0;
+            c->state  = CHUNK_FREE;
+        } else {
+            c->filled = FFMAX(ret, 0);
+            c->ret    = ret < 0 ? ret : ret < c->size ? AVERROR(EIO) : 0;
+            c->state  = CHUNK_DONE;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+/* Queue chunks following the last queued one into the free slots. */
+static void http_parallel_queue(HTTPContext *s)
+{
+    HTTPParallel *p = s->parallel;
+
+    for (int i = 0; i < p->nb_chunks && p->next_off < s->filesize; i++) {
+        HTTPChunk *c = &p->chunks[i];
+
+        if (c->state != CHUNK_FREE)
+            continue;
+        c->start  = p->next_off;
+        c->size   = FFMIN(s->parallel_chunk_size, s->filesize - p->next_off);
+        c->filled = 0;
+        c->state  = CHUNK_QUEUED;
+        p->next_off += c->size;
+        pthread_cond_broadcast(&p->cond);
+    }
+}
+
+static HTTPChunk *http_parallel_find(HTTPParallel *p, uint64_t off)
+{
+    for (int i = 0; i < p->nb_chunks; i++) {
+        HTTPChunk *c = &p->chunks[i];
+        if (c->state != CHUNK_FREE && !c->cancel &&
+            c->start <= off && off < c->start + c->size)
+            return c;
+    }
+    return NULL;
+}
+
+static void http_parallel_drop(HTTPChunk *c)
+{
+    if (c->state == CHUNK_FETCHING)
+        c->cancel = 1;
+    else
+        c->state = CHUNK_FREE;
+}
+
+static void http_parallel_close(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p = s->parallel;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (int i = 0; i < p->nb_workers; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+        ffurl_closep(&p->workers[i].hd);
+    }
+    for (int i = 0; i < p->nb_chunks; i++)
+        av_freep(&p->chunks[i].data);
+    av_freep(&p->chunks);
+    av_freep(&p->workers);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&s->parallel);
+}
+
+static int http_parallel_init(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p;
+    int ret;
+
+    p = s->parallel = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->h        = h;
+    p->next_off = s->off;
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        av_freep(&s->parallel);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        av_freep(&s->parallel);
+        return AVERROR(ret);
+    }
+
+    /* Twice as many chunks as connections, so that each connection has
+     * the next chunk queued while the reader consumes the current one. */
+    p->chunks  = av_calloc(2 * s->parallel_requests, sizeof(*p->chunks));
+    p->workers = av_calloc(s->parallel_requests, sizeof(*p->workers));
+    if (!p->chunks || !p->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (; p->nb_chunks < 2 * s->parallel_requests; p->nb_chunks++) {
+        p->chunks[p->nb_chunks].data = av_malloc(s->parallel_chunk_size);
+        if (!p->chunks[p->nb_chunks].data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    for (; p->nb_workers < s->parallel_requests; p->nb_workers++) {
+        HTTPWorker *w = &p->workers[p->nb_workers];
+        w->p = p;
+        w->interrupt_callback.callback = http_worker_check_interrupt;
+        w->interrupt_callback.opaque   = w;
+        if ((ret = pthread_create(&w->thread, NULL, http_worker_thread, w))) {
+            ret = AVERROR(ret);
+            goto fail;
+        }
+    }
+
+    /* The parent connection is not used any more. */
+    ffurl_closep(&s->hd);
+    return 0;
+
+fail:
+    http_parallel_close(h);
+    return ret;
+}
+
+static int http_parallel_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p = s->parallel;
+    HTTPChunk *c;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    for (;;) {
+        if (s->off >= s->filesize) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        http_parallel_queue(s);
+        c = http_parallel_find(p, s->off);
+        if (!c || c->state != CHUNK_DONE) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+
+        if (s->off >= c->start + c->filled) {
+            ret = c->ret;
+            break;
+        }
+
+        ret = FFMIN(size, c->start + c->filled - s->off);
+        memcpy(buf, c->data + (s->off - c->start), ret);
+        s->off += ret;
+        if (s->off == c->start + c->size)
+            c->state = CHUNK_FREE;
+        break;
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+static int64_t http_parallel_seek(URLContext *h, int64_t off, int whence)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p = s->parallel;
+
+    if (whence == AVSEEK_SIZE)
+        return s->filesize;
+    else if (whence == SEEK_CUR)
+        off += s->off;
+    else if (whence == SEEK_END)
+        off += s->filesize;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (off < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&p->mutex);
+    if (http_parallel_find(p, off)) {
+        /* Within the window: only drop what lies behind. */
+        for (int i = 0; i < p->nb_chunks; i++)
+            if (p->chunks[i].start + p->chunks[i].size <= off)
+                http_parallel_drop(&p->chunks[i]);
+    } else {
+        for (int i = 0; i < p->nb_chunks; i++)
+            if (p->chunks[i].state != CHUNK_FREE)
+                http_parallel_drop(&p->chunks[i]);
+        p->next_off = off;
+    }
+    s->off = off;
+    pthread_mutex_unlock(&p->mutex);
+
+    return off;
+}
+#endif /* HAVE_THREADS */
+
 static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+#if HAVE_THREADS
+    if (s->parallel_requests > 1 && !s->parallel) {
+        int ret = AVERROR(ENOSYS);
+        if (!h->is_streamed && s->filesize != UINT64_MAX && !s->icy_metaint &&
+            !s->post_data &&
+#if CONFIG_ZLIB
+            !s->compressed &&
+#endif
+            !s->listen && !(h->flags & AVIO_FLAG_WRITE))
+            ret = http_parallel_init(h);
+        if (ret < 0) {
+            av_log(h, AV_LOG_WARNING, "Cannot use parallel requests, reading serially: %s\n",
+                   av_err2str(ret));
+            s->parallel_requests = 0;
+        }
+    }
+    if (s->parallel)
+        return http_parallel_read(h, buf, size);
+#endif
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1756,6 +2157,9 @@ static int http_close(URLContext *h)
     int ret = 0;
     HTTPContext *s = h->priv_data;
 
+#if HAVE_THREADS
+    http_parallel_close(h);
+#endif
 #if CONFIG_ZLIB
     inflateEnd(&s->inflate_stream);
     av_freep(&s->inflate_buffer);
@@ -1781,6 +2185,11 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     int old_buf_size, ret;
     AVDictionary *options = NULL;
 
+#if HAVE_THREADS
+    if (s->parallel)
+        return http_parallel_seek(h, off, whence);
+#endif
+
     if (whence == AVSEEK_SIZE)
         return s->filesize;
     else if (!force_reconnect &&
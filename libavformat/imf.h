@@ -42,6 +42,7 @@
 #include "libavformat/avio.h"
 #include "libavutil/rational.h"
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 
 #define FF_UUID_FORMAT                                \
     "urn:uuid:%02hhx%02hhx%02hhx%02hhx-%02hhx%02hhx-" \
@@ -74,9 +75,9 @@ typedef struct FFIMFTrackFileResource {
  * IMF Marker
  */
 typedef struct FFIMFMarker {
-    xmlChar *label_utf8; /**< Marker/Label */
-    xmlChar *scope_utf8; /**< Marker/Label/\@scope */
-    uint32_t offset;     /**< Marker/Offset */
+    const xmlChar *label_utf8; /**< Marker/Label */
+    const xmlChar *scope_utf8; /**< Marker/Label/\@scope */
+    uint32_t offset;           /**< Marker/Offset */
 } FFIMFMarker;
 
 /**
@@ -84,8 +85,9 @@ typedef struct FFIMFMarker {
  */
 typedef struct FFIMFMarkerResource {
     FFIMFBaseResource base;
-    uint32_t marker_count; /**< Number of Marker elements */
-    FFIMFMarker *markers;  /**< Marker elements */
+    uint32_t marker_count;     /**< Number of Marker elements */
+    FFIMFMarker *markers;      /**< Marker elements */
+    uint32_t markers_alloc_sz; /**< Size of the markers buffer */
 } FFIMFMarkerResource;
 
 /**
@@ -112,19 +114,28 @@ typedef struct FFIMFMarkerVirtualTrack {
     FFIMFBaseVirtualTrack base;
     uint32_t resource_count;        /**< Number of Resource elements present in the Virtual Track */
     FFIMFMarkerResource *resources; /**< Resource elements of the Virtual Track */
+    uint32_t resources_alloc_sz;    /**< Size of the resources buffer */
 } FFIMFMarkerVirtualTrack;
 
+/**
+ * Memory from which an FFIMFCPL structure, its arrays and its strings are
+ * allocated, and which is released at once by ff_imf_cpl_free()
+ */
+typedef struct FFIMFArena FFIMFArena;
+
 /**
  * IMF Composition Playlist
  */
 typedef struct FFIMFCPL {
     FFUUID id_uuid;                                  /**< CompositionPlaylist/Id element */
-    xmlChar *content_title_utf8;                     /**< CompositionPlaylist/ContentTitle element */
+    const xmlChar *content_title_utf8;               /**< CompositionPlaylist/ContentTitle element */
     AVRational edit_rate;                            /**< CompositionPlaylist/EditRate element */
     FFIMFMarkerVirtualTrack *main_markers_track;     /**< Main Marker Virtual Track */
     FFIMFTrackFileVirtualTrack *main_image_2d_track; /**< Main Image Virtual Track */
     uint32_t main_audio_track_count;                 /**< Number of Main Audio Virtual Tracks */
     FFIMFTrackFileVirtualTrack *main_audio_tracks;   /**< Main Audio Virtual Tracks */
+    uint32_t main_audio_tracks_alloc_sz;             /**< Size of the main_audio_tracks buffer */
+    FFIMFArena *arena;                               /**< Memory of the CPL */
 } FFIMFCPL;
 
 /**
@@ -149,6 +160,27 @@ int ff_parse_imf_cpl_from_xml_dom(xmlDocPtr doc, FFIMFCPL **cpl);
  */
 int ff_parse_imf_cpl(AVIOContext *in, FFIMFCPL **cpl);
 
+/**
+ * Serializes an FFIMFCPL data structure, so that it can be restored without
+ * parsing the CPL document again.
+ * @param[in] pb The context to which the structure is written.
+ * @param[in] cpl The FFIMFCPL structure to serialize.
+ * @return A non-zero value in case of an error.
+ */
+int ff_imf_cpl_write(AVIOContext *pb, const FFIMFCPL *cpl);
+
+/**
+ * Restores an FFIMFCPL data structure previously serialized with
+ * ff_imf_cpl_write().
+ * @param[in] pb The context from which the structure is read.
+ * @param[out] cpl Pointer to a memory area (allocated by the client), where the
+ * function writes a pointer to the newly constructed FFIMFCPL structure (or
+ * NULL if it could not be read). The client is responsible for freeing
+ * the FFIMFCPL structure using ff_imf_cpl_free().
+ * @return A non-zero value in case of an error.
+ */
+int ff_imf_cpl_read(AVIOContext *pb, FFIMFCPL **cpl);
+
 /**
  * Allocates and initializes an FFIMFCPL data structure.
  * @return A pointer to the newly constructed FFIMFCPL structure (or NULL if the
@@ -187,4 +219,21 @@ int ff_xml_read_uuid(xmlNodePtr element, uint8_t uuid[16]);
  */
 xmlNodePtr ff_xml_get_child_element_by_name(xmlNodePtr parent, const char *name_utf8);
 
+/**
+ * Creates a streaming XML reader that pulls the document from an AVIOContext.
+ * The AVIOContext is not closed when the reader is freed.
+ * @return A pointer to the reader, to be freed with xmlFreeTextReader(), or
+ * NULL on error.
+ */
+xmlTextReaderPtr ff_xml_reader_for_avio(AVIOContext *in, const char *url);
+
+/**
+ * Advances the reader to the next child element of the element at depth
+ * parent_depth.
+ * @param[in] skip_current Skips the subtree of the current node if non-zero.
+ * @return 1 if the reader is positioned on a child element, 0 if no more child
+ * elements exist, < 0 AVERROR code on error.
+ */
+int ff_xml_reader_next_child_element(xmlTextReaderPtr reader, int parent_depth, int skip_current);
+
 #endif
@@ -33,11 +33,160 @@
  * @ingroup lavu_imf
  */
 
+#include "avio_internal.h"
 #include "imf.h"
 #include "libavformat/mxf.h"
 #include "libavutil/bprint.h"
 #include "libavutil/error.h"
+#include "libavutil/mem.h"
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
+
+#define IMF_ARENA_ALIGN          16
+#define IMF_ARENA_BLOCK_SIZE     4096
+#define IMF_ARENA_MAX_BLOCK_SIZE (1 << 20)
+#define IMF_ARENA_STRING_BUCKETS 64
+
+typedef struct IMFArenaBlock {
+    struct IMFArenaBlock *next;
+    size_t size;
+} IMFArenaBlock;
+
+/**
+ * String shared by all the elements of the CPL that carry the same text
+ */
+typedef struct IMFArenaString {
+    struct IMFArenaString *next;
+    uint32_t hash;
+    xmlChar *str;
+} IMFArenaString;
+
+struct FFIMFArena {
+    IMFArenaBlock *blocks; /**< Allocated blocks, the current one first */
+    uint8_t *ptr;          /**< Free space of the current block */
+    uint8_t *end;
+    uint8_t *last;         /**< Last allocation, which can be grown in place */
+    IMFArenaString *strings[IMF_ARENA_STRING_BUCKETS];
+};
+
+#define IMF_ARENA_BLOCK_HEADER_SIZE FFALIGN(sizeof(IMFArenaBlock), IMF_ARENA_ALIGN)
+
+/**
+ * Allocates zeroed memory from the arena. The memory is released with the
+ * arena.
+ */
+static void *imf_arena_alloc(FFIMFArena *arena, size_t size)
+{
+    IMFArenaBlock *block;
+    size_t block_size;
+    uint8_t *ptr;
+
+    if (size > SIZE_MAX - IMF_ARENA_BLOCK_HEADER_SIZE - IMF_ARENA_ALIGN)
+        return NULL;
+    size = FFALIGN(size, IMF_ARENA_ALIGN);
+
+    if (size > arena->end - arena->ptr) {
+        block_size = arena->blocks ? FFMIN(2 * arena->blocks->size, IMF_ARENA_MAX_BLOCK_SIZE)
+                                   : IMF_ARENA_BLOCK_SIZE;
+        block_size = FFMAX(block_size, size);
+        if (!(block = av_malloc(IMF_ARENA_BLOCK_HEADER_SIZE + block_size)))
+            return NULL;
+        block->next = arena->blocks;
+        block->size = block_size;
+        arena->blocks = block;
+        arena->ptr = (uint8_t *)block + IMF_ARENA_BLOCK_HEADER_SIZE;
+        arena->end = arena->ptr + block_size;
+    }
+
+    ptr = arena->ptr;
+    arena->ptr += size;
+    arena->last = ptr;
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+/**
+ * Arena counterpart of av_fast_realloc(): the buffer is grown in place if it
+ * is the last allocation of the arena, and copied otherwise. The previous
+ * buffer is released with the arena.
+ */
+static void *imf_arena_fast_realloc(FFIMFArena *arena, void *ptr, uint32_t *size, size_t min_size)
+{
+    size_t new_size;
+    void *new_ptr;
+
+    if (min_size <= *size)
+        return ptr;
+    if (min_size > UINT32_MAX)
+        return NULL;
+    new_size = FFMIN(UINT32_MAX, min_size + min_size / 16 + 32);
+
+    if (ptr && ptr == arena->last
+        && FFALIGN(new_size, IMF_ARENA_ALIGN) <= arena->end - arena->last) {
+        memset((uint8_t *)ptr + *size, 0, new_size - *size);
+        arena->ptr = arena->last + FFALIGN(new_size, IMF_ARENA_ALIGN);
+        *size = new_size;
+        return ptr;
+    }
+
+    if (!(new_ptr = imf_arena_alloc(arena, new_size)))
+        return NULL;
+    if (ptr)
+        memcpy(new_ptr, ptr, *size);
+    *size = new_size;
+
+    return new_ptr;
+}
+
+/**
+ * Returns a copy of str held by the arena, shared with the identical strings
+ * previously interned.
+ */
+static const xmlChar *imf_arena_intern(FFIMFArena *arena, const xmlChar *str)
+{
+    IMFArenaString **bucket;
+    IMFArenaString *string;
+    uint32_t hash = 2166136261u;
+    size_t len;
+
+    for (len = 0; str[len]; len++)
+        hash = (hash ^ str[len]) * 16777619u;
+
+    bucket = &arena->strings[hash % IMF_ARENA_STRING_BUCKETS];
+    for (string = *bucket; string; string = string->next)
+        if (string->hash == hash && !xmlStrcmp(string->str, str))
+            return string->str;
+
+    if (len > SIZE_MAX - sizeof(*string) - 1
+        || !(string = imf_arena_alloc(arena, sizeof(*string) + len + 1)))
+        return NULL;
+    string->hash = hash;
+    string->str = (xmlChar *)(string + 1);
+    memcpy(string->str, str, len + 1);
+    string->next = *bucket;
+    *bucket = string;
+
+    return string->str;
+}
+
+/**
+ * Interns the text content of an element.
+ * @return 0 on success, including if the element has no text content, in
+ * which case *str is set to NULL, or AVERROR(ENOMEM).
+ */
+static int imf_arena_intern_text(FFIMFArena *arena, xmlNodePtr element, const xmlChar **str)
+{
+    xmlChar *text = xmlNodeListGetString(element->doc, element->xmlChildrenNode, 1);
+
+    *str = NULL;
+    if (!text)
+        return 0;
+    *str = imf_arena_intern(arena, text);
+    xmlFree(text);
+
+    return *str ? 0 : AVERROR(ENOMEM);
+}
 
 xmlNodePtr ff_xml_get_child_element_by_name(xmlNodePtr parent, const char *name_utf8)
 {
@@ -125,6 +274,7 @@ static void imf_marker_virtual_track_init(FFIMFMarkerVirtualTrack *track)
 {
     imf_base_virtual_track_init((FFIMFBaseVirtualTrack *)track);
     track->resource_count = 0;
+    track->resources_alloc_sz = 0;
     track->resources = NULL;
 }
 
@@ -148,6 +298,7 @@ static void imf_marker_resource_init(FFIMFMarkerResource *rsrc)
 {
     imf_base_resource_init((FFIMFBaseResource *)rsrc);
     rsrc->marker_count = 0;
+    rsrc->markers_alloc_sz = 0;
     rsrc->markers = NULL;
 }
 
@@ -164,6 +315,11 @@ static void imf_trackfile_resource_init(FFIMFTrackFileResource *rsrc)
     memset(rsrc->track_file_uuid, 0, sizeof(rsrc->track_file_uuid));
 }
 
+static int fill_content_title_element(xmlNodePtr element, FFIMFCPL *cpl)
+{
+    return imf_arena_intern_text(cpl->arena, element, &cpl->content_title_utf8);
+}
+
 static int fill_content_title(xmlNodePtr cpl_element, FFIMFCPL *cpl)
 {
     xmlNodePtr element = NULL;
@@ -172,11 +328,8 @@ static int fill_content_title(xmlNodePtr cpl_element, FFIMFCPL *cpl)
         av_log(NULL, AV_LOG_ERROR, "ContentTitle element not found in the IMF CPL\n");
         return AVERROR_INVALIDDATA;
     }
-    cpl->content_title_utf8 = xmlNodeListGetString(cpl_element->doc,
-        element->xmlChildrenNode,
-        1);
 
-    return 0;
+    return fill_content_title_element(element, cpl);
 }
 
 static int fill_edit_rate(xmlNodePtr cpl_element, FFIMFCPL *cpl)
@@ -203,8 +356,9 @@ static int fill_id(xmlNodePtr cpl_element, FFIMFCPL *cpl)
     return ff_xml_read_uuid(element, cpl->id_uuid);
 }
 
-static int fill_marker(xmlNodePtr marker_elem, FFIMFMarker *marker)
+static int fill_marker(xmlNodePtr marker_elem, FFIMFMarker *marker, FFIMFCPL *cpl)
 {
+    xmlChar *scope;
     xmlNodePtr element = NULL;
     int ret = 0;
 
@@ -221,17 +375,21 @@ static int fill_marker(xmlNodePtr marker_elem, FFIMFMarker *marker)
         av_log(NULL, AV_LOG_ERROR, "Label element not found in a Marker\n");
         return AVERROR_INVALIDDATA;
     }
-    if (!(marker->label_utf8 = xmlNodeListGetString(element->doc, element->xmlChildrenNode, 1))) {
+    if ((ret = imf_arena_intern_text(cpl->arena, element, &marker->label_utf8)) < 0)
+        return ret;
+    if (!marker->label_utf8) {
         av_log(NULL, AV_LOG_ERROR, "Empty Label element found in a Marker\n");
         return AVERROR_INVALIDDATA;
     }
-    if (!(marker->scope_utf8 = xmlGetNoNsProp(element, "scope"))) {
-        marker->scope_utf8 = xmlCharStrdup("http://www.smpte-ra.org/schemas/2067-3/2013#standard-markers");
-        if (!marker->scope_utf8) {
-            xmlFree(marker->label_utf8);
-            return AVERROR(ENOMEM);
-        }
+    if ((scope = xmlGetNoNsProp(element, "scope"))) {
+        marker->scope_utf8 = imf_arena_intern(cpl->arena, scope);
+        xmlFree(scope);
+    } else {
+        marker->scope_utf8 = imf_arena_intern(cpl->arena,
+            "http://www.smpte-ra.org/schemas/2067-3/2013#standard-markers");
     }
+    if (!marker->scope_utf8)
+        return AVERROR(ENOMEM);
 
     return ret;
 }
@@ -323,14 +481,17 @@ static int fill_marker_resource(xmlNodePtr marker_resource_elem,
     element = xmlFirstElementChild(marker_resource_elem);
     while (element) {
         if (xmlStrcmp(element->name, "Marker") == 0) {
-            tmp = av_realloc(marker_resource->markers,
+            tmp = imf_arena_fast_realloc(cpl->arena,
+                marker_resource->markers,
+                &marker_resource->markers_alloc_sz,
                 (marker_resource->marker_count + 1) * sizeof(FFIMFMarker));
             if (!tmp)
                 return AVERROR(ENOMEM);
             marker_resource->markers = tmp;
             imf_marker_init(&marker_resource->markers[marker_resource->marker_count]);
             ret = fill_marker(element,
-                &marker_resource->markers[marker_resource->marker_count]);
+                &marker_resource->markers[marker_resource->marker_count],
+                cpl);
             marker_resource->marker_count++;
             if (ret)
                 return ret;
@@ -367,7 +528,7 @@ static int push_marker_sequence(xmlNodePtr marker_sequence_elem, FFIMFCPL *cpl)
 
     /* create main marker virtual track if it does not exist */
     if (!cpl->main_markers_track) {
-        cpl->main_markers_track = av_malloc(sizeof(FFIMFMarkerVirtualTrack));
+        cpl->main_markers_track = imf_arena_alloc(cpl->arena, sizeof(FFIMFMarkerVirtualTrack));
         if (!cpl->main_markers_track)
             return AVERROR(ENOMEM);
         imf_marker_virtual_track_init(cpl->main_markers_track);
@@ -382,7 +543,9 @@ static int push_marker_sequence(xmlNodePtr marker_sequence_elem, FFIMFCPL *cpl)
     if (!resource_list_elem)
         return 0;
     resource_elem_count = xmlChildElementCount(resource_list_elem);
-    tmp = av_realloc(cpl->main_markers_track->resources,
+    tmp = imf_arena_fast_realloc(cpl->arena,
+        cpl->main_markers_track->resources,
+        &cpl->main_markers_track->resources_alloc_sz,
         (cpl->main_markers_track->resource_count + resource_elem_count)
             * sizeof(FFIMFMarkerResource));
     if (!tmp) {
@@ -454,7 +617,9 @@ static int push_main_audio_sequence(xmlNodePtr audio_sequence_elem, FFIMFCPL *cp
 
     /* create a main audio virtual track if none exists for the sequence */
     if (!vt) {
-        tmp = av_realloc(cpl->main_audio_tracks,
+        tmp = imf_arena_fast_realloc(cpl->arena,
+            cpl->main_audio_tracks,
+            &cpl->main_audio_tracks_alloc_sz,
             (cpl->main_audio_track_count + 1) * sizeof(FFIMFTrackFileVirtualTrack));
         if (!tmp)
             return AVERROR(ENOMEM);
@@ -470,7 +635,8 @@ static int push_main_audio_sequence(xmlNodePtr audio_sequence_elem, FFIMFCPL *cp
     if (!resource_list_elem)
         return 0;
     resource_elem_count = xmlChildElementCount(resource_list_elem);
-    tmp = av_fast_realloc(vt->resources,
+    tmp = imf_arena_fast_realloc(cpl->arena,
+        vt->resources,
         &vt->resources_alloc_sz,
         (vt->resource_count + resource_elem_count) * sizeof(FFIMFTrackFileResource));
     if (!tmp) {
@@ -524,7 +690,7 @@ static int push_main_image_2d_sequence(xmlNodePtr image_sequence_elem, FFIMFCPL
 
     /* create main image virtual track if one does not exist */
     if (!cpl->main_image_2d_track) {
-        cpl->main_image_2d_track = av_malloc(sizeof(FFIMFTrackFileVirtualTrack));
+        cpl->main_image_2d_track = imf_arena_alloc(cpl->arena, sizeof(FFIMFTrackFileVirtualTrack));
         if (!cpl->main_image_2d_track)
             return AVERROR(ENOMEM);
         imf_trackfile_virtual_track_init(cpl->main_image_2d_track);
@@ -543,7 +709,8 @@ static int push_main_image_2d_sequence(xmlNodePtr image_sequence_elem, FFIMFCPL
     if (!resource_list_elem)
         return 0;
     resource_elem_count = xmlChildElementCount(resource_list_elem);
-    tmp = av_fast_realloc(cpl->main_image_2d_track->resources,
+    tmp = imf_arena_fast_realloc(cpl->arena,
+        cpl->main_image_2d_track->resources,
         &cpl->main_image_2d_track->resources_alloc_sz,
         (cpl->main_image_2d_track->resource_count + resource_elem_count) * sizeof(FFIMFTrackFileResource));
     if (!tmp) {
@@ -570,13 +737,47 @@ static int push_main_image_2d_sequence(xmlNodePtr image_sequence_elem, FFIMFCPL
     return 0;
 }
 
+/**
+ * Processes the sequences of a Segment element.
+ * @return the result of the last processed sequence, or AVERROR(ENOMEM).
+ */
+static int fill_segment(xmlNodePtr segment_elem, FFIMFCPL *cpl)
+{
+    int ret = 0;
+    xmlNodePtr sequence_list_elem = NULL;
+    xmlNodePtr sequence_elem = NULL;
+
+    av_log(NULL, AV_LOG_DEBUG, "Processing IMF CPL Segment\n");
+    sequence_list_elem = ff_xml_get_child_element_by_name(segment_elem, "SequenceList");
+    if (!sequence_list_elem)
+        return 0;
+    sequence_elem = xmlFirstElementChild(sequence_list_elem);
+    while (sequence_elem) {
+        if (xmlStrcmp(sequence_elem->name, "MarkerSequence") == 0)
+            ret = push_marker_sequence(sequence_elem, cpl);
+        else if (xmlStrcmp(sequence_elem->name, "MainImageSequence") == 0)
+            ret = push_main_image_2d_sequence(sequence_elem, cpl);
+        else if (xmlStrcmp(sequence_elem->name, "MainAudioSequence") == 0)
+            ret = push_main_audio_sequence(sequence_elem, cpl);
+        else
+            av_log(NULL,
+                AV_LOG_INFO,
+                "The following Sequence is not supported and is ignored: %s\n",
+                sequence_elem->name);
+        if (ret == AVERROR(ENOMEM))
+            /* abort parsing only if memory error occurred */
+            return ret;
+        sequence_elem = xmlNextElementSibling(sequence_elem);
+    }
+
+    return ret;
+}
+
 static int fill_virtual_tracks(xmlNodePtr cpl_element, FFIMFCPL *cpl)
 {
     int ret = 0;
     xmlNodePtr segment_list_elem = NULL;
     xmlNodePtr segment_elem = NULL;
-    xmlNodePtr sequence_list_elem = NULL;
-    xmlNodePtr sequence_elem = NULL;
 
     if (!(segment_list_elem = ff_xml_get_child_element_by_name(cpl_element, "SegmentList"))) {
         av_log(NULL, AV_LOG_ERROR, "SegmentList element missing\n");
@@ -586,28 +787,9 @@ static int fill_virtual_tracks(xmlNodePtr cpl_element, FFIMFCPL *cpl)
     /* process sequences */
     segment_elem = xmlFirstElementChild(segment_list_elem);
     while (segment_elem) {
-        av_log(NULL, AV_LOG_DEBUG, "Processing IMF CPL Segment\n");
-        sequence_list_elem = ff_xml_get_child_element_by_name(segment_elem, "SequenceList");
-        if (!segment_list_elem)
-            continue;
-        sequence_elem = xmlFirstElementChild(sequence_list_elem);
-        while (sequence_elem) {
-            if (xmlStrcmp(sequence_elem->name, "MarkerSequence") == 0)
-                ret = push_marker_sequence(sequence_elem, cpl);
-            else if (xmlStrcmp(sequence_elem->name, "MainImageSequence") == 0)
-                ret = push_main_image_2d_sequence(sequence_elem, cpl);
-            else if (xmlStrcmp(sequence_elem->name, "MainAudioSequence") == 0)
-                ret = push_main_audio_sequence(sequence_elem, cpl);
-            else
-                av_log(NULL,
-                    AV_LOG_INFO,
-                    "The following Sequence is not supported and is ignored: %s\n",
-                    sequence_elem->name);
-            if (ret == AVERROR(ENOMEM))
-                /* abort parsing only if memory error occurred */
-                return ret;
-            sequence_elem = xmlNextElementSibling(sequence_elem);
-        }
+        ret = fill_segment(segment_elem, cpl);
+        if (ret == AVERROR(ENOMEM))
+            return ret;
         segment_elem = xmlNextElementSibling(segment_elem);
     }
 
@@ -647,39 +829,6 @@ cleanup:
     return ret;
 }
 
-static void imf_marker_free(FFIMFMarker *marker)
-{
-    if (!marker)
-        return;
-    xmlFree(marker->label_utf8);
-    xmlFree(marker->scope_utf8);
-}
-
-static void imf_marker_resource_free(FFIMFMarkerResource *rsrc)
-{
-    if (!rsrc)
-        return;
-    for (uint32_t i = 0; i < rsrc->marker_count; i++)
-        imf_marker_free(&rsrc->markers[i]);
-    av_freep(&rsrc->markers);
-}
-
-static void imf_marker_virtual_track_free(FFIMFMarkerVirtualTrack *vt)
-{
-    if (!vt)
-        return;
-    for (uint32_t i = 0; i < vt->resource_count; i++)
-        imf_marker_resource_free(&vt->resources[i]);
-    av_freep(&vt->resources);
-}
-
-static void imf_trackfile_virtual_track_free(FFIMFTrackFileVirtualTrack *vt)
-{
-    if (!vt)
-        return;
-    av_freep(&vt->resources);
-}
-
 static void imf_cpl_init(FFIMFCPL *cpl)
 {
     memset(cpl->id_uuid, 0, sizeof(cpl->id_uuid));
@@ -688,78 +837,467 @@ static void imf_cpl_init(FFIMFCPL *cpl)
     cpl->main_markers_track = NULL;
     cpl->main_image_2d_track = NULL;
     cpl->main_audio_track_count = 0;
+    cpl->main_audio_tracks_alloc_sz = 0;
     cpl->main_audio_tracks = NULL;
 }
 
 FFIMFCPL *ff_imf_cpl_alloc(void)
 {
+    FFIMFArena *arena;
     FFIMFCPL *cpl;
 
-    cpl = av_malloc(sizeof(FFIMFCPL));
-    if (!cpl)
+    arena = av_mallocz(sizeof(FFIMFArena));
+    if (!arena)
+        return NULL;
+    cpl = imf_arena_alloc(arena, sizeof(FFIMFCPL));
+    if (!cpl) {
+        av_free(arena);
         return NULL;
+    }
     imf_cpl_init(cpl);
+    cpl->arena = arena;
     return cpl;
 }
 
 void ff_imf_cpl_free(FFIMFCPL *cpl)
 {
+    FFIMFArena *arena;
+    IMFArenaBlock *block;
+
     if (!cpl)
         return;
-    xmlFree(cpl->content_title_utf8);
-    imf_marker_virtual_track_free(cpl->main_markers_track);
-    if (cpl->main_markers_track)
-        av_freep(&cpl->main_markers_track);
-    imf_trackfile_virtual_track_free(cpl->main_image_2d_track);
-    if (cpl->main_image_2d_track)
-        av_freep(&cpl->main_image_2d_track);
-    for (uint32_t i = 0; i < cpl->main_audio_track_count; i++)
-        imf_trackfile_virtual_track_free(&cpl->main_audio_tracks[i]);
-    if (cpl->main_audio_tracks)
-        av_freep(&cpl->main_audio_tracks);
-    av_freep(&cpl);
+
+    /* the CPL itself lives in the arena */
+    arena = cpl->arena;
+    while ((block = arena->blocks)) {
+        arena->blocks = block->next;
+        av_free(block);
+    }
+    av_free(arena);
 }
 
-int ff_parse_imf_cpl(AVIOContext *in, FFIMFCPL **cpl)
+static int xml_reader_read_avio(void *opaque, char *buffer, int len)
 {
-    AVBPrint buf;
-    xmlDoc *doc = NULL;
+    int ret = avio_read(opaque, buffer, len);
+
+    if (ret == AVERROR_EOF)
+        return 0;
+    return ret < 0 ? -1 : ret;
+}
+
+static int xml_reader_close_avio(void *opaque)
+{
+    return 0;
+}
+
+xmlTextReaderPtr ff_xml_reader_for_avio(AVIOContext *in, const char *url)
+{
+    LIBXML_TEST_VERSION
+
+    return xmlReaderForIO(xml_reader_read_avio, xml_reader_close_avio, in, url, NULL, 0);
+}
+
+int ff_xml_reader_next_child_element(xmlTextReaderPtr reader, int parent_depth, int skip_current)
+{
+    int ret;
+
+    ret = skip_current ? xmlTextReaderNext(reader) : xmlTextReaderRead(reader);
+    while (ret == 1) {
+        if (xmlTextReaderDepth(reader) <= parent_depth)
+            return 0;
+        if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT
+            && xmlTextReaderDepth(reader) == parent_depth + 1)
+            return 1;
+        ret = xmlTextReaderRead(reader);
+    }
+
+    return ret < 0 ? AVERROR_INVALIDDATA : 0;
+}
+
+/**
+ * Processes the children of the SegmentList element the reader is positioned
+ * on, expanding one Segment at a time.
+ */
+static int fill_virtual_tracks_from_reader(xmlTextReaderPtr reader, FFIMFCPL *cpl)
+{
+    int depth = xmlTextReaderDepth(reader);
+    xmlNodePtr segment_elem;
     int ret = 0;
-    int64_t filesize = 0;
-
-    filesize = avio_size(in);
-    filesize = filesize > 0 ? filesize : 8192;
-    av_bprint_init(&buf, filesize + 1, AV_BPRINT_SIZE_UNLIMITED);
-    ret = avio_read_to_bprint(in, &buf, UINT_MAX - 1);
-    if (ret < 0 || !avio_feof(in) || (filesize = buf.len) == 0) {
-        if (ret == 0) {
-            av_log(NULL, AV_LOG_ERROR, "Cannot read IMF CPL\n");
-            return AVERROR_INVALIDDATA;
+    int next;
+
+    if (xmlTextReaderIsEmptyElement(reader))
+        return 0;
+
+    next = ff_xml_reader_next_child_element(reader, depth, 0);
+    while (next > 0) {
+        if (xmlStrcmp(xmlTextReaderConstLocalName(reader), "Segment") == 0) {
+            if (!(segment_elem = xmlTextReaderExpand(reader)))
+                return AVERROR_INVALIDDATA;
+            ret = fill_segment(segment_elem, cpl);
+            if (ret == AVERROR(ENOMEM))
+                return ret;
+        }
+        next = ff_xml_reader_next_child_element(reader, depth, 1);
+    }
+
+    return next < 0 ? next : ret;
+}
+
+static int fill_cpl_from_reader(xmlTextReaderPtr reader, FFIMFCPL *cpl)
+{
+    const xmlChar *name;
+    xmlNodePtr element;
+    int has_content_title = 0;
+    int has_id = 0;
+    int has_edit_rate = 0;
+    int has_segment_list = 0;
+    int ret = 0;
+    int next;
+
+    /* move to the root element */
+    if ((next = ff_xml_reader_next_child_element(reader, -1, 0)) <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "XML parsing failed when reading the IMF CPL\n");
+        return AVERROR_INVALIDDATA;
+    }
+    if (xmlStrcmp(xmlTextReaderConstLocalName(reader), "CompositionPlaylist")) {
+        av_log(NULL, AV_LOG_ERROR, "The root element of the CPL is not CompositionPlaylist\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    next = ff_xml_reader_next_child_element(reader, 0, 0);
+    while (next > 0) {
+        name = xmlTextReaderConstLocalName(reader);
+        if (xmlStrcmp(name, "SegmentList") == 0) {
+            if (!has_edit_rate) {
+                av_log(NULL, AV_LOG_ERROR, "EditRate element not found before SegmentList in the IMF CPL\n");
+                return AVERROR_INVALIDDATA;
+            }
+            has_segment_list = 1;
+            if ((ret = fill_virtual_tracks_from_reader(reader, cpl)) == AVERROR(ENOMEM))
+                return ret;
+        } else if (xmlStrcmp(name, "ContentTitle") == 0
+            || xmlStrcmp(name, "Id") == 0
+            || xmlStrcmp(name, "EditRate") == 0) {
+            if (!(element = xmlTextReaderExpand(reader)))
+                return AVERROR_INVALIDDATA;
+            if (xmlStrcmp(name, "ContentTitle") == 0) {
+                has_content_title = 1;
+                ret = fill_content_title_element(element, cpl);
+            } else if (xmlStrcmp(name, "Id") == 0) {
+                has_id = 1;
+                ret = ff_xml_read_uuid(element, cpl->id_uuid);
+            } else {
+                has_edit_rate = 1;
+                ret = ff_xml_read_rational(element, &cpl->edit_rate);
+            }
+            if (ret)
+                return ret;
         }
+        next = ff_xml_reader_next_child_element(reader, 0, 1);
+    }
+    if (next < 0) {
+        av_log(NULL, AV_LOG_ERROR, "XML parsing failed when reading the IMF CPL\n");
+        return next;
+    }
+
+    if (!has_content_title) {
+        av_log(NULL, AV_LOG_ERROR, "ContentTitle element not found in the IMF CPL\n");
+        return AVERROR_INVALIDDATA;
+    }
+    if (!has_id) {
+        av_log(NULL, AV_LOG_ERROR, "Id element not found in the IMF CPL\n");
+        return AVERROR_INVALIDDATA;
+    }
+    if (!has_segment_list) {
+        av_log(NULL, AV_LOG_ERROR, "SegmentList element missing\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    return ret;
+}
+
+int ff_parse_imf_cpl(AVIOContext *in, FFIMFCPL **cpl)
+{
+    xmlTextReaderPtr reader;
+    int ret = 0;
+
+    if (!(reader = ff_xml_reader_for_avio(in, NULL))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot read IMF CPL\n");
+        return AVERROR(ENOMEM);
+    }
+
+    *cpl = ff_imf_cpl_alloc();
+    if (!*cpl) {
+        ret = AVERROR(ENOMEM);
+        goto cleanup;
+    }
+
+    if (ret = fill_cpl_from_reader(reader, *cpl)) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot parse IMF CPL\n");
+        ff_imf_cpl_free(*cpl);
+        *cpl = NULL;
     } else {
-        LIBXML_TEST_VERSION
-        doc = xmlReadMemory(buf.str, filesize, NULL, NULL, 0);
-        if (!doc) {
-            av_log(NULL,
-                AV_LOG_ERROR,
-                "XML parsing failed when reading the IMF CPL\n");
-            ret = AVERROR_INVALIDDATA;
+        av_log(NULL,
+            AV_LOG_INFO,
+            "IMF CPL ContentTitle: %s\n",
+            (*cpl)->content_title_utf8);
+        av_log(NULL,
+            AV_LOG_INFO,
+            "IMF CPL Id: " FF_UUID_FORMAT "\n",
+            UID_ARG((*cpl)->id_uuid));
+    }
+
+cleanup:
+    xmlFreeTextReader(reader);
+
+    return ret;
+}
+
+#define IMF_CPL_SERIALIZATION_VERSION 1
+
+static void write_xml_string(AVIOContext *pb, const xmlChar *str)
+{
+    size_t len = str ? strlen((const char *)str) : 0;
+
+    if (!str || len >= UINT32_MAX) {
+        avio_wl32(pb, UINT32_MAX);
+        return;
+    }
+    avio_wl32(pb, len);
+    avio_write(pb, str, len);
+}
+
+static int read_xml_string(AVIOContext *pb, FFIMFArena *arena, const xmlChar **str)
+{
+    uint32_t len = avio_rl32(pb);
+    xmlChar *buf;
+    int ret = 0;
+
+    *str = NULL;
+    if (len == UINT32_MAX)
+        return 0;
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+    if (!(buf = av_malloc((size_t)len + 1)))
+        return AVERROR(ENOMEM);
+    if (avio_read(pb, buf, len) != len) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    buf[len] = 0;
+    if (!(*str = imf_arena_intern(arena, buf)))
+        ret = AVERROR(ENOMEM);
+
+end:
+    av_free(buf);
+    return ret;
+}
+
+static void write_base_resource(AVIOContext *pb, const FFIMFBaseResource *rsrc)
+{
+    avio_wl32(pb, rsrc->edit_rate.num);
+    avio_wl32(pb, rsrc->edit_rate.den);
+    avio_wl32(pb, rsrc->entry_point);
+    avio_wl32(pb, rsrc->duration);
+    avio_wl32(pb, rsrc->repeat_count);
+}
+
+static void read_base_resource(AVIOContext *pb, FFIMFBaseResource *rsrc)
+{
+    rsrc->edit_rate.num = (int32_t)avio_rl32(pb);
+    rsrc->edit_rate.den = (int32_t)avio_rl32(pb);
+    rsrc->entry_point = avio_rl32(pb);
+    rsrc->duration = avio_rl32(pb);
+    rsrc->repeat_count = avio_rl32(pb);
+}
+
+static void write_trackfile_virtual_track(AVIOContext *pb, const FFIMFTrackFileVirtualTrack *vt)
+{
+    avio_write(pb, vt->base.id_uuid, sizeof(vt->base.id_uuid));
+    avio_wl32(pb, vt->resource_count);
+    for (uint32_t i = 0; i < vt->resource_count; i++) {
+        write_base_resource(pb, &vt->resources[i].base);
+        avio_write(pb, vt->resources[i].track_file_uuid, sizeof(vt->resources[i].track_file_uuid));
+    }
+}
+
+static int read_trackfile_virtual_track(AVIOContext *pb, FFIMFArena *arena, FFIMFTrackFileVirtualTrack *vt)
+{
+    uint32_t resource_count;
+
+    avio_read(pb, vt->base.id_uuid, sizeof(vt->base.id_uuid));
+    resource_count = avio_rl32(pb);
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+    if (resource_count) {
+        vt->resources = imf_arena_fast_realloc(arena,
+            NULL,
+            &vt->resources_alloc_sz,
+            (size_t)resource_count * sizeof(FFIMFTrackFileResource));
+        if (!vt->resources)
+            return AVERROR(ENOMEM);
+    }
+    for (; vt->resource_count < resource_count; vt->resource_count++) {
+        FFIMFTrackFileResource *rsrc = &vt->resources[vt->resource_count];
+
+        read_base_resource(pb, &rsrc->base);
+        if (avio_read(pb, rsrc->track_file_uuid, sizeof(rsrc->track_file_uuid)) != sizeof(rsrc->track_file_uuid))
+            return AVERROR_INVALIDDATA;
+    }
+
+    return 0;
+}
+
+static void write_marker_virtual_track(AVIOContext *pb, const FFIMFMarkerVirtualTrack *vt)
+{
+    avio_write(pb, vt->base.id_uuid, sizeof(vt->base.id_uuid));
+    avio_wl32(pb, vt->resource_count);
+    for (uint32_t i = 0; i < vt->resource_count; i++) {
+        write_base_resource(pb, &vt->resources[i].base);
+        avio_wl32(pb, vt->resources[i].marker_count);
+        for (uint32_t j = 0; j < vt->resources[i].marker_count; j++) {
+            write_xml_string(pb, vt->resources[i].markers[j].label_utf8);
+            write_xml_string(pb, vt->resources[i].markers[j].scope_utf8);
+            avio_wl32(pb, vt->resources[i].markers[j].offset);
         }
-        if (ret = ff_parse_imf_cpl_from_xml_dom(doc, cpl)) {
-            av_log(NULL, AV_LOG_ERROR, "Cannot parse IMF CPL\n");
-        } else {
-            av_log(NULL,
-                AV_LOG_INFO,
-                "IMF CPL ContentTitle: %s\n",
-                (*cpl)->content_title_utf8);
-            av_log(NULL,
-                AV_LOG_INFO,
-                "IMF CPL Id: " FF_UUID_FORMAT "\n",
-                UID_ARG((*cpl)->id_uuid));
+    }
+}
+
+static int read_marker_virtual_track(AVIOContext *pb, FFIMFArena *arena, FFIMFMarkerVirtualTrack *vt)
+{
+    uint32_t resource_count;
+    uint32_t marker_count;
+    int ret;
+
+    avio_read(pb, vt->base.id_uuid, sizeof(vt->base.id_uuid));
+    resource_count = avio_rl32(pb);
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+    if (resource_count
+        && !(vt->resources = imf_arena_fast_realloc(arena,
+            NULL,
+            &vt->resources_alloc_sz,
+            (size_t)resource_count * sizeof(FFIMFMarkerResource))))
+        return AVERROR(ENOMEM);
+    while (vt->resource_count < resource_count) {
+        FFIMFMarkerResource *rsrc = &vt->resources[vt->resource_count++];
+
+        imf_marker_resource_init(rsrc);
+        read_base_resource(pb, &rsrc->base);
+        marker_count = avio_rl32(pb);
+        if (avio_feof(pb))
+            return AVERROR_INVALIDDATA;
+        if (marker_count
+            && !(rsrc->markers = imf_arena_fast_realloc(arena,
+                NULL,
+                &rsrc->markers_alloc_sz,
+                (size_t)marker_count * sizeof(FFIMFMarker))))
+            return AVERROR(ENOMEM);
+        while (rsrc->marker_count < marker_count) {
+            FFIMFMarker *marker = &rsrc->markers[rsrc->marker_count++];
+
+            imf_marker_init(marker);
+            if ((ret = read_xml_string(pb, arena, &marker->label_utf8)) < 0 ||
+                (ret = read_xml_string(pb, arena, &marker->scope_utf8)) < 0)
+                return ret;
+            marker->offset = avio_rl32(pb);
         }
-        xmlFreeDoc(doc);
     }
-    av_bprint_finalize(&buf, NULL);
+
+    return 0;
+}
+
+int ff_imf_cpl_write(AVIOContext *pb, const FFIMFCPL *cpl)
+{
+    ffio_wfourcc(pb, "IMFC");
+    avio_wl32(pb, IMF_CPL_SERIALIZATION_VERSION);
+    avio_write(pb, cpl->id_uuid, sizeof(cpl->id_uuid));
+    write_xml_string(pb, cpl->content_title_utf8);
+    avio_wl32(pb, cpl->edit_rate.num);
+    avio_wl32(pb, cpl->edit_rate.den);
+
+    avio_w8(pb, !!cpl->main_markers_track);
+    if (cpl->main_markers_track)
+        write_marker_virtual_track(pb, cpl->main_markers_track);
+
+    avio_w8(pb, !!cpl->main_image_2d_track);
+    if (cpl->main_image_2d_track)
+        write_trackfile_virtual_track(pb, cpl->main_image_2d_track);
+
+    avio_wl32(pb, cpl->main_audio_track_count);
+    for (uint32_t i = 0; i < cpl->main_audio_track_count; i++)
+        write_trackfile_virtual_track(pb, &cpl->main_audio_tracks[i]);
+
+    return pb->error;
+}
+
+static int read_cpl(AVIOContext *pb, FFIMFCPL *cpl)
+{
+    uint32_t audio_track_count;
+    int ret;
+
+    if (avio_rl32(pb) != MKTAG('I', 'M', 'F', 'C')
+        || avio_rl32(pb) != IMF_CPL_SERIALIZATION_VERSION)
+        return AVERROR_INVALIDDATA;
+    avio_read(pb, cpl->id_uuid, sizeof(cpl->id_uuid));
+    if ((ret = read_xml_string(pb, cpl->arena, &cpl->content_title_utf8)) < 0)
+        return ret;
+    cpl->edit_rate.num = (int32_t)avio_rl32(pb);
+    cpl->edit_rate.den = (int32_t)avio_rl32(pb);
+
+    if (avio_r8(pb)) {
+        if (!(cpl->main_markers_track = imf_arena_alloc(cpl->arena, sizeof(FFIMFMarkerVirtualTrack))))
+            return AVERROR(ENOMEM);
+        imf_marker_virtual_track_init(cpl->main_markers_track);
+        if ((ret = read_marker_virtual_track(pb, cpl->arena, cpl->main_markers_track)) < 0)
+            return ret;
+    }
+
+    if (avio_r8(pb)) {
+        if (!(cpl->main_image_2d_track = imf_arena_alloc(cpl->arena, sizeof(FFIMFTrackFileVirtualTrack))))
+            return AVERROR(ENOMEM);
+        imf_trackfile_virtual_track_init(cpl->main_image_2d_track);
+        if ((ret = read_trackfile_virtual_track(pb, cpl->arena, cpl->main_image_2d_track)) < 0)
+            return ret;
+    }
+
+    audio_track_count = avio_rl32(pb);
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+    if (audio_track_count
+        && !(cpl->main_audio_tracks = imf_arena_fast_realloc(cpl->arena,
+            NULL,
+            &cpl->main_audio_tracks_alloc_sz,
+            (size_t)audio_track_count * sizeof(FFIMFTrackFileVirtualTrack))))
+        return AVERROR(ENOMEM);
+    while (cpl->main_audio_track_count < audio_track_count) {
+        FFIMFTrackFileVirtualTrack *vt = &cpl->main_audio_tracks[cpl->main_audio_track_count++];
+
+        imf_trackfile_virtual_track_init(vt);
+        if ((ret = read_trackfile_virtual_track(pb, cpl->arena, vt)) < 0)
+            return ret;
+    }
+
+    if (pb->error)
+        return pb->error;
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+
+    return 0;
+}
+
+int ff_imf_cpl_read(AVIOContext *pb, FFIMFCPL **cpl)
+{
+    int ret;
+
+    *cpl = ff_imf_cpl_alloc();
+    if (!*cpl)
+        return AVERROR(ENOMEM);
+
+    if ((ret = read_cpl(pb, *cpl)) < 0) {
+        ff_imf_cpl_free(*cpl);
+        *cpl = NULL;
+    }
 
     return ret;
 }
@@ -45,19 +45,34 @@
  * @ingroup lavu_imf
  */
 
+#include "config.h"
 #include "imf.h"
 #include "internal.h"
 #include "libavutil/avstring.h"
+#include "libavutil/base64.h"
 #include "libavutil/bprint.h"
+#include "libavutil/hash.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+#include "libavutil/timecode.h"
+#include "libavutil/trace_internal.h"
+#include "http.h"
 #include "mxf.h"
+#include "os_support.h"
 #include "url.h"
 #include "avio_internal.h"
 #include <inttypes.h>
+#include <sys/stat.h>
 #include <libxml/parser.h>
 
-#define MAX_BPRINT_READ_SIZE (UINT_MAX - 1)
-#define DEFAULT_ASSETMAP_SIZE 8 * 1024
+#define IMF_CACHE_VERSION 2
+#define IMF_IO_POOL_SIZE 16
+#define IMF_READ_BATCH 16
 #define AVRATIONAL_FORMAT "%d/%d"
 #define AVRATIONAL_ARG(rational) rational.num, rational.den
 
@@ -67,8 +82,17 @@
 typedef struct IMFAssetLocator {
     FFUUID uuid;
     char *absolute_uri;
+    int packing_list; /**< The asset is a packing list */
 } IMFAssetLocator;
 
+/**
+ * Entry of the UUID-sorted index of an IMF Asset locator map
+ */
+typedef struct IMFAssetLocatorIndexEntry {
+    FFUUID uuid;
+    uint32_t asset_index;
+} IMFAssetLocatorIndexEntry;
+
 /**
  * IMF Asset locator map
  * Results from the parsing of one or more ASSETMAP XML files
@@ -76,39 +100,207 @@ typedef struct IMFAssetLocator {
 typedef struct IMFAssetLocatorMap {
     uint32_t asset_count;
     IMFAssetLocator *assets;
+    unsigned int assets_alloc_sz; /**< Size of the assets buffer */
+    uint32_t index_count;
+    IMFAssetLocatorIndexEntry *index; /**< assets sorted by UUID, then by parsing order */
 } IMFAssetLocatorMap;
 
+/**
+ * Hash of an asset listed in a packing list, and its verification
+ */
+typedef struct IMFAssetHash {
+    FFUUID uuid;
+    int64_t size;                        /**< Size of the asset in the packing list */
+    uint8_t digest[AV_HASH_MAX_SIZE];    /**< Hash of the asset in the packing list */
+    struct AVHashContext *hash;
+    char *uri;                           /**< Location of the asset, or NULL if no asset map lists it */
+    AVMutex lock;
+    int64_t hashed;                      /**< Size of the start of the asset hashed so far */
+} IMFAssetHash;
+
+/**
+ * Asset hashes of the packing lists of the package
+ */
+typedef struct IMFPackingList {
+    uint32_t asset_count;
+    IMFAssetHash *assets;
+    unsigned int assets_alloc_sz; /**< Size of the assets buffer */
+} IMFPackingList;
+
+/**
+ * Asset map or packing list fetched and parsed by a worker thread, while the
+ * demuxer goes on with the other documents of the package
+ */
+typedef struct IMFDocumentFetch {
+    AVFormatContext *s;
+    char *url;
+    int packing_list;                          /**< The document is a packing list, not an asset map */
+    IMFAssetLocatorMap asset_map;              /**< Parsed asset map, if not shared */
+    struct IMFAssetMapCacheEntry *cache_entry; /**< Parsed asset map, if shared */
+    IMFPackingList pkl;                        /**< Parsed packing list, whose hashes have no lock yet */
+    int done;
+    int ret;
+#if HAVE_THREADS
+    pthread_t thread;
+    int thread_running;
+#endif
+} IMFDocumentFetch;
+
+/**
+ * Demuxer context of a track file, shared by all the resources of a virtual
+ * track that reference the same TrackFileId (including repeated resources)
+ */
+typedef struct IMFTrackFileCtx {
+    FFUUID uuid;
+    int32_t track_index;
+    uint32_t ref_count;
+    AVFormatContext *ctx;
+    int preopening; /**< Set while the context is being opened by a worker thread */
+    int parked;     /**< The context keeps its parsed header, but has no AVIOContext */
+    unsigned park_seq; /**< Order in which the context was parked */
+    int in_use;     /**< The context is read, or being opened, by its track */
+    unsigned use_seq;  /**< Order in which the context was last used */
+    // Statistics, updated by the thread that opens the context
+    int opens;
+    int reattaches; /**< Reopens of a parked context, without parsing the header */
+    int64_t open_time;  /**< Time spent in avformat_open_input(), in microseconds */
+    int64_t probe_time; /**< Time spent in avformat_find_stream_info(), in microseconds */
+    int seeks;
+    int64_t seek_time;  /**< Time spent seeking to entry points, in microseconds */
+} IMFTrackFileCtx;
+
 typedef struct IMFVirtualTrackResourcePlaybackCtx {
     IMFAssetLocator *locator;
     FFIMFTrackFileResource *resource;
-    AVFormatContext *ctx;
+    IMFTrackFileCtx *track_file;
+    int64_t start_edit_unit; /**< Offset of the resource in the virtual track, in edit units */
+    uint32_t entry_point;    /**< Entry point of the resource, trimmed to the timeline window */
+    uint32_t duration;       /**< Duration of the resource, trimmed to the timeline window */
 } IMFVirtualTrackResourcePlaybackCtx;
 
+#if HAVE_THREADS
+/**
+ * Packet read ahead by the worker thread of a virtual track
+ */
+typedef struct IMFReadAheadMsg {
+    AVPacket *pkt;     /**< Packet, or NULL at the end of the track */
+    int64_t timestamp; /**< Timestamp of the track before the packet, in the track stream time base */
+    int ret;           /**< Error that ended the track, when pkt is NULL */
+} IMFReadAheadMsg;
+#endif
+
 typedef struct IMFVirtualTrackPlaybackCtx {
     // Track index in playlist
     int32_t index;
-    // Time counters
-    AVRational current_timestamp;
-    AVRational duration;
+    int discard; /**< The stream of the track is discarded: the track is not read */
+    // Time counters, in the time base of the track stream
+    int64_t current_timestamp;
+    int64_t duration;
+    // Scheduling key: current timestamp in the common time base of the tracks
+    int64_t heap_timestamp;
     // Resources
     uint32_t resource_count;
     uint32_t resources_alloc_sz;
     IMFVirtualTrackResourcePlaybackCtx *resources;
     // Decoding cursors
     uint32_t current_resource_index;
+    uint32_t prefetched_resource; /**< Index of the last resource whose start was prefetched */
     int64_t last_pts;
+    // Coalescing of PCM edit units
+    AVPacket *coalesce_pkt;
+    // Batch of packets read ahead from the track file of the current resource
+    int batch_size; /**< Number of packets to read at once, set during imf_read_packets() */
+    AVPacket *batch_pkts[IMF_READ_BATCH];
+    int batch_pos;
+    int batch_nb;
+    AVDictionary *map; /**< Byte-range map of the resources, exported as stream metadata */
+    // Statistics
+    int64_t packet_count;
+    int64_t byte_count;
+    int64_t read_time; /**< Time spent in av_read_frame(), in microseconds */
+    int resource_switches;
+    // Background opening of the next resource
+    int preopen;
+#if HAVE_THREADS
+    AVFormatContext *preopen_avf;
+    IMFVirtualTrackResourcePlaybackCtx *preopen_resource;
+    pthread_t preopen_thread;
+    int preopen_thread_running;
+    int preopen_ret;
+    // Read-ahead of the packets on a worker thread
+    AVFormatContext *read_ahead_avf;
+    AVThreadMessageQueue *read_ahead_queue;
+    pthread_t read_ahead_thread;
+    int read_ahead_thread_running;
+    IMFReadAheadMsg read_ahead_head; /**< Next packet to return from the track */
+#endif
 } IMFVirtualTrackPlaybackCtx;
 
 typedef struct IMFContext {
     const AVClass *class;
     const char *base_url;
     char *asset_map_paths;
+    IMFDocumentFetch **asset_map_fetches; /**< Asset maps of asset_map_paths, in order */
+    int nb_asset_map_fetches;
+    int next_asset_map;                   /**< Index of the first asset map that is not loaded yet */
+    int concurrent_fetch;
     AVIOInterruptCB *interrupt_callback;
     AVDictionary *avio_opts;
     FFIMFCPL *cpl;
     IMFAssetLocatorMap asset_locator_map;
     uint32_t track_count;
     IMFVirtualTrackPlaybackCtx **tracks;
+    uint32_t track_file_count;
+    IMFTrackFileCtx **track_files;
+    char *preopen_tracks;
+    int max_open_resources;
+    int max_parked_resources;
+    unsigned park_seq;
+    unsigned use_seq;
+    AVMutex track_files_lock; /**< Protects the open state of the track files, changed by the read-ahead threads */
+    int open_threads;
+    int fast_open;
+    int header_only;
+    int flatten;
+    int check;
+    int check_errors;
+    char *cache_dir;
+    int http_persistent;
+    int read_ahead;
+    int read_ahead_started;
+    int64_t prefetch_size; /**< Size of the data prefetched at the start of the next resource */
+    int64_t prefetch_lead; /**< Time before the end of a resource at which the next one is prefetched, in microseconds */
+    int audio_edit_units_per_packet;
+    int64_t interleave_window; /**< Maximum duration of a run of packets of one track, in microseconds */
+    int64_t interleave_bytes;  /**< Maximum size of a run of packets of one track */
+    int64_t run_start;         /**< Timestamp of the current run in the scheduling time base, or AV_NOPTS_VALUE */
+    int64_t run_bytes;         /**< Size of the packets of the current run */
+    int stats;
+    int export_resources;
+    int export_map;
+    int map_span; /**< Edit units per byte range of the exported map, 0 for one range per resource */
+    int export_content_ids;
+    int verify_hashes;
+    int lazy_index;
+    int follow;
+    int64_t follow_timeout; /**< Time after which a followed track file that stops growing is ended, in microseconds */
+    IMFPackingList packing_list;
+    int assetmap_cache;
+    char *window_start_str;
+    char *window_end_str;
+    int64_t window_start; /**< First edit unit of the composition to present */
+    int64_t window_end;   /**< Edit unit following the last one to present, or INT64_MAX */
+    char *seek_marker;
+    char *track_id_str;
+    FFUUID track_id;
+    int64_t seek_marker_ts; /**< Position of seek_marker in AV_TIME_BASE units, or AV_NOPTS_VALUE */
+    struct IMFAssetMapCacheEntry **asset_map_cache_entries; /**< Shared asset maps referenced by the demuxer */
+    unsigned asset_map_cache_entry_count;
+    AVMutex io_pool_lock;
+    int io_pool_count;
+    AVIOContext *io_pool[IMF_IO_POOL_SIZE]; /**< Idle keep-alive HTTP contexts */
+    AVRational time_base;                   /**< Time base common to all the tracks */
+    IMFVirtualTrackPlaybackCtx **track_heap; /**< Tracks, as a min-heap on heap_timestamp */
 } IMFContext;
 
 static int imf_uri_is_url(const char *string)
@@ -138,98 +330,176 @@ static int imf_uri_is_dos_abs_path(const char *string)
     return 0;
 }
 
+static int imf_asset_locator_index_entry_cmp(const void *a, const void *b)
+{
+    const IMFAssetLocatorIndexEntry *entry_a = a;
+    const IMFAssetLocatorIndexEntry *entry_b = b;
+    int ret = memcmp(entry_a->uuid, entry_b->uuid, sizeof(entry_a->uuid));
+
+    if (ret)
+        return ret;
+    return FFDIFFSIGN(entry_a->asset_index, entry_b->asset_index);
+}
+
 /**
- * Parse a ASSETMAP XML file to extract the UUID-URI mapping of assets.
- * @param s the current format context, if any (can be NULL).
- * @param doc the XML document to be parsed.
- * @param asset_map pointer on the IMFAssetLocatorMap to fill.
- * @param base_url the url of the asset map XML file, if any (can be NULL).
+ * Rebuilds the UUID-sorted index of an IMFAssetLocatorMap from its assets.
  * @return a negative value in case of error, 0 otherwise.
  */
-static int parse_imf_asset_map_from_xml_dom(AVFormatContext *s,
-    xmlDocPtr doc,
+static int imf_asset_locator_map_build_index(IMFAssetLocatorMap *asset_map)
+{
+    void *tmp;
+
+    tmp = av_realloc_array(asset_map->index, asset_map->asset_count, sizeof(IMFAssetLocatorIndexEntry));
+    if (!tmp && asset_map->asset_count)
+        return AVERROR(ENOMEM);
+    asset_map->index = tmp;
+
+    for (uint32_t i = 0; i < asset_map->asset_count; ++i) {
+        memcpy(asset_map->index[i].uuid, asset_map->assets[i].uuid, sizeof(FFUUID));
+        asset_map->index[i].asset_index = i;
+    }
+    asset_map->index_count = asset_map->asset_count;
+
+    if (asset_map->index_count)
+        qsort(asset_map->index,
+            asset_map->index_count,
+            sizeof(IMFAssetLocatorIndexEntry),
+            imf_asset_locator_index_entry_cmp);
+
+    return 0;
+}
+
+/**
+ * Appends the locator described by an Asset element to an asset map.
+ */
+static int parse_imf_asset_element(AVFormatContext *s,
+    xmlNodePtr asset_element,
     IMFAssetLocatorMap *asset_map,
     const char *base_url)
 {
-    xmlNodePtr asset_map_element = NULL;
     xmlNodePtr node = NULL;
-    xmlNodePtr asset_element = NULL;
     char *uri;
-    int ret = 0;
     IMFAssetLocator *asset = NULL;
     void *tmp;
 
-    asset_map_element = xmlDocGetRootElement(doc);
+    if (asset_map->asset_count == UINT32_MAX)
+        return AVERROR(ENOMEM);
+    tmp = av_fast_realloc(asset_map->assets,
+        &asset_map->assets_alloc_sz,
+        (asset_map->asset_count + 1) * sizeof(IMFAssetLocator));
+    if (!tmp) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate IMF asset locators\n");
+        return AVERROR(ENOMEM);
+    }
+    asset_map->assets = tmp;
 
-    if (!asset_map_element) {
-        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing root node\n");
+    asset = &(asset_map->assets[asset_map->asset_count]);
+
+    if (ff_xml_read_uuid(ff_xml_get_child_element_by_name(asset_element, "Id"), asset->uuid)) {
+        av_log(s, AV_LOG_ERROR, "Could not parse UUID from asset in asset map.\n");
         return AVERROR_INVALIDDATA;
     }
 
-    if (asset_map_element->type != XML_ELEMENT_NODE || av_strcasecmp(asset_map_element->name, "AssetMap")) {
-        av_log(s,
-            AV_LOG_ERROR,
-            "Unable to parse asset map XML - wrong root node name[%s] type[%d]\n",
-            asset_map_element->name,
-            (int)asset_map_element->type);
+    asset->packing_list = 0;
+    if ((node = ff_xml_get_child_element_by_name(asset_element, "PackingList"))) {
+        xmlChar *value = xmlNodeGetContent(node);
+        asset->packing_list = value && !xmlStrcmp(value, "true");
+        xmlFree(value);
+    }
+
+    av_log(s, AV_LOG_DEBUG, "Found asset id: " FF_UUID_FORMAT "\n", UID_ARG(asset->uuid));
+
+    if (!(node = ff_xml_get_child_element_by_name(asset_element, "ChunkList"))) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing ChunkList node\n");
         return AVERROR_INVALIDDATA;
     }
 
-    /* parse asset locators */
-    if (!(node = ff_xml_get_child_element_by_name(asset_map_element, "AssetList"))) {
-        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing AssetList node\n");
+    if (!(node = ff_xml_get_child_element_by_name(node, "Chunk"))) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing Chunk node\n");
         return AVERROR_INVALIDDATA;
     }
-    tmp = av_realloc(asset_map->assets,
-        (xmlChildElementCount(node) + asset_map->asset_count)
-            * sizeof(IMFAssetLocator));
-    if (!tmp) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot allocate IMF asset locators\n");
+
+    uri = xmlNodeGetContent(ff_xml_get_child_element_by_name(node, "Path"));
+    if (!imf_uri_is_url(uri) && !imf_uri_is_unix_abs_path(uri) && !imf_uri_is_dos_abs_path(uri))
+        asset->absolute_uri = av_append_path_component(base_url, uri);
+    else
+        asset->absolute_uri = av_strdup(uri);
+    xmlFree(uri);
+    if (!asset->absolute_uri) {
         return AVERROR(ENOMEM);
     }
-    asset_map->assets = tmp;
 
-    asset_element = xmlFirstElementChild(node);
-    while (asset_element) {
-        if (av_strcasecmp(asset_element->name, "Asset") != 0)
-            continue;
+    av_log(s, AV_LOG_DEBUG, "Found asset absolute URI: %s\n", asset->absolute_uri);
 
-        asset = &(asset_map->assets[asset_map->asset_count]);
+    asset_map->asset_count++;
 
-        if (ff_xml_read_uuid(ff_xml_get_child_element_by_name(asset_element, "Id"), asset->uuid)) {
-            av_log(s, AV_LOG_ERROR, "Could not parse UUID from asset in asset map.\n");
-            return AVERROR_INVALIDDATA;
-        }
+    return 0;
+}
 
-        av_log(s, AV_LOG_DEBUG, "Found asset id: " FF_UUID_FORMAT "\n", UID_ARG(asset->uuid));
+/**
+ * Parse a ASSETMAP XML file to extract the UUID-URI mapping of assets.
+ * The document is read incrementally, expanding one Asset element at a
+ * time, so that the whole document is never held in memory.
+ * @param s the current format context, if any (can be NULL).
+ * @param reader the XML reader positioned at the start of the document.
+ * @param asset_map pointer on the IMFAssetLocatorMap to fill.
+ * @param base_url the url of the asset map XML file, if any (can be NULL).
+ * @return a negative value in case of error, 0 otherwise.
+ */
+static int parse_imf_asset_map_from_reader(AVFormatContext *s,
+    xmlTextReaderPtr reader,
+    IMFAssetLocatorMap *asset_map,
+    const char *base_url)
+{
+    xmlNodePtr asset_element;
+    int has_asset_list = 0;
+    int ret;
 
-        if (!(node = ff_xml_get_child_element_by_name(asset_element, "ChunkList"))) {
-            av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing ChunkList node\n");
-            return AVERROR_INVALIDDATA;
-        }
+    if ((ret = ff_xml_reader_next_child_element(reader, -1, 0)) <= 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing root node\n");
+        return AVERROR_INVALIDDATA;
+    }
 
-        if (!(node = ff_xml_get_child_element_by_name(node, "Chunk"))) {
-            av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing Chunk node\n");
-            return AVERROR_INVALIDDATA;
-        }
+    if (av_strcasecmp(xmlTextReaderConstLocalName(reader), "AssetMap")) {
+        av_log(s,
+            AV_LOG_ERROR,
+            "Unable to parse asset map XML - wrong root node name[%s]\n",
+            xmlTextReaderConstLocalName(reader));
+        return AVERROR_INVALIDDATA;
+    }
 
-        uri = xmlNodeGetContent(ff_xml_get_child_element_by_name(node, "Path"));
-        if (!imf_uri_is_url(uri) && !imf_uri_is_unix_abs_path(uri) && !imf_uri_is_dos_abs_path(uri))
-            asset->absolute_uri = av_append_path_component(base_url, uri);
-        else
-            asset->absolute_uri = av_strdup(uri);
-        xmlFree(uri);
-        if (!asset->absolute_uri) {
-            return AVERROR(ENOMEM);
+    ret = ff_xml_reader_next_child_element(reader, 0, 0);
+    while (ret > 0 && !has_asset_list) {
+        if (xmlStrcmp(xmlTextReaderConstLocalName(reader), "AssetList") == 0) {
+            has_asset_list = 1;
+            if (xmlTextReaderIsEmptyElement(reader))
+                break;
+            /* parse asset locators */
+            ret = ff_xml_reader_next_child_element(reader, 1, 0);
+            while (ret > 0) {
+                if (av_strcasecmp(xmlTextReaderConstLocalName(reader), "Asset") == 0) {
+                    if (!(asset_element = xmlTextReaderExpand(reader)))
+                        return AVERROR_INVALIDDATA;
+                    if ((ret = parse_imf_asset_element(s, asset_element, asset_map, base_url)) < 0)
+                        return ret;
+                }
+                ret = ff_xml_reader_next_child_element(reader, 1, 1);
+            }
+        } else {
+            ret = ff_xml_reader_next_child_element(reader, 0, 1);
         }
+    }
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML\n");
+        return ret;
+    }
 
-        av_log(s, AV_LOG_DEBUG, "Found asset absolute URI: %s\n", asset->absolute_uri);
-
-        asset_map->asset_count++;
-        asset_element = xmlNextElementSibling(asset_element);
+    if (!has_asset_list) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse asset map XML - missing AssetList node\n");
+        return AVERROR_INVALIDDATA;
     }
 
-    return ret;
+    return imf_asset_locator_map_build_index(asset_map);
 }
 
 /**
@@ -239,6 +509,9 @@ static void imf_asset_locator_map_init(IMFAssetLocatorMap *asset_map)
 {
     asset_map->assets = NULL;
     asset_map->asset_count = 0;
+    asset_map->assets_alloc_sz = 0;
+    asset_map->index = NULL;
+    asset_map->index_count = 0;
 }
 
 /**
@@ -249,19 +522,228 @@ static void imf_asset_locator_map_deinit(IMFAssetLocatorMap *asset_map)
     for (uint32_t i = 0; i < asset_map->asset_count; ++i)
         av_freep(&asset_map->assets[i].absolute_uri);
     av_freep(&asset_map->assets);
+    av_freep(&asset_map->index);
+}
+
+/**
+ * Gets the size and modification time of a local file.
+ * @return 0 on success, AVERROR(ENOSYS) if the URL is not a local file.
+ */
+static int imf_stat_local_file(const char *url, int64_t *size, int64_t *mtime)
+{
+    const char *path = url;
+    const char *proto = avio_find_protocol_name(url);
+    struct stat st;
+
+    if (!proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    av_strstart(url, "file:", &path);
+    if (stat(path, &st))
+        return AVERROR(ENOSYS);
+
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+
+    return 0;
+}
+
+static int imf_io_is_same_host(AVIOContext *pb, const char *url)
+{
+    char proto1[16], proto2[16], hostname1[1024], hostname2[1024];
+    int port1, port2;
+    uint8_t *location = NULL;
+
+    if (av_opt_get(pb, "location", AV_OPT_SEARCH_CHILDREN, &location) < 0 || !location)
+        return 0;
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, hostname1, sizeof(hostname1), &port1, NULL, 0, location);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, hostname2, sizeof(hostname2), &port2, NULL, 0, url);
+    av_free(location);
+
+    return port1 == port2 && !strcmp(proto1, proto2) && !av_strcasecmp(hostname1, hostname2);
+}
+
+static int imf_io_open_keepalive(AVFormatContext *s, AVFormatContext *io_s, AVIOContext **pb,
+    const char *url, int flags, AVDictionary **options)
+{
+    AVDictionary *tmp = NULL;
+    int ret;
+
+    if (!options)
+        options = &tmp;
+    av_dict_set(options, "multiple_requests", "1", 0);
+    ret = s->io_open(io_s, pb, url, flags, options);
+    av_dict_free(&tmp);
+
+    return ret;
 }
 
-static int parse_assetmap(AVFormatContext *s, const char *url, AVIOContext *in)
+/**
+ * Opens a resource, reusing an idle keep-alive HTTP connection to the same host
+ * if one is available.
+ * @param[in] s The IMF demuxer context, which owns the pool.
+ * @param[in] io_s The context on behalf of which the resource is opened.
+ */
+static int imf_io_open(AVFormatContext *s, AVFormatContext *io_s, AVIOContext **pb,
+    const char *url, int flags, AVDictionary **options)
+{
+    IMFContext *c = s->priv_data;
+    const char *proto = avio_find_protocol_name(url);
+    AVIOContext *pooled = NULL;
+    int ret = AVERROR_PROTOCOL_NOT_FOUND;
+
+    if (!c->http_persistent || flags != AVIO_FLAG_READ || !proto || !av_strstart(proto, "http", NULL))
+        return s->io_open(io_s, pb, url, flags, options);
+
+    ff_mutex_lock(&c->io_pool_lock);
+    for (int i = 0; i < c->io_pool_count; i++)
+        if (imf_io_is_same_host(c->io_pool[i], url)) {
+            pooled = c->io_pool[i];
+            c->io_pool[i] = c->io_pool[--c->io_pool_count];
+            break;
+        }
+    ff_mutex_unlock(&c->io_pool_lock);
+
+    if (!pooled)
+        return imf_io_open_keepalive(s, io_s, pb, url, flags, options);
+
+#if CONFIG_HTTP_PROTOCOL
+    ret = ff_http_do_new_request2(ffio_geturlcontext(pooled), url, options);
+#endif
+    if (ret >= 0) {
+        /* the new response starts at offset 0 */
+        pooled->buf_ptr = pooled->buf_end = pooled->buffer;
+        pooled->pos = 0;
+        pooled->eof_reached = 0;
+        pooled->error = 0;
+        av_log(s, AV_LOG_DEBUG, "Reusing HTTP connection for %s\n", url);
+        *pb = pooled;
+        return ret;
+    }
+    if (ret == AVERROR_EXIT) {
+        ff_format_io_close(s, &pooled);
+        return ret;
+    }
+    if (ret != AVERROR_EOF)
+        av_log(s,
+            AV_LOG_WARNING,
+            "keepalive request failed for '%s' with error: '%s', retrying with new connection\n",
+            url,
+            av_err2str(ret));
+    ff_format_io_close(s, &pooled);
+
+    return imf_io_open_keepalive(s, io_s, pb, url, flags, options);
+}
+
+/**
+ * Closes a resource opened with imf_io_open(). An HTTP connection whose
+ * response has been read entirely is kept in the pool instead, since only such
+ * connections can carry a new request.
+ */
+static void imf_io_close(AVFormatContext *s, AVIOContext *pb)
+{
+    IMFContext *c = s->priv_data;
+    URLContext *uc = ffio_geturlcontext(pb);
+
+    /* hash the data still in the buffer */
+    if (c->verify_hashes)
+        ffio_set_read_hook(pb, NULL, NULL);
+
+    if (c->http_persistent && uc && uc->prot && av_strstart(uc->prot->name, "http", NULL)
+        && avio_feof(pb) && !pb->error) {
+        ff_mutex_lock(&c->io_pool_lock);
+        if (c->io_pool_count < IMF_IO_POOL_SIZE) {
+            c->io_pool[c->io_pool_count++] = pb;
+            pb = NULL;
+        }
+        ff_mutex_unlock(&c->io_pool_lock);
+    }
+
+    if (pb)
+        ff_format_io_close(s, &pb);
+}
+
+/**
+ * Read hook of the track files, hashing the data that continues the hashed
+ * start of the asset. The other data is hashed when the demuxer is closed.
+ */
+static void imf_asset_hash_update(void *opaque, int64_t pos, const uint8_t *buf, int size)
+{
+    IMFAssetHash *asset = opaque;
+
+    ff_mutex_lock(&asset->lock);
+    if (pos <= asset->hashed && pos + size > asset->hashed) {
+        av_hash_update(asset->hash, buf + (asset->hashed - pos), pos + size - asset->hashed);
+        asset->hashed = pos + size;
+    }
+    ff_mutex_unlock(&asset->lock);
+}
+
+static int imf_track_file_io_open(AVFormatContext *ctx, AVIOContext **pb,
+    const char *url, int flags, AVDictionary **options)
+{
+    AVFormatContext *s = ctx->opaque;
+    IMFContext *c = s->priv_data;
+    int ret = imf_io_open(s, ctx, pb, url, flags, options);
+
+    if (ret < 0 || !c->verify_hashes)
+        return ret;
+
+    for (uint32_t i = 0; i < c->packing_list.asset_count; i++) {
+        IMFAssetHash *asset = &c->packing_list.assets[i];
+
+        if (asset->uri && !strcmp(asset->uri, url)) {
+            ffio_set_read_hook(*pb, imf_asset_hash_update, asset);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Closes the demuxer context of a track file, handing its AVIOContext back to
+ * the connection pool.
+ */
+static void imf_track_file_close_input(AVFormatContext **ctx)
+{
+    AVFormatContext *s;
+    AVIOContext *pb;
+
+    if (!*ctx)
+        return;
+
+    s = (*ctx)->opaque;
+    pb = (*ctx)->pb;
+    if (!s || !pb || (*ctx)->flags & AVFMT_FLAG_CUSTOM_IO
+        || !(*ctx)->iformat || (*ctx)->iformat->flags & AVFMT_NOFILE) {
+        avformat_close_input(ctx);
+        return;
+    }
+
+    (*ctx)->flags |= AVFMT_FLAG_CUSTOM_IO;
+    avformat_close_input(ctx);
+    imf_io_close(s, pb);
+}
+
+static void imf_io_pool_free(IMFContext *c)
+{
+    while (c->io_pool_count)
+        avio_closep(&c->io_pool[--c->io_pool_count]);
+}
+
+/**
+ * Parses an asset map document and appends its locators to an asset map.
+ */
+static int parse_assetmap(AVFormatContext *s, const char *url, AVIOContext *in, IMFAssetLocatorMap *asset_map)
 {
     IMFContext *c = s->priv_data;
-    struct AVBPrint buf;
     AVDictionary *opts = NULL;
-    xmlDoc *doc = NULL;
+    xmlTextReaderPtr reader = NULL;
     const char *base_url;
     char *tmp_str = NULL;
     int close_in = 0;
     int ret;
-    int64_t filesize;
 
     av_log(s, AV_LOG_DEBUG, "Asset Map URL: %s\n", url);
 
@@ -269,27 +751,12 @@ static int parse_assetmap(AVFormatContext *s, const char *url, AVIOContext *in)
         close_in = 1;
 
         av_dict_copy(&opts, c->avio_opts, 0);
-        ret = s->io_open(s, &in, url, AVIO_FLAG_READ, &opts);
+        ret = imf_io_open(s, s, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
         if (ret < 0)
             return ret;
     }
 
-    filesize = avio_size(in);
-    filesize = filesize > 0 ? filesize : DEFAULT_ASSETMAP_SIZE;
-
-    av_bprint_init(&buf, filesize + 1, AV_BPRINT_SIZE_UNLIMITED);
-
-    ret = avio_read_to_bprint(in, &buf, MAX_BPRINT_READ_SIZE);
-    if (ret < 0 || !avio_feof(in) || (filesize = buf.len) == 0) {
-        av_log(s, AV_LOG_ERROR, "Unable to read to asset map '%s'\n", url);
-        if (ret == 0)
-            ret = AVERROR_INVALIDDATA;
-        goto clean_up;
-    }
-
-    LIBXML_TEST_VERSION
-
     tmp_str = av_strdup(url);
     if (!tmp_str) {
         ret = AVERROR(ENOMEM);
@@ -297,508 +764,3426 @@ static int parse_assetmap(AVFormatContext *s, const char *url, AVIOContext *in)
     }
     base_url = av_dirname(tmp_str);
 
-    doc = xmlReadMemory(buf.str, filesize, url, NULL, 0);
+    if (!(reader = ff_xml_reader_for_avio(in, url))) {
+        av_log(s, AV_LOG_ERROR, "Unable to read to asset map '%s'\n", url);
+        ret = AVERROR(ENOMEM);
+        goto clean_up;
+    }
 
-    ret = parse_imf_asset_map_from_xml_dom(s, doc, &c->asset_locator_map, base_url);
+    ret = parse_imf_asset_map_from_reader(s, reader, asset_map, base_url);
     if (!ret)
         av_log(s,
             AV_LOG_DEBUG,
             "Found %d assets from %s\n",
-            c->asset_locator_map.asset_count,
+            asset_map->asset_count,
             url);
 
-    xmlFreeDoc(doc);
+    /* The parser stops at the end of the root element: consume the rest of
+     * the response so that the connection can be reused */
+    if (!ret && close_in && c->http_persistent) {
+        uint8_t drain[256];
+
+        while (avio_read(in, drain, sizeof(drain)) > 0)
+            ;
+    }
 
 clean_up:
+    if (reader)
+        xmlFreeTextReader(reader);
     if (tmp_str)
         av_freep(&tmp_str);
     if (close_in)
-        avio_close(in);
-    av_bprint_finalize(&buf, NULL);
+        imf_io_close(s, in);
 
     return ret;
 }
 
-static IMFAssetLocator *find_asset_map_locator(IMFAssetLocatorMap *asset_map, FFUUID uuid)
+/**
+ * Asset map shared by the demuxer instances of the process
+ */
+typedef struct IMFAssetMapCacheEntry {
+    char *url;
+    int64_t size;  /**< Size of the local file, or -1 */
+    int64_t mtime; /**< Modification time of the local file, or -1 */
+    unsigned ref_count;
+    IMFAssetLocatorMap asset_map;
+    struct IMFAssetMapCacheEntry *next;
+} IMFAssetMapCacheEntry;
+
+static AVMutex asset_map_cache_lock = AV_MUTEX_INITIALIZER;
+static IMFAssetMapCacheEntry *asset_map_cache;
+
+static void asset_map_cache_entry_free(IMFAssetMapCacheEntry *entry)
 {
-    for (uint32_t i = 0; i < asset_map->asset_count; ++i)
-        if (memcmp(asset_map->assets[i].uuid, uuid, 16) == 0)
-            return &(asset_map->assets[i]);
+    imf_asset_locator_map_deinit(&entry->asset_map);
+    av_free(entry->url);
+    av_free(entry);
+}
+
+/**
+ * Looks up a cached asset map that is still up to date, and references it.
+ * Must be called with asset_map_cache_lock held.
+ */
+static IMFAssetMapCacheEntry *asset_map_cache_find(const char *url, int64_t size, int64_t mtime)
+{
+    for (IMFAssetMapCacheEntry *entry = asset_map_cache; entry; entry = entry->next)
+        if (!strcmp(entry->url, url) && entry->size == size && entry->mtime == mtime) {
+            entry->ref_count++;
+            return entry;
+        }
+
     return NULL;
 }
 
-static int open_track_resource_context(AVFormatContext *s,
-    IMFVirtualTrackResourcePlaybackCtx *track_resource)
+static void asset_map_cache_release(IMFAssetMapCacheEntry *entry)
 {
-    IMFContext *c = s->priv_data;
-    int ret = 0;
-    int64_t entry_point;
-    AVDictionary *opts = NULL;
+    IMFAssetMapCacheEntry **next;
 
-    if (!track_resource->ctx) {
-        track_resource->ctx = avformat_alloc_context();
-        if (!track_resource->ctx)
-            return AVERROR(ENOMEM);
+    ff_mutex_lock(&asset_map_cache_lock);
+    if (!--entry->ref_count) {
+        for (next = &asset_map_cache; *next != entry; next = &(*next)->next)
+            ;
+        *next = entry->next;
+        asset_map_cache_entry_free(entry);
     }
+    ff_mutex_unlock(&asset_map_cache_lock);
+}
 
-    if (track_resource->ctx->iformat) {
-        av_log(s,
-            AV_LOG_DEBUG,
-            "Input context already opened for %s.\n",
-            track_resource->locator->absolute_uri);
+/**
+ * Gets the parsed asset map of a URL from the process-wide cache, parsing it
+ * if no instance of the demuxer currently references it. Local files are
+ * checked for modifications; other URLs are shared as long as they are
+ * referenced.
+ */
+static int asset_map_cache_acquire(AVFormatContext *s, const char *url, IMFAssetMapCacheEntry **entry)
+{
+    IMFAssetMapCacheEntry *new_entry;
+    int64_t size = -1, mtime = -1;
+    int ret;
+
+    imf_stat_local_file(url, &size, &mtime);
+
+    ff_mutex_lock(&asset_map_cache_lock);
+    *entry = asset_map_cache_find(url, size, mtime);
+    ff_mutex_unlock(&asset_map_cache_lock);
+    if (*entry) {
+        av_log(s, AV_LOG_DEBUG, "Using cached asset map %s\n", url);
         return 0;
     }
 
-    track_resource->ctx->io_open = s->io_open;
-    track_resource->ctx->io_close = s->io_close;
-    track_resource->ctx->flags |= s->flags & ~AVFMT_FLAG_CUSTOM_IO;
-
-    if ((ret = ff_copy_whiteblacklists(track_resource->ctx, s)) < 0)
-        goto cleanup;
+    /* parse without holding the lock, so that other instances are not blocked on I/O */
+    if (!(new_entry = av_mallocz(sizeof(*new_entry))))
+        return AVERROR(ENOMEM);
+    imf_asset_locator_map_init(&new_entry->asset_map);
+    new_entry->size = size;
+    new_entry->mtime = mtime;
+    new_entry->ref_count = 1;
+    if (!(new_entry->url = av_strdup(url))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = parse_assetmap(s, url, NULL, &new_entry->asset_map)) < 0)
+        goto fail;
 
-    av_dict_copy(&opts, c->avio_opts, 0);
-    ret = avformat_open_input(&track_resource->ctx,
-        track_resource->locator->absolute_uri,
-        NULL,
-        &opts);
-    av_dict_free(&opts);
-    if (ret < 0) {
-        av_log(s,
-            AV_LOG_ERROR,
-            "Could not open %s input context: %s\n",
-            track_resource->locator->absolute_uri,
-            av_err2str(ret));
-        return ret;
+    ff_mutex_lock(&asset_map_cache_lock);
+    /* another instance may have parsed the same asset map in the meantime */
+    if ((*entry = asset_map_cache_find(url, size, mtime))) {
+        asset_map_cache_entry_free(new_entry);
+    } else {
+        new_entry->next = asset_map_cache;
+        asset_map_cache = new_entry;
+        *entry = new_entry;
     }
+    ff_mutex_unlock(&asset_map_cache_lock);
 
-    ret = avformat_find_stream_info(track_resource->ctx, NULL);
-    if (ret < 0) {
-        av_log(s,
-            AV_LOG_ERROR,
-            "Could not find %s stream information: %s\n",
-            track_resource->locator->absolute_uri,
-            av_err2str(ret));
+    return 0;
+
+fail:
+    asset_map_cache_entry_free(new_entry);
+    return ret;
+}
+
+/**
+ * Appends copies of the locators of an asset map to another one.
+ */
+static int imf_asset_locator_map_append(IMFAssetLocatorMap *asset_map, const IMFAssetLocatorMap *src)
+{
+    void *tmp;
+
+    if (src->asset_count > UINT32_MAX - asset_map->asset_count)
+        return AVERROR(ENOMEM);
+    tmp = av_fast_realloc(asset_map->assets,
+        &asset_map->assets_alloc_sz,
+        ((size_t)asset_map->asset_count + src->asset_count) * sizeof(IMFAssetLocator));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    asset_map->assets = tmp;
+
+    for (uint32_t i = 0; i < src->asset_count; ++i) {
+        IMFAssetLocator *asset = &asset_map->assets[asset_map->asset_count];
+
+        memcpy(asset->uuid, src->assets[i].uuid, sizeof(asset->uuid));
+        asset->packing_list = src->assets[i].packing_list;
+        if (!(asset->absolute_uri = av_strdup(src->assets[i].absolute_uri)))
+            return AVERROR(ENOMEM);
+        asset_map->asset_count++;
+    }
+
+    return imf_asset_locator_map_build_index(asset_map);
+}
+
+static const struct {
+    const char *uri;
+    const char *name;
+} imf_hash_algorithms[] = {
+    { "http://www.w3.org/2000/09/xmldsig#sha1",  "SHA160" },
+    { "http://www.w3.org/2001/04/xmlenc#sha256", "SHA256" },
+    { "http://www.w3.org/2001/04/xmlenc#sha512", "SHA512" },
+};
+
+/**
+ * Appends the hash described by an Asset element of a packing list.
+ */
+static int parse_imf_packing_list_asset(AVFormatContext *s,
+    xmlNodePtr asset_element,
+    IMFPackingList *pkl)
+{
+    const char *name = "SHA160";
+    IMFAssetHash *asset;
+    xmlNodePtr node;
+    xmlChar *value;
+    void *tmp;
+    int ret = 0;
+
+    if (pkl->asset_count == UINT32_MAX)
+        return AVERROR(ENOMEM);
+    tmp = av_fast_realloc(pkl->assets,
+        &pkl->assets_alloc_sz,
+        (pkl->asset_count + 1) * sizeof(*pkl->assets));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    pkl->assets = tmp;
+    asset = &pkl->assets[pkl->asset_count];
+    memset(asset, 0, sizeof(*asset));
+
+    if (ff_xml_read_uuid(ff_xml_get_child_element_by_name(asset_element, "Id"), asset->uuid)) {
+        av_log(s, AV_LOG_ERROR, "Could not parse UUID from asset in packing list.\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    /* ST 2067-2 packing lists may use other algorithms than SHA-1 */
+    if ((node = ff_xml_get_child_element_by_name(asset_element, "HashAlgorithm"))) {
+        unsigned i;
+
+        value = xmlGetNoNsProp(node, "Algorithm");
+        for (i = 0; value && i < FF_ARRAY_ELEMS(imf_hash_algorithms); i++)
+            if (!xmlStrcmp(value, imf_hash_algorithms[i].uri))
+                break;
+        if (!value || i == FF_ARRAY_ELEMS(imf_hash_algorithms)) {
+            av_log(s, AV_LOG_WARNING, "Unsupported hash algorithm %s of asset " FF_UUID_FORMAT "\n",
+                value, UID_ARG(asset->uuid));
+            xmlFree(value);
+            return 0;
+        }
+        xmlFree(value);
+        name = imf_hash_algorithms[i].name;
+    }
+
+    value = xmlNodeGetContent(ff_xml_get_child_element_by_name(asset_element, "Size"));
+    asset->size = value ? strtoll(value, NULL, 10) : -1;
+    xmlFree(value);
+    if (asset->size < 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid size of asset " FF_UUID_FORMAT " in packing list.\n", UID_ARG(asset->uuid));
+        return AVERROR_INVALIDDATA;
+    }
+
+    if ((ret = av_hash_alloc(&asset->hash, name)) < 0)
+        return ret;
+    value = xmlNodeGetContent(ff_xml_get_child_element_by_name(asset_element, "Hash"));
+    if (!value || av_base64_decode(asset->digest, value, sizeof(asset->digest)) != av_hash_get_size(asset->hash)) {
+        av_log(s, AV_LOG_ERROR, "Invalid hash of asset " FF_UUID_FORMAT " in packing list.\n", UID_ARG(asset->uuid));
+        ret = AVERROR_INVALIDDATA;
+    }
+    xmlFree(value);
+    if (ret < 0) {
+        av_hash_freep(&asset->hash);
+        return ret;
+    }
+    av_hash_init(asset->hash);
+    pkl->asset_count++;
+
+    return 0;
+}
+
+/**
+ * Parses a packing list document incrementally, expanding one Asset element at
+ * a time, and appends the hashes of its assets.
+ */
+static int parse_imf_packing_list_from_reader(AVFormatContext *s,
+    xmlTextReaderPtr reader,
+    IMFPackingList *pkl)
+{
+    xmlNodePtr asset_element;
+    int ret;
+
+    if ((ret = ff_xml_reader_next_child_element(reader, -1, 0)) <= 0
+        || xmlStrcmp(xmlTextReaderConstLocalName(reader), "PackingList")) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse packing list XML - missing PackingList root node\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    ret = ff_xml_reader_next_child_element(reader, 0, 0);
+    while (ret > 0) {
+        if (xmlStrcmp(xmlTextReaderConstLocalName(reader), "AssetList") == 0) {
+            if (xmlTextReaderIsEmptyElement(reader))
+                return 0;
+            ret = ff_xml_reader_next_child_element(reader, 1, 0);
+            while (ret > 0) {
+                if (xmlStrcmp(xmlTextReaderConstLocalName(reader), "Asset") == 0) {
+                    if (!(asset_element = xmlTextReaderExpand(reader)))
+                        return AVERROR_INVALIDDATA;
+                    if ((ret = parse_imf_packing_list_asset(s, asset_element, pkl)) < 0)
+                        return ret;
+                }
+                ret = ff_xml_reader_next_child_element(reader, 1, 1);
+            }
+            break;
+        }
+        ret = ff_xml_reader_next_child_element(reader, 0, 1);
+    }
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to parse packing list XML\n");
+        return ret;
+    }
+
+    return 0;
+}
+
+static void imf_packing_list_deinit(IMFPackingList *pkl)
+{
+    for (uint32_t i = 0; i < pkl->asset_count; i++) {
+        av_hash_freep(&pkl->assets[i].hash);
+        av_freep(&pkl->assets[i].uri);
+        ff_mutex_destroy(&pkl->assets[i].lock);
+    }
+    av_freep(&pkl->assets);
+    pkl->asset_count = 0;
+    pkl->assets_alloc_sz = 0;
+}
+
+static int parse_packing_list(AVFormatContext *s, const char *url, IMFPackingList *pkl)
+{
+    IMFContext *c = s->priv_data;
+    AVDictionary *opts = NULL;
+    xmlTextReaderPtr reader;
+    AVIOContext *in = NULL;
+    int ret;
+
+    av_log(s, AV_LOG_DEBUG, "Packing list URL: %s\n", url);
+
+    av_dict_copy(&opts, c->avio_opts, 0);
+    ret = imf_io_open(s, s, &in, url, AVIO_FLAG_READ, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if (!(reader = ff_xml_reader_for_avio(in, url))) {
+        av_log(s, AV_LOG_ERROR, "Unable to read packing list '%s'\n", url);
+        ret = AVERROR(ENOMEM);
+    } else {
+        ret = parse_imf_packing_list_from_reader(s, reader, pkl);
+        xmlFreeTextReader(reader);
+    }
+    imf_io_close(s, in);
+
+    return ret;
+}
+
+/**
+ * Moves the hashes of a parsed packing list to another one.
+ */
+static int imf_packing_list_append(IMFPackingList *pkl, IMFPackingList *src)
+{
+    void *tmp;
+    int ret;
+
+    if (src->asset_count > UINT32_MAX - pkl->asset_count)
+        return AVERROR(ENOMEM);
+    tmp = av_fast_realloc(pkl->assets,
+        &pkl->assets_alloc_sz,
+        ((size_t)pkl->asset_count + src->asset_count) * sizeof(*pkl->assets));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    pkl->assets = tmp;
+
+    for (uint32_t i = 0; i < src->asset_count; i++) {
+        IMFAssetHash *asset = &pkl->assets[pkl->asset_count];
+
+        *asset = src->assets[i];
+        if ((ret = AVERROR(ff_mutex_init(&asset->lock, NULL))))
+            return ret;
+        src->assets[i].hash = NULL;
+        pkl->asset_count++;
+    }
+
+    return 0;
+}
+
+static void fetch_document(IMFDocumentFetch *fetch)
+{
+    IMFContext *c = fetch->s->priv_data;
+
+    if (fetch->packing_list)
+        fetch->ret = parse_packing_list(fetch->s, fetch->url, &fetch->pkl);
+    else if (c->assetmap_cache)
+        fetch->ret = asset_map_cache_acquire(fetch->s, fetch->url, &fetch->cache_entry);
+    else
+        fetch->ret = parse_assetmap(fetch->s, fetch->url, NULL, &fetch->asset_map);
+    fetch->done = 1;
+}
+
+#if HAVE_THREADS
+static void *fetch_document_thread(void *arg)
+{
+    fetch_document(arg);
+    return NULL;
+}
+#endif
+
+/**
+ * Starts fetching an asset map or a packing list on a worker thread, if the
+ * concurrent_fetch option is set. Otherwise, the document is fetched when it
+ * is waited for.
+ * @return the fetch, or NULL if it could not be allocated.
+ */
+static IMFDocumentFetch *start_fetch(AVFormatContext *s, const char *url, int packing_list)
+{
+    IMFDocumentFetch *fetch = av_mallocz(sizeof(*fetch));
+
+    if (!fetch)
+        return NULL;
+    if (!(fetch->url = av_strdup(url))) {
+        av_free(fetch);
+        return NULL;
+    }
+    fetch->s = s;
+    fetch->packing_list = packing_list;
+    imf_asset_locator_map_init(&fetch->asset_map);
+
+#if HAVE_THREADS
+    if (((IMFContext *)s->priv_data)->concurrent_fetch) {
+        int ret = pthread_create(&fetch->thread, NULL, fetch_document_thread, fetch);
+
+        if (ret)
+            av_log(s, AV_LOG_WARNING, "Could not create fetch thread: %s\n", av_err2str(AVERROR(ret)));
+        else
+            fetch->thread_running = 1;
+    }
+#endif
+
+    return fetch;
+}
+
+/**
+ * Waits for a document to be fetched and parsed.
+ * @return 0 on success, < 0 AVERROR code on error.
+ */
+static int wait_fetch(IMFDocumentFetch *fetch)
+{
+#if HAVE_THREADS
+    if (fetch->thread_running) {
+        pthread_join(fetch->thread, NULL);
+        fetch->thread_running = 0;
+    }
+#endif
+    if (!fetch->done)
+        fetch_document(fetch);
+
+    return fetch->ret;
+}
+
+static void free_fetch(IMFDocumentFetch **fetch)
+{
+    if (!*fetch)
+        return;
+
+#if HAVE_THREADS
+    if ((*fetch)->thread_running)
+        pthread_join((*fetch)->thread, NULL);
+#endif
+    imf_asset_locator_map_deinit(&(*fetch)->asset_map);
+    if ((*fetch)->cache_entry)
+        asset_map_cache_release((*fetch)->cache_entry);
+    for (uint32_t i = 0; i < (*fetch)->pkl.asset_count; i++)
+        av_hash_freep(&(*fetch)->pkl.assets[i].hash);
+    av_freep(&(*fetch)->pkl.assets);
+    av_freep(&(*fetch)->url);
+    av_freep(fetch);
+}
+
+/**
+ * Starts fetching all the asset maps of the assetmaps option, which are
+ * loaded in order as they are needed.
+ */
+static int start_asset_map_fetches(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    char *paths, *path, *saveptr = NULL;
+    int count = 1;
+    int ret = 0;
+
+    /* the parser is initialized before it is used by several threads */
+    LIBXML_TEST_VERSION
+
+    for (const char *p = c->asset_map_paths; *p; p++)
+        count += *p == ',';
+    if (!(c->asset_map_fetches = av_calloc(count, sizeof(*c->asset_map_fetches))))
+        return AVERROR(ENOMEM);
+    if (!(paths = av_strdup(c->asset_map_paths)))
+        return AVERROR(ENOMEM);
+
+    for (path = av_strtok(paths, ",", &saveptr); path; path = av_strtok(NULL, ",", &saveptr)) {
+        if (!(c->asset_map_fetches[c->nb_asset_map_fetches] = start_fetch(s, path, 0))) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        c->nb_asset_map_fetches++;
+    }
+
+    av_free(paths);
+    return ret;
+}
+
+/**
+ * Adds the locators of a fetched asset map to the asset locator map of the
+ * demuxer.
+ */
+static int load_assetmap(AVFormatContext *s, IMFDocumentFetch *fetch)
+{
+    IMFContext *c = s->priv_data;
+    IMFAssetMapCacheEntry *entry;
+    void *tmp;
+    int ret;
+
+    if ((ret = wait_fetch(fetch)) < 0)
+        return ret;
+
+    if (!fetch->cache_entry)
+        return imf_asset_locator_map_append(&c->asset_locator_map, &fetch->asset_map);
+
+    tmp = av_realloc_array(c->asset_map_cache_entries,
+        c->asset_map_cache_entry_count + 1,
+        sizeof(*c->asset_map_cache_entries));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    c->asset_map_cache_entries = tmp;
+
+    entry = fetch->cache_entry;
+    fetch->cache_entry = NULL;
+    c->asset_map_cache_entries[c->asset_map_cache_entry_count++] = entry;
+
+    return imf_asset_locator_map_append(&c->asset_locator_map, &entry->asset_map);
+}
+
+/**
+ * Loads the next asset map of the assetmaps option.
+ * @return 1 if an asset map was loaded, 0 if all of them are loaded, < 0
+ * AVERROR code on error.
+ */
+static int load_next_assetmap(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFDocumentFetch *fetch;
+    int ret;
+
+    if (c->next_asset_map >= c->nb_asset_map_fetches)
+        return 0;
+    fetch = c->asset_map_fetches[c->next_asset_map++];
+
+    av_log(s, AV_LOG_DEBUG, "start parsing IMF Asset Map: %s\n", fetch->url);
+    ret = load_assetmap(s, fetch);
+    free_fetch(&c->asset_map_fetches[c->next_asset_map - 1]);
+    if (ret < 0)
+        return ret;
+
+    return 1;
+}
+
+/**
+ * Looks up an asset by UUID, using a binary search on the index of the map.
+ * If several asset maps list the same UUID, the first parsed asset is returned.
+ */
+static IMFAssetLocator *find_asset_map_locator(IMFAssetLocatorMap *asset_map, FFUUID uuid)
+{
+    uint32_t low = 0;
+    uint32_t high = asset_map->index_count;
+    uint32_t mid;
+
+    /* find the first index entry whose UUID is not lower than the searched one */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (memcmp(asset_map->index[mid].uuid, uuid, 16) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < asset_map->index_count && memcmp(asset_map->index[low].uuid, uuid, 16) == 0)
+        return &(asset_map->assets[asset_map->index[low].asset_index]);
+    return NULL;
+}
+
+/**
+ * Looks up an asset by UUID in the loaded asset maps, then in the following
+ * asset maps of the assetmaps option, which are loaded until the asset is
+ * found.
+ * @param[out] locator The locator of the asset, or NULL if no asset map lists
+ * it.
+ * @return 0 on success, < 0 AVERROR code on error.
+ */
+static int resolve_asset_locator(AVFormatContext *s, FFUUID uuid, IMFAssetLocator **locator)
+{
+    IMFContext *c = s->priv_data;
+    int ret;
+
+    while (!(*locator = find_asset_map_locator(&c->asset_locator_map, uuid)))
+        if ((ret = load_next_assetmap(s)) <= 0)
+            return ret;
+
+    return 0;
+}
+
+/**
+ * Loads all the asset maps, then the hashes of the packing lists they list,
+ * and locates the hashed assets. The packing lists of an asset map are
+ * fetched as soon as it is loaded, while the next asset maps are fetched.
+ */
+static int load_packing_lists(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFAssetLocatorMap *asset_map = &c->asset_locator_map;
+    IMFDocumentFetch **fetches = NULL;
+    int nb_packing_lists = 0;
+    uint32_t start = 0;
+    void *tmp;
+    int ret;
+
+    do {
+        for (uint32_t i = start; i < asset_map->asset_count; i++) {
+            IMFAssetLocator *locator = &asset_map->assets[i];
+
+            /* an asset map may be listed twice, or two asset maps list the same packing list */
+            if (!locator->packing_list || find_asset_map_locator(asset_map, locator->uuid) != locator)
+                continue;
+            if (!(tmp = av_realloc_array(fetches, nb_packing_lists + 1, sizeof(*fetches)))) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            fetches = tmp;
+            if (!(fetches[nb_packing_lists] = start_fetch(s, locator->absolute_uri, 1))) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            nb_packing_lists++;
+        }
+        start = asset_map->asset_count;
+    } while ((ret = load_next_assetmap(s)) > 0);
+    if (ret < 0)
+        goto end;
+
+    for (int i = 0; i < nb_packing_lists; i++) {
+        if ((ret = wait_fetch(fetches[i])) < 0
+            || (ret = imf_packing_list_append(&c->packing_list, &fetches[i]->pkl)) < 0)
+            goto end;
+    }
+    if (!nb_packing_lists) {
+        av_log(s, AV_LOG_WARNING, "No packing list in the asset maps, no asset is verified\n");
+        goto end;
+    }
+
+    for (uint32_t i = 0; i < c->packing_list.asset_count; i++) {
+        IMFAssetHash *asset = &c->packing_list.assets[i];
+        IMFAssetLocator *locator = find_asset_map_locator(asset_map, asset->uuid);
+        int duplicate = 0;
+
+        for (uint32_t j = 0; j < i && !duplicate; j++)
+            duplicate = !memcmp(c->packing_list.assets[j].uuid, asset->uuid, sizeof(asset->uuid));
+        if (duplicate)
+            continue;
+        if (!locator) {
+            av_log(s, AV_LOG_WARNING, "Asset " FF_UUID_FORMAT " of the packing list is not in the asset maps\n",
+                UID_ARG(asset->uuid));
+            continue;
+        }
+        if (!(asset->uri = av_strdup(locator->absolute_uri))) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+    av_log(s, AV_LOG_VERBOSE, "Verifying the hashes of %"PRIu32" assets from %d packing list(s)\n",
+        c->packing_list.asset_count, nb_packing_lists);
+
+end:
+    for (int i = 0; i < nb_packing_lists; i++)
+        free_fetch(&fetches[i]);
+    av_free(fetches);
+    return ret;
+}
+
+/**
+ * Hashes the part of an asset that was not read while demuxing and compares
+ * the hash to the packing list.
+ * @return 1 if the asset matches, 0 if not, < 0 AVERROR code on error.
+ */
+static int verify_asset_hash(AVFormatContext *s, IMFAssetHash *asset)
+{
+    IMFContext *c = s->priv_data;
+    uint8_t digest[AV_HASH_MAX_SIZE];
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    int64_t demuxed = asset->hashed;
+    uint8_t *buf;
+    int ret;
+
+    if (!(buf = av_malloc(1 << 16)))
+        return AVERROR(ENOMEM);
+    av_dict_copy(&opts, c->avio_opts, 0);
+    ret = imf_io_open(s, s, &pb, asset->uri, AVIO_FLAG_READ, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    if (asset->hashed && avio_seek(pb, asset->hashed, SEEK_SET) < 0) {
+        av_hash_init(asset->hash);
+        asset->hashed = demuxed = 0;
+    }
+    while ((ret = avio_read(pb, buf, 1 << 16)) > 0) {
+        av_hash_update(asset->hash, buf, ret);
+        asset->hashed += ret;
+    }
+    imf_io_close(s, pb);
+    if (ret < 0 && ret != AVERROR_EOF)
+        goto end;
+
+    av_hash_final(asset->hash, digest);
+    ret = asset->hashed == asset->size && !memcmp(digest, asset->digest, av_hash_get_size(asset->hash));
+    av_log(s, ret ? AV_LOG_VERBOSE : AV_LOG_ERROR,
+        "%s %s: %"PRId64" of %"PRId64" bytes hashed while demuxing\n",
+        ret ? "Verified" : "Hash mismatch of", asset->uri, demuxed, asset->hashed);
+
+end:
+    av_free(buf);
+    return ret;
+}
+
+static void verify_asset_hashes(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    int mismatches = 0, failures = 0, verified = 0;
+
+    for (uint32_t i = 0; i < c->packing_list.asset_count; i++) {
+        IMFAssetHash *asset = &c->packing_list.assets[i];
+        int ret;
+
+        if (!asset->uri)
+            continue;
+        if ((ret = verify_asset_hash(s, asset)) < 0) {
+            av_log(s, AV_LOG_ERROR, "Could not verify %s: %s\n", asset->uri, av_err2str(ret));
+            failures++;
+        } else if (!ret) {
+            mismatches++;
+        } else {
+            verified++;
+        }
+    }
+
+    if (mismatches || failures)
+        av_log(s, AV_LOG_ERROR, "%d asset(s) do not match the packing list, %d could not be verified\n",
+            mismatches, failures);
+    else if (verified)
+        av_log(s, AV_LOG_INFO, "%d asset(s) match the packing list\n", verified);
+}
+
+/**
+ * Returns the track file context of the virtual track for the specified
+ * track file UUID, creating it if needed, and takes a reference on it.
+ */
+static IMFTrackFileCtx *imf_track_file_ctx_acquire(IMFContext *c, FFUUID uuid, int32_t track_index)
+{
+    IMFTrackFileCtx *track_file;
+    void *tmp;
+
+    for (uint32_t i = 0; i < c->track_file_count; ++i) {
+        track_file = c->track_files[i];
+        if (track_file->track_index == track_index && memcmp(track_file->uuid, uuid, 16) == 0) {
+            track_file->ref_count++;
+            return track_file;
+        }
+    }
+
+    tmp = av_realloc_array(c->track_files, c->track_file_count + 1, sizeof(IMFTrackFileCtx *));
+    if (!tmp)
+        return NULL;
+    c->track_files = tmp;
+
+    track_file = av_mallocz(sizeof(IMFTrackFileCtx));
+    if (!track_file)
+        return NULL;
+    memcpy(track_file->uuid, uuid, sizeof(track_file->uuid));
+    track_file->track_index = track_index;
+    track_file->ref_count = 1;
+    c->track_files[c->track_file_count++] = track_file;
+
+    return track_file;
+}
+
+/**
+ * Releases a reference on a track file context, closing and freeing it when
+ * it is no longer referenced.
+ */
+static void imf_track_file_ctx_release(IMFContext *c, IMFTrackFileCtx *track_file)
+{
+    if (--track_file->ref_count)
+        return;
+
+    for (uint32_t i = 0; i < c->track_file_count; ++i)
+        if (c->track_files[i] == track_file) {
+            c->track_files[i] = c->track_files[--c->track_file_count];
+            break;
+        }
+
+    imf_track_file_close_input(&track_file->ctx);
+    av_free(track_file);
+}
+
+static int is_first_track_resource(IMFContext *c, IMFVirtualTrackResourcePlaybackCtx *track_resource)
+{
+    int32_t track_index = track_resource->track_file->track_index;
+
+    return track_index < c->track_count && track_resource == c->tracks[track_index]->resources;
+}
+
+static int open_track_resource_context_internal(AVFormatContext *s,
+    IMFVirtualTrackResourcePlaybackCtx *track_resource,
+    int64_t offset)
+{
+    IMFContext *c = s->priv_data;
+    IMFTrackFileCtx *track_file = track_resource->track_file;
+    int ret = 0;
+    int reused = 0;
+    int probe;
+    int64_t entry_point;
+    int64_t start_time;
+    AVDictionary *opts = NULL;
+
+    if (track_file->ctx && track_file->ctx->iformat) {
+        if (track_file->parked) {
+            av_dict_copy(&opts, c->avio_opts, 0);
+            start_time = av_gettime_relative();
+            ret = track_file->ctx->io_open(track_file->ctx, &track_file->ctx->pb,
+                track_resource->locator->absolute_uri, AVIO_FLAG_READ, &opts);
+            track_file->open_time += av_gettime_relative() - start_time;
+            av_dict_free(&opts);
+            track_file->parked = 0;
+            if (ret < 0) {
+                av_log(s,
+                    AV_LOG_ERROR,
+                    "Could not reopen %s: %s\n",
+                    track_resource->locator->absolute_uri,
+                    av_err2str(ret));
+                goto cleanup;
+            }
+            track_file->reattaches++;
+            av_log(s,
+                AV_LOG_DEBUG,
+                "Reattached parked input context of %s.\n",
+                track_resource->locator->absolute_uri);
+        } else
+            av_log(s,
+                AV_LOG_DEBUG,
+                "Input context already opened for %s.\n",
+                track_resource->locator->absolute_uri);
+        reused = 1;
+        goto seek;
+    }
+
+    if (!track_file->ctx) {
+        track_file->ctx = avformat_alloc_context();
+        if (!track_file->ctx)
+            return AVERROR(ENOMEM);
+    }
+
+    track_file->ctx->opaque = s;
+    track_file->ctx->io_open = imf_track_file_io_open;
+    track_file->ctx->io_close = s->io_close;
+    track_file->ctx->flags |= s->flags & ~AVFMT_FLAG_CUSTOM_IO;
+    /* the packets are stream copied: skip the parsers of the MXF demuxer */
+    if (c->flatten)
+        track_file->ctx->flags |= AVFMT_FLAG_NOPARSE;
+
+    if ((ret = ff_copy_whiteblacklists(track_file->ctx, s)) < 0)
         goto cleanup;
+
+    /* In fast open mode, only the first resource of a virtual track is
+     * probed: the other ones are MXF track files whose codec parameters are
+     * read from the header metadata by the MXF demuxer. In flatten, check and
+     * header-only modes, no resource is probed. */
+    probe = !c->flatten && !c->check && !c->header_only
+        && (!c->fast_open || is_first_track_resource(c, track_resource));
+
+    av_dict_copy(&opts, c->avio_opts, 0);
+    if (c->lazy_index)
+        av_dict_set(&opts, "lazy_index", "1", 0);
+    if (c->follow) {
+        /* the track files of a live capture are still being written */
+        av_dict_set(&opts, "follow", "1", 0);
+        av_dict_set_int(&opts, "follow_timeout", c->follow_timeout, 0);
+    }
+    start_time = av_gettime_relative();
+    ret = avformat_open_input(&track_file->ctx,
+        track_resource->locator->absolute_uri,
+        probe ? NULL : av_find_input_format("mxf"),
+        &opts);
+    track_file->open_time += av_gettime_relative() - start_time;
+    track_file->opens++;
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(s,
+            AV_LOG_ERROR,
+            "Could not open %s input context: %s\n",
+            track_resource->locator->absolute_uri,
+            av_err2str(ret));
+        return ret;
+    }
+
+    /* only the first stream of a track file belongs to the virtual track: the
+     * demuxer skips the data of the other ones, e.g. timecode or ancillary data */
+    for (unsigned i = 1; i < track_file->ctx->nb_streams; i++)
+        track_file->ctx->streams[i]->discard = AVDISCARD_ALL;
+
+    if (probe) {
+        start_time = av_gettime_relative();
+        ret = avformat_find_stream_info(track_file->ctx, NULL);
+        track_file->probe_time += av_gettime_relative() - start_time;
+        if (ret < 0) {
+            av_log(s,
+                AV_LOG_ERROR,
+                "Could not find %s stream information: %s\n",
+                track_resource->locator->absolute_uri,
+                av_err2str(ret));
+            goto cleanup;
+        }
+    }
+
+    if (!track_file->ctx->nb_streams) {
+        av_log(s, AV_LOG_ERROR, "No stream found in %s\n", track_resource->locator->absolute_uri);
+        ret = AVERROR_INVALIDDATA;
+        goto cleanup;
+    }
+
+    /* Compare the source timebase to the resource edit rate, considering the first stream of the source file */
+    if (av_cmp_q(track_file->ctx->streams[0]->time_base, av_inv_q(track_resource->resource->base.edit_rate)))
+        av_log(s,
+            AV_LOG_WARNING,
+            "Incoherent source stream timebase %d/%d regarding resource edit rate: %d/%d",
+            track_file->ctx->streams[0]->time_base.num,
+            track_file->ctx->streams[0]->time_base.den,
+            track_resource->resource->base.edit_rate.den,
+            track_resource->resource->base.edit_rate.num);
+
+seek:
+    /* seek in the time base of the source stream to stay on edit unit boundaries */
+    entry_point = av_rescale_q(track_resource->entry_point + offset,
+        av_inv_q(track_resource->resource->base.edit_rate),
+        track_file->ctx->streams[0]->time_base);
+
+    /* A reused context must be rewound even when the entry point is zero */
+    if (entry_point || reused) {
+        av_log(s,
+            AV_LOG_DEBUG,
+            "Seek at resource %s entry point: %" PRIu32 " (offset: %" PRId64 ")\n",
+            track_resource->locator->absolute_uri,
+            track_resource->entry_point,
+            offset);
+        start_time = av_gettime_relative();
+        /* every edit unit of IMF essence is a random access point: seeking
+         * to any frame lets the MXF demuxer look up the edit unit in its index
+         * table and jump to its byte offset, without searching for a key frame */
+        ret = avformat_seek_file(track_file->ctx, 0, entry_point, entry_point, entry_point, AVSEEK_FLAG_ANY);
+        track_file->seek_time += av_gettime_relative() - start_time;
+        track_file->seeks++;
+        if (ret < 0) {
+            av_log(s,
+                AV_LOG_ERROR,
+                "Could not seek at %" PRId64 "on %s: %s\n",
+                entry_point,
+                track_resource->locator->absolute_uri,
+                av_err2str(ret));
+            goto cleanup;
+        }
+    }
+
+    return ret;
+cleanup:
+    imf_track_file_close_input(&track_file->ctx);
+    return ret;
+}
+
+/**
+ * Opens the demuxer context of a resource, if needed, and seeks it to the
+ * specified offset, in edit units, from the entry point of the resource.
+ */
+static int open_track_resource_context(AVFormatContext *s,
+    IMFVirtualTrackResourcePlaybackCtx *track_resource,
+    int64_t offset)
+{
+    int ret;
+
+    FF_TRACE_BEGIN("imf", "open_resource");
+    ret = open_track_resource_context_internal(s, track_resource, offset);
+    FF_TRACE_END("imf", "open_resource");
+    return ret;
+}
+
+/**
+ * Appends an occurrence of a track file resource to a virtual track.
+ * @param[in] trim_in Number of edit units skipped at the start of the resource.
+ * @param[in] duration Number of edit units played from the resource.
+ */
+static int open_track_file_resource(AVFormatContext *s,
+    FFIMFTrackFileResource *track_file_resource,
+    IMFVirtualTrackPlaybackCtx *track,
+    uint32_t trim_in,
+    uint32_t duration)
+{
+    IMFContext *c = s->priv_data;
+    IMFAssetLocator *asset_locator;
+    IMFVirtualTrackResourcePlaybackCtx vt_ctx;
+    void *tmp;
+    int ret = 0;
+
+    if ((ret = resolve_asset_locator(s, track_file_resource->track_file_uuid, &asset_locator)) < 0)
+        return ret;
+    if (!asset_locator) {
+        av_log(s,
+            AV_LOG_ERROR,
+            "Could not find asset locator for UUID: " FF_UUID_FORMAT "\n",
+            UID_ARG(track_file_resource->track_file_uuid));
+        /* report all the unresolved resources in check mode */
+        if (c->check) {
+            c->check_errors++;
+            return 0;
+        }
+        return AVERROR_INVALIDDATA;
+    }
+
+    av_log(s,
+        AV_LOG_DEBUG,
+        "Found locator for " FF_UUID_FORMAT ": %s\n",
+        UID_ARG(asset_locator->uuid),
+        asset_locator->absolute_uri);
+    if (track->resource_count == UINT32_MAX)
+        return AVERROR(ENOMEM);
+    tmp = av_fast_realloc(track->resources,
+        &track->resources_alloc_sz,
+        (track->resource_count + 1) * sizeof(IMFVirtualTrackResourcePlaybackCtx));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    track->resources = tmp;
+
+    /* The resource context is opened on demand, when playback reaches it */
+    vt_ctx.locator = asset_locator;
+    vt_ctx.resource = track_file_resource;
+    vt_ctx.track_file = imf_track_file_ctx_acquire(c, asset_locator->uuid, track->index);
+    if (!vt_ctx.track_file)
+        return AVERROR(ENOMEM);
+    vt_ctx.entry_point = track_file_resource->base.entry_point + trim_in;
+    vt_ctx.duration = duration;
+    vt_ctx.start_edit_unit = 0;
+    if (track->resource_count)
+        vt_ctx.start_edit_unit = track->resources[track->resource_count - 1].start_edit_unit
+            + track->resources[track->resource_count - 1].duration;
+    track->resources[track->resource_count++] = vt_ctx;
+
+    return ret;
+}
+
+static void imf_virtual_track_playback_context_deinit(IMFContext *c, IMFVirtualTrackPlaybackCtx *track)
+{
+    for (uint32_t i = 0; i < track->resource_count; ++i)
+        imf_track_file_ctx_release(c, track->resources[i].track_file);
+
+    av_freep(&track->resources);
+    av_packet_free(&track->coalesce_pkt);
+    for (int i = 0; i < IMF_READ_BATCH; i++)
+        av_packet_free(&track->batch_pkts[i]);
+    av_dict_free(&track->map);
+}
+
+static int track_file_is_used_from(IMFVirtualTrackPlaybackCtx *track,
+    uint32_t resource_index,
+    IMFTrackFileCtx *track_file)
+{
+    for (uint32_t i = resource_index; i < track->resource_count; ++i)
+        if (track->resources[i].track_file == track_file)
+            return 1;
+    return 0;
+}
+
+/**
+ * Counts the track file contexts that are open or being opened, not including
+ * the parked ones.
+ */
+static int count_open_track_files(IMFContext *c)
+{
+    int count = 0;
+
+    for (uint32_t i = 0; i < c->track_file_count; ++i)
+        if (c->track_files[i]->preopening || (c->track_files[i]->ctx && !c->track_files[i]->parked))
+            count++;
+    return count;
+}
+
+/**
+ * Releases the AVIOContext of a track file context that is no longer read, but
+ * keeps its demuxer, with the parsed header metadata and index tables, so that
+ * reading the track file again does not parse it again. When
+ * max_parked_resources contexts are parked, the least recently parked one is
+ * closed.
+ */
+static void imf_track_file_park(AVFormatContext *s, IMFTrackFileCtx *track_file)
+{
+    IMFContext *c = s->priv_data;
+    AVFormatContext *ctx = track_file->ctx;
+    IMFTrackFileCtx *oldest = NULL;
+    int parked = 0;
+
+    if (!ctx || track_file->parked)
+        return;
+    if (!c->max_parked_resources || !ctx->pb || !ctx->iformat
+        || ctx->flags & AVFMT_FLAG_CUSTOM_IO || ctx->iformat->flags & AVFMT_NOFILE) {
+        imf_track_file_close_input(&track_file->ctx);
+        return;
+    }
+
+    for (uint32_t i = 0; i < c->track_file_count; ++i)
+        if (c->track_files[i]->parked && !c->track_files[i]->in_use) {
+            parked++;
+            if (!oldest || c->track_files[i]->park_seq < oldest->park_seq)
+                oldest = c->track_files[i];
+        }
+    if (oldest && parked >= c->max_parked_resources) {
+        imf_track_file_close_input(&oldest->ctx);
+        oldest->parked = 0;
+    }
+
+    imf_io_close(s, ctx->pb);
+    ctx->pb = NULL;
+    track_file->parked = 1;
+    track_file->park_seq = c->park_seq++;
+}
+
+/**
+ * Parks the least recently used track file contexts that are open but not
+ * read by their track, until opening reserve more contexts keeps at most
+ * max_open_resources contexts open. Must be called with track_files_lock held.
+ */
+static void evict_track_files(AVFormatContext *s, int reserve)
+{
+    IMFContext *c = s->priv_data;
+    IMFTrackFileCtx *track_file;
+    IMFTrackFileCtx *lru;
+
+    if (!c->max_open_resources)
+        return;
+
+    while (count_open_track_files(c) + reserve > c->max_open_resources) {
+        lru = NULL;
+        for (uint32_t i = 0; i < c->track_file_count; ++i) {
+            track_file = c->track_files[i];
+            if (!track_file->ctx || track_file->parked || track_file->preopening || track_file->in_use)
+                continue;
+            if (!lru || track_file->use_seq < lru->use_seq)
+                lru = track_file;
+        }
+        /* the contexts left open are all read by a track */
+        if (!lru)
+            return;
+
+        av_log(s,
+            AV_LOG_DEBUG,
+            "Close least recently used track file " FF_UUID_FORMAT " of track %d\n",
+            UID_ARG(lru->uuid),
+            lru->track_index);
+        imf_track_file_park(s, lru);
+    }
+}
+
+#if HAVE_THREADS
+static void *preopen_resource_thread(void *arg)
+{
+    IMFVirtualTrackPlaybackCtx *track = arg;
+
+    track->preopen_ret = open_track_resource_context(track->preopen_avf, track->preopen_resource, 0);
+    return NULL;
+}
+#endif
+
+/**
+ * Starts opening, on a worker thread, the next resource of the track that
+ * uses a track file other than the one of the current resource.
+ */
+static void start_preopen(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+#if HAVE_THREADS
+    IMFContext *c = s->priv_data;
+    IMFTrackFileCtx *current_track_file = track->resources[track->current_resource_index].track_file;
+    IMFVirtualTrackResourcePlaybackCtx *next_resource = NULL;
+    int ret;
+
+    if (!track->preopen || track->preopen_thread_running)
+        return;
+
+    for (uint32_t i = track->current_resource_index + 1; i < track->resource_count; ++i)
+        if (track->resources[i].track_file != current_track_file) {
+            next_resource = &track->resources[i];
+            break;
+        }
+    if (!next_resource || next_resource->track_file->ctx)
+        return;
+
+    evict_track_files(s, 1);
+    if (c->max_open_resources && count_open_track_files(c) >= c->max_open_resources) {
+        av_log(s,
+            AV_LOG_DEBUG,
+            "Not pre-opening %s: %d resources are already open\n",
+            next_resource->locator->absolute_uri,
+            c->max_open_resources);
+        return;
+    }
+
+    av_log(s, AV_LOG_DEBUG, "Pre-open %s on track %d\n", next_resource->locator->absolute_uri, track->index);
+    track->preopen_avf = s;
+    track->preopen_resource = next_resource;
+    next_resource->track_file->preopening = 1;
+    next_resource->track_file->use_seq = c->use_seq++;
+    ret = pthread_create(&track->preopen_thread, NULL, preopen_resource_thread, track);
+    if (ret) {
+        av_log(s, AV_LOG_WARNING, "Could not create pre-open thread: %s\n", av_err2str(AVERROR(ret)));
+        next_resource->track_file->preopening = 0;
+        return;
+    }
+    track->preopen_thread_running = 1;
+#endif
+}
+
+/**
+ * Waits for the background opening of a resource of the track, if any.
+ * @return the track file context that was being opened, or NULL.
+ */
+static IMFTrackFileCtx *wait_preopen(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+#if HAVE_THREADS
+    IMFTrackFileCtx *track_file;
+
+    if (!track->preopen_thread_running)
+        return NULL;
+
+    pthread_join(track->preopen_thread, NULL);
+    track->preopen_thread_running = 0;
+    track_file = track->preopen_resource->track_file;
+    track_file->preopening = 0;
+
+    /* the resource is opened again synchronously when playback reaches it */
+    if (track->preopen_ret < 0)
+        av_log(s,
+            AV_LOG_WARNING,
+            "Could not pre-open %s: %s\n",
+            track->preopen_resource->locator->absolute_uri,
+            av_err2str(track->preopen_ret));
+
+    return track_file;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Parses the preopen_tracks option into the preopen flag of the tracks.
+ */
+static int parse_preopen_tracks(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    char *tracks_str;
+    char *track_str;
+    char *saveptr = NULL;
+    char *end;
+    long track_index;
+    int ret = 0;
+
+    if (!c->preopen_tracks)
+        return 0;
+
+    if (!HAVE_THREADS) {
+        av_log(s, AV_LOG_WARNING, "Resource pre-opening requires threading support, ignoring preopen_tracks\n");
+        return 0;
+    }
+
+    if (!strcmp(c->preopen_tracks, "all")) {
+        for (uint32_t i = 0; i < c->track_count; ++i)
+            c->tracks[i]->preopen = 1;
+        return 0;
+    }
+
+    if (!(tracks_str = av_strdup(c->preopen_tracks)))
+        return AVERROR(ENOMEM);
+
+    track_str = av_strtok(tracks_str, ",", &saveptr);
+    while (track_str) {
+        track_index = strtol(track_str, &end, 10);
+        if (end == track_str || *end || track_index < 0) {
+            av_log(s, AV_LOG_ERROR, "Invalid track index in preopen_tracks: %s\n", track_str);
+            ret = AVERROR(EINVAL);
+            break;
+        }
+        if (track_index < c->track_count)
+            c->tracks[track_index]->preopen = 1;
+        else
+            av_log(s, AV_LOG_WARNING, "No track %ld to pre-open resources for\n", track_index);
+        track_str = av_strtok(NULL, ",", &saveptr);
+    }
+
+    av_free(tracks_str);
+    return ret;
+}
+
+/**
+ * Returns the duration of a virtual track, in edit units.
+ */
+static int64_t get_track_edit_unit_count(IMFVirtualTrackPlaybackCtx *track)
+{
+    IMFVirtualTrackResourcePlaybackCtx *last_resource;
+
+    if (!track->resource_count)
+        return 0;
+    last_resource = &track->resources[track->resource_count - 1];
+    return last_resource->start_edit_unit + last_resource->duration;
+}
+
+static int open_virtual_track(AVFormatContext *s,
+    FFIMFTrackFileVirtualTrack *virtual_track,
+    int32_t track_index)
+{
+    IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track = NULL;
+    AVRational edit_rate;
+    int64_t window_start = 0;
+    int64_t window_end = INT64_MAX;
+    int64_t position = 0;
+    int64_t trim_in, trim_out;
+    uint32_t duration;
+    void *tmp;
+    int ret = 0;
+
+    if (!(track = av_mallocz(sizeof(IMFVirtualTrackPlaybackCtx))))
+        return AVERROR(ENOMEM);
+    track->index = track_index;
+
+    /* convert the timeline window to edit units of the track */
+    if (virtual_track->resource_count) {
+        edit_rate = virtual_track->resources[0].base.edit_rate;
+        window_start = av_rescale_rnd(c->window_start,
+            (int64_t)edit_rate.num * c->cpl->edit_rate.den,
+            (int64_t)edit_rate.den * c->cpl->edit_rate.num,
+            AV_ROUND_DOWN);
+        if (c->window_end != INT64_MAX)
+            window_end = av_rescale_rnd(c->window_end,
+                (int64_t)edit_rate.num * c->cpl->edit_rate.den,
+                (int64_t)edit_rate.den * c->cpl->edit_rate.num,
+                AV_ROUND_UP);
+    }
+
+    for (uint32_t i = 0; i < virtual_track->resource_count; i++) {
+        duration = virtual_track->resources[i].base.duration;
+        for (uint32_t j = 0; j < virtual_track->resources[i].base.repeat_count; ++j, position += duration) {
+            /* resources outside of the window are neither resolved nor opened */
+            if (position + duration <= window_start || position >= window_end)
+                continue;
+            trim_in = FFMAX(window_start - position, 0);
+            trim_out = FFMAX(position + duration - window_end, 0);
+
+            av_log(s,
+                AV_LOG_DEBUG,
+                "Open stream from file " FF_UUID_FORMAT ", stream %d\n",
+                UID_ARG(virtual_track->resources[i].track_file_uuid),
+                i);
+            if ((ret = open_track_file_resource(s,
+                     &virtual_track->resources[i],
+                     track,
+                     trim_in,
+                     duration - trim_in - trim_out))
+                != 0) {
+                av_log(s,
+                    AV_LOG_ERROR,
+                    "Could not open image track resource " FF_UUID_FORMAT "\n",
+                    UID_ARG(virtual_track->resources[i].track_file_uuid));
+                goto clean_up;
+            }
+        }
+    }
+
+    tmp = av_realloc(c->tracks, (c->track_count + 1) * sizeof(IMFVirtualTrackPlaybackCtx *));
+    if (!tmp) {
+        ret = AVERROR(ENOMEM);
+        goto clean_up;
+    }
+    c->tracks = tmp;
+    c->tracks[c->track_count++] = track;
+
+    return 0;
+
+clean_up:
+    imf_virtual_track_playback_context_deinit(c, track);
+    av_free(track);
+    return ret;
+}
+
+static int set_context_streams_from_tracks(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+
+    AVStream *asset_stream;
+    AVStream *first_resource_stream;
+
+    int ret = 0;
+
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        /* Open the first resource of the track to get stream information */
+        av_log(s, AV_LOG_DEBUG, "Open the first resource of track %d\n", c->tracks[i]->index);
+        if (!c->tracks[i]->resource_count) {
+            av_log(s, AV_LOG_ERROR, "Track %d has no resource\n", c->tracks[i]->index);
+            return AVERROR_INVALIDDATA;
+        }
+        c->tracks[i]->resources[0].track_file->in_use = 1;
+        c->tracks[i]->resources[0].track_file->use_seq = c->use_seq++;
+        if (!c->tracks[i]->resources[0].track_file->ctx || c->tracks[i]->resources[0].track_file->parked)
+            evict_track_files(s, 1);
+        if ((ret = open_track_resource_context(s, &c->tracks[i]->resources[0], 0)) != 0)
+            return ret;
+        first_resource_stream = c->tracks[i]->resources[0].track_file->ctx->streams[0];
+        start_preopen(s, c->tracks[i]);
+
+        /* Copy stream information */
+        asset_stream = avformat_new_stream(s, NULL);
+        if (!asset_stream) {
+            av_log(s, AV_LOG_ERROR, "Could not create stream\n");
+            break;
+        }
+        asset_stream->id = i;
+        ret = avcodec_parameters_copy(asset_stream->codecpar, first_resource_stream->codecpar);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Could not copy stream parameters\n");
+            break;
+        }
+        avpriv_set_pts_info(asset_stream,
+            first_resource_stream->pts_wrap_bits,
+            first_resource_stream->time_base.num,
+            first_resource_stream->time_base.den);
+        c->tracks[i]->duration = av_rescale_q(get_track_edit_unit_count(c->tracks[i]),
+            av_inv_q(c->tracks[i]->resources[0].resource->base.edit_rate),
+            asset_stream->time_base);
+        asset_stream->duration = c->tracks[i]->duration;
+        /* a video track is read as one packet per edit unit */
+        if (asset_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            asset_stream->nb_frames = get_track_edit_unit_count(c->tracks[i]);
+    }
+
+    return ret;
+}
+
+/**
+ * Gets the byte size of each edit unit of a resource, read from the MXF index
+ * tables of its track file, which must be open or parked.
+ */
+static int get_resource_edit_unit_sizes(AVFormatContext *s,
+    IMFVirtualTrackResourcePlaybackCtx *resource,
+    int *sizes)
+{
+#if CONFIG_MXF_DEMUXER
+    AVFormatContext *ctx = resource->track_file->ctx;
+    AVRational edit_unit_tb = av_inv_q(resource->resource->base.edit_rate);
+    AVRational time_base;
+    int64_t pos, size;
+    int ret;
+
+    if (!ctx || !ctx->iformat || strcmp(ctx->iformat->name, "mxf") || !ctx->nb_streams)
+        return AVERROR(ENOSYS);
+    time_base = ctx->streams[0]->time_base;
+
+    for (uint32_t i = 0; i < resource->duration; i++) {
+        int64_t start = (int64_t)resource->entry_point + i;
+
+        if ((ret = ff_mxf_get_byte_range(ctx, 0,
+                 av_rescale_q(start, edit_unit_tb, time_base),
+                 av_rescale_q(start + 1, edit_unit_tb, time_base),
+                 &pos,
+                 &size)) < 0)
+            return ret;
+        if (size <= 0 || size > INT_MAX)
+            return AVERROR_INVALIDDATA;
+        sizes[i] = size;
+    }
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Adds an index entry per edit unit of the composition to the stream of a
+ * track: IMF essence is intra-coded, so that every edit unit is a random
+ * access point. The entries are spaced further apart if they would exceed
+ * max_index_size. Since a track spans several files, the entries carry no
+ * byte position. When there is an entry per edit unit of a video track, and
+ * the track files are open, the entries carry the size of the edit units.
+ */
+static int add_track_index_entries(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+    IMFContext *c = s->priv_data;
+    AVStream *st = s->streams[track->index];
+    AVRational edit_unit_tb = av_inv_q(c->cpl->edit_rate);
+    int64_t edit_unit_count;
+    int64_t max_entries;
+    int64_t step;
+    int *sizes = NULL;
+    int ret = 0;
+
+    edit_unit_count = av_rescale_q_rnd(track->duration, st->time_base, edit_unit_tb, AV_ROUND_UP);
+    max_entries = FFMAX(1, s->max_index_size / sizeof(AVIndexEntry));
+    step = (edit_unit_count + max_entries - 1) / max_entries;
+    step = FFMAX(step, 1);
+
+    if (step == 1 && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+        edit_unit_count == get_track_edit_unit_count(track)) {
+        if (!(sizes = av_calloc(edit_unit_count, sizeof(*sizes))))
+            return AVERROR(ENOMEM);
+        for (uint32_t i = 0; i < track->resource_count; i++) {
+            IMFVirtualTrackResourcePlaybackCtx *resource = &track->resources[i];
+
+            if (resource->track_file->preopening ||
+                get_resource_edit_unit_sizes(s, resource, sizes + resource->start_edit_unit) < 0) {
+                av_freep(&sizes);
+                break;
+            }
+        }
+    }
+
+    for (int64_t i = 0; i < edit_unit_count; i += step)
+        if ((ret = av_add_index_entry(st,
+                 -1,
+                 av_rescale_q(i, edit_unit_tb, st->time_base),
+                 sizes ? sizes[i] : 0,
+                 0,
+                 AVINDEX_KEYFRAME)) < 0)
+            break;
+
+    av_free(sizes);
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * Prints the comma-separated byte ranges, as position+size, of the spans of
+ * map_span edit units of a resource, read from the MXF index tables of its
+ * track file, which must be open or parked.
+ */
+static int print_resource_byte_ranges(AVFormatContext *s,
+    IMFVirtualTrackResourcePlaybackCtx *resource,
+    AVBPrint *bp)
+{
+#if CONFIG_MXF_DEMUXER
+    IMFContext *c = s->priv_data;
+    AVFormatContext *ctx = resource->track_file->ctx;
+    AVRational edit_unit_tb = av_inv_q(resource->resource->base.edit_rate);
+    AVRational time_base;
+    uint32_t span = c->map_span > 0 ? c->map_span : resource->duration;
+    int64_t pos, size;
+    int ret;
+
+    if (!ctx || !ctx->iformat || strcmp(ctx->iformat->name, "mxf") || !ctx->nb_streams)
+        return AVERROR(ENOSYS);
+    time_base = ctx->streams[0]->time_base;
+
+    for (uint32_t i = 0; i < resource->duration; i += span) {
+        int64_t start = (int64_t)resource->entry_point + i;
+        int64_t end = start + FFMIN(span, resource->duration - i);
+
+        if ((ret = ff_mxf_get_byte_range(ctx, 0,
+                 av_rescale_q(start, edit_unit_tb, time_base),
+                 av_rescale_q(end, edit_unit_tb, time_base),
+                 &pos, &size)) < 0)
+            return ret;
+        av_bprintf(bp, "%s%"PRId64"+%"PRId64, i ? "," : "", pos, size);
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Sets the byte-range map of the resources of a track, one set of imf_map.N.*
+ * entries per resource. The track files are opened before the preopen threads
+ * start, which may open them concurrently.
+ */
+static int build_track_map(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+    IMFContext *c = s->priv_data;
+    AVBPrint bp;
+    char key[64];
+    int ret = 0;
+
+    for (uint32_t i = 0; i < track->resource_count; i++) {
+        IMFVirtualTrackResourcePlaybackCtx *resource = &track->resources[i];
+        IMFTrackFileCtx *track_file = resource->track_file;
+
+        snprintf(key, sizeof(key), "imf_map.%"PRIu32".uri", i);
+        if ((ret = av_dict_set(&track->map, key, resource->locator->absolute_uri, 0)) < 0)
+            return ret;
+        snprintf(key, sizeof(key), "imf_map.%"PRIu32".start", i);
+        if ((ret = av_dict_set_int(&track->map, key, resource->start_edit_unit, 0)) < 0)
+            return ret;
+        snprintf(key, sizeof(key), "imf_map.%"PRIu32".entry_point", i);
+        if ((ret = av_dict_set_int(&track->map, key, resource->entry_point, 0)) < 0)
+            return ret;
+        snprintf(key, sizeof(key), "imf_map.%"PRIu32".duration", i);
+        if ((ret = av_dict_set_int(&track->map, key, resource->duration, 0)) < 0)
+            return ret;
+
+        /* Parked contexts keep their index tables. In check mode, the track
+         * files that could not be opened are already reported as errors. */
+        if ((!track_file->ctx || !track_file->ctx->iformat) && !c->check) {
+            track_file->use_seq = c->use_seq++;
+            evict_track_files(s, 1);
+            if ((ret = open_track_resource_context(s, resource, 0)) < 0)
+                return ret;
+        }
+
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        if ((ret = print_resource_byte_ranges(s, resource, &bp)) < 0) {
+            av_log(s,
+                AV_LOG_VERBOSE,
+                "No byte ranges for resource %"PRIu32" of track %d in %s: %s\n",
+                i,
+                track->index,
+                resource->locator->absolute_uri,
+                av_err2str(ret));
+            av_bprint_finalize(&bp, NULL);
+            continue;
+        }
+        if (!av_bprint_is_complete(&bp)) {
+            av_bprint_finalize(&bp, NULL);
+            return AVERROR(ENOMEM);
+        }
+        snprintf(key, sizeof(key), "imf_map.%"PRIu32".ranges", i);
+        ret = av_dict_set(&track->map, key, bp.str, 0);
+        av_bprint_finalize(&bp, NULL);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int track_heap_less(IMFVirtualTrackPlaybackCtx *a, IMFVirtualTrackPlaybackCtx *b)
+{
+    /* on equal timestamps, the track that comes first in the playlist is read first */
+    if (a->heap_timestamp != b->heap_timestamp)
+        return a->heap_timestamp < b->heap_timestamp;
+    return a->index < b->index;
+}
+
+static void track_heap_sift_down(IMFContext *c, uint32_t i)
+{
+    IMFVirtualTrackPlaybackCtx *track = c->track_heap[i];
+    uint32_t child;
+
+    while ((child = 2 * i + 1) < c->track_count) {
+        if (child + 1 < c->track_count && track_heap_less(c->track_heap[child + 1], c->track_heap[child]))
+            child++;
+        if (!track_heap_less(c->track_heap[child], track))
+            break;
+        c->track_heap[i] = c->track_heap[child];
+        i = child;
+    }
+    c->track_heap[i] = track;
+}
+
+static void update_track_heap_timestamp(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+    IMFContext *c = s->priv_data;
+    int64_t timestamp = track->current_timestamp;
+
+#if HAVE_THREADS
+    /* the worker thread is ahead of the demuxer: use the timestamp of the next packet */
+    if (track->read_ahead_thread_running)
+        timestamp = track->read_ahead_head.timestamp;
+#endif
+
+    /* discarded tracks sink to the bottom of the heap, below the tracks at their end */
+    if (track->discard)
+        track->heap_timestamp = INT64_MAX;
+    else
+        track->heap_timestamp = av_rescale_q(timestamp, s->streams[track->index]->time_base, c->time_base);
+}
+
+/**
+ * Rebuilds the track heap from the current timestamps of the tracks.
+ */
+static void track_heap_rebuild(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        update_track_heap_timestamp(s, c->tracks[i]);
+    for (uint32_t i = c->track_count / 2; i > 0; --i)
+        track_heap_sift_down(c, i - 1);
+}
+
+/**
+ * Computes the time base common to the streams of all the tracks, in which
+ * the timestamps of the tracks are compared, and builds the track heap.
+ */
+static int init_track_heap(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    int64_t den = 1;
+
+    for (uint32_t i = 0; i < c->track_count && den <= INT_MAX; ++i)
+        den = den / av_gcd(den, s->streams[i]->time_base.den) * s->streams[i]->time_base.den;
+
+    /* fall back to an approximate time base if the exact one cannot be represented */
+    c->time_base = den <= INT_MAX ? av_make_q(1, den) : AV_TIME_BASE_Q;
+    av_log(s, AV_LOG_DEBUG, "Track scheduling time base: " AVRATIONAL_FORMAT "\n", AVRATIONAL_ARG(c->time_base));
+
+    c->track_heap = av_calloc(c->track_count, sizeof(*c->track_heap));
+    if (c->track_count && !c->track_heap)
+        return AVERROR(ENOMEM);
+    memcpy(c->track_heap, c->tracks, c->track_count * sizeof(*c->track_heap));
+    track_heap_rebuild(s);
+
+    return 0;
+}
+
+/**
+ * Resources opened up front by open_all_track_files(), one per track file
+ */
+typedef struct IMFOpenJobs {
+    AVFormatContext *s;
+    IMFVirtualTrackResourcePlaybackCtx **resources;
+    int *rets;
+} IMFOpenJobs;
+
+static void open_track_file_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    IMFOpenJobs *jobs = priv;
+
+    jobs->rets[jobnr] = open_track_resource_context(jobs->s, jobs->resources[jobnr], 0);
+}
+
+/**
+ * Opens the track files of all the tracks up front, using the number of
+ * threads set by the imf_open_threads option.
+ * @return 0 on success, or the error of the first track file, in playlist
+ * order, that could not be opened.
+ */
+static int open_all_track_files(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFOpenJobs jobs = { .s = s };
+    IMFOpenJobs batch_jobs = { .s = s };
+    AVSliceThread *thread = NULL;
+    IMFTrackFileCtx **track_files = NULL;
+    int nb_jobs = 0;
+    int batch;
+    int ret = 0;
+
+    jobs.resources = av_calloc(c->track_file_count, sizeof(*jobs.resources));
+    jobs.rets = av_calloc(c->track_file_count, sizeof(*jobs.rets));
+    track_files = av_calloc(c->track_file_count, sizeof(*track_files));
+    if (!jobs.resources || !jobs.rets || !track_files) {
+        ret = AVERROR(ENOMEM);
+        goto clean_up;
+    }
+
+    /* one job per track file, opened through its first resource */
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        for (uint32_t j = 0; j < c->tracks[i]->resource_count; ++j) {
+            IMFVirtualTrackResourcePlaybackCtx *resource = &c->tracks[i]->resources[j];
+            int found = 0;
+
+            for (int k = 0; k < nb_jobs && !found; ++k)
+                found = track_files[k] == resource->track_file;
+            if (found)
+                continue;
+            track_files[nb_jobs] = resource->track_file;
+            jobs.resources[nb_jobs++] = resource;
+        }
+
+    /* The track files are opened by batches of at most max_open_resources,
+     * the ones of the previous batch being closed before the next batch, but
+     * the check mode needs the header metadata of all the track files. */
+    batch = c->max_open_resources && !c->check ? c->max_open_resources : nb_jobs;
+
+    av_log(s, AV_LOG_DEBUG, "Open %d track files with %d threads\n", nb_jobs, c->open_threads);
+
+    if (c->open_threads > 1
+        && avpriv_slicethread_create(&thread, &batch_jobs, open_track_file_worker, NULL, c->open_threads) <= 0)
+        thread = NULL;
+    for (int start = 0; start < nb_jobs; start += batch) {
+        int count = FFMIN(batch, nb_jobs - start);
+
+        evict_track_files(s, count);
+        batch_jobs.resources = jobs.resources + start;
+        batch_jobs.rets = jobs.rets + start;
+        for (int i = 0; i < count; ++i)
+            jobs.resources[start + i]->track_file->use_seq = c->use_seq++;
+        if (thread) {
+            avpriv_slicethread_execute(thread, count, 0);
+        } else {
+            for (int i = 0; i < count; ++i)
+                open_track_file_worker(&batch_jobs, i, 0, count, 1);
+        }
+    }
+    avpriv_slicethread_free(&thread);
+
+    for (int i = 0; i < nb_jobs; ++i)
+        if (jobs.rets[i] < 0) {
+            av_log(s,
+                AV_LOG_ERROR,
+                "Could not open track file %s\n",
+                jobs.resources[i]->locator->absolute_uri);
+            ret = jobs.rets[i];
+            /* report all the track files that cannot be opened in check mode */
+            if (!c->check)
+                break;
+            c->check_errors++;
+        }
+
+clean_up:
+    av_free(jobs.resources);
+    av_free(jobs.rets);
+    av_free(track_files);
+    return ret;
+}
+
+/**
+ * Checks that the resources of the tracks fit within their track files, using
+ * the header metadata of the track files, which must be open.
+ * @return 0 if no error was found in the package, AVERROR_INVALIDDATA
+ * otherwise.
+ */
+static int check_track_resources(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        for (uint32_t j = 0; j < c->tracks[i]->resource_count; ++j) {
+            IMFVirtualTrackResourcePlaybackCtx *resource = &c->tracks[i]->resources[j];
+            FFIMFBaseResource *base = &resource->resource->base;
+            AVStream *st;
+            int64_t intrinsic_duration;
+
+            /* the track files that could not be opened are already reported */
+            if (!resource->track_file->ctx || !resource->track_file->ctx->nb_streams)
+                continue;
+            st = resource->track_file->ctx->streams[0];
+
+            if (av_cmp_q(st->time_base, av_inv_q(base->edit_rate))) {
+                av_log(s,
+                    AV_LOG_ERROR,
+                    "Resource %" PRIu32 " of track %d: edit rate " AVRATIONAL_FORMAT
+                    " does not match the edit rate of %s (%d/%d)\n",
+                    j,
+                    c->tracks[i]->index,
+                    AVRATIONAL_ARG(base->edit_rate),
+                    resource->locator->absolute_uri,
+                    st->time_base.den,
+                    st->time_base.num);
+                c->check_errors++;
+            }
+
+            if (st->duration == AV_NOPTS_VALUE) {
+                av_log(s,
+                    AV_LOG_WARNING,
+                    "Unknown duration of %s, resource %" PRIu32 " of track %d not checked\n",
+                    resource->locator->absolute_uri,
+                    j,
+                    c->tracks[i]->index);
+                continue;
+            }
+            intrinsic_duration = av_rescale_q(st->duration, st->time_base, av_inv_q(base->edit_rate));
+            if ((int64_t)base->entry_point + base->duration > intrinsic_duration) {
+                av_log(s,
+                    AV_LOG_ERROR,
+                    "Resource %" PRIu32 " of track %d: entry point %" PRIu32 " and duration %" PRIu32
+                    " exceed the %" PRId64 " edit units of %s\n",
+                    j,
+                    c->tracks[i]->index,
+                    base->entry_point,
+                    base->duration,
+                    intrinsic_duration,
+                    resource->locator->absolute_uri);
+                c->check_errors++;
+            }
+        }
+
+    if (c->check_errors) {
+        av_log(s, AV_LOG_ERROR, "%d error(s) found in the IMF package\n", c->check_errors);
+        return AVERROR_INVALIDDATA;
+    }
+
+    av_log(s, AV_LOG_INFO, "No error found in the IMF package\n");
+    return 0;
+}
+
+/**
+ * Parses a point of the timeline window, given either as a number of edit
+ * units or as a timecode relative to the start of the composition.
+ */
+static int parse_window_point(AVFormatContext *s, const char *str, int64_t *edit_unit)
+{
+    IMFContext *c = s->priv_data;
+    AVTimecode tc;
+    char *end;
+    int ret;
+
+    if (strchr(str, ':') || strchr(str, ';')) {
+        if ((ret = av_timecode_init_from_string(&tc, c->cpl->edit_rate, str, s)) < 0)
+            return ret;
+        *edit_unit = tc.start;
+        return 0;
+    }
+
+    *edit_unit = strtoll(str, &end, 10);
+    if (end == str || *end || *edit_unit < 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid timeline window point: %s\n", str);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int parse_timeline_window(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    int ret;
+
+    c->window_start = 0;
+    c->window_end = INT64_MAX;
+    if (c->window_start_str && (ret = parse_window_point(s, c->window_start_str, &c->window_start)) < 0)
+        return ret;
+    if (c->window_end_str && (ret = parse_window_point(s, c->window_end_str, &c->window_end)) < 0)
+        return ret;
+    if (c->window_end <= c->window_start) {
+        av_log(s, AV_LOG_ERROR, "The end of the timeline window must follow its start\n");
+        return AVERROR(EINVAL);
+    }
+    if (c->window_start_str || c->window_end_str)
+        av_log(s,
+            AV_LOG_DEBUG,
+            "Timeline window: edit units %" PRId64 " to %" PRId64 "\n",
+            c->window_start,
+            c->window_end);
+
+    return 0;
+}
+
+/**
+ * Parses the imf_track option.
+ */
+static int parse_track_id(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    const char *str = c->track_id_str;
+
+    if (!str)
+        return 0;
+
+    /* the urn:uuid: prefix is optional */
+    av_strstart(str, "urn:uuid:", &str);
+    if (sscanf(str,
+            FF_UUID_FORMAT + strlen("urn:uuid:"),
+            &c->track_id[0],
+            &c->track_id[1],
+            &c->track_id[2],
+            &c->track_id[3],
+            &c->track_id[4],
+            &c->track_id[5],
+            &c->track_id[6],
+            &c->track_id[7],
+            &c->track_id[8],
+            &c->track_id[9],
+            &c->track_id[10],
+            &c->track_id[11],
+            &c->track_id[12],
+            &c->track_id[13],
+            &c->track_id[14],
+            &c->track_id[15]) != 16) {
+        av_log(s, AV_LOG_ERROR, "Invalid imf_track %s\n", c->track_id_str);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+/**
+ * @return 1 if the virtual track is presented, 0 if it is filtered out by the
+ * imf_track option.
+ */
+static int is_track_selected(IMFContext *c, FFIMFTrackFileVirtualTrack *virtual_track)
+{
+    return !c->track_id_str || !memcmp(virtual_track->base.id_uuid, c->track_id, sizeof(FFUUID));
+}
+
+static int open_cpl_tracks(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    int32_t track_index = 0;
+    int ret;
+
+    if ((ret = parse_timeline_window(s)) < 0)
+        return ret;
+
+    if ((ret = parse_track_id(s)) < 0)
+        return ret;
+
+    if (c->cpl->main_image_2d_track && is_track_selected(c, c->cpl->main_image_2d_track))
+        if ((ret = open_virtual_track(s, c->cpl->main_image_2d_track, track_index++)) != 0) {
+            av_log(s,
+                AV_LOG_ERROR,
+                "Could not open image track " FF_UUID_FORMAT "\n",
+                UID_ARG(c->cpl->main_image_2d_track->base.id_uuid));
+            return ret;
+        }
+
+    for (uint32_t i = 0; i < c->cpl->main_audio_track_count; ++i) {
+        if (!is_track_selected(c, &c->cpl->main_audio_tracks[i]))
+            continue;
+        if ((ret = open_virtual_track(s, &c->cpl->main_audio_tracks[i], track_index++)) != 0) {
+            av_log(s,
+                AV_LOG_ERROR,
+                "Could not open audio track " FF_UUID_FORMAT "\n",
+                UID_ARG(c->cpl->main_audio_tracks[i].base.id_uuid));
+            return ret;
+        }
+    }
+
+    if (c->track_id_str && !track_index) {
+        av_log(s, AV_LOG_ERROR, "Track %s not found in the composition\n", c->track_id_str);
+        return AVERROR(EINVAL);
+    }
+
+    if ((ret = parse_preopen_tracks(s)) < 0)
+        return ret;
+
+    if (!HAVE_THREADS && c->read_ahead) {
+        av_log(s, AV_LOG_WARNING, "Read-ahead requires threading support, ignoring read_ahead\n");
+        c->read_ahead = 0;
+    }
+
+    if (c->check) {
+        /* a failure to open a track file is counted as a check error */
+        if ((ret = open_all_track_files(s)) == AVERROR(ENOMEM))
+            return ret;
+        if ((ret = check_track_resources(s)) < 0)
+            return ret;
+    } else if (c->open_threads && !c->header_only && (ret = open_all_track_files(s)) < 0)
+        return ret;
+
+    if (c->export_map)
+        for (uint32_t i = 0; i < c->track_count; ++i)
+            if ((ret = build_track_map(s, c->tracks[i])) < 0)
+                return ret;
+
+    if ((ret = set_context_streams_from_tracks(s)) < 0)
+        return ret;
+
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        if ((ret = add_track_index_entries(s, c->tracks[i])) < 0)
+            return ret;
+
+    return init_track_heap(s);
+}
+
+/**
+ * Adds the path, size and modification time of a local file to a cache key.
+ * @return 0 on success, AVERROR(ENOSYS) if the file is not a local file.
+ */
+static int imf_cache_hash_file(AVFormatContext *s, struct AVHashContext *hash, const char *url)
+{
+    int64_t size, mtime;
+    char buf[64];
+
+    if (imf_stat_local_file(url, &size, &mtime) < 0) {
+        av_log(s, AV_LOG_DEBUG, "%s is not a local file, not using the cache\n", url);
+        return AVERROR(ENOSYS);
+    }
+
+    snprintf(buf, sizeof(buf), "|%"PRId64"|%"PRId64"|", size, mtime);
+    av_hash_update(hash, url, strlen(url) + 1);
+    av_hash_update(hash, buf, strlen(buf));
+
+    return 0;
+}
+
+/**
+ * Builds the path of the cache file of the package from the CPL and the asset
+ * maps, so that the cache entry is invalidated when any of them is modified.
+ * @return 0 on success, AVERROR(ENOSYS) if the package cannot be cached.
+ */
+static int imf_cache_get_path(AVFormatContext *s, char **cache_path)
+{
+    IMFContext *c = s->priv_data;
+    struct AVHashContext *hash;
+    char key[AV_HASH_MAX_SIZE * 2 + 1];
+    char *asset_map_paths;
+    char *asset_map_path;
+    char *tmp_str;
+    int ret;
+
+    if ((ret = av_hash_alloc(&hash, "SHA160")) < 0)
+        return ret;
+    av_hash_init(hash);
+
+    if ((ret = imf_cache_hash_file(s, hash, s->url)) < 0)
+        goto clean_up;
+
+    if (!(asset_map_paths = av_strdup(c->asset_map_paths))) {
+        ret = AVERROR(ENOMEM);
+        goto clean_up;
+    }
+    asset_map_path = av_strtok(asset_map_paths, ",", &tmp_str);
+    while (asset_map_path != NULL && ret >= 0) {
+        ret = imf_cache_hash_file(s, hash, asset_map_path);
+        asset_map_path = av_strtok(NULL, ",", &tmp_str);
+    }
+    av_free(asset_map_paths);
+    if (ret < 0)
+        goto clean_up;
+
+    av_hash_final_hex(hash, key, sizeof(key));
+    if (!(*cache_path = av_asprintf("%s/%s.imfcache", c->cache_dir, key)))
+        ret = AVERROR(ENOMEM);
+
+clean_up:
+    av_hash_freep(&hash);
+
+    return ret;
+}
+
+static int imf_cache_read_asset_map(AVIOContext *pb, IMFAssetLocatorMap *asset_map)
+{
+    uint32_t asset_count = avio_rl32(pb);
+    uint32_t len;
+
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+    if (asset_count && !(asset_map->assets = av_calloc(asset_count, sizeof(IMFAssetLocator))))
+        return AVERROR(ENOMEM);
+    asset_map->assets_alloc_sz = asset_count * sizeof(IMFAssetLocator);
+
+    while (asset_map->asset_count < asset_count) {
+        IMFAssetLocator *asset = &asset_map->assets[asset_map->asset_count];
+
+        avio_read(pb, asset->uuid, sizeof(asset->uuid));
+        asset->packing_list = avio_r8(pb);
+        len = avio_rl32(pb);
+        if (avio_feof(pb) || len == UINT32_MAX)
+            return AVERROR_INVALIDDATA;
+        if (!(asset->absolute_uri = av_malloc(len + 1)))
+            return AVERROR(ENOMEM);
+        asset_map->asset_count++;
+        if (avio_read(pb, asset->absolute_uri, len) != len)
+            return AVERROR_INVALIDDATA;
+        asset->absolute_uri[len] = 0;
+    }
+
+    return imf_asset_locator_map_build_index(asset_map);
+}
+
+/**
+ * Restores the CPL and the asset locator map of the package from the cache.
+ * @return 0 on success, < 0 AVERROR code if the package is not in the cache.
+ */
+static int imf_cache_load(AVFormatContext *s, const char *cache_path)
+{
+    IMFContext *c = s->priv_data;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if ((ret = avio_open2(&pb, cache_path, AVIO_FLAG_READ, &s->interrupt_callback, NULL)) < 0)
+        return ret;
+
+    if (avio_rl32(pb) != MKTAG('I', 'M', 'F', 'P') || avio_rl32(pb) != IMF_CACHE_VERSION) {
+        ret = AVERROR_INVALIDDATA;
+        goto clean_up;
+    }
+    if ((ret = ff_imf_cpl_read(pb, &c->cpl)) < 0)
+        goto clean_up;
+    ret = imf_cache_read_asset_map(pb, &c->asset_locator_map);
+    if (ret >= 0 && avio_feof(pb))
+        ret = AVERROR_INVALIDDATA;
+
+clean_up:
+    avio_closep(&pb);
+    if (ret < 0) {
+        ff_imf_cpl_free(c->cpl);
+        c->cpl = NULL;
+        imf_asset_locator_map_deinit(&c->asset_locator_map);
+        imf_asset_locator_map_init(&c->asset_locator_map);
+    }
+
+    return ret;
+}
+
+/**
+ * Stores the CPL and the asset locator map of the package in the cache. The
+ * entry is written to a temporary file first, so that concurrent readers never
+ * see a partial entry.
+ */
+static int imf_cache_store(AVFormatContext *s, const char *cache_path)
+{
+    IMFContext *c = s->priv_data;
+    AVIOContext *pb = NULL;
+    char *tmp_path;
+    int ret;
+
+    if (!(tmp_path = av_asprintf("%s.%08"PRIx32".tmp", cache_path, av_get_random_seed())))
+        return AVERROR(ENOMEM);
+
+    if ((ret = avio_open2(&pb, tmp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL)) < 0)
+        goto clean_up;
+
+    ffio_wfourcc(pb, "IMFP");
+    avio_wl32(pb, IMF_CACHE_VERSION);
+    ff_imf_cpl_write(pb, c->cpl);
+    avio_wl32(pb, c->asset_locator_map.asset_count);
+    for (uint32_t i = 0; i < c->asset_locator_map.asset_count; i++) {
+        IMFAssetLocator *asset = &c->asset_locator_map.assets[i];
+
+        avio_write(pb, asset->uuid, sizeof(asset->uuid));
+        avio_w8(pb, asset->packing_list);
+        avio_wl32(pb, strlen(asset->absolute_uri));
+        avio_write(pb, asset->absolute_uri, strlen(asset->absolute_uri));
+    }
+
+    ret = avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp_path, cache_path, s);
+    if (ret < 0)
+        ffurl_delete(tmp_path);
+
+clean_up:
+    av_free(tmp_path);
+
+    return ret;
+}
+
+/**
+ * Marker placed on the timeline of the composition
+ */
+typedef struct IMFTimelineMarker {
+    FFIMFMarker *marker;
+    int64_t position; /**< Position in edit units of the marker track */
+    uint32_t index;   /**< Order of the marker in the CPL */
+} IMFTimelineMarker;
+
+static int imf_timeline_marker_cmp(const void *a, const void *b)
+{
+    const IMFTimelineMarker *ma = a;
+    const IMFTimelineMarker *mb = b;
+
+    if (ma->position != mb->position)
+        return ma->position < mb->position ? -1 : 1;
+    return FFDIFFSIGN(ma->index, mb->index);
+}
+
+/**
+ * Exports the markers of the main marker track that fall within the timeline
+ * window as chapters, and locates the marker given by the imf_seek_marker
+ * option.
+ */
+static int set_context_chapters_from_markers(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    FFIMFMarkerVirtualTrack *marker_track = c->cpl->main_markers_track;
+    IMFTimelineMarker *markers = NULL;
+    AVRational edit_rate;
+    AVChapter *chapter;
+    int64_t window_start, window_end;
+    int64_t position = 0;
+    uint32_t marker_count = 0;
+    uint32_t marker_alloc = 0;
+    int ret = 0;
+
+    c->seek_marker_ts = AV_NOPTS_VALUE;
+    if (!marker_track || !marker_track->resource_count)
+        goto check_seek_marker;
+
+    edit_rate = marker_track->resources[0].base.edit_rate;
+    window_start = av_rescale_rnd(c->window_start,
+        (int64_t)edit_rate.num * c->cpl->edit_rate.den,
+        (int64_t)edit_rate.den * c->cpl->edit_rate.num,
+        AV_ROUND_UP);
+    window_end = c->window_end;
+    if (window_end != INT64_MAX)
+        window_end = av_rescale_rnd(c->window_end,
+            (int64_t)edit_rate.num * c->cpl->edit_rate.den,
+            (int64_t)edit_rate.den * c->cpl->edit_rate.num,
+            AV_ROUND_UP);
+
+    for (uint32_t i = 0; i < marker_track->resource_count; ++i) {
+        FFIMFMarkerResource *resource = &marker_track->resources[i];
+
+        for (uint32_t j = 0; j < resource->base.repeat_count; ++j, position += resource->base.duration)
+            for (uint32_t k = 0; k < resource->marker_count; ++k) {
+                int64_t marker_position = position + resource->markers[k].offset;
+                void *tmp;
+
+                if (marker_position < window_start || marker_position >= window_end)
+                    continue;
+                if (marker_count == marker_alloc) {
+                    if (marker_alloc > UINT32_MAX / 2 - 1) {
+                        ret = AVERROR(ENOMEM);
+                        goto clean_up;
+                    }
+                    marker_alloc = 2 * marker_alloc + 1;
+                    tmp = av_realloc_array(markers, marker_alloc, sizeof(*markers));
+                    if (!tmp) {
+                        ret = AVERROR(ENOMEM);
+                        goto clean_up;
+                    }
+                    markers = tmp;
+                }
+                markers[marker_count].marker = &resource->markers[k];
+                markers[marker_count].position = marker_position - window_start;
+                markers[marker_count].index = marker_count;
+                marker_count++;
+            }
+    }
+    if (window_end != INT64_MAX)
+        position = FFMIN(position, window_end);
+    position -= window_start;
+
+    if (marker_count)
+        qsort(markers, marker_count, sizeof(*markers), imf_timeline_marker_cmp);
+
+    /* a chapter extends to the next marker, or to the end of the marker track */
+    for (uint32_t i = 0; i < marker_count; ++i) {
+        chapter = avpriv_new_chapter(s,
+            i,
+            av_inv_q(edit_rate),
+            markers[i].position,
+            i + 1 < marker_count ? markers[i + 1].position : FFMAX(position, markers[i].position),
+            markers[i].marker->label_utf8);
+        if (!chapter) {
+            ret = AVERROR(ENOMEM);
+            goto clean_up;
+        }
+        if (markers[i].marker->scope_utf8
+            && (ret = av_dict_set(&chapter->metadata, "scope", markers[i].marker->scope_utf8, 0)) < 0)
+            goto clean_up;
+
+        if (c->seek_marker && c->seek_marker_ts == AV_NOPTS_VALUE
+            && !xmlStrcmp(markers[i].marker->label_utf8, c->seek_marker))
+            /* round up, so that the seek does not land on the previous edit unit */
+            c->seek_marker_ts = av_rescale_q_rnd(markers[i].position,
+                av_inv_q(edit_rate),
+                AV_TIME_BASE_Q,
+                AV_ROUND_UP);
+    }
+
+check_seek_marker:
+    if (c->seek_marker && c->seek_marker_ts == AV_NOPTS_VALUE) {
+        av_log(s, AV_LOG_ERROR, "Marker %s not found in the composition\n", c->seek_marker);
+        ret = AVERROR(EINVAL);
+    }
+
+clean_up:
+    av_free(markers);
+    return ret;
+}
+
+static int imf_probe(const AVProbeData *p)
+{
+    const char *root = av_stristr((const char *)p->buf, "CompositionPlaylist");
+    const char *start = root;
+
+    if (!root)
+        return 0;
+
+    /* the root element may have a namespace prefix, e.g. <cpl:CompositionPlaylist */
+    while (start > (const char *)p->buf && av_isgraph(start[-1]) && start[-1] != '<' && start[-1] != '>')
+        start--;
+    if (start == (const char *)p->buf || start[-1] != '<')
+        return 0;
+
+    if (av_stristr(root, "http://www.smpte-ra.org/schemas/2067-3/"))
+        return AVPROBE_SCORE_MAX;
+
+    return 0;
+}
+
+/**
+ * Sets the imf_resource_starts metadata of each track stream to the
+ * comma-separated edit units at which its resources start in the window.
+ */
+static int export_resource_starts(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    AVBPrint bp;
+    int ret = 0;
+
+    for (uint32_t i = 0; i < c->track_count && ret >= 0; i++) {
+        IMFVirtualTrackPlaybackCtx *track = c->tracks[i];
+
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        for (uint32_t j = 0; j < track->resource_count; j++)
+            av_bprintf(&bp, "%s%"PRId64, j ? "," : "", track->resources[j].start_edit_unit);
+        if (!av_bprint_is_complete(&bp)) {
+            av_bprint_finalize(&bp, NULL);
+            return AVERROR(ENOMEM);
+        }
+        ret = av_dict_set(&s->streams[track->index]->metadata, "imf_resource_starts", bp.str, 0);
+        av_bprint_finalize(&bp, NULL);
+    }
+    return ret;
+}
+
+static int imf_read_header(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    char *cache_path = NULL;
+    char *tmp_str;
+    int ret = 0;
+
+    c->interrupt_callback = &s->interrupt_callback;
+    c->run_start = AV_NOPTS_VALUE;
+    if ((ret = ff_mutex_init(&c->io_pool_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_mutex_init(&c->track_files_lock, NULL)))
+        return AVERROR(ret);
+    tmp_str = av_strdup(s->url);
+    if (!tmp_str) {
+        ret = AVERROR(ENOMEM);
+        return ret;
+    }
+    /* av_dirname() returns a static string for a URL without directory */
+    c->base_url = av_strdup(av_dirname(tmp_str));
+    av_free(tmp_str);
+    if (!c->base_url)
+        return AVERROR(ENOMEM);
+    if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
+        return ret;
+
+    if (!c->asset_map_paths) {
+        c->asset_map_paths = av_append_path_component(c->base_url, "ASSETMAP.xml");
+        if (!c->asset_map_paths) {
+            ret = AVERROR(ENOMEM);
+            return ret;
+        }
+        av_log(s, AV_LOG_DEBUG, "No asset maps provided, using the default ASSETMAP.xml\n");
+    }
+
+    imf_asset_locator_map_init(&c->asset_locator_map);
+
+    if (c->cache_dir) {
+        ret = imf_cache_get_path(s, &cache_path);
+        if (ret == AVERROR(ENOMEM))
+            return ret;
+        if (cache_path && imf_cache_load(s, cache_path) >= 0) {
+            av_log(s, AV_LOG_DEBUG, "loaded IMF package from cache: %s\n", cache_path);
+            av_freep(&cache_path);
+            goto open_tracks;
+        }
+    }
+
+    /* the asset maps are fetched while the CPL is parsed */
+    if ((ret = start_asset_map_fetches(s)) < 0)
+        goto fail;
+
+    av_log(s, AV_LOG_DEBUG, "start parsing IMF CPL: %s\n", s->url);
+
+    if ((ret = ff_parse_imf_cpl(s->pb, &c->cpl)) < 0)
+        goto fail;
+
+    av_log(s,
+        AV_LOG_DEBUG,
+        "parsed IMF CPL: " FF_UUID_FORMAT "\n",
+        UID_ARG(c->cpl->id_uuid));
+
+    /* Parse the first asset map. The other ones are parsed when an asset is
+     * not found in the previous ones, except when the package is cached,
+     * since the cache entry holds all the assets. */
+    if ((ret = load_next_assetmap(s)) < 0)
+        goto fail;
+    if (cache_path) {
+        while ((ret = load_next_assetmap(s)) > 0)
+            ;
+        if (ret < 0)
+            goto fail;
+        av_log(s, AV_LOG_DEBUG, "parsed IMF Asset Maps\n");
+
+        if ((ret = imf_cache_store(s, cache_path)) < 0)
+            av_log(s, AV_LOG_WARNING, "Cannot write IMF package cache %s: %s\n", cache_path, av_err2str(ret));
+        av_freep(&cache_path);
+    }
+
+open_tracks:
+    if (c->verify_hashes && (ret = load_packing_lists(s)) < 0)
+        return ret;
+
+    if (ret = open_cpl_tracks(s))
+        return ret;
+
+    if ((ret = set_context_chapters_from_markers(s)) < 0)
+        return ret;
+
+    if (c->export_resources && (ret = export_resource_starts(s)) < 0)
+        return ret;
+
+    for (uint32_t i = 0; i < c->track_count; i++) {
+        ret = av_dict_copy(&s->streams[c->tracks[i]->index]->metadata, c->tracks[i]->map, 0);
+        av_dict_free(&c->tracks[i]->map);
+        if (ret < 0)
+            return ret;
+    }
+
+    av_log(s, AV_LOG_DEBUG, "parsed IMF package\n");
+
+    return 0;
+
+fail:
+    av_free(cache_path);
+    return ret;
+}
+
+/**
+ * Makes a resource the current resource of a virtual track, positioned at the
+ * specified offset from its entry point, in edit units.
+ */
+/**
+ * Drops the packets read ahead from the track file of the current resource.
+ */
+static void flush_track_batch(IMFVirtualTrackPlaybackCtx *track)
+{
+    for (int i = track->batch_pos; i < track->batch_nb; i++)
+        av_packet_unref(track->batch_pkts[i]);
+    track->batch_pos = track->batch_nb = 0;
+}
+
+static int switch_track_resource(AVFormatContext *s,
+    IMFVirtualTrackPlaybackCtx *track,
+    uint32_t resource_index,
+    int64_t offset)
+{
+    IMFContext *c = s->priv_data;
+    IMFTrackFileCtx *current_track_file = track->resources[track->current_resource_index].track_file;
+    IMFTrackFileCtx *preopened_track_file = wait_preopen(s, track);
+    IMFTrackFileCtx *track_file = track->resources[resource_index].track_file;
+    int ret;
+
+    flush_track_batch(track);
+    ff_mutex_lock(&c->track_files_lock);
+    current_track_file->in_use = 0;
+    track_file->in_use = 1;
+    track_file->use_seq = c->use_seq++;
+    /* Keep the current context open if the new or a later resource uses the same track file */
+    if (!track_file_is_used_from(track, resource_index, current_track_file))
+        imf_track_file_park(s, current_track_file);
+    /* Same for a context pre-opened for a resource that is skipped by a seek */
+    if (preopened_track_file && !track_file_is_used_from(track, resource_index, preopened_track_file))
+        imf_track_file_park(s, preopened_track_file);
+    if (!track_file->ctx || track_file->parked)
+        evict_track_files(s, 1);
+    ff_mutex_unlock(&c->track_files_lock);
+
+    if ((ret = open_track_resource_context(s, &(track->resources[resource_index]), offset)) != 0)
+        return ret;
+    track->current_resource_index = resource_index;
+    track->prefetched_resource = resource_index;
+    track->resource_switches++;
+
+    ff_mutex_lock(&c->track_files_lock);
+    start_preopen(s, track);
+    ff_mutex_unlock(&c->track_files_lock);
+
+    return 0;
+}
+
+static int resource_contains_edit_unit(IMFVirtualTrackResourcePlaybackCtx *resource, int64_t edit_unit)
+{
+    return resource->start_edit_unit <= edit_unit
+        && edit_unit < resource->start_edit_unit + resource->duration;
+}
+
+/**
+ * Finds the resource of a virtual track that contains an edit unit, by
+ * bisection over the resource start offsets.
+ * @return the index of the resource, or a negative value if there is none.
+ */
+static int64_t find_resource_index_for_edit_unit(IMFVirtualTrackPlaybackCtx *track, int64_t edit_unit)
+{
+    uint32_t low = 0;
+    uint32_t high = track->resource_count;
+    uint32_t mid;
+
+    /* find the last resource that starts at or before the edit unit */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (track->resources[mid].start_edit_unit <= edit_unit)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (!low || !resource_contains_edit_unit(&track->resources[low - 1], edit_unit))
+        return -1;
+    return low - 1;
+}
+
+/**
+ * Positions a virtual track at an edit unit, or at its end if the edit unit is
+ * past the end of the track.
+ */
+static int seek_track(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track, int64_t edit_unit)
+{
+    AVRational edit_rate = track->resources[0].resource->base.edit_rate;
+    int64_t resource_index;
+    int ret;
+
+    flush_track_batch(track);
+    if (edit_unit >= get_track_edit_unit_count(track)) {
+        track->current_timestamp = track->duration;
+        track->last_pts = track->duration;
+        return 0;
+    }
+
+    resource_index = find_resource_index_for_edit_unit(track, edit_unit);
+    if (resource_index < 0)
+        return AVERROR_BUG;
+
+    av_log(s,
+        AV_LOG_DEBUG,
+        "Seek track %d to edit unit %" PRId64 " in resource %" PRId64 "\n",
+        track->index,
+        edit_unit,
+        resource_index);
+
+    if ((ret = switch_track_resource(s,
+             track,
+             resource_index,
+             edit_unit - track->resources[resource_index].start_edit_unit))
+        != 0)
+        return ret;
+
+    track->current_timestamp = av_rescale_q(edit_unit, av_inv_q(edit_rate), s->streams[track->index]->time_base);
+    track->last_pts = track->current_timestamp;
+
+    return 0;
+}
+
+/**
+ * Applies the discard setting of the streams to their tracks. The track file
+ * contexts of a track whose stream is discarded get the same setting and are
+ * parked, and the track is no longer scheduled. A track that is read again is
+ * first positioned at the current timestamp of the other tracks.
+ */
+static int update_track_discard(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track;
+    IMFTrackFileCtx *track_file;
+    AVRational edit_rate;
+    int64_t timestamp;
+    int changed = 0;
+    int discard;
+    int ret;
+
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        discard = s->streams[track->index]->discard >= AVDISCARD_ALL;
+        if (discard == track->discard)
+            continue;
+
+        track_file = wait_preopen(s, track);
+        ff_mutex_lock(&c->track_files_lock);
+        for (uint32_t j = 0; j < track->resource_count; ++j) {
+            AVFormatContext *ctx = track->resources[j].track_file->ctx;
+
+            if (ctx && ctx->nb_streams)
+                ctx->streams[0]->discard = s->streams[track->index]->discard;
+        }
+        if (discard) {
+            track->resources[track->current_resource_index].track_file->in_use = 0;
+            imf_track_file_park(s, track->resources[track->current_resource_index].track_file);
+            if (track_file)
+                imf_track_file_park(s, track_file);
+            track->discard = 1;
+            changed = 1;
+        }
+        ff_mutex_unlock(&c->track_files_lock);
+
+        av_log(s, AV_LOG_DEBUG, "%s track %d\n", discard ? "Discard" : "Read", track->index);
     }
+    if (changed)
+        track_heap_rebuild(s);
 
-    /* Compare the source timebase to the resource edit rate, considering the first stream of the source file */
-    if (av_cmp_q(track_resource->ctx->streams[0]->time_base, av_inv_q(track_resource->resource->base.edit_rate)))
-        av_log(s,
-            AV_LOG_WARNING,
-            "Incoherent source stream timebase %d/%d regarding resource edit rate: %d/%d",
-            track_resource->ctx->streams[0]->time_base.num,
-            track_resource->ctx->streams[0]->time_base.den,
-            track_resource->resource->base.edit_rate.den,
-            track_resource->resource->base.edit_rate.num);
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        if (!track->discard || s->streams[track->index]->discard >= AVDISCARD_ALL)
+            continue;
+
+        /* resume at the first edit unit not before the tracks being read */
+        timestamp = c->track_heap[0]->discard ? 0 : c->track_heap[0]->heap_timestamp;
+        edit_rate = track->resources[0].resource->base.edit_rate;
+        track->discard = 0;
+        if ((ret = seek_track(s, track, av_rescale_q_rnd(timestamp, c->time_base, av_inv_q(edit_rate),
+                                                         AV_ROUND_UP))) < 0)
+            return ret;
+        track_heap_rebuild(s);
+        changed = 1;
+    }
+    if (changed)
+        c->run_start = AV_NOPTS_VALUE;
+
+    return 0;
+}
+
+/**
+ * Returns the index of the first edit unit of the track that starts at or
+ * after the current timestamp of the track.
+ */
+static int64_t get_track_current_edit_unit(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+    AVRational edit_rate = track->resources[0].resource->base.edit_rate;
+    AVRational time_base = s->streams[track->index]->time_base;
+
+    return av_rescale_rnd(track->current_timestamp,
+        (int64_t)time_base.num * edit_rate.num,
+        (int64_t)time_base.den * edit_rate.den,
+        AV_ROUND_UP);
+}
+
+static IMFVirtualTrackResourcePlaybackCtx *get_resource_context_for_timestamp(AVFormatContext *s,
+    IMFVirtualTrackPlaybackCtx *track)
+{
+    int64_t edit_unit = get_track_current_edit_unit(s, track);
+    int64_t i;
+    int ret;
+
+    /* fast path: the current resource still contains the edit unit */
+    if (resource_contains_edit_unit(&track->resources[track->current_resource_index], edit_unit))
+        return &(track->resources[track->current_resource_index]);
 
-    entry_point = (int64_t)track_resource->resource->base.entry_point
-        * track_resource->resource->base.edit_rate.den
-        * AV_TIME_BASE
-        / track_resource->resource->base.edit_rate.num;
+    i = find_resource_index_for_edit_unit(track, edit_unit);
+    if (i < 0)
+        return NULL;
 
-    if (entry_point) {
+    av_log(s,
+        AV_LOG_DEBUG,
+        "Found resource %" PRId64 " in track %d to read for timestamp %" PRId64 " / %" PRId64
+        " (edit unit=%" PRId64 ", start=%" PRId64 "): entry=%" PRIu32
+        ", duration=%" PRIu32
+        ", editrate=" AVRATIONAL_FORMAT "\n",
+        i,
+        track->index,
+        track->current_timestamp,
+        track->duration,
+        edit_unit,
+        track->resources[i].start_edit_unit,
+        track->resources[i].entry_point,
+        track->resources[i].duration,
+        AVRATIONAL_ARG(track->resources[i].resource->base.edit_rate));
+
+    if (track->current_resource_index != i) {
         av_log(s,
             AV_LOG_DEBUG,
-            "Seek at resource %s entry point: %" PRIu32 "\n",
-            track_resource->locator->absolute_uri,
-            track_resource->resource->base.entry_point);
-        ret = avformat_seek_file(track_resource->ctx, -1, entry_point, entry_point, entry_point, 0);
-        if (ret < 0) {
-            av_log(s,
-                AV_LOG_ERROR,
-                "Could not seek at %" PRId64 "on %s: %s\n",
-                entry_point,
-                track_resource->locator->absolute_uri,
-                av_err2str(ret));
-            goto cleanup;
+            "Switch resource on track %d: re-open context\n",
+            track->index);
+        FF_TRACE_BEGIN("imf", "switch_resource");
+        ret = switch_track_resource(s, track, i, 0);
+        FF_TRACE_END("imf", "switch_resource");
+        if (ret != 0)
+            return NULL;
+    }
+    return &(track->resources[track->current_resource_index]);
+}
+
+/**
+ * Updates the packet info from the track and advances the track cursors.
+ */
+static void update_track_cursors(AVFormatContext *s,
+    IMFVirtualTrackPlaybackCtx *track,
+    AVStream *source_stream,
+    AVPacket *pkt)
+{
+    IMFContext *c = s->priv_data;
+
+    /* IMF essence is intra-coded, so packets are presented in the order they
+     * are read */
+    pkt->pts = track->last_pts;
+    pkt->dts = track->last_pts;
+    pkt->stream_index = track->index;
+    /* packets are not parsed in flatten mode, so flag them all as key frames */
+    if (c->flatten)
+        pkt->flags |= AV_PKT_FLAG_KEY;
+
+    track->current_timestamp += av_rescale_q(pkt->duration,
+        source_stream->time_base,
+        s->streams[track->index]->time_base);
+    track->last_pts += pkt->duration;
+}
+
+static int track_is_pcm(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
+{
+    enum AVCodecID codec_id = s->streams[track->index]->codecpar->codec_id;
+
+    return codec_id >= AV_CODEC_ID_PCM_S16LE && codec_id < AV_CODEC_ID_ADPCM_IMA_QT;
+}
+
+/**
+ * Attaches the TrackFileId of the resource and the timestamp of the packet in
+ * the track file to the packet, so that the frames of repeated resources can
+ * be recognized downstream.
+ */
+static int add_content_id(IMFVirtualTrackResourcePlaybackCtx *resource, int64_t source_pts, AVPacket *pkt)
+{
+    uint8_t *id = av_packet_new_side_data(pkt, AV_PKT_DATA_CONTENT_ID, sizeof(FFUUID) + 8);
+
+    if (!id)
+        return AVERROR(ENOMEM);
+    memcpy(id, resource->track_file->uuid, sizeof(FFUUID));
+    AV_WB64(id + sizeof(FFUUID), source_pts);
+
+    return 0;
+}
+
+/**
+ * Appends the edit units that follow pkt in the same resource to pkt, up to
+ * audio_edit_units_per_packet edit units. The samples are left untouched.
+ */
+static int coalesce_track_packets(AVFormatContext *s,
+    IMFVirtualTrackPlaybackCtx *track,
+    IMFVirtualTrackResourcePlaybackCtx *resource,
+    AVPacket *pkt)
+{
+    IMFContext *c = s->priv_data;
+    AVStream *source_stream = resource->track_file->ctx->streams[0];
+    AVPacket *next = track->coalesce_pkt;
+    int64_t start_time;
+    int size;
+    int ret;
+
+    if (!next && !(next = track->coalesce_pkt = av_packet_alloc()))
+        return AVERROR(ENOMEM);
+
+    for (int i = 1; i < c->audio_edit_units_per_packet; i++) {
+        if (track->current_timestamp >= track->duration
+            || !resource_contains_edit_unit(resource, get_track_current_edit_unit(s, track)))
+            break;
+
+        start_time = av_gettime_relative();
+        ret = av_read_frame(resource->track_file->ctx, next);
+        track->read_time += av_gettime_relative() - start_time;
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        if (next->stream_index) {
+            av_packet_unref(next);
+            i--;
+            continue;
+        }
+
+        size = pkt->size;
+        if (next->size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE - size) {
+            av_packet_unref(next);
+            return AVERROR(ERANGE);
+        }
+        if ((ret = av_grow_packet(pkt, next->size)) < 0) {
+            av_packet_unref(next);
+            return ret;
         }
+        memcpy(pkt->data + size, next->data, next->size);
+
+        track->current_timestamp += av_rescale_q(next->duration,
+            source_stream->time_base,
+            s->streams[track->index]->time_base);
+        track->last_pts += next->duration;
+        pkt->duration += next->duration;
+        av_packet_unref(next);
     }
 
-    return ret;
-cleanup:
-    avformat_free_context(track_resource->ctx);
-    track_resource->ctx = NULL;
-    return ret;
+    return 0;
 }
 
-static int open_track_file_resource(AVFormatContext *s,
-    FFIMFTrackFileResource *track_file_resource,
-    IMFVirtualTrackPlaybackCtx *track)
+/**
+ * Hints the storage that the start of the resource following the current one
+ * of a track will be read soon, once the current resource is nearly consumed.
+ * The data is located with the index tables of the track file if its demuxer
+ * was opened before; otherwise, the start of the track file, with its header,
+ * is prefetched. Track files are only opened for the hint on local storage.
+ */
+static void prefetch_next_resource(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
 {
     IMFContext *c = s->priv_data;
-    IMFAssetLocator *asset_locator;
-    IMFVirtualTrackResourcePlaybackCtx vt_ctx;
-    void *tmp;
+    IMFVirtualTrackResourcePlaybackCtx *current = &track->resources[track->current_resource_index];
+    IMFVirtualTrackResourcePlaybackCtx *next;
+    IMFTrackFileCtx *track_file;
+    AVFormatContext *ctx;
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    const char *proto;
+    uint32_t index = track->current_resource_index + 1;
+    int64_t remaining;
+    int64_t pos = 0;
+    int64_t end;
+    int64_t size = c->prefetch_size;
     int ret;
 
-    asset_locator = find_asset_map_locator(&c->asset_locator_map, track_file_resource->track_file_uuid);
-    if (!asset_locator) {
-        av_log(s,
-            AV_LOG_ERROR,
-            "Could not find asset locator for UUID: " FF_UUID_FORMAT "\n",
-            UID_ARG(track_file_resource->track_file_uuid));
-        return AVERROR_INVALIDDATA;
+    if (index >= track->resource_count || index <= track->prefetched_resource)
+        return;
+    next = &track->resources[index];
+
+    remaining = current->start_edit_unit + current->duration - get_track_current_edit_unit(s, track);
+    if (av_rescale_q(remaining, av_inv_q(current->resource->base.edit_rate), AV_TIME_BASE_Q) > c->prefetch_lead)
+        return;
+    track->prefetched_resource = index;
+
+    /* the next resource continues the current one in the same track file */
+    if (next->track_file == current->track_file && next->entry_point == current->entry_point + current->duration)
+        return;
+
+    ff_mutex_lock(&c->track_files_lock);
+    track_file = next->track_file;
+    ctx = track_file->ctx;
+    /* a context being opened by a worker thread must not be touched */
+    if (track_file->preopening) {
+        ff_mutex_unlock(&c->track_files_lock);
+        return;
+    }
+#if CONFIG_MXF_DEMUXER
+    if (ctx && ctx->iformat && !strcmp(ctx->iformat->name, "mxf") && ctx->nb_streams) {
+        AVRational time_base = ctx->streams[0]->time_base;
+        AVRational edit_unit_tb = av_inv_q(next->resource->base.edit_rate);
+
+        if (ff_mxf_get_edit_unit_offset(ctx, 0, av_rescale_q(next->entry_point, edit_unit_tb, time_base), &pos) < 0)
+            pos = 0;
+        else if (ff_mxf_get_edit_unit_offset(ctx, 0,
+                     av_rescale_q((int64_t)next->entry_point + next->duration, edit_unit_tb, time_base), &end) >= 0
+                 && end > pos)
+            size = FFMIN(size, end - pos);
+    }
+#endif
+    if (ctx && ctx->pb && !track_file->parked) {
+        ret = ffio_prefetch(ctx->pb, pos, size);
+    } else {
+        proto = avio_find_protocol_name(next->locator->absolute_uri);
+        ret = AVERROR(ENOSYS);
+        if (proto && !strcmp(proto, "file")) {
+            av_dict_copy(&opts, c->avio_opts, 0);
+            if ((ret = s->io_open(s, &pb, next->locator->absolute_uri, AVIO_FLAG_READ, &opts)) >= 0) {
+                ret = ffio_prefetch(pb, pos, size);
+                ff_format_io_close(s, &pb);
+            }
+            av_dict_free(&opts);
+        }
     }
+    ff_mutex_unlock(&c->track_files_lock);
 
     av_log(s,
         AV_LOG_DEBUG,
-        "Found locator for " FF_UUID_FORMAT ": %s\n",
-        UID_ARG(asset_locator->uuid),
-        asset_locator->absolute_uri);
-    tmp = av_fast_realloc(track->resources,
-        &track->resources_alloc_sz,
-        (track->resource_count + track_file_resource->base.repeat_count)
-            * sizeof(IMFVirtualTrackResourcePlaybackCtx));
-    if (!tmp)
-        return AVERROR(ENOMEM);
-    track->resources = tmp;
+        "Prefetch %" PRId64 " bytes at %" PRId64 " of %s for resource %" PRIu32 " of track %d: %s\n",
+        size,
+        pos,
+        next->locator->absolute_uri,
+        index,
+        track->index,
+        ret < 0 ? av_err2str(ret) : "ok");
+}
 
-    for (uint32_t i = 0; i < track_file_resource->base.repeat_count; ++i) {
-        vt_ctx.locator = asset_locator;
-        vt_ctx.resource = track_file_resource;
-        vt_ctx.ctx = NULL;
-        if ((ret = open_track_resource_context(s, &vt_ctx)) != 0)
-            return ret;
-        track->resources[track->resource_count++] = vt_ctx;
-        track->duration = av_add_q(track->duration,
-            av_make_q((int)track_file_resource->base.duration * track_file_resource->base.edit_rate.den,
-                track_file_resource->base.edit_rate.num));
+/**
+ * Reads the next packet from the track file of a resource. Outside of PCM
+ * tracks, whose packets are coalesced instead, up to track->batch_size
+ * packets are read at once, without going past the end of the resource.
+ */
+static int read_resource_packet(AVFormatContext *s,
+    IMFVirtualTrackPlaybackCtx *track,
+    IMFVirtualTrackResourcePlaybackCtx *resource,
+    AVPacket *pkt)
+{
+    int64_t remaining;
+    int ret;
+
+    if (track->batch_pos < track->batch_nb) {
+        av_packet_move_ref(pkt, track->batch_pkts[track->batch_pos++]);
+        return 0;
     }
 
-    return ret;
-}
+    remaining = resource->start_edit_unit + resource->duration - get_track_current_edit_unit(s, track);
+    if (FFMIN(track->batch_size, remaining) <= 1 || track_is_pcm(s, track))
+        return av_read_frame(resource->track_file->ctx, pkt);
 
-static void imf_virtual_track_playback_context_deinit(IMFVirtualTrackPlaybackCtx *track)
-{
-    for (uint32_t i = 0; i < track->resource_count; ++i)
-        if (track->resources[i].ctx && track->resources[i].ctx->iformat)
-            avformat_close_input(&track->resources[i].ctx);
+    remaining = FFMIN3(track->batch_size, IMF_READ_BATCH, remaining);
+    for (int i = 0; i < remaining; i++)
+        if (!track->batch_pkts[i] && !(track->batch_pkts[i] = av_packet_alloc()))
+            return AVERROR(ENOMEM);
+    ret = av_read_frames(resource->track_file->ctx, track->batch_pkts, remaining, 0);
+    if (ret < 0)
+        return ret;
+    av_packet_move_ref(pkt, track->batch_pkts[0]);
+    track->batch_pos = 1;
+    track->batch_nb = ret;
 
-    av_freep(&track->resources);
+    return 0;
 }
 
-static int open_virtual_track(AVFormatContext *s,
-    FFIMFTrackFileVirtualTrack *virtual_track,
-    int32_t track_index)
+static int read_track_packet(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track, AVPacket *pkt)
 {
     IMFContext *c = s->priv_data;
-    IMFVirtualTrackPlaybackCtx *track = NULL;
-    void *tmp;
+    IMFVirtualTrackResourcePlaybackCtx *resource_to_read = NULL;
     int ret = 0;
+    int64_t start_time;
 
-    if (!(track = av_mallocz(sizeof(IMFVirtualTrackPlaybackCtx))))
-        return AVERROR(ENOMEM);
-    track->index = track_index;
-    track->duration = av_make_q(0, 1);
+    if (track->current_timestamp >= track->duration)
+        return AVERROR_EOF;
 
-    for (uint32_t i = 0; i < virtual_track->resource_count; i++) {
+    resource_to_read = get_resource_context_for_timestamp(s, track);
+
+    if (!resource_to_read) {
+        if (get_track_current_edit_unit(s, track) >= get_track_edit_unit_count(track))
+            return AVERROR_EOF;
+
+        av_log(s, AV_LOG_ERROR, "Could not find IMF track resource to read\n");
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+
+    while (!ff_check_interrupt(c->interrupt_callback) && !ret) {
+        start_time = av_gettime_relative();
+        ret = read_resource_packet(s, track, resource_to_read, pkt);
+        track->read_time += av_gettime_relative() - start_time;
         av_log(s,
             AV_LOG_DEBUG,
-            "Open stream from file " FF_UUID_FORMAT ", stream %d\n",
-            UID_ARG(virtual_track->resources[i].track_file_uuid),
-            i);
-        if ((ret = open_track_file_resource(s, &virtual_track->resources[i], track)) != 0) {
+            "Got packet: pts=%" PRId64
+            ", dts=%" PRId64
+            ", duration=%" PRId64
+            ", stream_index=%d, pos=%" PRId64
+            "\n",
+            pkt->pts,
+            pkt->dts,
+            pkt->duration,
+            pkt->stream_index,
+            pkt->pos);
+        if (ret >= 0 && pkt->stream_index) {
+            /* from a stream that is not discarded by the demuxer */
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (ret >= 0) {
+            if (c->export_content_ids && !track_is_pcm(s, track) && pkt->pts != AV_NOPTS_VALUE
+                && (ret = add_content_id(resource_to_read, pkt->pts, pkt)) < 0) {
+                av_packet_unref(pkt);
+                return ret;
+            }
+
+            update_track_cursors(s, track, resource_to_read->track_file->ctx->streams[0], pkt);
+
+            if (c->audio_edit_units_per_packet > 1 && track_is_pcm(s, track)
+                && (ret = coalesce_track_packets(s, track, resource_to_read, pkt)) < 0) {
+                av_log(s,
+                    AV_LOG_ERROR,
+                    "Could not coalesce packets of track %d: %s\n",
+                    track->index,
+                    av_err2str(ret));
+                av_packet_unref(pkt);
+                return ret;
+            }
+
+            track->packet_count++;
+            track->byte_count += pkt->size;
+
+            if (c->prefetch_size)
+                prefetch_next_resource(s, track);
+
+            return 0;
+        } else if (ret != AVERROR_EOF) {
             av_log(s,
                 AV_LOG_ERROR,
-                "Could not open image track resource " FF_UUID_FORMAT "\n",
-                UID_ARG(virtual_track->resources[i].track_file_uuid));
-            goto clean_up;
+                "Could not get packet from track %d: %s\n",
+                track->index,
+                av_err2str(ret));
+            return ret;
         }
     }
 
-    track->current_timestamp = av_make_q(0, track->duration.den);
+    return AVERROR_EOF;
+}
+
+#if HAVE_THREADS
+static void read_ahead_msg_free(void *msg)
+{
+    av_packet_free(&((IMFReadAheadMsg *)msg)->pkt);
+}
 
-    tmp = av_realloc(c->tracks, (c->track_count + 1) * sizeof(IMFVirtualTrackPlaybackCtx *));
-    if (!tmp) {
-        ret = AVERROR(ENOMEM);
-        goto clean_up;
+static void *read_ahead_thread(void *arg)
+{
+    IMFVirtualTrackPlaybackCtx *track = arg;
+    IMFReadAheadMsg msg;
+
+    for (;;) {
+        msg.timestamp = track->current_timestamp;
+        if (!(msg.pkt = av_packet_alloc())) {
+            msg.ret = AVERROR(ENOMEM);
+            break;
+        }
+        if ((msg.ret = read_track_packet(track->read_ahead_avf, track, msg.pkt)) < 0) {
+            av_packet_free(&msg.pkt);
+            break;
+        }
+        /* fails when the demuxer stops the thread */
+        if (av_thread_message_queue_send(track->read_ahead_queue, &msg, 0) < 0) {
+            av_packet_free(&msg.pkt);
+            return NULL;
+        }
     }
-    c->tracks = tmp;
-    c->tracks[c->track_count++] = track;
 
-    return 0;
+    /* the end of the track is the last message */
+    msg.timestamp = track->current_timestamp;
+    av_thread_message_queue_send(track->read_ahead_queue, &msg, 0);
 
-clean_up:
-    imf_virtual_track_playback_context_deinit(track);
-    av_free(track);
-    return ret;
+    return NULL;
 }
 
-static int set_context_streams_from_tracks(AVFormatContext *s)
+/**
+ * Stops the worker threads of the tracks and discards the packets they read.
+ * The track cursors are left past the last returned packet, so a seek must
+ * follow unless the demuxer is closed.
+ */
+static void stop_read_ahead(AVFormatContext *s)
 {
     IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track;
 
-    AVStream *asset_stream;
-    AVStream *first_resource_stream;
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        if (!track->read_ahead_thread_running)
+            continue;
+        av_thread_message_queue_set_err_send(track->read_ahead_queue, AVERROR_EXIT);
+        pthread_join(track->read_ahead_thread, NULL);
+        track->read_ahead_thread_running = 0;
+        av_thread_message_flush(track->read_ahead_queue);
+        av_packet_free(&track->read_ahead_head.pkt);
+    }
+    c->read_ahead_started = 0;
+}
 
-    int ret = 0;
+/**
+ * Starts a worker thread per track, which reads up to read_ahead packets in
+ * advance, and waits for the first packet of each track.
+ */
+static int start_read_ahead(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track;
+    int ret;
 
-    for (uint32_t i = 0; i < c->track_count; ++i) {
-        /* Open the first resource of the track to get stream information */
-        first_resource_stream = c->tracks[i]->resources[0].ctx->streams[0];
-        av_log(s, AV_LOG_DEBUG, "Open the first resource of track %d\n", c->tracks[i]->index);
+    /* the discard setting of the streams is applied until the next seek */
+    if ((ret = update_track_discard(s)) < 0)
+        return ret;
 
-        /* Copy stream information */
-        asset_stream = avformat_new_stream(s, NULL);
-        if (!asset_stream) {
-            av_log(s, AV_LOG_ERROR, "Could not create stream\n");
-            break;
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        if (track->discard) {
+            track->read_ahead_head.pkt = NULL;
+            track->read_ahead_head.ret = AVERROR_EOF;
+            continue;
         }
-        asset_stream->id = i;
-        ret = avcodec_parameters_copy(asset_stream->codecpar, first_resource_stream->codecpar);
-        if (ret < 0) {
-            av_log(s, AV_LOG_ERROR, "Could not copy stream parameters\n");
-            break;
+        if (!track->read_ahead_queue) {
+            ret = av_thread_message_queue_alloc2(&track->read_ahead_queue, c->read_ahead, sizeof(IMFReadAheadMsg),
+                                                 AV_THREAD_MESSAGE_QUEUE_SPSC);
+            if (ret < 0)
+                goto fail;
+            av_thread_message_queue_set_free_func(track->read_ahead_queue, read_ahead_msg_free);
         }
-        avpriv_set_pts_info(asset_stream,
-            first_resource_stream->pts_wrap_bits,
-            first_resource_stream->time_base.num,
-            first_resource_stream->time_base.den);
-        asset_stream->duration = (int64_t)av_q2d(av_mul_q(c->tracks[i]->duration,
-            av_inv_q(asset_stream->time_base)));
+        av_thread_message_queue_set_err_send(track->read_ahead_queue, 0);
+        track->read_ahead_avf = s;
+        ret = pthread_create(&track->read_ahead_thread, NULL, read_ahead_thread, track);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "Could not create read-ahead thread: %s\n", av_err2str(AVERROR(ret)));
+            ret = AVERROR(ret);
+            goto fail;
+        }
+        track->read_ahead_thread_running = 1;
+    }
+
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        if (!track->read_ahead_thread_running)
+            continue;
+        ret = av_thread_message_queue_recv(track->read_ahead_queue, &track->read_ahead_head, 0);
+        if (ret < 0)
+            goto fail;
     }
+    c->read_ahead_started = 1;
+    track_heap_rebuild(s);
 
+    return 0;
+
+fail:
+    stop_read_ahead(s);
     return ret;
 }
 
-static int open_cpl_tracks(AVFormatContext *s)
+static int read_ahead_packet(AVFormatContext *s, AVPacket *pkt)
 {
     IMFContext *c = s->priv_data;
-    int32_t track_index = 0;
+    IMFVirtualTrackPlaybackCtx *track;
     int ret;
 
-    if (c->cpl->main_image_2d_track)
-        if ((ret = open_virtual_track(s, c->cpl->main_image_2d_track, track_index++)) != 0) {
-            av_log(s,
-                AV_LOG_ERROR,
-                "Could not open image track " FF_UUID_FORMAT "\n",
-                UID_ARG(c->cpl->main_image_2d_track->base.id_uuid));
-            return ret;
-        }
+    if (!c->read_ahead_started && (ret = start_read_ahead(s)) < 0)
+        return ret;
 
-    for (uint32_t i = 0; i < c->cpl->main_audio_track_count; ++i)
-        if ((ret = open_virtual_track(s, &c->cpl->main_audio_tracks[i], track_index++)) != 0) {
-            av_log(s,
-                AV_LOG_ERROR,
-                "Could not open audio track " FF_UUID_FORMAT "\n",
-                UID_ARG(c->cpl->main_audio_tracks[i].base.id_uuid));
-            return ret;
-        }
+    /* the track with the minimum timestamp is at the top of the heap */
+    track = c->track_heap[0];
+
+    if (!track->read_ahead_head.pkt)
+        return track->read_ahead_head.ret;
+
+    av_packet_move_ref(pkt, track->read_ahead_head.pkt);
+    av_packet_free(&track->read_ahead_head.pkt);
+
+    ret = av_thread_message_queue_recv(track->read_ahead_queue, &track->read_ahead_head, 0);
+    if (ret < 0) {
+        track->read_ahead_head.pkt = NULL;
+        track->read_ahead_head.ret = ret;
+    }
+    update_track_heap_timestamp(s, track);
+    track_heap_sift_down(c, 0);
 
-    return set_context_streams_from_tracks(s);
+    return 0;
 }
+#endif
 
-static int imf_read_header(AVFormatContext *s)
+static int imf_read_seek2(AVFormatContext *s,
+    int stream_index,
+    int64_t min_ts,
+    int64_t ts,
+    int64_t max_ts,
+    int flags);
+
+/**
+ * Checks whether the next packet is read from the same track as the previous
+ * one, to read contiguous data from the track file. A run of packets of a
+ * track lasts at most interleave_window, so that the packets returned are
+ * never more than interleave_window ahead of the other tracks, and holds at
+ * most interleave_bytes of data.
+ */
+static int track_run_continues(AVFormatContext *s, IMFVirtualTrackPlaybackCtx *track)
 {
     IMFContext *c = s->priv_data;
-    char *asset_map_path;
-    char *tmp_str;
-    int ret = 0;
 
-    c->interrupt_callback = &s->interrupt_callback;
-    tmp_str = av_strdup(s->url);
-    if (!tmp_str) {
-        ret = AVERROR(ENOMEM);
-        return ret;
-    }
-    c->base_url = av_dirname(tmp_str);
-    if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
-        return ret;
+    if (!c->interleave_window || track->current_timestamp >= track->duration)
+        return 0;
+    if (c->interleave_bytes && c->run_bytes >= c->interleave_bytes)
+        return 0;
 
-    av_log(s, AV_LOG_DEBUG, "start parsing IMF CPL: %s\n", s->url);
+    return track->heap_timestamp - c->run_start < av_rescale_q(c->interleave_window, AV_TIME_BASE_Q, c->time_base);
+}
 
-    if ((ret = ff_parse_imf_cpl(s->pb, &c->cpl)) < 0)
-        return ret;
+static int imf_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track;
+    int ret;
 
-    av_log(s,
-        AV_LOG_DEBUG,
-        "parsed IMF CPL: " FF_UUID_FORMAT "\n",
-        UID_ARG(c->cpl->id_uuid));
+    if (!c->track_count)
+        return AVERROR_EOF;
 
-    if (!c->asset_map_paths) {
-        c->asset_map_paths = av_append_path_component(c->base_url, "ASSETMAP.xml");
-        if (!c->asset_map_paths) {
-            ret = AVERROR(ENOMEM);
+    /* start at the marker requested with imf_seek_marker */
+    if (c->seek_marker_ts != AV_NOPTS_VALUE) {
+        int64_t ts = c->seek_marker_ts;
+
+        c->seek_marker_ts = AV_NOPTS_VALUE;
+        av_log(s, AV_LOG_DEBUG, "Seek to marker %s\n", c->seek_marker);
+        if ((ret = imf_read_seek2(s, -1, INT64_MIN, ts, INT64_MAX, 0)) < 0)
             return ret;
-        }
-        av_log(s, AV_LOG_DEBUG, "No asset maps provided, using the default ASSETMAP.xml\n");
     }
 
-    /* Parse each asset map XML file */
-    imf_asset_locator_map_init(&c->asset_locator_map);
-    asset_map_path = av_strtok(c->asset_map_paths, ",", &tmp_str);
-    while (asset_map_path != NULL) {
-        av_log(s, AV_LOG_DEBUG, "start parsing IMF Asset Map: %s\n", asset_map_path);
+#if HAVE_THREADS
+    if (c->read_ahead)
+        return read_ahead_packet(s, pkt);
+#endif
 
-        if (ret = parse_assetmap(s, asset_map_path, NULL))
-            return ret;
+    if ((ret = update_track_discard(s)) < 0)
+        return ret;
 
-        asset_map_path = av_strtok(NULL, ",", &tmp_str);
+    /* the track with the minimum timestamp is at the top of the heap, unless
+     * a run of packets of the track at the top is being read */
+    track = c->track_heap[0];
+    if (track->discard)
+        return AVERROR_EOF;
+    if (c->run_start == AV_NOPTS_VALUE) {
+        c->run_start = track->heap_timestamp;
+        c->run_bytes = 0;
     }
 
-    av_log(s, AV_LOG_DEBUG, "parsed IMF Asset Maps\n");
-
-    if (ret = open_cpl_tracks(s))
+    if ((ret = read_track_packet(s, track, pkt)) < 0)
         return ret;
 
-    av_log(s, AV_LOG_DEBUG, "parsed IMF package\n");
+    update_track_heap_timestamp(s, track);
+    c->run_bytes += pkt->size;
+    if (!track_run_continues(s, track)) {
+        track_heap_sift_down(c, 0);
+        c->run_start = AV_NOPTS_VALUE;
+    }
 
     return 0;
 }
 
-static IMFVirtualTrackPlaybackCtx *get_next_track_with_minimum_timestamp(AVFormatContext *s)
+static int imf_read_packets(AVFormatContext *s, AVPacket **pkts, int *nb_pkts, int64_t max_size)
 {
     IMFContext *c = s->priv_data;
-    IMFVirtualTrackPlaybackCtx *track;
+    int64_t size = 0;
+    int n, ret = 0;
 
-    AVRational minimum_timestamp = av_make_q(INT32_MAX, 1);
-    for (uint32_t i = 0; i < c->track_count; ++i) {
-        av_log(
-            s,
-            AV_LOG_DEBUG,
-            "Compare track %d timestamp " AVRATIONAL_FORMAT
-            " to minimum " AVRATIONAL_FORMAT
-            " (over duration: " AVRATIONAL_FORMAT
-            ")\n",
-            i,
-            AVRATIONAL_ARG(c->tracks[i]->current_timestamp),
-            AVRATIONAL_ARG(minimum_timestamp),
-            AVRATIONAL_ARG(c->tracks[i]->duration));
-        if (av_cmp_q(c->tracks[i]->current_timestamp, minimum_timestamp) < 0) {
-            track = c->tracks[i];
-            minimum_timestamp = track->current_timestamp;
+    /* the track files are read in batches too, unless the tracks are read
+     * by the read-ahead threads */
+    if (!c->read_ahead)
+        for (uint32_t i = 0; i < c->track_count; ++i)
+            c->tracks[i]->batch_size = *nb_pkts;
+
+    for (n = 0; n < *nb_pkts && (max_size <= 0 || size < max_size); n++) {
+        if ((ret = imf_read_packet(s, pkts[n])) < 0) {
+            av_packet_unref(pkts[n]);
+            break;
         }
+        size += pkts[n]->size;
     }
+    *nb_pkts = n;
 
-    av_log(s,
-        AV_LOG_DEBUG,
-        "Found next track to read: %d (timestamp: %lf / %lf)\n",
-        track->index,
-        av_q2d(track->current_timestamp),
-        av_q2d(minimum_timestamp));
-    return track;
-}
-
-static IMFVirtualTrackResourcePlaybackCtx *get_resource_context_for_timestamp(AVFormatContext *s,
-    IMFVirtualTrackPlaybackCtx *track)
-{
-    AVRational edit_unit_duration = av_inv_q(track->resources[0].resource->base.edit_rate);
-    AVRational cumulated_duration = av_make_q(0, edit_unit_duration.den);
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        c->tracks[i]->batch_size = 0;
 
-    av_log(s,
-        AV_LOG_DEBUG,
-        "Looking for track %d resource for timestamp = %lf / %lf\n",
-        track->index,
-        av_q2d(track->current_timestamp),
-        av_q2d(track->duration));
-    for (uint32_t i = 0; i < track->resource_count; ++i) {
-        cumulated_duration = av_add_q(cumulated_duration,
-            av_make_q((int)track->resources[i].resource->base.duration * edit_unit_duration.num,
-                edit_unit_duration.den));
-
-        if (av_cmp_q(av_add_q(track->current_timestamp, edit_unit_duration), cumulated_duration) <= 0) {
-            av_log(s,
-                AV_LOG_DEBUG,
-                "Found resource %d in track %d to read for timestamp %lf "
-                "(on cumulated=%lf): entry=%" PRIu32
-                ", duration=%" PRIu32
-                ", editrate=" AVRATIONAL_FORMAT
-                " | edit_unit_duration=%lf\n",
-                i,
-                track->index,
-                av_q2d(track->current_timestamp),
-                av_q2d(cumulated_duration),
-                track->resources[i].resource->base.entry_point,
-                track->resources[i].resource->base.duration,
-                AVRATIONAL_ARG(track->resources[i].resource->base.edit_rate),
-                av_q2d(edit_unit_duration));
-
-            if (track->current_resource_index != i) {
-                av_log(s,
-                    AV_LOG_DEBUG,
-                    "Switch resource on track %d: re-open context\n",
-                    track->index);
-                avformat_close_input(&(track->resources[track->current_resource_index].ctx));
-                if (open_track_resource_context(s, &(track->resources[i])) != 0)
-                    return NULL;
-                track->current_resource_index = i;
-            }
-            return &(track->resources[track->current_resource_index]);
-        }
-    }
-    return NULL;
+    return ret;
 }
 
-static int imf_read_packet(AVFormatContext *s, AVPacket *pkt)
+static int imf_read_seek2(AVFormatContext *s,
+    int stream_index,
+    int64_t min_ts,
+    int64_t ts,
+    int64_t max_ts,
+    int flags)
 {
     IMFContext *c = s->priv_data;
-    IMFVirtualTrackResourcePlaybackCtx *resource_to_read = NULL;
-    AVRational edit_unit_duration;
-    int ret = 0;
     IMFVirtualTrackPlaybackCtx *track;
-    FFStream *track_stream;
+    AVRational time_base = AV_TIME_BASE_Q;
+    AVRational edit_rate;
+    AVRational target;
+    int64_t edit_unit;
+    int ret;
 
-    track = get_next_track_with_minimum_timestamp(s);
+    if (flags & AVSEEK_FLAG_BYTE)
+        return AVERROR(ENOSYS);
 
-    if (av_cmp_q(track->current_timestamp, track->duration) == 0)
-        return AVERROR_EOF;
+    if (stream_index >= 0)
+        time_base = s->streams[stream_index]->time_base;
+    track = c->tracks[stream_index >= 0 ? stream_index : 0];
 
-    resource_to_read = get_resource_context_for_timestamp(s, track);
+    /* every edit unit of IMF essence is a random access point: round the
+     * target to the edit unit of the reference track that contains it */
+    edit_rate = track->resources[0].resource->base.edit_rate;
+    edit_unit = av_rescale_rnd(ts,
+        (int64_t)time_base.num * edit_rate.num,
+        (int64_t)time_base.den * edit_rate.den,
+        AV_ROUND_DOWN);
+    if (av_rescale_q(edit_unit, av_inv_q(edit_rate), time_base) < min_ts)
+        edit_unit++;
+    if (av_rescale_q(edit_unit, av_inv_q(edit_rate), time_base) > max_ts)
+        return AVERROR(EINVAL);
+    target = av_mul_q(av_make_q(FFMAX(edit_unit, 0), 1), av_inv_q(edit_rate));
 
-    if (!resource_to_read) {
-        edit_unit_duration = av_inv_q(track->resources[track->current_resource_index].resource->base.edit_rate);
-        if (av_cmp_q(av_add_q(track->current_timestamp, edit_unit_duration),
-                track->duration)
-            > 0)
-            return AVERROR_EOF;
+    av_log(s, AV_LOG_DEBUG, "Seek to %lf s\n", av_q2d(target));
 
-        av_log(s, AV_LOG_ERROR, "Could not find IMF track resource to read\n");
-        return AVERROR_STREAM_NOT_FOUND;
+#if HAVE_THREADS
+    /* the worker threads are restarted at the next read */
+    stop_read_ahead(s);
+#endif
+
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        /* discarded tracks are positioned when they are read again */
+        if (track->discard)
+            continue;
+
+        edit_rate = track->resources[0].resource->base.edit_rate;
+        edit_unit = av_rescale_rnd(target.num,
+            edit_rate.num,
+            (int64_t)target.den * edit_rate.den,
+            AV_ROUND_DOWN);
+
+        if ((ret = seek_track(s, track, edit_unit)) < 0)
+            return ret;
     }
 
-    while (!ff_check_interrupt(c->interrupt_callback) && !ret) {
-        ret = av_read_frame(resource_to_read->ctx, pkt);
-        av_log(s,
-            AV_LOG_DEBUG,
-            "Got packet: pts=%" PRId64
-            ", dts=%" PRId64
-            ", duration=%" PRId64
-            ", stream_index=%d, pos=%" PRId64
-            "\n",
-            pkt->pts,
-            pkt->dts,
-            pkt->duration,
-            pkt->stream_index,
-            pkt->pos);
-        track_stream = ffstream(s->streams[track->index]);
-        if (ret >= 0) {
-            /* Update packet info from track */
-            if (pkt->dts < track_stream->cur_dts && track->last_pts > 0)
-                pkt->dts = track_stream->cur_dts;
+    track_heap_rebuild(s);
+    c->run_start = AV_NOPTS_VALUE;
+
+    return 0;
+}
 
-            pkt->pts = track->last_pts;
-            pkt->dts = pkt->dts
-                - (int64_t)track->resources[track->current_resource_index].resource->base.entry_point;
-            pkt->stream_index = track->index;
+/**
+ * Logs the statistics of the tracks and of their track files.
+ */
+static void log_track_stats(AVFormatContext *s)
+{
+    IMFContext *c = s->priv_data;
+    IMFVirtualTrackPlaybackCtx *track;
+    IMFTrackFileCtx *track_file;
+    uint32_t j;
 
-            /* Update track cursors */
-            track->current_timestamp = av_add_q(track->current_timestamp,
-                av_make_q((int)pkt->duration * resource_to_read->ctx->streams[0]->time_base.num,
-                    resource_to_read->ctx->streams[0]->time_base.den));
-            track->last_pts += pkt->duration;
+    for (uint32_t i = 0; i < c->track_count; ++i) {
+        track = c->tracks[i];
+        av_log(s,
+            AV_LOG_INFO,
+            "Track %d: %" PRId64 " packets, %" PRId64 " bytes, %.3f s reading, %d resource switches\n",
+            track->index,
+            track->packet_count,
+            track->byte_count,
+            track->read_time / 1e6,
+            track->resource_switches);
 
-            return 0;
-        } else if (ret != AVERROR_EOF) {
+        for (uint32_t k = 0; k < track->resource_count; ++k) {
+            track_file = track->resources[k].track_file;
+            /* report each track file once */
+            for (j = 0; j < k; ++j)
+                if (track->resources[j].track_file == track_file)
+                    break;
+            if (j < k)
+                continue;
             av_log(s,
-                AV_LOG_ERROR,
-                "Could not get packet from track %d: %s\n",
-                track->index,
-                av_err2str(ret));
-            return ret;
+                AV_LOG_INFO,
+                "  %s: %d opens (%.3f s), %d reattaches, %.3f s probing, %d seeks (%.3f s)\n",
+                track->resources[k].locator->absolute_uri,
+                track_file->opens,
+                track_file->open_time / 1e6,
+                track_file->reattaches,
+                track_file->probe_time / 1e6,
+                track_file->seeks,
+                track_file->seek_time / 1e6);
         }
     }
-
-    return AVERROR_EOF;
 }
 
 static int imf_close(AVFormatContext *s)
@@ -806,17 +4191,43 @@ static int imf_close(AVFormatContext *s)
     IMFContext *c = s->priv_data;
 
     av_log(s, AV_LOG_DEBUG, "Close IMF package\n");
+    for (int i = 0; i < c->nb_asset_map_fetches; i++)
+        free_fetch(&c->asset_map_fetches[i]);
+    av_freep(&c->asset_map_fetches);
+#if HAVE_THREADS
+    stop_read_ahead(s);
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        av_thread_message_queue_free(&c->tracks[i]->read_ahead_queue);
+#endif
+    for (uint32_t i = 0; i < c->track_count; ++i)
+        wait_preopen(s, c->tracks[i]);
+    if (c->stats)
+        log_track_stats(s);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
     imf_asset_locator_map_deinit(&c->asset_locator_map);
+    for (unsigned i = 0; i < c->asset_map_cache_entry_count; ++i)
+        asset_map_cache_release(c->asset_map_cache_entries[i]);
+    av_freep(&c->asset_map_cache_entries);
     ff_imf_cpl_free(c->cpl);
 
     for (uint32_t i = 0; i < c->track_count; ++i) {
-        imf_virtual_track_playback_context_deinit(c->tracks[i]);
+        imf_virtual_track_playback_context_deinit(c, c->tracks[i]);
         av_freep(&c->tracks[i]);
     }
 
     av_freep(&c->tracks);
+    av_freep(&c->track_files);
+    av_freep(&c->track_heap);
+
+    /* after the track files are closed, with everything they read hashed */
+    if (c->verify_hashes)
+        verify_asset_hashes(s);
+    imf_packing_list_deinit(&c->packing_list);
+
+    imf_io_pool_free(c);
+    ff_mutex_destroy(&c->io_pool_lock);
+    ff_mutex_destroy(&c->track_files_lock);
 
     return 0;
 }
@@ -832,6 +4243,309 @@ static const AVOption imf_options[] = {
         .default_val = {.str = NULL},
         .flags       = AV_OPT_FLAG_DECODING_PARAM,
     },
+    {
+        .name        = "assetmap_cache",
+        .help        = "Share the parsed asset maps with the other instances of the demuxer in the process.",
+        .offset      = offsetof(IMFContext, assetmap_cache),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "concurrent_fetch",
+        .help        = "Fetch the asset maps and packing lists concurrently, while the CPL is parsed.",
+        .offset      = offsetof(IMFContext, concurrent_fetch),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 1},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_start",
+        .help        = "Start of the timeline window, in edit units or as a timecode.",
+        .offset      = offsetof(IMFContext, window_start_str),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_end",
+        .help        = "End of the timeline window (exclusive), in edit units or as a timecode.",
+        .offset      = offsetof(IMFContext, window_end_str),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_track",
+        .help        = "TrackId of the only virtual track to present, e.g. urn:uuid:...",
+        .offset      = offsetof(IMFContext, track_id_str),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_seek_marker",
+        .help        = "Label of the marker of the composition at which to start reading, e.g. FFOC.",
+        .offset      = offsetof(IMFContext, seek_marker),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "preopen_tracks",
+        .help        = "Comma-separated indices of the tracks whose next resource is opened in the background "
+                       "while the current one is read, or `all`.",
+        .offset      = offsetof(IMFContext, preopen_tracks),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "max_open_resources",
+        .help        = "Maximum number of track files open at once, the least recently used one that no track "
+                       "reads being closed beyond it (0 for no limit).",
+        .offset      = offsetof(IMFContext, max_open_resources),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "max_parked_resources",
+        .help        = "Maximum number of track files that are no longer read whose parsed header is kept, "
+                       "so that reading them again does not parse them again (0 to close them).",
+        .offset      = offsetof(IMFContext, max_parked_resources),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 8},
+        .min         = 0,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_open_threads",
+        .help        = "Open all resources when reading the header, using the specified number of threads "
+                       "(0 to open resources on demand).",
+        .offset      = offsetof(IMFContext, open_threads),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "read_ahead",
+        .help        = "Number of packets read in advance on a worker thread per track (0 to read packets on demand).",
+        .offset      = offsetof(IMFContext, read_ahead),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_prefetch_size",
+        .help        = "Size of the data at the start of the next resource of a track that the storage is asked to prefetch "
+                       "before the end of the current one (0 to disable).",
+        .offset      = offsetof(IMFContext, prefetch_size),
+        .type        = AV_OPT_TYPE_INT64,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT64_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_prefetch_lead",
+        .help        = "Time before the end of a resource at which the start of the next one is prefetched.",
+        .offset      = offsetof(IMFContext, prefetch_lead),
+        .type        = AV_OPT_TYPE_DURATION,
+        .default_val = {.i64 = 2000000},
+        .min         = 0,
+        .max         = INT64_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_interleave_window",
+        .help        = "Maximum duration of the runs of packets read from one track before switching to another (0 to interleave packet by packet).",
+        .offset      = offsetof(IMFContext, interleave_window),
+        .type        = AV_OPT_TYPE_DURATION,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT64_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_interleave_bytes",
+        .help        = "Maximum size of the runs of packets read from one track (0 for no limit).",
+        .offset      = offsetof(IMFContext, interleave_bytes),
+        .type        = AV_OPT_TYPE_INT64,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT64_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "audio_edit_units_per_packet",
+        .help        = "Number of contiguous edit units of PCM audio returned in each packet.",
+        .offset      = offsetof(IMFContext, audio_edit_units_per_packet),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 1},
+        .min         = 1,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_stats",
+        .help        = "Log per-track reading statistics when closing the demuxer.",
+        .offset      = offsetof(IMFContext, stats),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "export_resources",
+        .help        = "Export the edit units at which the resources of each track start as stream metadata.",
+        .offset      = offsetof(IMFContext, export_resources),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "export_map",
+        .help        = "Export the track file, entry point, duration and byte ranges of the resources of each track as stream metadata.",
+        .offset      = offsetof(IMFContext, export_map),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "map_span",
+        .help        = "Number of edit units per byte range of the exported map (0: one range per resource).",
+        .offset      = offsetof(IMFContext, map_span),
+        .type        = AV_OPT_TYPE_INT,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = INT_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "export_content_ids",
+        .help        = "Identify the edit units of the track files read by the packets, to let repeated frames be reused.",
+        .offset      = offsetof(IMFContext, export_content_ids),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "verify_hashes",
+        .help        = "Verify the assets against the hashes of the packing lists, hashing the track files as they are read.",
+        .offset      = offsetof(IMFContext, verify_hashes),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "lazy_index",
+        .help        = "Defer the parsing of the index of the track files to the first seek in them.",
+        .offset      = offsetof(IMFContext, lazy_index),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "follow",
+        .help        = "Read track files that are still being written, waiting for their essence.",
+        .offset      = offsetof(IMFContext, follow),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "follow_timeout",
+        .help        = "Time after which a followed track file that stops growing is considered ended.",
+        .offset      = offsetof(IMFContext, follow_timeout),
+        .type        = AV_OPT_TYPE_DURATION,
+        .default_val = {.i64 = 10000000},
+        .min         = 0,
+        .max         = INT64_MAX,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "http_persistent",
+        .help        = "Keep idle HTTP connections open and reuse them to open the next resources.",
+        .offset      = offsetof(IMFContext, http_persistent),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 1},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_cache_dir",
+        .help        = "Directory where the parsed CPL and asset maps are cached across opens.",
+        .offset      = offsetof(IMFContext, cache_dir),
+        .type        = AV_OPT_TYPE_STRING,
+        .default_val = {.str = NULL},
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "flatten",
+        .help        = "Open the track files for stream copy, without probing them or parsing their packets.",
+        .offset      = offsetof(IMFContext, flatten),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_check",
+        .help        = "Check that all the resources resolve and fit within their track files, reading only the MXF header metadata.",
+        .offset      = offsetof(IMFContext, check),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "imf_header_only",
+        .help        = "Take the stream parameters from the MXF header metadata of the first resource of each track, without probing or opening other resources.",
+        .offset      = offsetof(IMFContext, header_only),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
+    {
+        .name        = "fast_open",
+        .help        = "Only probe the stream information of the first resource of each track.",
+        .offset      = offsetof(IMFContext, fast_open),
+        .type        = AV_OPT_TYPE_BOOL,
+        .default_val = {.i64 = 0},
+        .min         = 0,
+        .max         = 1,
+        .flags       = AV_OPT_FLAG_DECODING_PARAM,
+    },
     {NULL},
 };
 
@@ -848,9 +4562,12 @@ const AVInputFormat ff_imf_demuxer = {
     .flags_internal = FF_FMT_INIT_CLEANUP,
     .priv_class     = &imf_class,
     .priv_data_size = sizeof(IMFContext),
+    .read_probe     = imf_probe,
     .read_header    = imf_read_header,
     .read_packet    = imf_read_packet,
+    .read_packets   = imf_read_packets,
     .read_close     = imf_close,
+    .read_seek2     = imf_read_seek2,
     .extensions     = "xml",
     .mime_type      = "application/xml,text/xml",
 };
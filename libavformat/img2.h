@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include "avformat.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 
 #if HAVE_GLOB
 #include <glob.h>
@@ -38,6 +39,20 @@ enum PatternType {
     PT_DEFAULT
 };
 
+#if HAVE_THREADS
+/**
+ * File of the sequence read in advance by a worker thread
+ */
+typedef struct ImgReadAheadSlot {
+    AVPacket *pkt;
+    char filename[1024];
+    int number;             /**< number of the file in the sequence */
+    int64_t pts;            /**< timestamp of the file, with ts_from_file */
+    int ret;                /**< error reading the file */
+    int state;              /**< ReadAheadState */
+} ImgReadAheadSlot;
+#endif
+
 typedef struct VideoDemuxData {
     const AVClass *class;  /**< Class for private options. */
     int img_first;
@@ -62,6 +77,20 @@ typedef struct VideoDemuxData {
     int frame_size;
     int ts_from_file;
     int export_path_metadata; /**< enabled when set to 1. */
+    int read_ahead;         /**< number of files read in advance, 0 to read each file on demand */
+    int read_threads;       /**< number of threads reading the files in advance */
+#if HAVE_THREADS
+    ImgReadAheadSlot *read_ahead_slots;
+    int read_ahead_head;    /**< slot of the next file to return */
+    int read_ahead_filled;  /**< number of slots in use from the head */
+    int read_ahead_next;    /**< number of the file of the next slot to fill */
+    int read_ahead_started;
+    int read_ahead_exit;
+    pthread_mutex_t read_ahead_lock;
+    pthread_cond_t read_ahead_cond;
+    pthread_t *read_ahead_workers;
+    int nb_read_ahead_workers;
+#endif
 } VideoDemuxData;
 
 typedef struct IdStrMap {
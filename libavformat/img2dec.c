@@ -212,6 +212,11 @@ int ff_img_read_header(AVFormatContext *s1)
         ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
 
+    if (!HAVE_THREADS && s->read_ahead) {
+        av_log(s1, AV_LOG_WARNING, "Read-ahead requires threading support, ignoring read_ahead\n");
+        s->read_ahead = 0;
+    }
+
     if (s->ts_from_file == 2) {
 #if !HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
         av_log(s1, AV_LOG_ERROR, "POSIX.1-2008 not supported, nanosecond file timestamps unavailable\n");
@@ -402,6 +407,258 @@ static int add_filename_as_pkt_side_data(char *filename, AVPacket *pkt) {
     return 0;
 }
 
+static int get_file_pts(VideoDemuxData *s, const char *filename, int64_t *pts)
+{
+    struct stat img_stat;
+
+    if (stat(filename, &img_stat))
+        return AVERROR(EIO);
+    *pts = (int64_t)img_stat.st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    if (s->ts_from_file == 2)
+        *pts = 1000000000 * *pts + img_stat.st_mtim.tv_nsec;
+#endif
+    return 0;
+}
+
+#if HAVE_THREADS
+enum ReadAheadState {
+    SLOT_EMPTY,
+    SLOT_PENDING,
+    SLOT_READING,
+    SLOT_DONE,
+};
+
+static int read_ahead_file(AVFormatContext *s1, ImgReadAheadSlot *slot)
+{
+    VideoDemuxData *s = s1->priv_data;
+    AVIOContext *pb;
+    int64_t size;
+    int ret;
+
+    if (s->ts_from_file && (ret = get_file_pts(s, slot->filename, &slot->pts)) < 0)
+        return ret;
+
+    if (s1->io_open(s1, &pb, slot->filename, AVIO_FLAG_READ, NULL) < 0) {
+        av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n", slot->filename);
+        return AVERROR(EIO);
+    }
+    size = avio_size(pb);
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = size < 0 ? size : AVERROR(ERANGE);
+    } else {
+        ret = av_get_packet(pb, slot->pkt, size);
+        if (!ret)
+            ret = AVERROR_EOF;
+        slot->pkt->pos = -1;
+    }
+    ff_format_io_close(s1, &pb);
+    return ret;
+}
+
+static void *read_ahead_worker(void *arg)
+{
+    AVFormatContext *s1 = arg;
+    VideoDemuxData *s = s1->priv_data;
+    ImgReadAheadSlot *slot;
+    int ret;
+
+    pthread_mutex_lock(&s->read_ahead_lock);
+    for (;;) {
+        /* the pending file closest to the head is read first */
+        slot = NULL;
+        for (int i = 0; i < s->read_ahead_filled && !slot; i++) {
+            ImgReadAheadSlot *cur = &s->read_ahead_slots[(s->read_ahead_head + i) % s->read_ahead];
+            if (cur->state == SLOT_PENDING)
+                slot = cur;
+        }
+        if (s->read_ahead_exit)
+            break;
+        if (!slot) {
+            pthread_cond_wait(&s->read_ahead_cond, &s->read_ahead_lock);
+            continue;
+        }
+
+        slot->state = SLOT_READING;
+        pthread_mutex_unlock(&s->read_ahead_lock);
+        ret = read_ahead_file(s1, slot);
+        pthread_mutex_lock(&s->read_ahead_lock);
+        slot->ret   = ret;
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&s->read_ahead_cond);
+    }
+    pthread_mutex_unlock(&s->read_ahead_lock);
+
+    return NULL;
+}
+
+static void stop_read_ahead(VideoDemuxData *s)
+{
+    if (!s->read_ahead_started)
+        return;
+
+    pthread_mutex_lock(&s->read_ahead_lock);
+    s->read_ahead_exit = 1;
+    pthread_cond_broadcast(&s->read_ahead_cond);
+    pthread_mutex_unlock(&s->read_ahead_lock);
+    for (int i = 0; i < s->nb_read_ahead_workers; i++)
+        pthread_join(s->read_ahead_workers[i], NULL);
+    av_freep(&s->read_ahead_workers);
+    s->nb_read_ahead_workers = 0;
+
+    for (int i = 0; i < s->read_ahead; i++)
+        av_packet_free(&s->read_ahead_slots[i].pkt);
+    av_freep(&s->read_ahead_slots);
+    pthread_cond_destroy(&s->read_ahead_cond);
+    pthread_mutex_destroy(&s->read_ahead_lock);
+    s->read_ahead_started = 0;
+}
+
+static int start_read_ahead(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    int nb_workers = FFMIN(s->read_threads, s->read_ahead);
+    int ret;
+
+    s->read_ahead_slots = av_calloc(s->read_ahead, sizeof(*s->read_ahead_slots));
+    s->read_ahead_workers = av_calloc(nb_workers, sizeof(*s->read_ahead_workers));
+    if (!s->read_ahead_slots || !s->read_ahead_workers) {
+        av_freep(&s->read_ahead_slots);
+        av_freep(&s->read_ahead_workers);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&s->read_ahead_lock, NULL);
+    pthread_cond_init(&s->read_ahead_cond, NULL);
+    s->read_ahead_head   = 0;
+    s->read_ahead_filled = 0;
+    s->read_ahead_exit   = 0;
+    s->read_ahead_started = 1;
+
+    for (int i = 0; i < s->read_ahead; i++) {
+        if (!(s->read_ahead_slots[i].pkt = av_packet_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    for (; s->nb_read_ahead_workers < nb_workers; s->nb_read_ahead_workers++) {
+        ret = pthread_create(&s->read_ahead_workers[s->nb_read_ahead_workers], NULL,
+                             read_ahead_worker, s1);
+        if (ret) {
+            av_log(s1, AV_LOG_ERROR, "Could not create read-ahead thread: %s\n", av_err2str(AVERROR(ret)));
+            ret = AVERROR(ret);
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    stop_read_ahead(s);
+    return ret;
+}
+
+/**
+ * Discard the files read in advance, when they do not follow the current
+ * position after a seek. Must be called with the lock held.
+ */
+static void flush_read_ahead(VideoDemuxData *s)
+{
+    for (int i = 0; i < s->read_ahead_filled; i++) {
+        ImgReadAheadSlot *slot = &s->read_ahead_slots[(s->read_ahead_head + i) % s->read_ahead];
+
+        while (slot->state == SLOT_READING)
+            pthread_cond_wait(&s->read_ahead_cond, &s->read_ahead_lock);
+        av_packet_unref(slot->pkt);
+        slot->state = SLOT_EMPTY;
+    }
+    s->read_ahead_head   = 0;
+    s->read_ahead_filled = 0;
+}
+
+/**
+ * Queue the next files of the sequence until the window is full. Must be
+ * called with the lock held.
+ */
+static void fill_read_ahead(VideoDemuxData *s)
+{
+    while (s->read_ahead_filled < s->read_ahead) {
+        ImgReadAheadSlot *slot = &s->read_ahead_slots[(s->read_ahead_head + s->read_ahead_filled) % s->read_ahead];
+        int number = s->read_ahead_next;
+
+        if (number > s->img_last) {
+            if (!s->loop)
+                break;
+            number = s->img_first;
+        }
+        slot->number = number;
+        slot->ret    = 0;
+        slot->state  = SLOT_PENDING;
+        if (s->use_glob) {
+#if HAVE_GLOB
+            av_strlcpy(slot->filename, s->globstate.gl_pathv[number], sizeof(slot->filename));
+#endif
+        } else if (av_get_frame_filename(slot->filename, sizeof(slot->filename),
+                                         s->path, number) < 0 && number > 1) {
+            slot->ret   = AVERROR(EIO);
+            slot->state = SLOT_DONE;
+        }
+        s->read_ahead_next = number + 1;
+        s->read_ahead_filled++;
+    }
+    pthread_cond_broadcast(&s->read_ahead_cond);
+}
+
+static int read_ahead_packet(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImgReadAheadSlot *slot;
+    int64_t pts;
+    int ret;
+
+    if (!s->read_ahead_started && (ret = start_read_ahead(s1)) < 0)
+        return ret;
+
+    pthread_mutex_lock(&s->read_ahead_lock);
+    if (s->read_ahead_filled &&
+        s->read_ahead_slots[s->read_ahead_head].number != s->img_number)
+        flush_read_ahead(s);
+    if (!s->read_ahead_filled)
+        s->read_ahead_next = s->img_number;
+    fill_read_ahead(s);
+
+    slot = &s->read_ahead_slots[s->read_ahead_head];
+    while (slot->state != SLOT_DONE)
+        pthread_cond_wait(&s->read_ahead_cond, &s->read_ahead_lock);
+    ret = slot->ret;
+    pts = slot->pts;
+    av_packet_move_ref(pkt, slot->pkt);
+    if (s->export_path_metadata == 1 && ret >= 0)
+        ret = add_filename_as_pkt_side_data(slot->filename, pkt);
+    slot->state = SLOT_EMPTY;
+    s->read_ahead_head = (s->read_ahead_head + 1) % s->read_ahead;
+    s->read_ahead_filled--;
+    fill_read_ahead(s);
+    pthread_mutex_unlock(&s->read_ahead_lock);
+
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+
+    pkt->stream_index = 0;
+    pkt->flags       |= AV_PKT_FLAG_KEY;
+    if (s->ts_from_file) {
+        pkt->pts = pts;
+        av_add_index_entry(s1->streams[0], s->img_number, pkt->pts, 0, 0, AVINDEX_KEYFRAME);
+    } else {
+        pkt->pts = s->pts;
+    }
+    s->img_count++;
+    s->img_number++;
+    s->pts++;
+    return 0;
+}
+#endif
+
 int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -419,6 +676,13 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
+#if HAVE_THREADS
+        /* the first file is read here to probe the codec */
+        if (s->read_ahead && !s->split_planes && s->pattern_type != PT_NONE &&
+            par->codec_id != AV_CODEC_ID_NONE &&
+            (par->codec_id != AV_CODEC_ID_RAWVIDEO || par->width))
+            return read_ahead_packet(s1, pkt);
+#endif
         if (s->pattern_type == PT_NONE) {
             av_strlcpy(filename_bytes, s->path, sizeof(filename_bytes));
         } else if (s->use_glob) {
@@ -496,16 +760,8 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     pkt->stream_index = 0;
     pkt->flags       |= AV_PKT_FLAG_KEY;
     if (s->ts_from_file) {
-        struct stat img_stat;
-        if (stat(filename, &img_stat)) {
-            res = AVERROR(EIO);
+        if ((res = get_file_pts(s, filename, &pkt->pts)) < 0)
             goto fail;
-        }
-        pkt->pts = (int64_t)img_stat.st_mtime;
-#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-        if (s->ts_from_file == 2)
-            pkt->pts = 1000000000*pkt->pts + img_stat.st_mtim.tv_nsec;
-#endif
         av_add_index_entry(s1->streams[0], s->img_number, pkt->pts, 0, 0, AVINDEX_KEYFRAME);
     } else if (!s->is_pipe) {
         pkt->pts      = s->pts;
@@ -572,8 +828,11 @@ fail:
 
 static int img_read_close(struct AVFormatContext* s1)
 {
-#if HAVE_GLOB
     VideoDemuxData *s = s1->priv_data;
+#if HAVE_THREADS
+    stop_read_ahead(s);
+#endif
+#if HAVE_GLOB
     if (s->use_glob) {
         globfree(&s->globstate);
     }
@@ -624,6 +883,8 @@ const AVOption ff_img_options[] = {
     { "sec",  "second precision",       0, AV_OPT_TYPE_CONST,    {.i64 = 1   }, 0, 2,       DEC, "ts_type" },
     { "ns",   "nano second precision",  0, AV_OPT_TYPE_CONST,    {.i64 = 2   }, 0, 2,       DEC, "ts_type" },
     { "export_path_metadata", "enable metadata containing input path information", OFFSET(export_path_metadata), AV_OPT_TYPE_BOOL,   {.i64 = 0   }, 0, 1,       DEC }, \
+    { "read_ahead",   "set number of files read in advance", OFFSET(read_ahead),   AV_OPT_TYPE_INT,    {.i64 = 0   }, 0, INT_MAX, DEC },
+    { "read_threads", "set number of threads reading files in advance", OFFSET(read_threads), AV_OPT_TYPE_INT, {.i64 = 4 }, 1, INT_MAX, DEC },
     COMMON_OPTIONS
 };
 
@@ -35,6 +35,11 @@
 #define PROBE_BUF_MIN 2048
 #define PROBE_BUF_MAX (1 << 20)
 
+/**
+ * Maximum number of packets read at once with AVInputFormat.read_packets().
+ */
+#define MAX_READ_BATCH 16
+
 #ifdef DEBUG
 #    define hex_dump_debug(class, buf, size) av_hex_dump_log(class, AV_LOG_DEBUG, buf, size)
 #else
@@ -186,6 +191,29 @@ typedef struct FFFormatContext {
      * Set if chapter ids are strictly monotonic.
      */
     int chapter_ids_monotonic;
+
+    /**
+     * Packets read by AVInputFormat.read_packets() that have not been
+     * returned by ff_read_packet() yet: batch_pkts[batch_pos] to
+     * batch_pkts[batch_nb - 1], followed by batch_error if it is < 0.
+     */
+    AVPacket *batch_pkts[MAX_READ_BATCH];
+    int batch_pos;
+    int batch_nb;
+    int batch_error;
+
+    /**
+     * Number of packets and byte budget of the running av_read_frames()
+     * call, batch_size is 0 outside of it.
+     */
+    int batch_size;
+    int64_t batch_max_size;
+
+    /**
+     * Error that ended the previous av_read_frames() call after some
+     * packets were returned, reported by the next call.
+     */
+    int read_frames_error;
 } FFFormatContext;
 
 static av_always_inline FFFormatContext *ffformatcontext(AVFormatContext *s)
@@ -64,7 +64,8 @@
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
-    { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, -1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "moov_size" },
+    { "auto", "estimate from the stream durations (faststart only)", 0, AV_OPT_TYPE_CONST, {.i64 = -1}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "moov_size" },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_every_frame", "Fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_EVERY_FRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -6563,6 +6564,43 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Upper bound for the moov atom of a non-fragmented file, derived from the
+ * stream duration hints. Returns 0 if any stream lacks a usable hint.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    int64_t size = 4096;
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        AVRational rate = { 0, 1 };
+        int64_t samples;
+
+        if (st->duration <= 0 || st->time_base.num <= 0 || st->time_base.den <= 0)
+            return 0;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            rate = st->avg_frame_rate.num > 0 ? st->avg_frame_rate : st->r_frame_rate;
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && par->sample_rate > 0) {
+            rate = (AVRational){ par->sample_rate, par->frame_size > 0 ? par->frame_size : 1024 };
+        } else {
+            /* sparse tracks such as subtitles and timecode */
+            rate = (AVRational){ 1, 1 };
+        }
+        if (rate.num <= 0 || rate.den <= 0)
+            return 0;
+        samples = av_rescale_q_rnd(st->duration, st->time_base, av_inv_q(rate),
+                                   AV_ROUND_UP) + 1;
+        /* stsz, stts, ctts, stss and one chunk offset per sample at worst */
+        size += 1024 + samples * 24;
+        if (size > INT_MAX)
+            return 0;
+    }
+    return size;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6617,7 +6655,22 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-        mov->reserved_moov_size = -1;
+        if (mov->reserved_moov_size < 0 && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
+            int estimate = estimate_moov_size(s);
+            if (estimate > 0) {
+                av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n", estimate);
+                mov->reserved_moov_size = estimate;
+            }
+        }
+        if (mov->reserved_moov_size <= 0 || mov->flags & FF_MOV_FLAG_FRAGMENT)
+            mov->reserved_moov_size = -1;
+    } else if (mov->reserved_moov_size < 0) {
+        av_log(s, AV_LOG_WARNING, "moov_size auto requires faststart, ignoring\n");
+        mov->reserved_moov_size = 0;
+    }
+    if (mov->reserved_moov_size > 0 && mov->reserved_moov_size < 8) {
+        av_log(s, AV_LOG_ERROR, "moov_size must be at least 8 bytes\n");
+        return AVERROR(EINVAL);
     }
 
     if (mov->use_editlist < 0) {
@@ -7008,8 +7061,12 @@ static int mov_write_header(AVFormatContext *s)
 
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
-        if (mov->reserved_moov_size > 0)
-            avio_skip(pb, mov->reserved_moov_size);
+        if (mov->reserved_moov_size > 0) {
+            /* keep the area a valid atom in case shift_data() has to move it */
+            avio_wb32(pb, mov->reserved_moov_size);
+            ffio_wfourcc(pb, "free");
+            ffio_fill(pb, 0, mov->reserved_moov_size - 8);
+        }
     }
 
     if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
@@ -7020,7 +7077,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -7289,29 +7346,41 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
-        avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
-
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
+        if (mov->reserved_moov_size > 0) {
+            res = get_moov_size(s);
             if (res < 0)
                 return res;
-            avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
-            if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
-                return res;
-        } else if (mov->reserved_moov_size > 0) {
+            if (res + 8 > mov->reserved_moov_size) {
+                if (!(mov->flags & FF_MOV_FLAG_FASTSTART)) {
+                    av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %d additional\n",
+                           res + 8 - mov->reserved_moov_size);
+                    return AVERROR(EINVAL);
+                }
+                av_log(s, AV_LOG_WARNING, "moov atom of %d bytes does not fit the %d reserved, "
+                       "falling back to a second pass\n", res, mov->reserved_moov_size);
+                /* the reserved free atom stays in front of the mdat */
+                mov->reserved_moov_size = -1;
+            }
+        }
+        avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
+
+        if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
             size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
-            if (size < 8){
-                av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
-                return AVERROR(EINVAL);
-            }
             avio_wb32(pb, size);
             ffio_wfourcc(pb, "free");
             ffio_fill(pb, 0, size - 8);
             avio_seek(pb, moov_pos, SEEK_SET);
+        } else if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
+            res = shift_data(s);
+            if (res < 0)
+                return res;
+            avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+            if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                return res;
         } else {
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
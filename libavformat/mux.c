@@ -32,6 +32,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/trace_internal.h"
 
 /**
  * @file
@@ -483,7 +484,9 @@ int avformat_write_header(AVFormatContext *s, AVDictionary **options)
     if (!(s->oformat->flags & AVFMT_NOFILE) && s->pb)
         avio_write_marker(s->pb, AV_NOPTS_VALUE, AVIO_DATA_MARKER_HEADER);
     if (s->oformat->write_header) {
+        void *mem_ctx = av_mem_accounting_set_context(s);
         ret = s->oformat->write_header(s);
+        av_mem_accounting_set_context(mem_ctx);
         if (ret >= 0 && s->pb && s->pb->error < 0)
             ret = s->pb->error;
         if (ret < 0)
@@ -715,7 +718,11 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
         av_assert0(pkt->size == sizeof(*frame));
         ret = s->oformat->write_uncoded_frame(s, pkt->stream_index, frame, 0);
     } else {
+        void *mem_ctx = av_mem_accounting_set_context(s);
+        FF_TRACE_BEGIN("write_packet", s->oformat->name);
         ret = s->oformat->write_packet(s, pkt);
+        FF_TRACE_END("write_packet", s->oformat->name);
+        av_mem_accounting_set_context(mem_ctx);
     }
 
     if (s->pb && ret >= 0) {
@@ -25,6 +25,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/rational.h"
+#include "avformat.h"
 
 typedef uint8_t UID[16];
 
@@ -51,6 +52,7 @@ enum MXFMetadataSetType {
     TapeDescriptor,
     AVCSubDescriptor,
     MCASubDescriptor,
+    JPEG2000SubDescriptor,
 };
 
 enum MXFFrameLayout {
@@ -117,6 +119,31 @@ extern const MXFCodecUL ff_mxf_color_space_uls[];
 int ff_mxf_decode_pixel_layout(const char pixel_layout[16], enum AVPixelFormat *pix_fmt);
 int ff_mxf_get_content_package_rate(AVRational time_base);
 
+/**
+ * Looks up the position in the file of the edit unit of a stream of an MXF
+ * demuxer at a timestamp, in the time base of the stream, from the index
+ * tables read with the header.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the stream is not indexed, or
+ *         another negative error code
+ */
+int ff_mxf_get_edit_unit_offset(AVFormatContext *s, int stream_index, int64_t timestamp, int64_t *offset);
+
+/**
+ * Looks up the bytes of the file holding the edit units of a stream of an MXF
+ * demuxer between two timestamps, in the time base of the stream, from the
+ * index tables read with the header.
+ *
+ * @param start timestamp of the first edit unit of the range
+ * @param end   timestamp following the last edit unit of the range
+ * @param pos   set to the position of the first edit unit in the file
+ * @param size  set to the number of bytes up to the end of the last edit unit
+ * @return 0 on success, AVERROR(ENOSYS) if the stream is not indexed or the
+ *         end of the range is unknown, or another negative error code
+ */
+int ff_mxf_get_byte_range(AVFormatContext *s, int stream_index, int64_t start, int64_t end,
+                          int64_t *pos, int64_t *size);
+
 
 #define PRIxUID                             \
     "%02x.%02x.%02x.%02x."                  \
@@ -55,14 +55,22 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
+#include "avio_internal.h"
 #include "avlanguage.h"
 #include "internal.h"
 #include "mxf.h"
 
 #define MXF_MAX_CHUNK_SIZE (32 << 20)
+#define MXF_MAX_POOLED_PACKET_SIZE (1 << 30)
+#define MXF_READ_HINT_UNITS 4
+#define MXF_TAIL_PREFETCH_SIZE (1 << 20)
+#define MXF_FOLLOW_POLL_INTERVAL 100000 /* microseconds between the checks of the size of a growing file */
 
 typedef enum {
     Header,
@@ -180,6 +188,7 @@ typedef struct {
     int body_sid;
     MXFWrappingScheme wrapping;
     int edit_units_per_packet; /* how many edit units to read at a time (PCM, ClipWrapped) */
+    int audio_packet_size;     /* maximum size of the packets of PCM essence set by audio_packet_duration */
     int require_reordering;
     int channel_ordering[FF_SANE_NB_CHANNELS];
 } MXFTrack;
@@ -277,10 +286,22 @@ typedef struct MXFIndexTable {
     int64_t *ptses;             /* maps EditUnit -> PTS */
     int nb_segments;
     MXFIndexTableSegment **segments;    /* sorted by IndexStartPosition */
+    uint64_t *segment_ends;     /* maximum EditUnit following segments[0..i], for bisecting the segments */
+    int64_t *segment_offsets;   /* sum of the CBR sizes of segments[0..i-1] */
     AVIndexEntry *fake_index;   /* used for calling ff_index_search_timestamp() */
     int8_t *offsets;            /* temporal offsets for display order to stored order conversion */
 } MXFIndexTable;
 
+/* encrypted essence read ahead, decrypted by the worker threads */
+typedef struct MXFDecryptJob {
+    AVPacket *pkt;
+    int ret;                    /* result of reading the packet */
+    int encrypted;
+    uint8_t ivec[16];
+    uint64_t plaintext_size;
+    uint64_t orig_size;
+} MXFDecryptJob;
+
 typedef struct MXFContext {
     const AVClass *class;     /**< Class for private options. */
     MXFPartition *partitions;
@@ -292,11 +313,15 @@ typedef struct MXFContext {
     int essence_container_data_count;
     MXFMetadataSet **metadata_sets;
     int metadata_sets_count;
+    int *metadata_set_buckets;      /* hash table on the set UIDs: index of the last set of each bucket, or -1 */
+    int *metadata_set_next;         /* index of the previous set of the same bucket, or -1 */
+    unsigned metadata_set_buckets_count;
     AVFormatContext *fc;
     struct AVAES *aesc;
     uint8_t *local_tags;
     int local_tags_count;
     uint64_t footer_partition;
+    int footer_prefetched;
     KLVPacket current_klv_data;
     int run_in;
     MXFPartition *current_partition;
@@ -307,8 +332,69 @@ typedef struct MXFContext {
     MXFIndexTable *index_tables;
     int eia608_extract;
     int skip_audio_reordering;
+    int use_rip;
+    uint64_t *rip_offsets;      /* ThisPartition of the partitions listed in the RIP, in file order */
+    int rip_count;
+    int rip_index;              /* next RIP entry to visit */
+    AVPacketPool *pkt_pool;     /* payloads of frame-wrapped essence packets */
+    int decrypt_threads;
+    int64_t audio_packet_duration;
+    AVSliceThread *decrypt_thread;
+    struct AVAES **decrypt_aesc;    /* one per thread, since AVAES holds the state of the cipher */
+    MXFDecryptJob *decrypt_jobs;    /* packets read ahead, in file order */
+    int nb_decrypt_jobs;
+    int decrypt_job_index;          /* next packet to return */
+    int readahead_edit_units;
+    struct MXFReadAhead *readahead;
+    int follow;
+    int64_t follow_timeout;
+    int follow_done;            /* the FooterPartition was reached, the file is complete */
+    int64_t follow_parsed_pos;  /* end of the partition packs and index segments parsed while following */
+    int lazy_index;
+    KLVPacket *lazy_index_klvs; /* index table segments whose parsing is deferred to the first seek */
+    int nb_lazy_index_klvs;
 } MXFContext;
 
+#define MXF_READAHEAD_SLOTS 4
+#define MXF_READAHEAD_SIZE (4 << 20)    /* size of the reads not sized by the index */
+#define MXF_READAHEAD_IO_BUFFER_SIZE 32768
+
+/* range of the file read ahead by the worker */
+typedef struct MXFReadAheadSlot {
+    uint8_t *data;
+    unsigned int alloc_size;
+    int64_t pos;
+    int size;
+} MXFReadAheadSlot;
+
+/**
+ * Essence read ahead by a worker thread, on its own connection to the file,
+ * in ranges of several edit units sized by the index table. The demuxer reads
+ * the essence through an AVIOContext which is served from these ranges.
+ */
+typedef struct MXFReadAhead {
+    MXFContext *mxf;
+    AVIOContext *pb;            /* read by the demuxer */
+    AVIOContext *worker_pb;     /* read by the worker */
+    MXFTrack *track;            /* track whose index table sizes the reads */
+    MXFIndexTable *index_table;
+    int edit_units;             /* number of edit units of each read */
+    int64_t file_size;
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    MXFReadAheadSlot slots[MXF_READAHEAD_SLOTS];
+    int first;                  /* first slot read by the worker, in file order */
+    int count;                  /* number of slots read by the worker */
+    int consumed;               /* bytes of the first slot read by the demuxer */
+    int64_t fill_pos;           /* offset of the next read of the worker */
+    unsigned generation;        /* incremented when the demuxer seeks outside of the slots */
+    int eof;                    /* error that ended the reads of the worker at fill_pos */
+    int abort;
+} MXFReadAhead;
+
 /* NOTE: klv_offset is not set (-1) for local keys */
 typedef int MXFMetadataReadFunc(void *arg, AVIOContext *pb, int tag, int size, UID uid, int64_t klv_offset);
 
@@ -333,6 +419,7 @@ static const uint8_t mxf_soundfield_group[]                = { 0x06,0x0e,0x2b,0x
 
 /* complete keys to match */
 static const uint8_t mxf_crypto_source_container_ul[]      = { 0x06,0x0e,0x2b,0x34,0x01,0x01,0x01,0x09,0x06,0x01,0x01,0x02,0x02,0x00,0x00,0x00 };
+static const uint8_t mxf_index_table_segment_key[]         = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x10,0x01,0x00 };
 static const uint8_t mxf_encrypted_triplet_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x04,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x7e,0x01,0x00 };
 static const uint8_t mxf_encrypted_essence_container[]     = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x0b,0x01,0x00 };
 static const uint8_t mxf_sony_mpeg4_extradata[]            = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x01,0x0e,0x06,0x06,0x02,0x02,0x01,0x00,0x00 };
@@ -473,7 +560,7 @@ static int mxf_get_stream_index(AVFormatContext *s, KLVPacket *klv, int body_sid
     return s->nb_streams == 1 && s->streams[0]->priv_data ? 0 : -1;
 }
 
-static int find_body_sid_by_absolute_offset(MXFContext *mxf, int64_t offset)
+static MXFPartition *find_partition_by_absolute_offset(MXFContext *mxf, int64_t offset)
 {
     // we look for partition where the offset is placed
     int a, b, m;
@@ -492,13 +579,30 @@ static int find_body_sid_by_absolute_offset(MXFContext *mxf, int64_t offset)
     }
 
     if (a == -1)
-        return 0;
-    return mxf->partitions[a].body_sid;
+        return NULL;
+    return &mxf->partitions[a];
+}
+
+static int find_body_sid_by_absolute_offset(MXFContext *mxf, int64_t offset)
+{
+    MXFPartition *p = find_partition_by_absolute_offset(mxf, offset);
+
+    return p ? p->body_sid : 0;
+}
+
+/**
+ * @return the context from which the essence is read
+ */
+static AVIOContext *mxf_essence_pb(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    return mxf->readahead ? mxf->readahead->pb : s->pb;
 }
 
 static int mxf_get_eia608_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt, int64_t length)
 {
-    int count = avio_rb16(s->pb);
+    AVIOContext *pb = mxf_essence_pb(s);
+    int count = avio_rb16(pb);
     int cdp_identifier, cdp_length, cdp_footer_id, ccdata_id, cc_count;
     int line_num, sample_coding, sample_count;
     int did, sdid, data_length;
@@ -512,10 +616,10 @@ static int mxf_get_eia608_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt
             av_log(s, AV_LOG_ERROR, "error reading s436m packet %"PRId64"\n", length);
             return AVERROR_INVALIDDATA;
         }
-        line_num = avio_rb16(s->pb);
-        avio_r8(s->pb); // wrapping type
-        sample_coding = avio_r8(s->pb);
-        sample_count = avio_rb16(s->pb);
+        line_num = avio_rb16(pb);
+        avio_r8(pb); // wrapping type
+        sample_coding = avio_r8(pb);
+        sample_count = avio_rb16(pb);
         length -= 6 + 8 + sample_count;
         if (line_num != 9 && line_num != 11)
             continue;
@@ -526,45 +630,45 @@ static int mxf_get_eia608_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt
         if (length < 0)
             return AVERROR_INVALIDDATA;
 
-        avio_rb32(s->pb); // array count
-        avio_rb32(s->pb); // array elem size
-        did = avio_r8(s->pb);
-        sdid = avio_r8(s->pb);
-        data_length = avio_r8(s->pb);
+        avio_rb32(pb); // array count
+        avio_rb32(pb); // array elem size
+        did = avio_r8(pb);
+        sdid = avio_r8(pb);
+        data_length = avio_r8(pb);
         if (did != 0x61 || sdid != 1) {
             av_log(s, AV_LOG_WARNING, "unsupported did or sdid: %x %x\n", did, sdid);
             continue;
         }
-        cdp_identifier = avio_rb16(s->pb); // cdp id
+        cdp_identifier = avio_rb16(pb); // cdp id
         if (cdp_identifier != 0x9669) {
             av_log(s, AV_LOG_ERROR, "wrong cdp identifier %x\n", cdp_identifier);
             return AVERROR_INVALIDDATA;
         }
-        cdp_length = avio_r8(s->pb);
-        avio_r8(s->pb); // cdp_frame_rate
-        avio_r8(s->pb); // cdp_flags
-        avio_rb16(s->pb); // cdp_hdr_sequence_cntr
-        ccdata_id = avio_r8(s->pb); // ccdata_id
+        cdp_length = avio_r8(pb);
+        avio_r8(pb); // cdp_frame_rate
+        avio_r8(pb); // cdp_flags
+        avio_rb16(pb); // cdp_hdr_sequence_cntr
+        ccdata_id = avio_r8(pb); // ccdata_id
         if (ccdata_id != 0x72) {
             av_log(s, AV_LOG_ERROR, "wrong cdp data section %x\n", ccdata_id);
             return AVERROR_INVALIDDATA;
         }
-        cc_count = avio_r8(s->pb) & 0x1f;
-        ret = av_get_packet(s->pb, pkt, cc_count * 3);
+        cc_count = avio_r8(pb) & 0x1f;
+        ret = av_get_packet(pb, pkt, cc_count * 3);
         if (ret < 0)
             return ret;
         if (cdp_length - 9 - 4 <  cc_count * 3) {
             av_log(s, AV_LOG_ERROR, "wrong cdp size %d cc count %d\n", cdp_length, cc_count);
             return AVERROR_INVALIDDATA;
         }
-        avio_skip(s->pb, data_length - 9 - 4 - cc_count * 3);
-        cdp_footer_id = avio_r8(s->pb);
+        avio_skip(pb, data_length - 9 - 4 - cc_count * 3);
+        cdp_footer_id = avio_r8(pb);
         if (cdp_footer_id != 0x74) {
             av_log(s, AV_LOG_ERROR, "wrong cdp footer section %x\n", cdp_footer_id);
             return AVERROR_INVALIDDATA;
         }
-        avio_rb16(s->pb); // cdp_ftr_sequence_cntr
-        avio_r8(s->pb); // packet_checksum
+        avio_rb16(pb); // cdp_ftr_sequence_cntr
+        avio_r8(pb); // packet_checksum
         break;
     }
 
@@ -604,11 +708,26 @@ static int mxf_get_d10_aes3_packet(AVIOContext *pb, AVStream *st, AVPacket *pkt,
     return 0;
 }
 
-static int mxf_decrypt_triplet(AVFormatContext *s, AVPacket *pkt, KLVPacket *klv)
+/**
+ * Decrypts the payload of an encrypted triplet read by mxf_decrypt_triplet().
+ */
+static void mxf_decrypt_packet(struct AVAES *aesc, AVPacket *pkt, uint8_t *ivec,
+                               uint64_t plaintext_size, uint64_t orig_size)
+{
+    av_aes_crypt(aesc, &pkt->data[plaintext_size], &pkt->data[plaintext_size],
+                 (pkt->size - plaintext_size) >> 4, ivec, 1);
+    av_shrink_packet(pkt, orig_size);
+}
+
+/**
+ * Reads an encrypted triplet. The payload is decrypted, unless job is set,
+ * in which case the decryption parameters are stored in it.
+ */
+static int mxf_decrypt_triplet(AVFormatContext *s, AVPacket *pkt, KLVPacket *klv, MXFDecryptJob *job)
 {
     static const uint8_t checkv[16] = {0x43, 0x48, 0x55, 0x4b, 0x43, 0x48, 0x55, 0x4b, 0x43, 0x48, 0x55, 0x4b, 0x43, 0x48, 0x55, 0x4b};
     MXFContext *mxf = s->priv_data;
-    AVIOContext *pb = s->pb;
+    AVIOContext *pb = mxf_essence_pb(s);
     int64_t end = avio_tell(pb) + klv->length;
     int64_t size;
     uint64_t orig_size;
@@ -663,11 +782,15 @@ static int mxf_decrypt_triplet(AVFormatContext *s, AVPacket *pkt, KLVPacket *klv
         return size;
     else if (size < plaintext_size)
         return AVERROR_INVALIDDATA;
-    size -= plaintext_size;
-    if (mxf->aesc)
-        av_aes_crypt(mxf->aesc, &pkt->data[plaintext_size],
-                     &pkt->data[plaintext_size], size >> 4, ivec, 1);
-    av_shrink_packet(pkt, orig_size);
+    if (job && mxf->aesc) {
+        memcpy(job->ivec, ivec, sizeof(ivec));
+        job->plaintext_size = plaintext_size;
+        job->orig_size      = orig_size;
+        job->encrypted      = 1;
+    } else if (mxf->aesc)
+        mxf_decrypt_packet(mxf->aesc, pkt, ivec, plaintext_size, orig_size);
+    else
+        av_shrink_packet(pkt, orig_size);
     pkt->stream_index = index;
     avio_skip(pb, end - avio_tell(pb));
     return 0;
@@ -699,6 +822,23 @@ static int mxf_read_primer_pack(void *arg, AVIOContext *pb, int tag, int size, U
     return 0;
 }
 
+/* The footer is read right after the header metadata, let the I/O layer
+ * fetch it in the meantime. */
+static void mxf_prefetch_footer(MXFContext *mxf)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    int64_t pos, file_size;
+
+    if (mxf->footer_prefetched || !(pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return;
+    mxf->footer_prefetched = 1;
+
+    pos       = mxf->run_in + mxf->footer_partition;
+    file_size = avio_size(pb);
+    if (file_size > pos)
+        ffio_prefetch(pb, pos, file_size - pos);
+}
+
 static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size, UID uid, int64_t klv_offset)
 {
     MXFContext *mxf = arg;
@@ -801,6 +941,7 @@ static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size
                    mxf->footer_partition, footer_partition);
         } else {
             mxf->footer_partition = footer_partition;
+            mxf_prefetch_footer(mxf);
         }
     }
 
@@ -885,16 +1026,56 @@ static uint64_t partition_score(MXFPartition *p)
     return (score << 60) | ((uint64_t)p->this_partition >> 4);
 }
 
+static unsigned mxf_metadata_set_bucket(const MXFContext *mxf, const UID uid)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < 16; i++)
+        hash = (hash ^ uid[i]) * 16777619u;
+    return hash & (mxf->metadata_set_buckets_count - 1);
+}
+
+/* rebuilds the hash table with twice as many buckets as metadata sets */
+static int mxf_grow_metadata_set_buckets(MXFContext *mxf)
+{
+    unsigned count = FFMAX(2 * mxf->metadata_set_buckets_count, 64);
+    int *buckets = av_malloc_array(count, sizeof(*buckets));
+
+    if (!buckets)
+        return AVERROR(ENOMEM);
+    av_free(mxf->metadata_set_buckets);
+    mxf->metadata_set_buckets = buckets;
+    mxf->metadata_set_buckets_count = count;
+
+    memset(buckets, 0xff, count * sizeof(*buckets));
+    for (int i = 0; i < mxf->metadata_sets_count; i++) {
+        unsigned bucket = mxf_metadata_set_bucket(mxf, mxf->metadata_sets[i]->uid);
+        mxf->metadata_set_next[i] = buckets[bucket];
+        buckets[bucket] = i;
+    }
+    return 0;
+}
+
 static int mxf_add_metadata_set(MXFContext *mxf, MXFMetadataSet **metadata_set)
 {
     MXFMetadataSet **tmp;
+    int *next;
+    unsigned bucket;
+    int ret;
     enum MXFMetadataSetType type = (*metadata_set)->type;
 
+    if (mxf->metadata_sets_count >= mxf->metadata_set_buckets_count / 2 &&
+        (ret = mxf_grow_metadata_set_buckets(mxf)) < 0) {
+        mxf_free_metadataset(metadata_set, 1);
+        return ret;
+    }
+    bucket = mxf_metadata_set_bucket(mxf, (*metadata_set)->uid);
+
     // Index Table is special because it might be added manually without
     // partition and we iterate thorugh all instances of them. Also some files
     // use the same Instance UID for different index tables...
     if (type != IndexTableSegment) {
-        for (int i = 0; i < mxf->metadata_sets_count; i++) {
+        for (int i = mxf->metadata_set_buckets[bucket]; i >= 0; i = mxf->metadata_set_next[i]) {
             if (!memcmp((*metadata_set)->uid, mxf->metadata_sets[i]->uid, 16) && type == mxf->metadata_sets[i]->type) {
                 uint64_t old_s = mxf->metadata_sets[i]->partition_score;
                 uint64_t new_s = (*metadata_set)->partition_score;
@@ -911,7 +1092,15 @@ static int mxf_add_metadata_set(MXFContext *mxf, MXFMetadataSet **metadata_set)
         return AVERROR(ENOMEM);
     }
     mxf->metadata_sets = tmp;
+    next = av_realloc_array(mxf->metadata_set_next, mxf->metadata_sets_count + 1, sizeof(*mxf->metadata_set_next));
+    if (!next) {
+        mxf_free_metadataset(metadata_set, 1);
+        return AVERROR(ENOMEM);
+    }
+    mxf->metadata_set_next = next;
     mxf->metadata_sets[mxf->metadata_sets_count] = *metadata_set;
+    mxf->metadata_set_next[mxf->metadata_sets_count] = mxf->metadata_set_buckets[bucket];
+    mxf->metadata_set_buckets[bucket] = mxf->metadata_sets_count;
     mxf->metadata_sets_count++;
     return 0;
 }
@@ -1504,9 +1693,10 @@ static void *mxf_resolve_strong_ref(MXFContext *mxf, UID *strong_ref, enum MXFMe
 {
     int i;
 
-    if (!strong_ref)
+    if (!strong_ref || !mxf->metadata_sets_count)
         return NULL;
-    for (i = mxf->metadata_sets_count - 1; i >= 0; i--) {
+    /* the sets of a bucket are linked from the last one added */
+    for (i = mxf->metadata_set_buckets[mxf_metadata_set_bucket(mxf, *strong_ref)]; i >= 0; i = mxf->metadata_set_next[i]) {
         if (!memcmp(*strong_ref, mxf->metadata_sets[i]->uid, 16) &&
             (type == AnyType || mxf->metadata_sets[i]->type == type)) {
             return mxf->metadata_sets[i];
@@ -1813,42 +2003,51 @@ static int64_t mxf_essence_container_end(MXFContext *mxf, int body_sid)
 /* EditUnit -> absolute offset */
 static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_table, int64_t edit_unit, AVRational edit_rate, int64_t *edit_unit_out, int64_t *offset_out, MXFPartition **partition_out, int nag)
 {
-    int i;
-    int64_t offset_temp = 0;
+    int a, b, m;
+    int64_t offset_temp;
 
     edit_unit = av_rescale_q(edit_unit, index_table->segments[0]->index_edit_rate, edit_rate);
 
-    for (i = 0; i < index_table->nb_segments; i++) {
-        MXFIndexTableSegment *s = index_table->segments[i];
+    /* bisect for the first segment that ends after the edit unit */
+    a = -1;
+    b = index_table->nb_segments;
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (edit_unit < index_table->segment_ends[m])
+            b = m;
+        else
+            a = m;
+    }
+    /* segments with no duration contain no edit unit */
+    while (b < index_table->nb_segments && !index_table->segments[b]->index_duration)
+        b++;
 
-        edit_unit = FFMAX(edit_unit, s->index_start_position);  /* clamp if trying to seek before start */
+    if (b < index_table->nb_segments) {
+        MXFIndexTableSegment *s = index_table->segments[b];
+        int64_t index;
 
-        if (edit_unit < s->index_start_position + s->index_duration) {
-            int64_t index = edit_unit - s->index_start_position;
+        edit_unit = FFMAX(edit_unit, s->index_start_position);  /* clamp if trying to seek before start */
+        index = edit_unit - s->index_start_position;
 
-            if (s->edit_unit_byte_count)
-                offset_temp += s->edit_unit_byte_count * index;
-            else {
-                if (s->nb_index_entries == 2 * s->index_duration + 1)
-                    index *= 2;     /* Avid index */
+        if (s->edit_unit_byte_count)
+            offset_temp = index_table->segment_offsets[b] + s->edit_unit_byte_count * index;
+        else {
+            if (s->nb_index_entries == 2 * s->index_duration + 1)
+                index *= 2;     /* Avid index */
 
-                if (index < 0 || index >= s->nb_index_entries) {
-                    av_log(mxf->fc, AV_LOG_ERROR, "IndexSID %i segment at %"PRId64" IndexEntryArray too small\n",
-                           index_table->index_sid, s->index_start_position);
-                    return AVERROR_INVALIDDATA;
-                }
-
-                offset_temp = s->stream_offset_entries[index];
+            if (index < 0 || index >= s->nb_index_entries) {
+                av_log(mxf->fc, AV_LOG_ERROR, "IndexSID %i segment at %"PRId64" IndexEntryArray too small\n",
+                       index_table->index_sid, s->index_start_position);
+                return AVERROR_INVALIDDATA;
             }
 
-            if (edit_unit_out)
-                *edit_unit_out = av_rescale_q(edit_unit, edit_rate, s->index_edit_rate);
-
-            return mxf_absolute_bodysid_offset(mxf, index_table->body_sid, offset_temp, offset_out, partition_out);
-        } else {
-            /* EditUnitByteCount == 0 for VBR indexes, which is fine since they use explicit StreamOffsets */
-            offset_temp += s->edit_unit_byte_count * s->index_duration;
+            offset_temp = s->stream_offset_entries[index];
         }
+
+        if (edit_unit_out)
+            *edit_unit_out = av_rescale_q(edit_unit, edit_rate, s->index_edit_rate);
+
+        return mxf_absolute_bodysid_offset(mxf, index_table->body_sid, offset_temp, offset_out, partition_out);
     }
 
     if (nag)
@@ -1981,6 +2180,47 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
  * Sorts and collects index table segments into index tables.
  * Also computes PTSes if possible.
  */
+/**
+ * Computes the arrays on which mxf_edit_unit_absolute_offset() bisects the
+ * segments of an index table, so that the cost of a lookup does not grow
+ * with the number of segments.
+ */
+static int mxf_compute_segment_bounds(MXFIndexTable *t)
+{
+    uint64_t end = 0;
+    int64_t offset = 0;
+
+    t->segment_ends    = av_malloc_array(t->nb_segments, sizeof(*t->segment_ends));
+    t->segment_offsets = av_malloc_array(t->nb_segments, sizeof(*t->segment_offsets));
+    if (!t->segment_ends || !t->segment_offsets)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < t->nb_segments; i++) {
+        MXFIndexTableSegment *s = t->segments[i];
+
+        end = FFMAX(end, s->index_start_position + s->index_duration);
+        t->segment_ends[i]    = end;
+        t->segment_offsets[i] = offset;
+        offset += s->edit_unit_byte_count * s->index_duration;
+    }
+
+    return 0;
+}
+
+static void mxf_free_index_tables(MXFContext *mxf)
+{
+    for (int i = 0; i < mxf->nb_index_tables; i++) {
+        av_freep(&mxf->index_tables[i].segments);
+        av_freep(&mxf->index_tables[i].segment_ends);
+        av_freep(&mxf->index_tables[i].segment_offsets);
+        av_freep(&mxf->index_tables[i].ptses);
+        av_freep(&mxf->index_tables[i].fake_index);
+        av_freep(&mxf->index_tables[i].offsets);
+    }
+    av_freep(&mxf->index_tables);
+    mxf->nb_index_tables = 0;
+}
+
 static int mxf_compute_index_tables(MXFContext *mxf)
 {
     int i, j, k, ret, nb_sorted_segments;
@@ -2079,6 +2319,9 @@ static int mxf_compute_index_tables(MXFContext *mxf)
             t->segments[k]->index_duration = mxf_track->original_duration;
             break;
         }
+
+        if ((ret = mxf_compute_segment_bounds(t)) < 0)
+            goto finish_decoding_index;
     }
 
     ret = 0;
@@ -3336,6 +3579,50 @@ static int mxf_seek_to_previous_partition(MXFContext *mxf)
     return 1;
 }
 
+static int mxf_parse_handle_essence(MXFContext *mxf);
+
+/**
+ * Seeks to the partition that follows the current one in the Random Index
+ * Pack and parses its PartitionPack. The partitions are visited in file order,
+ * the essence of each one being skipped. Falls back to parsing the partitions
+ * backward from the footer if the RIP entry isn't a PartitionPack.
+ * @return <= 0 if we should stop parsing, > 0 if we should keep going
+ */
+static int mxf_seek_to_next_rip_partition(MXFContext *mxf)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    uint64_t current_partition = mxf->current_partition->pack_ofs - mxf->run_in;
+    KLVPacket klv;
+    int64_t offset;
+    int ret;
+
+    while (mxf->rip_index < mxf->rip_count && mxf->rip_offsets[mxf->rip_index] <= current_partition)
+        mxf->rip_index++;
+    if (mxf->rip_index == mxf->rip_count)
+        return 0;   /* we've parsed all partitions */
+
+    offset = mxf->run_in + mxf->rip_offsets[mxf->rip_index++];
+    av_log(mxf->fc, AV_LOG_TRACE, "seeking to RIP partition @ 0x%" PRIx64 "\n", offset);
+    if ((ret = avio_seek(pb, offset, SEEK_SET)) < 0)
+        return ret;
+
+    if ((ret = klv_read_packet(&klv, pb)) < 0 ||
+        !mxf_is_partition_pack_key(klv.key) || klv.offset != offset) {
+        av_log(mxf->fc, AV_LOG_WARNING,
+               "RIP entry @ %" PRIx64 " isn't a PartitionPack - parsing partitions from the FooterPartition\n",
+               offset);
+        mxf->rip_count = 0;
+        if ((ret = avio_seek(pb, offset, SEEK_SET)) < 0)
+            return ret;
+        return mxf_parse_handle_essence(mxf);
+    }
+
+    if ((ret = mxf_parse_klv(mxf, klv, mxf_read_partition_pack, 0, 0)) < 0)
+        return ret;
+
+    return 1;
+}
+
 /**
  * Called when essence is encountered
  * @return <= 0 if we should stop parsing, > 0 if we should keep going
@@ -3347,6 +3634,8 @@ static int mxf_parse_handle_essence(MXFContext *mxf)
 
     if (mxf->parsing_backward) {
         return mxf_seek_to_previous_partition(mxf);
+    } else if (mxf->rip_count) {
+        return mxf_seek_to_next_rip_partition(mxf);
     } else {
         if (!mxf->footer_partition) {
             av_log(mxf->fc, AV_LOG_TRACE, "no FooterPartition\n");
@@ -3449,6 +3738,59 @@ static MXFIndexTable *mxf_find_index_table(MXFContext *mxf, int index_sid)
     return NULL;
 }
 
+int ff_mxf_get_edit_unit_offset(AVFormatContext *s, int stream_index, int64_t timestamp, int64_t *offset)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFTrack *track;
+    MXFIndexTable *t;
+
+    if (stream_index < 0 || stream_index >= s->nb_streams)
+        return AVERROR(EINVAL);
+    track = s->streams[stream_index]->priv_data;
+    if (!track || !(t = mxf_find_index_table(mxf, track->index_sid)) || !t->nb_segments)
+        return AVERROR(ENOSYS);
+
+    return mxf_edit_unit_absolute_offset(mxf, t, timestamp, track->edit_rate, NULL, offset, NULL, 0);
+}
+
+static int mxf_load_lazy_index(MXFContext *mxf);
+
+int ff_mxf_get_byte_range(AVFormatContext *s, int stream_index, int64_t start, int64_t end,
+                          int64_t *pos, int64_t *size)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFTrack *track;
+    MXFIndexTable *t;
+    MXFPartition *partition, *end_partition = NULL;
+    int64_t last, end_pos = -1;
+    int ret;
+
+    if (stream_index < 0 || stream_index >= s->nb_streams || end <= start)
+        return AVERROR(EINVAL);
+    if ((ret = mxf_load_lazy_index(mxf)) < 0)
+        return ret;
+    track = s->streams[stream_index]->priv_data;
+    if (!track || !(t = mxf_find_index_table(mxf, track->index_sid)) || !t->nb_segments)
+        return AVERROR(ENOSYS);
+
+    if ((ret = mxf_edit_unit_absolute_offset(mxf, t, start, track->edit_rate, NULL, pos, NULL, 0)) < 0 ||
+        (ret = mxf_edit_unit_absolute_offset(mxf, t, end - 1, track->edit_rate, NULL, &last, &partition, 0)) < 0)
+        return ret;
+
+    /* the range ends where the next edit unit starts, unless it is in another
+     * partition, or past the last edit unit: then at the end of the essence
+     * of the partition of the last edit unit of the range */
+    if (mxf_edit_unit_absolute_offset(mxf, t, end, track->edit_rate, NULL, &end_pos, &end_partition, 0) < 0)
+        end_pos = -1;
+    if ((end_pos < 0 || end_partition != partition) && partition->essence_length > 0)
+        end_pos = partition->essence_offset + partition->essence_length;
+    if (end_pos <= last)
+        return AVERROR(ENOSYS);
+
+    *size = end_pos - *pos;
+    return 0;
+}
+
 /**
  * Deal with the case where for some audio atoms EditUnitByteCount is
  * very small (2, 4..). In those cases we should read more than one
@@ -3456,12 +3798,38 @@ static MXFIndexTable *mxf_find_index_table(MXFContext *mxf, int index_sid)
  */
 static void mxf_compute_edit_units_per_packet(MXFContext *mxf, AVStream *st)
 {
+    AVCodecParameters *par = st->codecpar;
     MXFTrack *track = st->priv_data;
     MXFIndexTable *t;
+    int bits_per_sample;
 
     if (!track)
         return;
     track->edit_units_per_packet = 1;
+    track->audio_packet_size = 0;
+
+    bits_per_sample = par->bits_per_coded_sample ? par->bits_per_coded_sample
+                                                 : av_get_bits_per_sample(par->codec_id);
+    if (mxf->audio_packet_duration > 0                        &&
+        par->codec_type == AVMEDIA_TYPE_AUDIO                 &&
+        is_pcm(par->codec_id)                                 &&
+        par->sample_rate > 0 && par->channels > 0             &&
+        bits_per_sample > 0 && !(bits_per_sample & 7)         &&
+        (track->wrapping == FrameWrapped || track->wrapping == ClipWrapped)) {
+        int64_t frame_size = par->channels * (int64_t)(bits_per_sample >> 3);
+        int64_t samples    = av_rescale(mxf->audio_packet_duration, par->sample_rate, AV_TIME_BASE);
+
+        /* packets are cut at the end of each KLV, so frame-wrapped elements
+         * are only ever split, never merged with the following ones */
+        samples = av_clip64(samples, 1, MXF_MAX_CHUNK_SIZE / frame_size);
+        track->audio_packet_size = samples * frame_size;
+        if (track->wrapping == ClipWrapped)
+            track->edit_units_per_packet = av_clip64(av_rescale_q(mxf->audio_packet_duration, AV_TIME_BASE_Q,
+                                                                  av_inv_q(track->edit_rate)),
+                                                     1, INT_MAX);
+        return;
+    }
+
     if (track->wrapping != ClipWrapped)
         return;
 
@@ -3482,6 +3850,64 @@ static void mxf_compute_edit_units_per_packet(MXFContext *mxf, AVStream *st)
     track->edit_units_per_packet = FFMAX(1, track->edit_rate.num / track->edit_rate.den / 25);
 }
 
+/**
+ * Exports the index table of a frame-wrapped track as one AVIndexEntry per
+ * edit unit, with the byte size of the edit unit, so that the packets can be
+ * counted and sized without reading them. This is only done when each edit
+ * unit is one packet of the track and no other track shares its essence
+ * container, and when the entries fit in max_index_size.
+ */
+static int mxf_export_index_entries(MXFContext *mxf, AVStream *st)
+{
+    AVFormatContext *s = mxf->fc;
+    MXFTrack *track = st->priv_data;
+    MXFIndexTable *t;
+    AVRational edit_unit_tb;
+    int64_t pos, size;
+    int ret;
+
+    if (!track || track->wrapping != FrameWrapped || track->audio_packet_size ||
+        track->edit_units_per_packet != 1 || track->original_duration <= 0 ||
+        track->original_duration > s->max_index_size / sizeof(AVIndexEntry) ||
+        (mxf->follow && !mxf->follow_done) || avformat_index_get_entries_count(st) ||
+        !(t = mxf_find_index_table(mxf, track->index_sid)) || !t->nb_segments)
+        return 0;
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        MXFTrack *track2 = s->streams[i]->priv_data;
+        if (track2 && track2 != track && track2->body_sid == track->body_sid)
+            return 0;
+    }
+
+    /* check that the index covers the whole track before adding anything */
+    if (ff_mxf_get_byte_range(s, st->index, track->original_duration - 1,
+                              track->original_duration, &pos, &size) < 0)
+        return 0;
+
+    edit_unit_tb = av_inv_q(track->edit_rate);
+    for (int64_t x = 0; x < track->original_duration; x++) {
+        int flags = AVINDEX_KEYFRAME;
+
+        if ((ret = ff_mxf_get_byte_range(s, st->index, x, x + 1, &pos, &size)) < 0 ||
+            size > INT_MAX) {
+            av_log(s, AV_LOG_VERBOSE, "edit unit %"PRId64" of stream %d has no usable "
+                   "byte range, not exporting its index\n", x, st->index);
+            ffstream(st)->nb_index_entries = 0;
+            return 0;
+        }
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !track->intra_only &&
+            t->fake_index && x < t->nb_ptses)
+            flags = t->fake_index[t->ptses[x]].flags;
+
+        if ((ret = av_add_index_entry(st, pos,
+                                      av_rescale_q(x + t->first_dts, edit_unit_tb, st->time_base),
+                                      size, 0, flags)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 /**
  * Deal with the case where ClipWrapped essences does not have any IndexTableSegments.
  */
@@ -3553,6 +3979,35 @@ static int mxf_handle_missing_index_segment(MXFContext *mxf, AVStream *st)
     return 0;
 }
 
+/**
+ * Reads the partition offsets of a RIP, so that the partitions can be
+ * visited in file order. They are ignored unless sorted and within the file.
+ */
+static void mxf_read_rip_entries(AVFormatContext *s, const KLVPacket *klv, int64_t file_size)
+{
+    MXFContext *mxf = s->priv_data;
+    int count = (klv->length - 4) / 12;
+    uint64_t *offsets = av_malloc_array(count, sizeof(*offsets));
+
+    if (!offsets)
+        return;
+
+    avio_seek(s->pb, klv->next_klv - klv->length, SEEK_SET);
+    for (int i = 0; i < count; i++) {
+        avio_skip(s->pb, 4);    /* BodySID */
+        offsets[i] = avio_rb64(s->pb);
+        if (avio_feof(s->pb) || mxf->run_in + offsets[i] >= file_size ||
+            (i && offsets[i] <= offsets[i - 1])) {
+            av_log(s, AV_LOG_VERBOSE, "RIP entries are not in file order - ignoring\n");
+            av_free(offsets);
+            return;
+        }
+    }
+
+    mxf->rip_offsets = offsets;
+    mxf->rip_count = count;
+}
+
 static void mxf_read_random_index_pack(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
@@ -3579,6 +4034,11 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
     /* We're only interested in RIPs with at least two entries.. */
     min_rip_length = 16+1+24+4;
 
+    /* The RIP is usually preceded by the footer partition, which is read
+     * next, so ask for both at once. */
+    ffio_prefetch(s->pb, FFMAX(file_size - MXF_TAIL_PREFETCH_SIZE, 0),
+                  MXF_TAIL_PREFETCH_SIZE);
+
     /* See S377m section 11 */
     avio_seek(s->pb, file_size - 4, SEEK_SET);
     length = avio_rb32(s->pb);
@@ -3601,12 +4061,191 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
     if (mxf->run_in + mxf->footer_partition >= file_size) {
         av_log(s, AV_LOG_WARNING, "bad FooterPartition in RIP - ignoring\n");
         mxf->footer_partition = 0;
+        goto end;
     }
 
+    mxf_prefetch_footer(mxf);
+
+    if (mxf->use_rip)
+        mxf_read_rip_entries(s, &klv, file_size);
+
 end:
     avio_seek(s->pb, mxf->run_in, SEEK_SET);
 }
 
+/**
+ * Checks that the packets can be read without the index tables: all the
+ * essence is frame-wrapped, and the video is intra-only so that its
+ * timestamps do not depend on the TemporalOffsets of the index.
+ */
+static int mxf_can_defer_index(AVFormatContext *s)
+{
+    for (int i = 0; i < s->nb_streams; i++) {
+        MXFTrack *track = s->streams[i]->priv_data;
+
+        if (!track)
+            continue;
+        if (track->wrapping != FrameWrapped)
+            return 0;
+        if (s->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !track->intra_only)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Parses the index table segments deferred by the lazy_index option.
+ * The position in the file is kept.
+ */
+static int mxf_parse_lazy_index_segments(MXFContext *mxf)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    MXFPartition *current_partition = mxf->current_partition;
+    int64_t pos;
+    int64_t seek_ret;
+    int ret = 0;
+
+    if (!pb)
+        return AVERROR(EIO);
+    pos = avio_tell(pb);
+
+    for (int i = 0; i < mxf->nb_lazy_index_klvs; i++) {
+        KLVPacket *klv = &mxf->lazy_index_klvs[i];
+
+        /* the duplicate segments are ranked by their partition */
+        mxf->current_partition = find_partition_by_absolute_offset(mxf, klv->offset);
+        if ((seek_ret = avio_seek(pb, klv->next_klv - klv->length, SEEK_SET)) < 0) {
+            ret = seek_ret;
+            break;
+        }
+        if ((ret = mxf_parse_klv(mxf, *klv, mxf_read_index_table_segment,
+                                 sizeof(MXFIndexTableSegment), IndexTableSegment)) < 0)
+            break;
+    }
+    mxf->current_partition = current_partition;
+    av_freep(&mxf->lazy_index_klvs);
+    mxf->nb_lazy_index_klvs = 0;
+
+    if ((seek_ret = avio_seek(pb, pos, SEEK_SET)) < 0 && ret >= 0)
+        ret = seek_ret;
+    return ret;
+}
+
+/**
+ * Parses the deferred index table segments, if any, and computes the index
+ * tables from all the segments.
+ */
+static int mxf_load_lazy_index(MXFContext *mxf)
+{
+    int ret;
+
+    if (!mxf->nb_lazy_index_klvs)
+        return 0;
+
+    av_log(mxf->fc, AV_LOG_VERBOSE, "parsing %d deferred index table segments\n",
+           mxf->nb_lazy_index_klvs);
+    if ((ret = mxf_parse_lazy_index_segments(mxf)) < 0)
+        return ret;
+    mxf_free_index_tables(mxf);
+    return mxf_compute_index_tables(mxf);
+}
+
+/**
+ * Waits for a growing file to reach a size.
+ * @return 0 once it has, AVERROR_EOF if it stopped growing for follow_timeout
+ */
+static int mxf_follow_wait(AVFormatContext *s, AVIOContext *pb, int64_t size)
+{
+    MXFContext *mxf = s->priv_data;
+    int64_t last_size = -1, deadline = 0;
+
+    while (1) {
+        int64_t file_size = avio_size(pb);
+
+        if (file_size < 0)
+            return file_size;
+        if (file_size >= size)
+            break;
+        if (file_size != last_size) {
+            last_size = file_size;
+            deadline  = av_gettime_relative() + mxf->follow_timeout;
+        } else if (av_gettime_relative() >= deadline) {
+            av_log(s, AV_LOG_VERBOSE, "file stopped growing at %"PRId64" bytes\n", file_size);
+            return AVERROR_EOF;
+        }
+        if (ff_check_interrupt(&s->interrupt_callback))
+            return AVERROR_EXIT;
+        av_usleep(MXF_FOLLOW_POLL_INTERVAL);
+    }
+
+    /* a read may have hit the previous end of the file */
+    if (avio_feof(pb))
+        avio_seek(pb, avio_tell(pb), SEEK_SET);
+
+    return 0;
+}
+
+/**
+ * Waits for the KLV at the current position of a growing file to be written
+ * completely. Does nothing once the FooterPartition is reached.
+ * @return 0 if it is, AVERROR_EOF if the file stopped growing first
+ */
+static int mxf_follow_klv(AVFormatContext *s, AVIOContext *pb)
+{
+    MXFContext *mxf = s->priv_data;
+    int64_t pos = avio_tell(pb);
+    KLVPacket klv;
+    int ret;
+
+    if (!mxf->follow || mxf->follow_done)
+        return 0;
+
+    /* the key and the longest BER length we accept */
+    if ((ret = mxf_follow_wait(s, pb, pos + 16 + 9)) < 0)
+        return ret;
+    ret = klv_read_packet(&klv, pb);
+    avio_seek(pb, pos, SEEK_SET);
+    if (ret < 0)
+        return 0;   /* not a KLV, let the caller resync */
+
+    return mxf_follow_wait(s, pb, klv.next_klv);
+}
+
+/**
+ * Parses the partition packs and index table segments written after the
+ * header was read, so that the index tables of a growing file cover the
+ * essence as it is appended.
+ * @return 1 if the KLV was parsed, 0 if it should be skipped, < 0 on error
+ */
+static int mxf_follow_parse_klv(MXFContext *mxf, KLVPacket *klv)
+{
+    int ret;
+
+    if (!mxf->follow || mxf->follow_done || klv->offset < mxf->follow_parsed_pos)
+        return 0;
+
+    if (mxf_is_partition_pack_key(klv->key)) {
+        if ((ret = mxf_parse_klv(mxf, *klv, mxf_read_partition_pack, 0, 0)) < 0)
+            return ret;
+        if (mxf->current_partition->type == Footer) {
+            av_log(mxf->fc, AV_LOG_VERBOSE, "reached FooterPartition, the file is complete\n");
+            mxf->follow_done = 1;
+        }
+    } else if (IS_KLV_KEY(klv->key, mxf_index_table_segment_key)) {
+        if ((ret = mxf_parse_klv(mxf, *klv, mxf_read_index_table_segment,
+                                 sizeof(MXFIndexTableSegment), IndexTableSegment)) < 0)
+            return ret;
+        mxf_free_index_tables(mxf);
+        if ((ret = mxf_compute_index_tables(mxf)) < 0)
+            return ret;
+    } else {
+        return 0;
+    }
+    mxf->follow_parsed_pos = klv->next_klv;
+
+    return 1;
+}
+
 static int mxf_read_header(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
@@ -3616,6 +4255,10 @@ static int mxf_read_header(AVFormatContext *s)
 
     mxf->last_forward_tell = INT64_MAX;
 
+    mxf->pkt_pool = av_packet_pool_alloc();
+    if (!mxf->pkt_pool)
+        return AVERROR(ENOMEM);
+
     if (!mxf_read_sync(s->pb, mxf_header_partition_pack_key, 14)) {
         av_log(s, AV_LOG_ERROR, "could not find header partition pack key\n");
         return AVERROR_INVALIDDATA;
@@ -3629,6 +4272,9 @@ static int mxf_read_header(AVFormatContext *s)
     while (!avio_feof(s->pb)) {
         const MXFMetadataReadTableEntry *metadata;
 
+        if (!mxf->parsing_backward && (ret = mxf_follow_klv(s, s->pb)) < 0 && ret != AVERROR_EOF)
+            return ret;
+
         if (klv_read_packet(&klv, s->pb) < 0) {
             /* EOF - seek to previous partition or stop */
             if(mxf_parse_handle_partition_or_eof(mxf) <= 0)
@@ -3670,6 +4316,18 @@ static int mxf_read_header(AVFormatContext *s)
             /* we're still parsing forward. proceed to parsing this partition pack */
         }
 
+        if (mxf->lazy_index && IS_KLV_KEY(klv.key, mxf_index_table_segment_key)) {
+            ret = av_reallocp_array(&mxf->lazy_index_klvs, mxf->nb_lazy_index_klvs + 1,
+                                    sizeof(*mxf->lazy_index_klvs));
+            if (ret < 0) {
+                mxf->nb_lazy_index_klvs = 0;
+                return ret;
+            }
+            mxf->lazy_index_klvs[mxf->nb_lazy_index_klvs++] = klv;
+            avio_skip(s->pb, klv.length);
+            continue;
+        }
+
         for (metadata = mxf_metadata_read_table; metadata->read; metadata++) {
             if (IS_KLV_KEY(klv.key, metadata->key)) {
                 if ((ret = mxf_parse_klv(mxf, klv, metadata->read, metadata->ctx_size, metadata->type)) < 0)
@@ -3690,11 +4348,25 @@ static int mxf_read_header(AVFormatContext *s)
     }
     avio_seek(s->pb, essence_offset, SEEK_SET);
 
+    /* without a FooterPartition, the partitions that follow the essence
+     * are parsed as the packets are read */
+    mxf->follow_done = !!mxf->footer_partition;
+    mxf->follow_parsed_pos = essence_offset;
+    if (mxf->follow && !mxf->follow_done)
+        mxf->readahead_edit_units = 0;
+
     /* we need to do this before computing the index tables
      * to be able to fill in zero IndexDurations with st->duration */
     if ((ret = mxf_parse_structural_metadata(mxf)) < 0)
         return ret;
 
+    /* the index is needed to packetize the other essence, and a growing
+     * file rebuilds its index as it is read */
+    if (mxf->nb_lazy_index_klvs &&
+        (!mxf_can_defer_index(s) || (mxf->follow && !mxf->follow_done)) &&
+        (ret = mxf_parse_lazy_index_segments(mxf)) < 0)
+        return ret;
+
     for (int i = 0; i < s->nb_streams; i++)
         mxf_handle_missing_index_segment(mxf, s->streams[i]);
 
@@ -3705,7 +4377,8 @@ static int mxf_read_header(AVFormatContext *s)
         /* TODO: look up which IndexSID to use via EssenceContainerData */
         av_log(mxf->fc, AV_LOG_INFO, "got %i index tables - only the first one (IndexSID %i) will be used\n",
                mxf->nb_index_tables, mxf->index_tables[0].index_sid);
-    } else if (mxf->nb_index_tables == 0 && mxf->op == OPAtom && (s->error_recognition & AV_EF_EXPLODE)) {
+    } else if (mxf->nb_index_tables == 0 && !mxf->nb_lazy_index_klvs &&
+               mxf->op == OPAtom && (s->error_recognition & AV_EF_EXPLODE)) {
         av_log(mxf->fc, AV_LOG_ERROR, "cannot demux OPAtom without an index\n");
         return AVERROR_INVALIDDATA;
     }
@@ -3715,6 +4388,10 @@ static int mxf_read_header(AVFormatContext *s)
     for (int i = 0; i < s->nb_streams; i++)
         mxf_compute_edit_units_per_packet(mxf, s->streams[i]);
 
+    for (int i = 0; i < s->nb_streams; i++)
+        if ((ret = mxf_export_index_entries(mxf, s->streams[i])) < 0)
+            return ret;
+
     return 0;
 }
 
@@ -3866,13 +4543,46 @@ static int mxf_set_pts(MXFContext *mxf, AVStream *st, AVPacket *pkt)
     return 0;
 }
 
+#define MXF_AUDIO_REMAPPING(name, type, sample_size, rn, wn)                    \
+static void name(const int *channel_ordering, uint8_t *data,               \
+                 int number_of_samples, int channels)                      \
+{                                                                          \
+    type tmp[FF_SANE_NB_CHANNELS];                                         \
+                                                                           \
+    for (int sample = 0; sample < number_of_samples; ++sample) {           \
+        for (int channel = 0; channel < channels; ++channel)               \
+            tmp[channel] = rn(data + sample_size * channel);               \
+        for (int channel = 0; channel < channels; ++channel)               \
+            wn(data + sample_size * channel_ordering[channel], tmp[channel]); \
+        data += sample_size * channels;                                    \
+    }                                                                      \
+}
+
+MXF_AUDIO_REMAPPING(mxf_audio_remapping_16, uint16_t, 2, AV_RN16, AV_WN16)
+MXF_AUDIO_REMAPPING(mxf_audio_remapping_24, uint32_t, 3, AV_RL24, AV_WL24)
+MXF_AUDIO_REMAPPING(mxf_audio_remapping_32, uint32_t, 4, AV_RN32, AV_WN32)
+
 static int mxf_audio_remapping(int* channel_ordering, uint8_t* data, int size, int sample_size, int channels)
 {
     int sample_offset = channels * sample_size;
     int number_of_samples = size / sample_offset;
-    uint8_t* tmp = av_malloc(sample_offset);
+    uint8_t* tmp;
     uint8_t* data_ptr = data;
 
+    /* the samples of each channel are moved as whole words for the common sizes */
+    switch (channels <= FF_SANE_NB_CHANNELS ? sample_size : 0) {
+    case 2:
+        mxf_audio_remapping_16(channel_ordering, data, number_of_samples, channels);
+        return 0;
+    case 3:
+        mxf_audio_remapping_24(channel_ordering, data, number_of_samples, channels);
+        return 0;
+    case 4:
+        mxf_audio_remapping_32(channel_ordering, data, number_of_samples, channels);
+        return 0;
+    }
+
+    tmp = av_malloc(sample_offset);
     if (!tmp)
         return AVERROR(ENOMEM);
 
@@ -3889,27 +4599,34 @@ static int mxf_audio_remapping(int* channel_ordering, uint8_t* data, int size, i
     return 0;
 }
 
-static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
+static int mxf_read_essence_packet(AVFormatContext *s, AVPacket *pkt, MXFDecryptJob *job)
 {
     KLVPacket klv;
     MXFContext *mxf = s->priv_data;
+    AVIOContext *pb = mxf_essence_pb(s);
     int ret;
 
     while (1) {
         int64_t max_data_size;
-        int64_t pos = avio_tell(s->pb);
+        int64_t pos = avio_tell(pb);
 
         if (pos < mxf->current_klv_data.next_klv - mxf->current_klv_data.length || pos >= mxf->current_klv_data.next_klv) {
             mxf->current_klv_data = (KLVPacket){{0}};
-            ret = klv_read_packet(&klv, s->pb);
+            if ((ret = mxf_follow_klv(s, pb)) < 0)
+                return ret;
+            ret = klv_read_packet(&klv, pb);
             if (ret < 0)
                 break;
             max_data_size = klv.length;
             pos = klv.next_klv - klv.length;
             PRINT_KEY(s, "read packet", klv.key);
             av_log(s, AV_LOG_TRACE, "size %"PRIu64" offset %#"PRIx64"\n", klv.length, klv.offset);
+            if ((ret = mxf_follow_parse_klv(mxf, &klv)) < 0)
+                return ret;
+            if (ret)
+                continue;
             if (IS_KLV_KEY(klv.key, mxf_encrypted_triplet_key)) {
-                ret = mxf_decrypt_triplet(s, pkt, &klv);
+                ret = mxf_decrypt_triplet(s, pkt, &klv, job);
                 if (ret < 0) {
                     av_log(s, AV_LOG_ERROR, "invalid encoded triplet\n");
                     return ret;
@@ -3944,16 +4661,20 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
 
             next_ofs = mxf_set_current_edit_unit(mxf, st, pos, 1);
 
-            if (track->wrapping != FrameWrapped) {
+            if (track->wrapping != FrameWrapped || track->audio_packet_size) {
                 int64_t size;
 
                 if (next_ofs <= 0) {
                     // If we have no way to packetize the data, then return it in chunks...
-                    if (klv.next_klv - klv.length == pos && max_data_size > MXF_MAX_CHUNK_SIZE) {
-                        ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
-                        avpriv_request_sample(s, "Huge KLV without proper index in non-frame wrapped essence");
+                    if (track->audio_packet_size) {
+                        size = FFMIN(max_data_size, track->audio_packet_size);
+                    } else {
+                        if (klv.next_klv - klv.length == pos && max_data_size > MXF_MAX_CHUNK_SIZE) {
+                            ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
+                            avpriv_request_sample(s, "Huge KLV without proper index in non-frame wrapped essence");
+                        }
+                        size = FFMIN(max_data_size, MXF_MAX_CHUNK_SIZE);
                     }
-                    size = FFMIN(max_data_size, MXF_MAX_CHUNK_SIZE);
                 } else {
                     if ((size = next_ofs - pos) <= 0) {
                         av_log(s, AV_LOG_ERROR, "bad size: %"PRId64"\n", size);
@@ -3963,6 +4684,8 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
                     // We must not overread, because the next edit unit might be in another KLV
                     if (size > max_data_size)
                         size = max_data_size;
+                    if (track->audio_packet_size && size > track->audio_packet_size)
+                        size = track->audio_packet_size;
                 }
 
                 mxf->current_klv_data = klv;
@@ -3973,7 +4696,7 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
 
             /* check for 8 channels AES3 element */
             if (klv.key[12] == 0x06 && klv.key[13] == 0x01 && klv.key[14] == 0x10) {
-                ret = mxf_get_d10_aes3_packet(s->pb, s->streams[index],
+                ret = mxf_get_d10_aes3_packet(pb, s->streams[index],
                                               pkt, klv.length);
                 if (ret < 0) {
                     av_log(s, AV_LOG_ERROR, "error reading D-10 aes3 frame\n");
@@ -3988,7 +4711,13 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
                     return ret;
                 }
             } else {
-                ret = av_get_packet(s->pb, pkt, klv.length);
+                /* read several edit units per refill of the IO buffer */
+                ffio_hint_read_size(pb, FFMIN(klv.length, INT_MAX) * MXF_READ_HINT_UNITS);
+                if ((track->wrapping == FrameWrapped || track->audio_packet_size) &&
+                    klv.length <= MXF_MAX_POOLED_PACKET_SIZE)
+                    ret = av_get_packet_pooled(pb, mxf->pkt_pool, pkt, klv.length);
+                else
+                    ret = av_get_packet(pb, pkt, klv.length);
                 if (ret < 0) {
                     mxf->current_klv_data = (KLVPacket){{0}};
                     return ret;
@@ -4013,16 +4742,398 @@ static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
             }
 
             /* seek for truncated packets */
-            avio_seek(s->pb, klv.next_klv, SEEK_SET);
+            avio_seek(pb, klv.next_klv, SEEK_SET);
 
             return 0;
         } else {
         skip:
-            avio_skip(s->pb, max_data_size);
+            avio_skip(pb, max_data_size);
             mxf->current_klv_data = (KLVPacket){{0}};
         }
     }
-    return avio_feof(s->pb) ? AVERROR_EOF : ret;
+    return avio_feof(pb) ? AVERROR_EOF : ret;
+}
+
+static void mxf_decrypt_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    MXFContext *mxf = priv;
+    MXFDecryptJob *job = &mxf->decrypt_jobs[jobnr];
+
+    if (job->ret >= 0 && job->encrypted)
+        mxf_decrypt_packet(mxf->decrypt_aesc[threadnr], job->pkt, job->ivec,
+                           job->plaintext_size, job->orig_size);
+}
+
+static void mxf_free_decrypt_threads(MXFContext *mxf)
+{
+    avpriv_slicethread_free(&mxf->decrypt_thread);
+    if (mxf->decrypt_aesc)
+        for (int i = 0; i < mxf->decrypt_threads; i++)
+            av_freep(&mxf->decrypt_aesc[i]);
+    av_freep(&mxf->decrypt_aesc);
+    if (mxf->decrypt_jobs)
+        for (int i = 0; i < 2 * mxf->decrypt_threads; i++)
+            av_packet_free(&mxf->decrypt_jobs[i].pkt);
+    av_freep(&mxf->decrypt_jobs);
+    mxf->nb_decrypt_jobs = mxf->decrypt_job_index = 0;
+}
+
+static int mxf_init_decrypt_threads(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    int nb_threads, nb_jobs;
+
+    nb_threads = avpriv_slicethread_create(&mxf->decrypt_thread, mxf, mxf_decrypt_worker,
+                                           NULL, mxf->decrypt_threads);
+    if (nb_threads <= 0) {
+        av_log(s, AV_LOG_WARNING, "could not create decryption threads, decrypting on the demuxer thread\n");
+        mxf->decrypt_threads = 0;
+        return 0;
+    }
+
+    /* two packets per thread, so that each batch keeps all the threads busy */
+    mxf->decrypt_threads = nb_threads;
+    nb_jobs = 2 * nb_threads;
+    mxf->decrypt_aesc = av_calloc(nb_threads, sizeof(*mxf->decrypt_aesc));
+    mxf->decrypt_jobs = av_calloc(nb_jobs, sizeof(*mxf->decrypt_jobs));
+    if (!mxf->decrypt_aesc || !mxf->decrypt_jobs)
+        goto fail;
+    for (int i = 0; i < nb_threads; i++) {
+        if (!(mxf->decrypt_aesc[i] = av_aes_alloc()))
+            goto fail;
+        av_aes_init(mxf->decrypt_aesc[i], s->key, 128, 1);
+    }
+    for (int i = 0; i < nb_jobs; i++)
+        if (!(mxf->decrypt_jobs[i].pkt = av_packet_alloc()))
+            goto fail;
+
+    return 0;
+fail:
+    mxf_free_decrypt_threads(mxf);
+    mxf->decrypt_threads = 0;
+    return AVERROR(ENOMEM);
+}
+
+/**
+ * Reads a batch of packets and decrypts the encrypted ones on the worker
+ * threads: each triplet has its own IV, so that they are decrypted in parallel.
+ */
+static int mxf_read_decrypt_jobs(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+
+    mxf->nb_decrypt_jobs = mxf->decrypt_job_index = 0;
+    while (mxf->nb_decrypt_jobs < 2 * mxf->decrypt_threads) {
+        MXFDecryptJob *job = &mxf->decrypt_jobs[mxf->nb_decrypt_jobs++];
+
+        job->encrypted = 0;
+        if ((job->ret = mxf_read_essence_packet(s, job->pkt, job)) < 0)
+            break;
+    }
+    avpriv_slicethread_execute(mxf->decrypt_thread, mxf->nb_decrypt_jobs, 0);
+
+    return 0;
+}
+
+static void mxf_flush_decrypt_jobs(MXFContext *mxf)
+{
+    for (int i = mxf->decrypt_job_index; i < mxf->nb_decrypt_jobs; i++)
+        av_packet_unref(mxf->decrypt_jobs[i].pkt);
+    mxf->nb_decrypt_jobs = mxf->decrypt_job_index = 0;
+}
+
+#if HAVE_THREADS
+/**
+ * @return the end of the next read of the worker, which covers the next
+ * edit_units edit units of the index track, starting at pos
+ */
+static int64_t mxf_readahead_end(MXFReadAhead *ra, int64_t pos)
+{
+    MXFContext *mxf = ra->mxf;
+    int64_t edit_unit, end;
+
+    if (mxf_get_next_track_edit_unit(mxf, ra->track, pos, &edit_unit) >= 0 &&
+        mxf_edit_unit_absolute_offset(mxf, ra->index_table, edit_unit + ra->edit_units,
+                                      ra->track->edit_rate, NULL, &end, NULL, 0) >= 0 &&
+        end > pos)
+        return FFMIN(end, pos + MXF_MAX_CHUNK_SIZE);
+
+    return pos + MXF_READAHEAD_SIZE;
+}
+
+static void *mxf_readahead_thread(void *arg)
+{
+    MXFReadAhead *ra = arg;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->abort) {
+        MXFReadAheadSlot *slot;
+        unsigned generation;
+        int64_t pos, size;
+        int ret;
+
+        if (ra->eof || ra->count == MXF_READAHEAD_SLOTS) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        /* the demuxer does not access the slots which are not read yet */
+        slot       = &ra->slots[(ra->first + ra->count) % MXF_READAHEAD_SLOTS];
+        generation = ra->generation;
+        pos        = ra->fill_pos;
+        pthread_mutex_unlock(&ra->mutex);
+
+        size = mxf_readahead_end(ra, pos) - pos;
+        av_fast_malloc(&slot->data, &slot->alloc_size, size);
+        if (!slot->data)
+            ret = AVERROR(ENOMEM);
+        else if ((ret = avio_seek(ra->worker_pb, pos, SEEK_SET)) >= 0)
+            ret = avio_read(ra->worker_pb, slot->data, size);
+
+        pthread_mutex_lock(&ra->mutex);
+        if (generation != ra->generation)
+            continue;
+        if (ret > 0) {
+            slot->pos  = pos;
+            slot->size = ret;
+            ra->count++;
+            ra->fill_pos += ret;
+        }
+        if (ret < size)
+            ra->eof = ret < 0 ? ret : AVERROR_EOF;
+        pthread_cond_signal(&ra->cond);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+static int mxf_readahead_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    MXFReadAhead *ra = opaque;
+    MXFReadAheadSlot *slot;
+    int ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->count && !ra->eof)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+
+    if (!ra->count) {
+        ret = ra->eof;
+    } else {
+        slot = &ra->slots[ra->first];
+        ret  = FFMIN(buf_size, slot->size - ra->consumed);
+        memcpy(buf, slot->data + ra->consumed, ret);
+        ra->consumed += ret;
+        if (ra->consumed == slot->size) {
+            ra->first    = (ra->first + 1) % MXF_READAHEAD_SLOTS;
+            ra->consumed = 0;
+            ra->count--;
+            pthread_cond_signal(&ra->cond);
+        }
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return ret;
+}
+
+static int64_t mxf_readahead_seek(void *opaque, int64_t offset, int whence)
+{
+    MXFReadAhead *ra = opaque;
+
+    if (whence == AVSEEK_SIZE)
+        return ra->file_size;
+    if (whence != SEEK_SET || offset < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&ra->mutex);
+    /* drop the slots before the offset, and restart the worker from the
+     * offset unless it lies in the slots already read */
+    while (ra->count && offset >= ra->slots[ra->first].pos + ra->slots[ra->first].size) {
+        ra->first = (ra->first + 1) % MXF_READAHEAD_SLOTS;
+        ra->count--;
+    }
+    if (ra->count && offset >= ra->slots[ra->first].pos) {
+        ra->consumed = offset - ra->slots[ra->first].pos;
+    } else if (ra->count || offset != ra->fill_pos) {
+        ra->first    = 0;
+        ra->count    = 0;
+        ra->consumed = 0;
+        ra->fill_pos = offset;
+        ra->eof      = 0;
+        ra->generation++;
+    } else {
+        ra->consumed = 0;
+    }
+    pthread_cond_signal(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+
+    return offset;
+}
+#endif
+
+static void mxf_free_readahead(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MXFContext *mxf = s->priv_data;
+    MXFReadAhead *ra = mxf->readahead;
+
+    if (!ra)
+        return;
+
+    pthread_mutex_lock(&ra->mutex);
+    ra->abort = 1;
+    pthread_cond_signal(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+    pthread_join(ra->thread, NULL);
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->mutex);
+
+    for (int i = 0; i < MXF_READAHEAD_SLOTS; i++)
+        av_freep(&ra->slots[i].data);
+    if (ra->pb)
+        av_freep(&ra->pb->buffer);
+    avio_context_free(&ra->pb);
+    ff_format_io_close(s, &ra->worker_pb);
+    av_freep(&mxf->readahead);
+#endif
+}
+
+/**
+ * Starts reading ahead the essence at the current position, from a second
+ * connection to the file. On failure, the essence is read from s->pb.
+ */
+static int mxf_init_readahead(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+#if HAVE_THREADS
+    MXFReadAhead *ra;
+    uint8_t *buf;
+    int ret;
+
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return 0;
+
+    if (!(ra = av_mallocz(sizeof(*ra))))
+        return AVERROR(ENOMEM);
+    ra->mxf        = mxf;
+    ra->edit_units = mxf->readahead_edit_units;
+    ra->file_size = avio_size(s->pb);
+
+    for (int i = 0; i < s->nb_streams && !ra->track; i++) {
+        MXFTrack *track = s->streams[i]->priv_data;
+        MXFIndexTable *t;
+
+        if (track && track->original_duration > 0 &&
+            (t = mxf_find_index_table(mxf, track->index_sid)) && t->nb_segments) {
+            ra->track       = track;
+            ra->index_table = t;
+        }
+    }
+    if (!ra->track) {
+        av_log(s, AV_LOG_VERBOSE, "No index table to read ahead the essence\n");
+        av_free(ra);
+        return 0;
+    }
+
+    if ((ret = s->io_open(s, &ra->worker_pb, s->url, AVIO_FLAG_READ, NULL)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not open %s to read ahead the essence: %s\n",
+               s->url, av_err2str(ret));
+        av_free(ra);
+        return 0;
+    }
+    if (!(buf = av_malloc(MXF_READAHEAD_IO_BUFFER_SIZE)) ||
+        !(ra->pb = avio_alloc_context(buf, MXF_READAHEAD_IO_BUFFER_SIZE, 0, ra, mxf_readahead_read, NULL, mxf_readahead_seek))) {
+        av_free(buf);
+        ff_format_io_close(s, &ra->worker_pb);
+        av_free(ra);
+        return AVERROR(ENOMEM);
+    }
+    ra->pb->seekable = AVIO_SEEKABLE_NORMAL;
+    ra->pb->pos      = avio_tell(s->pb);
+    ra->fill_pos     = ra->pb->pos;
+
+    if ((ret = pthread_mutex_init(&ra->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&ra->cond, NULL))) {
+        pthread_mutex_destroy(&ra->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&ra->thread, NULL, mxf_readahead_thread, ra))) {
+        pthread_cond_destroy(&ra->cond);
+        pthread_mutex_destroy(&ra->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Reading ahead the essence in ranges of %d edit units\n", ra->edit_units);
+    mxf->readahead = ra;
+    return 0;
+
+fail:
+    av_log(s, AV_LOG_WARNING, "Could not start reading ahead the essence: %s\n", av_err2str(ret));
+    av_freep(&ra->pb->buffer);
+    avio_context_free(&ra->pb);
+    ff_format_io_close(s, &ra->worker_pb);
+    av_free(ra);
+    return 0;
+#else
+    av_log(s, AV_LOG_WARNING, "Reading ahead requires threading support\n");
+    return 0;
+#endif
+}
+
+static int mxf_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFDecryptJob *job;
+    int ret;
+
+    /* the index tables are complete once the header is read */
+    if (mxf->readahead_edit_units > 0 && !mxf->readahead) {
+        if ((ret = mxf_load_lazy_index(mxf)) < 0)
+            return ret;
+        ret = mxf_init_readahead(s);
+        mxf->readahead_edit_units = 0;
+        if (ret < 0)
+            return ret;
+    }
+    if (mxf->decrypt_threads > 1 && s->key && s->keylen == 16 && !mxf->decrypt_thread &&
+        (ret = mxf_init_decrypt_threads(s)) < 0)
+        return ret;
+    if (!mxf->decrypt_thread)
+        return mxf_read_essence_packet(s, pkt, NULL);
+
+    if (mxf->decrypt_job_index == mxf->nb_decrypt_jobs &&
+        (ret = mxf_read_decrypt_jobs(s)) < 0)
+        return ret;
+
+    job = &mxf->decrypt_jobs[mxf->decrypt_job_index++];
+    if (job->ret < 0)
+        return job->ret;
+    av_packet_move_ref(pkt, job->pkt);
+
+    return 0;
+}
+
+static int mxf_read_packets(AVFormatContext *s, AVPacket **pkts, int *nb_pkts,
+                            int64_t max_size)
+{
+    int64_t size = 0;
+    int n, ret = 0;
+
+    for (n = 0; n < *nb_pkts && (max_size <= 0 || size < max_size); n++) {
+        if ((ret = mxf_read_packet(s, pkts[n])) < 0) {
+            av_packet_unref(pkts[n]);
+            break;
+        }
+        size += pkts[n]->size;
+    }
+    *nb_pkts = n;
+
+    return ret;
 }
 
 static int mxf_read_close(AVFormatContext *s)
@@ -4030,6 +5141,8 @@ static int mxf_read_close(AVFormatContext *s)
     MXFContext *mxf = s->priv_data;
     int i;
 
+    mxf_free_readahead(s);
+
     av_freep(&mxf->packages_refs);
     av_freep(&mxf->essence_container_data_refs);
 
@@ -4042,18 +5155,17 @@ static int mxf_read_close(AVFormatContext *s)
     mxf->metadata_sets_count = 0;
     av_freep(&mxf->partitions);
     av_freep(&mxf->metadata_sets);
+    av_freep(&mxf->metadata_set_buckets);
+    av_freep(&mxf->rip_offsets);
+    av_freep(&mxf->lazy_index_klvs);
+    av_packet_pool_free(&mxf->pkt_pool);
+    av_freep(&mxf->metadata_set_next);
+    mxf->metadata_set_buckets_count = 0;
     av_freep(&mxf->aesc);
+    mxf_free_decrypt_threads(mxf);
     av_freep(&mxf->local_tags);
 
-    if (mxf->index_tables) {
-        for (i = 0; i < mxf->nb_index_tables; i++) {
-            av_freep(&mxf->index_tables[i].segments);
-            av_freep(&mxf->index_tables[i].ptses);
-            av_freep(&mxf->index_tables[i].fake_index);
-            av_freep(&mxf->index_tables[i].offsets);
-        }
-    }
-    av_freep(&mxf->index_tables);
+    mxf_free_index_tables(mxf);
 
     return 0;
 }
@@ -4098,6 +5210,12 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
     if (!source_track)
         return 0;
 
+    /* the packets decrypted ahead of the seek point are dropped */
+    mxf_flush_decrypt_jobs(mxf);
+
+    if ((ret = mxf_load_lazy_index(mxf)) < 0)
+        return ret;
+
     /* if audio then truncate sample_time to EditRate */
     if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
         sample_time = av_rescale_q(sample_time, st->time_base,
@@ -4110,7 +5228,7 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
             sample_time = 0;
         seconds = av_rescale(sample_time, st->time_base.num, st->time_base.den);
 
-        seekpos = avio_seek(s->pb, (s->bit_rate * seconds) >> 3, SEEK_SET);
+        seekpos = avio_seek(mxf_essence_pb(s), (s->bit_rate * seconds) >> 3, SEEK_SET);
         if (seekpos < 0)
             return seekpos;
 
@@ -4178,7 +5296,7 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         } else {
             mxf->current_klv_data = (KLVPacket){{0}};
         }
-        avio_seek(s->pb, seekpos, SEEK_SET);
+        avio_seek(mxf_essence_pb(s), seekpos, SEEK_SET);
     }
 
     // Update all tracks sample count
@@ -4202,6 +5320,27 @@ static const AVOption options[] = {
     { "skip_audio_reordering", "skip audio reordering based on Multi-Channel Audio labelling",
       offsetof(MXFContext, skip_audio_reordering), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
       AV_OPT_FLAG_DECODING_PARAM },
+    { "decrypt_threads", "number of threads decrypting encrypted essence (0 to decrypt on the demuxer thread)",
+      offsetof(MXFContext, decrypt_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "audio_packet_duration", "maximum duration of the packets of PCM essence (0 to follow the edit units)",
+      offsetof(MXFContext, audio_packet_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead_edit_units", "read the essence ahead on a worker thread, in ranges of this many edit units of the index (0 to disable)",
+      offsetof(MXFContext, readahead_edit_units), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "use_rip", "visit the partitions listed in the Random Index Pack in file order",
+      offsetof(MXFContext, use_rip), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "lazy_index", "defer the parsing of the index table segments to the first seek when the essence can be read without them",
+      offsetof(MXFContext, lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "follow", "read a file that is still being written, waiting for its essence until the FooterPartition is written",
+      offsetof(MXFContext, follow), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,
+      AV_OPT_FLAG_DECODING_PARAM },
+    { "follow_timeout", "time after which a followed file that stops growing is considered ended",
+      offsetof(MXFContext, follow_timeout), AV_OPT_TYPE_DURATION, {.i64 = 10000000}, 0, INT64_MAX,
+      AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -4222,6 +5361,7 @@ const AVInputFormat ff_mxf_demuxer = {
     .read_probe     = mxf_probe,
     .read_header    = mxf_read_header,
     .read_packet    = mxf_read_packet,
+    .read_packets   = mxf_read_packets,
     .read_close     = mxf_read_close,
     .read_seek      = mxf_read_seek,
     .priv_class     = &demuxer_class,
@@ -46,6 +46,8 @@
 #include "libavutil/avassert.h"
 #include "libavutil/mastering_display_metadata.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time_internal.h"
 #include "libavcodec/bytestream.h"
 #include "libavcodec/dnxhddata.h"
@@ -74,6 +76,8 @@ typedef struct MXFIndexEntry {
     uint8_t flags;
 } MXFIndexEntry;
 
+#define MXF_J2K_MAX_COMPONENTS 4
+
 typedef struct MXFStreamContext {
     int64_t pkt_cnt;         ///< pkt counter for muxed packets
     UID track_essence_element_key;
@@ -99,6 +103,16 @@ typedef struct MXFStreamContext {
     int b_picture_count;     ///< maximum number of consecutive b pictures, used in mpeg-2 descriptor
     int low_delay;           ///< low delay, used in mpeg-2 descriptor
     int avc_intra;
+    int j2k_info_parsed;     ///< the fields of the jpeg 2000 sub descriptor were parsed
+    uint16_t j2k_rsiz;
+    uint32_t j2k_xsiz, j2k_ysiz, j2k_xosiz, j2k_yosiz;
+    uint32_t j2k_xtsiz, j2k_ytsiz, j2k_xtosiz, j2k_ytosiz;
+    uint16_t j2k_csiz;
+    uint8_t j2k_component_sizing[3 * MXF_J2K_MAX_COMPONENTS]; ///< Ssiz, XRsiz and YRsiz of each component
+    uint8_t j2k_cod[64];     ///< coding style default marker segment, without marker and length
+    int j2k_cod_size;
+    uint8_t j2k_qcd[256];    ///< quantization default marker segment, without marker and length
+    int j2k_qcd_size;
 } MXFStreamContext;
 
 typedef struct MXFContainerEssenceEntry {
@@ -381,6 +395,20 @@ static const MXFLocalTagPair mxf_local_tag_batch[] = {
     { 0x8200, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0E,0x04,0x01,0x06,0x06,0x01,0x0E,0x00,0x00}}, /* AVC Decoding Delay */
     { 0x8201, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0E,0x04,0x01,0x06,0x06,0x01,0x0A,0x00,0x00}}, /* AVC Profile */
     { 0x8202, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0E,0x04,0x01,0x06,0x06,0x01,0x0D,0x00,0x00}}, /* AVC Level */
+    // mxf_jpeg2000_subdescriptor_local_tags
+    { 0x8400, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x01,0x00,0x00,0x00}}, /* Rsiz */
+    { 0x8401, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x02,0x00,0x00,0x00}}, /* Xsiz */
+    { 0x8402, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x03,0x00,0x00,0x00}}, /* Ysiz */
+    { 0x8403, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x04,0x00,0x00,0x00}}, /* XOsiz */
+    { 0x8404, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x05,0x00,0x00,0x00}}, /* YOsiz */
+    { 0x8405, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x06,0x00,0x00,0x00}}, /* XTsiz */
+    { 0x8406, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x07,0x00,0x00,0x00}}, /* YTsiz */
+    { 0x8407, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x08,0x00,0x00,0x00}}, /* XTOsiz */
+    { 0x8408, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x09,0x00,0x00,0x00}}, /* YTOsiz */
+    { 0x8409, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x0A,0x00,0x00,0x00}}, /* Csiz */
+    { 0x840A, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x0B,0x00,0x00,0x00}}, /* Picture Component Sizing */
+    { 0x840B, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x0C,0x00,0x00,0x00}}, /* Coding Style Default */
+    { 0x840C, {0x06,0x0E,0x2B,0x34,0x01,0x01,0x01,0x0A,0x04,0x01,0x06,0x03,0x0D,0x00,0x00,0x00}}, /* Quantization Default */
     // ff_mxf_mastering_display_local_tags
     { 0x8301, FF_MXF_MasteringDisplayPrimaries },
     { 0x8302, FF_MXF_MasteringDisplayWhitePointChromaticity },
@@ -420,9 +448,31 @@ typedef struct MXFContext {
     int store_user_comments;
     int track_instance_count; // used to generate MXFTrack uuids
     int cbr_index;           ///< use a constant bitrate index
+    int imf;                 ///< write an IMF track file
+    int write_once;          ///< never seek back, the footer has the complete metadata
     uint8_t unused_tags[MXF_NUM_TAGS];  ///< local tags that we know will not be used
+    int write_queue_size;    ///< number of blocks queued to the writer thread, 0 to write inline
+    AVIOContext *writer_pb;  ///< context the muxer writes to, drained by the writer thread
+    AVIOContext *output_pb;  ///< output context, written by the writer thread
+    int64_t writer_pos;      ///< offset of the next byte written to writer_pb
+    int64_t writer_size;     ///< end of the bytes written to writer_pb
+    int output_min_packet_size;
+#if HAVE_THREADS
+    AVThreadMessageQueue *writer_queue;
+    pthread_t writer_thread;
+    int writer_thread_running;
+#endif
 } MXFContext;
 
+#define MXF_WRITER_BUFFER_SIZE (1 << 20)
+
+/* block of the output written by the writer thread */
+typedef struct MXFWriterMsg {
+    uint8_t *data;           ///< bytes to write, or NULL to seek
+    int size;
+    int64_t pos;             ///< offset to seek to
+} MXFWriterMsg;
+
 static void mxf_write_uuid(AVIOContext *pb, enum MXFMetadataSetType type, int value)
 {
     avio_write(pb, uuid_base, 12);
@@ -521,13 +571,16 @@ static void mxf_write_primer_pack(AVFormatContext *s)
     MXFContext *mxf = s->priv_data;
     AVIOContext *pb = s->pb;
     int local_tag_number = MXF_NUM_TAGS, i;
-    int will_have_avc_tags = 0, will_have_mastering_tags = 0;
+    int will_have_avc_tags = 0, will_have_mastering_tags = 0, will_have_j2k_tags = 0;
 
     for (i = 0; i < s->nb_streams; i++) {
         MXFStreamContext *sc = s->streams[i]->priv_data;
         if (s->streams[i]->codecpar->codec_id == AV_CODEC_ID_H264 && !sc->avc_intra) {
             will_have_avc_tags = 1;
         }
+        if (sc->j2k_info_parsed) {
+            will_have_j2k_tags = 1;
+        }
         if (av_stream_get_side_data(s->streams[i], AV_PKT_DATA_MASTERING_DISPLAY_METADATA, NULL)) {
             will_have_mastering_tags = 1;
         }
@@ -539,13 +592,20 @@ static void mxf_write_primer_pack(AVFormatContext *s)
         mxf_mark_tag_unused(mxf, 0x5003);
     }
 
-    if (!will_have_avc_tags) {
+    if (!will_have_avc_tags && !will_have_j2k_tags)
         mxf_mark_tag_unused(mxf, 0x8100);
+
+    if (!will_have_avc_tags) {
         mxf_mark_tag_unused(mxf, 0x8200);
         mxf_mark_tag_unused(mxf, 0x8201);
         mxf_mark_tag_unused(mxf, 0x8202);
     }
 
+    if (!will_have_j2k_tags) {
+        for (i = 0x8400; i <= 0x840C; i++)
+            mxf_mark_tag_unused(mxf, i);
+    }
+
     if (!will_have_mastering_tags) {
         mxf_mark_tag_unused(mxf, 0x8301);
         mxf_mark_tag_unused(mxf, 0x8302);
@@ -1092,6 +1152,7 @@ static const UID mxf_cdci_descriptor_key      = { 0x06,0x0E,0x2B,0x34,0x02,0x53,
 static const UID mxf_generic_sound_descriptor_key = { 0x06,0x0E,0x2B,0x34,0x02,0x53,0x01,0x01,0x0D,0x01,0x01,0x01,0x01,0x01,0x42,0x00 };
 
 static const UID mxf_avc_subdescriptor_key = { 0x06,0x0E,0x2B,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x01,0x01,0x01,0x01,0x6E,0x00 };
+static const UID mxf_jpeg2000_subdescriptor_key = { 0x06,0x0E,0x2B,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x01,0x01,0x01,0x01,0x5A,0x00 };
 
 static inline uint16_t rescale_mastering_chroma(AVRational q)
 {
@@ -1105,6 +1166,7 @@ static inline uint32_t rescale_mastering_luma(AVRational q)
 
 static int64_t mxf_write_cdci_common(AVFormatContext *s, AVStream *st, const UID key)
 {
+    MXFContext *mxf = s->priv_data;
     MXFStreamContext *sc = st->priv_data;
     AVIOContext *pb = s->pb;
     int stored_width = 0;
@@ -1127,6 +1189,10 @@ static int64_t mxf_write_cdci_common(AVFormatContext *s, AVStream *st, const UID
         else if (st->codecpar->height == 720)
             stored_width = 1280;
     }
+    if (mxf->imf) { // jpeg 2000 has no macroblock padding
+        stored_width  = st->codecpar->width;
+        stored_height = st->codecpar->height;
+    }
     if (!stored_width)
         stored_width = (st->codecpar->width+15)/16*16;
 
@@ -1324,6 +1390,13 @@ static int64_t mxf_write_cdci_common(AVFormatContext *s, AVStream *st, const UID
         mxf_write_uuid(pb, AVCSubDescriptor, 0);
     }
 
+    if (sc->j2k_info_parsed) {
+        // write jpeg 2000 sub descriptor ref
+        mxf_write_local_tag(s, 8 + 16, 0x8100);
+        mxf_write_refs_count(pb, 1);
+        mxf_write_uuid(pb, JPEG2000SubDescriptor, 0);
+    }
+
     return pos;
 }
 
@@ -1360,14 +1433,67 @@ static void mxf_write_avc_subdesc(AVFormatContext *s, AVStream *st)
     mxf_update_klv_size(s->pb, pos);
 }
 
+static void mxf_write_jpeg2000_subdesc(AVFormatContext *s, AVStream *st)
+{
+    AVIOContext *pb = s->pb;
+    MXFStreamContext *sc = st->priv_data;
+    int64_t pos;
+
+    avio_write(pb, mxf_jpeg2000_subdescriptor_key, 16);
+    klv_encode_ber4_length(pb, 0);
+    pos = avio_tell(pb);
+
+    mxf_write_local_tag(s, 16, 0x3C0A);
+    mxf_write_uuid(pb, JPEG2000SubDescriptor, 0);
+
+    mxf_write_local_tag(s, 2, 0x8400);
+    avio_wb16(pb, sc->j2k_rsiz);
+    mxf_write_local_tag(s, 4, 0x8401);
+    avio_wb32(pb, sc->j2k_xsiz);
+    mxf_write_local_tag(s, 4, 0x8402);
+    avio_wb32(pb, sc->j2k_ysiz);
+    mxf_write_local_tag(s, 4, 0x8403);
+    avio_wb32(pb, sc->j2k_xosiz);
+    mxf_write_local_tag(s, 4, 0x8404);
+    avio_wb32(pb, sc->j2k_yosiz);
+    mxf_write_local_tag(s, 4, 0x8405);
+    avio_wb32(pb, sc->j2k_xtsiz);
+    mxf_write_local_tag(s, 4, 0x8406);
+    avio_wb32(pb, sc->j2k_ytsiz);
+    mxf_write_local_tag(s, 4, 0x8407);
+    avio_wb32(pb, sc->j2k_xtosiz);
+    mxf_write_local_tag(s, 4, 0x8408);
+    avio_wb32(pb, sc->j2k_ytosiz);
+    mxf_write_local_tag(s, 2, 0x8409);
+    avio_wb16(pb, sc->j2k_csiz);
+
+    // picture component sizing, an array of 3 byte items
+    mxf_write_local_tag(s, 8 + 3 * sc->j2k_csiz, 0x840A);
+    avio_wb32(pb, sc->j2k_csiz);
+    avio_wb32(pb, 3);
+    avio_write(pb, sc->j2k_component_sizing, 3 * sc->j2k_csiz);
+
+    mxf_write_local_tag(s, sc->j2k_cod_size, 0x840B);
+    avio_write(pb, sc->j2k_cod, sc->j2k_cod_size);
+
+    mxf_write_local_tag(s, sc->j2k_qcd_size, 0x840C);
+    avio_write(pb, sc->j2k_qcd, sc->j2k_qcd_size);
+
+    mxf_update_klv_size(s->pb, pos);
+}
+
 static void mxf_write_cdci_desc(AVFormatContext *s, AVStream *st)
 {
+    MXFStreamContext *sc = st->priv_data;
     int64_t pos = mxf_write_cdci_common(s, st, mxf_cdci_descriptor_key);
     mxf_update_klv_size(s->pb, pos);
 
     if (st->codecpar->codec_id == AV_CODEC_ID_H264) {
         mxf_write_avc_subdesc(s, st);
     }
+    if (sc->j2k_info_parsed) {
+        mxf_write_jpeg2000_subdesc(s, st);
+    }
 }
 
 static void mxf_write_h264_desc(AVFormatContext *s, AVStream *st)
@@ -1789,44 +1915,55 @@ static void mxf_write_index_table_segment(AVFormatContext *s)
 
     // real slice count - 1
     mxf_write_local_tag(s, 1, 0x3F08);
-    avio_w8(pb, !mxf->edit_unit_byte_count); // only one slice for CBR
+    avio_w8(pb, !mxf->edit_unit_byte_count && !mxf->imf); // only one slice for CBR and IMF
 
-    // delta entry array
-    mxf_write_local_tag(s, 8 + (s->nb_streams+1)*6, 0x3F09);
-    avio_wb32(pb, s->nb_streams+1); // num of entries
-    avio_wb32(pb, 6);               // size of one entry
-    // write system item delta entry
-    avio_w8(pb, 0);
-    avio_w8(pb, 0); // slice entry
-    avio_wb32(pb, 0); // element delta
-    // write each stream delta entry
-    for (i = 0; i < s->nb_streams; i++) {
-        AVStream *st = s->streams[i];
-        MXFStreamContext *sc = st->priv_data;
-        avio_w8(pb, sc->temporal_reordering);
-        if (sc->temporal_reordering)
-            temporal_reordering = 1;
-        if (mxf->edit_unit_byte_count) {
-            avio_w8(pb, 0); // slice number
-            avio_wb32(pb, sc->slice_offset);
-        } else if (i == 0) { // video track
-            avio_w8(pb, 0); // slice number
-            avio_wb32(pb, KAG_SIZE); // system item size including klv fill
-        } else { // audio or data track
-            if (!audio_frame_size) {
-                audio_frame_size = sc->frame_size;
-                audio_frame_size += klv_fill_size(audio_frame_size);
+    if (mxf->imf) {
+        // single essence element, no system item
+        mxf_write_local_tag(s, 8 + 6, 0x3F09);
+        avio_wb32(pb, 1); // num of entries
+        avio_wb32(pb, 6); // size of one entry
+        avio_w8(pb, 0);
+        avio_w8(pb, 0); // slice entry
+        avio_wb32(pb, 0); // element delta
+    } else {
+        // delta entry array
+        mxf_write_local_tag(s, 8 + (s->nb_streams+1)*6, 0x3F09);
+        avio_wb32(pb, s->nb_streams+1); // num of entries
+        avio_wb32(pb, 6);               // size of one entry
+        // write system item delta entry
+        avio_w8(pb, 0);
+        avio_w8(pb, 0); // slice entry
+        avio_wb32(pb, 0); // element delta
+        // write each stream delta entry
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            MXFStreamContext *sc = st->priv_data;
+            avio_w8(pb, sc->temporal_reordering);
+            if (sc->temporal_reordering)
+                temporal_reordering = 1;
+            if (mxf->edit_unit_byte_count) {
+                avio_w8(pb, 0); // slice number
+                avio_wb32(pb, sc->slice_offset);
+            } else if (i == 0) { // video track
+                avio_w8(pb, 0); // slice number
+                avio_wb32(pb, KAG_SIZE); // system item size including klv fill
+            } else { // audio or data track
+                if (!audio_frame_size) {
+                    audio_frame_size = sc->frame_size;
+                    audio_frame_size += klv_fill_size(audio_frame_size);
+                }
+                avio_w8(pb, 1);
+                avio_wb32(pb, (i-1)*audio_frame_size); // element delta
             }
-            avio_w8(pb, 1);
-            avio_wb32(pb, (i-1)*audio_frame_size); // element delta
         }
     }
 
     if (!mxf->edit_unit_byte_count) {
         MXFStreamContext *sc = s->streams[0]->priv_data;
-        mxf_write_local_tag(s, 8 + mxf->edit_units_count*15, 0x3F0A);
+        int entry_size = mxf->imf ? 11 : 15; // no slice offset without slices
+        mxf_write_local_tag(s, 8 + mxf->edit_units_count*entry_size, 0x3F0A);
         avio_wb32(pb, mxf->edit_units_count);  // num of entries
-        avio_wb32(pb, 15);  // size of one entry
+        avio_wb32(pb, entry_size);  // size of one entry
 
         for (i = 0; i < mxf->edit_units_count; i++) {
             int temporal_offset = 0;
@@ -1867,6 +2004,8 @@ static void mxf_write_index_table_segment(AVFormatContext *s)
             avio_w8(pb, mxf->index_entries[i].flags);
             // stream offset
             avio_wb64(pb, mxf->index_entries[i].offset);
+            if (mxf->imf)
+                continue;
             if (s->nb_streams > 1)
                 avio_wb32(pb, mxf->index_entries[i].slice_offset);
             else
@@ -1899,12 +2038,16 @@ static int mxf_write_partition(AVFormatContext *s, int bodysid,
 {
     MXFContext *mxf = s->priv_data;
     AVIOContext *pb = s->pb;
-    int64_t header_byte_count_offset;
     unsigned index_byte_count = 0;
     uint64_t partition_offset = avio_tell(pb);
+    uint64_t header_byte_count = 0;
+    uint8_t *metadata = NULL;
+    int metadata_size = 0;
     int err;
 
-    if (!mxf->edit_unit_byte_count && mxf->edit_units_count)
+    if (!mxf->edit_unit_byte_count && mxf->edit_units_count && mxf->imf)
+        index_byte_count = 85 + 12+6 + 12+mxf->edit_units_count*11;
+    else if (!mxf->edit_unit_byte_count && mxf->edit_units_count)
         index_byte_count = 85 + 12+(s->nb_streams+1)*6 +
             12+mxf->edit_units_count*15;
     else if (mxf->edit_unit_byte_count && indexsid)
@@ -1915,10 +2058,31 @@ static int mxf_write_partition(AVFormatContext *s, int bodysid,
         index_byte_count += klv_fill_size(index_byte_count);
     }
 
+    if (write_metadata) {
+        // the metadata is built in memory first, so that its size is
+        // known without seeking back in the output
+        AVIOContext *dyn_pb;
+
+        if ((err = avio_open_dyn_buf(&dyn_pb)) < 0)
+            return err;
+        // the metadata starts on a KAG boundary, so the fill sizes
+        // computed in the buffer are the same as in the output
+        s->pb = dyn_pb;
+        mxf_write_primer_pack(s);
+        mxf_write_klv_fill(s);
+        mxf_write_header_metadata_sets(s);
+        s->pb = pb;
+        metadata_size = avio_close_dyn_buf(dyn_pb, &metadata);
+        if (metadata_size < 0)
+            return metadata_size;
+        header_byte_count = metadata_size + klv_fill_size(metadata_size);
+    }
+
     if (key && !memcmp(key, body_partition_key, 16)) {
         if ((err = av_reallocp_array(&mxf->body_partition_offset, mxf->body_partitions_count + 1,
                                      sizeof(*mxf->body_partition_offset))) < 0) {
             mxf->body_partitions_count = 0;
+            av_free(metadata);
             return err;
         }
         mxf->body_partition_offset[mxf->body_partitions_count++] = partition_offset;
@@ -1948,9 +2112,7 @@ static int mxf_write_partition(AVFormatContext *s, int bodysid,
 
     avio_wb64(pb, mxf->footer_partition_offset); // footerPartition
 
-    // set offset
-    header_byte_count_offset = avio_tell(pb);
-    avio_wb64(pb, 0); // headerByteCount, update later
+    avio_wb64(pb, header_byte_count); // headerByteCount
 
     // indexTable
     avio_wb64(pb, index_byte_count); // indexByteCount
@@ -1974,22 +2136,9 @@ static int mxf_write_partition(AVFormatContext *s, int bodysid,
     mxf_write_essence_container_refs(s);
 
     if (write_metadata) {
-        // mark the start of the headermetadata and calculate metadata size
-        int64_t pos, start;
-        unsigned header_byte_count;
-
-        mxf_write_klv_fill(s);
-        start = avio_tell(s->pb);
-        mxf_write_primer_pack(s);
         mxf_write_klv_fill(s);
-        mxf_write_header_metadata_sets(s);
-        pos = avio_tell(s->pb);
-        header_byte_count = pos - start + klv_fill_size(pos);
-
-        // update header_byte_count
-        avio_seek(pb, header_byte_count_offset, SEEK_SET);
-        avio_wb64(pb, header_byte_count);
-        avio_seek(pb, pos, SEEK_SET);
+        avio_write(pb, metadata, metadata_size);
+        av_free(metadata);
     }
 
     if(key)
@@ -2010,6 +2159,62 @@ static const struct {
     { FF_PROFILE_PRORES_XQ,       { 0x06,0x0E,0x2B,0x34,0x04,0x01,0x01,0x0d,0x04,0x01,0x02,0x02,0x03,0x06,0x06,0x00 } },
 };
 
+static int mxf_parse_jpeg2000_frame(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                                    MXFIndexEntry *e)
+{
+    MXFContext *mxf = s->priv_data;
+    MXFStreamContext *sc = st->priv_data;
+    GetByteContext g;
+    int len;
+
+    e->flags |= 0x80; // intra only, every frame is a random access point
+
+    if (mxf->header_written)
+        return 1;
+
+    bytestream2_init(&g, pkt->data, pkt->size);
+    if (bytestream2_get_be16(&g) != 0xFF4F || // SOC
+        bytestream2_get_be16(&g) != 0xFF51)   // SIZ
+        return 0;
+    len = bytestream2_get_be16(&g);
+    sc->j2k_rsiz   = bytestream2_get_be16(&g);
+    sc->j2k_xsiz   = bytestream2_get_be32(&g);
+    sc->j2k_ysiz   = bytestream2_get_be32(&g);
+    sc->j2k_xosiz  = bytestream2_get_be32(&g);
+    sc->j2k_yosiz  = bytestream2_get_be32(&g);
+    sc->j2k_xtsiz  = bytestream2_get_be32(&g);
+    sc->j2k_ytsiz  = bytestream2_get_be32(&g);
+    sc->j2k_xtosiz = bytestream2_get_be32(&g);
+    sc->j2k_ytosiz = bytestream2_get_be32(&g);
+    sc->j2k_csiz   = bytestream2_get_be16(&g);
+    if (!sc->j2k_csiz || sc->j2k_csiz > MXF_J2K_MAX_COMPONENTS ||
+        len != 38 + 3 * sc->j2k_csiz ||
+        bytestream2_get_buffer(&g, sc->j2k_component_sizing, 3 * sc->j2k_csiz) != 3 * sc->j2k_csiz)
+        return 0;
+
+    // main header marker segments, up to the first tile-part
+    while (bytestream2_get_bytes_left(&g) >= 4) {
+        int marker = bytestream2_get_be16(&g);
+        if (marker == 0xFF90) // SOT
+            break;
+        len = bytestream2_get_be16(&g) - 2;
+        if (len < 0 || len > bytestream2_get_bytes_left(&g))
+            return 0;
+        if (marker == 0xFF52 && len <= sizeof(sc->j2k_cod)) { // COD
+            sc->j2k_cod_size = bytestream2_get_buffer(&g, sc->j2k_cod, len);
+        } else if (marker == 0xFF5C && len <= sizeof(sc->j2k_qcd)) { // QCD
+            sc->j2k_qcd_size = bytestream2_get_buffer(&g, sc->j2k_qcd, len);
+        } else {
+            bytestream2_skip(&g, len);
+        }
+    }
+    if (!sc->j2k_cod_size || !sc->j2k_qcd_size)
+        return 0;
+
+    sc->j2k_info_parsed = 1;
+    return 1;
+}
+
 static int mxf_parse_prores_frame(AVFormatContext *s, AVStream *st, AVPacket *pkt)
 {
     MXFContext *mxf = s->priv_data;
@@ -2493,6 +2698,166 @@ static int mxf_init_timecode(AVFormatContext *s, AVStream *st, AVRational tbc)
         return av_timecode_init(&mxf->tc, av_inv_q(tbc), 0, 0, s);
 }
 
+#if HAVE_THREADS
+static void mxf_writer_free_msg(void *arg)
+{
+    MXFWriterMsg *msg = arg;
+    av_freep(&msg->data);
+}
+
+static void *mxf_writer_thread(void *arg)
+{
+    MXFContext *mxf = arg;
+    AVIOContext *pb = mxf->output_pb;
+    MXFWriterMsg msg;
+    int ret;
+
+    while (av_thread_message_queue_recv(mxf->writer_queue, &msg, 0) >= 0) {
+        if (msg.data) {
+            avio_write(pb, msg.data, msg.size);
+            av_free(msg.data);
+            ret = pb->error;
+        } else {
+            ret = avio_seek(pb, msg.pos, SEEK_SET);
+        }
+        if (ret < 0) {
+            av_thread_message_queue_set_err_send(mxf->writer_queue, ret);
+            return NULL;
+        }
+    }
+    avio_flush(pb);
+    if (pb->error < 0)
+        av_thread_message_queue_set_err_send(mxf->writer_queue, pb->error);
+
+    return NULL;
+}
+
+static int mxf_writer_write(void *opaque, uint8_t *buf, int buf_size)
+{
+    MXFContext *mxf = opaque;
+    MXFWriterMsg msg = { .data = av_memdup(buf, buf_size), .size = buf_size };
+    int ret;
+
+    if (!msg.data)
+        return AVERROR(ENOMEM);
+    if ((ret = av_thread_message_queue_send(mxf->writer_queue, &msg, 0)) < 0) {
+        av_free(msg.data);
+        return ret;
+    }
+    mxf->writer_pos += buf_size;
+    mxf->writer_size = FFMAX(mxf->writer_size, mxf->writer_pos);
+
+    return buf_size;
+}
+
+static int64_t mxf_writer_seek(void *opaque, int64_t offset, int whence)
+{
+    MXFContext *mxf = opaque;
+    MXFWriterMsg msg = { .pos = offset };
+    int ret;
+
+    if (whence == AVSEEK_SIZE)
+        return mxf->writer_size;
+    if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if ((ret = av_thread_message_queue_send(mxf->writer_queue, &msg, 0)) < 0)
+        return ret;
+    mxf->writer_pos = offset;
+
+    return offset;
+}
+#endif
+
+/**
+ * Sets up the writer thread, to which the muxer passes the bytes it writes
+ * through a bounded queue, so that it does not wait for the output.
+ */
+static int mxf_init_writer(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    MXFContext *mxf = s->priv_data;
+    uint8_t *buf;
+    int ret;
+
+    /* the output context is flushed between the calls to the muxer otherwise */
+    if (s->flush_packets == 1 || (s->flags & AVFMT_FLAG_FLUSH_PACKETS) || s->pb->write_data_type) {
+        av_log(s, AV_LOG_WARNING, "The writer thread does not support flushing the packets, writing inline\n");
+        return 0;
+    }
+
+    if ((ret = av_thread_message_queue_alloc(&mxf->writer_queue, mxf->write_queue_size,
+                                             sizeof(MXFWriterMsg))) < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(mxf->writer_queue, mxf_writer_free_msg);
+
+    if (!(buf = av_malloc(MXF_WRITER_BUFFER_SIZE)) ||
+        !(mxf->writer_pb = avio_alloc_context(buf, MXF_WRITER_BUFFER_SIZE, 1, mxf,
+                                              NULL, mxf_writer_write, mxf_writer_seek))) {
+        av_free(buf);
+        av_thread_message_queue_free(&mxf->writer_queue);
+        return AVERROR(ENOMEM);
+    }
+    mxf->output_pb           = s->pb;
+    mxf->writer_pb->seekable = s->pb->seekable;
+    mxf->writer_pb->pos      = mxf->writer_pos = mxf->writer_size = avio_tell(s->pb);
+
+    if ((ret = pthread_create(&mxf->writer_thread, NULL, mxf_writer_thread, mxf))) {
+        av_log(s, AV_LOG_ERROR, "Could not create writer thread: %s\n", av_err2str(AVERROR(ret)));
+        av_freep(&mxf->writer_pb->buffer);
+        avio_context_free(&mxf->writer_pb);
+        av_thread_message_queue_free(&mxf->writer_queue);
+        return AVERROR(ret);
+    }
+    mxf->writer_thread_running = 1;
+    /* keeps the flush points between the packets from writing to the output */
+    mxf->output_min_packet_size = s->pb->min_packet_size;
+    s->pb->min_packet_size      = INT_MAX;
+#else
+    av_log(s, AV_LOG_WARNING, "The writer thread requires threading support, writing inline\n");
+#endif
+    return 0;
+}
+
+/**
+ * Writes the bytes still queued, and stops the writer thread.
+ * @return the first error of the writer thread
+ */
+static int mxf_flush_writer(AVFormatContext *s)
+{
+    int ret = 0;
+#if HAVE_THREADS
+    MXFContext *mxf = s->priv_data;
+
+    if (!mxf->writer_thread_running)
+        return 0;
+
+    avio_flush(mxf->writer_pb);
+    av_thread_message_queue_set_err_recv(mxf->writer_queue, AVERROR_EOF);
+    pthread_join(mxf->writer_thread, NULL);
+    mxf->writer_thread_running = 0;
+    mxf->output_pb->min_packet_size = mxf->output_min_packet_size;
+
+    ret = mxf->writer_pb->error;
+    if (ret >= 0)
+        ret = mxf->output_pb->error;
+#endif
+    return ret;
+}
+
+static void mxf_stop_writer(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+
+    if (!mxf->writer_pb)
+        return;
+    mxf_flush_writer(s);
+#if HAVE_THREADS
+    av_thread_message_queue_free(&mxf->writer_queue);
+#endif
+    av_freep(&mxf->writer_pb->buffer);
+    avio_context_free(&mxf->writer_pb);
+}
+
 static int mxf_init(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
@@ -2505,6 +2870,18 @@ static int mxf_init(AVFormatContext *s)
         return -1;
     }
 
+    if (mxf->write_once && s->oformat == &ff_mxf_opatom_muxer) {
+        av_log(s, AV_LOG_ERROR, "write_once is not supported for mxf opatom, "
+               "the essence length is only known at the end\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (mxf->imf && (s->nb_streams != 1 ||
+                     s->streams[0]->codecpar->codec_id != AV_CODEC_ID_JPEG2000)) {
+        av_log(s, AV_LOG_ERROR, "there must be exactly one jpeg 2000 stream for an imf track file\n");
+        return AVERROR(EINVAL);
+    }
+
     if (!av_dict_get(s->metadata, "comment_", NULL, AV_DICT_IGNORE_SUFFIX))
         mxf->store_user_comments = 0;
 
@@ -2710,6 +3087,9 @@ static int mxf_init(AVFormatContext *s)
         return AVERROR(ENOMEM);
     mxf->timecode_track->index = -1;
 
+    if (mxf->write_queue_size)
+        return mxf_init_writer(s);
+
     return 0;
 }
 
@@ -2868,7 +3248,7 @@ static void mxf_compute_edit_unit_byte_count(AVFormatContext *s)
     }
 }
 
-static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
+static int mxf_write_essence_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MXFContext *mxf = s->priv_data;
     AVIOContext *pb = s->pb;
@@ -2918,6 +3298,11 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
             av_log(s, AV_LOG_ERROR, "could not get h264 profile\n");
             return -1;
         }
+    } else if (st->codecpar->codec_id == AV_CODEC_ID_JPEG2000) {
+        if (!mxf_parse_jpeg2000_frame(s, st, pkt, &ie) && mxf->imf) {
+            av_log(s, AV_LOG_ERROR, "could not parse jpeg 2000 codestream header\n");
+            return AVERROR_INVALIDDATA;
+        }
     }
 
     if (mxf->cbr_index) {
@@ -2947,7 +3332,14 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (st->index == 0) {
-        if (!mxf->edit_unit_byte_count &&
+        if (mxf->imf) {
+            // a single body partition, the whole index goes to the footer
+            if (!mxf->body_partitions_count) {
+                mxf_write_klv_fill(s);
+                if ((err = mxf_write_partition(s, 1, 0, body_partition_key, 0)) < 0)
+                    return err;
+            }
+        } else if (!mxf->edit_unit_byte_count &&
             (!mxf->edit_units_count || mxf->edit_units_count > EDIT_UNITS_PER_BODY) &&
             !(ie.flags & 0x33)) { // I-frame, GOP start
             mxf_write_klv_fill(s);
@@ -2957,14 +3349,17 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
             mxf_write_index_table_segment(s);
         }
 
-        mxf_write_klv_fill(s);
-        mxf_write_system_item(s);
+        if (!mxf->imf) {
+            mxf_write_klv_fill(s);
+            mxf_write_system_item(s);
+        }
 
         if (!mxf->edit_unit_byte_count) {
             mxf->index_entries[mxf->edit_units_count].offset = mxf->body_offset;
             mxf->index_entries[mxf->edit_units_count].flags = ie.flags;
             mxf->index_entries[mxf->edit_units_count].temporal_ref = ie.temporal_ref;
-            mxf->body_offset += KAG_SIZE; // size of system element
+            if (!mxf->imf)
+                mxf->body_offset += KAG_SIZE; // size of system element
         }
         mxf->edit_units_count++;
     } else if (!mxf->edit_unit_byte_count && st->index == 1) {
@@ -3017,10 +3412,11 @@ static void mxf_write_random_index_pack(AVFormatContext *s)
     avio_wb32(pb, avio_tell(pb) - pos + 4);
 }
 
-static int mxf_write_footer(AVFormatContext *s)
+static int mxf_write_footer_partition(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
     AVIOContext *pb = s->pb;
+    int rewrite_header = (s->pb->seekable & AVIO_SEEKABLE_NORMAL) && !mxf->write_once;
     int i, err;
 
     if (!mxf->header_written ||
@@ -3033,11 +3429,12 @@ static int mxf_write_footer(AVFormatContext *s)
 
     mxf_write_klv_fill(s);
     mxf->footer_partition_offset = avio_tell(pb);
-    if (mxf->edit_unit_byte_count && s->oformat != &ff_mxf_opatom_muxer) { // no need to repeat index
+    if (mxf->edit_unit_byte_count && s->oformat != &ff_mxf_opatom_muxer && rewrite_header) { // no need to repeat index
         if ((err = mxf_write_partition(s, 0, 0, footer_partition_key, 0)) < 0)
             return err;
     } else {
-        if ((err = mxf_write_partition(s, 0, 2, footer_partition_key, 0)) < 0)
+        // without the header rewrite, the footer has the complete metadata
+        if ((err = mxf_write_partition(s, 0, 2, footer_partition_key, !rewrite_header)) < 0)
             return err;
         mxf_write_klv_fill(s);
         mxf_write_index_table_segment(s);
@@ -3046,7 +3443,7 @@ static int mxf_write_footer(AVFormatContext *s)
     mxf_write_klv_fill(s);
     mxf_write_random_index_pack(s);
 
-    if (s->pb->seekable & AVIO_SEEKABLE_NORMAL) {
+    if (rewrite_header) {
         if (s->oformat == &ff_mxf_opatom_muxer) {
             /* rewrite body partition to update lengths */
             avio_seek(pb, mxf->body_partition_offset[0], SEEK_SET);
@@ -3074,10 +3471,45 @@ static int mxf_write_footer(AVFormatContext *s)
     return 0;
 }
 
+static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    MXFContext *mxf = s->priv_data;
+    int ret;
+
+    if (!mxf->writer_pb)
+        return mxf_write_essence_packet(s, pkt);
+
+    s->pb = mxf->writer_pb;
+    ret = mxf_write_essence_packet(s, pkt);
+    s->pb = mxf->output_pb;
+    if (ret >= 0 && mxf->writer_pb->error < 0)
+        ret = mxf->writer_pb->error;
+
+    return ret;
+}
+
+static int mxf_write_footer(AVFormatContext *s)
+{
+    MXFContext *mxf = s->priv_data;
+    int ret, ret2;
+
+    if (!mxf->writer_pb)
+        return mxf_write_footer_partition(s);
+
+    s->pb = mxf->writer_pb;
+    ret = mxf_write_footer_partition(s);
+    s->pb = mxf->output_pb;
+    ret2 = mxf_flush_writer(s);
+
+    return ret < 0 ? ret : ret2;
+}
+
 static void mxf_deinit(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
 
+    mxf_stop_writer(s);
+
     av_freep(&mxf->index_entries);
     av_freep(&mxf->body_partition_offset);
     if (mxf->timecode_track) {
@@ -3180,7 +3612,11 @@ static int mxf_interleave(AVFormatContext *s, AVPacket *pkt,
     { "smpte349m", "SMPTE 349M (1485 Mbps mappings)",\
       0, AV_OPT_TYPE_CONST, {.i64 = 6}, -1, 7, AV_OPT_FLAG_ENCODING_PARAM, "signal_standard"},\
     { "smpte428", "SMPTE 428-1 DCDM",\
-      0, AV_OPT_TYPE_CONST, {.i64 = 7}, -1, 7, AV_OPT_FLAG_ENCODING_PARAM, "signal_standard"},
+      0, AV_OPT_TYPE_CONST, {.i64 = 7}, -1, 7, AV_OPT_FLAG_ENCODING_PARAM, "signal_standard"},\
+    { "write_queue_size", "Number of 1 MiB blocks queued to the writer thread (0 to write inline)",\
+      offsetof(MXFContext, write_queue_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},\
+    { "write_once", "Never seek back, write the complete metadata in the footer",\
+      offsetof(MXFContext, write_once), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
 
 
 
@@ -3188,6 +3624,8 @@ static const AVOption mxf_options[] = {
     MXF_COMMON_OPTIONS
     { "store_user_comments", "",
       offsetof(MXFContext, store_user_comments), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+    { "imf", "Write an IMF track file",
+      offsetof(MXFContext, imf), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { NULL },
 };
 
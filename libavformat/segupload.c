@@ -0,0 +1,391 @@
+/*
+ * Asynchronous segment and playlist upload for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "url.h"
+#if CONFIG_HTTP_PROTOCOL
+#include "http.h"
+#endif
+#include "segupload.h"
+
+typedef struct UploadJob {
+    char *url;
+    AVDictionary *options;
+    uint8_t *buf;
+    int size;
+    int ordered;
+    int running;
+    struct UploadJob *next;
+} UploadJob;
+
+/* a buffer handed out by ff_segment_uploader_open() and not closed yet */
+typedef struct OpenBuffer {
+    AVIOContext **pb;
+    char *url;
+    AVDictionary *options;
+    int ordered;
+} OpenBuffer;
+
+typedef struct UploadThread {
+    SegmentUploader *w;
+    AVIOContext *pb;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+} UploadThread;
+
+struct SegmentUploader {
+    AVFormatContext *s;
+    int persistent;
+    int nb_threads;
+    int max_pending;
+    UploadThread *threads;
+
+    OpenBuffer *open;
+    int nb_open;
+
+#if HAVE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+    /* queued and running jobs, in the order they were closed */
+    UploadJob *jobs;
+    int nb_jobs;
+    int error;
+    int exit;
+};
+
+static void free_job(UploadJob **pjob)
+{
+    UploadJob *job = *pjob;
+
+    if (!job)
+        return;
+    av_freep(&job->url);
+    av_dict_free(&job->options);
+    av_freep(&job->buf);
+    av_freep(pjob);
+}
+
+int ff_segment_uploader_open(SegmentUploader *w, AVIOContext **pb, const char *url,
+                             AVDictionary **options, int ordered)
+{
+    OpenBuffer *open, *entry;
+    int ret;
+
+    open = av_realloc_array(w->open, w->nb_open + 1, sizeof(*w->open));
+    if (!open)
+        return AVERROR(ENOMEM);
+    w->open = open;
+    entry = &w->open[w->nb_open];
+    memset(entry, 0, sizeof(*entry));
+    entry->pb      = pb;
+    entry->ordered = ordered;
+    if (!(entry->url = av_strdup(url)))
+        return AVERROR(ENOMEM);
+    if (options && (ret = av_dict_copy(&entry->options, *options, 0)) < 0)
+        goto fail;
+    if ((ret = avio_open_dyn_buf(pb)) < 0)
+        goto fail;
+    w->nb_open++;
+    return 0;
+fail:
+    av_freep(&entry->url);
+    av_dict_free(&entry->options);
+    return ret;
+}
+
+int ff_segment_uploader_owns(SegmentUploader *w, AVIOContext *pb)
+{
+    int i;
+
+    if (!pb)
+        return 0;
+    for (i = 0; i < w->nb_open; i++)
+        if (*w->open[i].pb == pb)
+            return 1;
+    return 0;
+}
+
+#if HAVE_THREADS
+static int upload_once(UploadThread *t, UploadJob *job)
+{
+    SegmentUploader *w = t->w;
+    AVFormatContext *s = w->s;
+    AVDictionary *options = NULL;
+    int ret;
+
+    if ((ret = av_dict_copy(&options, job->options, 0)) < 0)
+        return ret;
+#if CONFIG_HTTP_PROTOCOL
+    if (t->pb && w->persistent) {
+        URLContext *h = ffio_geturlcontext(t->pb);
+        av_assert0(h);
+        ret = ff_http_do_new_request2(h, job->url, &options);
+        if (ret < 0)
+            ff_format_io_close(s, &t->pb);
+    }
+#endif
+    if (!t->pb)
+        ret = s->io_open(s, &t->pb, job->url, AVIO_FLAG_WRITE, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+
+    avio_write(t->pb, job->buf, job->size);
+    avio_flush(t->pb);
+    ret = t->pb->error;
+#if CONFIG_HTTP_PROTOCOL
+    if (ret >= 0 && w->persistent && ff_is_http_proto(job->url)) {
+        URLContext *h = ffio_geturlcontext(t->pb);
+        av_assert0(h);
+        ffurl_shutdown(h, AVIO_FLAG_WRITE);
+        ret = ff_http_get_shutdown_status(h);
+        if (ret >= 0)
+            return 0;
+    }
+#endif
+    ff_format_io_close(s, &t->pb);
+    return ret;
+}
+
+static int upload_job(UploadThread *t, UploadJob *job)
+{
+    int ret = upload_once(t, job);
+
+    if (ret < 0) {
+        av_log(t->w->s, AV_LOG_WARNING, "Upload of '%s' failed, "
+               "retrying with a new session\n", job->url);
+        ff_format_io_close(t->w->s, &t->pb);
+        ret = upload_once(t, job);
+        if (ret < 0)
+            av_log(t->w->s, AV_LOG_ERROR, "Failed to upload '%s': %s\n",
+                   job->url, av_err2str(ret));
+    }
+    return ret;
+}
+
+/* Called with the lock held. */
+static UploadJob *next_job(SegmentUploader *w)
+{
+    UploadJob *job;
+
+    for (job = w->jobs; job; job = job->next) {
+        if (job->running)
+            continue;
+        /* ordered jobs wait until all earlier jobs are done */
+        if (job->ordered && job != w->jobs)
+            continue;
+        return job;
+    }
+    return NULL;
+}
+
+static void *upload_thread(void *arg)
+{
+    UploadThread *t = arg;
+    SegmentUploader *w = t->w;
+    UploadJob *job, **p;
+    int ret;
+
+    pthread_mutex_lock(&w->lock);
+    while (1) {
+        if (!(job = next_job(w))) {
+            if (w->exit && !w->jobs)
+                break;
+            pthread_cond_wait(&w->cond, &w->lock);
+            continue;
+        }
+        job->running = 1;
+        pthread_mutex_unlock(&w->lock);
+
+        ret = upload_job(t, job);
+
+        pthread_mutex_lock(&w->lock);
+        for (p = &w->jobs; *p != job; p = &(*p)->next)
+            ;
+        *p = job->next;
+        w->nb_jobs--;
+        if (ret < 0 && !w->error)
+            w->error = ret;
+        free_job(&job);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    ff_format_io_close(w->s, &t->pb);
+    return NULL;
+}
+#endif
+
+int ff_segment_uploader_alloc(SegmentUploader **pw, AVFormatContext *s,
+                              int nb_threads, int persistent)
+{
+#if HAVE_THREADS
+    SegmentUploader *w;
+    int i, ret;
+
+    *pw = NULL;
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s           = s;
+    w->persistent  = persistent;
+    w->max_pending = 2 * nb_threads;
+    w->threads     = av_calloc(nb_threads, sizeof(*w->threads));
+    if (!w->threads) {
+        av_free(w);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        w->threads[i].w = w;
+        ret = pthread_create(&w->threads[i].thread, NULL, upload_thread, &w->threads[i]);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "Failed to start upload thread: %s\n",
+                   av_err2str(AVERROR(ret)));
+            ff_segment_uploader_free(&w);
+            return AVERROR(ret);
+        }
+        w->nb_threads++;
+    }
+    *pw = w;
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_segment_uploader_close(SegmentUploader *w, AVIOContext **pb)
+{
+    OpenBuffer entry;
+    UploadJob *job;
+    int i, ret = 0;
+
+    for (i = 0; i < w->nb_open; i++)
+        if (*w->open[i].pb == *pb)
+            break;
+    av_assert0(i < w->nb_open);
+    entry = w->open[i];
+    memmove(&w->open[i], &w->open[i + 1], (w->nb_open - i - 1) * sizeof(*w->open));
+    w->nb_open--;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        ffio_free_dyn_buf(pb);
+        av_free(entry.url);
+        av_dict_free(&entry.options);
+        return AVERROR(ENOMEM);
+    }
+    job->url     = entry.url;
+    job->options = entry.options;
+    job->ordered = entry.ordered;
+    job->size    = avio_close_dyn_buf(*pb, &job->buf);
+    *pb = NULL;
+
+#if HAVE_THREADS
+    {
+    UploadJob **p;
+
+    pthread_mutex_lock(&w->lock);
+    if (job->ordered) {
+        /* a newer version replaces a queued one of the same file */
+        for (p = &w->jobs; *p; p = &(*p)->next) {
+            UploadJob *old = *p;
+            if (old->ordered && !old->running && !strcmp(old->url, job->url)) {
+                *p = old->next;
+                w->nb_jobs--;
+                free_job(&old);
+                break;
+            }
+        }
+    }
+    while (!w->error && w->nb_jobs >= w->max_pending)
+        pthread_cond_wait(&w->cond, &w->lock);
+    if (w->error) {
+        ret = w->error;
+        free_job(&job);
+    } else {
+        for (p = &w->jobs; *p; p = &(*p)->next)
+            ;
+        *p = job;
+        w->nb_jobs++;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    }
+#else
+    free_job(&job);
+    ret = AVERROR(ENOSYS);
+#endif
+    return ret;
+}
+
+int ff_segment_uploader_flush(SegmentUploader *w)
+{
+    int ret = 0;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->lock);
+    while (w->jobs)
+        pthread_cond_wait(&w->cond, &w->lock);
+    ret = w->error;
+    pthread_mutex_unlock(&w->lock);
+#endif
+    return ret;
+}
+
+void ff_segment_uploader_free(SegmentUploader **pw)
+{
+    SegmentUploader *w = *pw;
+    int i;
+
+    if (!w)
+        return;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->lock);
+    w->exit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    for (i = 0; i < w->nb_threads; i++)
+        pthread_join(w->threads[i].thread, NULL);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+#endif
+    av_assert0(!w->jobs);
+
+    for (i = 0; i < w->nb_open; i++) {
+        ffio_free_dyn_buf(w->open[i].pb);
+        av_free(w->open[i].url);
+        av_dict_free(&w->open[i].options);
+    }
+    av_freep(&w->open);
+    av_freep(&w->threads);
+    av_freep(pw);
+}
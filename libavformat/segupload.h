@@ -0,0 +1,81 @@
+/*
+ * Asynchronous segment and playlist upload for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGUPLOAD_H
+#define AVFORMAT_SEGUPLOAD_H
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * A pool of threads writing finished output files (segments, playlists)
+ * while the muxer keeps going.
+ *
+ * Files are opened as dynamic buffers with ff_segment_uploader_open() and
+ * queued for upload when closed with ff_segment_uploader_close(). Unordered
+ * files (segments) are uploaded concurrently. An ordered file (playlist) is
+ * only uploaded once everything queued before it is done, so it never
+ * references a segment that is not available yet; a queued ordered file is
+ * replaced when a newer version of it is closed.
+ */
+typedef struct SegmentUploader SegmentUploader;
+
+/**
+ * @param nb_threads number of upload threads
+ * @param persistent keep the HTTP connection of each thread open
+ */
+int ff_segment_uploader_alloc(SegmentUploader **pw, AVFormatContext *s,
+                              int nb_threads, int persistent);
+
+/**
+ * Open a buffer collecting the data for url. *options is copied and used for
+ * the actual upload.
+ */
+int ff_segment_uploader_open(SegmentUploader *w, AVIOContext **pb, const char *url,
+                             AVDictionary **options, int ordered);
+
+/**
+ * @return 1 if pb was opened with ff_segment_uploader_open(), 0 otherwise
+ */
+int ff_segment_uploader_owns(SegmentUploader *w, AVIOContext *pb);
+
+/**
+ * Queue the data written to *pb for upload, blocking while too many uploads
+ * are pending. *pb is set to NULL.
+ *
+ * @return 0 on success, or the first error hit by an earlier upload
+ */
+int ff_segment_uploader_close(SegmentUploader *w, AVIOContext **pb);
+
+/**
+ * Wait for all queued uploads to finish.
+ *
+ * @return 0 on success, or the first error hit by an upload
+ */
+int ff_segment_uploader_flush(SegmentUploader *w);
+
+/**
+ * Finish outstanding uploads, stop the threads and free the uploader. Buffers
+ * still open are discarded and their AVIOContext pointers set to NULL.
+ */
+void ff_segment_uploader_free(SegmentUploader **pw);
+
+#endif /* AVFORMAT_SEGUPLOAD_H */
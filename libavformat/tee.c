@@ -23,6 +23,8 @@
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavcodec/bsf.h"
 #include "internal.h"
 #include "avformat.h"
@@ -36,6 +38,11 @@ typedef enum {
 
 #define DEFAULT_SLAVE_FAILURE_POLICY ON_SLAVE_FAILURE_ABORT
 
+typedef enum {
+    ON_SLAVE_OVERFLOW_BLOCK = 1,
+    ON_SLAVE_OVERFLOW_DROP  = 2
+} SlaveOverflowPolicy;
+
 typedef struct {
     AVFormatContext *avf;
     AVBSFContext **bsfs; ///< bitstream filters per stream
@@ -48,6 +55,20 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    int use_thread;
+    int queue_size;
+    SlaveOverflowPolicy on_overflow;
+    /** per input stream, set while dropping until the next keyframe */
+    uint8_t *dropping;
+    int64_t nb_dropped;
+    /** queue of AVPacket pointers, NULL requests a flush */
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_started;
+    void *log_ctx;
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -57,6 +78,8 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    int use_threads;
+    int queue_size;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -69,6 +92,10 @@ static const AVOption options[] = {
          OFFSET(use_fifo), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
         {"fifo_options", "fifo pseudo-muxer options", OFFSET(fifo_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
+        {"use_threads", "Write each slave from its own thread",
+         OFFSET(use_threads), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"queue_size", "Number of packets queued per slave writer thread",
+         OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64 = 64}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
         {NULL}
 };
 
@@ -96,38 +123,98 @@ static inline int parse_slave_failure_policy_option(const char *opt, TeeSlave *t
     return AVERROR(EINVAL);
 }
 
-static int parse_slave_fifo_policy(const char *use_fifo, TeeSlave *tee_slave)
+static int parse_slave_bool_option(const char *opt, int *value)
 {
     /*TODO - change this to use proper function for parsing boolean
      *       options when there is one */
-    if (av_match_name(use_fifo, "true,y,yes,enable,enabled,on,1")) {
-        tee_slave->use_fifo = 1;
-    } else if (av_match_name(use_fifo, "false,n,no,disable,disabled,off,0")) {
-        tee_slave->use_fifo = 0;
+    if (av_match_name(opt, "true,y,yes,enable,enabled,on,1")) {
+        *value = 1;
+    } else if (av_match_name(opt, "false,n,no,disable,disabled,off,0")) {
+        *value = 0;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+static int parse_slave_fifo_policy(const char *use_fifo, TeeSlave *tee_slave)
+{
+    return parse_slave_bool_option(use_fifo, &tee_slave->use_fifo);
+}
+
+static int parse_slave_overflow_policy(const char *opt, TeeSlave *tee_slave)
+{
+    if (!av_strcasecmp("block", opt)) {
+        tee_slave->on_overflow = ON_SLAVE_OVERFLOW_BLOCK;
+    } else if (!av_strcasecmp("drop", opt)) {
+        tee_slave->on_overflow = ON_SLAVE_OVERFLOW_DROP;
     } else {
         return AVERROR(EINVAL);
     }
     return 0;
 }
 
+static int parse_slave_queue_size(const char *opt, TeeSlave *tee_slave)
+{
+    char *end;
+    long size = strtol(opt, &end, 10);
+
+    if (*end || size < 1 || size > INT_MAX)
+        return AVERROR(EINVAL);
+    tee_slave->queue_size = size;
+    return 0;
+}
+
 static int parse_slave_fifo_options(const char *fifo_options, TeeSlave *tee_slave)
 {
     return av_dict_parse_string(&tee_slave->fifo_options, fifo_options, "=", ":", 0);
 }
 
+/**
+ * Stop the writer thread of a slave after it has drained its queue.
+ * Returns the first error the thread ran into, if any.
+ */
+static int stop_slave_thread(TeeSlave *tee_slave)
+{
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (tee_slave->thread_started) {
+        void *thread_ret;
+
+        av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+        pthread_join(tee_slave->thread, &thread_ret);
+        tee_slave->thread_started = 0;
+        ret = (intptr_t)thread_ret;
+    }
+#endif
+    av_thread_message_queue_free(&tee_slave->queue);
+    return ret;
+}
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
     unsigned i;
     int ret = 0;
 
+    ret = stop_slave_thread(tee_slave);
+    av_freep(&tee_slave->dropping);
+    if (tee_slave->nb_dropped)
+        av_log(tee_slave->log_ctx, AV_LOG_WARNING,
+               "Slave '%s': %"PRId64" packets dropped on queue overflow\n",
+               tee_slave->avf ? tee_slave->avf->url : "", tee_slave->nb_dropped);
+    tee_slave->nb_dropped = 0;
     av_dict_free(&tee_slave->fifo_options);
     avf = tee_slave->avf;
     if (!avf)
         return 0;
 
-    if (tee_slave->header_written)
-        ret = av_write_trailer(avf);
+    if (tee_slave->header_written) {
+        int ret2 = av_write_trailer(avf);
+        if (!ret)
+            ret = ret2;
+    }
 
     if (tee_slave->bsfs) {
         for (i = 0; i < avf->nb_streams; ++i)
@@ -161,6 +248,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     char *filename;
     char *format = NULL, *select = NULL, *on_fail = NULL;
     char *use_fifo = NULL, *fifo_options_str = NULL;
+    char *use_thread = NULL, *queue_size = NULL, *on_overflow = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -195,6 +283,16 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
                           av_err2str(ret)););
     PROCESS_OPTION("fifo_options", fifo_options_str,
                    parse_slave_fifo_options(fifo_options_str, tee_slave), ;);
+    PROCESS_OPTION("use_thread", use_thread,
+                   parse_slave_bool_option(use_thread, &tee_slave->use_thread),
+                   av_log(avf, AV_LOG_ERROR, "Invalid use_thread option value\n"););
+    PROCESS_OPTION("queue_size", queue_size,
+                   parse_slave_queue_size(queue_size, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid queue_size option value\n"););
+    PROCESS_OPTION("onoverflow", on_overflow,
+                   parse_slave_overflow_policy(on_overflow, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid onoverflow option value, "
+                          "valid options are 'block' and 'drop'\n"););
     entry = NULL;
     while ((entry = av_dict_get(options, "bsfs", entry, AV_DICT_IGNORE_SUFFIX))) {
         /* trim out strlen("bsfs") characters from key */
@@ -448,6 +546,144 @@ static int tee_process_slave_failure(AVFormatContext *avf, unsigned slave_idx, i
     }
 }
 
+/**
+ * Filter and mux one packet, already mapped to the slave stream index, into
+ * a slave. The packet is consumed. A NULL packet flushes the slave.
+ */
+static int write_slave_packet(void *log_ctx, TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    AVBSFContext *bsfs;
+    int ret, s2;
+
+    if (!pkt)
+        return av_interleaved_write_frame(avf2, NULL);
+
+    s2 = pkt->stream_index;
+    bsfs = tee_slave->bsfs[s2];
+
+    ret = av_bsf_send_packet(bsfs, pkt);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        av_log(log_ctx, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+
+    while(1) {
+        ret = av_bsf_receive_packet(bsfs, pkt);
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+
+        av_packet_rescale_ts(pkt, bsfs->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, pkt);
+        if (ret < 0)
+            break;
+    };
+
+    return ret;
+}
+
+#if HAVE_THREADS
+static void free_slave_message(void *msg)
+{
+    av_packet_free(msg);
+}
+
+static void *slave_writer_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVPacket *pkt;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(tee_slave->queue, &pkt, 0)) >= 0) {
+        ret = write_slave_packet(tee_slave->log_ctx, tee_slave, pkt);
+        av_packet_free(&pkt);
+        if (ret < 0)
+            break;
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    /* fail the producer side so the error is reported on the next packet */
+    av_thread_message_queue_set_err_send(tee_slave->queue, ret < 0 ? ret : AVERROR_EOF);
+    return (void *)(intptr_t)ret;
+}
+#endif
+
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    int ret;
+
+    tee_slave->dropping = av_calloc(avf->nb_streams, sizeof(*tee_slave->dropping));
+    if (!tee_slave->dropping)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                        sizeof(AVPacket *));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, free_slave_message);
+
+    ret = pthread_create(&tee_slave->thread, NULL, slave_writer_thread, tee_slave);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "Failed to start slave writer thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+#else
+    av_log(avf, AV_LOG_ERROR, "Slave writer threads require threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Hand a packet over to the writer thread of a slave. The packet is consumed.
+ */
+static int queue_slave_packet(AVFormatContext *avf, TeeSlave *tee_slave,
+                              AVPacket *pkt, int s)
+{
+    int drop = tee_slave->on_overflow == ON_SLAVE_OVERFLOW_DROP;
+    int ret;
+
+    if (pkt && tee_slave->dropping[s]) {
+        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+            tee_slave->nb_dropped++;
+            av_packet_free(&pkt);
+            return 0;
+        }
+        tee_slave->dropping[s] = 0;
+    }
+
+    ret = av_thread_message_queue_send(tee_slave->queue, &pkt,
+                                       drop ? AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret == AVERROR(EAGAIN)) {
+        if (!pkt)
+            return av_thread_message_queue_send(tee_slave->queue, &pkt, 0);
+        if (!tee_slave->nb_dropped)
+            av_log(avf, AV_LOG_WARNING, "Slave '%s': queue full, dropping packets\n",
+                   tee_slave->avf->url);
+        /* the rest of the GOP would not be decodable without this packet */
+        tee_slave->dropping[s] = 1;
+        tee_slave->nb_dropped++;
+        av_packet_free(&pkt);
+        return 0;
+    } else if (ret < 0) {
+        av_packet_free(&pkt);
+        /* the thread stopped on an error, collect it */
+        ret = stop_slave_thread(tee_slave);
+        return ret < 0 ? ret : AVERROR_EOF;
+    }
+    return 0;
+}
+
 static int tee_write_header(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -480,11 +716,17 @@ static int tee_write_header(AVFormatContext *avf)
     for (i = 0; i < nb_slaves; i++) {
 
         tee->slaves[i].use_fifo = tee->use_fifo;
+        tee->slaves[i].use_thread = tee->use_threads;
+        tee->slaves[i].queue_size = tee->queue_size;
+        tee->slaves[i].on_overflow = ON_SLAVE_OVERFLOW_BLOCK;
+        tee->slaves[i].log_ctx = avf;
         ret = av_dict_copy(&tee->slaves[i].fifo_options, tee->fifo_options, 0);
         if (ret < 0)
             goto fail;
 
-        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0) {
+        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0 ||
+            (tee->slaves[i].use_thread &&
+             (ret = start_slave_thread(avf, &tee->slaves[i])) < 0)) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (ret < 0)
                 goto fail;
@@ -534,66 +776,48 @@ static int tee_write_trailer(AVFormatContext *avf)
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
-    AVFormatContext *avf2;
-    AVBSFContext *bsfs;
+    TeeSlave *tee_slave;
     AVPacket *const pkt2 = ffformatcontext(avf)->pkt;
     int ret_all = 0, ret;
-    unsigned i, s;
-    int s2;
+    unsigned i, s = 0;
+    int s2 = 0;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        if (!(avf2 = tee->slaves[i].avf))
-            continue;
-
-        /* Flush slave if pkt is NULL*/
-        if (!pkt) {
-            ret = av_interleaved_write_frame(avf2, NULL);
-            if (ret < 0) {
-                ret = tee_process_slave_failure(avf, i, ret);
-                if (!ret_all && ret < 0)
-                    ret_all = ret;
-            }
-            continue;
-        }
-
-        s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
+        tee_slave = &tee->slaves[i];
+        if (!tee_slave->avf)
             continue;
 
-        if ((ret = av_packet_ref(pkt2, pkt)) < 0) {
-            if (!ret_all)
-                ret_all = ret;
-            continue;
-        }
-        bsfs = tee->slaves[i].bsfs[s2];
-        pkt2->stream_index = s2;
-
-        ret = av_bsf_send_packet(bsfs, pkt2);
-        if (ret < 0) {
-            av_packet_unref(pkt2);
-            av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
-                   av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
+        if (pkt) {
+            s = pkt->stream_index;
+            s2 = tee_slave->stream_map[s];
+            if (s2 < 0)
+                continue;
         }
 
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, pkt2);
-            if (ret == AVERROR(EAGAIN)) {
-                ret = 0;
-                break;
-            } else if (ret < 0) {
-                break;
+        if (tee_slave->thread_started) {
+            AVPacket *ref = NULL;
+            if (pkt) {
+                /* a new reference to the same data for each slave */
+                if (!(ref = av_packet_clone(pkt))) {
+                    if (!ret_all)
+                        ret_all = AVERROR(ENOMEM);
+                    continue;
+                }
+                ref->stream_index = s2;
             }
-
-            av_packet_rescale_ts(pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, pkt2);
-            if (ret < 0)
-                break;
-        };
+            ret = queue_slave_packet(avf, tee_slave, ref, s);
+        } else if (pkt) {
+            if ((ret = av_packet_ref(pkt2, pkt)) < 0) {
+                if (!ret_all)
+                    ret_all = ret;
+                continue;
+            }
+            pkt2->stream_index = s2;
+            ret = write_slave_packet(avf, tee_slave, pkt2);
+        } else {
+            /* Flush slave if pkt is NULL*/
+            ret = write_slave_packet(avf, tee_slave, NULL);
+        }
 
         if (ret < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
@@ -267,6 +267,38 @@ const char *asset_map_doc =
     "</am:AssetList>"
     "</am:AssetMap>";
 
+const char *packing_list_doc =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"
+    "<PackingList xmlns=\"http://www.smpte-ra.org/schemas/2067-2/2016/PKL\">"
+    "<Id>urn:uuid:dd04528d-9b80-452a-7a13-805b08278b3d</Id>"
+    "<IssueDate>2021-06-07T12:00:00+00:00</IssueDate>"
+    "<Issuer>FFmpeg</Issuer>"
+    "<Creator>Some tool</Creator>"
+    "<AssetList>"
+    "<Asset>"
+    "<Id>urn:uuid:b5d674b8-c6ce-4bce-3bdf-be045dfdb2d0</Id>"
+    "<Hash>2jmj7l5rSw0yVb/vlWAYkK/YBwk=</Hash>"
+    "<Size>1234567</Size>"
+    "<Type>application/mxf</Type>"
+    "<OriginalFileName>IMF_TEST_ASSET_MAP_video.mxf</OriginalFileName>"
+    "</Asset>"
+    "<Asset>"
+    "<Id>urn:uuid:ec3467ec-ab2a-4f49-c8cb-89caa3761f4a</Id>"
+    "<Hash>2jmj7l5rSw0yVb/vlWAYkK/YBwk=</Hash>"
+    "<Size>234567</Size>"
+    "<Type>application/mxf</Type>"
+    "<HashAlgorithm Algorithm=\"http://www.w3.org/2000/09/xmldsig#md5\"/>"
+    "</Asset>"
+    "<Asset>"
+    "<Id>urn:uuid:559777d6-ec29-4375-f90d-300b0bf73686</Id>"
+    "<Hash>47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=</Hash>"
+    "<Size>12345</Size>"
+    "<Type>text/xml</Type>"
+    "<HashAlgorithm Algorithm=\"http://www.w3.org/2001/04/xmlenc#sha256\"/>"
+    "</Asset>"
+    "</AssetList>"
+    "</PackingList>";
+
 static int test_cpl_parsing(void)
 {
     xmlDocPtr doc;
@@ -366,6 +398,13 @@ static int check_asset_locator_attributes(IMFAssetLocator *asset, IMFAssetLocato
         return 1;
     }
 
+    if (asset->packing_list != expected_asset->packing_list) {
+        printf("Invalid asset locator packing list flag: found %d instead of %d expected.\n",
+            asset->packing_list,
+            expected_asset->packing_list);
+        return 1;
+    }
+
     return 0;
 }
 
@@ -379,17 +418,19 @@ static IMFAssetLocator ASSET_MAP_EXPECTED_LOCATORS[5] = {
     {.uuid = {0x55, 0x97, 0x77, 0xd6, 0xec, 0x29, 0x43, 0x75, 0xf9, 0x0d, 0x30, 0x0b, 0x0b, 0xf7, 0x36, 0x86},
         .absolute_uri = (char *)"CPL_IMF_TEST_ASSET_MAP.xml"},
     {.uuid = {0xdd, 0x04, 0x52, 0x8d, 0x9b, 0x80, 0x45, 0x2a, 0x7a, 0x13, 0x80, 0x5b, 0x08, 0x27, 0x8b, 0x3d},
-        .absolute_uri = (char *)"PKL_IMF_TEST_ASSET_MAP.xml"},
+        .absolute_uri = (char *)"PKL_IMF_TEST_ASSET_MAP.xml", .packing_list = 1},
 };
 
+static FFUUID UNKNOWN_ASSET_UUID = {0x6f, 0x76, 0x8c, 0xa4, 0xc8, 0x9e, 0x4d, 0xac, 0x90, 0x56, 0xa2, 0x94, 0x25, 0xd4, 0x0b, 0xa1};
+
 static int test_asset_map_parsing(void)
 {
     IMFAssetLocatorMap asset_locator_map;
-    xmlDoc *doc;
+    xmlTextReaderPtr reader;
     int ret;
 
-    doc = xmlReadMemory(asset_map_doc, strlen(asset_map_doc), NULL, NULL, 0);
-    if (doc == NULL) {
+    reader = xmlReaderForMemory(asset_map_doc, strlen(asset_map_doc), NULL, NULL, 0);
+    if (reader == NULL) {
         printf("Asset map XML parsing failed.\n");
         return 1;
     }
@@ -398,7 +439,7 @@ static int test_asset_map_parsing(void)
     imf_asset_locator_map_init(&asset_locator_map);
 
     printf("Parse asset map XML document\n");
-    ret = parse_imf_asset_map_from_xml_dom(NULL, doc, &asset_locator_map, doc->name);
+    ret = parse_imf_asset_map_from_reader(NULL, reader, &asset_locator_map, NULL);
     if (ret) {
         printf("Asset map parsing failed.\n");
         goto cleanup;
@@ -420,9 +461,81 @@ static int test_asset_map_parsing(void)
             goto cleanup;
     }
 
+    for (uint32_t i = 0; i < asset_locator_map.asset_count; ++i) {
+        printf("Find asset: " FF_UUID_FORMAT "\n", UID_ARG(ASSET_MAP_EXPECTED_LOCATORS[i].uuid));
+        if (find_asset_map_locator(&asset_locator_map, ASSET_MAP_EXPECTED_LOCATORS[i].uuid)
+            != &(asset_locator_map.assets[i])) {
+            printf("Asset lookup failed for asset %d.\n", i);
+            ret = 1;
+            goto cleanup;
+        }
+    }
+
+    if (find_asset_map_locator(&asset_locator_map, UNKNOWN_ASSET_UUID)) {
+        printf("Asset lookup succeeded for an unknown UUID.\n");
+        ret = 1;
+        goto cleanup;
+    }
+
 cleanup:
     imf_asset_locator_map_deinit(&asset_locator_map);
-    xmlFreeDoc(doc);
+    xmlFreeTextReader(reader);
+    return ret;
+}
+
+static int test_packing_list_parsing(void)
+{
+    static const uint8_t sha1_empty[] = {
+        0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d, 0x32, 0x55,
+        0xbf, 0xef, 0x95, 0x60, 0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09,
+    };
+    IMFPackingList pkl = { 0 };
+    xmlTextReaderPtr reader;
+    int ret;
+
+    reader = xmlReaderForMemory(packing_list_doc, strlen(packing_list_doc), NULL, NULL, 0);
+    if (reader == NULL) {
+        printf("Packing list XML parsing failed.\n");
+        return 1;
+    }
+
+    printf("Parse packing list XML document\n");
+    ret = parse_imf_packing_list_from_reader(NULL, reader, &pkl);
+    if (ret) {
+        printf("Packing list parsing failed.\n");
+        goto cleanup;
+    }
+
+    /* the asset hashed with MD5 is skipped */
+    printf("Compare hashed assets count: %d to 2\n", pkl.asset_count);
+    if (pkl.asset_count != 2) {
+        printf("Packing list parsing failed: found %d hashes instead of 2 expected.\n", pkl.asset_count);
+        ret = 1;
+        goto cleanup;
+    }
+
+    for (uint32_t i = 0; i < pkl.asset_count; i++)
+        printf("Asset " FF_UUID_FORMAT ": %s, %" PRId64 " bytes\n",
+            UID_ARG(pkl.assets[i].uuid), av_hash_get_name(pkl.assets[i].hash), pkl.assets[i].size);
+
+    if (memcmp(pkl.assets[0].uuid, ASSET_MAP_EXPECTED_LOCATORS[0].uuid, 16) || pkl.assets[0].size != 1234567
+        || strcmp(av_hash_get_name(pkl.assets[0].hash), "SHA160")
+        || memcmp(pkl.assets[0].digest, sha1_empty, sizeof(sha1_empty))) {
+        printf("Invalid hash of the first asset.\n");
+        ret = 1;
+        goto cleanup;
+    }
+
+    if (memcmp(pkl.assets[1].uuid, ASSET_MAP_EXPECTED_LOCATORS[3].uuid, 16)
+        || strcmp(av_hash_get_name(pkl.assets[1].hash), "SHA256")) {
+        printf("Invalid hash of the third asset.\n");
+        ret = 1;
+        goto cleanup;
+    }
+
+cleanup:
+    imf_packing_list_deinit(&pkl);
+    xmlFreeTextReader(reader);
     return ret;
 }
 
@@ -486,6 +599,352 @@ fail:
     return 1;
 }
 
+static char *get_data_url(const char *doc)
+{
+    static const char prefix[] = "data:text/xml;base64,";
+    int size = strlen(doc);
+    char *url = av_malloc(sizeof(prefix) - 1 + AV_BASE64_SIZE(size));
+
+    if (!url)
+        return NULL;
+    memcpy(url, prefix, sizeof(prefix) - 1);
+    av_base64_encode(url + sizeof(prefix) - 1, AV_BASE64_SIZE(size), doc, size);
+    return url;
+}
+
+/*
+ * Fetches two copies of the asset map, the packing list and a broken asset map
+ * concurrently. The asset maps are loaded in order, so the locators of the
+ * first copy are found, and the broken map only fails when it is waited for.
+ */
+static int test_concurrent_fetch(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    char *asset_map_url = get_data_url(asset_map_doc);
+    char *packing_list_url = get_data_url(packing_list_doc);
+    IMFDocumentFetch *fetches[4] = { NULL };
+    IMFContext *c;
+    int ret = 1;
+
+    if (!s || !asset_map_url || !packing_list_url || !(s->url = av_strdup(""))
+        || !(s->priv_data = c = av_mallocz(sizeof(IMFContext)))) {
+        printf("Context allocation failed.\n");
+        goto cleanup;
+    }
+    c->concurrent_fetch = 1;
+    imf_asset_locator_map_init(&c->asset_locator_map);
+
+    if (!(fetches[0] = start_fetch(s, asset_map_url, 0))
+        || !(fetches[1] = start_fetch(s, asset_map_url, 0))
+        || !(fetches[2] = start_fetch(s, packing_list_url, 1))
+        || !(fetches[3] = start_fetch(s, "data:text/xml,<AssetMap>", 0))) {
+        printf("Fetch allocation failed.\n");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < 2; i++)
+        if (load_assetmap(s, fetches[i]) < 0) {
+            printf("Asset map %d loading failed.\n", i);
+            goto cleanup;
+        }
+    printf("Loaded assets count: %" PRIu32 "\n", c->asset_locator_map.asset_count);
+    if (c->asset_locator_map.asset_count != 10) {
+        printf("Asset map loading failed: found %" PRIu32 " assets instead of 10 expected.\n",
+            c->asset_locator_map.asset_count);
+        goto cleanup;
+    }
+    for (int i = 0; i < 5; i++)
+        if (find_asset_map_locator(&c->asset_locator_map, ASSET_MAP_EXPECTED_LOCATORS[i].uuid)
+            != &c->asset_locator_map.assets[i]) {
+            printf("Asset lookup did not return the asset of the first map for asset %d.\n", i);
+            goto cleanup;
+        }
+
+    if (wait_fetch(fetches[2]) < 0) {
+        printf("Packing list fetch failed.\n");
+        goto cleanup;
+    }
+    printf("Fetched packing list hashes count: %" PRIu32 "\n", fetches[2]->pkl.asset_count);
+    if (fetches[2]->pkl.asset_count != 2) {
+        printf("Packing list fetch failed: found %" PRIu32 " hashes instead of 2 expected.\n",
+            fetches[2]->pkl.asset_count);
+        goto cleanup;
+    }
+
+    if (wait_fetch(fetches[3]) >= 0) {
+        printf("Broken asset map fetch succeeded.\n");
+        goto cleanup;
+    }
+    printf("Broken asset map fetch failed\n");
+
+    ret = 0;
+
+cleanup:
+    for (int i = 0; i < 4; i++)
+        free_fetch(&fetches[i]);
+    if (s && s->priv_data)
+        imf_asset_locator_map_deinit(&c->asset_locator_map);
+    avformat_free_context(s);
+    av_free(asset_map_url);
+    av_free(packing_list_url);
+    return ret;
+}
+
+static const AVInputFormat track_file_test_format = {
+    .name = "imf_track_file_test",
+};
+
+static int open_test_track_file(AVFormatContext *s, IMFTrackFileCtx *track_file)
+{
+    IMFContext *c = s->priv_data;
+    uint8_t *buf = av_malloc(16);
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    if (!(track_file->ctx = avformat_alloc_context())) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    track_file->ctx->opaque = s;
+    track_file->ctx->iformat = &track_file_test_format;
+    track_file->ctx->pb = avio_alloc_context(buf, 16, 0, NULL, NULL, NULL, NULL);
+    if (!track_file->ctx->pb) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    track_file->parked = 0;
+    track_file->use_seq = c->use_seq++;
+    return 0;
+}
+
+static void print_track_files(IMFContext *c)
+{
+    for (uint32_t i = 0; i < c->track_file_count; ++i)
+        printf("\tTrack file %" PRIu32 ": %s\n", i,
+            !c->track_files[i]->ctx ? "closed" :
+            c->track_files[i]->parked ? "parked" : "open");
+}
+
+static int test_track_file_lru(void)
+{
+    static const char *const expected[] = { "parked", "closed", "closed", "open" };
+    AVFormatContext *s = avformat_alloc_context();
+    IMFTrackFileCtx *track_files[4];
+    IMFContext *c;
+    FFUUID uuid = { 0 };
+    int ret = 1;
+
+    if (!s || !(s->priv_data = c = av_mallocz(sizeof(IMFContext)))) {
+        printf("Context allocation failed.\n");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        uuid[15] = i;
+        if (!(track_files[i] = imf_track_file_ctx_acquire(c, uuid, 0))
+            || open_test_track_file(s, track_files[i]) < 0) {
+            printf("Track file allocation failed.\n");
+            goto cleanup;
+        }
+    }
+    /* the first track file was used again, the last one is read */
+    track_files[0]->use_seq = c->use_seq++;
+    track_files[3]->in_use = 1;
+
+    c->max_open_resources = 2;
+    c->max_parked_resources = 1;
+    printf("Evict track files to open one more, at most 2 open and 1 parked\n");
+    evict_track_files(s, 1);
+    print_track_files(c);
+    for (int i = 0; i < 4; i++)
+        if (strcmp(expected[i], !track_files[i]->ctx ? "closed" :
+                                track_files[i]->parked ? "parked" : "open")) {
+            printf("Track file %d is not %s.\n", i, expected[i]);
+            goto cleanup;
+        }
+
+    printf("Evict track files when the open ones are all read\n");
+    evict_track_files(s, 2);
+    print_track_files(c);
+    if (!track_files[3]->ctx || track_files[3]->parked) {
+        printf("Track file 3 was evicted while in use.\n");
+        goto cleanup;
+    }
+
+    printf("Park track files without parked contexts\n");
+    c->max_parked_resources = 0;
+    track_files[3]->in_use = 0;
+    imf_track_file_park(s, track_files[3]);
+    print_track_files(c);
+    if (track_files[3]->ctx || !track_files[0]->parked) {
+        printf("Track file 3 was not closed.\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    if (s && s->priv_data) {
+        while (c->track_file_count) {
+            c->track_files[0]->ref_count = 1;
+            imf_track_file_ctx_release(c, c->track_files[0]);
+        }
+        av_freep(&c->track_files);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+static int test_resource_cursor(void)
+{
+    static const struct {
+        int64_t edit_unit;
+        int64_t resource_index;
+    } lookups[] = {
+        { 0, 0 }, { 23, 0 }, { 24, 1 }, { 71, 1 }, { 72, 2 },
+        { 95, 2 }, { 96, 3 }, { 107, 3 }, { 108, -1 }, { -1, -1 },
+    };
+    IMFTrackFileCtx track_files[3] = { 0 };
+    IMFVirtualTrackResourcePlaybackCtx resources[4] = {
+        { .track_file = &track_files[0], .start_edit_unit =  0, .duration = 24 },
+        { .track_file = &track_files[1], .start_edit_unit = 24, .duration = 48 },
+        { .track_file = &track_files[0], .start_edit_unit = 72, .duration = 24 },
+        { .track_file = &track_files[2], .start_edit_unit = 96, .duration = 12 },
+    };
+    IMFVirtualTrackPlaybackCtx track = {
+        .resource_count = 4,
+        .resources = resources,
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(lookups); i++) {
+        int64_t index = find_resource_index_for_edit_unit(&track, lookups[i].edit_unit);
+
+        printf("Edit unit %" PRId64 ": resource %" PRId64 "\n", lookups[i].edit_unit, index);
+        if (index != lookups[i].resource_index) {
+            printf("Resource lookup failed: found %" PRId64 " instead of %" PRId64 " expected.\n",
+                index,
+                lookups[i].resource_index);
+            return 1;
+        }
+    }
+
+    /* a track file stays open while a later resource of the track uses it */
+    printf("Track file 0 used from resource 1: %d\n", track_file_is_used_from(&track, 1, &track_files[0]));
+    printf("Track file 0 used from resource 3: %d\n", track_file_is_used_from(&track, 3, &track_files[0]));
+    if (!track_file_is_used_from(&track, 1, &track_files[0])
+        || track_file_is_used_from(&track, 3, &track_files[0])) {
+        printf("Track file use lookup failed.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+#if HAVE_THREADS
+static int send_read_ahead_packet(IMFVirtualTrackPlaybackCtx *track, int64_t timestamp, int end)
+{
+    IMFReadAheadMsg msg = { .timestamp = timestamp, .ret = AVERROR_EOF };
+
+    if (!end) {
+        if (!(msg.pkt = av_packet_alloc()))
+            return AVERROR(ENOMEM);
+        msg.pkt->pts = timestamp;
+        msg.pkt->stream_index = track->index;
+    }
+    return av_thread_message_queue_send(track->read_ahead_queue, &msg, 0);
+}
+
+/*
+ * Queues the packets of a 1/24 video track and a 1/48000 audio track, as read
+ * ahead by their worker threads, and checks that the demuxer returns them in
+ * timestamp order, the first track first on equal timestamps.
+ */
+static int test_read_ahead_order(void)
+{
+    static const struct {
+        int stream_index;
+        int64_t pts;
+    } expected[] = {
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 3000 },
+        { 0, 2 }, { 0, 3 }, { 1, 6000 },
+    };
+    static const AVRational time_bases[2] = { { 1, 24 }, { 1, 48000 } };
+    static const int packets[2] = { 4, 3 };
+    static const int durations[2] = { 1, 3000 };
+    AVFormatContext *s = avformat_alloc_context();
+    IMFVirtualTrackPlaybackCtx tracks[2] = { { 0 } };
+    IMFVirtualTrackPlaybackCtx *track_ptrs[2] = { &tracks[0], &tracks[1] };
+    AVPacket *pkt = av_packet_alloc();
+    IMFContext *c;
+    int ret = 1;
+
+    if (!s || !pkt || !(s->priv_data = c = av_mallocz(sizeof(IMFContext)))) {
+        printf("Context allocation failed.\n");
+        goto cleanup;
+    }
+    c->tracks = track_ptrs;
+    c->track_count = 2;
+    c->read_ahead_started = 1;
+
+    for (int i = 0; i < 2; i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+
+        if (!st || av_thread_message_queue_alloc(&tracks[i].read_ahead_queue, packets[i] + 1,
+                                                 sizeof(IMFReadAheadMsg)) < 0) {
+            printf("Track allocation failed.\n");
+            goto cleanup;
+        }
+        av_thread_message_queue_set_free_func(tracks[i].read_ahead_queue, read_ahead_msg_free);
+        st->time_base = time_bases[i];
+        tracks[i].index = i;
+        tracks[i].read_ahead_thread_running = 1;
+        for (int j = 0; j <= packets[i]; j++)
+            if (send_read_ahead_packet(&tracks[i], j * durations[i], j == packets[i]) < 0) {
+                printf("Packet allocation failed.\n");
+                goto cleanup;
+            }
+        av_thread_message_queue_recv(tracks[i].read_ahead_queue, &tracks[i].read_ahead_head, 0);
+    }
+    if (init_track_heap(s) < 0) {
+        printf("Track heap allocation failed.\n");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(expected); i++) {
+        if (read_ahead_packet(s, pkt) < 0) {
+            printf("Read-ahead ended after %d packets.\n", i);
+            goto cleanup;
+        }
+        printf("Read-ahead packet: stream %d, pts %" PRId64 "\n", pkt->stream_index, pkt->pts);
+        if (pkt->stream_index != expected[i].stream_index || pkt->pts != expected[i].pts) {
+            printf("Read-ahead order failed: expected stream %d, pts %" PRId64 ".\n",
+                expected[i].stream_index,
+                expected[i].pts);
+            goto cleanup;
+        }
+        av_packet_unref(pkt);
+    }
+    if (read_ahead_packet(s, pkt) != AVERROR_EOF) {
+        printf("Read-ahead did not end with the tracks.\n");
+        goto cleanup;
+    }
+    printf("Read-ahead end of tracks\n");
+
+    ret = 0;
+
+cleanup:
+    for (int i = 0; i < 2; i++) {
+        av_thread_message_queue_free(&tracks[i].read_ahead_queue);
+        av_packet_free(&tracks[i].read_ahead_head.pkt);
+    }
+    if (s && s->priv_data)
+        av_freep(&c->track_heap);
+    avformat_free_context(s);
+    av_packet_free(&pkt);
+    return ret;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     int ret = 0;
@@ -496,9 +955,26 @@ int main(int argc, char *argv[])
     if (test_asset_map_parsing() != 0)
         ret = 1;
 
+    if (test_packing_list_parsing() != 0)
+        ret = 1;
+
     if (test_path_type_functions() != 0)
         ret = 1;
 
+    if (test_concurrent_fetch() != 0)
+        ret = 1;
+
+    if (test_track_file_lru() != 0)
+        ret = 1;
+
+    if (test_resource_cursor() != 0)
+        ret = 1;
+
+#if HAVE_THREADS
+    if (test_read_ahead_order() != 0)
+        ret = 1;
+#endif
+
     printf("#### The following should fail ####\n");
     if (test_bad_cpl_parsing() == 0)
         ret = 1;
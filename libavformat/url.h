@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -86,6 +87,17 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    /**
+     * Return a reference to size bytes of the resource starting at pos,
+     * followed by at least AV_INPUT_BUFFER_PADDING_SIZE readable bytes,
+     * without copying them. The returned buffer is read-only.
+     */
+    int (*url_get_buffer)(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+    /**
+     * Hint that size bytes starting at pos will be read soon, so that they
+     * can be fetched in the background.
+     */
+    int (*url_prefetch)(URLContext *h, int64_t pos, int64_t size);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -254,6 +266,23 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Get a read-only reference to size bytes of the resource starting at pos,
+ * for protocols that can provide one without copying.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if not supported for this range
+ *         or another negative error code
+ */
+int ffurl_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+
+/**
+ * Tell the protocol that size bytes starting at pos will be read soon.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the protocol takes no hints
+ *         or another negative error code
+ */
+int ffurl_prefetch(URLContext *h, int64_t pos, int64_t size);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -207,9 +207,39 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
     pkt->pos  = avio_tell(s);
 
+    if (size > 0 && ffio_read_buffer_ref(s, size, &pkt->buf) >= 0) {
+        pkt->data = pkt->buf->data;
+        pkt->size = size;
+        return size;
+    }
+
     return append_packet_chunked(s, pkt, size);
 }
 
+int av_get_packet_pooled(AVIOContext *s, AVPacketPool *pool, AVPacket *pkt, int size)
+{
+    int ret;
+
+    av_packet_unref(pkt);
+    size = ffio_limit(s, size);
+    ret  = av_packet_pool_new_packet(pool, pkt, size);
+    if (ret < 0)
+        return ret;
+    pkt->pos = avio_tell(s);
+
+    ret = avio_read(s, pkt->data, size);
+    if (ret <= 0) {
+        av_packet_unref(pkt);
+        return ret < 0 ? ret : AVERROR_EOF;
+    }
+    if (ret < size) {
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+        av_shrink_packet(pkt, ret);
+    }
+
+    return ret;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -303,8 +333,13 @@ void ff_flush_packet_queue(AVFormatContext *s)
     avpriv_packet_list_free(&si->parse_queue,       &si->parse_queue_end);
     avpriv_packet_list_free(&si->packet_buffer,     &si->packet_buffer_end);
     avpriv_packet_list_free(&si->raw_packet_buffer, &si->raw_packet_buffer_end);
+    for (int i = si->batch_pos; i < si->batch_nb; i++)
+        av_packet_unref(si->batch_pkts[i]);
 
     si->raw_packet_buffer_size = 0;
+    si->batch_pos = si->batch_nb = 0;
+    si->batch_error = 0;
+    si->read_frames_error = 0;
 }
 
 int av_find_default_stream_index(AVFormatContext *s)
@@ -718,6 +753,8 @@ void avformat_free_context(AVFormatContext *s)
     av_packet_free(&si->parse_pkt);
     av_freep(&s->streams);
     ff_flush_packet_queue(s);
+    for (int i = 0; i < MAX_READ_BATCH; i++)
+        av_packet_free(&si->batch_pkts[i]);
     av_freep(&s->url);
     av_free(s);
 }
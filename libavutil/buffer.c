@@ -272,6 +272,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
     pool->alloc     = av_buffer_alloc; // fallback
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -288,6 +289,7 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -295,15 +297,47 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
 
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolEntry *buf = (BufferPoolEntry *)atomic_exchange_explicit(&pool->pool, 0,
+                                                                       memory_order_acquire);
+
+    while (buf) {
+        BufferPoolEntry *next = buf->next;
 
         buf->free(buf->opaque, buf->data);
         av_freep(&buf);
+        buf = next;
     }
 }
 
+static void buffer_pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uintptr_t head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+
+    do {
+        buf->next = (BufferPoolEntry *)head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, (uintptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/* must be called with pool->mutex held */
+static BufferPoolEntry *buffer_pool_pop(AVBufferPool *pool)
+{
+    uintptr_t head = atomic_load_explicit(&pool->pool, memory_order_acquire);
+    BufferPoolEntry *buf;
+
+    do {
+        buf = (BufferPoolEntry *)head;
+        if (!buf)
+            return NULL;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, (uintptr_t)buf->next,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+    buf->next = NULL;
+
+    return buf;
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
@@ -344,10 +378,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    buffer_pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -386,24 +417,24 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
 
     ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = buffer_pool_pop(pool);
+    if (!buf)
+        ret = pool_alloc_buffer(pool);
+    ff_mutex_unlock(&pool->mutex);
+
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (ret)
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        else
+            buffer_pool_push(pool, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -87,8 +87,18 @@ typedef struct BufferPoolEntry {
 } BufferPoolEntry;
 
 struct AVBufferPool {
+    /*
+     * Serializes taking entries from the pool and allocating new ones.
+     * Entries are returned to the pool without taking it.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /*
+     * Stack of the available entries (BufferPoolEntry*). Since only one
+     * thread at a time pops from it, the compare-and-swap is not subject
+     * to the ABA problem.
+     */
+    atomic_uintptr_t pool;
 
     /*
      * This is used to track when the pool is to be freed.
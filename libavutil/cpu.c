@@ -16,6 +16,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_SCHED_GETAFFINITY
+/* CPU_COUNT() is only visible if this comes before any system header */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#endif
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdatomic.h>
@@ -23,14 +32,10 @@
 #include "attributes.h"
 #include "cpu.h"
 #include "cpu_internal.h"
-#include "config.h"
 #include "opt.h"
 #include "common.h"
 
 #if HAVE_SCHED_GETAFFINITY
-#ifndef _GNU_SOURCE
-# define _GNU_SOURCE
-#endif
 #include <sched.h>
 #endif
 #if HAVE_GETPROCESSAFFINITYMASK || HAVE_WINRT
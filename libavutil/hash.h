@@ -102,6 +102,9 @@
  * If the Murmur3 hash is selected, the default seed will be used. See @ref
  * lavu_murmur3_seedinfo "Murmur3" for more information.
  *
+ * The xxh3 and xxh3_128 hashes are XXH3 with the default secret and no seed,
+ * see @ref lavu_xxh3 "XXH3". They are not cryptographic, but much faster.
+ *
  * @{
  */
 
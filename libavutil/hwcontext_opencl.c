@@ -2197,6 +2197,15 @@ static inline cl_mem_flags opencl_mem_flags_for_mapping(int map_flags)
 
 #if HAVE_OPENCL_VAAPI_INTEL_MEDIA
 
+static int opencl_qsv_format_supported(enum AVPixelFormat sw_format)
+{
+    // The 10- and 16-bit formats need a recent enough driver, the mapping
+    // fails at creation of the images otherwise.
+    return sw_format == AV_PIX_FMT_NV12 ||
+           sw_format == AV_PIX_FMT_P010 ||
+           sw_format == AV_PIX_FMT_P016;
+}
+
 static void opencl_unmap_from_qsv(AVHWFramesContext *dst_fc,
                                   HWMapDescriptor *hwmap)
 {
@@ -2269,8 +2278,8 @@ static int opencl_map_from_qsv(AVHWFramesContext *dst_fc, AVFrame *dst,
     if (!desc)
         return AVERROR(ENOMEM);
 
-    // The cl_intel_va_api_media_sharing extension only supports NV12
-    // surfaces, so for now there are always exactly two planes.
+    // The surfaces supported by the cl_intel_va_api_media_sharing
+    // extension all have a luma and an interleaved chroma plane.
     desc->nb_planes = 2;
 
     for (p = 0; p < desc->nb_planes; p++) {
@@ -2870,6 +2879,12 @@ static int opencl_frames_derive_to(AVHWFramesContext *dst_fc,
     case AV_HWDEVICE_TYPE_VAAPI:
         if (!priv->qsv_mapping_usable)
             return AVERROR(ENOSYS);
+        if (!opencl_qsv_format_supported(src_fc->sw_format)) {
+            av_log(dst_fc, AV_LOG_ERROR, "Pixel format %s is not supported "
+                   "for mapping from QSV/VAAPI.\n",
+                   av_get_pix_fmt_name(src_fc->sw_format));
+            return AVERROR(ENOSYS);
+        }
         break;
 #endif
 #if HAVE_OPENCL_DXVA2
@@ -32,6 +32,9 @@
 #   ifndef DRM_FORMAT_MOD_INVALID
 #       define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
 #   endif
+#   ifndef DRM_FORMAT_MOD_LINEAR
+#       define DRM_FORMAT_MOD_LINEAR 0
+#   endif
 #endif
 
 #include <fcntl.h>
@@ -69,6 +72,8 @@ typedef struct VAAPIDeviceContext {
     // Surface formats which can be used with this device.
     VAAPISurfaceFormat *formats;
     int              nb_formats;
+    // Whether creating surfaces from DRM PRIME 2 descriptors failed.
+    int prime_2_import_unsupported;
 } VAAPIDeviceContext;
 
 typedef struct VAAPIFramesContext {
@@ -989,10 +994,23 @@ static const struct {
 } vaapi_drm_format_map[] = {
 #ifdef DRM_FORMAT_R8
     DRM_MAP(NV12, 2, DRM_FORMAT_R8,  DRM_FORMAT_RG88),
+    DRM_MAP(NV12, 2, DRM_FORMAT_R8,  DRM_FORMAT_GR88),
 #endif
     DRM_MAP(NV12, 1, DRM_FORMAT_NV12),
 #if defined(VA_FOURCC_P010) && defined(DRM_FORMAT_R16)
     DRM_MAP(P010, 2, DRM_FORMAT_R16, DRM_FORMAT_RG1616),
+    DRM_MAP(P010, 2, DRM_FORMAT_R16, DRM_FORMAT_GR1616),
+#endif
+#if defined(VA_FOURCC_P010) && defined(DRM_FORMAT_P010)
+    DRM_MAP(P010, 1, DRM_FORMAT_P010),
+#endif
+    DRM_MAP(YUY2, 1, DRM_FORMAT_YUYV),
+    DRM_MAP(UYVY, 1, DRM_FORMAT_UYVY),
+#if defined(VA_FOURCC_Y210) && defined(DRM_FORMAT_Y210)
+    DRM_MAP(Y210, 1, DRM_FORMAT_Y210),
+#endif
+#if defined(VA_FOURCC_X2R10G10B10) && defined(DRM_FORMAT_XRGB2101010)
+    DRM_MAP(X2R10G10B10, 1, DRM_FORMAT_XRGB2101010),
 #endif
     DRM_MAP(BGRA, 1, DRM_FORMAT_ARGB8888),
     DRM_MAP(BGRX, 1, DRM_FORMAT_XRGB8888),
@@ -1019,12 +1037,76 @@ static void vaapi_unmap_from_drm(AVHWFramesContext *dst_fc,
     vaDestroySurfaces(dst_dev->display, &surface_id, 1);
 }
 
+#if VA_CHECK_VERSION(1, 1, 0)
+static VAStatus vaapi_create_surface_from_prime_2(AVHWFramesContext *dst_fc,
+                                                  const AVFrame *src,
+                                                  const VAAPIFormatDescriptor *format_desc,
+                                                  uint32_t va_fourcc,
+                                                  VASurfaceID *surface_id)
+{
+    AVVAAPIDeviceContext *dst_dev = dst_fc->device_ctx->hwctx;
+    const AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor*)src->data[0];
+    VADRMPRIMESurfaceDescriptor prime_desc = {
+        .fourcc      = va_fourcc,
+        .width       = src->width,
+        .height      = src->height,
+        .num_objects = desc->nb_objects,
+        .num_layers  = desc->nb_layers,
+    };
+    VASurfaceAttrib attrs[2] = {
+        {
+            .type  = VASurfaceAttribMemoryType,
+            .flags = VA_SURFACE_ATTRIB_SETTABLE,
+            .value.type    = VAGenericValueTypeInteger,
+            .value.value.i = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+        },
+        {
+            .type  = VASurfaceAttribExternalBufferDescriptor,
+            .flags = VA_SURFACE_ATTRIB_SETTABLE,
+            .value.type    = VAGenericValueTypePointer,
+            .value.value.p = &prime_desc,
+        }
+    };
+    int i, j;
+
+    for (i = 0; i < desc->nb_objects; i++) {
+        prime_desc.objects[i].fd                  = desc->objects[i].fd;
+        prime_desc.objects[i].size                = desc->objects[i].size;
+        prime_desc.objects[i].drm_format_modifier = desc->objects[i].format_modifier;
+    }
+
+    for (i = 0; i < desc->nb_layers; i++) {
+        const AVDRMLayerDescriptor *layer = &desc->layers[i];
+
+        prime_desc.layers[i].drm_format = layer->format;
+        prime_desc.layers[i].num_planes = layer->nb_planes;
+        for (j = 0; j < layer->nb_planes; j++) {
+            prime_desc.layers[i].object_index[j] = layer->planes[j].object_index;
+            prime_desc.layers[i].offset[j]       = layer->planes[j].offset;
+            prime_desc.layers[i].pitch[j]        = layer->planes[j].pitch;
+        }
+
+        if (format_desc->chroma_planes_swapped && layer->nb_planes == 3) {
+            FFSWAP(uint32_t, prime_desc.layers[i].pitch[1],
+                             prime_desc.layers[i].pitch[2]);
+            FFSWAP(uint32_t, prime_desc.layers[i].offset[1],
+                             prime_desc.layers[i].offset[2]);
+        }
+    }
+
+    return vaCreateSurfaces(dst_dev->display, format_desc->rt_format,
+                            src->width, src->height, surface_id, 1,
+                            attrs, FF_ARRAY_ELEMS(attrs));
+}
+#endif
+
 static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
                               const AVFrame *src, int flags)
 {
     AVHWFramesContext      *dst_fc =
         (AVHWFramesContext*)dst->hw_frames_ctx->data;
     AVVAAPIDeviceContext  *dst_dev = dst_fc->device_ctx->hwctx;
+    VAAPIDeviceContext   *dst_priv = dst_fc->device_ctx->internal->priv;
     const AVDRMFrameDescriptor *desc;
     const VAAPIFormatDescriptor *format_desc;
     VASurfaceID surface_id;
@@ -1051,12 +1133,6 @@ static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
 
     desc = (AVDRMFrameDescriptor*)src->data[0];
 
-    if (desc->nb_objects != 1) {
-        av_log(dst_fc, AV_LOG_ERROR, "VAAPI can only map frames "
-               "made from a single DRM object.\n");
-        return AVERROR(EINVAL);
-    }
-
     va_fourcc = 0;
     for (i = 0; i < FF_ARRAY_ELEMS(vaapi_drm_format_map); i++) {
         if (desc->nb_layers != vaapi_drm_format_map[i].nb_layer_formats)
@@ -1083,6 +1159,33 @@ static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
     format_desc = vaapi_format_from_fourcc(va_fourcc);
     av_assert0(format_desc);
 
+#if VA_CHECK_VERSION(1, 1, 0)
+    // Frames made from several objects or with a tiling modifier, as
+    // exported by Vulkan, can only be described with the PRIME 2 memory type.
+    if (!dst_priv->prime_2_import_unsupported &&
+        (desc->nb_objects > 1 ||
+         (desc->objects[0].format_modifier != DRM_FORMAT_MOD_INVALID &&
+          desc->objects[0].format_modifier != DRM_FORMAT_MOD_LINEAR))) {
+        vas = vaapi_create_surface_from_prime_2(dst_fc, src, format_desc,
+                                                va_fourcc, &surface_id);
+        if (vas == VA_STATUS_SUCCESS)
+            goto mapped;
+        av_log(dst_fc, AV_LOG_VERBOSE, "Failed to create surface from "
+               "DRM PRIME 2 descriptor: %d (%s).\n", vas, vaErrorStr(vas));
+        // Support for the memory type can't be queried without a config,
+        // drivers which don't have it reject it.
+        if (vas == VA_STATUS_ERROR_ATTR_NOT_SUPPORTED ||
+            vas == VA_STATUS_ERROR_UNSUPPORTED_MEMORY_TYPE)
+            dst_priv->prime_2_import_unsupported = 1;
+    }
+#endif
+
+    if (desc->nb_objects != 1) {
+        av_log(dst_fc, AV_LOG_ERROR, "VAAPI can only map frames "
+               "made from a single DRM object.\n");
+        return AVERROR(EINVAL);
+    }
+
     buffer_handle = desc->objects[0].fd;
     buffer_desc.pixel_format = va_fourcc;
     buffer_desc.width        = src_fc->width;
@@ -1117,6 +1220,10 @@ static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
                "object: %d (%s).\n", vas, vaErrorStr(vas));
         return AVERROR(EIO);
     }
+
+#if VA_CHECK_VERSION(1, 1, 0)
+mapped:
+#endif
     av_log(dst_fc, AV_LOG_DEBUG, "Create surface %#x.\n", surface_id);
 
     err = ff_hwframe_map_create(dst->hw_frames_ctx, dst, src,
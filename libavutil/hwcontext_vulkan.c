@@ -114,6 +114,10 @@ typedef struct VulkanFramesPriv {
     /* Image transfers */
     VulkanExecCtx upload_ctx;
     VulkanExecCtx download_ctx;
+
+    /* Host visible staging buffers for the transfers, per plane */
+    AVBufferPool *staging_pool[AV_NUM_DATA_POINTERS];
+    size_t staging_size[AV_NUM_DATA_POINTERS];
 } VulkanFramesPriv;
 
 typedef struct AVVkFrameInternal {
@@ -2030,6 +2034,9 @@ static void vulkan_frames_uninit(AVHWFramesContext *hwfc)
     free_exec_ctx(hwfc, &fp->conv_ctx);
     free_exec_ctx(hwfc, &fp->upload_ctx);
     free_exec_ctx(hwfc, &fp->download_ctx);
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+        av_buffer_pool_uninit(&fp->staging_pool[i]);
 }
 
 static int vulkan_frames_init(AVHWFramesContext *hwfc)
@@ -3228,6 +3235,45 @@ fail:
     return err;
 }
 
+static AVBufferRef *alloc_staging_buf(void *opaque, size_t size)
+{
+    AVHWFramesContext *hwfc = opaque;
+    AVBufferRef *buf;
+
+    if (create_buf(hwfc->device_ctx, &buf,
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, size, 0, 0, NULL, NULL))
+        return NULL;
+
+    return buf;
+}
+
+/* Staging buffers are pooled per plane, allocating device memory for every
+ * transfer is far more expensive than the copy itself. The pool is replaced
+ * if the size changes, buffers still in flight keep the old one alive. */
+static int get_staging_buf(AVHWFramesContext *hwfc, int plane, size_t size,
+                           AVBufferRef **buf)
+{
+    VulkanFramesPriv *fp = hwfc->internal->priv;
+
+    if (fp->staging_pool[plane] && fp->staging_size[plane] != size)
+        av_buffer_pool_uninit(&fp->staging_pool[plane]);
+
+    if (!fp->staging_pool[plane]) {
+        fp->staging_pool[plane] = av_buffer_pool_init2(size, hwfc,
+                                                       alloc_staging_buf, NULL);
+        if (!fp->staging_pool[plane])
+            return AVERROR(ENOMEM);
+        fp->staging_size[plane] = size;
+    }
+
+    *buf = av_buffer_pool_get(fp->staging_pool[plane]);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
 /* Skips mapping of host mapped buffers but still invalidates them */
 static int map_buffers(AVHWDeviceContext *ctx, AVBufferRef **bufs, uint8_t *mem[],
                        int nb_buffers, int invalidate)
@@ -3337,7 +3383,8 @@ static int unmap_buffers(AVHWDeviceContext *ctx, AVBufferRef **bufs,
 static int transfer_image_buf(AVHWFramesContext *hwfc, const AVFrame *f,
                               AVBufferRef **bufs, size_t *buf_offsets,
                               const int *buf_stride, int w,
-                              int h, enum AVPixelFormat pix_fmt, int to_buf)
+                              int h, enum AVPixelFormat pix_fmt, int to_buf,
+                              int host_mapped)
 {
     int err;
     AVVkFrame *frame = (AVVkFrame *)f->data[0];
@@ -3442,23 +3489,24 @@ static int transfer_image_buf(AVHWFramesContext *hwfc, const AVFrame *f,
                                      frame->layout[i], 1, &buf_reg);
     }
 
-    /* When uploading, do this asynchronously if the source is refcounted by
-     * keeping the buffers as a submission dependency.
+    /* When uploading, do this asynchronously by keeping the staging buffers,
+     * and the source if its memory was imported and it is refcounted, as a
+     * submission dependency. Consumers wait on the frame semaphores.
      * The hwcontext is guaranteed to not be freed until all frames are freed
      * in the frames_unint function.
      * When downloading to buffer, do this synchronously and wait for the
      * queue submission to finish executing */
     if (!to_buf) {
-        int ref;
-        for (ref = 0; ref < AV_NUM_DATA_POINTERS; ref++) {
+        int ref = 0;
+        for (; host_mapped && ref < AV_NUM_DATA_POINTERS; ref++) {
             if (!f->buf[ref])
                 break;
             if ((err = add_buf_dep_exec_ctx(hwfc, ectx, &f->buf[ref], 1)))
                 return err;
         }
-        if (ref && (err = add_buf_dep_exec_ctx(hwfc, ectx, bufs, planes)))
+        if ((err = add_buf_dep_exec_ctx(hwfc, ectx, bufs, planes)))
             return err;
-        return submit_exec_ctx(hwfc, ectx, &s_info, frame, !ref);
+        return submit_exec_ctx(hwfc, ectx, &s_info, frame, host_mapped && !ref);
     } else {
         return submit_exec_ctx(hwfc, ectx, &s_info, frame,    1);
     }
@@ -3483,6 +3531,7 @@ static int vulkan_transfer_data(AVHWFramesContext *hwfc, const AVFrame *vkf,
     const int planes = av_pix_fmt_count_planes(swf->format);
 
     int host_mapped[AV_NUM_DATA_POINTERS] = { 0 };
+    int any_host_mapped = 0;
     const int map_host = !!(p->extensions & FF_VK_EXT_EXTERNAL_HOST_MEMORY);
 
     if ((swf->format != AV_PIX_FMT_NONE && !av_vkfmt_from_pixfmt(swf->format))) {
@@ -3554,16 +3603,18 @@ static int vulkan_transfer_data(AVHWFramesContext *hwfc, const AVFrame *vkf,
             }
         }
 
-        if (!host_mapped[i])
+        if (!host_mapped[i]) {
             req_size = get_req_buffer_size(p, &tmp.linesize[i], p_h);
-
-        err = create_buf(dev_ctx, &bufs[i],
-                         from ? VK_BUFFER_USAGE_TRANSFER_DST_BIT :
-                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                         req_size, p_props.memoryTypeBits, host_mapped[i],
-                         host_mapped[i] ? &create_desc : NULL,
-                         host_mapped[i] ? &import_desc : NULL);
+            err = get_staging_buf(hwfc, i, req_size, &bufs[i]);
+        } else {
+            err = create_buf(dev_ctx, &bufs[i],
+                             from ? VK_BUFFER_USAGE_TRANSFER_DST_BIT :
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                             req_size, p_props.memoryTypeBits, 1,
+                             &create_desc, &import_desc);
+            any_host_mapped = 1;
+        }
         if (err)
             goto end;
     }
@@ -3591,7 +3642,8 @@ static int vulkan_transfer_data(AVHWFramesContext *hwfc, const AVFrame *vkf,
 
     /* Copy buffers into/from image */
     err = transfer_image_buf(hwfc, vkf, bufs, buf_offsets, tmp.linesize,
-                             swf->width, swf->height, swf->format, from);
+                             swf->width, swf->height, swf->format, from,
+                             any_host_mapped);
 
     if (from) {
         /* Map, copy buffer (which came FROM the VkImage) to the frame, unmap */
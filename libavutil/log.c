@@ -32,7 +32,9 @@
 #if HAVE_IO_H
 #include <io.h>
 #endif
+#include <inttypes.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include "avutil.h"
 #include "bprint.h"
@@ -40,6 +42,7 @@
 #include "internal.h"
 #include "log.h"
 #include "thread.h"
+#include "time.h"
 
 static AVMutex mutex = AV_MUTEX_INITIALIZER;
 
@@ -343,28 +346,16 @@ int av_log_format_line2(void *ptr, int level, const char *fmt, va_list vl,
     return ret;
 }
 
-void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+/* must be called with the mutex held */
+static void print_line(char *part[4], int level, unsigned tint,
+                       const int type[2], int print_prefix)
 {
-    static int print_prefix = 1;
     static int count;
     static char prev[LINE_SZ];
-    AVBPrint part[4];
     char line[LINE_SZ];
     static int is_atty;
-    int type[2];
-    unsigned tint = 0;
-
-    if (level >= 0) {
-        tint = level & 0xff00;
-        level &= 0xff;
-    }
-
-    if (level > av_log_level)
-        return;
-    ff_mutex_lock(&mutex);
 
-    format_line(ptr, level, fmt, vl, part, &print_prefix, type);
-    snprintf(line, sizeof(line), "%s%s%s%s", part[0].str, part[1].str, part[2].str, part[3].str);
+    snprintf(line, sizeof(line), "%s%s%s%s", part[0], part[1], part[2], part[3]);
 
 #if HAVE_ISATTY
     if (!is_atty)
@@ -376,31 +367,253 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
         count++;
         if (is_atty == 1)
             fprintf(stderr, "    Last message repeated %d times\r", count);
-        goto end;
+        return;
     }
     if (count > 0) {
         fprintf(stderr, "    Last message repeated %d times\n", count);
         count = 0;
     }
     strcpy(prev, line);
-    sanitize(part[0].str);
-    colored_fputs(type[0], 0, part[0].str);
-    sanitize(part[1].str);
-    colored_fputs(type[1], 0, part[1].str);
-    sanitize(part[2].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2].str);
-    sanitize(part[3].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3].str);
+    sanitize(part[0]);
+    colored_fputs(type[0], 0, part[0]);
+    sanitize(part[1]);
+    colored_fputs(type[1], 0, part[1]);
+    sanitize(part[2]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2]);
+    sanitize(part[3]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3]);
 
 #if CONFIG_VALGRIND_BACKTRACE
     if (level <= BACKTRACE_LOGLEVEL)
         VALGRIND_PRINTF_BACKTRACE("%s", "");
 #endif
-end:
+}
+
+void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+{
+    static int print_prefix = 1;
+    AVBPrint part[4];
+    char *str[4];
+    int type[2];
+    unsigned tint = 0;
+
+    if (level >= 0) {
+        tint = level & 0xff00;
+        level &= 0xff;
+    }
+
+    if (level > av_log_level)
+        return;
+    ff_mutex_lock(&mutex);
+
+    format_line(ptr, level, fmt, vl, part, &print_prefix, type);
+    for (int i = 0; i < 4; i++)
+        str[i] = part[i].str;
+    print_line(str, level, tint, type, print_prefix);
+
     av_bprint_finalize(part+3, NULL);
     ff_mutex_unlock(&mutex);
 }
 
+#if HAVE_THREADS
+typedef struct LogMessage {
+    /* position in the queue at which the message may be written, plus one
+     * once it is written and may be read */
+    atomic_uint seq;
+    int level;
+    unsigned tint;
+    int type[2];
+    int print_prefix;
+    /* the 4 parts of the line, each NUL-terminated */
+    char buf[LINE_SZ];
+} LogMessage;
+
+static struct {
+    LogMessage *msgs;
+    unsigned mask;
+    atomic_uint write_pos;
+    unsigned read_pos;
+    atomic_int active;
+    atomic_int stop;
+    atomic_int print_prefix;
+    atomic_uint_least64_t dropped;
+    uint64_t reported;
+    pthread_t thread;
+} async;
+
+static int log_async_read(void)
+{
+    LogMessage *msg = &async.msgs[async.read_pos & async.mask];
+    unsigned seq = atomic_load_explicit(&msg->seq, memory_order_acquire);
+    uint64_t dropped;
+    char *part[4];
+
+    if (seq != async.read_pos + 1)
+        return 0;
+
+    part[0] = msg->buf;
+    for (int i = 1; i < 4; i++)
+        part[i] = part[i - 1] + strlen(part[i - 1]) + 1;
+
+    ff_mutex_lock(&mutex);
+    print_line(part, msg->level, msg->tint, msg->type, msg->print_prefix);
+    dropped = atomic_load_explicit(&async.dropped, memory_order_relaxed);
+    if (dropped != async.reported) {
+        fprintf(stderr, "    %"PRIu64" log messages dropped\n",
+                dropped - async.reported);
+        async.reported = dropped;
+    }
+    ff_mutex_unlock(&mutex);
+
+    atomic_store_explicit(&msg->seq, async.read_pos + async.mask + 1,
+                          memory_order_release);
+    async.read_pos++;
+    return 1;
+}
+
+static void *log_async_thread(void *arg)
+{
+    while (!atomic_load_explicit(&async.stop, memory_order_acquire)) {
+        if (!log_async_read())
+            av_usleep(1000);
+    }
+    while (log_async_read());
+    return NULL;
+}
+
+void av_log_async_callback(void *ptr, int level, const char *fmt, va_list vl)
+{
+    LogMessage *msg;
+    AVBPrint part[4];
+    unsigned tint = 0, pos;
+    int print_prefix, type[2];
+    char *p, *end;
+
+    if (!atomic_load_explicit(&async.active, memory_order_acquire)) {
+        av_log_default_callback(ptr, level, fmt, vl);
+        return;
+    }
+
+    if (level >= 0) {
+        tint = level & 0xff00;
+        level &= 0xff;
+    }
+
+    if (level > av_log_level)
+        return;
+
+    print_prefix = atomic_load_explicit(&async.print_prefix, memory_order_relaxed);
+    format_line(ptr, level, fmt, vl, part, &print_prefix, type);
+    atomic_store_explicit(&async.print_prefix, print_prefix, memory_order_relaxed);
+
+    pos = atomic_load_explicit(&async.write_pos, memory_order_relaxed);
+    for (;;) {
+        int diff;
+        msg  = &async.msgs[pos & async.mask];
+        diff = atomic_load_explicit(&msg->seq, memory_order_acquire) - pos;
+        if (!diff) {
+            if (atomic_compare_exchange_weak_explicit(&async.write_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&async.dropped, 1, memory_order_relaxed);
+            goto end;
+        } else {
+            pos = atomic_load_explicit(&async.write_pos, memory_order_relaxed);
+        }
+    }
+
+    msg->level        = level;
+    msg->tint         = tint;
+    msg->type[0]      = type[0];
+    msg->type[1]      = type[1];
+    msg->print_prefix = print_prefix;
+    p   = msg->buf;
+    end = msg->buf + sizeof(msg->buf);
+    for (int i = 0; i < 4; i++) {
+        /* keep room for the terminators of the remaining parts */
+        size_t len = FFMIN(strlen(part[i].str), end - p - (4 - i));
+        memcpy(p, part[i].str, len);
+        p[len] = 0;
+        p += len + 1;
+    }
+    atomic_store_explicit(&msg->seq, pos + 1, memory_order_release);
+
+end:
+    av_bprint_finalize(part+3, NULL);
+}
+
+int av_log_async_start(unsigned nb_messages)
+{
+    int ret;
+
+    if (atomic_load(&async.active))
+        return AVERROR(EINVAL);
+
+    if (!nb_messages)
+        nb_messages = 1024;
+    if (nb_messages > 1 << 20)
+        return AVERROR(EINVAL);
+    nb_messages = 1 << av_ceil_log2(nb_messages);
+
+    async.msgs = av_malloc_array(nb_messages, sizeof(*async.msgs));
+    if (!async.msgs)
+        return AVERROR(ENOMEM);
+    for (unsigned i = 0; i < nb_messages; i++)
+        atomic_init(&async.msgs[i].seq, i);
+    async.mask     = nb_messages - 1;
+    async.read_pos = 0;
+    async.reported = 0;
+    atomic_init(&async.write_pos, 0);
+    atomic_init(&async.stop, 0);
+    atomic_init(&async.print_prefix, 1);
+    atomic_init(&async.dropped, 0);
+
+    ret = pthread_create(&async.thread, NULL, log_async_thread, NULL);
+    if (ret) {
+        av_freep(&async.msgs);
+        return AVERROR(ret);
+    }
+    atomic_store(&async.active, 1);
+    return 0;
+}
+
+void av_log_async_stop(void)
+{
+    if (!atomic_load(&async.active))
+        return;
+    atomic_store(&async.active, 0);
+    atomic_store(&async.stop, 1);
+    pthread_join(async.thread, NULL);
+    av_freep(&async.msgs);
+}
+
+uint64_t av_log_async_get_dropped(void)
+{
+    return atomic_load_explicit(&async.dropped, memory_order_relaxed);
+}
+#else
+void av_log_async_callback(void *ptr, int level, const char *fmt, va_list vl)
+{
+    av_log_default_callback(ptr, level, fmt, vl);
+}
+
+int av_log_async_start(unsigned nb_messages)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_log_async_stop(void)
+{
+}
+
+uint64_t av_log_async_get_dropped(void)
+{
+    return 0;
+}
+#endif /* HAVE_THREADS */
+
 static void (*av_log_callback)(void*, int, const char*, va_list) =
     av_log_default_callback;
 
@@ -322,6 +322,50 @@ void av_log_set_callback(void (*callback)(void*, int, const char*, va_list));
 void av_log_default_callback(void *avcl, int level, const char *fmt,
                              va_list vl);
 
+/**
+ * Asynchronous logging callback
+ *
+ * It formats the message in the calling thread like av_log_default_callback()
+ * and queues it, the message is then printed to stderr by a background
+ * thread started with av_log_async_start(). The calling thread never waits
+ * for the output or for other logging threads. If the queue is full, the
+ * message is dropped and counted, the number of dropped messages is then
+ * printed with the next message.
+ *
+ * When the background thread is not running, the message is passed to
+ * av_log_default_callback().
+ *
+ * @see av_log_set_callback
+ */
+void av_log_async_callback(void *avcl, int level, const char *fmt,
+                           va_list vl);
+
+/**
+ * Start the thread printing the messages of av_log_async_callback().
+ *
+ * @param nb_messages size of the message queue, rounded up to a power of
+ *                    two, or 0 for a default of 1024
+ * @return 0 on success, a negative AVERROR code on failure, AVERROR(ENOSYS)
+ *         if the library was built without threads
+ */
+int av_log_async_start(unsigned nb_messages);
+
+/**
+ * Print the queued messages and stop the thread printing the messages of
+ * av_log_async_callback(). Messages logged afterwards are printed
+ * synchronously.
+ *
+ * No other thread may be in av_log_async_callback() while this function is
+ * called.
+ */
+void av_log_async_stop(void);
+
+/**
+ * @return the number of messages dropped by av_log_async_callback() because
+ *         the queue was full since av_log_async_start()
+ */
+uint64_t av_log_async_get_dropped(void);
+
 /**
  * Return the context name
  *
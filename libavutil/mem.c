@@ -25,9 +25,12 @@
  */
 
 #define _XOPEN_SOURCE 600
+/* for madvise() */
+#define _DEFAULT_SOURCE
 
 #include "config.h"
 
+#include <inttypes.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -36,6 +39,9 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#if HAVE_MADVISE
+#include <sys/mman.h>
+#endif
 
 #include "avutil.h"
 #include "common.h"
@@ -61,6 +67,11 @@ void  free(void *ptr);
 
 #include "mem_internal.h"
 
+#if CONFIG_MEMORY_ACCOUNTING
+#include <pthread.h>
+#include "avstring.h"
+#endif
+
 #define ALIGN (HAVE_AVX512 ? 64 : (HAVE_AVX ? 32 : 16))
 
 /* NOTE: if you want to override these functions with your own
@@ -74,6 +85,332 @@ void av_max_alloc(size_t max){
     atomic_store_explicit(&max_alloc_size, max, memory_order_relaxed);
 }
 
+#if HAVE_POSIX_MEMALIGN && HAVE_MADVISE && defined(MADV_HUGEPAGE)
+#define HUGEPAGE_SIZE (2 << 20)
+
+static atomic_size_t hugepage_threshold = ATOMIC_VAR_INIT(0);
+
+/* Blocks this large are aligned to a huge page boundary and marked with
+ * MADV_HUGEPAGE, so that the kernel backs them with transparent huge
+ * pages instead of faulting in 4 kB pages one by one. */
+static void *hugepage_malloc(size_t size)
+{
+    size_t threshold = atomic_load_explicit(&hugepage_threshold, memory_order_relaxed);
+    void *ptr;
+
+    if (!threshold || size < threshold || size < HUGEPAGE_SIZE)
+        return NULL;
+
+    if (posix_memalign(&ptr, HUGEPAGE_SIZE, size))
+        return NULL;
+    madvise(ptr, size & ~(size_t)(HUGEPAGE_SIZE - 1), MADV_HUGEPAGE);
+
+    return ptr;
+}
+#endif
+
+void av_hugepage_threshold(size_t threshold)
+{
+#ifdef HUGEPAGE_SIZE
+    atomic_store_explicit(&hugepage_threshold, threshold, memory_order_relaxed);
+#endif
+}
+
+#if CONFIG_MEMORY_ACCOUNTING
+#define MAX_COMPONENTS 256
+
+/* A block allocated while accounting, in the hash table of the blocks. */
+typedef struct MemBlock {
+    struct MemBlock *next;
+    void *ptr;
+    size_t size;
+    int component;
+} MemBlock;
+
+static atomic_int accounting_active;
+
+static pthread_once_t accounting_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  context_key;
+static int            context_key_ret;
+
+/* The tables are allocated with malloc(), av_malloc() would recurse. */
+static pthread_mutex_t accounting_lock = PTHREAD_MUTEX_INITIALIZER;
+static MemBlock      **blocks;
+static size_t          nb_buckets;
+static size_t          nb_blocks;
+static AVMemComponentStats components[MAX_COMPONENTS];
+static int             nb_components;
+static AVMemComponentStats total;
+
+static void make_context_key(void)
+{
+    context_key_ret = pthread_key_create(&context_key, NULL);
+}
+
+static size_t block_hash(const void *ptr)
+{
+    uintptr_t v = (uintptr_t)ptr >> 4;
+    return (v ^ v >> 17) * 0x9E3779B1U & (nb_buckets - 1);
+}
+
+/* Component of the allocations of the calling thread,
+ * the first one collects the allocations made without a context. */
+static int get_component(void)
+{
+    void *avcl = pthread_getspecific(context_key);
+    const AVClass *avc = avcl ? *(const AVClass **)avcl : NULL;
+    const char *name = avc ? avc->item_name(avcl) : NULL;
+    int i;
+
+    if (!name)
+        return 0;
+    for (i = 1; i < nb_components; i++)
+        if (!strcmp(components[i].name, name))
+            return i;
+    if (nb_components == MAX_COMPONENTS)
+        return 0;
+    av_strlcpy(components[i].name, name, sizeof(components[i].name));
+    return nb_components++;
+}
+
+static void grow_blocks(void)
+{
+    size_t new_nb = nb_buckets * 2;
+    MemBlock **old = blocks, **new = calloc(new_nb, sizeof(*new));
+
+    if (!new)
+        return;
+    blocks     = new;
+    nb_buckets = new_nb;
+    for (size_t i = 0; i < new_nb / 2; i++) {
+        MemBlock *b = old[i], *next;
+        for (; b; b = next) {
+            size_t h = block_hash(b->ptr);
+            next = b->next;
+            b->next   = blocks[h];
+            blocks[h] = b;
+        }
+    }
+    free(old);
+}
+
+static void account(AVMemComponentStats *c, size_t size)
+{
+    c->live += size;
+    c->peak  = FFMAX(c->peak, c->live);
+    c->nb_allocs++;
+}
+
+/* must be called with the lock held */
+static void add_block(void *ptr, size_t size, int component)
+{
+    MemBlock *b;
+    size_t h;
+
+    if (!blocks)
+        return;
+    if (nb_blocks >= nb_buckets)
+        grow_blocks();
+
+    b = malloc(sizeof(*b));
+    if (!b)
+        return;
+    h = block_hash(ptr);
+    b->ptr       = ptr;
+    b->size      = size;
+    b->component = component;
+    b->next      = blocks[h];
+    blocks[h]    = b;
+    nb_blocks++;
+    account(&components[component], size);
+    account(&total, size);
+}
+
+/* must be called with the lock held, returns the component or -1 */
+static int remove_block(void *ptr, size_t *size)
+{
+    MemBlock **pb, *b;
+    int component;
+
+    if (!blocks)
+        return -1;
+    for (pb = &blocks[block_hash(ptr)]; (b = *pb); pb = &b->next)
+        if (b->ptr == ptr)
+            break;
+    if (!b)
+        return -1;
+
+    *pb = b->next;
+    nb_blocks--;
+    component = b->component;
+    *size     = b->size;
+    components[component].live -= b->size;
+    total.live                 -= b->size;
+    free(b);
+    return component;
+}
+
+static int accounting(void)
+{
+    return atomic_load_explicit(&accounting_active, memory_order_relaxed);
+}
+
+static void account_alloc(void *ptr, size_t size)
+{
+    size_t old_size;
+
+    pthread_mutex_lock(&accounting_lock);
+    /* a block freed behind our back, e.g. with free() */
+    remove_block(ptr, &old_size);
+    add_block(ptr, size, get_component());
+    pthread_mutex_unlock(&accounting_lock);
+}
+
+static void account_free(void *ptr)
+{
+    size_t size;
+
+    pthread_mutex_lock(&accounting_lock);
+    remove_block(ptr, &size);
+    pthread_mutex_unlock(&accounting_lock);
+}
+
+int av_mem_accounting_start(void)
+{
+    int ret = 0;
+
+    pthread_once(&accounting_key_once, make_context_key);
+    if (context_key_ret)
+        return AVERROR(context_key_ret);
+
+    pthread_mutex_lock(&accounting_lock);
+    if (!blocks) {
+        nb_buckets = 1 << 12;
+        blocks     = calloc(nb_buckets, sizeof(*blocks));
+        if (!blocks)
+            ret = AVERROR(ENOMEM);
+        memset(components, 0, sizeof(components));
+        memset(&total, 0, sizeof(total));
+        av_strlcpy(components[0].name, "other", sizeof(components[0].name));
+        av_strlcpy(total.name, "total", sizeof(total.name));
+        nb_components = 1;
+        nb_blocks     = 0;
+    }
+    pthread_mutex_unlock(&accounting_lock);
+
+    if (!ret)
+        atomic_store_explicit(&accounting_active, 1, memory_order_relaxed);
+    return ret;
+}
+
+void av_mem_accounting_stop(void)
+{
+    atomic_store_explicit(&accounting_active, 0, memory_order_relaxed);
+
+    pthread_mutex_lock(&accounting_lock);
+    for (size_t i = 0; blocks && i < nb_buckets; i++) {
+        MemBlock *b = blocks[i], *next;
+        for (; b; b = next) {
+            next = b->next;
+            free(b);
+        }
+    }
+    free(blocks);
+    blocks     = NULL;
+    nb_buckets = nb_blocks = 0;
+    pthread_mutex_unlock(&accounting_lock);
+}
+
+void *av_mem_accounting_set_context(void *avcl)
+{
+    void *prev;
+
+    if (!accounting())
+        return NULL;
+    prev = pthread_getspecific(context_key);
+    pthread_setspecific(context_key, avcl);
+    return prev;
+}
+
+int av_mem_accounting_get_stats(AVMemComponentStats **stats)
+{
+    AVMemComponentStats *s;
+    int nb;
+
+    *stats = NULL;
+    pthread_mutex_lock(&accounting_lock);
+    nb = nb_components;
+    pthread_mutex_unlock(&accounting_lock);
+    if (!nb)
+        return 0;
+
+    /* components are only added, allocate room for some more */
+    s = av_malloc_array(nb + 16 + 1, sizeof(*s));
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&accounting_lock);
+    nb = FFMIN(nb_components, nb + 16);
+    memcpy(s, components, nb * sizeof(*s));
+    s[nb] = total;
+    pthread_mutex_unlock(&accounting_lock);
+
+    *stats = s;
+    return nb + 1;
+}
+#else
+#define accounting() 0
+#define account_alloc(ptr, size) do { } while (0)
+#define account_free(ptr)        do { } while (0)
+
+int av_mem_accounting_start(void)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_mem_accounting_stop(void)
+{
+}
+
+void *av_mem_accounting_set_context(void *avcl)
+{
+    return NULL;
+}
+
+int av_mem_accounting_get_stats(AVMemComponentStats **stats)
+{
+    *stats = NULL;
+    return AVERROR(ENOSYS);
+}
+#endif /* CONFIG_MEMORY_ACCOUNTING */
+
+static int cmp_peak(const void *a, const void *b)
+{
+    const AVMemComponentStats *sa = a, *sb = b;
+    return (sa->peak < sb->peak) - (sa->peak > sb->peak);
+}
+
+void av_mem_accounting_dump(void *log_ctx, int level)
+{
+    AVMemComponentStats *stats;
+    int nb = av_mem_accounting_get_stats(&stats);
+
+    if (nb <= 0)
+        return;
+
+    /* the total stays last */
+    qsort(stats, nb - 1, sizeof(*stats), cmp_peak);
+    av_log(log_ctx, level, "%-32s %12s %12s %10s\n",
+           "component", "live bytes", "peak bytes", "allocs");
+    for (int i = 0; i < nb; i++) {
+        if (!stats[i].nb_allocs)
+            continue;
+        av_log(log_ctx, level, "%-32s %12zu %12zu %10"PRIu64"\n", stats[i].name,
+               stats[i].live, stats[i].peak, stats[i].nb_allocs);
+    }
+    av_free(stats);
+}
+
 static int size_mult(size_t a, size_t b, size_t *r)
 {
     size_t t;
@@ -100,6 +437,10 @@ void *av_malloc(size_t size)
         return NULL;
 
 #if HAVE_POSIX_MEMALIGN
+#ifdef HUGEPAGE_SIZE
+    ptr = hugepage_malloc(size);
+    if (!ptr)
+#endif
     if (size) //OS X on SDK 10.6 has a broken posix_memalign implementation
     if (posix_memalign(&ptr, ALIGN, size))
         ptr = NULL;
@@ -138,6 +479,8 @@ void *av_malloc(size_t size)
 #else
     ptr = malloc(size);
 #endif
+    if (ptr && accounting())
+        account_alloc(ptr, size);
     if(!ptr && !size) {
         size = 1;
         ptr= av_malloc(1);
@@ -152,17 +495,49 @@ void *av_malloc(size_t size)
 void *av_realloc(void *ptr, size_t size)
 {
     void *ret;
+#if CONFIG_MEMORY_ACCOUNTING
+    int component = -1;
+    size_t old_size;
+#endif
     if (size > atomic_load_explicit(&max_alloc_size, memory_order_relaxed))
         return NULL;
 
+#if CONFIG_MEMORY_ACCOUNTING
+    /* The block is removed before it is freed by realloc(), another thread
+     * could get its address immediately. */
+    if (accounting()) {
+        pthread_mutex_lock(&accounting_lock);
+        if (ptr)
+            component = remove_block(ptr, &old_size);
+        if (component < 0)
+            component = get_component();
+        pthread_mutex_unlock(&accounting_lock);
+    }
+#endif
+
 #if HAVE_ALIGNED_MALLOC
     ret = _aligned_realloc(ptr, size + !size, ALIGN);
 #else
+#ifdef HUGEPAGE_SIZE
+    /* First allocations of growable buffers, e.g. packet data, can take
+     * the huge page path too. */
+    if (ptr || !(ret = hugepage_malloc(size)))
+#endif
     ret = realloc(ptr, size + !size);
 #endif
 #if CONFIG_MEMORY_POISONING
     if (ret && !ptr)
         memset(ret, FF_MEMORY_POISON, size);
+#endif
+#if CONFIG_MEMORY_ACCOUNTING
+    if (component >= 0) {
+        pthread_mutex_lock(&accounting_lock);
+        if (ret)
+            add_block(ret, size + !size, component);
+        else if (ptr)
+            add_block(ptr, old_size, component);
+        pthread_mutex_unlock(&accounting_lock);
+    }
 #endif
     return ret;
 }
@@ -244,6 +619,8 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
 
 void av_free(void *ptr)
 {
+    if (ptr && accounting())
+        account_free(ptr);
 #if HAVE_ALIGNED_MALLOC
     _aligned_free(ptr);
 #else
@@ -689,6 +689,109 @@ int av_size_mult(size_t a, size_t b, size_t *r);
  */
 void av_max_alloc(size_t max);
 
+/**
+ * Back large blocks with huge pages.
+ *
+ * Blocks of at least `threshold` bytes allocated afterwards by av_malloc(),
+ * av_realloc() with a NULL pointer and the functions built on them, including
+ * the default AVBufferPool allocator, are aligned to a huge page boundary and marked as eligible for
+ * transparent huge pages. This reduces the number of page faults and TLB
+ * misses for large frame buffers, at the cost of up to one huge page of
+ * address space per block.
+ *
+ * This is only effective on systems supporting `madvise(MADV_HUGEPAGE)`,
+ * and a no-op elsewhere. By default, it is disabled.
+ *
+ * @param threshold minimum size of the blocks to back with huge pages,
+ *                  0 to disable
+ */
+void av_hugepage_threshold(size_t threshold);
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup lavu_mem_accounting Memory accounting
+ * Accounting of the memory allocated with the @ref lavu_mem_funcs
+ * "heap management functions" to the components of the libraries.
+ *
+ * Each thread has a current context, an arbitrary struct of which the first
+ * field is a pointer to an AVClass, set with av_mem_accounting_set_context().
+ * The libraries set it to the demuxer, muxer, codec or filter context while
+ * it runs. The blocks allocated by a thread are accounted to the component
+ * named by the item_name() of its current context, until they are freed
+ * by any thread. The blocks allocated without a context are accounted to a
+ * component named "other".
+ *
+ * Accounting is process wide and opt-in. When it is not started, the
+ * allocation functions only check a flag. It may be disabled at build time,
+ * in which case these functions return AVERROR(ENOSYS).
+ *
+ * @{
+ */
+
+typedef struct AVMemComponentStats {
+    /**
+     * Name of the component.
+     */
+    char name[64];
+    /**
+     * Number of bytes allocated and not yet freed.
+     */
+    size_t live;
+    /**
+     * Maximum of live since accounting was started.
+     */
+    size_t peak;
+    /**
+     * Number of allocations and reallocations.
+     */
+    uint64_t nb_allocs;
+} AVMemComponentStats;
+
+/**
+ * Start accounting the allocated memory to components.
+ *
+ * Only the blocks allocated from then on are accounted.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int av_mem_accounting_start(void);
+
+/**
+ * Stop accounting the allocated memory and discard the statistics.
+ */
+void av_mem_accounting_stop(void);
+
+/**
+ * Set the context the memory allocated by the calling thread is accounted
+ * to.
+ *
+ * @param avcl a pointer to an arbitrary struct of which the first field is
+ *             a pointer to an AVClass, or NULL
+ * @return the previous context of the thread, to be restored afterwards,
+ *         NULL if accounting is not started
+ */
+void *av_mem_accounting_set_context(void *avcl);
+
+/**
+ * Get the statistics of the components.
+ *
+ * @param stats set to an array of the statistics, the last element sums up
+ *              all components; must be freed with av_free()
+ * @return the number of elements of stats, a negative AVERROR code on failure
+ */
+int av_mem_accounting_get_stats(AVMemComponentStats **stats);
+
+/**
+ * Log a table of the statistics of the components, sorted by peak usage.
+ *
+ * @param log_ctx context to log with, may be NULL
+ * @param level   log level
+ */
+void av_mem_accounting_dump(void *log_ctx, int level);
+
 /**
  * @}
  * @}
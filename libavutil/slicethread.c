@@ -38,6 +38,7 @@ struct AVSliceThread {
     int             nb_threads;
     int             nb_active_threads;
     int             nb_jobs;
+    int             nb_wake;    ///< number of workers to wake up for the current jobs
 
     atomic_uint     first_job;
     atomic_uint     current_job;
@@ -65,10 +66,34 @@ static int run_jobs(AVSliceThread *ctx)
     return current_job == nb_jobs + nb_active_threads - 1;
 }
 
+static void wake_worker(AVSliceThread *ctx, int i)
+{
+    WorkerContext *w = &ctx->workers[i];
+
+    pthread_mutex_lock(&w->mutex);
+    w->done = 0;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/*
+ * Workers are woken up as a binary tree: the caller wakes workers 0 and 1,
+ * and worker i wakes workers 2 * i + 2 and 2 * i + 3, so starting a batch
+ * takes O(log(nb_threads)) sequential wake-ups instead of O(nb_threads).
+ * A worker only ever locks the mutexes of workers with a higher index,
+ * which keeps this free of lock cycles.
+ */
+static void wake_children(AVSliceThread *ctx, int parent)
+{
+    for (int i = 2 * parent + 2; i <= 2 * parent + 3 && i < ctx->nb_wake; i++)
+        wake_worker(ctx, i);
+}
+
 static void *attribute_align_arg thread_worker(void *v)
 {
     WorkerContext *w = v;
     AVSliceThread *ctx = w->ctx;
+    const int idx = w - ctx->workers;
 
     pthread_mutex_lock(&w->mutex);
     pthread_cond_signal(&w->cond);
@@ -83,6 +108,8 @@ static void *attribute_align_arg thread_worker(void *v)
             return NULL;
         }
 
+        wake_children(ctx, idx);
+
         if (run_jobs(ctx)) {
             pthread_mutex_lock(&ctx->done_mutex);
             ctx->done = 1;
@@ -174,14 +201,10 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
+    ctx->nb_wake           = nb_workers;
 
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
-    }
+    for (i = 0; i < FFMIN(nb_workers, 2); i++)
+        wake_worker(ctx, i);
 
     if (ctx->main_func && execute_main)
         ctx->main_func(ctx->priv);
@@ -0,0 +1,121 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program gets and releases buffers of a single AVBufferPool from
+ * several threads, checking that no buffer is handed out twice at the same
+ * time. When run with the -b option, it prints the throughput for 1 to 64
+ * threads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUF_SIZE   4096
+#define NB_HELD    4
+#define MAX_THREADS 64
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    AVBufferRef *held[NB_HELD] = { NULL };
+
+    for (int i = 0; i < arg->iterations; i++) {
+        AVBufferRef **ref = &held[i % NB_HELD];
+
+        if (*ref) {
+            if ((*ref)->data[0] != arg->id || (*ref)->data[BUF_SIZE - 1] != (uint8_t)i)
+                arg->errors++;
+            av_buffer_unref(ref);
+        }
+        *ref = av_buffer_pool_get(arg->pool);
+        if (!*ref) {
+            arg->errors++;
+            break;
+        }
+        (*ref)->data[0]            = arg->id;
+        (*ref)->data[BUF_SIZE - 1] = i + NB_HELD;
+    }
+
+    for (int i = 0; i < NB_HELD; i++)
+        av_buffer_unref(&held[i]);
+
+    return NULL;
+}
+
+static int run(int nb_threads, int iterations, int64_t *time)
+{
+    AVBufferPool *pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    pthread_t threads[MAX_THREADS];
+    ThreadArg args[MAX_THREADS];
+    int errors = 0, ret;
+
+    if (!pool)
+        return -1;
+
+    *time = av_gettime_relative();
+    for (int i = 0; i < nb_threads; i++) {
+        args[i] = (ThreadArg){ .pool = pool, .id = i, .iterations = iterations };
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            nb_threads = i;
+            errors++;
+            break;
+        }
+    }
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+    *time = av_gettime_relative() - *time;
+
+    av_buffer_pool_uninit(&pool);
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t time;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        const int iterations = 1000000;
+
+        for (int nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+            if (run(nb_threads, iterations, &time))
+                return 1;
+            printf("%2d threads: %6.2f Mops/s\n", nb_threads,
+                   (double)nb_threads * iterations / FFMAX(time, 1));
+        }
+        return 0;
+    }
+
+    return run(8, 100000, &time) ? 1 : 0;
+}
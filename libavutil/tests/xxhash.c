@@ -0,0 +1,72 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/xxhash.h"
+
+int main(void)
+{
+    /* one length for each code path of the reference implementation */
+    static const int lengths[] = {
+        0, 1, 3, 4, 8, 9, 16, 17, 32, 33, 64, 65, 96, 97, 128, 129, 160, 240,
+        241, 255, 256, 257, 1023, 1024, 1025, 2047, 2048, 100000,
+    };
+    struct AVXXH3 *ctx;
+    uint8_t *data, digest[16], ref[16];
+    int ret = 0;
+
+    ctx  = av_xxh3_alloc();
+    data = av_malloc(100000);
+    if (!ctx || !data)
+        return 1;
+    for (int i = 0; i < 100000; i++)
+        data[i] = i * 2654435761U >> 24;
+
+    for (int bits = 64; bits <= 128; bits += 64) {
+        printf("Testing XXH3-%d\n", bits);
+        for (int i = 0; i < FF_ARRAY_ELEMS(lengths); i++) {
+            int len = lengths[i];
+
+            av_xxh3_init(ctx, bits);
+            av_xxh3_update(ctx, data, len);
+            av_xxh3_final(ctx, ref);
+            printf("%6d ", len);
+            for (int j = 0; j < bits >> 3; j++)
+                printf("%02x", ref[j]);
+            putchar('\n');
+
+            /* the same data in pieces of varying size */
+            av_xxh3_init(ctx, bits);
+            for (int pos = 0, n = 1; pos < len; pos += n, n = n * 3 % 509)
+                av_xxh3_update(ctx, data + pos, FFMIN(n, len - pos));
+            av_xxh3_final(ctx, digest);
+            if (memcmp(digest, ref, bits >> 3)) {
+                printf("mismatch with split input\n");
+                ret = 1;
+            }
+        }
+    }
+    av_free(data);
+    av_free(ctx);
+
+    return ret;
+}
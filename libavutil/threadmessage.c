@@ -18,6 +18,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
@@ -28,10 +31,23 @@ struct AVThreadMessageQueue {
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /**
+     * Ring buffer used instead of the fifo by AV_THREAD_MESSAGE_QUEUE_SPSC
+     * queues. Each position is only written by one side, and the lock and
+     * condition variables are only used to sleep when the ring is full or
+     * empty, as announced by the waiting_* flags.
+     */
+    uint8_t *ring;
+    unsigned nb_slots;      ///< nelem + 1, a full ring has one empty slot
+    atomic_uint write_pos;
+    atomic_uint read_pos;
+    atomic_int waiting_send;
+    atomic_int waiting_recv;
 #else
     int dummy;
 #endif
@@ -40,12 +56,21 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
+    const int spsc = flags & AV_THREAD_MESSAGE_QUEUE_SPSC;
     int ret = 0;
 
-    if (nelem > INT_MAX / elsize)
+    if (nelem + spsc < nelem || nelem + spsc > INT_MAX / elsize)
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
@@ -64,13 +89,25 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (spsc) {
+        rmq->nb_slots = nelem + 1;
+        rmq->ring     = av_malloc_array(rmq->nb_slots, elsize);
+    } else {
+        rmq->fifo     = av_fifo_alloc(elsize * nelem);
+    }
+    if (!rmq->fifo && !rmq->ring) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
         return AVERROR(ENOMEM);
     }
+    atomic_init(&rmq->err_send, 0);
+    atomic_init(&rmq->err_recv, 0);
+    atomic_init(&rmq->write_pos, 0);
+    atomic_init(&rmq->read_pos, 0);
+    atomic_init(&rmq->waiting_send, 0);
+    atomic_init(&rmq->waiting_recv, 0);
     rmq->elsize = elsize;
     *mq = rmq;
     return 0;
@@ -94,6 +131,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -106,6 +144,13 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+
+    if (mq->ring) {
+        unsigned w = atomic_load(&mq->write_pos);
+        unsigned r = atomic_load(&mq->read_pos);
+        return (w + mq->nb_slots - r) % mq->nb_slots;
+    }
+
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -151,6 +196,77 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     return 0;
 }
 
+static void wake_up(AVThreadMessageQueue *mq, atomic_int *waiting,
+                    pthread_cond_t *cond)
+{
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+/*
+ * A side which has to wait first raises its waiting flag and then checks
+ * the other position again, while the other side first moves its position
+ * and then checks the flag. With sequentially consistent atomics, either
+ * the waiter sees the new position or the other side sees the flag and
+ * signals, after the waiter released the lock in pthread_cond_wait().
+ */
+static int ring_send(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    unsigned pos  = atomic_load_explicit(&mq->write_pos, memory_order_relaxed);
+    unsigned next = pos + 1 < mq->nb_slots ? pos + 1 : 0;
+    int err;
+
+    while (!(err = atomic_load(&mq->err_send)) &&
+           next == atomic_load_explicit(&mq->read_pos, memory_order_acquire)) {
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        pthread_mutex_lock(&mq->lock);
+        atomic_store(&mq->waiting_send, 1);
+        if (!atomic_load(&mq->err_send) && next == atomic_load(&mq->read_pos))
+            pthread_cond_wait(&mq->cond_send, &mq->lock);
+        atomic_store(&mq->waiting_send, 0);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    if (err)
+        return err;
+
+    memcpy(mq->ring + (size_t)pos * mq->elsize, msg, mq->elsize);
+    atomic_store(&mq->write_pos, next);
+    wake_up(mq, &mq->waiting_recv, &mq->cond_recv);
+    return 0;
+}
+
+static int ring_recv(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    unsigned pos = atomic_load_explicit(&mq->read_pos, memory_order_relaxed);
+    int err;
+
+    while (pos == atomic_load_explicit(&mq->write_pos, memory_order_acquire)) {
+        if ((err = atomic_load(&mq->err_recv))) {
+            /* a message may have been sent before the error was set */
+            if (pos != atomic_load(&mq->write_pos))
+                break;
+            return err;
+        }
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        pthread_mutex_lock(&mq->lock);
+        atomic_store(&mq->waiting_recv, 1);
+        if (!atomic_load(&mq->err_recv) && pos == atomic_load(&mq->write_pos))
+            pthread_cond_wait(&mq->cond_recv, &mq->lock);
+        atomic_store(&mq->waiting_recv, 0);
+        pthread_mutex_unlock(&mq->lock);
+    }
+
+    memcpy(msg, mq->ring + (size_t)pos * mq->elsize, mq->elsize);
+    atomic_store(&mq->read_pos, pos + 1 < mq->nb_slots ? pos + 1 : 0);
+    wake_up(mq, &mq->waiting_send, &mq->cond_send);
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -160,6 +276,9 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_send(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +295,9 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_recv(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -190,7 +312,7 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_send = err;
+    atomic_store(&mq->err_send, err);
     pthread_cond_broadcast(&mq->cond_send);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -201,7 +323,7 @@ void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_recv = err;
+    atomic_store(&mq->err_recv, err);
     pthread_cond_broadcast(&mq->cond_recv);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -222,6 +344,18 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     void *free_func = mq->free_func;
 
     pthread_mutex_lock(&mq->lock);
+    if (mq->ring) {
+        unsigned pos = atomic_load(&mq->read_pos);
+        unsigned end = atomic_load(&mq->write_pos);
+
+        for (; pos != end; pos = pos + 1 < mq->nb_slots ? pos + 1 : 0)
+            if (free_func)
+                mq->free_func(mq->ring + (size_t)pos * mq->elsize);
+        atomic_store(&mq->read_pos, end);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+        return;
+    }
     used = av_fifo_size(mq->fifo);
     if (free_func)
         for (off = 0; off < used; off += mq->elsize)
@@ -0,0 +1,241 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "config.h"
+#include "common.h"
+#include "error.h"
+#include "trace.h"
+#include "trace_internal.h"
+
+#if CONFIG_TRACE_EVENTS
+
+#include <pthread.h>
+
+#include "avutil.h"
+#include "mem.h"
+#include "time.h"
+
+#define DEFAULT_MAX_EVENTS (1 << 16)
+
+typedef struct TraceEvent {
+    int64_t ts;
+    const char *cat;
+    const char *name;
+    char phase;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    int tid;
+    TraceEvent *events;
+    unsigned mask;
+    unsigned nb_events;         /* number of events ever recorded */
+} TraceBuffer;
+
+/* thread local, points to the buffer of the thread in the current generation */
+typedef struct TraceSlot {
+    unsigned generation;
+    TraceBuffer *buf;
+} TraceSlot;
+
+atomic_int avpriv_trace_active;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  slot_key;
+static int            key_ret;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer    *buffers;
+static int             nb_buffers;
+static unsigned        max_events;
+static unsigned        generation = 1;
+static int64_t         start_time;
+
+static void make_key(void)
+{
+    key_ret = pthread_key_create(&slot_key, av_free);
+}
+
+static TraceBuffer *get_buffer(void)
+{
+    TraceSlot *slot = pthread_getspecific(slot_key);
+    TraceBuffer *buf;
+
+    if (slot && slot->generation == generation)
+        return slot->buf;
+
+    if (!slot) {
+        slot = av_mallocz(sizeof(*slot));
+        if (!slot || pthread_setspecific(slot_key, slot)) {
+            av_free(slot);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    buf = av_mallocz(sizeof(*buf));
+    if (buf)
+        buf->events = av_malloc_array(max_events, sizeof(*buf->events));
+    if (buf && buf->events) {
+        buf->mask = max_events - 1;
+        buf->tid  = ++nb_buffers;
+        buf->next = buffers;
+        buffers   = buf;
+    } else if (buf) {
+        av_freep(&buf);
+    }
+    slot->generation = generation;
+    slot->buf        = buf;
+    pthread_mutex_unlock(&lock);
+
+    return buf;
+}
+
+void avpriv_trace_event(const char *cat, const char *name, char phase)
+{
+    TraceBuffer *buf = get_buffer();
+    TraceEvent *ev;
+
+    if (!buf)
+        return;
+
+    ev = &buf->events[buf->nb_events++ & buf->mask];
+    ev->ts    = av_gettime_relative();
+    ev->cat   = cat;
+    ev->name  = name;
+    ev->phase = phase;
+}
+
+int av_trace_start(unsigned nb_events)
+{
+    pthread_once(&key_once, make_key);
+    if (key_ret)
+        return AVERROR(key_ret);
+
+    if (!nb_events)
+        nb_events = DEFAULT_MAX_EVENTS;
+    if (nb_events > INT_MAX / sizeof(TraceEvent))
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&lock);
+    if (!buffers) {
+        max_events = 1U << av_ceil_log2(nb_events);
+        start_time = av_gettime_relative();
+    }
+    pthread_mutex_unlock(&lock);
+
+    atomic_store_explicit(&avpriv_trace_active, 1, memory_order_relaxed);
+    return 0;
+}
+
+void av_trace_stop(void)
+{
+    atomic_store_explicit(&avpriv_trace_active, 0, memory_order_relaxed);
+}
+
+static void write_string(FILE *f, const char *s)
+{
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        fputc(*s, f);
+    }
+}
+
+int av_trace_write_json(const char *filename)
+{
+    const char *sep = "";
+    FILE *f;
+    int ret = 0;
+
+    f = av_fopen_utf8(filename, "w");
+    if (!f)
+        return AVERROR(errno);
+
+    pthread_mutex_lock(&lock);
+    fprintf(f, "{\"traceEvents\":[");
+    for (TraceBuffer *buf = buffers; buf; buf = buf->next) {
+        unsigned first = buf->nb_events > buf->mask ? buf->nb_events - buf->mask - 1 : 0;
+        int depth = 0;
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"thread %d\"}}", sep, buf->tid, buf->tid);
+        sep = ",";
+        for (unsigned i = first; i != buf->nb_events; i++) {
+            const TraceEvent *ev = &buf->events[i & buf->mask];
+
+            /* the beginning of the span may have been overwritten */
+            if (ev->phase == 'E' && !depth)
+                continue;
+            depth += ev->phase == 'B' ? 1 : -1;
+
+            fprintf(f, ",\n{\"name\":\"");
+            write_string(f, ev->name);
+            fprintf(f, "\",\"cat\":\"");
+            write_string(f, ev->cat);
+            fprintf(f, "\",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":1,\"tid\":%d}",
+                    ev->phase, ev->ts - start_time, buf->tid);
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    pthread_mutex_unlock(&lock);
+
+    if (ferror(f))
+        ret = AVERROR(EIO);
+    if (fclose(f) && !ret)
+        ret = AVERROR(errno);
+    return ret;
+}
+
+void av_trace_free(void)
+{
+    pthread_mutex_lock(&lock);
+    while (buffers) {
+        TraceBuffer *next = buffers->next;
+        av_freep(&buffers->events);
+        av_freep(&buffers);
+        buffers = next;
+    }
+    nb_buffers = 0;
+    generation++;
+    pthread_mutex_unlock(&lock);
+}
+
+#else
+
+int av_trace_start(unsigned max_events)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_trace_stop(void)
+{
+}
+
+int av_trace_write_json(const char *filename)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_trace_free(void)
+{
+}
+
+#endif /* CONFIG_TRACE_EVENTS */
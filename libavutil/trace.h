@@ -0,0 +1,85 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * @ingroup lavu_trace
+ * Trace event recorder
+ */
+
+#ifndef AVUTIL_TRACE_H
+#define AVUTIL_TRACE_H
+
+/**
+ * @defgroup lavu_trace Trace events
+ * @ingroup lavu_misc
+ *
+ * Recording of the time spent in the main processing stages of the
+ * libraries: demuxing, decoding, the frame and slice threads, filtering and
+ * muxing.
+ *
+ * Each thread records begin and end events into a ring buffer of its own,
+ * so that only the most recent events of each thread are kept. The events
+ * can be written in the Chrome trace event JSON format, which can be opened
+ * in Perfetto or chrome://tracing.
+ *
+ * Recording is process wide. When it is not started, the instrumented code
+ * only checks a flag. The recorder may be disabled at build time, in which
+ * case these functions return AVERROR(ENOSYS).
+ *
+ * @{
+ */
+
+/**
+ * Start recording trace events.
+ *
+ * Events recorded by a previous recording that has not been freed with
+ * av_trace_free() are kept.
+ *
+ * @param max_events maximum number of events kept for each thread, rounded
+ *                   up to a power of two, or 0 for a default of 65536
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int av_trace_start(unsigned max_events);
+
+/**
+ * Stop recording trace events.
+ */
+void av_trace_stop(void);
+
+/**
+ * Write the recorded events to a file as Chrome trace event JSON.
+ *
+ * This must be called after recording was stopped, once the threads which
+ * recorded events are done with the instrumented functions.
+ *
+ * @param filename name of the output file, in UTF-8
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int av_trace_write_json(const char *filename);
+
+/**
+ * Free the recorded events. Recording must be stopped.
+ */
+void av_trace_free(void);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_TRACE_H */
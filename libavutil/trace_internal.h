@@ -0,0 +1,59 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_TRACE_INTERNAL_H
+#define AVUTIL_TRACE_INTERNAL_H
+
+#include "config.h"
+
+#if CONFIG_TRACE_EVENTS
+
+#include <stdatomic.h>
+
+#include "internal.h"
+
+extern av_export_avutil atomic_int avpriv_trace_active;
+
+/**
+ * Record an event of the calling thread. cat and name must be static
+ * strings, they are only dereferenced when the events are written.
+ *
+ * @param phase 'B' for the beginning of a span, 'E' for its end
+ */
+void avpriv_trace_event(const char *cat, const char *name, char phase);
+
+#define FF_TRACE_EVENT(cat, name, phase)                                    \
+    do {                                                                    \
+        if (atomic_load_explicit(&avpriv_trace_active, memory_order_relaxed)) \
+            avpriv_trace_event(cat, name, phase);                           \
+    } while (0)
+
+#else
+
+#define FF_TRACE_EVENT(cat, name, phase) do { } while (0)
+
+#endif /* CONFIG_TRACE_EVENTS */
+
+/**
+ * Mark the beginning and the end of a span of the calling thread. The spans
+ * of a thread must nest.
+ */
+#define FF_TRACE_BEGIN(cat, name) FF_TRACE_EVENT(cat, name, 'B')
+#define FF_TRACE_END(cat, name)   FF_TRACE_EVENT(cat, name, 'E')
+
+#endif /* AVUTIL_TRACE_INTERNAL_H */
@@ -0,0 +1,389 @@
+/*
+ * XXH3 hash function
+ * based on the xxHash specification and reference implementation
+ * by Yann Collet
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "attributes.h"
+#include "common.h"
+#include "error.h"
+#include "intreadwrite.h"
+#include "mem.h"
+#include "xxhash.h"
+
+#define STRIPE_LEN        64
+#define SECRET_SIZE       192
+#define SECRET_LIMIT      (SECRET_SIZE - STRIPE_LEN)
+#define STRIPES_PER_BLOCK (SECRET_LIMIT / 8)
+#define BUFFER_SIZE       256
+#define BUFFER_STRIPES    (BUFFER_SIZE / STRIPE_LEN)
+#define MIDSIZE_MAX       240
+
+#define PRIME32_1 UINT64_C(0x9E3779B1)
+#define PRIME32_2 UINT64_C(0x85EBCA77)
+#define PRIME32_3 UINT64_C(0xC2B2AE3D)
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+#define PRIME_MX1 UINT64_C(0x165667919E3779F9)
+#define PRIME_MX2 UINT64_C(0x9FB21C651E98DF25)
+
+typedef struct AVXXH3 {
+    uint64_t acc[8];
+    uint8_t  buffer[BUFFER_SIZE]; ///< pending input, always holds the last stripe once a stripe was consumed
+    unsigned buffered;            ///< number of bytes in buffer
+    unsigned nb_stripes;          ///< number of stripes accumulated in the current block
+    uint64_t total_len;
+    int bits;
+} AVXXH3;
+
+typedef struct U128 {
+    uint64_t lo, hi;
+} U128;
+
+/* the default secret, pseudorandom bytes taken from FARSH */
+static const uint8_t secret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static U128 mul128(uint64_t a, uint64_t b)
+{
+    uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hi_lo = (a >> 32)        * (b & 0xFFFFFFFF);
+    uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hi_hi = (a >> 32)        * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    U128 r;
+
+    r.hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    r.lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return r;
+}
+
+static uint64_t mul128_fold64(uint64_t a, uint64_t b)
+{
+    U128 r = mul128(a, b);
+    return r.lo ^ r.hi;
+}
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static uint64_t mix16(const uint8_t *in, const uint8_t *key, uint64_t seed)
+{
+    return mul128_fold64(AV_RL64(in)     ^ (AV_RL64(key)     + seed),
+                         AV_RL64(in + 8) ^ (AV_RL64(key + 8) - seed));
+}
+
+static U128 mix32(U128 acc, const uint8_t *in1, const uint8_t *in2,
+                  const uint8_t *key, uint64_t seed)
+{
+    acc.lo += mix16(in1, key, seed);
+    acc.lo ^= AV_RL64(in2) + AV_RL64(in2 + 8);
+    acc.hi += mix16(in2, key + 16, seed);
+    acc.hi ^= AV_RL64(in1) + AV_RL64(in1 + 8);
+    return acc;
+}
+
+static uint64_t hash64_short(const uint8_t *in, size_t len)
+{
+    uint64_t acc = len * PRIME64_1;
+    int i;
+
+    if (len > 128) {
+        uint64_t acc_end;
+
+        for (i = 0; i < 8; i++)
+            acc += mix16(in + 16 * i, secret + 16 * i, 0);
+        acc_end = mix16(in + len - 16, secret + 136 - 17, 0);
+        acc = avalanche(acc);
+        for (i = 8; i < len / 16; i++)
+            acc_end += mix16(in + 16 * i, secret + 16 * (i - 8) + 3, 0);
+        return avalanche(acc + acc_end);
+    }
+    if (len > 16) {
+        for (i = (len - 1) / 32; i >= 0; i--) {
+            acc += mix16(in + 16 * i,             secret + 32 * i,      0);
+            acc += mix16(in + len - 16 * (i + 1), secret + 32 * i + 16, 0);
+        }
+        return avalanche(acc);
+    }
+    if (len > 8) {
+        uint64_t lo = AV_RL64(in)           ^ (AV_RL64(secret + 24) ^ AV_RL64(secret + 32));
+        uint64_t hi = AV_RL64(in + len - 8) ^ (AV_RL64(secret + 40) ^ AV_RL64(secret + 48));
+        return avalanche(len + av_bswap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t in64 = AV_RL32(in + len - 4) + ((uint64_t)AV_RL32(in) << 32);
+        return rrmxmx(in64 ^ (AV_RL64(secret + 8) ^ AV_RL64(secret + 16)), len);
+    }
+    if (len) {
+        uint32_t combined = (in[0] << 16) | ((uint32_t)in[len >> 1] << 24) | in[len - 1] | (len << 8);
+        return xxh64_avalanche(combined ^ (uint64_t)(AV_RL32(secret) ^ AV_RL32(secret + 4)));
+    }
+    return xxh64_avalanche(AV_RL64(secret + 56) ^ AV_RL64(secret + 64));
+}
+
+static U128 hash128_short(const uint8_t *in, size_t len)
+{
+    U128 acc = { len * PRIME64_1, 0 }, h;
+    int i;
+
+    if (len > 16) {
+        if (len > 128) {
+            for (i = 32; i < 160; i += 32)
+                acc = mix32(acc, in + i - 32, in + i - 16, secret + i - 32, 0);
+            acc.lo = avalanche(acc.lo);
+            acc.hi = avalanche(acc.hi);
+            for (i = 160; i <= len; i += 32)
+                acc = mix32(acc, in + i - 32, in + i - 16, secret + 3 + i - 160, 0);
+            acc = mix32(acc, in + len - 16, in + len - 32, secret + 136 - 17 - 16, 0);
+        } else {
+            for (i = (len - 1) / 32; i >= 0; i--)
+                acc = mix32(acc, in + 16 * i, in + len - 16 * (i + 1), secret + 32 * i, 0);
+        }
+        h.lo = avalanche(acc.lo + acc.hi);
+        h.hi = -avalanche(acc.lo * PRIME64_1 + acc.hi * PRIME64_4 + len * PRIME64_2);
+        return h;
+    }
+    if (len > 8) {
+        uint64_t lo = AV_RL64(in);
+        uint64_t hi = AV_RL64(in + len - 8);
+        U128 m = mul128(lo ^ hi ^ (AV_RL64(secret + 32) ^ AV_RL64(secret + 40)), PRIME64_1);
+
+        m.lo += (uint64_t)(len - 1) << 54;
+        hi   ^= AV_RL64(secret + 48) ^ AV_RL64(secret + 56);
+        m.hi += hi + (hi & 0xFFFFFFFF) * (PRIME32_2 - 1);
+        m.lo ^= av_bswap64(m.hi);
+        h     = mul128(m.lo, PRIME64_2);
+        h.hi += m.hi * PRIME64_2;
+        h.lo  = avalanche(h.lo);
+        h.hi  = avalanche(h.hi);
+        return h;
+    }
+    if (len >= 4) {
+        uint64_t in64 = AV_RL32(in) + ((uint64_t)AV_RL32(in + len - 4) << 32);
+
+        h = mul128(in64 ^ (AV_RL64(secret + 16) ^ AV_RL64(secret + 24)), PRIME64_1 + (len << 2));
+        h.hi += h.lo << 1;
+        h.lo ^= h.hi >> 3;
+        h.lo ^= h.lo >> 35;
+        h.lo *= PRIME_MX2;
+        h.lo ^= h.lo >> 28;
+        h.hi  = avalanche(h.hi);
+        return h;
+    }
+    if (len) {
+        uint32_t lo = (in[0] << 16) | ((uint32_t)in[len >> 1] << 24) | in[len - 1] | (len << 8);
+        uint32_t hi = av_bswap32(lo);
+
+        hi = (hi << 13) | (hi >> 19);
+        h.lo = xxh64_avalanche(lo ^ (uint64_t)(AV_RL32(secret)     ^ AV_RL32(secret + 4)));
+        h.hi = xxh64_avalanche(hi ^ (uint64_t)(AV_RL32(secret + 8) ^ AV_RL32(secret + 12)));
+        return h;
+    }
+    h.lo = xxh64_avalanche(AV_RL64(secret + 64) ^ AV_RL64(secret + 72));
+    h.hi = xxh64_avalanche(AV_RL64(secret + 80) ^ AV_RL64(secret + 88));
+    return h;
+}
+
+static void accumulate(uint64_t acc[8], const uint8_t *in,
+                         const uint8_t *key, size_t nb_stripes)
+{
+    for (; nb_stripes; nb_stripes--, in += STRIPE_LEN, key += 8) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t data = AV_RL64(in + 8 * i);
+            uint64_t k    = data ^ AV_RL64(key + 8 * i);
+
+            acc[i ^ 1] += data;
+            acc[i]     += (k & 0xFFFFFFFF) * (k >> 32);
+        }
+    }
+}
+
+static void scramble(uint64_t acc[8], const uint8_t *key)
+{
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= AV_RL64(key + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+static uint64_t merge_accs(const uint64_t acc[8], const uint8_t *key, uint64_t start)
+{
+    for (int i = 0; i < 4; i++)
+        start += mul128_fold64(acc[2 * i]     ^ AV_RL64(key + 16 * i),
+                               acc[2 * i + 1] ^ AV_RL64(key + 16 * i + 8));
+    return avalanche(start);
+}
+
+/* accumulate whole stripes, scrambling at the end of every block */
+static const uint8_t *consume_stripes(uint64_t acc[8], unsigned *nb_stripes_so_far,
+                                      const uint8_t *in, size_t nb_stripes)
+{
+    while (nb_stripes) {
+        size_t n = FFMIN(nb_stripes, STRIPES_PER_BLOCK - *nb_stripes_so_far);
+
+        accumulate(acc, in, secret + 8 * *nb_stripes_so_far, n);
+        in                 += n * STRIPE_LEN;
+        nb_stripes         -= n;
+        *nb_stripes_so_far += n;
+        if (*nb_stripes_so_far == STRIPES_PER_BLOCK) {
+            scramble(acc, secret + SECRET_LIMIT);
+            *nb_stripes_so_far = 0;
+        }
+    }
+    return in;
+}
+
+AVXXH3 *av_xxh3_alloc(void)
+{
+    return av_mallocz(sizeof(AVXXH3));
+}
+
+av_cold int av_xxh3_init(AVXXH3 *ctx, int bits)
+{
+    static const uint64_t init_acc[8] = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1,
+    };
+
+    if (bits != 64 && bits != 128)
+        return AVERROR(EINVAL);
+    memcpy(ctx->acc, init_acc, sizeof(ctx->acc));
+    ctx->buffered   = 0;
+    ctx->nb_stripes = 0;
+    ctx->total_len  = 0;
+    ctx->bits       = bits;
+    return 0;
+}
+
+void av_xxh3_update(AVXXH3 *ctx, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+
+    ctx->total_len += len;
+    if (len <= BUFFER_SIZE - ctx->buffered) {
+        memcpy(ctx->buffer + ctx->buffered, data, len);
+        ctx->buffered += len;
+        return;
+    }
+
+    if (ctx->buffered) {
+        size_t n = BUFFER_SIZE - ctx->buffered;
+        memcpy(ctx->buffer + ctx->buffered, data, n);
+        data += n;
+        consume_stripes(ctx->acc, &ctx->nb_stripes, ctx->buffer, BUFFER_STRIPES);
+        ctx->buffered = 0;
+    }
+
+    /* The last stripe of the input is always kept back for the final
+     * accumulation, so consume only up to the last byte exclusive. */
+    if (end - data > BUFFER_SIZE) {
+        data = consume_stripes(ctx->acc, &ctx->nb_stripes, data,
+                               (end - data - 1) / STRIPE_LEN);
+        memcpy(ctx->buffer + BUFFER_SIZE - STRIPE_LEN, data - STRIPE_LEN, STRIPE_LEN);
+    }
+    memcpy(ctx->buffer, data, end - data);
+    ctx->buffered = end - data;
+}
+
+void av_xxh3_final(AVXXH3 *ctx, uint8_t *digest)
+{
+    uint64_t acc[8];
+    uint8_t last[STRIPE_LEN];
+    const uint8_t *last_stripe;
+    unsigned nb_stripes = ctx->nb_stripes;
+
+    if (ctx->total_len <= MIDSIZE_MAX) {
+        if (ctx->bits == 64) {
+            AV_WB64(digest, hash64_short(ctx->buffer, ctx->total_len));
+        } else {
+            U128 h = hash128_short(ctx->buffer, ctx->total_len);
+            AV_WB64(digest,     h.hi);
+            AV_WB64(digest + 8, h.lo);
+        }
+        return;
+    }
+
+    memcpy(acc, ctx->acc, sizeof(acc));
+    if (ctx->buffered >= STRIPE_LEN) {
+        consume_stripes(acc, &nb_stripes, ctx->buffer, (ctx->buffered - 1) / STRIPE_LEN);
+        last_stripe = ctx->buffer + ctx->buffered - STRIPE_LEN;
+    } else {
+        size_t n = STRIPE_LEN - ctx->buffered;
+        memcpy(last,     ctx->buffer + BUFFER_SIZE - n, n);
+        memcpy(last + n, ctx->buffer, ctx->buffered);
+        last_stripe = last;
+    }
+    accumulate(acc, last_stripe, secret + SECRET_LIMIT - 7, 1);
+
+    AV_WB64(digest, merge_accs(acc, secret + 11, ctx->total_len * PRIME64_1));
+    if (ctx->bits == 128) {
+        AV_WB64(digest + 8, AV_RB64(digest));
+        AV_WB64(digest, merge_accs(acc, secret + SECRET_SIZE - 64 - 11,
+                                   ~(ctx->total_len * PRIME64_2)));
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * @ingroup lavu_xxh3
+ * Public header for the XXH3 hash function implementation.
+ */
+
+#ifndef AVUTIL_XXHASH_H
+#define AVUTIL_XXHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup lavu_xxh3 XXH3
+ * @ingroup lavu_hash
+ * XXH3 hash function implementation.
+ *
+ * XXH3 is a fast non-cryptographic hash function from the xxHash family.
+ * It is meant for checksums and bit-exactness checks, not for anything
+ * where the input may be chosen by an adversary.
+ *
+ * This module supports the following variants, both with the default secret
+ * and without seed, so the digests match those of the xxhsum tool:
+ *
+ * - XXH3_64bits: 64 bits
+ * - XXH3_128bits: 128 bits
+ *
+ * The digest is stored in the canonical (big-endian) representation.
+ *
+ * @{
+ */
+
+struct AVXXH3;
+
+/**
+ * Allocate an AVXXH3 context.
+ *
+ * @return Uninitialized hash context or `NULL` in case of error
+ */
+struct AVXXH3 *av_xxh3_alloc(void);
+
+/**
+ * Initialize or reinitialize an AVXXH3 context.
+ *
+ * @param ctx  hash context
+ * @param bits number of bits in digest (64 or 128 bits)
+ * @return     zero if initialization succeeded, a negative error code otherwise
+ */
+int av_xxh3_init(struct AVXXH3 *ctx, int bits);
+
+/**
+ * Update hash value.
+ *
+ * @param ctx  hash context
+ * @param data input data to update hash with
+ * @param len  input data length
+ */
+void av_xxh3_update(struct AVXXH3 *ctx, const uint8_t *data, size_t len);
+
+/**
+ * Finish hashing and output digest value.
+ *
+ * @param ctx    hash context
+ * @param digest buffer where output digest value is stored
+ */
+void av_xxh3_final(struct AVXXH3 *ctx, uint8_t *digest);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_XXHASH_H */
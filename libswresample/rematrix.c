@@ -504,6 +504,32 @@ av_cold void swri_rematrix_free(SwrContext *s){
     av_freep(&s->native_simd_one);
 }
 
+/* Mix the input channels of out_i into an accumulator one input channel at
+ * a time, in blocks small enough to stay in the L1 cache. */
+#define MIX_ANY_BLOCK 256
+#define MIX_ANY_ROUND_S16(x) (((x) + 16384)>>15)
+#define MIX_ANY(type, acc_type, coeffs, round) do {                         \
+    acc_type acc[MIX_ANY_BLOCK];                                            \
+    type *dst = (type *)out->ch[out_i];                                     \
+    for (i = 0; i < len; i += MIX_ANY_BLOCK) {                              \
+        const int n = FFMIN(len - i, MIX_ANY_BLOCK);                        \
+        int k;                                                              \
+        for (k = 0; k < n; k++)                                             \
+            acc[k] = 0;                                                     \
+        for (j = 0; j < s->matrix_ch[out_i][0]; j++) {                      \
+            const type *src;                                                \
+            acc_type coeff;                                                 \
+            in_i  = s->matrix_ch[out_i][1+j];                               \
+            src   = (const type *)in->ch[in_i] + i;                         \
+            coeff = coeffs[out_i][in_i];                                    \
+            for (k = 0; k < n; k++)                                         \
+                acc[k] += src[k] * coeff;                                   \
+        }                                                                   \
+        for (k = 0; k < n; k++)                                             \
+            dst[i + k] = round(acc[k]);                                     \
+    }                                                                       \
+} while (0)
+
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy){
     int out_i, in_i, i, j;
     int len1 = 0;
@@ -553,32 +579,11 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
             break;}
         default:
             if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP){
-                for(i=0; i<len; i++){
-                    float v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((float*)in->ch[in_i])[i] * s->matrix_flt[out_i][in_i];
-                    }
-                    ((float*)out->ch[out_i])[i]= v;
-                }
+                MIX_ANY(float, float, s->matrix_flt, );
             }else if(s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
-                for(i=0; i<len; i++){
-                    double v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((double*)in->ch[in_i])[i] * s->matrix[out_i][in_i];
-                    }
-                    ((double*)out->ch[out_i])[i]= v;
-                }
+                MIX_ANY(double, double, s->matrix, );
             }else{
-                for(i=0; i<len; i++){
-                    int v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((int16_t*)in->ch[in_i])[i] * s->matrix32[out_i][in_i];
-                    }
-                    ((int16_t*)out->ch[out_i])[i]= (v + 16384)>>15;
-                }
+                MIX_ANY(int16_t, int, s->matrix32, MIX_ANY_ROUND_S16);
             }
         }
     }
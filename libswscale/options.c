@@ -84,6 +84,8 @@ static const AVOption swscale_options[] = {
     { "threads",         "number of threads",             OFFSET(nb_threads),   AV_OPT_TYPE_INT, {.i64 = 1 }, 0, INT_MAX, VE, "threads" },
         { "auto",        NULL,                            0,                  AV_OPT_TYPE_CONST, {.i64 = 0 },    .flags = VE, "threads" },
 
+    { "chr_decimate",    "decimate 4:4:4 chroma to 4:2:x with fixed kernels, not bit-exact with the scaler", OFFSET(chr_decimate), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+
     { NULL }
 };
 
@@ -633,17 +633,24 @@ static int check_image_pointers(const uint8_t * const data[4], enum AVPixelForma
     return 1;
 }
 
-static void xyz12Torgb48(struct SwsContext *c, uint16_t *dst,
-                         const uint16_t *src, int stride, int h)
+static av_always_inline void xyz12Torgb48_c(const SwsContext *c, uint16_t *dst,
+                                            const uint16_t *src, int stride,
+                                            int w, int h, int big_endian)
 {
-    int xp,yp;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
-
-    for (yp=0; yp<h; yp++) {
-        for (xp=0; xp+2<stride; xp+=3) {
+    const int16_t *xyzgamma = c->xyzgamma;
+    const int16_t *rgbgamma = c->rgbgamma;
+    const int c00 = c->xyz2rgb_matrix[0][0], c01 = c->xyz2rgb_matrix[0][1],
+              c02 = c->xyz2rgb_matrix[0][2], c10 = c->xyz2rgb_matrix[1][0],
+              c11 = c->xyz2rgb_matrix[1][1], c12 = c->xyz2rgb_matrix[1][2],
+              c20 = c->xyz2rgb_matrix[2][0], c21 = c->xyz2rgb_matrix[2][1],
+              c22 = c->xyz2rgb_matrix[2][2];
+    int xp, yp;
+
+    for (yp = 0; yp < h; yp++) {
+        for (xp = 0; xp < 3 * w; xp += 3) {
             int x, y, z, r, g, b;
 
-            if (desc->flags & AV_PIX_FMT_FLAG_BE) {
+            if (big_endian) {
                 x = AV_RB16(src + xp + 0);
                 y = AV_RB16(src + xp + 1);
                 z = AV_RB16(src + xp + 2);
@@ -653,20 +660,14 @@ static void xyz12Torgb48(struct SwsContext *c, uint16_t *dst,
                 z = AV_RL16(src + xp + 2);
             }
 
-            x = c->xyzgamma[x>>4];
-            y = c->xyzgamma[y>>4];
-            z = c->xyzgamma[z>>4];
+            x = xyzgamma[x >> 4];
+            y = xyzgamma[y >> 4];
+            z = xyzgamma[z >> 4];
 
             // convert from XYZlinear to sRGBlinear
-            r = c->xyz2rgb_matrix[0][0] * x +
-                c->xyz2rgb_matrix[0][1] * y +
-                c->xyz2rgb_matrix[0][2] * z >> 12;
-            g = c->xyz2rgb_matrix[1][0] * x +
-                c->xyz2rgb_matrix[1][1] * y +
-                c->xyz2rgb_matrix[1][2] * z >> 12;
-            b = c->xyz2rgb_matrix[2][0] * x +
-                c->xyz2rgb_matrix[2][1] * y +
-                c->xyz2rgb_matrix[2][2] * z >> 12;
+            r = c00 * x + c01 * y + c02 * z >> 12;
+            g = c10 * x + c11 * y + c12 * z >> 12;
+            b = c20 * x + c21 * y + c22 * z >> 12;
 
             // limit values to 12-bit depth
             r = av_clip_uintp2(r, 12);
@@ -674,14 +675,14 @@ static void xyz12Torgb48(struct SwsContext *c, uint16_t *dst,
             b = av_clip_uintp2(b, 12);
 
             // convert from sRGBlinear to RGB and scale from 12bit to 16bit
-            if (desc->flags & AV_PIX_FMT_FLAG_BE) {
-                AV_WB16(dst + xp + 0, c->rgbgamma[r] << 4);
-                AV_WB16(dst + xp + 1, c->rgbgamma[g] << 4);
-                AV_WB16(dst + xp + 2, c->rgbgamma[b] << 4);
+            if (big_endian) {
+                AV_WB16(dst + xp + 0, rgbgamma[r] << 4);
+                AV_WB16(dst + xp + 1, rgbgamma[g] << 4);
+                AV_WB16(dst + xp + 2, rgbgamma[b] << 4);
             } else {
-                AV_WL16(dst + xp + 0, c->rgbgamma[r] << 4);
-                AV_WL16(dst + xp + 1, c->rgbgamma[g] << 4);
-                AV_WL16(dst + xp + 2, c->rgbgamma[b] << 4);
+                AV_WL16(dst + xp + 0, rgbgamma[r] << 4);
+                AV_WL16(dst + xp + 1, rgbgamma[g] << 4);
+                AV_WL16(dst + xp + 2, rgbgamma[b] << 4);
             }
         }
         src += stride;
@@ -689,17 +690,24 @@ static void xyz12Torgb48(struct SwsContext *c, uint16_t *dst,
     }
 }
 
-static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
-                         const uint16_t *src, int stride, int h)
+static av_always_inline void rgb48Toxyz12_c(const SwsContext *c, uint16_t *dst,
+                                            const uint16_t *src, int stride,
+                                            int w, int h, int big_endian)
 {
-    int xp,yp;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
-
-    for (yp=0; yp<h; yp++) {
-        for (xp=0; xp+2<stride; xp+=3) {
+    const int16_t *rgbgammainv = c->rgbgammainv;
+    const int16_t *xyzgammainv = c->xyzgammainv;
+    const int c00 = c->rgb2xyz_matrix[0][0], c01 = c->rgb2xyz_matrix[0][1],
+              c02 = c->rgb2xyz_matrix[0][2], c10 = c->rgb2xyz_matrix[1][0],
+              c11 = c->rgb2xyz_matrix[1][1], c12 = c->rgb2xyz_matrix[1][2],
+              c20 = c->rgb2xyz_matrix[2][0], c21 = c->rgb2xyz_matrix[2][1],
+              c22 = c->rgb2xyz_matrix[2][2];
+    int xp, yp;
+
+    for (yp = 0; yp < h; yp++) {
+        for (xp = 0; xp < 3 * w; xp += 3) {
             int x, y, z, r, g, b;
 
-            if (desc->flags & AV_PIX_FMT_FLAG_BE) {
+            if (big_endian) {
                 r = AV_RB16(src + xp + 0);
                 g = AV_RB16(src + xp + 1);
                 b = AV_RB16(src + xp + 2);
@@ -709,20 +717,14 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
                 b = AV_RL16(src + xp + 2);
             }
 
-            r = c->rgbgammainv[r>>4];
-            g = c->rgbgammainv[g>>4];
-            b = c->rgbgammainv[b>>4];
+            r = rgbgammainv[r >> 4];
+            g = rgbgammainv[g >> 4];
+            b = rgbgammainv[b >> 4];
 
             // convert from sRGBlinear to XYZlinear
-            x = c->rgb2xyz_matrix[0][0] * r +
-                c->rgb2xyz_matrix[0][1] * g +
-                c->rgb2xyz_matrix[0][2] * b >> 12;
-            y = c->rgb2xyz_matrix[1][0] * r +
-                c->rgb2xyz_matrix[1][1] * g +
-                c->rgb2xyz_matrix[1][2] * b >> 12;
-            z = c->rgb2xyz_matrix[2][0] * r +
-                c->rgb2xyz_matrix[2][1] * g +
-                c->rgb2xyz_matrix[2][2] * b >> 12;
+            x = c00 * r + c01 * g + c02 * b >> 12;
+            y = c10 * r + c11 * g + c12 * b >> 12;
+            z = c20 * r + c21 * g + c22 * b >> 12;
 
             // limit values to 12-bit depth
             x = av_clip_uintp2(x, 12);
@@ -730,14 +732,14 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
             z = av_clip_uintp2(z, 12);
 
             // convert from XYZlinear to X'Y'Z' and scale from 12bit to 16bit
-            if (desc->flags & AV_PIX_FMT_FLAG_BE) {
-                AV_WB16(dst + xp + 0, c->xyzgammainv[x] << 4);
-                AV_WB16(dst + xp + 1, c->xyzgammainv[y] << 4);
-                AV_WB16(dst + xp + 2, c->xyzgammainv[z] << 4);
+            if (big_endian) {
+                AV_WB16(dst + xp + 0, xyzgammainv[x] << 4);
+                AV_WB16(dst + xp + 1, xyzgammainv[y] << 4);
+                AV_WB16(dst + xp + 2, xyzgammainv[z] << 4);
             } else {
-                AV_WL16(dst + xp + 0, c->xyzgammainv[x] << 4);
-                AV_WL16(dst + xp + 1, c->xyzgammainv[y] << 4);
-                AV_WL16(dst + xp + 2, c->xyzgammainv[z] << 4);
+                AV_WL16(dst + xp + 0, xyzgammainv[x] << 4);
+                AV_WL16(dst + xp + 1, xyzgammainv[y] << 4);
+                AV_WL16(dst + xp + 2, xyzgammainv[z] << 4);
             }
         }
         src += stride;
@@ -745,6 +747,33 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
     }
 }
 
+/*
+ * Only the w visible pixels of each line are converted; the padding up to
+ * the stride is left alone. The byte order test is hoisted out of the loops
+ * so that each variant gets its own tight inner loop.
+ */
+static void xyz12Torgb48(const SwsContext *c, uint16_t *dst,
+                         const uint16_t *src, int stride, int w, int h)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+
+    if (desc->flags & AV_PIX_FMT_FLAG_BE)
+        xyz12Torgb48_c(c, dst, src, stride, w, h, 1);
+    else
+        xyz12Torgb48_c(c, dst, src, stride, w, h, 0);
+}
+
+static void rgb48Toxyz12(const SwsContext *c, uint16_t *dst,
+                         const uint16_t *src, int stride, int w, int h)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
+
+    if (desc->flags & AV_PIX_FMT_FLAG_BE)
+        rgb48Toxyz12_c(c, dst, src, stride, w, h, 1);
+    else
+        rgb48Toxyz12_c(c, dst, src, stride, w, h, 0);
+}
+
 static void update_palette(SwsContext *c, const uint32_t *pal)
 {
     for (int i = 0; i < 256; i++) {
@@ -990,7 +1019,8 @@ static int scale_internal(SwsContext *c,
         base = srcStride[0] < 0 ? c->xyz_scratch - srcStride[0] * (srcSliceH-1) :
                                   c->xyz_scratch;
 
-        xyz12Torgb48(c, (uint16_t*)base, (const uint16_t*)src2[0], srcStride[0]/2, srcSliceH);
+        xyz12Torgb48(c, (uint16_t*)base, (const uint16_t*)src2[0], srcStride[0]/2,
+                     c->srcW, srcSliceH);
         src2[0] = base;
     }
 
@@ -1038,6 +1068,7 @@ static int scale_internal(SwsContext *c,
             slice_h = dstSliceH;
         }
 
+        c->chrDecimateDstSlice = scale_dst;
         ret = c->convert_unscaled(c, src2, srcStride2, offset, slice_h,
                                   dst2, dstStride2);
         if (scale_dst)
@@ -1062,7 +1093,7 @@ static int scale_internal(SwsContext *c,
         }
 
         /* replace on the same data */
-        rgb48Toxyz12(c, dst16, dst16, dstStride2[0]/2, ret);
+        rgb48Toxyz12(c, dst16, dst16, dstStride2[0]/2, c->dstW, ret);
     }
 
     /* reset slice direction at end of frame */
@@ -1171,7 +1202,8 @@ int sws_receive_slice(struct SwsContext *c, unsigned int slice_start,
     }
 
     for (int i = 0; i < FF_ARRAY_ELEMS(dst); i++) {
-        ptrdiff_t offset = c->frame_dst->linesize[i] * (slice_start >> c->chrDstVSubSample);
+        const int vshift = (i == 1 || i == 2) ? c->chrDstVSubSample : 0;
+        ptrdiff_t offset = c->frame_dst->linesize[i] * (slice_start >> vshift);
         dst[i] = FF_PTR_ADD(c->frame_dst->data[i], offset);
     }
 
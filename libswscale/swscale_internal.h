@@ -418,6 +418,12 @@ typedef struct SwsContext {
     int hChrFilterSize;           ///< Horizontal filter size for chroma     pixels.
     int vLumFilterSize;           ///< Vertical   filter size for luma/alpha pixels.
     int vChrFilterSize;           ///< Vertical   filter size for chroma     pixels.
+    /**
+     * References to the filter arrays above when they are shared with the
+     * process-wide filter cache, indexed by [hLum, hChr, vLum, vChr]
+     * [coefficients, positions]. NULL when the context owns the array.
+     */
+    AVBufferRef *filterBuf[4][2];
     //@}
 
     int lumMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for luma/alpha planes.
@@ -655,6 +661,23 @@ typedef struct SwsContext {
     /// Color range conversion function for chroma planes if needed.
     void (*chrConvertRange)(int16_t *dst1, int16_t *dst2, int width);
 
+    /**
+     * 2:1 chroma decimation of the unscaled 4:4:4 to 4:2:2 and 4:2:0
+     * converter, 8 taps in units of 1/64 for each direction.
+     */
+    int16_t chrDecimateHTaps[8];
+    int16_t chrDecimateVTaps[8];
+    /**
+     * Last 8 chroma lines of the preceding slices of the frame, by plane and
+     * line number modulo 8, and the next chroma line to output. 4:2:0 output
+     * lines are delayed until the lines below them have been received.
+     */
+    uint16_t    *chrDecimateLines;
+    unsigned int chrDecimateLines_allocated;
+    int          chrDecimateY;
+    int          chr_decimate;         ///< Use the chroma decimation converter, set by the user.
+    int          chrDecimateDstSlice;  ///< Set while a destination slice of a whole source frame is converted.
+
     int needs_hcscale; ///< Set if there are chroma planes to be converted.
 
     SwsDither dither;
@@ -1966,6 +1966,195 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t *src[],
 }
 
 
+/* 2:1 chroma decimation filters in units of 1/64, applied to the source
+ * samples 2x - 3 to 2x + 4 (or lines 2y - 3 to 2y + 4) for output x (y).
+ * They are the kernels of the scaler stretched by the decimation factor, so
+ * that the results match it closely. */
+static const int16_t chr_decimate_taps[2][4][8] = {
+    { /* chroma sited between 2x and 2x + 1 */
+        {  0,  0,  0,  0, 64,  0,  0,  0 }, /* point */
+        {  0,  0,  0, 32, 32,  0,  0,  0 }, /* area */
+        {  0,  0,  8, 24, 24,  8,  0,  0 }, /* bilinear */
+        { -1, -3,  8, 28, 28,  8, -3, -1 }, /* bicubic */
+    },
+    { /* chroma co-sited with 2x */
+        {  0,  0,  0, 64,  0,  0,  0,  0 },
+        {  0,  0, 16, 32, 16,  0,  0,  0 },
+        {  0,  0, 16, 32, 16,  0,  0,  0 },
+        { -2,  0, 18, 32, 18,  0, -2,  0 },
+    },
+};
+
+/* Horizontal decimation of a line, with the samples outside of it
+ * replicated from its edges. */
+static void chr_decimate_h(uint16_t *dst, const uint16_t *src, int srcW, int dstW,
+                           const int16_t *taps, int max)
+{
+    int i, k;
+
+    for (i = 0; i < dstW; i++) {
+        int val = 0;
+        if (2 * i - 3 >= 0 && 2 * i + 4 < srcW) {
+            const uint16_t *s = src + 2 * i - 3;
+            for (k = 0; k < 8; k++)
+                val += taps[k] * s[k];
+        } else {
+            for (k = 0; k < 8; k++)
+                val += taps[k] * src[av_clip(2 * i - 3 + k, 0, srcW - 1)];
+        }
+        dst[i] = av_clip((val + 32) >> 6, 0, max);
+    }
+}
+
+static void chr_decimate_v(uint16_t *dst, const uint16_t *const *src, int width,
+                           const int16_t *taps, int max)
+{
+    int i, k;
+
+    for (i = 0; i < width; i++) {
+        int val = 0;
+        for (k = 0; k < 8; k++)
+            val += taps[k] * src[k][i];
+        dst[i] = av_clip((val + 32) >> 6, 0, max);
+    }
+}
+
+/* Native endian 9-16 bit planar YUV 4:4:4 to 4:2:2 or 4:2:0 of the same
+ * depth. For 4:2:0, chroma line y is filtered from the source lines 2y - 3 to
+ * 2y + 4, clipped to the picture. Lines of earlier slices are taken from
+ * c->chrDecimateLines, and output lines needing lines of later slices are
+ * left to those, so that the result does not depend on the slicing. When a
+ * destination slice is converted, the whole source frame is available and
+ * the lines around the slice are read directly. */
+static int chrDecimate16Wrapper(SwsContext *c, const uint8_t *src[],
+                                int srcStride[], int srcSliceY, int srcSliceH,
+                                uint8_t *dst[], int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
+    int max  = (1 << desc->comp[1].depth) - 1;
+    int srcW = c->srcW;
+    int sliceEnd = srcSliceY + srcSliceH;
+    int dstSlice = c->chrDecimateDstSlice;
+    uint16_t *tmp = (uint16_t *)c->formatConvBuffer;
+    int plane, i, y, k;
+
+    copyPlane(src[0], srcStride[0], srcSliceY, srcSliceH, srcW * 2,
+              dst[0], dstStride[0]);
+    if (dst[3])
+        copyPlane(src[3], srcStride[3], srcSliceY, srcSliceH, srcW * 2,
+                  dst[3], dstStride[3]);
+
+    if (!c->chrDstVSubSample) {
+        for (plane = 1; plane < 3; plane++) {
+            for (i = 0; i < srcSliceH; i++)
+                chr_decimate_h((uint16_t *)(dst[plane] + (srcSliceY + i) * dstStride[plane]),
+                               (const uint16_t *)(src[plane] + i * srcStride[plane]),
+                               srcW, c->chrDstW, c->chrDecimateHTaps, max);
+        }
+        return srcSliceH;
+    }
+
+    if (!dstSlice && srcSliceH < c->srcH) {
+        av_fast_malloc(&c->chrDecimateLines, &c->chrDecimateLines_allocated,
+                       2 * 8 * srcW * sizeof(*c->chrDecimateLines));
+        if (!c->chrDecimateLines)
+            return AVERROR(ENOMEM);
+    }
+    if (!srcSliceY)
+        c->chrDecimateY = 0;
+
+    for (plane = 1; plane < 3; plane++) {
+        uint16_t *lines = !dstSlice && srcSliceH < c->srcH ?
+                          c->chrDecimateLines + (plane - 1) * 8 * srcW : NULL;
+
+        for (y = dstSlice ? srcSliceY >> 1 : c->chrDecimateY; y < c->chrDstH; y++) {
+            const uint16_t *in[8];
+
+            if (dstSlice ? 2 * y >= sliceEnd : FFMIN(2 * y + 4, c->srcH - 1) >= sliceEnd)
+                break;
+            for (k = 0; k < 8; k++) {
+                int line = av_clip(2 * y - 3 + k, 0, c->srcH - 1);
+                in[k] = dstSlice || line >= srcSliceY ?
+                        (const uint16_t *)(src[plane] + (line - srcSliceY) * srcStride[plane]) :
+                        lines + (line & 7) * srcW;
+            }
+            chr_decimate_v(tmp, in, srcW, c->chrDecimateVTaps, max);
+            chr_decimate_h((uint16_t *)(dst[plane] + y * dstStride[plane]), tmp,
+                           srcW, c->chrDstW, c->chrDecimateHTaps, max);
+        }
+
+        if (!dstSlice && sliceEnd < c->srcH) {
+            for (i = FFMAX(srcSliceY, sliceEnd - 8); i < sliceEnd; i++)
+                memcpy(lines + (i & 7) * srcW,
+                       src[plane] + (i - srcSliceY) * srcStride[plane],
+                       srcW * sizeof(*lines));
+        }
+    }
+    if (!dstSlice)
+        c->chrDecimateY = y;
+    return srcSliceH;
+}
+
+/* Index of the taps for the scaling algorithm, or -1 if there are none
+ * for it. */
+static int chr_decimate_filter(SwsContext *c)
+{
+    if (c->flags & SWS_POINT)
+        return 0;
+    if (c->flags & SWS_AREA)
+        return 1;
+    if (c->flags & (SWS_FAST_BILINEAR | SWS_BILINEAR | SWS_BICUBLIN))
+        return 2;
+    if ((c->flags & SWS_BICUBIC) &&
+        c->param[0] == SWS_PARAM_DEFAULT && c->param[1] == SWS_PARAM_DEFAULT)
+        return 3;
+    return -1;
+}
+
+/* Index of the taps for a destination chroma position, or -1 if there are
+ * none for it. */
+static int chr_decimate_siting(int pos)
+{
+    if (pos == -1 || pos <= -513 || pos == 128)
+        return 0;
+    if (pos == 0)
+        return 1;
+    return -1;
+}
+
+static int init_chr_decimate(SwsContext *c)
+{
+    const AVPixFmtDescriptor *desc_src = av_pix_fmt_desc_get(c->srcFormat);
+    const AVPixFmtDescriptor *desc_dst = av_pix_fmt_desc_get(c->dstFormat);
+    int filter = chr_decimate_filter(c);
+    int hsite  = chr_decimate_siting(c->dst_h_chr_pos);
+    int vsite  = chr_decimate_siting(c->dst_v_chr_pos);
+    int depth  = desc_src->comp[0].depth;
+    int i;
+
+    if (!c->chr_decimate ||
+        !isPlanarYUV(c->srcFormat) || !isPlanarYUV(c->dstFormat) ||
+        isSemiPlanarYUV(c->srcFormat) || isSemiPlanarYUV(c->dstFormat) ||
+        isBE(c->srcFormat) != HAVE_BIGENDIAN || isBE(c->dstFormat) != HAVE_BIGENDIAN ||
+        desc_src->nb_components != desc_dst->nb_components ||
+        c->chrSrcHSubSample || c->chrSrcVSubSample ||
+        c->chrDstHSubSample != 1 || c->chrDstVSubSample > 1 ||
+        depth <= 8 || depth > 16 || filter < 0 || hsite < 0 ||
+        (c->chrDstVSubSample && vsite < 0) ||
+        /* the scaler steps by srcW / chrDstW rather than 2 for odd sizes */
+        (c->srcW & 1) || (c->chrDstVSubSample && (c->srcH & 1)))
+        return 0;
+    for (i = 0; i < desc_src->nb_components; i++)
+        if (desc_src->comp[i].depth != depth || desc_dst->comp[i].depth != depth)
+            return 0;
+
+    memcpy(c->chrDecimateHTaps, chr_decimate_taps[hsite][filter], sizeof(c->chrDecimateHTaps));
+    if (c->chrDstVSubSample)
+        memcpy(c->chrDecimateVTaps, chr_decimate_taps[vsite][filter], sizeof(c->chrDecimateVTaps));
+    return 1;
+}
+
+
 #define IS_DIFFERENT_ENDIANESS(src_fmt, dst_fmt, pix_fmt)          \
     ((src_fmt == pix_fmt ## BE && dst_fmt == pix_fmt ## LE) ||     \
      (src_fmt == pix_fmt ## LE && dst_fmt == pix_fmt ## BE))
@@ -2222,6 +2411,10 @@ void ff_get_unscaled_swscale(SwsContext *c)
             c->convert_unscaled = planarCopyWrapper;
     }
 
+    /* chroma subsampling at the same high bit depth */
+    if (init_chr_decimate(c))
+        c->convert_unscaled = chrDecimate16Wrapper;
+
     if (ARCH_PPC)
         ff_get_unscaled_swscale_ppc(c);
      if (ARCH_ARM)
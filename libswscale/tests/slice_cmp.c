@@ -0,0 +1,224 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks that scaling a frame in source or destination slices, or with slice
+ * threads, gives the same result as scaling it whole, for conversions whose
+ * filters span several lines.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/frame.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+#define W 96
+#define H 70
+
+static const struct {
+    enum AVPixelFormat src, dst;
+    int flags;
+    int chr_pos;
+} tests[] = {
+    { AV_PIX_FMT_YUV444P10,  AV_PIX_FMT_YUV420P10,  SWS_BILINEAR, -513 },
+    { AV_PIX_FMT_YUV444P10,  AV_PIX_FMT_YUV420P10,  SWS_BICUBIC,  -513 },
+    { AV_PIX_FMT_YUV444P12,  AV_PIX_FMT_YUV420P12,  SWS_BICUBIC,     0 },
+    { AV_PIX_FMT_YUV444P12,  AV_PIX_FMT_YUV420P12,  SWS_POINT,    -513 },
+    { AV_PIX_FMT_YUVA444P16, AV_PIX_FMT_YUVA420P16, SWS_AREA,     -513 },
+    { AV_PIX_FMT_YUV444P16,  AV_PIX_FMT_YUV422P16,  SWS_BICUBIC,  -513 },
+    { AV_PIX_FMT_YUV444P10,  AV_PIX_FMT_YUV420P10,  SWS_LANCZOS,  -513 },
+};
+
+static struct SwsContext *get_context(int i, int threads)
+{
+    struct SwsContext *c = sws_alloc_context();
+
+    if (!c)
+        return NULL;
+    av_opt_set_int(c, "srcw",          W,                0);
+    av_opt_set_int(c, "srch",          H,                0);
+    av_opt_set_int(c, "dstw",          W,                0);
+    av_opt_set_int(c, "dsth",          H,                0);
+    av_opt_set_int(c, "src_format",    tests[i].src,     0);
+    av_opt_set_int(c, "dst_format",    tests[i].dst,     0);
+    av_opt_set_int(c, "sws_flags",     tests[i].flags,   0);
+    av_opt_set_int(c, "dst_h_chr_pos", tests[i].chr_pos, 0);
+    av_opt_set_int(c, "dst_v_chr_pos", tests[i].chr_pos, 0);
+    av_opt_set_int(c, "threads",       threads,          0);
+    av_opt_set_int(c, "chr_decimate",  1,                0);
+    if (sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+static AVFrame *get_frame(enum AVPixelFormat format)
+{
+    AVFrame *frame = av_frame_alloc();
+
+    if (!frame)
+        return NULL;
+    frame->format = format;
+    frame->width  = W;
+    frame->height = H;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+static int compare(const AVFrame *a, const AVFrame *b)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+    int plane, y;
+
+    for (plane = 0; plane < 4 && a->data[plane]; plane++) {
+        int sub = plane == 1 || plane == 2;
+        int w = AV_CEIL_RSHIFT(W, sub ? desc->log2_chroma_w : 0) * 2;
+        int h = AV_CEIL_RSHIFT(H, sub ? desc->log2_chroma_h : 0);
+
+        for (y = 0; y < h; y++)
+            if (memcmp(a->data[plane] + y * a->linesize[plane],
+                       b->data[plane] + y * b->linesize[plane], w))
+                return 1;
+    }
+    return 0;
+}
+
+static int scale_dst_slices(struct SwsContext *c, AVFrame *out, const AVFrame *src,
+                            AVLFG *lfg)
+{
+    int align = sws_receive_slice_alignment(c);
+    int start, ret;
+
+    ret = sws_frame_start(c, out, src);
+    if (ret < 0)
+        return ret;
+
+    ret = sws_send_slice(c, 0, H);
+    for (start = 0; ret >= 0 && start < H;) {
+        int h = align * (1 + av_lfg_get(lfg) % 6);
+
+        h   = FFMIN(h, H - start);
+        ret = sws_receive_slice(c, start, h);
+        start += h;
+    }
+
+    sws_frame_end(c);
+    return ret;
+}
+
+static int run_test(int i, AVLFG *lfg)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(tests[i].src);
+    struct SwsContext *c = get_context(i, 1), *ct = get_context(i, 4);
+    AVFrame *src = get_frame(tests[i].src);
+    AVFrame *ref = get_frame(tests[i].dst);
+    AVFrame *out = get_frame(tests[i].dst);
+    int plane, x, y, start, ret = -1;
+
+    if (!c || !ct || !src || !ref || !out)
+        goto end;
+
+    for (plane = 0; plane < desc->nb_components; plane++) {
+        for (y = 0; y < H; y++) {
+            uint16_t *line = (uint16_t *)(src->data[plane] + y * src->linesize[plane]);
+            for (x = 0; x < W; x++)
+                line[x] = av_lfg_get(lfg) & ((1 << desc->comp[plane].depth) - 1);
+        }
+    }
+
+    if (sws_scale(c, (const uint8_t * const *)src->data, src->linesize, 0, H,
+                  ref->data, ref->linesize) < 0)
+        goto end;
+
+    for (start = 0; start < H;) {
+        const uint8_t *slice[4] = { NULL };
+        int h = 1 + av_lfg_get(lfg) % 12;
+
+        h = FFMIN(h, H - start);
+
+        for (plane = 0; plane < 4 && src->data[plane]; plane++)
+            slice[plane] = src->data[plane] + start * src->linesize[plane];
+        if (sws_scale(c, slice, src->linesize, start, h,
+                      out->data, out->linesize) < 0)
+            goto end;
+        start += h;
+    }
+    if (compare(ref, out)) {
+        printf("%s -> %s flags %d: sliced output differs\n",
+               av_get_pix_fmt_name(tests[i].src), av_get_pix_fmt_name(tests[i].dst),
+               tests[i].flags);
+        ret = 1;
+        goto end;
+    }
+
+    if (scale_dst_slices(c, out, src, lfg) < 0)
+        goto end;
+    if (compare(ref, out)) {
+        printf("%s -> %s flags %d: destination sliced output differs\n",
+               av_get_pix_fmt_name(tests[i].src), av_get_pix_fmt_name(tests[i].dst),
+               tests[i].flags);
+        ret = 1;
+        goto end;
+    }
+
+    if (sws_scale_frame(ct, out, src) < 0)
+        goto end;
+    if (compare(ref, out)) {
+        printf("%s -> %s flags %d: threaded output differs\n",
+               av_get_pix_fmt_name(tests[i].src), av_get_pix_fmt_name(tests[i].dst),
+               tests[i].flags);
+        ret = 1;
+        goto end;
+    }
+
+    printf("%s -> %s flags %d chr_pos %d: ok\n",
+           av_get_pix_fmt_name(tests[i].src), av_get_pix_fmt_name(tests[i].dst),
+           tests[i].flags, tests[i].chr_pos);
+    ret = 0;
+end:
+    if (ret < 0)
+        printf("%s -> %s flags %d: error\n",
+               av_get_pix_fmt_name(tests[i].src), av_get_pix_fmt_name(tests[i].dst),
+               tests[i].flags);
+    sws_freeContext(c);
+    sws_freeContext(ct);
+    av_frame_free(&src);
+    av_frame_free(&ref);
+    av_frame_free(&out);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int i, ret = 0;
+
+    av_lfg_init(&lfg, 0xff5);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++)
+        if (run_test(i, &lfg))
+            ret = 1;
+    return ret;
+}
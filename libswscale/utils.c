@@ -730,6 +730,133 @@ done:
     return ret;
 }
 
+/*
+ * Filters only depend on their initFilter() arguments, so contexts with the
+ * same geometry and flags share read-only, refcounted copies through a small
+ * process-wide cache instead of recomputing them. Filters using custom
+ * SwsVectors are not cached.
+ */
+#define FILTER_CACHE_SIZE 32
+
+typedef struct FilterCacheKey {
+    int xInc, srcW, dstW, filterAlign, one, flags, cpu_flags, srcPos, dstPos;
+    double param[2];
+} FilterCacheKey;
+
+typedef struct FilterCacheEntry {
+    FilterCacheKey key;
+    AVBufferRef *filter, *filterPos;
+    int filterSize;
+} FilterCacheEntry;
+
+static AVMutex filter_cache_mutex = AV_MUTEX_INITIALIZER;
+static FilterCacheEntry filter_cache[FILTER_CACHE_SIZE];
+static unsigned filter_cache_next;
+
+static av_cold int initFilterCached(int16_t **outFilter, int32_t **filterPos,
+                                    AVBufferRef *bufs[2],
+                                    int *outFilterSize, int xInc, int srcW,
+                                    int dstW, int filterAlign, int one,
+                                    int flags, int cpu_flags,
+                                    SwsVector *srcFilter, SwsVector *dstFilter,
+                                    double param[2], int srcPos, int dstPos)
+{
+    FilterCacheKey key;
+    FilterCacheEntry *e;
+    int i, ret;
+
+    if (srcFilter || dstFilter)
+        return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                          dstW, filterAlign, one, flags, cpu_flags,
+                          srcFilter, dstFilter, param, srcPos, dstPos);
+
+    memset(&key, 0, sizeof(key));
+    key.xInc        = xInc;
+    key.srcW        = srcW;
+    key.dstW        = dstW;
+    key.filterAlign = filterAlign;
+    key.one         = one;
+    key.flags       = flags;
+    key.cpu_flags   = cpu_flags;
+    key.srcPos      = srcPos;
+    key.dstPos      = dstPos;
+    key.param[0]    = param[0];
+    key.param[1]    = param[1];
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (i = 0; i < FILTER_CACHE_SIZE; i++) {
+        e = &filter_cache[i];
+        if (e->filter && !memcmp(&e->key, &key, sizeof(key))) {
+            bufs[0] = av_buffer_ref(e->filter);
+            bufs[1] = av_buffer_ref(e->filterPos);
+            if (!bufs[0] || !bufs[1]) {
+                av_buffer_unref(&bufs[0]);
+                av_buffer_unref(&bufs[1]);
+                break;
+            }
+            *outFilter     = (int16_t *)bufs[0]->data;
+            *filterPos     = (int32_t *)bufs[1]->data;
+            *outFilterSize = e->filterSize;
+            ff_mutex_unlock(&filter_cache_mutex);
+            return 0;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    ret = initFilter(outFilter, filterPos, outFilterSize, xInc, srcW, dstW,
+                     filterAlign, one, flags, cpu_flags, NULL, NULL,
+                     param, srcPos, dstPos);
+    if (ret < 0)
+        return ret;
+
+    bufs[0] = av_buffer_create((uint8_t *)*outFilter,
+                               *outFilterSize * (dstW + 3) * sizeof(**outFilter),
+                               NULL, NULL, AV_BUFFER_FLAG_READONLY);
+    if (!bufs[0]) {
+        av_freep(outFilter);
+        av_freep(filterPos);
+        return AVERROR(ENOMEM);
+    }
+    bufs[1] = av_buffer_create((uint8_t *)*filterPos,
+                               (dstW + 3) * sizeof(**filterPos),
+                               NULL, NULL, AV_BUFFER_FLAG_READONLY);
+    if (!bufs[1]) {
+        av_buffer_unref(&bufs[0]);
+        *outFilter = NULL;
+        av_freep(filterPos);
+        return AVERROR(ENOMEM);
+    }
+
+    ff_mutex_lock(&filter_cache_mutex);
+    e = &filter_cache[filter_cache_next++ % FILTER_CACHE_SIZE];
+    av_buffer_unref(&e->filter);
+    av_buffer_unref(&e->filterPos);
+    e->key        = key;
+    e->filterSize = *outFilterSize;
+    e->filter     = av_buffer_ref(bufs[0]);
+    e->filterPos  = av_buffer_ref(bufs[1]);
+    if (!e->filter || !e->filterPos) {
+        av_buffer_unref(&e->filter);
+        av_buffer_unref(&e->filterPos);
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    return 0;
+}
+
+static void freeFilter(int16_t **filter, int32_t **filterPos, AVBufferRef *bufs[2])
+{
+    if (bufs[0]) {
+        av_buffer_unref(&bufs[0]);
+        av_buffer_unref(&bufs[1]);
+        *filter    = NULL;
+        *filterPos = NULL;
+    } else {
+        av_freep(filter);
+        av_freep(filterPos);
+    }
+}
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -1784,8 +1911,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                     PPC_ALTIVEC(cpu_flags) ? 8 :
                                     have_neon(cpu_flags)   ? 8 : 1;
 
-            if ((ret = initFilter(&c->hLumFilter, &c->hLumFilterPos,
-                           &c->hLumFilterSize, c->lumXInc,
+            if ((ret = initFilterCached(&c->hLumFilter, &c->hLumFilterPos,
+                           c->filterBuf[0], &c->hLumFilterSize, c->lumXInc,
                            srcW, dstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                            cpu_flags, srcFilter->lumH, dstFilter->lumH,
@@ -1793,8 +1920,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                            get_local_pos(c, 0, 0, 0),
                            get_local_pos(c, 0, 0, 0))) < 0)
                 goto fail;
-            if ((ret = initFilter(&c->hChrFilter, &c->hChrFilterPos,
-                           &c->hChrFilterSize, c->chrXInc,
+            if ((ret = initFilterCached(&c->hChrFilter, &c->hChrFilterPos,
+                           c->filterBuf[1], &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
                            cpu_flags, srcFilter->chrH, dstFilter->chrH,
@@ -1811,7 +1938,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                 PPC_ALTIVEC(cpu_flags) ? 8 :
                                 have_neon(cpu_flags)   ? 2 : 1;
 
-        if ((ret = initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
+        if ((ret = initFilterCached(&c->vLumFilter, &c->vLumFilterPos,
+                       c->filterBuf[2], &c->vLumFilterSize,
                        c->lumYInc, srcH, dstH, filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                        cpu_flags, srcFilter->lumV, dstFilter->lumV,
@@ -1819,7 +1947,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                        get_local_pos(c, 0, 0, 1),
                        get_local_pos(c, 0, 0, 1))) < 0)
             goto fail;
-        if ((ret = initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
+        if ((ret = initFilterCached(&c->vChrFilter, &c->vChrFilterPos,
+                       c->filterBuf[3], &c->vChrFilterSize,
                        c->chrYInc, c->chrSrcH, c->chrDstH,
                        filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -2356,20 +2485,15 @@ void sws_freeContext(SwsContext *c)
 
     av_freep(&c->src_ranges.ranges);
 
-    av_freep(&c->vLumFilter);
-    av_freep(&c->vChrFilter);
-    av_freep(&c->hLumFilter);
-    av_freep(&c->hChrFilter);
+    freeFilter(&c->hLumFilter, &c->hLumFilterPos, c->filterBuf[0]);
+    freeFilter(&c->hChrFilter, &c->hChrFilterPos, c->filterBuf[1]);
+    freeFilter(&c->vLumFilter, &c->vLumFilterPos, c->filterBuf[2]);
+    freeFilter(&c->vChrFilter, &c->vChrFilterPos, c->filterBuf[3]);
 #if HAVE_ALTIVEC
     av_freep(&c->vYCoeffsBank);
     av_freep(&c->vCCoeffsBank);
 #endif
 
-    av_freep(&c->vLumFilterPos);
-    av_freep(&c->vChrFilterPos);
-    av_freep(&c->hLumFilterPos);
-    av_freep(&c->hChrFilterPos);
-
 #if HAVE_MMX_INLINE
 #if USE_MMAP
     if (c->lumMmxextFilterCode)
@@ -2404,6 +2528,7 @@ void sws_freeContext(SwsContext *c)
 
     av_freep(&c->rgb0_scratch);
     av_freep(&c->xyz_scratch);
+    av_freep(&c->chrDecimateLines);
 
     ff_free_filters(c);
 
@@ -33,6 +33,7 @@ struct sender_data {
     pthread_t tid;
     int workload;
     AVThreadMessageQueue *queue;
+    int spsc;
 };
 
 /* same as sender_data but shuffled for testing purpose */
@@ -41,6 +42,7 @@ struct receiver_data {
     int workload;
     int id;
     AVThreadMessageQueue *queue;
+    int spsc;
 };
 
 struct message {
@@ -66,7 +68,8 @@ static void *sender_thread(void *arg)
 
     av_log(NULL, AV_LOG_INFO, "sender #%d: workload=%d\n", wd->id, wd->workload);
     for (i = 0; i < wd->workload; i++) {
-        if (rand() % wd->workload < wd->workload / 10) {
+        /* only the receiver may flush a single producer/consumer queue */
+        if (!wd->spsc && rand() % wd->workload < wd->workload / 10) {
             av_log(NULL, AV_LOG_INFO, "sender #%d: flushing the queue\n", wd->id);
             av_thread_message_flush(wd->queue);
         } else {
@@ -164,6 +167,7 @@ static int get_workload(int minv, int maxv)
 int main(int ac, char **av)
 {
     int i, ret = 0;
+    int spsc = 0;
     int max_queue_size;
     int nb_senders, sender_min_load, sender_max_load;
     int nb_receivers, receiver_min_load, receiver_max_load;
@@ -171,12 +175,13 @@ int main(int ac, char **av)
     struct receiver_data *receivers;
     AVThreadMessageQueue *queue = NULL;
 
-    if (ac != 8) {
+    if (ac != 8 && !(ac == 9 && !strcmp(av[8], "spsc"))) {
         av_log(NULL, AV_LOG_ERROR, "%s <max_queue_size> "
                "<nb_senders> <sender_min_send> <sender_max_send> "
-               "<nb_receivers> <receiver_min_recv> <receiver_max_recv>\n", av[0]);
+               "<nb_receivers> <receiver_min_recv> <receiver_max_recv> [spsc]\n", av[0]);
         return 1;
     }
+    spsc = ac == 9;
 
     max_queue_size    = atoi(av[1]);
     nb_senders        = atoi(av[2]);
@@ -192,6 +197,10 @@ int main(int ac, char **av)
         av_log(NULL, AV_LOG_ERROR, "negative values not allowed\n");
         return 1;
     }
+    if (spsc && (nb_senders != 1 || nb_receivers != 1)) {
+        av_log(NULL, AV_LOG_ERROR, "spsc requires one sender and one receiver\n");
+        return 1;
+    }
 
     av_log(NULL, AV_LOG_INFO, "qsize:%d / %d senders sending [%d-%d] / "
            "%d receivers receiving [%d-%d]\n", max_queue_size,
@@ -205,7 +214,8 @@ int main(int ac, char **av)
         goto end;
     }
 
-    ret = av_thread_message_queue_alloc(&queue, max_queue_size, sizeof(struct message));
+    ret = av_thread_message_queue_alloc2(&queue, max_queue_size, sizeof(struct message),
+                                         spsc ? AV_THREAD_MESSAGE_QUEUE_SPSC : 0);
     if (ret < 0)
         goto end;
 
@@ -217,6 +227,7 @@ int main(int ac, char **av)
                                                                                 \
         td->id = i;                                                             \
         td->queue = queue;                                                      \
+        td->spsc = spsc;                                                        \
         td->workload = get_workload(type##_min_load, type##_max_load);          \
                                                                                 \
         ret = pthread_create(&td->tid, NULL, type##_thread, td);                \
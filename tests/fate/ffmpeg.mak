@@ -38,6 +38,20 @@ FATE_SAMPLES_FFMPEG-$(CONFIG_COLORKEY_FILTER) += fate-ffmpeg-filter_colorkey
 fate-ffmpeg-filter_colorkey: tests/data/filtergraphs/colorkey
 fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simple -fflags +bitexact -flags +bitexact  -sws_flags +accurate_rnd+bitexact -i $(TARGET_SAMPLES)/cavs/cavs.mpg -fflags +bitexact -flags +bitexact -sws_flags +accurate_rnd+bitexact -i $(TARGET_SAMPLES)/lena.pnm -an -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/colorkey -sws_flags +accurate_rnd+bitexact -fflags +bitexact -flags +bitexact -qscale 2 -frames:v 10
 
+# the independent branches run by worker threads output the same frames as
+# when run by the calling thread
+FATE_FFMPEG_BRANCH_THREADS = fate-ffmpeg-filter_complex_branch_threads \
+                             fate-ffmpeg-filter_complex_branch_threads_1
+FATE_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER HFLIP_FILTER \
+              SCALE_FILTER VOLUME_FILTER RAWVIDEO_ENCODER PCM_S16LE_ENCODER) += $(FATE_FFMPEG_BRANCH_THREADS)
+fate-ffmpeg-filter_complex_branch_threads: BRANCH_THREADS = 2
+fate-ffmpeg-filter_complex_branch_threads_1: BRANCH_THREADS = 1
+fate-ffmpeg-filter_complex_branch_threads_1: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-filter_complex_branch_threads
+$(FATE_FFMPEG_BRANCH_THREADS): CMD = framecrc -auto_conversion_filters -filter_complex_branch_threads $(BRANCH_THREADS) \
+  -f lavfi -i testsrc2=s=160x120:r=25:d=1 -f lavfi -i sine=d=1 \
+  -filter_complex "sws_flags=+accurate_rnd+bitexact\;[0:v]hflip,scale=80:60[v]\;[1:a]volume=0.5[a]" \
+  -map "[v]" -map "[a]" -c:v rawvideo -c:a pcm_s16le
+
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
@@ -22,6 +22,13 @@ FATE_LIBAVFORMAT-$(CONFIG_MOV_MUXER) += fate-movenc
 fate-movenc: libavformat/tests/movenc$(EXESUF)
 fate-movenc: CMD = run libavformat/tests/movenc$(EXESUF)
 
+# the read-ahead cases of the test only run with threads
+ifeq ($(HAVE_THREADS),yes)
+FATE_LIBAVFORMAT-$(CONFIG_IMF_DEMUXER) += fate-imf
+endif
+fate-imf: libavformat/tests/imf$(EXESUF)
+fate-imf: CMD = run libavformat/tests/imf$(EXESUF)
+
 FATE_LIBAVFORMAT += $(FATE_LIBAVFORMAT-yes)
 FATE-$(CONFIG_AVFORMAT) += $(FATE_LIBAVFORMAT)
 fate-libavformat: $(FATE_LIBAVFORMAT)
@@ -43,6 +43,11 @@ FATE_LIBAVUTIL += fate-bprint
 fate-bprint: libavutil/tests/bprint$(EXESUF)
 fate-bprint: CMD = run libavutil/tests/bprint$(EXESUF)
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-buffer_pool
+fate-buffer_pool: libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool: CMD = run libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool: CMP = null
+
 FATE_LIBAVUTIL += fate-cpu
 fate-cpu: libavutil/tests/cpu$(EXESUF)
 fate-cpu: CMD = runecho libavutil/tests/cpu$(EXESUF) $(CPUFLAGS:%=-c%) $(THREADS:%=-t%)
@@ -158,6 +163,10 @@ FATE_LIBAVUTIL += fate-xtea
 fate-xtea: libavutil/tests/xtea$(EXESUF)
 fate-xtea: CMD = run libavutil/tests/xtea$(EXESUF)
 
+FATE_LIBAVUTIL += fate-xxhash
+fate-xxhash: libavutil/tests/xxhash$(EXESUF)
+fate-xxhash: CMD = run libavutil/tests/xxhash$(EXESUF)
+
 FATE_LIBAVUTIL += fate-tea
 fate-tea: libavutil/tests/tea$(EXESUF)
 fate-tea: CMD = run libavutil/tests/tea$(EXESUF)
@@ -226,11 +226,15 @@ FATE_VCODEC-$(call ENCDEC, JPEGLS, AVI) += jpegls
 fate-vsynth%-jpegls:             ENCOPTS = -sws_flags neighbor+full_chroma_int
 fate-vsynth%-jpegls:             DECOPTS = -sws_flags area
 
-FATE_VCODEC-$(call ENCDEC, JPEG2000, AVI) += jpeg2000 jpeg2000-97
+FATE_VCODEC-$(call ENCDEC, JPEG2000, AVI) += jpeg2000 jpeg2000-97 jpeg2000-htj2k jpeg2000-97-htj2k
 fate-vsynth%-jpeg2000:                ENCOPTS = -qscale 7 -strict experimental -pred 1 -pix_fmt rgb24
 fate-vsynth%-jpeg2000:                DECINOPTS = -c:v jpeg2000
 fate-vsynth%-jpeg2000-97:             ENCOPTS = -qscale 7 -strict experimental -pix_fmt rgb24
 fate-vsynth%-jpeg2000-97:             DECINOPTS = -c:v jpeg2000
+fate-vsynth%-jpeg2000-htj2k:          ENCOPTS = -htj2k 1 -pred 1 -pix_fmt rgb24
+fate-vsynth%-jpeg2000-htj2k:          DECINOPTS = -c:v jpeg2000
+fate-vsynth%-jpeg2000-97-htj2k:       ENCOPTS = -htj2k 1 -qscale 7 -pix_fmt rgb24
+fate-vsynth%-jpeg2000-97-htj2k:       DECINOPTS = -c:v jpeg2000
 
 FATE_VCODEC-$(call ENCDEC, LJPEG MJPEG, AVI) += ljpeg
 fate-vsynth%-ljpeg:              ENCOPTS = -strict -1
@@ -463,7 +467,6 @@ FATE_VCODEC-$(call ENCDEC, ZLIB, AVI) += zlib
 FATE_VCODEC += $(FATE_VCODEC-yes)
 FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
-FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
 # Redundant tests because they just resize the input
 RESIZE_OFF   = dnxhd-720p dnxhd-720p-rd dnxhd-720p-10bit dnxhd-1080i \
                dv dv-411 dv-50 avui snow snow-hpel snow-ll vc2-420p \
@@ -477,6 +480,12 @@ VSYNTH3_OFF  = $(RESIZE_OFF) $(INC_PAR_OFF)
 FATE_VCODEC3 = $(filter-out $(VSYNTH3_OFF),$(FATE_VCODEC))
 FATE_VSYNTH3 = $(FATE_VCODEC3:%=fate-vsynth3-%)
 
+# HTJ2K references only exist for the generated inputs
+VSYNTH_LENA_OFF = jpeg2000-htj2k jpeg2000-97-htj2k
+
+FATE_VCODEC_LENA = $(filter-out $(VSYNTH_LENA_OFF),$(FATE_VCODEC))
+FATE_VSYNTH_LENA = $(FATE_VCODEC_LENA:%=fate-vsynth_lena-%)
+
 $(FATE_VSYNTH1): tests/data/vsynth1.yuv
 $(FATE_VSYNTH2): tests/data/vsynth2.yuv
 $(FATE_VSYNTH_LENA): tests/data/vsynth_lena.yuv
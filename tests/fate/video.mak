@@ -198,6 +198,11 @@ fate-interplay-mve-16bit: CMD = framecrc -i $(TARGET_SAMPLES)/interplay-mve/desc
 FATE_VIDEO-$(call DEMDEC, MXF, JPEG2000) += fate-jpeg2000-dcinema
 fate-jpeg2000-dcinema: CMD = framecrc -flags +bitexact -c:v jpeg2000 -i $(TARGET_SAMPLES)/jpeg2000/chiens_dcinema2K.mxf -pix_fmt xyz12le -vf scale
 
+# HTJ2K codestream of the ITU-T T.803 conformance set, from an external encoder
+FATE_VIDEO-$(call DEMDEC, IMAGE_J2K_PIPE, JPEG2000) += fate-jpeg2000-htj2k-ds0_ht_01_b11
+fate-jpeg2000-htj2k-ds0_ht_01_b11: CMD = framecrc -xerror -flags +bitexact -i $(TARGET_SAMPLES)/jpeg2000/itu-iso/htj2k_bsets_profile0/ds0_ht_01_b11.j2k
+fate-jpeg2000-htj2k-ds0_ht_01_b11: CMP = null
+
 FATE_VIDEO-$(call DEMDEC, JV, JV) += fate-jv
 fate-jv: CMD = framecrc -i $(TARGET_SAMPLES)/jv/intro.jv -an -pix_fmt rgb24 -vf scale
 
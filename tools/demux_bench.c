@@ -0,0 +1,814 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Throughput benchmark of demuxers
+ *
+ * Generates a sample file for each registered benchmark with the native
+ * encoders and muxers, or loads it from a cache directory, and demuxes it
+ * from memory, so that the results do not depend on the storage. Files
+ * given with -i are benchmarked the same way, with the probed demuxer. The
+ * time taken to open the file and to find the stream information, the
+ * packets and bytes demuxed per second and the allocations per packet are
+ * printed as JSON, to be compared across commits.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/file.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define FRAME_RATE     24
+#define SAMPLE_RATE    48000
+#define IMF_RESOURCES  4
+#define MAX_FILES      64
+#define MAX_INPUTS     16
+#define IO_BUFFER_SIZE 32768
+
+typedef struct DemuxBench {
+    const char *name;
+    const char *muxer;
+    const char *demuxer;
+    const char *muxer_opts;
+    enum AVCodecID video_codec;
+    enum AVPixelFormat pix_fmt;
+    int width, height;
+    enum AVCodecID audio_codec;
+    int imf;          /**< Wrap the MXF file in an IMF composition */
+} DemuxBench;
+
+static const DemuxBench benchs[] = {
+    { "mxf_j2k",        "mxf",        "mxf",      NULL,
+      AV_CODEC_ID_JPEG2000,   AV_PIX_FMT_YUV444P, 128, 128, AV_CODEC_ID_PCM_S24LE },
+    { "mxf_opatom_pcm", "mxf_opatom", "mxf",      "mxf_audio_edit_rate=24",
+      AV_CODEC_ID_NONE,       AV_PIX_FMT_NONE,      0,   0, AV_CODEC_ID_PCM_S24LE },
+    { "imf",            "mxf",        "imf",      NULL,
+      AV_CODEC_ID_JPEG2000,   AV_PIX_FMT_YUV444P, 128, 128, AV_CODEC_ID_NONE, 1 },
+    { "mov",            "mov",        "mov",      NULL,
+      AV_CODEC_ID_MPEG4,      AV_PIX_FMT_YUV420P, 320, 240, AV_CODEC_ID_PCM_S16LE },
+    { "mp4_frag",       "mp4",        "mov",      "movflags=frag_keyframe+empty_moov",
+      AV_CODEC_ID_MPEG4,      AV_PIX_FMT_YUV420P, 320, 240, AV_CODEC_ID_NONE },
+    { "matroska",       "matroska",   "matroska", NULL,
+      AV_CODEC_ID_MPEG4,      AV_PIX_FMT_YUV420P, 320, 240, AV_CODEC_ID_PCM_S16LE },
+    { "nut",            "nut",        "nut",      NULL,
+      AV_CODEC_ID_MPEG4,      AV_PIX_FMT_YUV420P, 320, 240, AV_CODEC_ID_PCM_S16LE },
+    { "mpegts",         "mpegts",     "mpegts",   NULL,
+      AV_CODEC_ID_MPEG2VIDEO, AV_PIX_FMT_YUV420P, 320, 240, AV_CODEC_ID_MP2 },
+};
+
+typedef struct BenchParams {
+    const char *dir;  /**< Cache directory of the samples, or NULL */
+    const char *bench;
+    const char *inputs[MAX_INPUTS];
+    int nb_inputs;
+    int duration;     /**< Duration of the samples, in frames */
+    int runs;         /**< Runs of each benchmark, the best one is reported */
+} BenchParams;
+
+typedef struct BenchResult {
+    int64_t size;
+    int64_t packets;
+    int64_t open_time;
+    int64_t probe_time;
+    int64_t read_time;
+    int64_t allocs;   /**< Allocations while reading, -1 if not accounted */
+} BenchResult;
+
+/**
+ * The files the demuxers are run on, looked up by the last component of
+ * their URL.
+ */
+typedef struct MemFile {
+    char name[64];
+    uint8_t *data;
+    int64_t size;
+} MemFile;
+
+static MemFile files[MAX_FILES];
+static int nb_files;
+
+/* An open MemFile, or a file being written when growing */
+typedef struct MemIO {
+    MemFile *file;
+    int64_t pos;
+    int64_t allocated;
+} MemIO;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: demux_bench [options] [directory]\n"
+            "Benchmarks demuxers on generated samples read from memory. The samples\n"
+            "are cached in directory if given, and reused by the next runs.\n"
+            "Options:\n"
+            "    -b name        only run the benchmarks whose name contains name\n"
+            "    -d duration    duration of the samples, in frames (default 240)\n"
+            "    -n runs        runs of each benchmark, the best one is reported (default 3)\n"
+            "    -i file        benchmark file, may be repeated; the registered\n"
+            "                   benchmarks then only run if -b is given\n"
+            "    -l             list the benchmarks\n"
+            );
+    exit(ret);
+}
+
+static MemFile *find_file(const char *url)
+{
+    const char *name = strrchr(url, '/');
+
+    name = name ? name + 1 : url;
+    for (int i = 0; i < nb_files; i++)
+        if (!strcmp(files[i].name, name))
+            return &files[i];
+    return NULL;
+}
+
+static MemFile *add_file(const char *name)
+{
+    MemFile *f = find_file(name);
+
+    if (f) {
+        av_freep(&f->data);
+        f->size = 0;
+        return f;
+    }
+    if (nb_files == MAX_FILES)
+        return NULL;
+    f = &files[nb_files++];
+    av_strlcpy(f->name, name, sizeof(f->name));
+    f->size = 0;
+    return f;
+}
+
+static void free_files(void)
+{
+    for (int i = 0; i < nb_files; i++) {
+        av_freep(&files[i].data);
+        files[i].size = 0;
+    }
+    nb_files = 0;
+}
+
+static int mem_read(void *opaque, uint8_t *buf, int size)
+{
+    MemIO *io = opaque;
+
+    size = FFMIN(size, io->file->size - io->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, io->file->data + io->pos, size);
+    io->pos += size;
+    return size;
+}
+
+static int mem_write(void *opaque, uint8_t *buf, int size)
+{
+    MemIO *io = opaque;
+    MemFile *f = io->file;
+
+    if (io->pos + size > io->allocated) {
+        int64_t allocated = FFMAX(io->pos + size, 2 * io->allocated);
+        uint8_t *data = av_realloc(f->data, allocated);
+        if (!data)
+            return AVERROR(ENOMEM);
+        f->data = data;
+        io->allocated = allocated;
+    }
+    if (io->pos > f->size)
+        memset(f->data + f->size, 0, io->pos - f->size);
+    memcpy(f->data + io->pos, buf, size);
+    io->pos += size;
+    f->size = FFMAX(f->size, io->pos);
+    return size;
+}
+
+static int64_t mem_seek(void *opaque, int64_t offset, int whence)
+{
+    MemIO *io = opaque;
+
+    switch (whence) {
+    case AVSEEK_SIZE: return io->file->size;
+    case SEEK_SET:                           break;
+    case SEEK_CUR:    offset += io->pos;     break;
+    case SEEK_END:    offset += io->file->size; break;
+    default:          return AVERROR(EINVAL);
+    }
+    if (offset < 0)
+        return AVERROR(EINVAL);
+    return io->pos = offset;
+}
+
+static int mem_open(MemFile *f, int write, AVIOContext **pb)
+{
+    MemIO *io = av_mallocz(sizeof(*io));
+    uint8_t *buf = av_malloc(IO_BUFFER_SIZE);
+
+    if (!io || !buf)
+        goto fail;
+    io->file = f;
+    *pb = avio_alloc_context(buf, IO_BUFFER_SIZE, write, io,
+                             write ? NULL : mem_read, write ? mem_write : NULL, mem_seek);
+    if (!*pb)
+        goto fail;
+    return 0;
+fail:
+    av_free(io);
+    av_free(buf);
+    return AVERROR(ENOMEM);
+}
+
+static void mem_close(AVIOContext **pb)
+{
+    if (!*pb)
+        return;
+    avio_flush(*pb);
+    av_freep(&(*pb)->opaque);
+    av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+}
+
+static int mem_io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                       int flags, AVDictionary **options)
+{
+    MemFile *f = find_file(url);
+
+    if (!f || (flags & AVIO_FLAG_WRITE))
+        return AVERROR(ENOENT);
+    return mem_open(f, 0, pb);
+}
+
+static void mem_io_close(AVFormatContext *s, AVIOContext *pb)
+{
+    mem_close(&pb);
+}
+
+/**
+ * Loads a file to memory under the name of the last component of its path.
+ */
+static int load_file(const char *path, const char *name)
+{
+    MemFile *f;
+    uint8_t *data;
+    size_t size;
+    int ret;
+
+    if ((ret = av_file_map(path, &data, &size, 0, NULL)) < 0)
+        return ret;
+    if (!(f = add_file(name)) || !(f->data = av_malloc(FFMAX(size, 1)))) {
+        av_file_unmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+    memcpy(f->data, data, size);
+    f->size = size;
+    av_file_unmap(data, size);
+    return 0;
+}
+
+static int save_file(const MemFile *f, const char *path)
+{
+    AVIOContext *pb;
+    int ret;
+
+    if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+    avio_write(pb, f->data, f->size);
+    return avio_closep(&pb);
+}
+
+static AVCodecContext *open_encoder(const DemuxBench *b, int audio, AVFormatContext *oc)
+{
+    const AVCodec *codec = avcodec_find_encoder(audio ? b->audio_codec : b->video_codec);
+    AVCodecContext *enc;
+    AVStream *st;
+
+    if (!codec) {
+        fprintf(stderr, "Missing %s encoder\n",
+                avcodec_get_name(audio ? b->audio_codec : b->video_codec));
+        return NULL;
+    }
+    if (!(enc = avcodec_alloc_context3(codec)) || !(st = avformat_new_stream(oc, NULL))) {
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+
+    if (audio) {
+        enc->sample_fmt     = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+        enc->sample_rate    = SAMPLE_RATE;
+        enc->time_base      = (AVRational){ 1, SAMPLE_RATE };
+        enc->channels       = 1;
+        enc->channel_layout = AV_CH_LAYOUT_MONO;
+    } else {
+        enc->pix_fmt   = b->pix_fmt;
+        enc->width     = b->width;
+        enc->height    = b->height;
+        enc->time_base = (AVRational){ 1, FRAME_RATE };
+        enc->framerate = (AVRational){ FRAME_RATE, 1 };
+        enc->gop_size  = FRAME_RATE;
+    }
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(enc, codec, NULL) < 0 ||
+        avcodec_parameters_from_context(st->codecpar, enc) < 0) {
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    st->time_base = enc->time_base;
+    return enc;
+}
+
+static int encode_and_write(AVFormatContext *oc, AVCodecContext *enc, int index,
+                            AVFrame *frame, AVPacket *pkt)
+{
+    int ret = avcodec_send_frame(enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(enc, pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+        av_packet_rescale_ts(pkt, enc->time_base, oc->streams[index]->time_base);
+        pkt->stream_index = index;
+        ret = av_interleaved_write_frame(oc, pkt);
+    }
+    return ret;
+}
+
+static void fill_frame(AVFrame *frame, int audio, int64_t n)
+{
+    if (audio) {
+        for (int c = 0; c < frame->channels; c++) {
+            uint8_t *samples = frame->extended_data[av_sample_fmt_is_planar(frame->format) ? c : 0];
+            int size = av_samples_get_buffer_size(NULL, av_sample_fmt_is_planar(frame->format) ?
+                                                  1 : frame->channels,
+                                                  frame->nb_samples, frame->format, 1);
+            for (int i = 0; i < size; i++)
+                samples[i] = (uint8_t)((n + i) * 2654435761u >> 24) & 0x3F;
+        }
+    } else {
+        for (int p = 0; p < 3; p++) {
+            int h = p ? AV_CEIL_RSHIFT(frame->height, frame->format == AV_PIX_FMT_YUV420P) : frame->height;
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < frame->linesize[p]; x++)
+                    frame->data[p][y * frame->linesize[p] + x] = (x * (p + 1) + y + n * 4) & 0xFF;
+        }
+    }
+}
+
+/**
+ * Writes the sample of a benchmark to the file name in memory: duration
+ * frames of video and the audio of the same duration.
+ */
+static int write_sample(const DemuxBench *b, const char *name, int duration)
+{
+    AVFormatContext *oc = NULL;
+    AVCodecContext *enc[2] = { NULL };
+    AVFrame *frame[2] = { NULL };
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    MemFile *f;
+    int64_t n[2] = { 0 };
+    int nb_streams = 0, ret;
+
+    if (!(f = add_file(name)))
+        return AVERROR(ENOMEM);
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, b->muxer, name)) < 0)
+        return ret;
+    if (b->muxer_opts && (ret = av_dict_parse_string(&opts, b->muxer_opts, "=", ":", 0)) < 0)
+        goto end;
+    for (int audio = 0; audio < 2; audio++) {
+        if ((audio ? b->audio_codec : b->video_codec) == AV_CODEC_ID_NONE)
+            continue;
+        enc[audio] = open_encoder(b, audio, oc);
+        frame[audio] = av_frame_alloc();
+        if (!enc[audio] || !frame[audio]) {
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if (audio) {
+            frame[1]->format         = enc[1]->sample_fmt;
+            frame[1]->channels       = enc[1]->channels;
+            frame[1]->channel_layout = enc[1]->channel_layout;
+            frame[1]->nb_samples     = enc[1]->frame_size ? enc[1]->frame_size :
+                                                            SAMPLE_RATE / FRAME_RATE;
+        } else {
+            frame[0]->format = enc[0]->pix_fmt;
+            frame[0]->width  = enc[0]->width;
+            frame[0]->height = enc[0]->height;
+        }
+        if ((ret = av_frame_get_buffer(frame[audio], 0)) < 0)
+            goto end;
+    }
+    if (!(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if ((ret = mem_open(f, 1, &oc->pb)) < 0 ||
+        (ret = avformat_write_header(oc, &opts)) < 0)
+        goto end;
+
+    /* video frames and audio samples, in the order of their timestamps */
+    for (;;) {
+        int audio = !enc[0] || (enc[1] && n[1] * FRAME_RATE < n[0] * SAMPLE_RATE);
+        int index = audio && enc[0];
+
+        if (audio ? n[1] >= (int64_t)duration * SAMPLE_RATE / FRAME_RATE : n[0] >= duration)
+            break;
+        if ((ret = av_frame_make_writable(frame[audio])) < 0)
+            goto end;
+        fill_frame(frame[audio], audio, n[audio]);
+        frame[audio]->pts = n[audio];
+        n[audio] += audio ? frame[1]->nb_samples : 1;
+        if ((ret = encode_and_write(oc, enc[audio], index, frame[audio], pkt)) < 0)
+            goto end;
+    }
+    for (int audio = 0; audio < 2; audio++)
+        if (enc[audio] &&
+            (ret = encode_and_write(oc, enc[audio], nb_streams++, NULL, pkt)) < 0)
+            goto end;
+
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc)
+        mem_close(&oc->pb);
+    avformat_free_context(oc);
+    for (int i = 0; i < 2; i++) {
+        avcodec_free_context(&enc[i]);
+        av_frame_free(&frame[i]);
+    }
+    av_packet_free(&pkt);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Could not write the %s sample: %s\n", b->name, av_err2str(ret));
+    return ret;
+}
+
+static void print_uuid(AVIOContext *pb, unsigned type, unsigned index)
+{
+    avio_printf(pb, "urn:uuid:%08x-0000-4000-8000-%012x", type, index);
+}
+
+static int close_dyn_file(AVIOContext *pb, const char *name)
+{
+    MemFile *f = add_file(name);
+    uint8_t *data;
+    int size = avio_close_dyn_buf(pb, &data);
+
+    if (!f) {
+        av_free(data);
+        return AVERROR(ENOMEM);
+    }
+    f->data = data;
+    f->size = size;
+    return 0;
+}
+
+/**
+ * Writes a composition of IMF_RESOURCES resources of the track file
+ * track_file, and its asset map.
+ */
+static int write_composition(const char *name, const char *track_file, int duration)
+{
+    AVIOContext *pb;
+    int ret;
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+    avio_printf(pb,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<AssetMap xmlns=\"http://www.smpte-ra.org/schemas/429-9/2007/AM\">\n<Id>");
+    print_uuid(pb, 0xA55E7000, 0);
+    avio_printf(pb, "</Id>\n<AssetList>\n<Asset><Id>");
+    print_uuid(pb, 1, 0);
+    avio_printf(pb,
+        "</Id><ChunkList><Chunk><Path>%s</Path></Chunk></ChunkList></Asset>\n"
+        "</AssetList>\n</AssetMap>\n", track_file);
+    if ((ret = close_dyn_file(pb, "ASSETMAP.xml")) < 0)
+        return ret;
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+    avio_printf(pb,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<CompositionPlaylist xmlns=\"http://www.smpte-ra.org/schemas/2067-3/2016\""
+        " xmlns:cc=\"http://www.smpte-ra.org/schemas/2067-2/2016\""
+        " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n<Id>");
+    print_uuid(pb, 0xC9100000, 0);
+    avio_printf(pb,
+        "</Id>\n<ContentTitle>demux_bench</ContentTitle>\n<EditRate>%d 1</EditRate>\n"
+        "<SegmentList>\n<Segment>\n<Id>", FRAME_RATE);
+    print_uuid(pb, 0x5E600000, 0);
+    avio_printf(pb, "</Id>\n<SequenceList>\n<cc:MainImageSequence>\n<Id>");
+    print_uuid(pb, 0x5E900000, 0);
+    avio_printf(pb, "</Id>\n<TrackId>");
+    print_uuid(pb, 0x77ACC000, 0);
+    avio_printf(pb, "</TrackId>\n<ResourceList>\n");
+    for (int i = 0; i < IMF_RESOURCES; i++) {
+        avio_printf(pb, "<Resource xsi:type=\"TrackFileResourceType\"><Id>");
+        print_uuid(pb, 0x7E500000, i);
+        avio_printf(pb, "</Id><IntrinsicDuration>%d</IntrinsicDuration><TrackFileId>", duration);
+        print_uuid(pb, 1, 0);
+        avio_printf(pb, "</TrackFileId></Resource>\n");
+    }
+    avio_printf(pb,
+        "</ResourceList>\n</cc:MainImageSequence>\n</SequenceList>\n"
+        "</Segment>\n</SegmentList>\n</CompositionPlaylist>\n");
+    return close_dyn_file(pb, name);
+}
+
+/**
+ * Makes the files of a benchmark available in memory, from the cache
+ * directory or by generating them, and returns the name of the one to
+ * demux.
+ */
+static int prepare_bench(const BenchParams *p, const DemuxBench *b,
+                         char *name, int name_size)
+{
+    char track_file[64], path[1024];
+    const char *names[3];
+    int nb_names = 0, cached = 1, ret;
+
+    snprintf(track_file, sizeof(track_file), "%s_%d.%s", b->name, p->duration,
+             b->imf ? "mxf" : "dat");
+    names[nb_names++] = track_file;
+    if (b->imf) {
+        snprintf(name, name_size, "%s_%d_CPL.xml", b->name, p->duration);
+        names[nb_names++] = name;
+        names[nb_names++] = "ASSETMAP.xml";
+    } else {
+        av_strlcpy(name, track_file, name_size);
+    }
+
+    for (int i = 0; i < nb_names && p->dir && cached; i++) {
+        snprintf(path, sizeof(path), "%s/%s", p->dir, names[i]);
+        cached = load_file(path, names[i]) >= 0;
+    }
+    if (p->dir && cached)
+        return 0;
+
+    if ((ret = write_sample(b, track_file, p->duration)) < 0)
+        return ret;
+    if (b->imf && (ret = write_composition(name, track_file, p->duration)) < 0)
+        return ret;
+
+    for (int i = 0; i < nb_names && p->dir; i++) {
+        snprintf(path, sizeof(path), "%s/%s", p->dir, names[i]);
+        if ((ret = save_file(find_file(names[i]), path)) < 0) {
+            fprintf(stderr, "Could not write %s: %s\n", path, av_err2str(ret));
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int64_t total_allocs(void)
+{
+    AVMemComponentStats *stats;
+    int64_t allocs;
+    int nb = av_mem_accounting_get_stats(&stats);
+
+    if (nb <= 0)
+        return -1;
+    allocs = stats[nb - 1].nb_allocs;
+    av_free(stats);
+    return allocs;
+}
+
+static int run_once(const char *name, const char *demuxer, BenchResult *r)
+{
+    const AVInputFormat *fmt = NULL;
+    AVFormatContext *avf;
+    AVIOContext *pb = NULL;
+    AVPacket *pkt = NULL;
+    int64_t start, allocs;
+    int ret;
+
+    if (demuxer && !(fmt = av_find_input_format(demuxer)))
+        return AVERROR_DEMUXER_NOT_FOUND;
+    if (!(avf = avformat_alloc_context()))
+        return AVERROR(ENOMEM);
+    /* the files referenced by the demuxed one are also read from memory */
+    avf->io_open  = mem_io_open;
+    avf->io_close = mem_io_close;
+
+    memset(r, 0, sizeof(*r));
+    r->size = find_file(name)->size;
+
+    start = av_gettime_relative();
+    if ((ret = mem_open(find_file(name), 0, &pb)) >= 0) {
+        avf->pb = pb;
+        ret = avformat_open_input(&avf, name, fmt, NULL);
+    }
+    r->open_time = av_gettime_relative() - start;
+    if (ret < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", name, av_err2str(ret));
+        avformat_free_context(avf);
+        mem_close(&pb);
+        return ret;
+    }
+
+    start = av_gettime_relative();
+    ret = avformat_find_stream_info(avf, NULL);
+    r->probe_time = av_gettime_relative() - start;
+    if (ret < 0) {
+        fprintf(stderr, "Could not find the stream information of %s: %s\n",
+                name, av_err2str(ret));
+        goto end;
+    }
+
+    if (!(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    allocs = total_allocs();
+    start = av_gettime_relative();
+    while ((ret = av_read_frame(avf, pkt)) >= 0) {
+        r->packets++;
+        av_packet_unref(pkt);
+    }
+    r->read_time = av_gettime_relative() - start;
+    r->allocs = allocs < 0 ? -1 : total_allocs() - allocs;
+    if (ret != AVERROR_EOF) {
+        fprintf(stderr, "Could not read a packet of %s: %s\n", name, av_err2str(ret));
+        goto end;
+    }
+    ret = 0;
+
+end:
+    av_packet_free(&pkt);
+    avformat_close_input(&avf);
+    mem_close(&pb);
+    return ret;
+}
+
+/**
+ * Runs a benchmark p->runs times, and keeps the shortest times of each
+ * step.
+ */
+static int run_bench(const BenchParams *p, const char *name, const char *demuxer,
+                     BenchResult *best)
+{
+    for (int i = 0; i < p->runs; i++) {
+        BenchResult r;
+        int ret = run_once(name, demuxer, &r);
+
+        if (ret < 0)
+            return ret;
+        if (!i) {
+            *best = r;
+            continue;
+        }
+        best->open_time  = FFMIN(best->open_time,  r.open_time);
+        best->probe_time = FFMIN(best->probe_time, r.probe_time);
+        best->read_time  = FFMIN(best->read_time,  r.read_time);
+    }
+    return 0;
+}
+
+static void print_result(const char *name, const char *demuxer, const BenchResult *r,
+                         int first)
+{
+    double t = FFMAX(r->read_time, 1) / 1e6;
+
+    printf("%s    {\n", first ? "" : ",\n");
+    printf("      \"name\": \"%s\",\n", name);
+    printf("      \"demuxer\": \"%s\",\n", demuxer ? demuxer : "probed");
+    printf("      \"bytes\": %"PRId64",\n", r->size);
+    printf("      \"packets\": %"PRId64",\n", r->packets);
+    printf("      \"open_us\": %"PRId64",\n", r->open_time);
+    printf("      \"find_stream_info_us\": %"PRId64",\n", r->probe_time);
+    printf("      \"read_us\": %"PRId64",\n", r->read_time);
+    printf("      \"packets_per_s\": %.1f,\n", r->packets / t);
+    printf("      \"mb_per_s\": %.3f,\n", r->size / t / (1 << 20));
+    if (r->allocs >= 0)
+        printf("      \"allocs_per_packet\": %.3f\n",
+               r->packets ? (double)r->allocs / r->packets : 0.0);
+    else
+        printf("      \"allocs_per_packet\": null\n");
+    printf("    }");
+    fflush(stdout);
+}
+
+static int run_benchs(const BenchParams *p)
+{
+    char name[64];
+    int first = 1, ret = 0;
+
+    /* allocations are counted if accounting is built in */
+    av_mem_accounting_start();
+
+    printf("{\n  \"duration\": %d,\n  \"runs\": %d,\n  \"results\": [\n",
+           p->duration, p->runs);
+    for (int i = 0; i < FF_ARRAY_ELEMS(benchs) && ret >= 0; i++) {
+        const DemuxBench *b = &benchs[i];
+        BenchResult r;
+
+        if ((p->bench && !strstr(b->name, p->bench)) || p->nb_inputs && !p->bench)
+            continue;
+        if (!av_guess_format(b->muxer, NULL, NULL) || !av_find_input_format(b->demuxer)) {
+            fprintf(stderr, "Skipping %s: missing muxer or demuxer\n", b->name);
+            continue;
+        }
+
+        if ((ret = prepare_bench(p, b, name, sizeof(name))) < 0 ||
+            (ret = run_bench(p, name, b->demuxer, &r)) < 0)
+            break;
+        print_result(b->name, b->demuxer, &r, first);
+        first = 0;
+        free_files();
+    }
+    for (int i = 0; i < p->nb_inputs && ret >= 0; i++) {
+        const char *base = strrchr(p->inputs[i], '/');
+        BenchResult r;
+
+        base = base ? base + 1 : p->inputs[i];
+        if ((ret = load_file(p->inputs[i], base)) < 0) {
+            fprintf(stderr, "Could not read %s: %s\n", p->inputs[i], av_err2str(ret));
+            break;
+        }
+        if ((ret = run_bench(p, base, NULL, &r)) < 0)
+            break;
+        print_result(base, NULL, &r, first);
+        first = 0;
+        free_files();
+    }
+    printf("\n  ]\n}\n");
+
+    free_files();
+    av_mem_accounting_stop();
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    BenchParams p = {
+        .duration = 240,
+        .runs     = 3,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hlb:d:n:i:")) != -1) {
+        switch (opt) {
+        case 'b': p.bench    = optarg; break;
+        case 'd': p.duration = atoi(optarg); break;
+        case 'n': p.runs     = atoi(optarg); break;
+        case 'i':
+            if (p.nb_inputs == MAX_INPUTS)
+                usage(1);
+            p.inputs[p.nb_inputs++] = optarg;
+            break;
+        case 'l':
+            for (int i = 0; i < FF_ARRAY_ELEMS(benchs); i++)
+                printf("%s\n", benchs[i].name);
+            return 0;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 1 < argc || p.duration < 1 || p.runs < 1)
+        usage(1);
+    p.dir = optind < argc ? argv[optind] : NULL;
+
+    /* the samples are muxed and demuxed many times, keep the library
+     * quiet and report failures from the tool itself */
+    av_log_set_level(AV_LOG_FATAL);
+
+    return run_benchs(&p) < 0;
+}
@@ -0,0 +1,468 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Benchmark of the IMF demuxer on synthetic packages
+ *
+ * Generates a Composition Playlist with the requested number of resources,
+ * repeats and audio tracks, and its Asset Maps, backed by two small MXF track
+ * files. Then measures the time taken to open the composition, the cost of
+ * demuxing each packet, the latency of seeks and the peak resident set size.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#if HAVE_GETRUSAGE
+#include <sys/resource.h>
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define EDIT_RATE          24
+#define SAMPLE_RATE        48000
+#define SAMPLES_PER_FRAME  (SAMPLE_RATE / EDIT_RATE)
+
+typedef struct BenchParams {
+    const char *dir;
+    int resources;    /**< Resources per virtual track */
+    int repeats;      /**< RepeatCount of each resource */
+    int audio_tracks; /**< Main audio virtual tracks */
+    int asset_maps;   /**< Asset maps the assets are spread over */
+    int duration;     /**< Duration of the track files, in edit units */
+    int seeks;        /**< Number of random seeks */
+    int64_t packets;  /**< Maximum number of packets to read, 0 for all */
+    const char *demuxer_opts;
+} BenchParams;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: imf_bench [options] directory\n"
+            "Generates a synthetic IMF package in directory and benchmarks its demuxing.\n"
+            "Options:\n"
+            "    -r resources   resources per virtual track (default 1000)\n"
+            "    -R repeats     RepeatCount of each resource (default 1)\n"
+            "    -a tracks      main audio virtual tracks (default 1)\n"
+            "    -m maps        asset maps the assets are spread over (default 1)\n"
+            "    -d duration    duration of the track files, in edit units (default 24)\n"
+            "    -s seeks       random seeks (default 100)\n"
+            "    -p packets     maximum number of packets to read (default all)\n"
+            "    -o options     demuxer options, as key=value:key=value\n"
+            );
+    exit(ret);
+}
+
+static void print_uuid(AVIOContext *pb, unsigned type, unsigned index)
+{
+    avio_printf(pb, "urn:uuid:%08x-0000-4000-8000-%012x", type, index);
+}
+
+static int encode_and_write(AVFormatContext *oc, AVCodecContext *enc, AVFrame *frame, AVPacket *pkt)
+{
+    int ret = avcodec_send_frame(enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(enc, pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+        av_packet_rescale_ts(pkt, enc->time_base, oc->streams[0]->time_base);
+        pkt->stream_index = 0;
+        ret = av_interleaved_write_frame(oc, pkt);
+    }
+    return ret;
+}
+
+/**
+ * Writes a track file of duration edit units, either of JPEG 2000 frames or of
+ * PCM samples.
+ */
+static int write_track_file(const char *path, int audio, int duration)
+{
+    const AVCodec *codec = avcodec_find_encoder(audio ? AV_CODEC_ID_PCM_S24LE : AV_CODEC_ID_JPEG2000);
+    AVFormatContext *oc = NULL;
+    AVCodecContext *enc = NULL;
+    AVDictionary *opts = NULL;
+    AVFrame *frame = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    int ret;
+
+    if (!codec) {
+        fprintf(stderr, "Missing %s encoder\n", audio ? "pcm_s24le" : "jpeg2000");
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, audio ? "mxf_opatom" : "mxf", path)) < 0)
+        return ret;
+    enc = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    pkt = av_packet_alloc();
+    st = avformat_new_stream(oc, NULL);
+    if (!enc || !frame || !pkt || !st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (audio) {
+        enc->sample_fmt = AV_SAMPLE_FMT_S32;
+        enc->sample_rate = SAMPLE_RATE;
+        enc->time_base = (AVRational){ 1, SAMPLE_RATE };
+        enc->channels = 1;
+        enc->channel_layout = AV_CH_LAYOUT_MONO;
+        av_dict_set(&opts, "mxf_audio_edit_rate", AV_STRINGIFY(EDIT_RATE), 0);
+    } else {
+        enc->pix_fmt = AV_PIX_FMT_YUV444P;
+        enc->width = 64;
+        enc->height = 64;
+        enc->time_base = (AVRational){ 1, EDIT_RATE };
+        enc->framerate = (AVRational){ EDIT_RATE, 1 };
+    }
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if ((ret = avcodec_open2(enc, codec, NULL)) < 0 ||
+        (ret = avcodec_parameters_from_context(st->codecpar, enc)) < 0)
+        goto end;
+    st->time_base = enc->time_base;
+
+    if ((ret = avio_open(&oc->pb, path, AVIO_FLAG_WRITE)) < 0 ||
+        (ret = avformat_write_header(oc, &opts)) < 0)
+        goto end;
+
+    if (audio) {
+        frame->format = enc->sample_fmt;
+        frame->nb_samples = SAMPLES_PER_FRAME;
+        frame->channel_layout = enc->channel_layout;
+    } else {
+        frame->format = enc->pix_fmt;
+        frame->width = enc->width;
+        frame->height = enc->height;
+    }
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+
+    for (int i = 0; i < duration; i++) {
+        if ((ret = av_frame_make_writable(frame)) < 0)
+            goto end;
+        if (audio) {
+            int32_t *samples = (int32_t *)frame->data[0];
+            for (int j = 0; j < SAMPLES_PER_FRAME; j++)
+                samples[j] = (int32_t)((i * SAMPLES_PER_FRAME + j) * 2654435761u) & 0xFFFFFF00;
+            frame->pts = (int64_t)i * SAMPLES_PER_FRAME;
+        } else {
+            for (int p = 0; p < 3; p++)
+                for (int y = 0; y < frame->height; y++)
+                    memset(frame->data[p] + y * frame->linesize[p], (i * 8 + y + p * 64) & 0xFF, frame->width);
+            frame->pts = i;
+        }
+        if ((ret = encode_and_write(oc, enc, frame, pkt)) < 0)
+            goto end;
+    }
+    if ((ret = encode_and_write(oc, enc, NULL, pkt)) < 0)
+        goto end;
+
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc && oc->pb)
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    avcodec_free_context(&enc);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Could not write %s: %s\n", path, av_err2str(ret));
+    return ret;
+}
+
+/**
+ * Writes the asset maps: asset i of track t goes to asset map i % asset_maps.
+ */
+static int write_asset_maps(const BenchParams *p)
+{
+    char path[1024];
+    AVIOContext *pb;
+    int ret;
+
+    for (int m = 0; m < p->asset_maps; m++) {
+        snprintf(path, sizeof(path), "%s/ASSETMAP%d.xml", p->dir, m);
+        if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+            return ret;
+
+        avio_printf(pb,
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<AssetMap xmlns=\"http://www.smpte-ra.org/schemas/429-9/2007/AM\">\n"
+            "<Id>");
+        print_uuid(pb, 0xA55E7000, m);
+        avio_printf(pb, "</Id>\n<AssetList>\n");
+        for (int t = 0; t <= p->audio_tracks; t++)
+            for (int i = m; i < p->resources; i += p->asset_maps) {
+                avio_printf(pb, "<Asset><Id>");
+                print_uuid(pb, 1 + t, i);
+                avio_printf(pb,
+                    "</Id><ChunkList><Chunk><Path>%s</Path></Chunk></ChunkList></Asset>\n",
+                    t ? "audio.mxf" : "video.mxf");
+            }
+        avio_printf(pb, "</AssetList>\n</AssetMap>\n");
+
+        avio_closep(&pb);
+    }
+
+    return 0;
+}
+
+static void write_sequence(AVIOContext *pb, const BenchParams *p, int track)
+{
+    avio_printf(pb, "<cc:%s>\n<Id>", track ? "MainAudioSequence" : "MainImageSequence");
+    print_uuid(pb, 0x5E900000, track);
+    avio_printf(pb, "</Id>\n<TrackId>");
+    print_uuid(pb, 0x77ACC000, track);
+    avio_printf(pb, "</TrackId>\n<ResourceList>\n");
+    for (int i = 0; i < p->resources; i++) {
+        avio_printf(pb, "<Resource xsi:type=\"TrackFileResourceType\"><Id>");
+        print_uuid(pb, 0x7E500000 + track, i);
+        avio_printf(pb, "</Id>");
+        if (track)
+            avio_printf(pb, "<EditRate>%d 1</EditRate><IntrinsicDuration>%d</IntrinsicDuration>",
+                SAMPLE_RATE, p->duration * SAMPLES_PER_FRAME);
+        else
+            avio_printf(pb, "<IntrinsicDuration>%d</IntrinsicDuration>", p->duration);
+        if (p->repeats > 1)
+            avio_printf(pb, "<RepeatCount>%d</RepeatCount>", p->repeats);
+        avio_printf(pb, "<TrackFileId>");
+        print_uuid(pb, 1 + track, i);
+        avio_printf(pb, "</TrackFileId></Resource>\n");
+    }
+    avio_printf(pb, "</ResourceList>\n</cc:%s>\n", track ? "MainAudioSequence" : "MainImageSequence");
+}
+
+static int write_cpl(const BenchParams *p)
+{
+    char path[1024];
+    AVIOContext *pb;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/CPL.xml", p->dir);
+    if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+
+    avio_printf(pb,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<CompositionPlaylist xmlns=\"http://www.smpte-ra.org/schemas/2067-3/2016\""
+        " xmlns:cc=\"http://www.smpte-ra.org/schemas/2067-2/2016\""
+        " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+        "<Id>");
+    print_uuid(pb, 0xC9100000, 0);
+    avio_printf(pb,
+        "</Id>\n<ContentTitle>imf_bench</ContentTitle>\n<EditRate>%d 1</EditRate>\n"
+        "<SegmentList>\n<Segment>\n<Id>", EDIT_RATE);
+    print_uuid(pb, 0x5E600000, 0);
+    avio_printf(pb, "</Id>\n<SequenceList>\n");
+    for (int t = 0; t <= p->audio_tracks; t++)
+        write_sequence(pb, p, t);
+    avio_printf(pb, "</SequenceList>\n</Segment>\n</SegmentList>\n</CompositionPlaylist>\n");
+
+    avio_closep(&pb);
+    return 0;
+}
+
+static int generate_package(const BenchParams *p)
+{
+    char path[1024];
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/video.mxf", p->dir);
+    if ((ret = write_track_file(path, 0, p->duration)) < 0)
+        return ret;
+    snprintf(path, sizeof(path), "%s/audio.mxf", p->dir);
+    if ((ret = write_track_file(path, 1, p->duration)) < 0)
+        return ret;
+    if ((ret = write_asset_maps(p)) < 0)
+        return ret;
+    return write_cpl(p);
+}
+
+static int64_t peak_rss_kb(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return rusage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+static int run_bench(const BenchParams *p)
+{
+    AVFormatContext *avf = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    AVBPrint asset_maps;
+    char path[1024];
+    int64_t start, open_time, probe_time, read_time, seek_time = 0, seek_max = 0;
+    int64_t packet_count = 0, duration;
+    AVLFG lfg;
+    int ret;
+
+    if (p->demuxer_opts && (ret = av_dict_parse_string(&opts, p->demuxer_opts, "=", ":", 0)) < 0) {
+        fprintf(stderr, "Invalid demuxer options %s\n", p->demuxer_opts);
+        return ret;
+    }
+
+    av_bprint_init(&asset_maps, 0, AV_BPRINT_SIZE_UNLIMITED);
+    for (int m = 0; m < p->asset_maps; m++)
+        av_bprintf(&asset_maps, "%s%s/ASSETMAP%d.xml", m ? "," : "", p->dir, m);
+    if (!av_bprint_is_complete(&asset_maps)) {
+        av_bprint_finalize(&asset_maps, NULL);
+        av_dict_free(&opts);
+        return AVERROR(ENOMEM);
+    }
+    av_dict_set(&opts, "assetmaps", asset_maps.str, 0);
+    av_bprint_finalize(&asset_maps, NULL);
+
+    snprintf(path, sizeof(path), "%s/CPL.xml", p->dir);
+    start = av_gettime_relative();
+    ret = avformat_open_input(&avf, path, av_find_input_format("imf"), &opts);
+    open_time = av_gettime_relative() - start;
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", path, av_err2str(ret));
+        return ret;
+    }
+
+    start = av_gettime_relative();
+    ret = avformat_find_stream_info(avf, NULL);
+    probe_time = av_gettime_relative() - start;
+    if (ret < 0) {
+        fprintf(stderr, "Could not find stream information: %s\n", av_err2str(ret));
+        goto end;
+    }
+    duration = avf->duration;
+
+    if (!(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    start = av_gettime_relative();
+    while ((!p->packets || packet_count < p->packets) && (ret = av_read_frame(avf, pkt)) >= 0) {
+        packet_count++;
+        av_packet_unref(pkt);
+    }
+    read_time = av_gettime_relative() - start;
+    if (ret < 0 && ret != AVERROR_EOF) {
+        fprintf(stderr, "Could not read packet: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    av_lfg_init(&lfg, 0x1AF);
+    for (int i = 0; i < p->seeks && duration > 0; i++) {
+        int64_t ts = av_rescale(av_lfg_get(&lfg), duration, UINT32_MAX);
+        int64_t t;
+
+        start = av_gettime_relative();
+        ret = avformat_seek_file(avf, -1, INT64_MIN, ts, INT64_MAX, 0);
+        if (ret >= 0)
+            ret = av_read_frame(avf, pkt);
+        t = av_gettime_relative() - start;
+        av_packet_unref(pkt);
+        if (ret < 0) {
+            fprintf(stderr, "Could not seek to %"PRId64": %s\n", ts, av_err2str(ret));
+            goto end;
+        }
+        seek_time += t;
+        seek_max = FFMAX(seek_max, t);
+    }
+    ret = 0;
+
+    printf("resources:       %d x %d track(s), repeat %d\n",
+        p->resources, 1 + p->audio_tracks, p->repeats);
+    printf("open time:       %"PRId64" us\n", open_time);
+    printf("probe time:      %"PRId64" us\n", probe_time);
+    printf("packets:         %"PRId64"\n", packet_count);
+    printf("packet time:     %.3f us\n", packet_count ? (double)read_time / packet_count : 0.0);
+    if (p->seeks && duration > 0)
+        printf("seek time:       %.1f us (max %"PRId64" us)\n", (double)seek_time / p->seeks, seek_max);
+    printf("peak rss:        %"PRId64" kB\n", peak_rss_kb());
+
+end:
+    av_packet_free(&pkt);
+    avformat_close_input(&avf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    BenchParams p = {
+        .resources    = 1000,
+        .repeats      = 1,
+        .audio_tracks = 1,
+        .asset_maps   = 1,
+        .duration     = 24,
+        .seeks        = 100,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hr:R:a:m:d:s:p:o:")) != -1) {
+        switch (opt) {
+        case 'r': p.resources    = atoi(optarg); break;
+        case 'R': p.repeats      = atoi(optarg); break;
+        case 'a': p.audio_tracks = atoi(optarg); break;
+        case 'm': p.asset_maps   = atoi(optarg); break;
+        case 'd': p.duration     = atoi(optarg); break;
+        case 's': p.seeks        = atoi(optarg); break;
+        case 'p': p.packets      = strtoll(optarg, NULL, 10); break;
+        case 'o': p.demuxer_opts = optarg; break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 1 != argc || p.resources < 1 || p.repeats < 1 || p.audio_tracks < 0 ||
+        p.asset_maps < 1 || p.duration < 1 || p.seeks < 0 || p.packets < 0)
+        usage(1);
+    p.dir = argv[optind];
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    if (generate_package(&p) < 0 || run_bench(&p) < 0)
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Checks an IMF package without reading its essence
+ *
+ * Opens a Composition Playlist with the imf_check option of the IMF demuxer,
+ * which resolves all the resources in the asset maps and opens all the track
+ * files concurrently, reading only their MXF header metadata.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/dict.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: imf_check [options] CPL\n"
+            "Options:\n"
+            "    -a assetmaps   comma-separated paths to the ASSETMAP files\n"
+            "    -t threads     number of track files opened concurrently (default 8)\n"
+            "    -v             print the progress of the checks\n"
+            );
+    exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *avf = NULL;
+    AVDictionary *opts = NULL;
+    const char *asset_maps = NULL;
+    const char *threads = "8";
+    int64_t start;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "ha:t:v")) != -1) {
+        switch (opt) {
+        case 'a':
+            asset_maps = optarg;
+            break;
+        case 't':
+            threads = optarg;
+            break;
+        case 'v':
+            av_log_set_level(AV_LOG_VERBOSE);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 1 != argc)
+        usage(1);
+
+    av_dict_set(&opts, "imf_check", "1", 0);
+    av_dict_set(&opts, "imf_open_threads", threads, 0);
+    if (asset_maps)
+        av_dict_set(&opts, "assetmaps", asset_maps, 0);
+
+    start = av_gettime_relative();
+    ret = avformat_open_input(&avf, argv[optind], av_find_input_format("imf"), &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", argv[optind], av_err2str(ret));
+        return 1;
+    }
+
+    printf("%s: OK (%u tracks, checked in %"PRId64" ms)\n",
+        argv[optind], avf->nb_streams, (av_gettime_relative() - start) / 1000);
+    avformat_close_input(&avf);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Prints the byte-range map of an IMF composition as JSON
+ *
+ * Opens a Composition Playlist with the export_map option of the IMF demuxer
+ * and prints, for every virtual track and resource, the track file, entry
+ * point, duration and the byte ranges of its spans of edit units, read from
+ * the MXF index tables, so that a job can be split by the bytes each part
+ * of the composition needs.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/dict.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: imf_map [options] CPL\n"
+            "Options:\n"
+            "    -a assetmaps   comma-separated paths to the ASSETMAP files\n"
+            "    -s span        edit units per byte range (default: one range per resource)\n"
+            "    -v             print the progress of the demuxer\n"
+            );
+    exit(ret);
+}
+
+static void print_json_string(const char *str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        unsigned char ch = *str;
+
+        if (ch == '"' || ch == '\\')
+            printf("\\%c", ch);
+        else if (ch < 0x20)
+            printf("\\u%04x", ch);
+        else
+            putchar(ch);
+    }
+    putchar('"');
+}
+
+static const char *get_map_entry(AVDictionary *metadata, int resource, const char *name)
+{
+    AVDictionaryEntry *entry;
+    char key[64];
+
+    snprintf(key, sizeof(key), "imf_map.%d.%s", resource, name);
+    entry = av_dict_get(metadata, key, NULL, 0);
+    return entry ? entry->value : NULL;
+}
+
+static void print_ranges(const char *ranges, int64_t duration, int64_t span)
+{
+    int64_t edit_unit = 0;
+    int64_t pos, size;
+    int n;
+
+    printf(",\n          \"ranges\": [");
+    while (sscanf(ranges, "%"SCNd64"+%"SCNd64"%n", &pos, &size, &n) == 2) {
+        int64_t count = span > 0 ? FFMIN(span, duration - edit_unit) : duration;
+
+        printf("%s\n            { \"edit_unit\": %"PRId64", \"duration\": %"PRId64
+               ", \"offset\": %"PRId64", \"size\": %"PRId64" }",
+               edit_unit ? "," : "", edit_unit, count, pos, size);
+        edit_unit += count;
+        ranges += n;
+        if (*ranges != ',')
+            break;
+        ranges++;
+    }
+    printf("\n          ]");
+}
+
+static void print_track(AVStream *st, int64_t span, int last)
+{
+    const char *uri;
+
+    printf("    {\n      \"index\": %d,\n      \"type\": \"%s\",\n      \"resources\": [",
+           st->index, av_get_media_type_string(st->codecpar->codec_type));
+    for (int i = 0; (uri = get_map_entry(st->metadata, i, "uri")); i++) {
+        const char *ranges = get_map_entry(st->metadata, i, "ranges");
+        const char *duration = get_map_entry(st->metadata, i, "duration");
+
+        printf("%s\n        {\n          \"uri\": ", i ? "," : "");
+        print_json_string(uri);
+        printf(",\n          \"start\": %s,\n          \"entry_point\": %s,\n          \"duration\": %s",
+               get_map_entry(st->metadata, i, "start"),
+               get_map_entry(st->metadata, i, "entry_point"),
+               duration);
+        if (ranges)
+            print_ranges(ranges, strtoll(duration, NULL, 10), span);
+        printf("\n        }");
+    }
+    printf("\n      ]\n    }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *avf = NULL;
+    AVDictionary *opts = NULL;
+    const char *asset_maps = NULL;
+    const char *span = "0";
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "ha:s:v")) != -1) {
+        switch (opt) {
+        case 'a':
+            asset_maps = optarg;
+            break;
+        case 's':
+            span = optarg;
+            break;
+        case 'v':
+            av_log_set_level(AV_LOG_VERBOSE);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 1 != argc)
+        usage(1);
+
+    av_dict_set(&opts, "export_map", "1", 0);
+    av_dict_set(&opts, "map_span", span, 0);
+    av_dict_set(&opts, "imf_header_only", "1", 0);
+    if (asset_maps)
+        av_dict_set(&opts, "assetmaps", asset_maps, 0);
+
+    ret = avformat_open_input(&avf, argv[optind], av_find_input_format("imf"), &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", argv[optind], av_err2str(ret));
+        return 1;
+    }
+
+    printf("{\n  \"cpl\": ");
+    print_json_string(argv[optind]);
+    printf(",\n  \"tracks\": [\n");
+    for (unsigned i = 0; i < avf->nb_streams; i++)
+        print_track(avf->streams[i], strtoll(span, NULL, 10), i + 1 == avf->nb_streams);
+    printf("  ]\n}\n");
+    avformat_close_input(&avf);
+
+    return 0;
+}
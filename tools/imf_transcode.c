@@ -0,0 +1,952 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Transcodes the image of an IMF composition in parallel chunks
+ *
+ * The timeline of the composition is split into chunks of consecutive edit
+ * units, which worker threads transcode concurrently, each with its own
+ * instances of the IMF demuxer, restricted to the chunk with the imf_start
+ * and imf_end options, of the decoder and of the encoder. The encoded chunks
+ * are then muxed in order into a single output, with the timestamps of the
+ * composition. This requires an intra-only source, so that a chunk can start
+ * at any edit unit, and an encoder whose decoding timestamps do not overlap
+ * between consecutive chunks, which is checked while muxing. Audio is not
+ * transcoded.
+ *
+ * Each chunk starts a new encoder, hence a new GOP. So that the chunk
+ * boundaries fall where a keyframe costs little, they are moved to the
+ * nearest resource boundary or scene cut within a quarter of a chunk of the
+ * even split. The scene cuts are found by a first parallel pass decoding
+ * the composition at a reduced resolution and scoring the difference of
+ * consecutive edit units as the scdet filter does. With two-pass encoding,
+ * each chunk is encoded twice in a row by its worker, the statistics of the
+ * first pass being passed in memory to the second one, so every chunk meets
+ * the average bitrate target on its own.
+ */
+
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/bprint.h"
+#include "libavutil/cpu.h"
+#include "libavutil/dict.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+/* the scene analysis compares the first plane decoded at 1/8 resolution */
+#define SCAN_LOWRES 3
+
+typedef struct Chunk {
+    int64_t start, end;         /**< Edit units of the chunk, end excluded */
+    AVPacket **packets;         /**< Encoded packets, timestamps in 1/edit rate */
+    int nb_packets;
+    AVCodecParameters *par;     /**< Parameters of the encoder */
+    AVBPrint stats;             /**< Statistics of the first pass */
+    int done;
+    int ret;
+} Chunk;
+
+typedef struct TranscodeContext TranscodeContext;
+
+typedef int (*ChunkJob)(TranscodeContext *tc, Chunk *c);
+
+struct TranscodeContext {
+    const char *cpl;
+    AVDictionary *demuxer_opts;
+    const AVCodec *encoder;
+    AVDictionary *encoder_opts;
+    int width, height;          /**< Output size */
+    enum AVPixelFormat pix_fmt; /**< Output pixel format */
+    int codec_threads;
+    int global_header;
+    int two_pass;
+    double scene_threshold;     /**< Minimum score of a scene cut, 0 to not look for them */
+    AVRational edit_rate;
+    int64_t duration;           /**< Edit units of the composition */
+
+    int64_t *cuts;              /**< Resource boundaries and scene cuts, in edit units */
+    int nb_cuts;
+    double *mafd;               /**< Mean absolute difference of each edit unit with the previous one */
+
+    ChunkJob job;
+    Chunk *chunks;
+    int nb_chunks;
+    int next_chunk;
+    int abort;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+typedef struct EncodeState {
+    AVCodecContext *enc;
+    struct SwsContext *sws;
+    int sws_width, sws_height, sws_format;
+    AVFrame *scaled;
+    AVPacket *pkt;
+    int pass;                   /**< 1 or 2 with two-pass encoding, 0 otherwise */
+} EncodeState;
+
+typedef struct ScanState {
+    AVFrame *prev;
+    int64_t prev_pos;
+} ScanState;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: imf_transcode [options] -c encoder CPL output\n"
+            "Transcodes the image of an intra-only IMF composition in parallel chunks.\n"
+            "Options:\n"
+            "    -c encoder     name of the encoder\n"
+            "    -o options     encoder options, as key=value:key=value\n"
+            "    -d options     IMF demuxer options, as key=value:key=value\n"
+            "    -f format      output format (default guessed from the output name)\n"
+            "    -s WxH         output size (default the source size)\n"
+            "    -p pix_fmt     output pixel format (default the closest to the source one)\n"
+            "    -j workers     number of chunks transcoded concurrently (default the number of CPUs)\n"
+            "    -n chunks      number of chunks (default the number of workers)\n"
+            "    -t threads     threads of each decoder and encoder (default 1)\n"
+            "    -S threshold   move the chunk boundaries to scene cuts scoring at least threshold,\n"
+            "                   from 0 to 100 as with the scdet filter (default 0, only resource boundaries)\n"
+            "    -2             two-pass encoding, the encoder must use stats_out and stats_in\n"
+            "    -v             print the progress of the chunks\n"
+            );
+    exit(ret);
+}
+
+static int add_packet(Chunk *c, AVPacket *pkt)
+{
+    AVPacket **packets = av_realloc_array(c->packets, c->nb_packets + 1, sizeof(*packets));
+
+    if (!packets)
+        return AVERROR(ENOMEM);
+    c->packets = packets;
+    if (!(c->packets[c->nb_packets] = av_packet_clone(pkt)))
+        return AVERROR(ENOMEM);
+    c->nb_packets++;
+    return 0;
+}
+
+static int encode_frame(EncodeState *es, Chunk *c, const AVFrame *frame)
+{
+    AVCodecContext *enc = es->enc;
+    AVPacket *pkt = es->pkt;
+    int ret = avcodec_send_frame(enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(enc, pkt);
+        if (es->pass == 1 && enc->stats_out && (ret >= 0 || ret == AVERROR_EOF))
+            av_bprintf(&c->stats, "%s", enc->stats_out);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            break;
+        /* the output of the first pass is only used for its statistics */
+        ret = es->pass == 1 ? 0 : add_packet(c, pkt);
+        av_packet_unref(pkt);
+    }
+    return ret;
+}
+
+static int open_encoder(TranscodeContext *tc, EncodeState *es, Chunk *c,
+                        const AVFrame *frame, const AVStream *st)
+{
+    const AVCodec *codec = tc->encoder;
+    AVCodecContext *enc;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    if (!(es->enc = enc = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+    /* the chunks must not depend on the resource they start in */
+    enc->width               = tc->width;
+    enc->height              = tc->height;
+    enc->pix_fmt             = tc->pix_fmt;
+    enc->sample_aspect_ratio = frame->sample_aspect_ratio.num ?
+                               frame->sample_aspect_ratio : st->sample_aspect_ratio;
+    enc->color_range         = frame->color_range;
+    enc->color_primaries     = frame->color_primaries;
+    enc->color_trc           = frame->color_trc;
+    enc->colorspace          = frame->colorspace;
+    enc->time_base           = av_inv_q(tc->edit_rate);
+    enc->framerate           = tc->edit_rate;
+    enc->thread_count        = tc->codec_threads;
+    if (tc->global_header)
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (es->pass == 1) {
+        enc->flags |= AV_CODEC_FLAG_PASS1;
+    } else if (es->pass == 2) {
+        if (!av_bprint_is_complete(&c->stats))
+            return AVERROR(ENOMEM);
+        enc->flags   |= AV_CODEC_FLAG_PASS2;
+        enc->stats_in = c->stats.str;
+    }
+
+    av_dict_copy(&opts, tc->encoder_opts, 0);
+    ret = avcodec_open2(enc, codec, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/**
+ * Decode the edit units [start, c->end) of the composition, passing each
+ * frame to handle(), then NULL at the end. The timestamps of the frames are
+ * set to their edit units in the composition.
+ */
+static int decode_chunk(TranscodeContext *tc, Chunk *c, int64_t start, int lowres,
+                        int (*handle)(TranscodeContext *tc, Chunk *c, void *priv,
+                                      const AVStream *st, AVFrame *frame),
+                        void *priv)
+{
+    AVFormatContext *ic = NULL;
+    AVCodecContext *dec = NULL;
+    AVDictionary *opts = NULL;
+    const AVCodec *codec;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    AVStream *st;
+    int flushing = 0, ret;
+
+    if (!frame || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    av_dict_copy(&opts, tc->demuxer_opts, 0);
+    av_dict_set_int(&opts, "imf_start", start, 0);
+    av_dict_set_int(&opts, "imf_end", c->end, 0);
+    ret = avformat_open_input(&ic, tc->cpl, av_find_input_format("imf"), &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
+        goto end;
+    st = ic->streams[ret];
+
+    if (!(dec = avcodec_alloc_context3(codec))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec, st->codecpar)) < 0)
+        goto end;
+    dec->thread_count = tc->codec_threads;
+    dec->lowres       = FFMIN(lowres, codec->max_lowres);
+    if ((ret = avcodec_open2(dec, codec, NULL)) < 0)
+        goto end;
+
+    while (1) {
+        if (!flushing) {
+            ret = av_read_frame(ic, pkt);
+            if (ret == AVERROR_EOF) {
+                flushing = 1;
+            } else if (ret < 0) {
+                goto end;
+            } else if (pkt->stream_index != st->index) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            ret = avcodec_send_packet(dec, flushing ? NULL : pkt);
+            av_packet_unref(pkt);
+            if (ret < 0)
+                goto end;
+        }
+
+        while ((ret = avcodec_receive_frame(dec, frame)) >= 0) {
+            /* the timestamps of the window start at 0 */
+            frame->pts = av_rescale_q(frame->best_effort_timestamp, st->time_base,
+                                      av_inv_q(tc->edit_rate)) + start;
+            ret = handle(tc, c, priv, st, frame);
+            av_frame_unref(frame);
+            if (ret < 0)
+                goto end;
+        }
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret != AVERROR(EAGAIN))
+            goto end;
+    }
+
+    ret = handle(tc, c, priv, st, NULL);
+
+end:
+    avcodec_free_context(&dec);
+    avformat_close_input(&ic);
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    return ret;
+}
+
+static int encode_handler(TranscodeContext *tc, Chunk *c, void *priv,
+                          const AVStream *st, AVFrame *frame)
+{
+    EncodeState *es = priv;
+    AVCodecContext *enc = es->enc;
+    AVFrame *out = frame;
+    int ret;
+
+    if (!frame)
+        return enc ? encode_frame(es, c, NULL) : AVERROR_INVALIDDATA;
+
+    if (!enc) {
+        if ((ret = open_encoder(tc, es, c, frame, st)) < 0)
+            return ret;
+        enc = es->enc;
+        if (es->pass != 1) {
+            if (!(c->par = avcodec_parameters_alloc()))
+                return AVERROR(ENOMEM);
+            if ((ret = avcodec_parameters_from_context(c->par, enc)) < 0)
+                return ret;
+        }
+    }
+
+    /* the resources of a composition may differ in format */
+    if (enc->width != frame->width || enc->height != frame->height ||
+        enc->pix_fmt != frame->format) {
+        if (frame->width != es->sws_width || frame->height != es->sws_height ||
+            frame->format != es->sws_format) {
+            sws_freeContext(es->sws);
+            es->sws = sws_getContext(frame->width, frame->height, frame->format,
+                                     enc->width, enc->height, enc->pix_fmt,
+                                     SWS_BICUBIC, NULL, NULL, NULL);
+            if (!es->sws)
+                return AVERROR(EINVAL);
+            es->sws_width  = frame->width;
+            es->sws_height = frame->height;
+            es->sws_format = frame->format;
+        }
+        av_frame_unref(es->scaled);
+        es->scaled->format = enc->pix_fmt;
+        es->scaled->width  = enc->width;
+        es->scaled->height = enc->height;
+        if ((ret = av_frame_get_buffer(es->scaled, 0)) < 0 ||
+            (ret = av_frame_copy_props(es->scaled, frame)) < 0)
+            return ret;
+        sws_scale(es->sws, (const uint8_t * const *)frame->data, frame->linesize,
+                  0, frame->height, es->scaled->data, es->scaled->linesize);
+        out = es->scaled;
+    }
+
+    out->pict_type = AV_PICTURE_TYPE_NONE;
+    return encode_frame(es, c, out);
+}
+
+static int encode_pass(TranscodeContext *tc, Chunk *c, int pass)
+{
+    EncodeState es = { .pass = pass, .sws_format = AV_PIX_FMT_NONE };
+    int ret;
+
+    es.scaled = av_frame_alloc();
+    es.pkt    = av_packet_alloc();
+    if (!es.scaled || !es.pkt)
+        ret = AVERROR(ENOMEM);
+    else
+        ret = decode_chunk(tc, c, c->start, 0, encode_handler, &es);
+
+    sws_freeContext(es.sws);
+    avcodec_free_context(&es.enc);
+    av_packet_free(&es.pkt);
+    av_frame_free(&es.scaled);
+    return ret;
+}
+
+/**
+ * Transcode the edit units of a chunk, keeping the encoded packets in it.
+ */
+static int transcode_chunk(TranscodeContext *tc, Chunk *c)
+{
+    int ret;
+
+    if (!tc->two_pass)
+        return encode_pass(tc, c, 0);
+    if ((ret = encode_pass(tc, c, 1)) < 0)
+        return ret;
+    return encode_pass(tc, c, 2);
+}
+
+static int scan_handler(TranscodeContext *tc, Chunk *c, void *priv,
+                        const AVStream *st, AVFrame *frame)
+{
+    ScanState *ss = priv;
+    const AVPixFmtDescriptor *desc;
+    AVFrame *prev = ss->prev;
+    int64_t sad = 0;
+    int x, y, bytes, w;
+
+    if (!frame)
+        return 0;
+
+    desc  = av_pix_fmt_desc_get(frame->format);
+    bytes = desc->comp[0].depth > 8 ? 2 : 1;
+    /* all the samples of the first plane, for packed formats too */
+    w     = frame->width * desc->comp[0].step / bytes;
+
+    if (frame->pts > 0 && frame->pts < tc->duration && frame->pts == ss->prev_pos + 1 &&
+        frame->width == prev->width && frame->height == prev->height &&
+        frame->format == prev->format) {
+        for (y = 0; y < frame->height; y++) {
+            const uint8_t *a = frame->data[0] + y * frame->linesize[0];
+            const uint8_t *b = prev->data[0]  + y * prev->linesize[0];
+            if (bytes == 2) {
+                for (x = 0; x < w; x++)
+                    sad += FFABS(AV_RN16(a + 2 * x) - AV_RN16(b + 2 * x));
+            } else {
+                for (x = 0; x < w; x++)
+                    sad += FFABS(a[x] - b[x]);
+            }
+        }
+        /* as in the scdet filter */
+        tc->mafd[frame->pts] = sad * 100. / ((int64_t)w * frame->height) /
+                               (1 << desc->comp[0].depth);
+    }
+    ss->prev_pos = frame->pts;
+    av_frame_unref(prev);
+    return av_frame_ref(prev, frame);
+}
+
+/**
+ * Compute the difference of each edit unit of a chunk with the previous one,
+ * decoding the chunk from the edit unit before it.
+ */
+static int scan_chunk(TranscodeContext *tc, Chunk *c)
+{
+    ScanState ss = { .prev_pos = INT64_MIN };
+    int ret;
+
+    if (!(ss.prev = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    ret = decode_chunk(tc, c, FFMAX(c->start - 1, 0), SCAN_LOWRES, scan_handler, &ss);
+    av_frame_free(&ss.prev);
+    return ret;
+}
+
+static void *worker(void *arg)
+{
+    TranscodeContext *tc = arg;
+    Chunk *c;
+    int64_t start;
+    int ret;
+
+    while (1) {
+        pthread_mutex_lock(&tc->lock);
+        if (tc->abort || tc->next_chunk == tc->nb_chunks) {
+            pthread_mutex_unlock(&tc->lock);
+            break;
+        }
+        c = &tc->chunks[tc->next_chunk++];
+        pthread_mutex_unlock(&tc->lock);
+
+        start = av_gettime_relative();
+        ret = tc->job(tc, c);
+        if (ret < 0)
+            av_log(NULL, AV_LOG_ERROR, "Chunk [%"PRId64", %"PRId64"): %s\n",
+                   c->start, c->end, av_err2str(ret));
+        else if (tc->job == scan_chunk)
+            av_log(NULL, AV_LOG_VERBOSE, "Chunk [%"PRId64", %"PRId64"): scanned in %"PRId64" ms\n",
+                   c->start, c->end, (av_gettime_relative() - start) / 1000);
+        else
+            av_log(NULL, AV_LOG_VERBOSE, "Chunk [%"PRId64", %"PRId64"): %d packets in %"PRId64" ms\n",
+                   c->start, c->end, c->nb_packets, (av_gettime_relative() - start) / 1000);
+
+        pthread_mutex_lock(&tc->lock);
+        c->ret  = ret;
+        c->done = 1;
+        if (ret < 0)
+            tc->abort = 1;
+        pthread_cond_broadcast(&tc->cond);
+        pthread_mutex_unlock(&tc->lock);
+    }
+    return NULL;
+}
+
+static int wait_chunk(TranscodeContext *tc, Chunk *c)
+{
+    int ret;
+
+    pthread_mutex_lock(&tc->lock);
+    while (!c->done && !tc->abort)
+        pthread_cond_wait(&tc->cond, &tc->lock);
+    ret = c->done ? c->ret : AVERROR_EXIT;
+    pthread_mutex_unlock(&tc->lock);
+    return ret;
+}
+
+static int add_cut(TranscodeContext *tc, int64_t pos)
+{
+    int64_t *cuts;
+
+    if (pos <= 0)
+        return 0;
+    if (!(cuts = av_realloc_array(tc->cuts, tc->nb_cuts + 1, sizeof(*cuts))))
+        return AVERROR(ENOMEM);
+    tc->cuts = cuts;
+    tc->cuts[tc->nb_cuts++] = pos;
+    return 0;
+}
+
+static int cmp_cuts(const void *a, const void *b)
+{
+    return FFDIFFSIGN(*(const int64_t *)a, *(const int64_t *)b);
+}
+
+/**
+ * Add the edit units whose score with the previous one reaches the scene
+ * threshold to the cuts.
+ */
+static int find_scene_cuts(TranscodeContext *tc)
+{
+    int nb_scenes = 0, ret;
+    int64_t i;
+
+    for (i = 1; i < tc->duration; i++) {
+        /* as in the scdet filter */
+        double diff  = fabs(tc->mafd[i] - tc->mafd[i - 1]);
+        double score = av_clipd(FFMIN(tc->mafd[i], diff), 0, 100.);
+
+        if (score >= tc->scene_threshold) {
+            if ((ret = add_cut(tc, i)) < 0)
+                return ret;
+            nb_scenes++;
+        }
+    }
+    av_log(NULL, AV_LOG_VERBOSE, "%d scene cuts\n", nb_scenes);
+    return 0;
+}
+
+/**
+ * Split the composition evenly, then move each boundary to the closest cut
+ * within a quarter of a chunk.
+ */
+static void plan_chunks(TranscodeContext *tc)
+{
+    int64_t tolerance = tc->duration / tc->nb_chunks / 4;
+    int64_t start = 0, end;
+    int i, j;
+
+    qsort(tc->cuts, tc->nb_cuts, sizeof(*tc->cuts), cmp_cuts);
+    for (i = 0; i < tc->nb_chunks; i++) {
+        end = tc->duration * (i + 1) / tc->nb_chunks;
+        if (i < tc->nb_chunks - 1) {
+            int64_t nominal = end;
+            for (j = 0; j < tc->nb_cuts; j++) {
+                int64_t cut = tc->cuts[j];
+                if (cut > start && FFABS(cut - nominal) <= tolerance &&
+                    FFABS(cut - nominal) < FFABS(end - nominal))
+                    end = cut;
+            }
+        }
+        tc->chunks[i].start = start;
+        tc->chunks[i].end   = end;
+        start = end;
+    }
+}
+
+/**
+ * Get the edit rate and duration in edit units of the composition from its
+ * main image track, and its resource boundaries.
+ */
+static int probe_composition(TranscodeContext *tc, int64_t *duration)
+{
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    const AVDictionaryEntry *e;
+    const AVCodecDescriptor *desc;
+    const enum AVPixelFormat *pix_fmts = tc->encoder->pix_fmts;
+    AVStream *st;
+    int i, ret;
+
+    av_dict_copy(&opts, tc->demuxer_opts, 0);
+    av_dict_set(&opts, "export_resources", "1", 0);
+    ret = avformat_open_input(&ic, tc->cpl, av_find_input_format("imf"), &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if ((ret = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0)
+        goto end;
+    st = ic->streams[ret];
+
+    /* the time base of the tracks is the inverse of their edit rate */
+    tc->edit_rate = st->r_frame_rate.num ? st->r_frame_rate : av_inv_q(st->time_base);
+    if (!tc->edit_rate.num || !tc->edit_rate.den) {
+        av_log(NULL, AV_LOG_ERROR, "Unknown edit rate of the image track\n");
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    if (st->duration != AV_NOPTS_VALUE)
+        *duration = av_rescale_q(st->duration, st->time_base, av_inv_q(tc->edit_rate));
+    else
+        *duration = av_rescale_q(ic->duration, AV_TIME_BASE_Q, av_inv_q(tc->edit_rate));
+
+    desc = avcodec_descriptor_get(st->codecpar->codec_id);
+    if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+        av_log(NULL, AV_LOG_ERROR, "The image track is not intra-only\n");
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+
+    if ((e = av_dict_get(st->metadata, "imf_resource_starts", NULL, 0))) {
+        const char *p = e->value;
+        char *next;
+
+        while (*p) {
+            if ((ret = add_cut(tc, strtoll(p, &next, 10))) < 0)
+                goto end;
+            if (next == p || (*next && *next != ','))
+                break;
+            p = *next ? next + 1 : next;
+        }
+    }
+
+    if (!tc->width) {
+        tc->width  = st->codecpar->width;
+        tc->height = st->codecpar->height;
+    }
+    if (tc->pix_fmt == AV_PIX_FMT_NONE) {
+        tc->pix_fmt = st->codecpar->format;
+        for (i = 0; pix_fmts && pix_fmts[i] != AV_PIX_FMT_NONE; i++)
+            if (pix_fmts[i] == tc->pix_fmt)
+                break;
+        if (pix_fmts && pix_fmts[i] == AV_PIX_FMT_NONE)
+            tc->pix_fmt = avcodec_find_best_pix_fmt_of_list(pix_fmts, st->codecpar->format, 0, NULL);
+    }
+    if (tc->width <= 0 || tc->height <= 0 || tc->pix_fmt == AV_PIX_FMT_NONE) {
+        av_log(NULL, AV_LOG_ERROR, "Unknown size or pixel format of the image track\n");
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    ret = 0;
+
+end:
+    avformat_close_input(&ic);
+    return ret;
+}
+
+static int start_workers(TranscodeContext *tc, ChunkJob job, pthread_t *threads,
+                         int nb_workers, int *nb_started)
+{
+    int ret;
+
+    tc->job        = job;
+    tc->next_chunk = 0;
+    for (; *nb_started < nb_workers; (*nb_started)++)
+        if ((ret = pthread_create(&threads[*nb_started], NULL, worker, tc)))
+            return AVERROR(ret);
+    return 0;
+}
+
+static void join_workers(pthread_t *threads, int *nb_started)
+{
+    for (; *nb_started > 0; (*nb_started)--)
+        pthread_join(threads[*nb_started - 1], NULL);
+}
+
+/**
+ * Find the sequence header OBU of an AV1 temporal unit, in the low overhead
+ * bitstream format.
+ *
+ * @return the size of the OBU payload, 0 if there is none
+ */
+static int av1_sequence_header(const uint8_t *buf, int size, const uint8_t **seq)
+{
+    while (size > 0) {
+        int type = (buf[0] >> 3) & 0xf;
+        int pos  = 1 + ((buf[0] >> 2) & 1);
+        uint64_t len = 0;
+
+        if (pos > size)
+            return 0;
+        if (buf[0] & 0x02) {
+            for (int i = 0; ; i++) {
+                if (pos >= size || i == 8)
+                    return 0;
+                len |= (uint64_t)(buf[pos] & 0x7f) << (7 * i);
+                if (!(buf[pos++] & 0x80))
+                    break;
+            }
+        } else {
+            len = size - pos;
+        }
+        if (len > size - pos)
+            return 0;
+        if (type == 1) {
+            *seq = buf + pos;
+            return len;
+        }
+        buf  += pos + len;
+        size -= pos + len;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    TranscodeContext tc = { .codec_threads = 1, .pix_fmt = AV_PIX_FMT_NONE };
+    AVFormatContext *oc = NULL;
+    const char *format = NULL, *encoder = NULL, *output;
+    pthread_t *threads = NULL;
+    AVStream *ost;
+    int64_t duration = 0, start, last_dts = AV_NOPTS_VALUE, nb_packets = 0;
+    uint8_t *seq_header = NULL;
+    int seq_header_size = 0;
+    int nb_workers = av_cpu_count(), nb_started = 0;
+    int opt, i, j, ret;
+
+    while ((opt = getopt(argc, argv, "hc:o:d:f:s:p:j:n:t:S:2v")) != -1) {
+        switch (opt) {
+        case 'c':
+            encoder = optarg;
+            break;
+        case 'o':
+        case 'd':
+            if (av_dict_parse_string(opt == 'o' ? &tc.encoder_opts : &tc.demuxer_opts,
+                                     optarg, "=", ":", 0) < 0) {
+                fprintf(stderr, "Invalid options: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 's':
+            if (av_parse_video_size(&tc.width, &tc.height, optarg) < 0) {
+                fprintf(stderr, "Invalid size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if ((tc.pix_fmt = av_get_pix_fmt(optarg)) == AV_PIX_FMT_NONE) {
+                fprintf(stderr, "Unknown pixel format: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'j':
+            nb_workers = atoi(optarg);
+            break;
+        case 'n':
+            tc.nb_chunks = atoi(optarg);
+            break;
+        case 't':
+            tc.codec_threads = atoi(optarg);
+            break;
+        case 'S':
+            tc.scene_threshold = atof(optarg);
+            break;
+        case '2':
+            tc.two_pass = 1;
+            break;
+        case 'v':
+            av_log_set_level(AV_LOG_VERBOSE);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 2 != argc || !encoder || nb_workers <= 0 || tc.nb_chunks < 0)
+        usage(1);
+    tc.cpl = argv[optind];
+    output = argv[optind + 1];
+    if (!tc.nb_chunks)
+        tc.nb_chunks = nb_workers;
+
+    if (!(tc.encoder = avcodec_find_encoder_by_name(encoder)) ||
+        tc.encoder->type != AVMEDIA_TYPE_VIDEO) {
+        fprintf(stderr, "Unknown video encoder: %s\n", encoder);
+        return 1;
+    }
+
+    start = av_gettime_relative();
+    if ((ret = probe_composition(&tc, &duration)) < 0) {
+        fprintf(stderr, "%s: %s\n", tc.cpl, av_err2str(ret));
+        return 1;
+    }
+    if (duration <= 0) {
+        fprintf(stderr, "%s: empty composition\n", tc.cpl);
+        return 1;
+    }
+    tc.duration  = duration;
+    tc.nb_chunks = FFMIN(tc.nb_chunks, duration);
+    nb_workers   = FFMIN(nb_workers, tc.nb_chunks);
+
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, format, output)) < 0) {
+        fprintf(stderr, "%s: %s\n", output, av_err2str(ret));
+        return 1;
+    }
+    tc.global_header = !!(oc->oformat->flags & AVFMT_GLOBALHEADER);
+
+    pthread_mutex_init(&tc.lock, NULL);
+    pthread_cond_init(&tc.cond, NULL);
+    tc.chunks = av_calloc(tc.nb_chunks, sizeof(*tc.chunks));
+    threads   = av_calloc(nb_workers, sizeof(*threads));
+    if (!tc.chunks || !threads) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < tc.nb_chunks; i++) {
+        tc.chunks[i].start = duration *  i      / tc.nb_chunks;
+        tc.chunks[i].end   = duration * (i + 1) / tc.nb_chunks;
+        av_bprint_init(&tc.chunks[i].stats, 0, AV_BPRINT_SIZE_UNLIMITED);
+    }
+
+    /* scene analysis, on the even split */
+    if (tc.scene_threshold > 0) {
+        if (!(tc.mafd = av_calloc(duration, sizeof(*tc.mafd)))) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = start_workers(&tc, scan_chunk, threads, nb_workers, &nb_started)) < 0)
+            goto end;
+        for (i = 0; i < tc.nb_chunks; i++)
+            if ((ret = wait_chunk(&tc, &tc.chunks[i])) < 0)
+                goto end;
+        join_workers(threads, &nb_started);
+        for (i = 0; i < tc.nb_chunks; i++)
+            tc.chunks[i].done = 0;
+        if ((ret = find_scene_cuts(&tc)) < 0)
+            goto end;
+    }
+    plan_chunks(&tc);
+    for (i = 0; i < tc.nb_chunks; i++)
+        av_log(NULL, AV_LOG_VERBOSE, "Chunk %d: [%"PRId64", %"PRId64")\n",
+               i, tc.chunks[i].start, tc.chunks[i].end);
+
+    if ((ret = start_workers(&tc, transcode_chunk, threads, nb_workers, &nb_started)) < 0)
+        goto end;
+
+    /* the muxer is initialized with the parameters of the first chunk */
+    if ((ret = wait_chunk(&tc, &tc.chunks[0])) < 0)
+        goto end;
+    if (!(ost = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_copy(ost->codecpar, tc.chunks[0].par)) < 0)
+        goto end;
+    ost->time_base      = av_inv_q(tc.edit_rate);
+    ost->avg_frame_rate = tc.edit_rate;
+    if (!(oc->oformat->flags & AVFMT_NOFILE) &&
+        (ret = avio_open(&oc->pb, output, AVIO_FLAG_WRITE)) < 0)
+        goto end;
+    if ((ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    for (i = 0; i < tc.nb_chunks; i++) {
+        Chunk *c = &tc.chunks[i];
+
+        if ((ret = wait_chunk(&tc, c)) < 0)
+            goto end;
+        if (c->par->extradata_size != ost->codecpar->extradata_size ||
+            (c->par->extradata_size &&
+             memcmp(c->par->extradata, ost->codecpar->extradata, c->par->extradata_size))) {
+            av_log(NULL, AV_LOG_ERROR, "The global header of the chunk starting at edit unit %"PRId64" "
+                   "differs from the first chunk\n", c->start);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        /* in-band AV1 sequence headers must be the same in all chunks */
+        if (ost->codecpar->codec_id == AV_CODEC_ID_AV1 && c->nb_packets) {
+            const uint8_t *seq;
+            int size = av1_sequence_header(c->packets[0]->data, c->packets[0]->size, &seq);
+
+            if (!i) {
+                if (size && !(seq_header = av_memdup(seq, size))) {
+                    ret = AVERROR(ENOMEM);
+                    goto end;
+                }
+                seq_header_size = size;
+            } else if (size != seq_header_size || memcmp(seq, seq_header, size)) {
+                av_log(NULL, AV_LOG_ERROR, "The sequence header of the chunk starting at edit unit %"PRId64" "
+                       "differs from the first chunk\n", c->start);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+        }
+        for (j = 0; j < c->nb_packets; j++) {
+            AVPacket *pkt = c->packets[j];
+
+            if (last_dts != AV_NOPTS_VALUE && pkt->dts <= last_dts) {
+                av_log(NULL, AV_LOG_ERROR, "The packets of the chunk starting at edit unit %"PRId64" "
+                       "overlap the previous chunk, the encoder must not reorder frames\n", c->start);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+            last_dts = pkt->dts;
+            pkt->stream_index = ost->index;
+            av_packet_rescale_ts(pkt, av_inv_q(tc.edit_rate), ost->time_base);
+            if ((ret = av_interleaved_write_frame(oc, pkt)) < 0)
+                goto end;
+            av_packet_free(&c->packets[j]);
+            nb_packets++;
+        }
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    pthread_mutex_lock(&tc.lock);
+    tc.abort = 1;
+    pthread_cond_broadcast(&tc.cond);
+    pthread_mutex_unlock(&tc.lock);
+    join_workers(threads, &nb_started);
+    pthread_cond_destroy(&tc.cond);
+    pthread_mutex_destroy(&tc.lock);
+
+    if (ret >= 0)
+        printf("%s: %"PRId64" edit units in %d chunks, %"PRId64" packets in %"PRId64" ms\n",
+               output, duration, tc.nb_chunks, nb_packets, (av_gettime_relative() - start) / 1000);
+    else if (ret != AVERROR_EXIT)
+        fprintf(stderr, "%s: %s\n", output, av_err2str(ret));
+
+    for (i = 0; tc.chunks && i < tc.nb_chunks; i++) {
+        for (j = 0; j < tc.chunks[i].nb_packets; j++)
+            av_packet_free(&tc.chunks[i].packets[j]);
+        av_freep(&tc.chunks[i].packets);
+        avcodec_parameters_free(&tc.chunks[i].par);
+        av_bprint_finalize(&tc.chunks[i].stats, NULL);
+    }
+    av_freep(&tc.chunks);
+    av_freep(&tc.cuts);
+    av_freep(&tc.mafd);
+    av_freep(&seq_header);
+    av_freep(&threads);
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    av_dict_free(&tc.encoder_opts);
+    av_dict_free(&tc.demuxer_opts);
+
+    return ret < 0;
+}
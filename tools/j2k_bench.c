@@ -0,0 +1,366 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Benchmark of the JPEG 2000 decoder on synthetic IMF-like codestreams
+ *
+ * Encodes a synthetic RGB picture with the native encoder for each of a set
+ * of configurations (2K / 4K, 10 / 12 bit, single tile / multiple tiles,
+ * 9/7 / 5/3 transform, one / several quality layers), then decodes it
+ * repeatedly with each of the requested slice thread counts. The time spent
+ * in each stage is read from the exported options of the decoder, and the
+ * results are printed as JSON.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#if HAVE_GETRUSAGE
+#include <sys/resource.h>
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define MAX_THREAD_COUNTS 16
+
+typedef struct BenchConfig {
+    const char *name;
+    int width, height;
+    int bits;                   /**< Significant bits per sample */
+    int pred;                   /**< 0 for the 9/7 transform, 1 for the 5/3 one */
+    int tile_size;              /**< 0 for a single tile */
+    const char *layer_rates;    /**< NULL for a single layer */
+} BenchConfig;
+
+static const BenchConfig configs[] = {
+    { "2k_10bit_97",        2048, 1080, 10, 0,    0, NULL          },
+    { "2k_12bit_53",        2048, 1080, 12, 1,    0, NULL          },
+    { "2k_12bit_97_tiles",  2048, 1080, 12, 0,  512, NULL          },
+    { "2k_12bit_97_layers", 2048, 1080, 12, 0,    0, "40,12,4"     },
+    { "4k_10bit_97",        4096, 2160, 10, 0,    0, NULL          },
+    { "4k_12bit_53_tiles",  4096, 2160, 12, 1, 1024, NULL          },
+    { "4k_12bit_97_layers", 4096, 2160, 12, 0,    0, "40,12,4"     },
+};
+
+typedef struct BenchParams {
+    const char *config;         /**< Only run the configurations containing this */
+    int frames;                 /**< Frames decoded per configuration and thread count */
+    int scale;                  /**< Divisor of the picture dimensions */
+    int threads[MAX_THREAD_COUNTS];
+    int nb_threads;
+} BenchParams;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: j2k_bench [options]\n"
+            "Encodes synthetic JPEG 2000 codestreams and benchmarks their decoding.\n"
+            "Options:\n"
+            "    -c name        only run the configurations whose name contains name\n"
+            "    -f frames      frames decoded per configuration and thread count (default 10)\n"
+            "    -s scale       divide the picture dimensions by scale (default 1)\n"
+            "    -t threads     comma separated slice thread counts (default 1,2,4)\n"
+            "    -l             list the configurations\n"
+            );
+    exit(ret);
+}
+
+static int64_t peak_rss_kb(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return rusage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Fills an RGB48 frame with smooth gradients and some noise, so that the
+ * code blocks carry a realistic amount of significant bit planes.
+ */
+static void fill_frame(AVFrame *frame, int bits)
+{
+    int shift = 16 - bits, max = (1 << bits) - 1;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0x12B);
+    for (int y = 0; y < frame->height; y++) {
+        uint16_t *row = (uint16_t *)(frame->data[0] + y * frame->linesize[0]);
+        for (int x = 0; x < frame->width; x++) {
+            unsigned noise = av_lfg_get(&lfg);
+            for (int c = 0; c < 3; c++) {
+                int v = (int64_t)(x * (c + 1) + y * (3 - c)) * max / (3 * (frame->width + frame->height)) +
+                        (int)((noise >> (8 * c)) & 0x3F) - 0x20;
+                row[3 * x + c] = av_clip(v, 0, max) << shift;
+            }
+        }
+    }
+}
+
+static int encode_config(const BenchConfig *cfg, int width, int height, AVPacket *pkt)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_JPEG2000);
+    AVCodecContext *enc = NULL;
+    AVDictionary *opts = NULL;
+    AVFrame *frame = NULL;
+    int tile_size = cfg->tile_size ? FFMAX(cfg->tile_size * width / cfg->width, 64) : 0;
+    int ret;
+
+    if (!codec) {
+        fprintf(stderr, "Missing jpeg2000 encoder\n");
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    enc = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!enc || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    enc->pix_fmt = AV_PIX_FMT_RGB48;
+    enc->width = width;
+    enc->height = height;
+    enc->bits_per_raw_sample = cfg->bits;
+    enc->time_base = (AVRational){ 1, 24 };
+    av_dict_set(&opts, "format", "j2k", 0);
+    av_dict_set_int(&opts, "pred", cfg->pred, 0);
+    av_dict_set_int(&opts, "tile_width",  tile_size ? tile_size : width,  0);
+    av_dict_set_int(&opts, "tile_height", tile_size ? tile_size : height, 0);
+    if (cfg->layer_rates)
+        av_dict_set(&opts, "layer_rates", cfg->layer_rates, 0);
+
+    if ((ret = avcodec_open2(enc, codec, &opts)) < 0)
+        goto end;
+
+    frame->format = enc->pix_fmt;
+    frame->width = enc->width;
+    frame->height = enc->height;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+    fill_frame(frame, cfg->bits);
+
+    if ((ret = avcodec_send_frame(enc, frame)) < 0 ||
+        (ret = avcodec_receive_packet(enc, pkt)) < 0)
+        goto end;
+
+end:
+    avcodec_free_context(&enc);
+    av_frame_free(&frame);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Could not encode %s: %s\n", cfg->name, av_err2str(ret));
+    return ret;
+}
+
+static const char *const stage_opts[] = {
+    "time_tier2", "time_tier1", "time_dwt", "time_output",
+};
+static const char *const stage_names[] = {
+    "tier2", "tier1_dequant", "dwt", "mct_output",
+};
+#define NB_STAGES FF_ARRAY_ELEMS(stage_opts)
+
+static int get_stage_times(AVCodecContext *dec, int64_t times[NB_STAGES])
+{
+    for (int i = 0; i < NB_STAGES; i++) {
+        int ret = av_opt_get_int(dec, stage_opts[i], AV_OPT_SEARCH_CHILDREN, &times[i]);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int decode_packet(AVCodecContext *dec, const AVPacket *pkt, AVFrame *frame)
+{
+    int ret = avcodec_send_packet(dec, pkt);
+
+    if (ret >= 0)
+        ret = avcodec_receive_frame(dec, frame);
+    av_frame_unref(frame);
+    return ret;
+}
+
+static int run_decode(const BenchParams *p, const BenchConfig *cfg, int width, int height,
+                      const AVPacket *pkt, int threads, int first)
+{
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_JPEG2000);
+    AVCodecContext *dec = NULL;
+    AVFrame *frame = NULL;
+    int64_t before[NB_STAGES], after[NB_STAGES], start, total;
+    double pixels = (double)width * height * p->frames;
+    int ret;
+
+    if (!codec) {
+        fprintf(stderr, "Missing jpeg2000 decoder\n");
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+
+    dec = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!dec || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    dec->thread_count = threads;
+    dec->thread_type = FF_THREAD_SLICE;
+    if ((ret = avcodec_open2(dec, codec, NULL)) < 0)
+        goto end;
+
+    /* the first frame warms up the allocations and is not counted */
+    if ((ret = decode_packet(dec, pkt, frame)) < 0 ||
+        (ret = get_stage_times(dec, before)) < 0)
+        goto end;
+
+    start = av_gettime_relative();
+    for (int i = 0; i < p->frames; i++)
+        if ((ret = decode_packet(dec, pkt, frame)) < 0)
+            goto end;
+    total = av_gettime_relative() - start;
+    if ((ret = get_stage_times(dec, after)) < 0)
+        goto end;
+
+    printf("%s    {\n", first ? "" : ",\n");
+    printf("      \"config\": \"%s\",\n", cfg->name);
+    printf("      \"width\": %d,\n", width);
+    printf("      \"height\": %d,\n", height);
+    printf("      \"bits\": %d,\n", cfg->bits);
+    printf("      \"transform\": \"%s\",\n", cfg->pred ? "5/3" : "9/7");
+    printf("      \"layer_rates\": \"%s\",\n", cfg->layer_rates ? cfg->layer_rates : "");
+    printf("      \"tile_size\": %d,\n", cfg->tile_size ? FFMAX(cfg->tile_size * width / cfg->width, 64) : 0);
+    printf("      \"bytes\": %d,\n", pkt->size);
+    printf("      \"threads\": %d,\n", threads);
+    printf("      \"fps\": %.3f,\n", total ? p->frames * 1e6 / total : 0.0);
+    printf("      \"ns_per_pixel\": {\n");
+    for (int i = 0; i < NB_STAGES; i++)
+        printf("        \"%s\": %.3f,\n", stage_names[i], (after[i] - before[i]) * 1e3 / pixels);
+    printf("        \"total\": %.3f\n", total * 1e3 / pixels);
+    printf("      }\n");
+    printf("    }");
+    fflush(stdout);
+
+end:
+    avcodec_free_context(&dec);
+    av_frame_free(&frame);
+    if (ret < 0)
+        fprintf(stderr, "Could not decode %s with %d threads: %s\n",
+                cfg->name, threads, av_err2str(ret));
+    return ret;
+}
+
+static int run_bench(const BenchParams *p)
+{
+    AVPacket *pkt = av_packet_alloc();
+    int first = 1, ret = 0;
+
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    printf("{\n  \"frames\": %d,\n  \"results\": [\n", p->frames);
+    for (int c = 0; c < FF_ARRAY_ELEMS(configs) && ret >= 0; c++) {
+        const BenchConfig *cfg = &configs[c];
+        int width  = FFMAX(cfg->width  / p->scale, 16);
+        int height = FFMAX(cfg->height / p->scale, 16);
+
+        if (p->config && !strstr(cfg->name, p->config))
+            continue;
+
+        if ((ret = encode_config(cfg, width, height, pkt)) < 0)
+            break;
+        for (int t = 0; t < p->nb_threads && ret >= 0; t++) {
+            ret = run_decode(p, cfg, width, height, pkt, p->threads[t], first);
+            first = 0;
+        }
+        av_packet_unref(pkt);
+    }
+    printf("\n  ],\n  \"peak_rss_kb\": %"PRId64"\n}\n", peak_rss_kb());
+
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int parse_threads(BenchParams *p, const char *str)
+{
+    char *end;
+
+    p->nb_threads = 0;
+    do {
+        long n = strtol(str, &end, 10);
+        if (end == str || n < 1 || n > INT_MAX || p->nb_threads == MAX_THREAD_COUNTS)
+            return AVERROR(EINVAL);
+        p->threads[p->nb_threads++] = n;
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end ? AVERROR(EINVAL) : 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchParams p = {
+        .frames     = 10,
+        .scale      = 1,
+        .threads    = { 1, 2, 4 },
+        .nb_threads = 3,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hlc:f:s:t:")) != -1) {
+        switch (opt) {
+        case 'c': p.config = optarg; break;
+        case 'f': p.frames = atoi(optarg); break;
+        case 's': p.scale  = atoi(optarg); break;
+        case 't':
+            if (parse_threads(&p, optarg) < 0)
+                usage(1);
+            break;
+        case 'l':
+            for (int c = 0; c < FF_ARRAY_ELEMS(configs); c++)
+                printf("%s\n", configs[c].name);
+            return 0;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind != argc || p.frames < 1 || p.scale < 1)
+        usage(1);
+
+    /* the decoder warns about the code blocks of the native encoder */
+    av_log_set_level(AV_LOG_FATAL);
+
+    if (run_bench(&p) < 0)
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,683 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Benchmark of IMF to ProRes / DNxHR mezzanine transcoding
+ *
+ * Generates an IMF package with a 12 bit RGB JPEG 2000 track file, then runs
+ * the whole mezzanine chain on it for each requested encoder and thread
+ * count: IMF demuxing, JPEG 2000 decoding, conversion to 4:2:2 10 bit BT.709
+ * YUV, encoding and MOV muxing. The decoder, the scaler and the encoder use
+ * the same thread count. The wall clock time spent in each stage is measured
+ * from the main thread, so that the throughput of each one is reported, and
+ * the results are printed as JSON.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#if HAVE_GETRUSAGE
+#include <sys/resource.h>
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/dict.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define EDIT_RATE          24
+#define MAX_THREAD_COUNTS  16
+
+typedef struct Mezzanine {
+    const char *name;
+    const char *encoder;
+    const char *options;
+    enum AVPixelFormat pix_fmt;
+} Mezzanine;
+
+static const Mezzanine mezzanines[] = {
+    { "prores_hq",   "prores_ks", "profile=hq",        AV_PIX_FMT_YUV422P10 },
+    { "prores_4444", "prores_ks", "profile=4444",      AV_PIX_FMT_YUV444P10 },
+    { "dnxhr_hqx",   "dnxhd",     "profile=dnxhr_hqx", AV_PIX_FMT_YUV422P10 },
+    { "dnxhr_444",   "dnxhd",     "profile=dnxhr_444", AV_PIX_FMT_YUV444P10 },
+};
+
+enum Stage {
+    STAGE_DEMUX,
+    STAGE_DECODE,
+    STAGE_COLORSPACE,
+    STAGE_ENCODE,
+    STAGE_MUX,
+    NB_STAGES
+};
+
+static const char *const stage_names[NB_STAGES] = {
+    "demux", "decode", "colorspace", "encode", "mux",
+};
+
+typedef struct BenchParams {
+    const char *dir;
+    const char *mezzanine;      /**< Only run the mezzanines containing this */
+    int width, height;
+    int duration;               /**< Duration of the track file, in edit units */
+    int resources;              /**< Resources of the image virtual track */
+    int threads[MAX_THREAD_COUNTS];
+    int nb_threads;
+    int keep;                   /**< Keep the output files */
+} BenchParams;
+
+typedef struct BenchRun {
+    AVFormatContext *ic, *oc;
+    AVCodecContext *dec, *enc;
+    struct SwsContext *sws;
+    AVFrame *frame, *scaled;
+    AVPacket *pkt;
+    AVStream *ist;
+    int64_t times[NB_STAGES];
+    int64_t frames;
+    int64_t bytes;
+} BenchRun;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: mezz_bench [options] directory\n"
+            "Generates a synthetic IMF package in directory and benchmarks its\n"
+            "transcoding to ProRes and DNxHR mezzanines.\n"
+            "Options:\n"
+            "    -m name        only run the mezzanines whose name contains name\n"
+            "    -s WxH         picture size (default 1920x1080)\n"
+            "    -d duration    duration of the track file, in edit units (default 12)\n"
+            "    -r resources   resources of the image virtual track (default 4)\n"
+            "    -t threads     comma separated thread counts (default 1,2,4)\n"
+            "    -k             keep the output files\n"
+            "    -l             list the mezzanines\n"
+            );
+    exit(ret);
+}
+
+static int64_t peak_rss_kb(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return rusage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+static void print_uuid(AVIOContext *pb, unsigned type, unsigned index)
+{
+    avio_printf(pb, "urn:uuid:%08x-0000-4000-8000-%012x", type, index);
+}
+
+/**
+ * Fills an RGB48 frame with moving gradients and some noise, so that neither
+ * the JPEG 2000 source nor the mezzanine compress unrealistically well.
+ */
+static void fill_frame(AVFrame *frame, int index, AVLFG *lfg)
+{
+    const int bits = 12, max = (1 << bits) - 1;
+
+    for (int y = 0; y < frame->height; y++) {
+        uint16_t *row = (uint16_t *)(frame->data[0] + y * frame->linesize[0]);
+        for (int x = 0; x < frame->width; x++) {
+            unsigned noise = av_lfg_get(lfg);
+            for (int c = 0; c < 3; c++) {
+                int v = (int64_t)((x + 8 * index) * (c + 1) + y * (3 - c)) * max /
+                        (3 * (frame->width + frame->height)) +
+                        (int)((noise >> (8 * c)) & 0x3F) - 0x20;
+                row[3 * x + c] = av_clip(v, 0, max) << (16 - bits);
+            }
+        }
+    }
+}
+
+static int encode_and_write(AVFormatContext *oc, AVCodecContext *enc, AVFrame *frame, AVPacket *pkt)
+{
+    int ret = avcodec_send_frame(enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(enc, pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+        av_packet_rescale_ts(pkt, enc->time_base, oc->streams[0]->time_base);
+        pkt->stream_index = 0;
+        ret = av_interleaved_write_frame(oc, pkt);
+    }
+    return ret;
+}
+
+static int write_track_file(const BenchParams *p)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_JPEG2000);
+    AVFormatContext *oc = NULL;
+    AVCodecContext *enc = NULL;
+    AVFrame *frame = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    char path[1024];
+    AVLFG lfg;
+    int ret;
+
+    if (!codec) {
+        fprintf(stderr, "Missing jpeg2000 encoder\n");
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    snprintf(path, sizeof(path), "%s/video.mxf", p->dir);
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, "mxf", path)) < 0)
+        return ret;
+    enc = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    pkt = av_packet_alloc();
+    st = avformat_new_stream(oc, NULL);
+    if (!enc || !frame || !pkt || !st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    enc->pix_fmt = AV_PIX_FMT_RGB48;
+    enc->width = p->width;
+    enc->height = p->height;
+    enc->bits_per_raw_sample = 12;
+    enc->time_base = (AVRational){ 1, EDIT_RATE };
+    enc->framerate = (AVRational){ EDIT_RATE, 1 };
+    enc->color_primaries = AVCOL_PRI_BT709;
+    enc->color_trc = AVCOL_TRC_BT709;
+    enc->colorspace = AVCOL_SPC_RGB;
+    enc->thread_count = 0;
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if ((ret = avcodec_open2(enc, codec, NULL)) < 0 ||
+        (ret = avcodec_parameters_from_context(st->codecpar, enc)) < 0)
+        goto end;
+    st->time_base = enc->time_base;
+
+    if ((ret = avio_open(&oc->pb, path, AVIO_FLAG_WRITE)) < 0 ||
+        (ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    frame->format = enc->pix_fmt;
+    frame->width = enc->width;
+    frame->height = enc->height;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+
+    av_lfg_init(&lfg, 0x3E22);
+    for (int i = 0; i < p->duration; i++) {
+        if ((ret = av_frame_make_writable(frame)) < 0)
+            goto end;
+        fill_frame(frame, i, &lfg);
+        frame->pts = i;
+        if ((ret = encode_and_write(oc, enc, frame, pkt)) < 0)
+            goto end;
+    }
+    if ((ret = encode_and_write(oc, enc, NULL, pkt)) < 0)
+        goto end;
+
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc && oc->pb)
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    avcodec_free_context(&enc);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    if (ret < 0)
+        fprintf(stderr, "Could not write %s: %s\n", path, av_err2str(ret));
+    return ret;
+}
+
+/**
+ * Writes an asset map and a composition playlist whose image virtual track
+ * plays the track file once per resource.
+ */
+static int write_composition(const BenchParams *p)
+{
+    char path[1024];
+    AVIOContext *pb;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/ASSETMAP.xml", p->dir);
+    if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+    avio_printf(pb,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<AssetMap xmlns=\"http://www.smpte-ra.org/schemas/429-9/2007/AM\">\n"
+        "<Id>");
+    print_uuid(pb, 0xA55E7000, 0);
+    avio_printf(pb, "</Id>\n<AssetList>\n<Asset><Id>");
+    print_uuid(pb, 1, 0);
+    avio_printf(pb,
+        "</Id><ChunkList><Chunk><Path>video.mxf</Path></Chunk></ChunkList></Asset>\n"
+        "</AssetList>\n</AssetMap>\n");
+    avio_closep(&pb);
+
+    snprintf(path, sizeof(path), "%s/CPL.xml", p->dir);
+    if ((ret = avio_open(&pb, path, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+    avio_printf(pb,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<CompositionPlaylist xmlns=\"http://www.smpte-ra.org/schemas/2067-3/2016\""
+        " xmlns:cc=\"http://www.smpte-ra.org/schemas/2067-2/2016\""
+        " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+        "<Id>");
+    print_uuid(pb, 0xC9100000, 0);
+    avio_printf(pb,
+        "</Id>\n<ContentTitle>mezz_bench</ContentTitle>\n<EditRate>%d 1</EditRate>\n"
+        "<SegmentList>\n<Segment>\n<Id>", EDIT_RATE);
+    print_uuid(pb, 0x5E600000, 0);
+    avio_printf(pb, "</Id>\n<SequenceList>\n<cc:MainImageSequence>\n<Id>");
+    print_uuid(pb, 0x5E900000, 0);
+    avio_printf(pb, "</Id>\n<TrackId>");
+    print_uuid(pb, 0x77ACC000, 0);
+    avio_printf(pb, "</TrackId>\n<ResourceList>\n");
+    for (int i = 0; i < p->resources; i++) {
+        avio_printf(pb, "<Resource xsi:type=\"TrackFileResourceType\"><Id>");
+        print_uuid(pb, 0x7E500000, i);
+        avio_printf(pb, "</Id><IntrinsicDuration>%d</IntrinsicDuration><TrackFileId>", p->duration);
+        print_uuid(pb, 1, 0);
+        avio_printf(pb, "</TrackFileId></Resource>\n");
+    }
+    avio_printf(pb,
+        "</ResourceList>\n</cc:MainImageSequence>\n</SequenceList>\n"
+        "</Segment>\n</SegmentList>\n</CompositionPlaylist>\n");
+    avio_closep(&pb);
+
+    return 0;
+}
+
+static int open_input(const BenchParams *p, BenchRun *r, int threads)
+{
+    AVDictionary *opts = NULL;
+    const AVCodec *codec;
+    char path[1024];
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/ASSETMAP.xml", p->dir);
+    av_dict_set(&opts, "assetmaps", path, 0);
+    snprintf(path, sizeof(path), "%s/CPL.xml", p->dir);
+    ret = avformat_open_input(&r->ic, path, av_find_input_format("imf"), &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if ((ret = av_find_best_stream(r->ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
+        return ret;
+    r->ist = r->ic->streams[ret];
+
+    if (!(r->dec = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(r->dec, r->ist->codecpar)) < 0)
+        return ret;
+    r->dec->thread_count = threads;
+    return avcodec_open2(r->dec, codec, NULL);
+}
+
+/**
+ * Opens the scaler, the encoder and the muxer, once the first frame tells the
+ * format of the decoded pictures.
+ */
+static int open_output(const BenchParams *p, const Mezzanine *m, BenchRun *r,
+                       int threads, const char *path)
+{
+    const AVCodec *codec = avcodec_find_encoder_by_name(m->encoder);
+    const AVFrame *frame = r->frame;
+    AVDictionary *opts = NULL;
+    AVStream *st;
+    int ret;
+
+    if (!codec) {
+        fprintf(stderr, "Missing %s encoder\n", m->encoder);
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    if (!(r->sws = sws_alloc_context()))
+        return AVERROR(ENOMEM);
+    av_opt_set_int(r->sws, "srcw",       frame->width,  0);
+    av_opt_set_int(r->sws, "srch",       frame->height, 0);
+    av_opt_set_int(r->sws, "src_format", frame->format, 0);
+    av_opt_set_int(r->sws, "dstw",       frame->width,  0);
+    av_opt_set_int(r->sws, "dsth",       frame->height, 0);
+    av_opt_set_int(r->sws, "dst_format", m->pix_fmt,    0);
+    av_opt_set_int(r->sws, "sws_flags",  SWS_BICUBIC,   0);
+    av_opt_set_int(r->sws, "threads",    threads,       0);
+    if ((ret = sws_init_context(r->sws, NULL, NULL)) < 0)
+        return ret;
+    sws_setColorspaceDetails(r->sws, sws_getCoefficients(SWS_CS_ITU709), 1,
+                             sws_getCoefficients(SWS_CS_ITU709), 0, 0, 1 << 16, 1 << 16);
+
+    r->scaled->format = m->pix_fmt;
+    r->scaled->width  = frame->width;
+    r->scaled->height = frame->height;
+    if ((ret = av_frame_get_buffer(r->scaled, 0)) < 0)
+        return ret;
+
+    if (!(r->enc = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+    r->enc->width           = frame->width;
+    r->enc->height          = frame->height;
+    r->enc->pix_fmt         = m->pix_fmt;
+    r->enc->time_base       = (AVRational){ 1, EDIT_RATE };
+    r->enc->framerate       = (AVRational){ EDIT_RATE, 1 };
+    r->enc->color_range     = AVCOL_RANGE_MPEG;
+    r->enc->color_primaries = AVCOL_PRI_BT709;
+    r->enc->color_trc       = AVCOL_TRC_BT709;
+    r->enc->colorspace      = AVCOL_SPC_BT709;
+    r->enc->thread_count    = threads;
+
+    if ((ret = avformat_alloc_output_context2(&r->oc, NULL, "mov", path)) < 0)
+        return ret;
+    if (r->oc->oformat->flags & AVFMT_GLOBALHEADER)
+        r->enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if ((ret = av_dict_parse_string(&opts, m->options, "=", ":", 0)) < 0)
+        return ret;
+    ret = avcodec_open2(r->enc, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if (!(st = avformat_new_stream(r->oc, NULL)))
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_from_context(st->codecpar, r->enc)) < 0)
+        return ret;
+    st->time_base = r->enc->time_base;
+
+    if ((ret = avio_open(&r->oc->pb, path, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+    return avformat_write_header(r->oc, NULL);
+}
+
+static int encode_frame(BenchRun *r, AVFrame *frame)
+{
+    int64_t start = av_gettime_relative();
+    int ret = avcodec_send_frame(r->enc, frame);
+
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(r->enc, r->pkt);
+        r->times[STAGE_ENCODE] += av_gettime_relative() - start;
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+
+        r->bytes += r->pkt->size;
+        av_packet_rescale_ts(r->pkt, r->enc->time_base, r->oc->streams[0]->time_base);
+        r->pkt->stream_index = 0;
+        start = av_gettime_relative();
+        ret = av_interleaved_write_frame(r->oc, r->pkt);
+        r->times[STAGE_MUX] += av_gettime_relative() - start;
+
+        start = av_gettime_relative();
+    }
+    return ret;
+}
+
+static int receive_frames(const BenchParams *p, const Mezzanine *m, BenchRun *r,
+                          int threads, const char *path)
+{
+    int64_t start;
+    int ret;
+
+    while (1) {
+        start = av_gettime_relative();
+        ret = avcodec_receive_frame(r->dec, r->frame);
+        r->times[STAGE_DECODE] += av_gettime_relative() - start;
+        if (ret < 0)
+            return ret;
+
+        if (!r->enc && (ret = open_output(p, m, r, threads, path)) < 0)
+            return ret;
+        if (r->frame->width != r->enc->width || r->frame->height != r->enc->height) {
+            fprintf(stderr, "Picture size changed\n");
+            return AVERROR_INVALIDDATA;
+        }
+
+        start = av_gettime_relative();
+        if ((ret = av_frame_make_writable(r->scaled)) < 0)
+            return ret;
+        sws_scale(r->sws, (const uint8_t * const *)r->frame->data, r->frame->linesize,
+                  0, r->frame->height, r->scaled->data, r->scaled->linesize);
+        r->times[STAGE_COLORSPACE] += av_gettime_relative() - start;
+
+        r->scaled->pts = av_rescale_q(r->frame->best_effort_timestamp, r->ist->time_base,
+                                      r->enc->time_base);
+        av_frame_unref(r->frame);
+        if ((ret = encode_frame(r, r->scaled)) < 0)
+            return ret;
+        r->frames++;
+    }
+}
+
+static void print_result(const Mezzanine *m, const BenchRun *r, int threads,
+                         int64_t total, int first)
+{
+    double pixels = (double)r->frames * r->enc->width * r->enc->height;
+
+    printf("%s    {\n", first ? "" : ",\n");
+    printf("      \"mezzanine\": \"%s\",\n", m->name);
+    printf("      \"encoder\": \"%s\",\n", m->encoder);
+    printf("      \"threads\": %d,\n", threads);
+    printf("      \"frames\": %"PRId64",\n", r->frames);
+    printf("      \"bytes\": %"PRId64",\n", r->bytes);
+    printf("      \"fps\": {\n");
+    for (int i = 0; i < NB_STAGES; i++)
+        printf("        \"%s\": %.3f,\n", stage_names[i],
+               r->times[i] ? r->frames * 1e6 / r->times[i] : 0.0);
+    printf("        \"total\": %.3f\n", total ? r->frames * 1e6 / total : 0.0);
+    printf("      },\n");
+    printf("      \"ns_per_pixel\": {\n");
+    for (int i = 0; i < NB_STAGES; i++)
+        printf("        \"%s\": %.3f,\n", stage_names[i], r->times[i] * 1e3 / pixels);
+    printf("        \"total\": %.3f\n", total * 1e3 / pixels);
+    printf("      }\n");
+    printf("    }");
+    fflush(stdout);
+}
+
+static int run_mezzanine(const BenchParams *p, const Mezzanine *m, int threads, int first)
+{
+    BenchRun r = { 0 };
+    char path[1024];
+    int64_t start, mux_start, total;
+    int flushing = 0, ret;
+
+    snprintf(path, sizeof(path), "%s/%s_%d.mov", p->dir, m->name, threads);
+
+    r.frame  = av_frame_alloc();
+    r.scaled = av_frame_alloc();
+    r.pkt    = av_packet_alloc();
+    if (!r.frame || !r.scaled || !r.pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    start = av_gettime_relative();
+    if ((ret = open_input(p, &r, threads)) < 0)
+        goto end;
+
+    while (1) {
+        if (!flushing) {
+            int64_t t = av_gettime_relative();
+            ret = av_read_frame(r.ic, r.pkt);
+            r.times[STAGE_DEMUX] += av_gettime_relative() - t;
+            if (ret == AVERROR_EOF)
+                flushing = 1;
+            else if (ret < 0)
+                goto end;
+            else if (r.pkt->stream_index != r.ist->index) {
+                av_packet_unref(r.pkt);
+                continue;
+            }
+
+            t = av_gettime_relative();
+            ret = avcodec_send_packet(r.dec, flushing ? NULL : r.pkt);
+            r.times[STAGE_DECODE] += av_gettime_relative() - t;
+            av_packet_unref(r.pkt);
+            if (ret < 0)
+                goto end;
+        }
+
+        ret = receive_frames(p, m, &r, threads, path);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret != AVERROR(EAGAIN))
+            goto end;
+    }
+    if (!r.enc) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    if ((ret = encode_frame(&r, NULL)) < 0)
+        goto end;
+
+    mux_start = av_gettime_relative();
+    ret = av_write_trailer(r.oc);
+    r.times[STAGE_MUX] += av_gettime_relative() - mux_start;
+    total = av_gettime_relative() - start;
+    if (ret < 0)
+        goto end;
+
+    print_result(m, &r, threads, total, first);
+
+end:
+    if (r.oc && r.oc->pb)
+        avio_closep(&r.oc->pb);
+    avformat_free_context(r.oc);
+    avformat_close_input(&r.ic);
+    avcodec_free_context(&r.dec);
+    avcodec_free_context(&r.enc);
+    sws_freeContext(r.sws);
+    av_frame_free(&r.frame);
+    av_frame_free(&r.scaled);
+    av_packet_free(&r.pkt);
+    if (ret < 0)
+        fprintf(stderr, "Could not transcode to %s with %d threads: %s\n",
+                m->name, threads, av_err2str(ret));
+    else if (!p->keep)
+        remove(path);
+    return ret;
+}
+
+static int run_bench(const BenchParams *p)
+{
+    int first = 1, ret = 0;
+
+    printf("{\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"results\": [\n",
+           p->width, p->height, p->duration * p->resources);
+    for (int i = 0; i < FF_ARRAY_ELEMS(mezzanines) && ret >= 0; i++) {
+        const Mezzanine *m = &mezzanines[i];
+
+        if (p->mezzanine && !strstr(m->name, p->mezzanine))
+            continue;
+
+        for (int t = 0; t < p->nb_threads && ret >= 0; t++) {
+            ret = run_mezzanine(p, m, p->threads[t], first);
+            first = 0;
+        }
+    }
+    printf("\n  ],\n  \"peak_rss_kb\": %"PRId64"\n}\n", peak_rss_kb());
+
+    return ret;
+}
+
+static int parse_threads(BenchParams *p, const char *str)
+{
+    char *end;
+
+    p->nb_threads = 0;
+    do {
+        long n = strtol(str, &end, 10);
+        if (end == str || n < 1 || n > INT_MAX || p->nb_threads == MAX_THREAD_COUNTS)
+            return AVERROR(EINVAL);
+        p->threads[p->nb_threads++] = n;
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end ? AVERROR(EINVAL) : 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchParams p = {
+        .width      = 1920,
+        .height     = 1080,
+        .duration   = 12,
+        .resources  = 4,
+        .threads    = { 1, 2, 4 },
+        .nb_threads = 3,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hklm:s:d:r:t:")) != -1) {
+        switch (opt) {
+        case 'm': p.mezzanine = optarg; break;
+        case 'd': p.duration  = atoi(optarg); break;
+        case 'r': p.resources = atoi(optarg); break;
+        case 'k': p.keep      = 1; break;
+        case 's':
+            if (av_parse_video_size(&p.width, &p.height, optarg) < 0)
+                usage(1);
+            break;
+        case 't':
+            if (parse_threads(&p, optarg) < 0)
+                usage(1);
+            break;
+        case 'l':
+            for (int i = 0; i < FF_ARRAY_ELEMS(mezzanines); i++)
+                printf("%s\n", mezzanines[i].name);
+            return 0;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    if (optind + 1 != argc || p.duration < 1 || p.resources < 1)
+        usage(1);
+    p.dir = argv[optind];
+
+    /* the decoder warns about the code blocks of the native encoder */
+    av_log_set_level(AV_LOG_FATAL);
+
+    if (write_track_file(&p) < 0 || write_composition(&p) < 0 || run_bench(&p) < 0)
+        return 1;
+
+    return 0;
+}